@@ -39,6 +39,8 @@
 #include <winpr/path.h>
 #include <winpr/file.h>
 #include <winpr/stream.h>
+#include <winpr/interlocked.h>
+#include <winpr/collections.h>
 
 #include <freerdp/channels/rdpdr.h>
 
@@ -59,6 +61,40 @@
 	} while (0)
 #endif
 
+struct drive_file_generation
+{
+	volatile LONG value; /* incremented with every modification of the file */
+	size_t refs;         /* handles of the file, guarded by the cache lock */
+};
+
+struct drive_file_cache
+{
+	volatile LONG dirty;      /* number of files with write-behind data */
+	CRITICAL_SECTION lock;    /* guards files, taken before the lock of a file */
+	wArrayList* files;        /* files with buffering enabled */
+};
+
+static BOOL drive_file_flush_int(DRIVE_FILE* file);
+
+static void drive_file_generation_release(DRIVE_FILE_GENERATION* generation)
+{
+	if (!generation)
+		return;
+
+	WINPR_ASSERT(generation->refs > 0);
+	if (--generation->refs == 0)
+		free(generation);
+}
+
+/* Read-ahead data of all handles of the file is outdated */
+static void drive_file_modified(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (file->generation)
+		(void)InterlockedIncrement(&file->generation->value);
+}
+
 static BOOL drive_file_fix_path(WCHAR* path, size_t length)
 {
 	if ((length == 0) || (length > UINT32_MAX))
@@ -335,6 +371,7 @@ DRIVE_FILE* drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 Pat
 		return nullptr;
 	}
 
+	InitializeCriticalSection(&file->lock);
 	file->file_handle = INVALID_HANDLE_VALUE;
 	file->find_handle = INVALID_HANDLE_VALUE;
 	file->id = id;
@@ -367,6 +404,17 @@ BOOL drive_file_free(DRIVE_FILE* file)
 	if (!file)
 		return FALSE;
 
+	/* Other workers can not reach the file anymore once it is removed from the cache */
+	if (file->cache)
+	{
+		EnterCriticalSection(&file->cache->lock);
+		ArrayList_Remove(file->cache->files, file);
+		LeaveCriticalSection(&file->cache->lock);
+	}
+
+	if (!drive_file_flush_int(file))
+		WLog_WARN(TAG, "Failed to write back buffered data [%" PRIu32 "]", GetLastError());
+
 	if (file->file_handle != INVALID_HANDLE_VALUE)
 	{
 		(void)CloseHandle(file->file_handle);
@@ -396,64 +444,439 @@ BOOL drive_file_free(DRIVE_FILE* file)
 	rc = TRUE;
 fail:
 	DEBUG_WSTR("Free %s", file->fullpath);
+	if (file->cache)
+	{
+		EnterCriticalSection(&file->cache->lock);
+		drive_file_generation_release(file->generation);
+		LeaveCriticalSection(&file->cache->lock);
+	}
+	free(file->buffer);
 	free(file->fullpath);
+	DeleteCriticalSection(&file->lock);
 	free(file);
 	return rc;
 }
 
-BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset)
+static BOOL drive_file_read_at(DRIVE_FILE* file, UINT64 offset, BYTE* buffer, UINT32 length,
+                               UINT32* read)
+{
+	DWORD done = 0;
+	const LARGE_INTEGER loffset = { .QuadPart = WINPR_ASSERTING_INT_CAST(LONGLONG, offset) };
+
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(read);
+
+	if (!SetFilePointerEx(file->file_handle, loffset, nullptr, FILE_BEGIN))
+		return FALSE;
+
+	if (!ReadFile(file->file_handle, buffer, length, &done, nullptr))
+		return FALSE;
+
+	*read = done;
+	return TRUE;
+}
+
+static BOOL drive_file_write_at(DRIVE_FILE* file, UINT64 offset, const BYTE* buffer,
+                                UINT32 length)
+{
+	DWORD written = 0;
+	const LARGE_INTEGER loffset = { .QuadPart = WINPR_ASSERTING_INT_CAST(LONGLONG, offset) };
+
+	WINPR_ASSERT(file);
+
+	drive_file_modified(file);
+
+	if (!SetFilePointerEx(file->file_handle, loffset, nullptr, FILE_BEGIN))
+		return FALSE;
+
+	while (length > 0)
+	{
+		if (!WriteFile(file->file_handle, buffer, length, &written, nullptr))
+			return FALSE;
+
+		length -= written;
+		buffer += written;
+	}
+
+	return TRUE;
+}
+
+static BOOL drive_file_buffer_alloc(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->buffer)
+		file->buffer = malloc(DRIVE_FILE_BUFFER_SIZE);
+	return file->buffer != nullptr;
+}
+
+/* Read-ahead data is only valid as long as no handle modified the file */
+static BOOL drive_file_buffer_readable(const DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->generation || file->bufferDirty || (file->bufferLength == 0))
+		return FALSE;
+	return InterlockedCompareExchange(&file->generation->value, 0, 0) == file->bufferGeneration;
+}
+
+static BOOL drive_file_read_ahead(const DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->cache)
+		return FALSE;
+	if (file->CreateOptions & (FILE_RANDOM_ACCESS | FILE_NO_INTERMEDIATE_BUFFERING))
+		return FALSE;
+	if (file->CreateOptions & FILE_SEQUENTIAL_ONLY)
+		return TRUE;
+	return file->offset == file->nextReadOffset;
+}
+
+static BOOL drive_file_write_behind(const DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->cache)
+		return FALSE;
+	return (file->CreateOptions & (FILE_WRITE_THROUGH | FILE_NO_INTERMEDIATE_BUFFERING)) == 0;
+}
+
+static BOOL drive_file_write_back(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (!file->bufferDirty)
+		return TRUE;
+
+	DEBUG_WSTR("Flush file %s", file->fullpath);
+
+	const BOOL rc =
+	    drive_file_write_at(file, file->bufferOffset, file->buffer, file->bufferLength);
+	file->bufferDirty = FALSE;
+	file->bufferLength = 0;
+	(void)InterlockedDecrement(&file->cache->dirty);
+	return rc;
+}
+
+static BOOL drive_file_flush_int(DRIVE_FILE* file)
+{
+	WINPR_ASSERT(file);
+
+	if (file->deferredError != 0)
+	{
+		SetLastError(file->deferredError);
+		file->deferredError = 0;
+		return FALSE;
+	}
+
+	return drive_file_write_back(file);
+}
+
+/* Write back what other handles buffered for the file at path, or for all files if path is
+ * nullptr. Other workers own these handles, a failure is reported with their next request. */
+static void drive_file_cache_flush(DRIVE_FILE_CACHE* cache, const DRIVE_FILE* except,
+                                   const WCHAR* path)
+{
+	if (!cache)
+		return;
+
+	const LONG dirty = InterlockedCompareExchange(&cache->dirty, 0, 0);
+	if ((dirty == 0) || ((dirty == 1) && except && except->bufferDirty))
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	const size_t count = ArrayList_Count(cache->files);
+	for (size_t x = 0; x < count; x++)
+	{
+		DRIVE_FILE* other = ArrayList_GetItem(cache->files, x);
+		if ((other == except) || !other->bufferDirty)
+			continue;
+
+		EnterCriticalSection(&other->lock);
+		if (!path || (_wcscmp(other->fullpath, path) == 0))
+		{
+			if (!drive_file_write_back(other))
+			{
+				other->deferredError = GetLastError();
+				WLog_WARN(TAG, "Deferred write failed [%" PRIu32 "]", other->deferredError);
+			}
+		}
+		LeaveCriticalSection(&other->lock);
+	}
+	LeaveCriticalSection(&cache->lock);
+}
+
+void drive_file_cache_free(DRIVE_FILE_CACHE* cache)
+{
+	if (!cache)
+		return;
+
+	ArrayList_Free(cache->files);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+DRIVE_FILE_CACHE* drive_file_cache_new(void)
+{
+	DRIVE_FILE_CACHE* cache = (DRIVE_FILE_CACHE*)calloc(1, sizeof(DRIVE_FILE_CACHE));
+	if (!cache)
+		return nullptr;
+
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		free(cache);
+		return nullptr;
+	}
+
+	cache->files = ArrayList_New(FALSE);
+	if (!cache->files)
+	{
+		drive_file_cache_free(cache);
+		return nullptr;
+	}
+
+	return cache;
+}
+
+void drive_file_cache_prepare_open(DRIVE_FILE_CACHE* cache, const WCHAR* base_path,
+                                   const WCHAR* path, UINT32 PathWCharLength)
+{
+	if (!cache)
+		return;
+
+	WCHAR* fullpath = drive_file_combine_fullpath(base_path, path, PathWCharLength);
+	if (!fullpath)
+		return;
+
+	drive_file_cache_flush(cache, nullptr, fullpath);
+	free(fullpath);
+}
+
+/* Handles of the same path share one generation, the cache lock must be held */
+static DRIVE_FILE_GENERATION* drive_file_cache_generation(DRIVE_FILE_CACHE* cache,
+                                                          const WCHAR* fullpath)
+{
+	DRIVE_FILE_GENERATION* generation = nullptr;
+
+	WINPR_ASSERT(cache);
+
+	const size_t count = ArrayList_Count(cache->files);
+	for (size_t x = 0; !generation && (x < count); x++)
+	{
+		DRIVE_FILE* other = ArrayList_GetItem(cache->files, x);
+
+		EnterCriticalSection(&other->lock);
+		if (fullpath && other->fullpath && (_wcscmp(other->fullpath, fullpath) == 0))
+			generation = other->generation;
+		LeaveCriticalSection(&other->lock);
+	}
+
+	if (!generation)
+		generation = (DRIVE_FILE_GENERATION*)calloc(1, sizeof(DRIVE_FILE_GENERATION));
+	if (generation)
+		generation->refs++;
+	return generation;
+}
+
+BOOL drive_file_enable_buffering(DRIVE_FILE* file, DRIVE_FILE_CACHE* cache)
 {
-	LARGE_INTEGER loffset = WINPR_C_ARRAY_INIT;
+	BOOL rc = FALSE;
+
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(cache);
+
+	EnterCriticalSection(&cache->lock);
+	DRIVE_FILE_GENERATION* generation = drive_file_cache_generation(cache, file->fullpath);
+	if (!generation)
+		goto out;
 
+	if (!ArrayList_Append(cache->files, file))
+	{
+		drive_file_generation_release(generation);
+		goto out;
+	}
+
+	file->cache = cache;
+	file->generation = generation;
+
+	/* The open replaced the content other handles might have read ahead */
+	switch (file->CreateDisposition)
+	{
+		case FILE_SUPERSEDE:
+		case FILE_OVERWRITE:
+		case FILE_OVERWRITE_IF:
+			drive_file_modified(file);
+			break;
+		default:
+			break;
+	}
+
+	rc = TRUE;
+out:
+	LeaveCriticalSection(&cache->lock);
+	return rc;
+}
+
+BOOL drive_file_flush(DRIVE_FILE* file)
+{
+	if (!file)
+		return FALSE;
+
+	EnterCriticalSection(&file->lock);
+	const BOOL rc = drive_file_flush_int(file);
+	LeaveCriticalSection(&file->lock);
+	return rc;
+}
+
+BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset)
+{
 	if (!file)
 		return FALSE;
 
 	if (Offset > INT64_MAX)
 		return FALSE;
 
-	loffset.QuadPart = (LONGLONG)Offset;
-	return SetFilePointerEx(file->file_handle, loffset, nullptr, FILE_BEGIN);
+	if (file->file_handle == INVALID_HANDLE_VALUE)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	file->offset = Offset;
+	return TRUE;
 }
 
-BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
+static BOOL drive_file_read_int(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
 {
-	DWORD read = 0;
+	UINT32 read = 0;
 
-	if (!file || !buffer || !Length)
-		return FALSE;
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(Length);
 
 	DEBUG_WSTR("Read file %s", file->fullpath);
 
-	if (ReadFile(file->file_handle, buffer, *Length, &read, nullptr))
+	if (!drive_file_flush_int(file))
+		return FALSE;
+
+	if (drive_file_buffer_readable(file) && (file->offset >= file->bufferOffset) &&
+	    (file->offset - file->bufferOffset < file->bufferLength))
 	{
-		*Length = read;
-		return TRUE;
+		const UINT32 pos = (UINT32)(file->offset - file->bufferOffset);
+		const UINT32 available = file->bufferLength - pos;
+
+		if ((available >= *Length) || file->bufferEof)
+		{
+			read = MIN(available, *Length);
+			memcpy(buffer, &file->buffer[pos], read);
+			goto out;
+		}
 	}
 
-	return FALSE;
+	if ((*Length < DRIVE_FILE_BUFFER_SIZE) && drive_file_read_ahead(file) &&
+	    drive_file_buffer_alloc(file))
+	{
+		UINT32 filled = 0;
+
+		file->bufferLength = 0;
+		file->bufferGeneration = InterlockedCompareExchange(&file->generation->value, 0, 0);
+		if (!drive_file_read_at(file, file->offset, file->buffer, DRIVE_FILE_BUFFER_SIZE,
+		                        &filled))
+			return FALSE;
+
+		file->bufferOffset = file->offset;
+		file->bufferLength = filled;
+		file->bufferEof = filled < DRIVE_FILE_BUFFER_SIZE;
+		read = MIN(filled, *Length);
+		memcpy(buffer, file->buffer, read);
+	}
+	else if (!drive_file_read_at(file, file->offset, buffer, *Length, &read))
+		return FALSE;
+
+out:
+	file->offset += read;
+	file->nextReadOffset = file->offset;
+	*Length = read;
+	return TRUE;
 }
 
-BOOL drive_file_write(DRIVE_FILE* file, const BYTE* buffer, UINT32 Length)
+BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer, UINT32* Length)
 {
-	DWORD written = 0;
-
-	if (!file || !buffer)
+	if (!file || !buffer || !Length)
 		return FALSE;
 
+	drive_file_cache_flush(file->cache, file, file->fullpath);
+
+	EnterCriticalSection(&file->lock);
+	const BOOL rc = drive_file_read_int(file, buffer, Length);
+	LeaveCriticalSection(&file->lock);
+	return rc;
+}
+
+static BOOL drive_file_write_int(DRIVE_FILE* file, const BYTE* buffer, UINT32 Length)
+{
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(buffer);
+
 	DEBUG_WSTR("Write file %s", file->fullpath);
 
-	while (Length > 0)
+	if (!file->bufferDirty)
+		file->bufferLength = 0;
+
+	if (Length == 0)
+		return TRUE;
+
+	if ((Length < DRIVE_FILE_BUFFER_SIZE) && drive_file_write_behind(file) &&
+	    drive_file_buffer_alloc(file))
 	{
-		if (!WriteFile(file->file_handle, buffer, Length, &written, nullptr))
-			return FALSE;
+		/* Only contiguous writes are combined */
+		if (file->bufferDirty && ((file->offset != file->bufferOffset + file->bufferLength) ||
+		                          (Length > DRIVE_FILE_BUFFER_SIZE - file->bufferLength)))
+		{
+			if (!drive_file_flush_int(file))
+				return FALSE;
+		}
 
-		Length -= written;
-		buffer += written;
+		if (!file->bufferDirty)
+		{
+			file->bufferOffset = file->offset;
+			file->bufferLength = 0;
+			file->bufferDirty = TRUE;
+			(void)InterlockedIncrement(&file->cache->dirty);
+		}
+
+		memcpy(&file->buffer[file->bufferLength], buffer, Length);
+		file->bufferLength += Length;
+		file->offset += Length;
+		drive_file_modified(file);
+		return TRUE;
 	}
 
+	if (!drive_file_flush_int(file))
+		return FALSE;
+
+	if (!drive_file_write_at(file, file->offset, buffer, Length))
+		return FALSE;
+
+	file->offset += Length;
 	return TRUE;
 }
 
+BOOL drive_file_write(DRIVE_FILE* file, const BYTE* buffer, UINT32 Length)
+{
+	if (!file || !buffer)
+		return FALSE;
+
+	/* A deferred write of another handle must not overwrite this one later */
+	drive_file_cache_flush(file->cache, file, file->fullpath);
+
+	EnterCriticalSection(&file->lock);
+	const BOOL rc = drive_file_write_int(file, buffer, Length);
+	LeaveCriticalSection(&file->lock);
+	return rc;
+}
+
 static BOOL drive_file_query_from_handle_information(const DRIVE_FILE* file,
                                                      const BY_HANDLE_FILE_INFORMATION* info,
                                                      UINT32 FsInformationClass, wStream* output)
@@ -584,13 +1007,17 @@ static BOOL drive_file_query_from_attributes(const DRIVE_FILE* file,
 	return TRUE;
 }
 
-BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
+static BOOL drive_file_query_information_int(DRIVE_FILE* file, UINT32 FsInformationClass,
+                                             wStream* output)
 {
 	BY_HANDLE_FILE_INFORMATION fileInformation = WINPR_C_ARRAY_INIT;
 	BOOL status = 0;
 
-	if (!file || !output)
-		return FALSE;
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(output);
+
+	if (!drive_file_flush_int(file))
+		goto out_fail;
 
 	if ((file->file_handle != INVALID_HANDLE_VALUE) &&
 	    GetFileInformationByHandle(file->file_handle, &fileInformation))
@@ -633,6 +1060,19 @@ out_fail:
 	return FALSE;
 }
 
+BOOL drive_file_query_information(DRIVE_FILE* file, UINT32 FsInformationClass, wStream* output)
+{
+	if (!file || !output)
+		return FALSE;
+
+	drive_file_cache_flush(file->cache, file, file->fullpath);
+
+	EnterCriticalSection(&file->lock);
+	const BOOL rc = drive_file_query_information_int(file, FsInformationClass, output);
+	LeaveCriticalSection(&file->lock);
+	return rc;
+}
+
 static BOOL drive_file_set_basic_information(DRIVE_FILE* file, UINT32 Length, wStream* input)
 {
 	WINPR_ASSERT(file);
@@ -863,14 +1303,17 @@ static BOOL drive_file_set_rename_information(DRIVE_FILE* file, UINT32 Length, w
 	return TRUE;
 }
 
-BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
-                                wStream* input)
+static BOOL drive_file_set_information_int(DRIVE_FILE* file, UINT32 FsInformationClass,
+                                           UINT32 Length, wStream* input)
 {
-	if (!file || !input)
-		return FALSE;
+	WINPR_ASSERT(file);
+	WINPR_ASSERT(input);
 
-	if (!Stream_CheckAndLogRequiredLength(TAG, input, Length))
+	/* Pending data must be on disk before sizes or timestamps change */
+	if (!drive_file_flush_int(file))
 		return FALSE;
+	file->bufferLength = 0;
+	drive_file_modified(file);
 
 	switch (FsInformationClass)
 	{
@@ -897,6 +1340,26 @@ BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UIN
 	return TRUE;
 }
 
+BOOL drive_file_set_information(DRIVE_FILE* file, UINT32 FsInformationClass, UINT32 Length,
+                                wStream* input)
+{
+	if (!file || !input)
+		return FALSE;
+
+	if (!Stream_CheckAndLogRequiredLength(TAG, input, Length))
+		return FALSE;
+
+	/* A rename might replace any file, write back all of them */
+	drive_file_cache_flush(file->cache, file,
+	                       (FsInformationClass == FileRenameInformation) ? nullptr
+	                                                                     : file->fullpath);
+
+	EnterCriticalSection(&file->lock);
+	const BOOL rc = drive_file_set_information_int(file, FsInformationClass, Length, input);
+	LeaveCriticalSection(&file->lock);
+	return rc;
+}
+
 static BOOL drive_file_query_dir_info(DRIVE_FILE* file, wStream* output, size_t length)
 {
 	WINPR_ASSERT(file);
@@ -1034,6 +1497,9 @@ BOOL drive_file_query_directory(DRIVE_FILE* file, UINT32 FsInformationClass, BYT
 	if (!file || !path || !output)
 		return FALSE;
 
+	/* Listed sizes and timestamps must include data buffered by any handle */
+	drive_file_cache_flush(file->cache, nullptr, nullptr);
+
 	if (InitialQuery != 0)
 	{
 		/* release search handle */
@@ -28,12 +28,18 @@
 
 #include <winpr/stream.h>
 #include <winpr/file.h>
+#include <winpr/synch.h>
 
 #include <freerdp/api.h>
 #include <freerdp/channels/log.h>
 
 #define TAG CHANNELS_TAG("drive.client")
 
+#define DRIVE_FILE_BUFFER_SIZE (64u * 1024u)
+
+typedef struct drive_file_cache DRIVE_FILE_CACHE;
+typedef struct drive_file_generation DRIVE_FILE_GENERATION;
+
 typedef struct
 {
 	UINT32 id;
@@ -49,6 +55,19 @@ typedef struct
 	UINT32 DesiredAccess;
 	UINT32 CreateDisposition;
 	UINT32 CreateOptions;
+
+	UINT64 offset;
+	UINT64 nextReadOffset;
+	CRITICAL_SECTION lock; /* taken by other workers writing back this file */
+	DRIVE_FILE_CACHE* cache;
+	DRIVE_FILE_GENERATION* generation;
+	BYTE* buffer;
+	UINT64 bufferOffset;
+	UINT32 bufferLength;
+	LONG bufferGeneration;
+	BOOL bufferDirty;
+	BOOL bufferEof;
+	DWORD deferredError;
 } DRIVE_FILE;
 
 FREERDP_LOCAL BOOL drive_file_free(DRIVE_FILE* file);
@@ -61,6 +80,34 @@ drive_file_new(const WCHAR* base_path, const WCHAR* path, UINT32 PathWCharLength
 
 WINPR_ATTR_NODISCARD FREERDP_LOCAL BOOL drive_file_open(DRIVE_FILE* file);
 
+FREERDP_LOCAL void drive_file_cache_free(DRIVE_FILE_CACHE* cache);
+
+/** Create the buffering state shared by all files of a drive */
+WINPR_ATTR_MALLOC(drive_file_cache_free, 1)
+WINPR_ATTR_NODISCARD FREERDP_LOCAL DRIVE_FILE_CACHE* drive_file_cache_new(void);
+
+/** Write back pending data of other handles before the file at \b path is opened
+ *
+ *  The open might truncate or replace a file another handle still has buffered data for.
+ */
+FREERDP_LOCAL void drive_file_cache_prepare_open(DRIVE_FILE_CACHE* cache, const WCHAR* base_path,
+                                                 const WCHAR* path, UINT32 PathWCharLength);
+
+/** Enable read-ahead and write-behind buffering for \b file
+ *
+ *  Read-ahead data is discarded whenever a handle of the same file modifies it. Before a
+ *  handle accesses a file, other handles of the same file write back their pending data.
+ *  Pending writes must be written back with \b drive_file_flush
+ */
+WINPR_ATTR_NODISCARD FREERDP_LOCAL BOOL drive_file_enable_buffering(DRIVE_FILE* file,
+                                                                    DRIVE_FILE_CACHE* cache);
+
+/** Write back pending data of \b file
+ *
+ *  @return \b FALSE if this or an earlier deferred write failed, \b GetLastError has the reason
+ */
+WINPR_ATTR_NODISCARD FREERDP_LOCAL BOOL drive_file_flush(DRIVE_FILE* file);
+
 WINPR_ATTR_NODISCARD FREERDP_LOCAL BOOL drive_file_seek(DRIVE_FILE* file, UINT64 Offset);
 
 WINPR_ATTR_NODISCARD FREERDP_LOCAL BOOL drive_file_read(DRIVE_FILE* file, BYTE* buffer,
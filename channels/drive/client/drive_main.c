@@ -42,29 +42,47 @@
 #include <winpr/interlocked.h>
 #include <winpr/collections.h>
 #include <winpr/shell.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/channels/rdpdr.h>
 
 #include "drive_file.h"
 
+#define DRIVE_WORKERS_DEFAULT 4
+#define DRIVE_WORKERS_MAX 64
+
+typedef struct S_DRIVE_DEVICE DRIVE_DEVICE;
+
+/* IRPs are distributed by FileId, so requests for one file are processed in order */
 typedef struct
+{
+	DRIVE_DEVICE* drive;
+	HANDLE thread;
+	wMessageQueue* IrpQueue;
+	wArrayList* pending; /* files with write-behind data */
+} DRIVE_WORKER;
+
+struct S_DRIVE_DEVICE
 {
 	DEVICE device;
 
 	WCHAR* path;
 	BOOL automount;
 	UINT32 PathLength;
-	wListDictionary* files;
+	wHashTable* files;
+	CRITICAL_SECTION lock;
+	DRIVE_FILE_CACHE* cache;
 
-	HANDLE thread;
 	BOOL async;
-	wMessageQueue* IrpQueue;
+	DRIVE_WORKER* workers;
+	size_t workerCount;
+	volatile LONG nextWorker;
 
 	DEVMAN* devman;
 
 	rdpContext* rdpcontext;
-} DRIVE_DEVICE;
+};
 
 static NTSTATUS drive_map_windows_err(DWORD fs_errno)
 {
@@ -137,6 +155,12 @@ static NTSTATUS drive_map_windows_err(DWORD fs_errno)
 	return rc;
 }
 
+static UINT32 drive_file_id_hash(const void* key)
+{
+	/* FileIds are sequential, so they are their own perfect hash */
+	return (UINT32)(size_t)key;
+}
+
 static DRIVE_FILE* drive_get_file_by_id(DRIVE_DEVICE* drive, UINT32 id)
 {
 	DRIVE_FILE* file = nullptr;
@@ -145,7 +169,7 @@ static DRIVE_FILE* drive_get_file_by_id(DRIVE_DEVICE* drive, UINT32 id)
 	if (!drive)
 		return nullptr;
 
-	file = (DRIVE_FILE*)ListDictionary_GetItemValue(drive->files, key);
+	file = (DRIVE_FILE*)HashTable_GetItemValue(drive->files, key);
 	return file;
 }
 
@@ -154,7 +178,7 @@ static DRIVE_FILE* drive_get_file_by_id(DRIVE_DEVICE* drive, UINT32 id)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
+static UINT drive_process_irp_create(DRIVE_DEVICE* drive, DRIVE_WORKER* worker, IRP* irp)
 {
 	BYTE Information = 0;
 
@@ -178,7 +202,10 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 		return ERROR_INVALID_DATA;
 
 	const WCHAR* path = Stream_ConstPointer(irp->input);
+	EnterCriticalSection(&drive->lock);
 	UINT32 FileId = irp->devman->id_sequence++;
+	LeaveCriticalSection(&drive->lock);
+	drive_file_cache_prepare_open(drive->cache, drive->path, path, PathLength / sizeof(WCHAR));
 	DRIVE_FILE* file =
 	    drive_file_new(drive->path, path, PathLength / sizeof(WCHAR), FileId, DesiredAccess,
 	                   CreateDisposition, CreateOptions, FileAttributes, SharedAccess);
@@ -193,9 +220,10 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 	{
 		void* key = (void*)(size_t)file->id;
 
-		if (!ListDictionary_Add(drive->files, key, file))
+		if (!HashTable_Insert(drive->files, key, file))
 		{
-			WLog_ERR(TAG, "ListDictionary_Add failed!");
+			WLog_ERR(TAG, "HashTable_Insert failed!");
+			drive_file_free(file);
 			return ERROR_INTERNAL_ERROR;
 		}
 
@@ -221,6 +249,9 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
 				break;
 		}
 
+		if (worker && !drive_file_enable_buffering(file, drive->cache))
+			WLog_WARN(TAG, "Buffering disabled for file %" PRIu32, file->id);
+
 		if (allocationSize > 0)
 		{
 			const BYTE buffer[] = { '\0' };
@@ -242,7 +273,7 @@ static UINT drive_process_irp_create(DRIVE_DEVICE* drive, IRP* irp)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drive_process_irp_close(DRIVE_DEVICE* drive, IRP* irp)
+static UINT drive_process_irp_close(DRIVE_DEVICE* drive, DRIVE_WORKER* worker, IRP* irp)
 {
 	WINPR_ASSERT(drive);
 	WINPR_ASSERT(irp);
@@ -256,8 +287,13 @@ static UINT drive_process_irp_close(DRIVE_DEVICE* drive, IRP* irp)
 		irp->IoStatus = STATUS_UNSUCCESSFUL;
 	else
 	{
-		ListDictionary_Remove(drive->files, key);
-		irp->IoStatus = drive_map_windows_err(GetLastError());
+		const BOOL flushed = drive_file_flush(file);
+		const DWORD error = GetLastError();
+
+		if (worker)
+			ArrayList_Remove(worker->pending, file);
+		HashTable_Remove(drive->files, key);
+		irp->IoStatus = drive_map_windows_err(flushed ? GetLastError() : error);
 	}
 
 	Stream_Zero(irp->output, 5); /* Padding(5) */
@@ -330,7 +366,7 @@ static UINT drive_process_irp_read(DRIVE_DEVICE* drive, IRP* irp)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drive_process_irp_write(DRIVE_DEVICE* drive, IRP* irp)
+static UINT drive_process_irp_write(DRIVE_DEVICE* drive, DRIVE_WORKER* worker, IRP* irp)
 {
 	DRIVE_FILE* file = nullptr;
 	UINT32 Length = 0;
@@ -367,6 +403,11 @@ static UINT drive_process_irp_write(DRIVE_DEVICE* drive, IRP* irp)
 		irp->IoStatus = drive_map_windows_err(GetLastError());
 		Length = 0;
 	}
+	else if (worker && file->bufferDirty && !ArrayList_Contains(worker->pending, file))
+	{
+		if (!ArrayList_Append(worker->pending, file))
+			return ERROR_INTERNAL_ERROR;
+	}
 
 	Stream_Write_UINT32(irp->output, Length);
 	Stream_Write_UINT8(irp->output, 0); /* Padding */
@@ -739,7 +780,7 @@ static UINT drive_evaluate(UINT error, IRP* irp)
  *
  * @return 0 on success, otherwise a Win32 error code
  */
-static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
+static UINT drive_process_irp(DRIVE_DEVICE* drive, DRIVE_WORKER* worker, IRP* irp)
 {
 	UINT error = CHANNEL_RC_OK;
 	WINPR_ASSERT(drive);
@@ -750,11 +791,11 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 	switch (irp->MajorFunction)
 	{
 		case IRP_MJ_CREATE:
-			error = drive_process_irp_create(drive, irp);
+			error = drive_process_irp_create(drive, worker, irp);
 			break;
 
 		case IRP_MJ_CLOSE:
-			error = drive_process_irp_close(drive, irp);
+			error = drive_process_irp_close(drive, worker, irp);
 			break;
 
 		case IRP_MJ_READ:
@@ -762,7 +803,7 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 			break;
 
 		case IRP_MJ_WRITE:
-			error = drive_process_irp_write(drive, irp);
+			error = drive_process_irp_write(drive, worker, irp);
 			break;
 
 		case IRP_MJ_QUERY_INFORMATION:
@@ -797,13 +838,13 @@ static UINT drive_process_irp(DRIVE_DEVICE* drive, IRP* irp)
 	return drive_evaluate(error, irp);
 }
 
-static BOOL drive_poll_run(DRIVE_DEVICE* drive, IRP* irp)
+static BOOL drive_poll_run(DRIVE_DEVICE* drive, DRIVE_WORKER* worker, IRP* irp)
 {
 	WINPR_ASSERT(drive);
 
 	if (irp)
 	{
-		const UINT error = drive_process_irp(drive, irp);
+		const UINT error = drive_process_irp(drive, worker, irp);
 		if (error)
 		{
 			WLog_ERR(TAG, "drive_process_irp failed with error %" PRIu32 "!", error);
@@ -814,31 +855,56 @@ static BOOL drive_poll_run(DRIVE_DEVICE* drive, IRP* irp)
 	return TRUE;
 }
 
+/* Write back buffered data once there is nothing more to combine it with. A failure is
+ * reported with the next request for that file. */
+static void drive_worker_flush(DRIVE_WORKER* worker)
+{
+	WINPR_ASSERT(worker);
+
+	const size_t count = ArrayList_Count(worker->pending);
+	for (size_t x = 0; x < count; x++)
+	{
+		DRIVE_FILE* file = ArrayList_GetItem(worker->pending, x);
+		if (!drive_file_flush(file))
+		{
+			file->deferredError = GetLastError();
+			WLog_WARN(TAG, "Deferred write failed [%" PRIu32 "]", file->deferredError);
+		}
+	}
+	ArrayList_Clear(worker->pending);
+}
+
 static DWORD WINAPI drive_thread_func(LPVOID arg)
 {
-	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)arg;
+	DRIVE_WORKER* worker = (DRIVE_WORKER*)arg;
+	DRIVE_DEVICE* drive = nullptr;
 	UINT error = CHANNEL_RC_OK;
 
-	if (!drive)
+	if (!worker || !worker->drive)
 	{
 		error = ERROR_INVALID_PARAMETER;
 		goto fail;
 	}
 
+	drive = worker->drive;
+
 	while (1)
 	{
-		if (!MessageQueue_Wait(drive->IrpQueue))
+		if (MessageQueue_Size(worker->IrpQueue) < 1)
+			drive_worker_flush(worker);
+
+		if (!MessageQueue_Wait(worker->IrpQueue))
 		{
 			WLog_ERR(TAG, "MessageQueue_Wait failed!");
 			error = ERROR_INTERNAL_ERROR;
 			break;
 		}
 
-		if (MessageQueue_Size(drive->IrpQueue) < 1)
+		if (MessageQueue_Size(worker->IrpQueue) < 1)
 			continue;
 
 		wMessage message = WINPR_C_ARRAY_INIT;
-		if (!MessageQueue_Peek(drive->IrpQueue, &message, TRUE))
+		if (!MessageQueue_Peek(worker->IrpQueue, &message, TRUE))
 		{
 			WLog_ERR(TAG, "MessageQueue_Peek failed!");
 			continue;
@@ -848,10 +914,12 @@ static DWORD WINAPI drive_thread_func(LPVOID arg)
 			break;
 
 		IRP* irp = (IRP*)message.wParam;
-		if (!drive_poll_run(drive, irp))
+		if (!drive_poll_run(drive, worker, irp))
 			break;
 	}
 
+	drive_worker_flush(worker);
+
 fail:
 
 	if (error && drive && drive->rdpcontext)
@@ -861,6 +929,22 @@ fail:
 	return error;
 }
 
+static DRIVE_WORKER* drive_select_worker(DRIVE_DEVICE* drive, const IRP* irp)
+{
+	WINPR_ASSERT(drive);
+	WINPR_ASSERT(irp);
+	WINPR_ASSERT(drive->workerCount > 0);
+
+	/* A new file has no requests to be ordered with yet */
+	if (irp->MajorFunction == IRP_MJ_CREATE)
+	{
+		const LONG next = InterlockedIncrement(&drive->nextWorker);
+		return &drive->workers[(UINT32)next % drive->workerCount];
+	}
+
+	return &drive->workers[irp->FileId % drive->workerCount];
+}
+
 /**
  * Function description
  *
@@ -870,12 +954,13 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 {
 	DRIVE_DEVICE* drive = (DRIVE_DEVICE*)device;
 
-	if (!drive)
+	if (!drive || !irp)
 		return ERROR_INVALID_PARAMETER;
 
 	if (drive->async)
 	{
-		if (!MessageQueue_Post(drive->IrpQueue, nullptr, 0, (void*)irp, nullptr))
+		DRIVE_WORKER* worker = drive_select_worker(drive, irp);
+		if (!MessageQueue_Post(worker->IrpQueue, nullptr, 0, (void*)irp, nullptr))
 		{
 			WLog_ERR(TAG, "MessageQueue_Post failed!");
 			return ERROR_INTERNAL_ERROR;
@@ -883,7 +968,7 @@ static UINT drive_irp_request(DEVICE* device, IRP* irp)
 	}
 	else
 	{
-		if (!drive_poll_run(drive, irp))
+		if (!drive_poll_run(drive, nullptr, irp))
 			return ERROR_INTERNAL_ERROR;
 	}
 
@@ -897,9 +982,17 @@ static UINT drive_free_int(DRIVE_DEVICE* drive)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	(void)CloseHandle(drive->thread);
-	ListDictionary_Free(drive->files);
-	MessageQueue_Free(drive->IrpQueue);
+	for (size_t x = 0; x < drive->workerCount; x++)
+	{
+		DRIVE_WORKER* worker = &drive->workers[x];
+		(void)CloseHandle(worker->thread);
+		MessageQueue_Free(worker->IrpQueue);
+		ArrayList_Free(worker->pending);
+	}
+	free(drive->workers);
+	HashTable_Free(drive->files);
+	drive_file_cache_free(drive->cache);
+	DeleteCriticalSection(&drive->lock);
 	Stream_Free(drive->device.data, TRUE);
 	free(drive->path);
 	free(drive);
@@ -919,19 +1012,23 @@ static UINT drive_free(DEVICE* device)
 	if (!drive)
 		return ERROR_INVALID_PARAMETER;
 
-	if (MessageQueue_PostQuit(drive->IrpQueue, 0) &&
-	    (WaitForSingleObject(drive->thread, INFINITE) == WAIT_FAILED))
+	for (size_t x = 0; x < drive->workerCount; x++)
 	{
-		error = GetLastError();
-		WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
-		return error;
+		DRIVE_WORKER* worker = &drive->workers[x];
+		if (worker->thread && MessageQueue_PostQuit(worker->IrpQueue, 0) &&
+		    (WaitForSingleObject(worker->thread, INFINITE) == WAIT_FAILED))
+		{
+			error = GetLastError();
+			WLog_ERR(TAG, "WaitForSingleObject failed with error %" PRIu32 "", error);
+			return error;
+		}
 	}
 
 	return drive_free_int(drive);
 }
 
 /**
- * Helper function used for freeing list dictionary value object
+ * Helper function used for freeing hash table value object
  */
 static void drive_file_objfree(void* obj)
 {
@@ -953,6 +1050,69 @@ static void drive_message_free(void* obj)
 	irp->Discard(irp);
 }
 
+/**
+ * The number of IRP workers per drive, can be set with the FREERDP_DRIVE_WORKERS environment
+ * variable and defaults to the number of processors up to DRIVE_WORKERS_DEFAULT.
+ */
+static size_t drive_worker_count(void)
+{
+	SYSTEM_INFO sysinfo = WINPR_C_ARRAY_INIT;
+	const char* env = getenv("FREERDP_DRIVE_WORKERS");
+
+	if (env)
+	{
+		errno = 0;
+		const unsigned long count = strtoul(env, nullptr, 0);
+		if ((errno == 0) && (count > 0) && (count <= DRIVE_WORKERS_MAX))
+			return count;
+		WLog_WARN(TAG, "Ignoring invalid FREERDP_DRIVE_WORKERS=%s", env);
+	}
+
+	GetNativeSystemInfo(&sysinfo);
+	return MAX(1, MIN(sysinfo.dwNumberOfProcessors, DRIVE_WORKERS_DEFAULT));
+}
+
+static BOOL drive_start_workers(DRIVE_DEVICE* drive)
+{
+	WINPR_ASSERT(drive);
+
+	const size_t count = drive_worker_count();
+	drive->workers = (DRIVE_WORKER*)calloc(count, sizeof(DRIVE_WORKER));
+	if (!drive->workers)
+		return FALSE;
+	drive->workerCount = count;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		DRIVE_WORKER* worker = &drive->workers[x];
+		worker->drive = drive;
+		worker->pending = ArrayList_New(FALSE);
+		worker->IrpQueue = MessageQueue_New(nullptr);
+
+		if (!worker->pending || !worker->IrpQueue)
+		{
+			WLog_ERR(TAG, "MessageQueue_New failed!");
+			return FALSE;
+		}
+
+		wObject* obj = MessageQueue_Object(worker->IrpQueue);
+		WINPR_ASSERT(obj);
+		obj->fnObjectFree = drive_message_free;
+
+		if (!(worker->thread = CreateThread(nullptr, 0, drive_thread_func, worker,
+		                                    CREATE_SUSPENDED, nullptr)))
+		{
+			WLog_ERR(TAG, "CreateThread failed!");
+			return FALSE;
+		}
+
+		ResumeThread(worker->thread);
+	}
+
+	WLog_DBG(TAG, "Started %" PRIuz " IRP workers", count);
+	return TRUE;
+}
+
 /**
  * Function description
  *
@@ -987,6 +1147,7 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			return CHANNEL_RC_NO_MEMORY;
 		}
 
+		InitializeCriticalSection(&drive->lock);
 		drive->device.type = RDPDR_DTYP_FILESYSTEM;
 		drive->device.IRPRequest = drive_irp_request;
 		drive->device.Free = drive_free;
@@ -1038,28 +1199,23 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 			goto out_error;
 		}
 
-		drive->files = ListDictionary_New(TRUE);
-
-		if (!drive->files)
+		drive->cache = drive_file_cache_new();
+		if (!drive->cache)
 		{
-			WLog_ERR(TAG, "ListDictionary_New failed!");
 			error = CHANNEL_RC_NO_MEMORY;
 			goto out_error;
 		}
 
-		ListDictionary_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
-		drive->IrpQueue = MessageQueue_New(nullptr);
+		drive->files = HashTable_New(TRUE);
 
-		if (!drive->IrpQueue)
+		if (!drive->files || !HashTable_SetHashFunction(drive->files, drive_file_id_hash))
 		{
-			WLog_ERR(TAG, "ListDictionary_New failed!");
+			WLog_ERR(TAG, "HashTable_New failed!");
 			error = CHANNEL_RC_NO_MEMORY;
 			goto out_error;
 		}
 
-		wObject* obj = MessageQueue_Object(drive->IrpQueue);
-		WINPR_ASSERT(obj);
-		obj->fnObjectFree = drive_message_free;
+		HashTable_ValueObject(drive->files)->fnObjectFree = drive_file_objfree;
 
 		if ((error = pEntryPoints->RegisterDevice(pEntryPoints->devman, &drive->device)))
 		{
@@ -1070,22 +1226,13 @@ static UINT drive_register_drive_path(PDEVICE_SERVICE_ENTRY_POINTS pEntryPoints,
 
 		drive->async = !freerdp_settings_get_bool(drive->rdpcontext->settings,
 		                                          FreeRDP_SynchronousStaticChannels);
-		if (drive->async)
-		{
-			if (!(drive->thread = CreateThread(nullptr, 0, drive_thread_func, drive,
-			                                   CREATE_SUSPENDED, nullptr)))
-			{
-				WLog_ERR(TAG, "CreateThread failed!");
-				goto out_error;
-			}
-
-			ResumeThread(drive->thread);
-		}
+		if (drive->async && !drive_start_workers(drive))
+			goto out_error;
 	}
 
 	return CHANNEL_RC_OK;
 out_error:
-	drive_free_int(drive);
+	(void)drive_free((DEVICE*)drive);
 	return error;
 }
 
@@ -0,0 +1,321 @@
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/thread.h>
+#include <winpr/stream.h>
+
+#include <freerdp/channels/rdpdr.h>
+
+#include "drive_file.h"
+
+typedef enum
+{
+	TEST_WRITE,
+	TEST_READ,
+	TEST_SIZE,
+	TEST_TRUNCATE,
+	TEST_FLUSH
+} TEST_OPERATION;
+
+typedef struct
+{
+	DRIVE_FILE* file;
+	TEST_OPERATION operation;
+	UINT64 offset;
+	BYTE data[32];
+	UINT32 length;
+	UINT64 size;
+	BOOL rc;
+} TEST_REQUEST;
+
+static BOOL test_query_size(DRIVE_FILE* file, UINT64* size)
+{
+	BOOL rc = FALSE;
+	wStream* s = Stream_New(nullptr, 64);
+	if (!s)
+		return FALSE;
+
+	if (!drive_file_query_information(file, FileStandardInformation, s))
+		goto fail;
+
+	Stream_SealLength(s);
+	Stream_SetPosition(s, 0);
+	if (!Stream_CheckAndLogRequiredLength(TAG, s, 20))
+		goto fail;
+
+	Stream_Seek(s, 4 + 8); /* Length, AllocationSize */
+	Stream_Read_UINT64(s, *size);
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	return rc;
+}
+
+static BOOL test_truncate(DRIVE_FILE* file, UINT64 size)
+{
+	BYTE buffer[8] = WINPR_C_ARRAY_INIT;
+	wStream sbuffer = WINPR_C_ARRAY_INIT;
+	wStream* s = Stream_StaticInit(&sbuffer, buffer, sizeof(buffer));
+	Stream_Write_UINT64(s, size);
+	Stream_SetPosition(s, 0);
+	return drive_file_set_information(file, FileEndOfFileInformation, sizeof(buffer), s);
+}
+
+static DWORD WINAPI test_worker(LPVOID arg)
+{
+	TEST_REQUEST* request = arg;
+	WINPR_ASSERT(request);
+
+	switch (request->operation)
+	{
+		case TEST_WRITE:
+			request->rc = drive_file_seek(request->file, request->offset) &&
+			              drive_file_write(request->file, request->data, request->length);
+			break;
+		case TEST_READ:
+			request->rc = drive_file_seek(request->file, request->offset) &&
+			              drive_file_read(request->file, request->data, &request->length);
+			break;
+		case TEST_SIZE:
+			request->rc = test_query_size(request->file, &request->size);
+			break;
+		case TEST_TRUNCATE:
+			request->rc = test_truncate(request->file, request->size);
+			break;
+		case TEST_FLUSH:
+			request->rc = drive_file_flush(request->file);
+			break;
+		default:
+			request->rc = FALSE;
+			break;
+	}
+
+	return 0;
+}
+
+/* Every handle is used from its own thread, like the drive workers do */
+static BOOL test_run(TEST_REQUEST* request)
+{
+	HANDLE thread = CreateThread(nullptr, 0, test_worker, request, 0, nullptr);
+	if (!thread)
+		return FALSE;
+
+	(void)WaitForSingleObject(thread, INFINITE);
+	(void)CloseHandle(thread);
+	return request->rc;
+}
+
+static DRIVE_FILE* test_open(DRIVE_FILE_CACHE* cache, const WCHAR* base, const WCHAR* path,
+                             UINT32 id, UINT32 disposition)
+{
+	drive_file_cache_prepare_open(cache, base, path, (UINT32)_wcslen(path));
+
+	DRIVE_FILE* file = drive_file_new(base, path, (UINT32)_wcslen(path), id,
+	                                  GENERIC_READ | GENERIC_WRITE, disposition, 0,
+	                                  FILE_ATTRIBUTE_NORMAL, FILE_SHARE_READ);
+	if (!file)
+		return nullptr;
+
+	if (!drive_file_enable_buffering(file, cache))
+	{
+		(void)drive_file_free(file);
+		return nullptr;
+	}
+	return file;
+}
+
+static BOOL test_two_handles(const WCHAR* base, const WCHAR* path)
+{
+	BOOL rc = FALSE;
+	DRIVE_FILE* a = nullptr;
+	DRIVE_FILE* b = nullptr;
+	DRIVE_FILE_CACHE* cache = drive_file_cache_new();
+	if (!cache)
+		return FALSE;
+
+	a = test_open(cache, base, path, 1, FILE_OVERWRITE_IF);
+	b = test_open(cache, base, path, 2, FILE_OPEN);
+	if (!a || !b)
+		goto fail;
+
+	{
+		TEST_REQUEST write = { .file = a, .operation = TEST_WRITE, .length = 10 };
+		memcpy(write.data, "0123456789", write.length);
+		if (!test_run(&write))
+			goto fail;
+
+		/* The data must still be buffered, otherwise this test checks nothing */
+		if (!a->bufferDirty)
+		{
+			(void)fprintf(stderr, "write-behind is not active\n");
+			goto fail;
+		}
+	}
+
+	{
+		TEST_REQUEST read = { .file = b, .operation = TEST_READ, .length = 10 };
+		if (!test_run(&read) || (read.length != 10) || (memcmp(read.data, "0123456789", 10) != 0))
+		{
+			(void)fprintf(stderr, "second handle does not see buffered data\n");
+			goto fail;
+		}
+
+		TEST_REQUEST size = { .file = b, .operation = TEST_SIZE };
+		if (!test_run(&size) || (size.size != 10))
+		{
+			(void)fprintf(stderr, "second handle reports size %" PRIu64 "\n", size.size);
+			goto fail;
+		}
+	}
+
+	{
+		/* A truncate must not be undone by the deferred flush of the other handle */
+		TEST_REQUEST write = { .file = a, .operation = TEST_WRITE, .offset = 10, .length = 6 };
+		memcpy(write.data, "abcdef", write.length);
+		TEST_REQUEST truncate = { .file = b, .operation = TEST_TRUNCATE, .size = 4 };
+		TEST_REQUEST flush = { .file = a, .operation = TEST_FLUSH };
+		TEST_REQUEST size = { .file = b, .operation = TEST_SIZE };
+
+		if (!test_run(&write) || !test_run(&truncate) || !test_run(&flush) || !test_run(&size))
+			goto fail;
+
+		if (size.size != 4)
+		{
+			(void)fprintf(stderr, "size after truncate is %" PRIu64 "\n", size.size);
+			goto fail;
+		}
+	}
+
+	{
+		TEST_REQUEST read = { .file = a, .operation = TEST_READ, .length = 10 };
+		if (!test_run(&read) || (read.length != 4) || (memcmp(read.data, "0123", 4) != 0))
+		{
+			(void)fprintf(stderr, "first handle reads stale data\n");
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	(void)drive_file_free(a);
+	(void)drive_file_free(b);
+	drive_file_cache_free(cache);
+	return rc;
+}
+
+/* Writes to one file keep the read-ahead of another and its pending data, like a copy does */
+static BOOL test_copy(const WCHAR* base, const WCHAR* src, const WCHAR* dst)
+{
+	BOOL rc = FALSE;
+	DRIVE_FILE* a = nullptr;
+	DRIVE_FILE* b = nullptr;
+	DRIVE_FILE* c = nullptr;
+	DRIVE_FILE_CACHE* cache = drive_file_cache_new();
+	if (!cache)
+		return FALSE;
+
+	a = test_open(cache, base, src, 1, FILE_OVERWRITE_IF);
+	if (!a)
+		goto fail;
+
+	{
+		TEST_REQUEST write = { .file = a, .operation = TEST_WRITE, .length = 32 };
+		memset(write.data, 'x', write.length);
+		TEST_REQUEST flush = { .file = a, .operation = TEST_FLUSH };
+		if (!test_run(&write) || !test_run(&flush))
+			goto fail;
+	}
+
+	b = test_open(cache, base, dst, 2, FILE_OVERWRITE_IF);
+	if (!b)
+		goto fail;
+
+	for (UINT64 offset = 0; offset < 32; offset += 8)
+	{
+		TEST_REQUEST read = { .file = a, .operation = TEST_READ, .offset = offset, .length = 8 };
+		if (!test_run(&read) || (read.length != 8))
+			goto fail;
+
+		TEST_REQUEST write = { .file = b, .operation = TEST_WRITE, .offset = offset, .length = 8 };
+		memcpy(write.data, read.data, write.length);
+		if (!test_run(&write))
+			goto fail;
+
+		if ((a->bufferOffset != 0) || !b->bufferDirty)
+		{
+			(void)fprintf(stderr, "read-ahead of the source was refilled at %" PRIu64 "\n",
+			              a->bufferOffset);
+			goto fail;
+		}
+	}
+
+	/* Opening another file must not write back the destination */
+	c = test_open(cache, base, src, 3, FILE_OPEN);
+	if (!c || !b->bufferDirty)
+	{
+		(void)fprintf(stderr, "open wrote back data of another file\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	(void)drive_file_free(a);
+	(void)drive_file_free(b);
+	(void)drive_file_free(c);
+	drive_file_cache_free(cache);
+	return rc;
+}
+
+int TestDriveFile(int argc, char* argv[])
+{
+	int result = -1;
+	char name[64] = WINPR_C_ARRAY_INIT;
+	char copy[64] = WINPR_C_ARRAY_INIT;
+	char* tmp = nullptr;
+	WCHAR* base = nullptr;
+	WCHAR* path = nullptr;
+	WCHAR* copypath = nullptr;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	tmp = GetKnownPath(KNOWN_PATH_TEMP);
+	if (!tmp)
+		goto fail;
+
+	(void)_snprintf(name, sizeof(name), "\\TestDriveFile_%" PRIu32 ".txt",
+	                GetCurrentProcessId());
+	(void)_snprintf(copy, sizeof(copy), "\\TestDriveFile_%" PRIu32 ".copy",
+	                GetCurrentProcessId());
+	base = ConvertUtf8ToWCharAlloc(tmp, nullptr);
+	path = ConvertUtf8ToWCharAlloc(name, nullptr);
+	copypath = ConvertUtf8ToWCharAlloc(copy, nullptr);
+	if (!base || !path || !copypath)
+		goto fail;
+
+	if (!test_two_handles(base, path))
+		goto fail;
+
+	if (!test_copy(base, path, copypath))
+		goto fail;
+
+	result = 0;
+fail:
+	if (tmp)
+	{
+		char* file = GetCombinedPath(tmp, &name[1]);
+		if (file)
+			winpr_DeleteFile(file);
+		free(file);
+
+		file = GetCombinedPath(tmp, &copy[1]);
+		if (file)
+			winpr_DeleteFile(file);
+		free(file);
+	}
+	free(tmp);
+	free(base);
+	free(path);
+	free(copypath);
+	return result;
+}
@@ -110,6 +110,84 @@ static UINT evict_cache_slots(RdpgfxClientContext* context, UINT16 MaxCacheSlots
 	return error;
 }
 
+static void rdpgfx_drop_cache_import(RDPGFX_PLUGIN* gfx, UINT16 cacheSlot)
+{
+	WINPR_ASSERT(gfx);
+
+	if ((cacheSlot > 0) && (cacheSlot <= ARRAYSIZE(gfx->CacheImports)))
+		gfx->CacheImports[cacheSlot - 1] = 0;
+}
+
+static void rdpgfx_close_persistent_cache(RDPGFX_PLUGIN* gfx)
+{
+	WINPR_ASSERT(gfx);
+
+	ZeroMemory(gfx->CacheImports, sizeof(gfx->CacheImports));
+	persistent_cache_free(gfx->persistent);
+	gfx->persistent = nullptr;
+}
+
+/**
+ * Function description
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_open_persistent_cache(RDPGFX_PLUGIN* gfx, const char* filename)
+{
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT(filename);
+
+	if (gfx->persistent)
+		return CHANNEL_RC_OK;
+
+	gfx->persistent = persistent_cache_new();
+
+	if (!gfx->persistent)
+		return CHANNEL_RC_NO_MEMORY;
+
+	if (persistent_cache_open(gfx->persistent, filename, FALSE, 3) < 1)
+	{
+		rdpgfx_close_persistent_cache(gfx);
+		return CHANNEL_RC_INITIALIZATION_ERROR;
+	}
+
+	if (persistent_cache_get_version(gfx->persistent) != 3)
+	{
+		rdpgfx_close_persistent_cache(gfx);
+		return ERROR_INVALID_DATA;
+	}
+
+	return CHANNEL_RC_OK;
+}
+
+/**
+ * Import a persistent cache entry the server accepted into its slot. This is deferred until the
+ * slot is first used, the bitmap data is referenced straight from the cache file mapping.
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_import_cache_slot(RDPGFX_PLUGIN* gfx, UINT16 cacheSlot)
+{
+	PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+
+	WINPR_ASSERT(gfx);
+	WINPR_ASSERT((cacheSlot > 0) && (cacheSlot <= ARRAYSIZE(gfx->CacheImports)));
+
+	RdpgfxClientContext* context = gfx->context;
+	const UINT16 import = gfx->CacheImports[cacheSlot - 1];
+
+	/* clear first, importing evicts the slot which looks it up again */
+	gfx->CacheImports[cacheSlot - 1] = 0;
+
+	if ((import == 0) || !gfx->persistent || !context || !context->ImportCacheEntry)
+		return CHANNEL_RC_OK;
+
+	if (persistent_cache_get_entry(gfx->persistent, import - 1u, &entry) < 1)
+		return ERROR_INVALID_DATA;
+
+	return context->ImportCacheEntry(context, cacheSlot, &entry);
+}
+
 /**
  * Function description
  *
@@ -351,10 +429,6 @@ static UINT rdpgfx_send_supported_caps(GENERIC_CHANNEL_CALLBACK* callback)
 			capsSet->flags = caps10Flags;
 		}
 
-		/* The following capabilities expect support for image scaling.
-		 * Disable these for builds that do not have support for that.
-		 */
-#if defined(WITH_CAIRO) || defined(WITH_SWSCALE)
 		if (!rdpgfx_is_capability_filtered(gfx, RDPGFX_CAPVERSION_105))
 		{
 			RDPGFX_CAPSET* capsSet = nextCapset(&pdu, ARRAYSIZE(capsSets));
@@ -384,7 +458,6 @@ static UINT rdpgfx_send_supported_caps(GENERIC_CHANNEL_CALLBACK* callback)
 			capsSet->length = 0x4;
 			capsSet->flags = caps10Flags;
 		}
-#endif
 
 		if (!rdpgfx_is_capability_filtered(gfx, RDPGFX_CAPVERSION_107))
 		{
@@ -394,9 +467,6 @@ static UINT rdpgfx_send_supported_caps(GENERIC_CHANNEL_CALLBACK* callback)
 			capsSet->version = RDPGFX_CAPVERSION_107;
 			capsSet->length = 0x4;
 			capsSet->flags = caps10Flags;
-#if !defined(WITH_CAIRO) && !defined(WITH_SWSCALE)
-			capsSet->flags |= RDPGFX_CAPS_FLAG_SCALEDMAP_DISABLE;
-#endif
 		}
 	}
 
@@ -416,10 +486,6 @@ static UINT rdpgfx_send_supported_caps(GENERIC_CHANNEL_CALLBACK* callback)
 			    freerdp_settings_get_uint32(gfx->rdpcontext->settings, FreeRDP_GfxCodecAV1Profile);
 			if (profile == 0)
 				capsSet->flags |= RDPGFX_CAPS_FLAG_AV1_I444_DISABLED;
-
-#if !defined(WITH_CAIRO) && !defined(WITH_SWSCALE)
-			capsSet->flags |= RDPGFX_CAPS_FLAG_SCALEDMAP_DISABLE;
-#endif
 		}
 	}
 #endif
@@ -675,6 +741,7 @@ static UINT rdpgfx_recv_evict_cache_entry_pdu(GENERIC_CHANNEL_CALLBACK* callback
 	Stream_Read_UINT16(s, pdu.cacheSlot); /* cacheSlot (2 bytes) */
 	WLog_Print(gfx->base.log, WLOG_DEBUG, "RecvEvictCacheEntryPdu: cacheSlot: %" PRIu16 "",
 	           pdu.cacheSlot);
+	rdpgfx_drop_cache_import(gfx, pdu.cacheSlot);
 
 	if (context)
 	{
@@ -729,19 +796,27 @@ static UINT rdpgfx_save_persistent_cache(RDPGFX_PLUGIN* gfx)
 
 	for (UINT16 idx = 0; idx < gfx->MaxCacheSlots; idx++)
 	{
-		if (gfx->CacheSlots[idx])
-		{
-			const UINT16 cacheSlot = idx;
-			PERSISTENT_CACHE_ENTRY cacheEntry = WINPR_C_ARRAY_INIT;
+		/* Microsoft uses 1-based indexing for the egfx bitmap cache ! */
+		const UINT16 cacheSlot = idx + 1;
+		PERSISTENT_CACHE_ENTRY cacheEntry = WINPR_C_ARRAY_INIT;
+		const UINT16 import = gfx->CacheImports[idx];
 
-			if (context->ExportCacheEntry(context, cacheSlot, &cacheEntry) != CHANNEL_RC_OK)
+		/* entries never used this session are copied over without importing them */
+		if ((import != 0) && gfx->persistent)
+		{
+			if (persistent_cache_get_entry(gfx->persistent, import - 1u, &cacheEntry) < 1)
 				continue;
-
-			if (persistent_cache_write_entry(persistent, &cacheEntry) < 0)
-				goto fail;
 		}
+		else if (!gfx->CacheSlots[idx] ||
+		         (context->ExportCacheEntry(context, cacheSlot, &cacheEntry) != CHANNEL_RC_OK))
+			continue;
+
+		if (persistent_cache_write_entry(persistent, &cacheEntry) < 0)
+			goto fail;
 	}
 
+	/* release the mapping of the current file before it is replaced */
+	rdpgfx_close_persistent_cache(gfx);
 	persistent_cache_free(persistent);
 
 	return error;
@@ -826,7 +901,6 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 {
 	int count = 0;
 	UINT error = CHANNEL_RC_OK;
-	PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
 	RDPGFX_CACHE_IMPORT_OFFER_PDU* offer = nullptr;
 
 	WINPR_ASSERT(gfx);
@@ -843,24 +917,12 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 	if (!BitmapCachePersistFile)
 		return CHANNEL_RC_OK;
 
-	rdpPersistentCache* persistent = persistent_cache_new();
-
-	if (!persistent)
-		return CHANNEL_RC_NO_MEMORY;
-
-	if (persistent_cache_open(persistent, BitmapCachePersistFile, FALSE, 3) < 1)
-	{
-		error = CHANNEL_RC_INITIALIZATION_ERROR;
-		goto fail;
-	}
-
-	if (persistent_cache_get_version(persistent) != 3)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
+	/* the cache stays open, imported entries are loaded from it on first use */
+	error = rdpgfx_open_persistent_cache(gfx, BitmapCachePersistFile);
+	if (error != CHANNEL_RC_OK)
+		return error;
 
-	count = persistent_cache_get_count(persistent);
+	count = persistent_cache_get_count(gfx->persistent);
 	if (count < 0)
 	{
 		error = ERROR_INVALID_DATA;
@@ -885,9 +947,12 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 
 	WLog_Print(gfx->base.log, WLOG_DEBUG, "Sending Cache Import Offer: %d", count);
 
+	/* the offer only needs the index, no bitmap data is read */
 	for (int idx = 0; idx < count; idx++)
 	{
-		if (persistent_cache_read_entry(persistent, &entry) < 1)
+		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+
+		if (persistent_cache_get_entry_info(gfx->persistent, (size_t)idx, &entry) < 1)
 		{
 			error = ERROR_INVALID_DATA;
 			goto fail;
@@ -907,8 +972,11 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 		}
 	}
 
+	free(offer);
+	return error;
+
 fail:
-	persistent_cache_free(persistent);
+	rdpgfx_close_persistent_cache(gfx);
 	free(offer);
 	return error;
 }
@@ -921,8 +989,6 @@ fail:
 static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
                                            const RDPGFX_CACHE_IMPORT_REPLY_PDU* reply)
 {
-	UINT error = CHANNEL_RC_OK;
-	rdpPersistentCache* persistent = nullptr;
 	WINPR_ASSERT(gfx);
 	WINPR_ASSERT(gfx->rdpcontext);
 	rdpSettings* settings = gfx->rdpcontext->settings;
@@ -938,53 +1004,31 @@ static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
 	if (!BitmapCachePersistFile)
 		return CHANNEL_RC_OK;
 
-	persistent = persistent_cache_new();
-
-	if (!persistent)
-		return CHANNEL_RC_NO_MEMORY;
-
-	if (persistent_cache_open(persistent, BitmapCachePersistFile, FALSE, 3) < 1)
-	{
-		error = CHANNEL_RC_INITIALIZATION_ERROR;
-		goto fail;
-	}
+	if (!context || !context->ImportCacheEntry)
+		return CHANNEL_RC_OK;
 
-	if (persistent_cache_get_version(persistent) != 3)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
+	const UINT error = rdpgfx_open_persistent_cache(gfx, BitmapCachePersistFile);
+	if (error != CHANNEL_RC_OK)
+		return error;
 
-	int count = persistent_cache_get_count(persistent);
+	int count = persistent_cache_get_count(gfx->persistent);
 
 	count = (count < reply->importedEntriesCount) ? count : reply->importedEntriesCount;
 
 	WLog_Print(gfx->base.log, WLOG_DEBUG, "Receiving Cache Import Reply: %d", count);
 
+	/* only remember which entry belongs to which slot, the bitmap is imported on first use */
 	for (int idx = 0; idx < count; idx++)
 	{
-		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
-		if (persistent_cache_read_entry(persistent, &entry) < 1)
-		{
-			error = ERROR_INVALID_DATA;
-			goto fail;
-		}
-
 		const UINT16 cacheSlot = reply->cacheSlots[idx];
-		if (context && context->ImportCacheEntry)
-		{
-			error = context->ImportCacheEntry(context, cacheSlot, &entry);
-			if (error != CHANNEL_RC_OK)
-				break;
-		}
-	}
 
-	persistent_cache_free(persistent);
+		if ((cacheSlot == 0) || (cacheSlot > gfx->MaxCacheSlots))
+			continue;
 
-	return error;
-fail:
-	persistent_cache_free(persistent);
-	return error;
+		gfx->CacheImports[cacheSlot - 1] = (UINT16)(idx + 1);
+	}
+
+	return CHANNEL_RC_OK;
 }
 
 /**
@@ -1022,24 +1066,25 @@ static UINT rdpgfx_recv_cache_import_reply_pdu(GENERIC_CHANNEL_CALLBACK* callbac
 	           "RecvCacheImportReplyPdu: importedEntriesCount: %" PRIu16 "",
 	           pdu.importedEntriesCount);
 
-	error = rdpgfx_load_cache_import_reply(gfx, &pdu);
-
-	if (error)
-	{
-		WLog_Print(gfx->base.log, WLOG_ERROR,
-		           "rdpgfx_load_cache_import_reply failed with error %" PRIu32 "", error);
-		return error;
-	}
-
+	/* let the client set up the slots first, imports are then deferred to the first use */
 	if (context)
 	{
 		IFCALLRET(context->CacheImportReply, error, context, &pdu);
 
 		if (error)
+		{
 			WLog_Print(gfx->base.log, WLOG_ERROR,
 			           "context->CacheImportReply failed with error %" PRIu32 "", error);
+			return error;
+		}
 	}
 
+	error = rdpgfx_load_cache_import_reply(gfx, &pdu);
+
+	if (error)
+		WLog_Print(gfx->base.log, WLOG_ERROR,
+		           "rdpgfx_load_cache_import_reply failed with error %" PRIu32 "", error);
+
 	return error;
 }
 
@@ -1639,6 +1684,8 @@ static UINT rdpgfx_recv_surface_to_cache_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	           pdu.surfaceId, pdu.cacheKey, pdu.cacheSlot, pdu.rectSrc.left, pdu.rectSrc.top,
 	           pdu.rectSrc.right, pdu.rectSrc.bottom);
 
+	rdpgfx_drop_cache_import(gfx, pdu.cacheSlot);
+
 	if (context)
 	{
 		IFCALLRET(context->SurfaceToCache, error, context, &pdu);
@@ -2187,6 +2234,7 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 		           "rdpgfx_save_persistent_cache failed with error %" PRIu32 "", error);
 	}
 
+	rdpgfx_close_persistent_cache(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	error = evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
 	if (error)
@@ -2319,6 +2367,7 @@ static UINT rdpgfx_set_cache_slot_data(RdpgfxClientContext* context, UINT16 cach
 		return ERROR_INVALID_INDEX;
 	}
 
+	gfx->CacheImports[cacheSlot - 1] = 0;
 	gfx->CacheSlots[cacheSlot - 1] = pData;
 	return CHANNEL_RC_OK;
 }
@@ -2337,6 +2386,15 @@ static void* rdpgfx_get_cache_slot_data(RdpgfxClientContext* context, UINT16 cac
 		return nullptr;
 	}
 
+	if (gfx->CacheImports[cacheSlot - 1] != 0)
+	{
+		const UINT rc = rdpgfx_import_cache_slot(gfx, cacheSlot);
+		if (rc != CHANNEL_RC_OK)
+			WLog_Print(gfx->base.log, WLOG_WARN,
+			           "importing cache slot %" PRIu16 " failed with error %" PRIu32, cacheSlot,
+			           rc);
+	}
+
 	return gfx->CacheSlots[cacheSlot - 1];
 }
 
@@ -2402,6 +2460,7 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 
 	RDPGFX_PLUGIN* gfx = (RDPGFX_PLUGIN*)context->handle;
 
+	rdpgfx_close_persistent_cache(gfx);
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
 
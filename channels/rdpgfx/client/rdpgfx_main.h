@@ -49,6 +49,7 @@ typedef struct
 
 	UINT16 MaxCacheSlots;
 	void* CacheSlots[25600];
+	UINT16 CacheImports[25600]; /* 1-based persistent cache entry not yet imported to a slot */
 	rdpPersistentCache* persistent;
 
 	rdpContext* rdpcontext;
@@ -52,6 +52,10 @@
 #include <X11/extensions/Xinerama.h>
 #endif
 
+#ifdef WITH_XSHM
+#include <X11/extensions/XShm.h>
+#endif
+
 #include <X11/XKBlib.h>
 
 #include <errno.h>
@@ -168,6 +172,7 @@ static int (*def_error_handler)(Display*, XErrorEvent*);
 static int xf_error_handler_ex(Display* d, XErrorEvent* ev);
 static void xf_check_extensions(xfContext* context);
 static BOOL xf_get_pixmap_info(xfContext* xfc);
+static void xf_destroy_image(xfContext* xfc);
 
 #ifdef WITH_XRENDER
 static void xf_draw_screen_scaled(xfContext* xfc, int x, int y, int w, int h)
@@ -403,6 +408,21 @@ static BOOL xf_desktop_resize(rdpContext* context)
 	return TRUE;
 }
 
+static void xf_put_primary(xfContext* xfc, const GDI_RGN* region)
+{
+	const UINT16 width = WINPR_ASSERTING_INT_CAST(UINT16, region->w);
+	const UINT16 height = WINPR_ASSERTING_INT_CAST(UINT16, region->h);
+
+#ifdef WITH_XSHM
+	if (xfc->shmImage && xf_shm_image_put(xfc, xfc->shmImage, xfc->primary, xfc->gc, region->x,
+	                                      region->y, width, height))
+		return;
+#endif
+
+	LogDynAndXPutImage(xfc->log, xfc->display, xfc->primary, xfc->gc, xfc->image, region->x,
+	                   region->y, region->x, region->y, width, height);
+}
+
 static BOOL xf_paint(xfContext* xfc, const GDI_RGN* region)
 {
 	WINPR_ASSERT(xfc);
@@ -420,15 +440,30 @@ static BOOL xf_paint(xfContext* xfc, const GDI_RGN* region)
 	}
 	else
 	{
-		LogDynAndXPutImage(xfc->log, xfc->display, xfc->primary, xfc->gc, xfc->image, region->x,
-		                   region->y, region->x, region->y,
-		                   WINPR_ASSERTING_INT_CAST(UINT16, region->w),
-		                   WINPR_ASSERTING_INT_CAST(UINT16, region->h));
+		xf_put_primary(xfc, region);
 		xf_draw_screen(xfc, region->x, region->y, region->w, region->h);
 	}
 	return TRUE;
 }
 
+/* With MIT-SHM the server reads the gdi primary buffer in place. Before gdi draws the next
+ * frame into it, wait until the server is done with the previous one. */
+static BOOL xf_begin_paint(rdpContext* context)
+{
+	xfContext* xfc = (xfContext*)context;
+	WINPR_ASSERT(xfc);
+
+#ifdef WITH_XSHM
+	if (xfc->shmImage)
+	{
+		xf_lock_x11(xfc);
+		xf_shm_image_wait(xfc, xfc->shmImage);
+		xf_unlock_x11(xfc);
+	}
+#endif
+	return TRUE;
+}
+
 static BOOL xf_end_paint(rdpContext* context)
 {
 	xfContext* xfc = (xfContext*)context;
@@ -481,6 +516,95 @@ static BOOL xf_end_paint(rdpContext* context)
 	return TRUE;
 }
 
+#ifdef WITH_XSHM
+/* A shared memory image whose segment doubles as the gdi primary buffer */
+static xfShmImage* xf_create_shm_image(xfContext* xfc, UINT32 format, UINT32 width,
+                                       UINT32 height)
+{
+	xfShmImage* shm = xf_shm_image_new(xfc, width, height);
+	if (!shm)
+		return nullptr;
+
+	const XImage* image = xf_shm_image_get(shm);
+	if (image->bits_per_pixel != WINPR_ASSERTING_INT_CAST(int, FreeRDPGetBitsPerPixel(format)))
+	{
+		WLog_Print(xfc->log, WLOG_DEBUG, "MIT-SHM image has %d bpp, %s required",
+		           image->bits_per_pixel, FreeRDPGetColorFormatName(format));
+		xf_shm_image_free(xfc, shm);
+		return nullptr;
+	}
+
+	return shm;
+}
+#endif
+
+static BOOL xf_gdi_init(xfContext* xfc, UINT32 format)
+{
+	WINPR_ASSERT(xfc);
+
+	freerdp* instance = xfc->common.context.instance;
+
+#ifdef WITH_XSHM
+	const rdpSettings* settings = xfc->common.context.settings;
+	const UINT32 width = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+	const UINT32 height = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+
+	xfc->shmImage = xf_create_shm_image(xfc, format, width, height);
+	if (xfc->shmImage)
+	{
+		const XImage* image = xf_shm_image_get(xfc->shmImage);
+		const UINT32 stride = WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line);
+		return gdi_init_ex(instance, format, stride, (BYTE*)image->data, nullptr);
+	}
+
+	WLog_Print(xfc->log, WLOG_DEBUG, "MIT-SHM not available, using XPutImage");
+#endif
+
+	return gdi_init(instance, format);
+}
+
+static BOOL xf_resize_primary(xfContext* xfc, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(xfc);
+
+	rdpGdi* gdi = xfc->common.context.gdi;
+	WINPR_ASSERT(gdi);
+
+#ifdef WITH_XSHM
+	if (xfc->shmImage)
+	{
+		if ((gdi->width == WINPR_ASSERTING_INT_CAST(INT32, width)) &&
+		    (gdi->height == WINPR_ASSERTING_INT_CAST(INT32, height)))
+			return TRUE;
+
+		/* Keep the old segment until gdi switched buffers, fall back to XPutImage on failure */
+		BOOL rc = FALSE;
+		xfShmImage* shm = xf_create_shm_image(xfc, gdi->dstFormat, width, height);
+		if (shm)
+		{
+			const XImage* image = xf_shm_image_get(shm);
+			rc = gdi_resize_ex(gdi, width, height,
+			                   WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), 0,
+			                   (BYTE*)image->data, nullptr);
+		}
+		else
+			rc = gdi_resize(gdi, width, height);
+
+		if (!rc)
+		{
+			xf_shm_image_free(xfc, shm);
+			return FALSE;
+		}
+
+		xf_shm_image_free(xfc, xfc->shmImage);
+		xfc->shmImage = shm;
+		return TRUE;
+	}
+#endif
+
+	return gdi_resize(gdi, width, height);
+}
+
 static BOOL xf_sw_desktop_resize(rdpContext* context)
 {
 	WINPR_ASSERT(context);
@@ -501,29 +625,15 @@ static BOOL xf_sw_desktop_resize(rdpContext* context)
 	gdi->suppressOutput = TRUE;
 
 	xf_lock_x11(xfc);
-	if (!gdi_resize(gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
-	                freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight)))
-		goto out;
+	xf_destroy_image(xfc);
 
-	if (xfc->image)
-	{
-		xfc->image->data = nullptr;
-		XDestroyImage(xfc->image);
-	}
+	if (!xf_resize_primary(xfc, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+	                       freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight)))
+		goto out;
 
-	WINPR_ASSERT(xfc->depth != 0);
-	if (!(xfc->image = LogDynAndXCreateImage(
-	          xfc->log, xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth),
-	          ZPixmap, 0, (char*)gdi->primary_buffer,
-	          WINPR_ASSERTING_INT_CAST(uint32_t, gdi->width),
-	          WINPR_ASSERTING_INT_CAST(uint32_t, gdi->height), xfc->scanline_pad,
-	          WINPR_ASSERTING_INT_CAST(int, gdi->stride))))
-	{
+	if (!xf_create_image(xfc))
 		goto out;
-	}
 
-	xfc->image->byte_order = LSBFirst;
-	xfc->image->bitmap_bit_order = LSBFirst;
 	ret = xf_desktop_resize(context);
 out:
 	xf_unlock_x11(xfc);
@@ -747,6 +857,14 @@ BOOL xf_create_image(xfContext* xfc)
 	WINPR_ASSERT(xfc);
 	if (!xfc->image)
 	{
+#ifdef WITH_XSHM
+		if (xfc->shmImage)
+		{
+			xfc->image = xf_shm_image_get(xfc->shmImage);
+			return TRUE;
+		}
+#endif
+
 		const rdpSettings* settings = xfc->common.context.settings;
 		rdpGdi* cgdi = xfc->common.context.gdi;
 		WINPR_ASSERT(cgdi);
@@ -758,12 +876,32 @@ BOOL xf_create_image(xfContext* xfc)
 		    freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
 		    freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight), xfc->scanline_pad,
 		    WINPR_ASSERTING_INT_CAST(int, cgdi->stride));
+		if (!xfc->image)
+			return FALSE;
 		xfc->image->byte_order = LSBFirst;
 		xfc->image->bitmap_bit_order = LSBFirst;
 	}
 	return TRUE;
 }
 
+static void xf_destroy_image(xfContext* xfc)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!xfc->image)
+		return;
+
+#ifdef WITH_XSHM
+	/* The shared memory image backs the gdi primary buffer, it is released with it */
+	if (!xfc->shmImage)
+#endif
+	{
+		xfc->image->data = nullptr;
+		XDestroyImage(xfc->image);
+	}
+	xfc->image = nullptr;
+}
+
 void xf_destroy_window(xfContext* xfc)
 {
 	if (xfc->window)
@@ -780,12 +918,7 @@ void xf_destroy_window(xfContext* xfc)
 	}
 #endif
 
-	if (xfc->image)
-	{
-		xfc->image->data = nullptr;
-		XDestroyImage(xfc->image);
-		xfc->image = nullptr;
-	}
+	xf_destroy_image(xfc);
 
 	if (xfc->bitmap_mono)
 	{
@@ -970,6 +1103,14 @@ static void xf_check_extensions(xfContext* context)
 		}
 	}
 #endif
+
+#ifdef WITH_XSHM
+	if (XShmQueryExtension(context->display))
+	{
+		context->shmAvailable = TRUE;
+		context->shmCompletionType = XShmGetEventBase(context->display) + ShmCompletion;
+	}
+#endif
 }
 
 #ifdef WITH_XI
@@ -1419,7 +1560,7 @@ static BOOL xf_post_connect(freerdp* instance)
 	if (!xf_get_pixmap_info(xfc))
 		return FALSE;
 
-	if (!gdi_init(instance, xf_get_local_color_format(xfc, TRUE)))
+	if (!xf_gdi_init(xfc, xf_get_local_color_format(xfc, TRUE)))
 		return FALSE;
 
 	if (!xf_create_image(xfc))
@@ -1455,6 +1596,7 @@ static BOOL xf_post_connect(freerdp* instance)
 	}
 
 	update->DesktopResize = xf_sw_desktop_resize;
+	update->BeginPaint = xf_begin_paint;
 	update->EndPaint = xf_end_paint;
 	update->PlaySound = xf_play_sound;
 	update->SetKeyboardIndicators = xf_keyboard_set_indicators;
@@ -1528,6 +1670,11 @@ static void xf_post_disconnect(freerdp* instance)
 	xfc->remap_table = nullptr;
 
 	xf_destroy_window(xfc);
+
+#ifdef WITH_XSHM
+	xf_shm_image_free(xfc, xfc->shmImage);
+	xfc->shmImage = nullptr;
+#endif
 }
 
 static void xf_post_final_disconnect(freerdp* instance)
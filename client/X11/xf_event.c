@@ -1335,6 +1335,10 @@ BOOL xf_event_process(freerdp* instance, const XEvent* event)
 			break;
 
 		default:
+#if defined(WITH_XSHM)
+			if (xf_shm_image_handle_xevent(xfc, xfc->shmImage, event))
+				break;
+#endif
 			if (freerdp_settings_get_bool(settings, FreeRDP_SupportDisplayControl))
 				xf_disp_handle_xevent(xfc, event);
 
@@ -0,0 +1,241 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM primary image
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <poll.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/sysinfo.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include "xfreerdp.h"
+#include "xf_shm.h"
+
+/* Upper bound for a single wait on ShmCompletion, guards against lost completions */
+#define XF_SHM_COMPLETION_TIMEOUT_MS 250
+
+struct xf_shm_image
+{
+	XShmSegmentInfo info;
+	XImage* image;
+	xfContext* xfc;
+	BOOL attached;
+	UINT32 pending;
+};
+
+static int xf_shm_attach_error = 0;
+
+static int xf_shm_error_handler(Display* display, XErrorEvent* event)
+{
+	WINPR_UNUSED(display);
+	WINPR_ASSERT(event);
+	xf_shm_attach_error = event->error_code;
+	return 0;
+}
+
+/* XShmAttach reports failure asynchronously, e.g. for a remote X server */
+static BOOL xf_shm_attach(xfContext* xfc, xfShmImage* shm)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(shm);
+
+	xf_shm_attach_error = 0;
+	XErrorHandler handler = XSetErrorHandler(xf_shm_error_handler);
+	const Status rc = XShmAttach(xfc->display, &shm->info);
+	XSync(xfc->display, False);
+	XSetErrorHandler(handler);
+
+	if (!rc || (xf_shm_attach_error != 0))
+	{
+		WLog_Print(xfc->log, WLOG_DEBUG, "XShmAttach failed with error %d", xf_shm_attach_error);
+		return FALSE;
+	}
+
+	shm->attached = TRUE;
+	return TRUE;
+}
+
+static BOOL xf_shm_is_completion(xfContext* xfc, const xfShmImage* shm, const XEvent* event)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(shm);
+	WINPR_ASSERT(event);
+
+	if (event->type != xfc->shmCompletionType)
+		return FALSE;
+
+	const XShmCompletionEvent* completion = (const XShmCompletionEvent*)event;
+	return completion->shmseg == shm->info.shmseg;
+}
+
+static Bool xf_shm_check_completion(Display* display, XEvent* event, XPointer arg)
+{
+	WINPR_UNUSED(display);
+	xfShmImage* shm = (xfShmImage*)arg;
+	WINPR_ASSERT(shm);
+	return xf_shm_is_completion(shm->xfc, shm, event) ? True : False;
+}
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* shm)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!shm)
+		return;
+
+	if (shm->attached)
+	{
+		xf_shm_image_wait(xfc, shm);
+		XShmDetach(xfc->display, &shm->info);
+		XSync(xfc->display, False);
+	}
+
+	if (shm->image)
+	{
+		/* data lives in the segment and obdata points to shm->info */
+		shm->image->data = nullptr;
+		shm->image->obdata = nullptr;
+		XDestroyImage(shm->image);
+	}
+
+	if (shm->info.shmaddr && (shm->info.shmaddr != (char*)-1))
+		shmdt(shm->info.shmaddr);
+
+	free(shm);
+}
+
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!xfc->shmAvailable)
+		return nullptr;
+
+	xfShmImage* shm = (xfShmImage*)calloc(1, sizeof(xfShmImage));
+	if (!shm)
+		return nullptr;
+
+	shm->xfc = xfc;
+	shm->info.shmid = -1;
+
+	WINPR_ASSERT(xfc->depth != 0);
+	shm->image = XShmCreateImage(xfc->display, xfc->visual,
+	                             WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, nullptr,
+	                             &shm->info, width, height);
+	if (!shm->image)
+		goto fail;
+
+	const size_t size = 1ull * WINPR_ASSERTING_INT_CAST(size_t, shm->image->bytes_per_line) *
+	                    WINPR_ASSERTING_INT_CAST(size_t, shm->image->height);
+	shm->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (shm->info.shmid < 0)
+		goto fail;
+
+	shm->info.shmaddr = shmat(shm->info.shmid, nullptr, 0);
+	if (shm->info.shmaddr == (char*)-1)
+		goto fail;
+
+	shm->info.readOnly = True;
+	shm->image->data = shm->info.shmaddr;
+	shm->image->byte_order = LSBFirst;
+	shm->image->bitmap_bit_order = LSBFirst;
+
+	if (!xf_shm_attach(xfc, shm))
+		goto fail;
+
+	/* The segment is released as soon as both sides detached */
+	shmctl(shm->info.shmid, IPC_RMID, nullptr);
+	return shm;
+
+fail:
+	if (shm->info.shmid >= 0)
+		shmctl(shm->info.shmid, IPC_RMID, nullptr);
+	xf_shm_image_free(xfc, shm);
+	return nullptr;
+}
+
+XImage* xf_shm_image_get(const xfShmImage* shm)
+{
+	WINPR_ASSERT(shm);
+	return shm->image;
+}
+
+BOOL xf_shm_image_put(xfContext* xfc, xfShmImage* shm, Drawable d, GC gc, int x, int y,
+                      UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(shm);
+
+	if (!XShmPutImage(xfc->display, d, gc, shm->image, x, y, x, y, width, height, True))
+		return FALSE;
+
+	shm->pending++;
+	return TRUE;
+}
+
+void xf_shm_image_wait(xfContext* xfc, xfShmImage* shm)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!shm || (shm->pending == 0))
+		return;
+
+	const UINT64 deadline = GetTickCount64() + XF_SHM_COMPLETION_TIMEOUT_MS;
+
+	while (shm->pending > 0)
+	{
+		XEvent event = WINPR_C_ARRAY_INIT;
+
+		if (XCheckIfEvent(xfc->display, &event, xf_shm_check_completion, (XPointer)shm))
+		{
+			shm->pending--;
+			continue;
+		}
+
+		const UINT64 now = GetTickCount64();
+		if (now >= deadline)
+		{
+			WLog_Print(xfc->log, WLOG_WARN, "Timeout waiting for %" PRIu32 " ShmCompletion events",
+			           shm->pending);
+			shm->pending = 0;
+			break;
+		}
+
+		struct pollfd pfd = { .fd = ConnectionNumber(xfc->display), .events = POLLIN };
+		(void)poll(&pfd, 1, WINPR_ASSERTING_INT_CAST(int, deadline - now));
+	}
+}
+
+BOOL xf_shm_image_handle_xevent(xfContext* xfc, xfShmImage* shm, const XEvent* event)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(event);
+
+	if (!shm || !xf_shm_is_completion(xfc, shm, event))
+		return FALSE;
+
+	if (shm->pending > 0)
+		shm->pending--;
+	return TRUE;
+}
@@ -0,0 +1,54 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM primary image
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_X11_SHM_H
+#define FREERDP_CLIENT_X11_SHM_H
+
+#include <winpr/wtypes.h>
+
+#include <X11/Xlib.h>
+
+#include "xf_types.h"
+
+typedef struct xf_shm_image xfShmImage;
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* shm);
+
+/**
+ * Create an image backed by a shared memory segment attached to the X server.
+ * Returns nullptr if MIT-SHM is unavailable or the server can not attach the segment,
+ * callers fall back to a plain XImage then.
+ */
+WINPR_ATTR_MALLOC(xf_shm_image_free, 2)
+WINPR_ATTR_NODISCARD
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height);
+
+WINPR_ATTR_NODISCARD
+XImage* xf_shm_image_get(const xfShmImage* shm);
+
+/** Copy a rectangle to a drawable, the server reads the pixels from the segment. */
+WINPR_ATTR_NODISCARD
+BOOL xf_shm_image_put(xfContext* xfc, xfShmImage* shm, Drawable d, GC gc, int x, int y,
+                      UINT32 width, UINT32 height);
+
+/** Block until the server has finished reading all outstanding puts. */
+void xf_shm_image_wait(xfContext* xfc, xfShmImage* shm);
+
+/** Consume a ShmCompletion event, returns TRUE if the event belonged to the image. */
+BOOL xf_shm_image_handle_xevent(xfContext* xfc, xfShmImage* shm, const XEvent* event);
+
+#endif /* FREERDP_CLIENT_X11_SHM_H */
@@ -30,6 +30,10 @@
 #include "xf_video.h"
 #include "xf_rail.h"
 
+#if defined(WITH_XSHM)
+#include "xf_shm.h"
+#endif
+
 #ifdef WITH_XCURSOR
 #include <X11/Xcursor/Xcursor.h>
 #endif
@@ -296,6 +300,12 @@ struct xf_context
 
 	BOOL xkbAvailable;
 	BOOL xrenderAvailable;
+	BOOL shmAvailable;
+
+#if defined(WITH_XSHM)
+	int shmCompletionType;
+	xfShmImage* shmImage;
+#endif
 
 	/* value to be sent over wire for each logical client mouse button */
 	button_map button_map[NUM_BUTTONS_MAPPED];
@@ -0,0 +1,914 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Session Replay Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Replays a session recorded with /dump:record,file:<file> through the
+ * complete client decoding path (fastpath, orders, rdpgfx, codecs and gdi) without
+ * network and display and prints the time spent per stage as JSON. */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/streamdump.h>
+#include <freerdp/log.h>
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/channels.h>
+#include <freerdp/client/rdpgfx.h>
+#include <freerdp/channels/rdpgfx.h>
+
+#define TAG CLIENT_TAG("replay-bench")
+
+#if defined(__GLIBC__)
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define REPLAY_BENCH_SANITIZER
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define REPLAY_BENCH_SANITIZER
+#endif
+#if !defined(REPLAY_BENCH_SANITIZER)
+#define REPLAY_BENCH_COUNT_ALLOCATIONS
+#endif
+#endif
+
+typedef enum
+{
+	REPLAY_STAGE_TRANSPORT,
+	REPLAY_STAGE_BITMAP,
+	REPLAY_STAGE_SURFACE_BITS,
+	REPLAY_STAGE_PRIMARY_ORDERS,
+	REPLAY_STAGE_SECONDARY_ORDERS,
+	REPLAY_STAGE_GFX_UNCOMPRESSED,
+	REPLAY_STAGE_GFX_REMOTEFX,
+	REPLAY_STAGE_GFX_CLEARCODEC,
+	REPLAY_STAGE_GFX_PLANAR,
+	REPLAY_STAGE_GFX_AVC420,
+	REPLAY_STAGE_GFX_ALPHA,
+	REPLAY_STAGE_GFX_AVC444,
+	REPLAY_STAGE_GFX_AVC444V2,
+	REPLAY_STAGE_GFX_PROGRESSIVE,
+	REPLAY_STAGE_GFX_OTHER,
+	REPLAY_STAGE_GFX_SOLIDFILL,
+	REPLAY_STAGE_GFX_CACHE,
+	REPLAY_STAGE_PRESENT,
+	REPLAY_STAGE_COUNT
+} replayBenchStage;
+
+static const char* replay_bench_stage_names[REPLAY_STAGE_COUNT] = {
+	"transport",
+	"bitmap",
+	"surface_bits",
+	"primary_orders",
+	"secondary_orders",
+	"gfx_uncompressed",
+	"gfx_remotefx",
+	"gfx_clearcodec",
+	"gfx_planar",
+	"gfx_avc420",
+	"gfx_alpha",
+	"gfx_avc444",
+	"gfx_avc444v2",
+	"gfx_progressive",
+	"gfx_other",
+	"gfx_solidfill",
+	"gfx_cache",
+	"present",
+};
+
+typedef struct
+{
+	UINT64 calls;
+	UINT64 ns;
+} replayBenchCounter;
+
+typedef struct
+{
+	rdpClientContext common;
+
+	rdpPrimaryUpdate primary;
+	rdpSecondaryUpdate secondary;
+	pBeginPaint BeginPaint;
+	pEndPaint EndPaint;
+	pBitmapUpdate BitmapUpdate;
+	pSurfaceBits SurfaceBits;
+
+	pcRdpgfxStartFrame StartFrame;
+	pcRdpgfxEndFrame EndFrame;
+	pcRdpgfxSurfaceCommand SurfaceCommand;
+	pcRdpgfxSolidFill SolidFill;
+	pcRdpgfxSurfaceToSurface SurfaceToSurface;
+	pcRdpgfxSurfaceToCache SurfaceToCache;
+	pcRdpgfxCacheToSurface CacheToSurface;
+	pcRdpgfxUpdateSurfaces UpdateSurfaces;
+
+	replayBenchCounter stages[REPLAY_STAGE_COUNT];
+	UINT64 stagesTotal;
+	size_t depth;
+	UINT64 stageStart;
+
+	UINT64 frameStart;
+	BOOL gfxFrame; /* the paints of a GFX frame belong to its sample */
+	UINT64* latencies;
+	size_t latencyCount;
+	size_t latencySize;
+} replayBenchContext;
+
+#if defined(REPLAY_BENCH_COUNT_ALLOCATIONS)
+/* Count the allocations of the whole process by replacing the glibc allocator entry points,
+ * these must stay visible to the shared libraries despite -fvisibility=hidden */
+#define REPLAY_BENCH_EXPORT __attribute__((visibility("default")))
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static UINT64 replay_bench_allocations = 0;
+static UINT64 replay_bench_allocated_bytes = 0;
+
+static inline void replay_bench_count_allocation(size_t size)
+{
+	__atomic_fetch_add(&replay_bench_allocations, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&replay_bench_allocated_bytes, size, __ATOMIC_RELAXED);
+}
+
+REPLAY_BENCH_EXPORT void* malloc(size_t size)
+{
+	replay_bench_count_allocation(size);
+	return __libc_malloc(size);
+}
+
+REPLAY_BENCH_EXPORT void* calloc(size_t nmemb, size_t size)
+{
+	replay_bench_count_allocation(nmemb * size);
+	return __libc_calloc(nmemb, size);
+}
+
+REPLAY_BENCH_EXPORT void* realloc(void* ptr, size_t size)
+{
+	replay_bench_count_allocation(size);
+	return __libc_realloc(ptr, size);
+}
+
+REPLAY_BENCH_EXPORT void free(void* ptr)
+{
+	__libc_free(ptr);
+}
+
+REPLAY_BENCH_EXPORT int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+	replay_bench_count_allocation(size);
+	void* ptr = __libc_memalign(alignment, size);
+	if (!ptr && (size > 0))
+		return ENOMEM;
+	*memptr = ptr;
+	return 0;
+}
+
+REPLAY_BENCH_EXPORT void* aligned_alloc(size_t alignment, size_t size)
+{
+	replay_bench_count_allocation(size);
+	return __libc_memalign(alignment, size);
+}
+
+REPLAY_BENCH_EXPORT void* memalign(size_t alignment, size_t size)
+{
+	replay_bench_count_allocation(size);
+	return __libc_memalign(alignment, size);
+}
+#endif
+
+static void replay_bench_enter(replayBenchContext* bench)
+{
+	WINPR_ASSERT(bench);
+	if (bench->depth++ == 0)
+		bench->stageStart = winpr_GetTickCount64NS();
+}
+
+/* Nested callbacks are accounted to the outermost stage */
+static void replay_bench_leave(replayBenchContext* bench, replayBenchStage stage)
+{
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(bench->depth > 0);
+	if (--bench->depth > 0)
+		return;
+
+	const UINT64 ns = winpr_GetTickCount64NS() - bench->stageStart;
+	bench->stages[stage].calls++;
+	bench->stages[stage].ns += ns;
+	bench->stagesTotal += ns;
+}
+
+static BOOL replay_bench_add_latency(replayBenchContext* bench, UINT64 ns)
+{
+	WINPR_ASSERT(bench);
+
+	if (bench->latencyCount >= bench->latencySize)
+	{
+		const size_t size = MAX(1024, bench->latencySize * 2);
+		UINT64* tmp = realloc(bench->latencies, size * sizeof(UINT64));
+		if (!tmp)
+			return FALSE;
+		bench->latencies = tmp;
+		bench->latencySize = size;
+	}
+
+	bench->latencies[bench->latencyCount++] = ns;
+	return TRUE;
+}
+
+#define REPLAY_BENCH_WRAP_ORDER(table, stage, name, T)                         \
+	static BOOL replay_bench_##name(rdpContext* context, T order)              \
+	{                                                                          \
+		replayBenchContext* bench = (replayBenchContext*)context;              \
+		replay_bench_enter(bench);                                             \
+		const BOOL rc = IFCALLRESULT(TRUE, bench->table.name, context, order); \
+		replay_bench_leave(bench, stage);                                      \
+		return rc;                                                             \
+	}
+
+#define REPLAY_BENCH_PRIMARY(name, T) \
+	REPLAY_BENCH_WRAP_ORDER(primary, REPLAY_STAGE_PRIMARY_ORDERS, name, T)
+#define REPLAY_BENCH_SECONDARY(name, T) \
+	REPLAY_BENCH_WRAP_ORDER(secondary, REPLAY_STAGE_SECONDARY_ORDERS, name, T)
+
+REPLAY_BENCH_PRIMARY(DstBlt, const DSTBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(PatBlt, PATBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(ScrBlt, const SCRBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(OpaqueRect, const OPAQUE_RECT_ORDER*)
+REPLAY_BENCH_PRIMARY(MultiDstBlt, const MULTI_DSTBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(MultiPatBlt, const MULTI_PATBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(MultiScrBlt, const MULTI_SCRBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(MultiOpaqueRect, const MULTI_OPAQUE_RECT_ORDER*)
+REPLAY_BENCH_PRIMARY(LineTo, const LINE_TO_ORDER*)
+REPLAY_BENCH_PRIMARY(Polyline, const POLYLINE_ORDER*)
+REPLAY_BENCH_PRIMARY(MemBlt, MEMBLT_ORDER*)
+REPLAY_BENCH_PRIMARY(Mem3Blt, MEM3BLT_ORDER*)
+REPLAY_BENCH_PRIMARY(SaveBitmap, const SAVE_BITMAP_ORDER*)
+REPLAY_BENCH_PRIMARY(GlyphIndex, GLYPH_INDEX_ORDER*)
+REPLAY_BENCH_PRIMARY(FastIndex, const FAST_INDEX_ORDER*)
+REPLAY_BENCH_PRIMARY(FastGlyph, const FAST_GLYPH_ORDER*)
+REPLAY_BENCH_PRIMARY(PolygonSC, const POLYGON_SC_ORDER*)
+REPLAY_BENCH_PRIMARY(PolygonCB, POLYGON_CB_ORDER*)
+REPLAY_BENCH_PRIMARY(EllipseSC, const ELLIPSE_SC_ORDER*)
+REPLAY_BENCH_PRIMARY(EllipseCB, const ELLIPSE_CB_ORDER*)
+
+REPLAY_BENCH_SECONDARY(CacheBitmap, const CACHE_BITMAP_ORDER*)
+REPLAY_BENCH_SECONDARY(CacheBitmapV2, CACHE_BITMAP_V2_ORDER*)
+REPLAY_BENCH_SECONDARY(CacheBitmapV3, CACHE_BITMAP_V3_ORDER*)
+REPLAY_BENCH_SECONDARY(CacheColorTable, const CACHE_COLOR_TABLE_ORDER*)
+REPLAY_BENCH_SECONDARY(CacheGlyph, const CACHE_GLYPH_ORDER*)
+REPLAY_BENCH_SECONDARY(CacheGlyphV2, const CACHE_GLYPH_V2_ORDER*)
+REPLAY_BENCH_SECONDARY(CacheBrush, const CACHE_BRUSH_ORDER*)
+
+static void replay_bench_wrap_orders(replayBenchContext* bench, rdpUpdate* update)
+{
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(update);
+
+	rdpPrimaryUpdate* primary = update->primary;
+	rdpSecondaryUpdate* secondary = update->secondary;
+	WINPR_ASSERT(primary);
+	WINPR_ASSERT(secondary);
+
+	bench->primary = *primary;
+	bench->secondary = *secondary;
+
+#define REPLAY_BENCH_SET(table, name) \
+	if (table->name)                  \
+		table->name = replay_bench_##name;
+
+	REPLAY_BENCH_SET(primary, DstBlt)
+	REPLAY_BENCH_SET(primary, PatBlt)
+	REPLAY_BENCH_SET(primary, ScrBlt)
+	REPLAY_BENCH_SET(primary, OpaqueRect)
+	REPLAY_BENCH_SET(primary, MultiDstBlt)
+	REPLAY_BENCH_SET(primary, MultiPatBlt)
+	REPLAY_BENCH_SET(primary, MultiScrBlt)
+	REPLAY_BENCH_SET(primary, MultiOpaqueRect)
+	REPLAY_BENCH_SET(primary, LineTo)
+	REPLAY_BENCH_SET(primary, Polyline)
+	REPLAY_BENCH_SET(primary, MemBlt)
+	REPLAY_BENCH_SET(primary, Mem3Blt)
+	REPLAY_BENCH_SET(primary, SaveBitmap)
+	REPLAY_BENCH_SET(primary, GlyphIndex)
+	REPLAY_BENCH_SET(primary, FastIndex)
+	REPLAY_BENCH_SET(primary, FastGlyph)
+	REPLAY_BENCH_SET(primary, PolygonSC)
+	REPLAY_BENCH_SET(primary, PolygonCB)
+	REPLAY_BENCH_SET(primary, EllipseSC)
+	REPLAY_BENCH_SET(primary, EllipseCB)
+	REPLAY_BENCH_SET(secondary, CacheBitmap)
+	REPLAY_BENCH_SET(secondary, CacheBitmapV2)
+	REPLAY_BENCH_SET(secondary, CacheBitmapV3)
+	REPLAY_BENCH_SET(secondary, CacheColorTable)
+	REPLAY_BENCH_SET(secondary, CacheGlyph)
+	REPLAY_BENCH_SET(secondary, CacheGlyphV2)
+	REPLAY_BENCH_SET(secondary, CacheBrush)
+#undef REPLAY_BENCH_SET
+}
+
+static BOOL replay_bench_begin_paint(rdpContext* context)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+	WINPR_ASSERT(bench);
+
+	if (!bench->gfxFrame)
+		bench->frameStart = winpr_GetTickCount64NS();
+	return IFCALLRESULT(TRUE, bench->BeginPaint, context);
+}
+
+static BOOL replay_bench_end_paint(rdpContext* context)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+	WINPR_ASSERT(bench);
+
+	replay_bench_enter(bench);
+	const BOOL rc = IFCALLRESULT(TRUE, bench->EndPaint, context);
+	replay_bench_leave(bench, REPLAY_STAGE_PRESENT);
+
+	if (bench->gfxFrame)
+		return rc;
+	if (!replay_bench_add_latency(bench, winpr_GetTickCount64NS() - bench->frameStart))
+		return FALSE;
+	return rc;
+}
+
+static BOOL replay_bench_bitmap_update(rdpContext* context, const BITMAP_UPDATE* bitmap)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+	WINPR_ASSERT(bench);
+
+	replay_bench_enter(bench);
+	const BOOL rc = IFCALLRESULT(TRUE, bench->BitmapUpdate, context, bitmap);
+	replay_bench_leave(bench, REPLAY_STAGE_BITMAP);
+	return rc;
+}
+
+static BOOL replay_bench_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cmd)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+	WINPR_ASSERT(bench);
+
+	replay_bench_enter(bench);
+	const BOOL rc = IFCALLRESULT(TRUE, bench->SurfaceBits, context, cmd);
+	replay_bench_leave(bench, REPLAY_STAGE_SURFACE_BITS);
+	return rc;
+}
+
+static replayBenchContext* replay_bench_from_gfx(RdpgfxClientContext* context)
+{
+	WINPR_ASSERT(context);
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+	WINPR_ASSERT(gdi);
+	return (replayBenchContext*)gdi->context;
+}
+
+static replayBenchStage replay_bench_gfx_stage(UINT32 codecId)
+{
+	switch (codecId)
+	{
+		case RDPGFX_CODECID_UNCOMPRESSED:
+			return REPLAY_STAGE_GFX_UNCOMPRESSED;
+		case RDPGFX_CODECID_CAVIDEO:
+			return REPLAY_STAGE_GFX_REMOTEFX;
+		case RDPGFX_CODECID_CLEARCODEC:
+			return REPLAY_STAGE_GFX_CLEARCODEC;
+		case RDPGFX_CODECID_PLANAR:
+			return REPLAY_STAGE_GFX_PLANAR;
+		case RDPGFX_CODECID_AVC420:
+			return REPLAY_STAGE_GFX_AVC420;
+		case RDPGFX_CODECID_ALPHA:
+			return REPLAY_STAGE_GFX_ALPHA;
+		case RDPGFX_CODECID_AVC444:
+			return REPLAY_STAGE_GFX_AVC444;
+		case RDPGFX_CODECID_AVC444v2:
+			return REPLAY_STAGE_GFX_AVC444V2;
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+			return REPLAY_STAGE_GFX_PROGRESSIVE;
+		default:
+			return REPLAY_STAGE_GFX_OTHER;
+	}
+}
+
+static UINT replay_bench_gfx_start_frame(RdpgfxClientContext* context,
+                                         const RDPGFX_START_FRAME_PDU* startFrame)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	bench->frameStart = winpr_GetTickCount64NS();
+	bench->gfxFrame = TRUE;
+	return IFCALLRESULT(CHANNEL_RC_OK, bench->StartFrame, context, startFrame);
+}
+
+static UINT replay_bench_gfx_end_frame(RdpgfxClientContext* context,
+                                       const RDPGFX_END_FRAME_PDU* endFrame)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->EndFrame, context, endFrame);
+	replay_bench_leave(bench, REPLAY_STAGE_PRESENT);
+	bench->gfxFrame = FALSE;
+
+	if (!replay_bench_add_latency(bench, winpr_GetTickCount64NS() - bench->frameStart))
+		return ERROR_NOT_ENOUGH_MEMORY;
+	return rc;
+}
+
+static UINT replay_bench_gfx_surface_command(RdpgfxClientContext* context,
+                                             const RDPGFX_SURFACE_COMMAND* cmd)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+	WINPR_ASSERT(cmd);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->SurfaceCommand, context, cmd);
+	replay_bench_leave(bench, replay_bench_gfx_stage(cmd->codecId));
+	return rc;
+}
+
+static UINT replay_bench_gfx_solid_fill(RdpgfxClientContext* context,
+                                        const RDPGFX_SOLID_FILL_PDU* solidFill)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->SolidFill, context, solidFill);
+	replay_bench_leave(bench, REPLAY_STAGE_GFX_SOLIDFILL);
+	return rc;
+}
+
+static UINT replay_bench_gfx_surface_to_surface(RdpgfxClientContext* context,
+                                                const RDPGFX_SURFACE_TO_SURFACE_PDU* pdu)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->SurfaceToSurface, context, pdu);
+	replay_bench_leave(bench, REPLAY_STAGE_GFX_CACHE);
+	return rc;
+}
+
+static UINT replay_bench_gfx_surface_to_cache(RdpgfxClientContext* context,
+                                              const RDPGFX_SURFACE_TO_CACHE_PDU* pdu)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->SurfaceToCache, context, pdu);
+	replay_bench_leave(bench, REPLAY_STAGE_GFX_CACHE);
+	return rc;
+}
+
+static UINT replay_bench_gfx_cache_to_surface(RdpgfxClientContext* context,
+                                              const RDPGFX_CACHE_TO_SURFACE_PDU* pdu)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->CacheToSurface, context, pdu);
+	replay_bench_leave(bench, REPLAY_STAGE_GFX_CACHE);
+	return rc;
+}
+
+static UINT replay_bench_gfx_update_surfaces(RdpgfxClientContext* context)
+{
+	replayBenchContext* bench = replay_bench_from_gfx(context);
+
+	replay_bench_enter(bench);
+	const UINT rc = IFCALLRESULT(CHANNEL_RC_OK, bench->UpdateSurfaces, context);
+	replay_bench_leave(bench, REPLAY_STAGE_PRESENT);
+	return rc;
+}
+
+static void replay_bench_wrap_gfx(replayBenchContext* bench, RdpgfxClientContext* gfx)
+{
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(gfx);
+
+	bench->StartFrame = gfx->StartFrame;
+	bench->EndFrame = gfx->EndFrame;
+	bench->SurfaceCommand = gfx->SurfaceCommand;
+	bench->SolidFill = gfx->SolidFill;
+	bench->SurfaceToSurface = gfx->SurfaceToSurface;
+	bench->SurfaceToCache = gfx->SurfaceToCache;
+	bench->CacheToSurface = gfx->CacheToSurface;
+	bench->UpdateSurfaces = gfx->UpdateSurfaces;
+
+	gfx->StartFrame = replay_bench_gfx_start_frame;
+	gfx->EndFrame = replay_bench_gfx_end_frame;
+	gfx->SurfaceCommand = replay_bench_gfx_surface_command;
+	gfx->SolidFill = replay_bench_gfx_solid_fill;
+	gfx->SurfaceToSurface = replay_bench_gfx_surface_to_surface;
+	gfx->SurfaceToCache = replay_bench_gfx_surface_to_cache;
+	gfx->CacheToSurface = replay_bench_gfx_cache_to_surface;
+	gfx->UpdateSurfaces = replay_bench_gfx_update_surfaces;
+}
+
+static void replay_bench_OnChannelConnectedEventHandler(void* context,
+                                                        const ChannelConnectedEventArgs* e)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(e);
+
+	freerdp_client_OnChannelConnectedEventHandler(&bench->common, e);
+
+	if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0)
+		replay_bench_wrap_gfx(bench, (RdpgfxClientContext*)e->pInterface);
+}
+
+static void replay_bench_OnChannelDisconnectedEventHandler(void* context,
+                                                           const ChannelDisconnectedEventArgs* e)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(e);
+
+	freerdp_client_OnChannelDisconnectedEventHandler(&bench->common, e);
+}
+
+static BOOL replay_bench_desktop_resize(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+
+	rdpSettings* settings = context->settings;
+	WINPR_ASSERT(settings);
+
+	return gdi_resize(context->gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+	                  freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight));
+}
+
+static BOOL replay_bench_pre_connect(freerdp* instance)
+{
+	WINPR_ASSERT(instance);
+	WINPR_ASSERT(instance->context);
+
+	if (PubSub_SubscribeChannelConnected(instance->context->pubSub,
+	                                     replay_bench_OnChannelConnectedEventHandler) < 0)
+		return FALSE;
+	if (PubSub_SubscribeChannelDisconnected(instance->context->pubSub,
+	                                        replay_bench_OnChannelDisconnectedEventHandler) < 0)
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL replay_bench_post_connect(freerdp* instance)
+{
+	WINPR_ASSERT(instance);
+
+	if (!gdi_init(instance, PIXEL_FORMAT_BGRX32))
+		return FALSE;
+
+	replayBenchContext* bench = (replayBenchContext*)instance->context;
+	rdpUpdate* update = instance->context->update;
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(update);
+
+	update->DesktopResize = replay_bench_desktop_resize;
+
+	bench->BeginPaint = update->BeginPaint;
+	bench->EndPaint = update->EndPaint;
+	bench->BitmapUpdate = update->BitmapUpdate;
+	bench->SurfaceBits = update->SurfaceBits;
+	update->BeginPaint = replay_bench_begin_paint;
+	update->EndPaint = replay_bench_end_paint;
+	update->BitmapUpdate = replay_bench_bitmap_update;
+	update->SurfaceBits = replay_bench_surface_bits;
+
+	replay_bench_wrap_orders(bench, update);
+	return TRUE;
+}
+
+static void replay_bench_post_disconnect(freerdp* instance)
+{
+	if (!instance || !instance->context)
+		return;
+
+	PubSub_UnsubscribeChannelConnected(instance->context->pubSub,
+	                                   replay_bench_OnChannelConnectedEventHandler);
+	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
+	                                      replay_bench_OnChannelDisconnectedEventHandler);
+	gdi_free(instance);
+}
+
+static BOOL replay_bench_client_new(freerdp* instance, rdpContext* context)
+{
+	if (!instance || !context)
+		return FALSE;
+
+	instance->PreConnect = replay_bench_pre_connect;
+	instance->PostConnect = replay_bench_post_connect;
+	instance->PostDisconnect = replay_bench_post_disconnect;
+	return TRUE;
+}
+
+static void replay_bench_client_free(WINPR_ATTR_UNUSED freerdp* instance, rdpContext* context)
+{
+	replayBenchContext* bench = (replayBenchContext*)context;
+
+	if (!bench)
+		return;
+
+	free(bench->latencies);
+}
+
+static int replay_bench_client_entry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
+{
+	WINPR_ASSERT(pEntryPoints);
+
+	ZeroMemory(pEntryPoints, sizeof(RDP_CLIENT_ENTRY_POINTS));
+	pEntryPoints->Version = RDP_CLIENT_INTERFACE_VERSION;
+	pEntryPoints->Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	pEntryPoints->ContextSize = sizeof(replayBenchContext);
+	pEntryPoints->ClientNew = replay_bench_client_new;
+	pEntryPoints->ClientFree = replay_bench_client_free;
+	return 0;
+}
+
+/* Runs the replay until the recording is exhausted, the time spent in the event loop that
+ * is not covered by any other stage is accounted to transport (reading, parsing and
+ * dispatching PDUs). */
+static BOOL replay_bench_run(replayBenchContext* bench, UINT64* duration)
+{
+	WINPR_ASSERT(bench);
+	WINPR_ASSERT(duration);
+
+	rdpContext* context = &bench->common.context;
+	freerdp* instance = context->instance;
+	const UINT64 start = winpr_GetTickCount64NS();
+
+	if (!freerdp_connect(instance))
+	{
+		WLog_ERR(TAG, "replay failed to connect: 0x%08" PRIx32, freerdp_get_last_error(context));
+		return FALSE;
+	}
+
+	while (!freerdp_shall_disconnect_context(context))
+	{
+		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = WINPR_C_ARRAY_INIT;
+		const DWORD nCount = freerdp_get_event_handles(context, handles, ARRAYSIZE(handles));
+
+		if (nCount == 0)
+			break;
+
+		if (WaitForMultipleObjects(nCount, handles, FALSE, INFINITE) == WAIT_FAILED)
+			break;
+
+		const UINT64 stagesBefore = bench->stagesTotal;
+		const UINT64 before = winpr_GetTickCount64NS();
+		const BOOL rc = freerdp_check_event_handles(context);
+		const UINT64 elapsed = winpr_GetTickCount64NS() - before;
+		const UINT64 covered = bench->stagesTotal - stagesBefore;
+
+		bench->stages[REPLAY_STAGE_TRANSPORT].calls++;
+		bench->stages[REPLAY_STAGE_TRANSPORT].ns += (elapsed > covered) ? elapsed - covered : 0;
+
+		/* The end of the recording shows up as a transport failure */
+		if (!rc)
+			break;
+	}
+
+	*duration = winpr_GetTickCount64NS() - start;
+	freerdp_disconnect(instance);
+	return TRUE;
+}
+
+static int replay_bench_compare_u64(const void* a, const void* b)
+{
+	const UINT64* pa = a;
+	const UINT64* pb = b;
+	if (*pa < *pb)
+		return -1;
+	return (*pa > *pb) ? 1 : 0;
+}
+
+static UINT64 replay_bench_percentile(const UINT64* sorted, size_t count, size_t percent)
+{
+	if (count == 0)
+		return 0;
+	return sorted[((count - 1) * percent) / 100];
+}
+
+static void replay_bench_print_string(FILE* fp, const char* str)
+{
+	(void)fputc('"', fp);
+	for (const char* cur = str; *cur; cur++)
+	{
+		const unsigned char c = (unsigned char)*cur;
+		if ((c == '"') || (c == '\\'))
+			(void)fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			(void)fprintf(fp, "\\u%04x", c);
+		else
+			(void)fputc(c, fp);
+	}
+	(void)fputc('"', fp);
+}
+
+static BOOL replay_bench_print_json(FILE* fp, replayBenchContext* bench, const char* file,
+                                    UINT64 duration, UINT64 allocations, UINT64 allocatedBytes)
+{
+	WINPR_ASSERT(fp);
+	WINPR_ASSERT(bench);
+
+	const size_t frames = bench->latencyCount;
+	const double seconds = (double)duration / 1000000000.0;
+
+	qsort(bench->latencies, frames, sizeof(UINT64), replay_bench_compare_u64);
+
+	(void)fprintf(fp, "{\n  \"file\": ");
+	replay_bench_print_string(fp, file);
+	(void)fprintf(fp, ",\n  \"duration_ns\": %" PRIu64 ",\n", duration);
+	(void)fprintf(fp, "  \"frames\": %" PRIuz ",\n", frames);
+	(void)fprintf(fp, "  \"fps\": %.2f,\n", (seconds > 0.0) ? (double)frames / seconds : 0.0);
+	(void)fprintf(fp,
+	              "  \"frame_latency_ns\": { \"p50\": %" PRIu64 ", \"p99\": %" PRIu64
+	              ", \"max\": %" PRIu64 " },\n",
+	              replay_bench_percentile(bench->latencies, frames, 50),
+	              replay_bench_percentile(bench->latencies, frames, 99),
+	              replay_bench_percentile(bench->latencies, frames, 100));
+#if defined(REPLAY_BENCH_COUNT_ALLOCATIONS)
+	(void)fprintf(fp, "  \"allocations\": { \"count\": %" PRIu64 ", \"bytes\": %" PRIu64 " },\n",
+	              allocations, allocatedBytes);
+#else
+	WINPR_UNUSED(allocations);
+	WINPR_UNUSED(allocatedBytes);
+	(void)fprintf(fp, "  \"allocations\": null,\n");
+#endif
+	(void)fprintf(fp, "  \"stages\": {");
+	for (size_t x = 0; x < REPLAY_STAGE_COUNT; x++)
+	{
+		const replayBenchCounter* counter = &bench->stages[x];
+		(void)fprintf(fp, "%s\n    \"%s\": { \"calls\": %" PRIu64 ", \"time_ns\": %" PRIu64 " }",
+		              (x == 0) ? "" : ",", replay_bench_stage_names[x], counter->calls,
+		              counter->ns);
+	}
+	(void)fprintf(fp, "\n  }\n}\n");
+	return ferror(fp) == 0;
+}
+
+static void replay_bench_usage(const char* name)
+{
+	(void)fprintf(stderr, "Usage: %s [--output <file>] <dump file> [FreeRDP client options]\n",
+	              name);
+	(void)fprintf(stderr, "\n");
+	(void)fprintf(stderr, "Replays a session recorded with /dump:record,file:<file>\n");
+	(void)fprintf(stderr, "through the client decoder without network and display and prints\n");
+	(void)fprintf(stderr, "the time spent per stage as JSON. The client options must match\n");
+	(void)fprintf(stderr, "the ones used for the recording (e.g. /gfx or /rfx).\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = -1;
+	int arg = 1;
+	const char* output = nullptr;
+	FILE* fp = stdout;
+	char** args = nullptr;
+	RDP_CLIENT_ENTRY_POINTS clientEntryPoints = WINPR_C_ARRAY_INIT;
+	rdpContext* context = nullptr;
+
+	for (; arg < argc; arg++)
+	{
+		if ((strcmp(argv[arg], "--output") == 0) && (arg + 1 < argc))
+			output = argv[++arg];
+		else if (strcmp(argv[arg], "--help") == 0)
+		{
+			replay_bench_usage(argv[0]);
+			return 0;
+		}
+		else
+			break;
+	}
+
+	if (arg >= argc)
+	{
+		replay_bench_usage(argv[0]);
+		return -1;
+	}
+
+	const char* file = argv[arg++];
+
+	/* Keep stdout for the report */
+	if (!WLog_ConfigureAppender(WLog_GetLogAppender(WLog_GetRoot()), "outputstream",
+	                            (void*)"stderr"))
+		WLog_DBG(TAG, "log output is not a console, leaving it unchanged");
+
+	/* Pass argv[0] and the remaining arguments on to the client command line parser */
+	const int nargs = argc - arg + 1;
+	args = (char**)calloc((size_t)nargs + 1, sizeof(char*));
+	if (!args)
+		goto fail;
+	args[0] = argv[0];
+	for (int x = 1; x < nargs; x++)
+		args[x] = argv[arg + x - 1];
+
+	(void)replay_bench_client_entry(&clientEntryPoints);
+	context = freerdp_client_context_new(&clientEntryPoints);
+	if (!context)
+		goto fail;
+
+	{
+		rdpSettings* settings = context->settings;
+		const int status =
+		    freerdp_client_settings_parse_command_line(settings, nargs, args, FALSE);
+		if (status)
+		{
+			rc = freerdp_client_settings_command_line_status_print(settings, status, nargs, args);
+			goto fail;
+		}
+
+		if (!freerdp_settings_get_string(settings, FreeRDP_ServerHostname) &&
+		    !freerdp_settings_set_string(settings, FreeRDP_ServerHostname, "replay"))
+			goto fail;
+
+		if (!freerdp_settings_set_string(settings, FreeRDP_TransportDumpFile, file) ||
+		    !freerdp_settings_set_bool(settings, FreeRDP_TransportDump, FALSE) ||
+		    !freerdp_settings_set_bool(settings, FreeRDP_TransportDumpReplay, TRUE) ||
+		    !freerdp_settings_set_bool(settings, FreeRDP_TransportDumpReplayNodelay, TRUE) ||
+		    !freerdp_settings_set_bool(settings, FreeRDP_DeactivateClientDecoding, FALSE))
+			goto fail;
+	}
+
+	if (!stream_dump_register_handlers(context, CONNECTION_STATE_MCS_CREATE_REQUEST, FALSE))
+		goto fail;
+
+	if (freerdp_client_start(context) != 0)
+		goto fail;
+
+	{
+		replayBenchContext* bench = (replayBenchContext*)context;
+		UINT64 duration = 0;
+		UINT64 allocations = 0;
+		UINT64 allocatedBytes = 0;
+
+#if defined(REPLAY_BENCH_COUNT_ALLOCATIONS)
+		allocations = __atomic_load_n(&replay_bench_allocations, __ATOMIC_RELAXED);
+		allocatedBytes = __atomic_load_n(&replay_bench_allocated_bytes, __ATOMIC_RELAXED);
+#endif
+		const BOOL success = replay_bench_run(bench, &duration);
+#if defined(REPLAY_BENCH_COUNT_ALLOCATIONS)
+		allocations = __atomic_load_n(&replay_bench_allocations, __ATOMIC_RELAXED) - allocations;
+		allocatedBytes =
+		    __atomic_load_n(&replay_bench_allocated_bytes, __ATOMIC_RELAXED) - allocatedBytes;
+#endif
+
+		if (freerdp_client_stop(context) != 0)
+			goto fail;
+
+		if (!success)
+			goto fail;
+
+		if (output)
+		{
+			fp = winpr_fopen(output, "w");
+			if (!fp)
+			{
+				WLog_ERR(TAG, "failed to open %s", output);
+				goto fail;
+			}
+		}
+
+		if (!replay_bench_print_json(fp, bench, file, duration, allocations, allocatedBytes))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (fp && (fp != stdout))
+		(void)fclose(fp);
+	freerdp_client_context_free(context);
+	free((void*)args);
+	return rc;
+}
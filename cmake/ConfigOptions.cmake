@@ -155,8 +155,10 @@ if(WITH_VAAPI_H264_ENCODING)
   add_definitions("-DWITH_VAAPI_H264_ENCODING")
 endif()
 
-option(WITH_CAIRO "Use CAIRO image library for screen resizing" OFF)
-option(WITH_SWSCALE "Use SWScale image library for screen resizing" ON)
+if(WITH_CAIRO)
+  message(WARNING "WITH_CAIRO is deprecated, image scaling is built in")
+endif()
+option(WITH_SWSCALE "Use SWScale for image and video format conversion" ON)
 
 if(ANDROID)
   include(ConfigOptionsAndroid)
@@ -1,5 +1,6 @@
 option(WITH_SIMD "Enable best platform specific vector instruction support" ON)
 cmake_dependent_option(WITH_AVX2 "Compile AVX2 optimizations." ON "WITH_SIMD" OFF)
+cmake_dependent_option(WITH_AVX512 "Compile AVX-512 optimizations." ON "WITH_SIMD" OFF)
 
 if(WITH_SSE2)
   message(WARNING "WITH_SSE2 is deprecated, use WITH_SIMD instead")
@@ -21,7 +22,7 @@ macro(set_simd_source_file_properties INTRINSIC_TYPE)
   set(SSE_X86_LIST "i686;x86")
   set(SSE_LIST "x86_64;ia64;x64;amd64;ia64;em64t;${SSE_X86_LIST}")
   set(NEON_LIST "arm;armv7;armv8b;armv8l;aarch64")
-  set(SUPPORTED_INTRINSICS_LIST "neon;sse2;sse3;ssse3;sse4.1;sse4.2;avx2")
+  set(SUPPORTED_INTRINSICS_LIST "neon;sse2;sse3;ssse3;sse4.1;sse4.2;avx2;avx512")
 
   string(TOLOWER "${CMAKE_SYSTEM_PROCESSOR}" SYSTEM_PROCESSOR)
 
@@ -37,6 +38,8 @@ macro(set_simd_source_file_properties INTRINSIC_TYPE)
           set(SIMD_LINK_ARG "ignore")
           if("${INTRINSIC_TYPE}" STREQUAL "avx2")
             set(SIMD_LINK_ARG "/arch:AVX2")
+          elseif("${INTRINSIC_TYPE}" STREQUAL "avx512")
+            set(SIMD_LINK_ARG "/arch:AVX512")
           endif()
         else()
           # /arch:SSE2 is the default, so do nothing
@@ -45,6 +48,8 @@ macro(set_simd_source_file_properties INTRINSIC_TYPE)
             set(SIMD_LINK_ARG "/arch:SSE4.2")
           elseif("${INTRINSIC_TYPE}" STREQUAL "avx2")
             set(SIMD_LINK_ARG "/arch:AVX2")
+          elseif("${INTRINSIC_TYPE}" STREQUAL "avx512")
+            set(SIMD_LINK_ARG "/arch:AVX512")
           endif()
         endif()
       endif()
@@ -68,6 +73,8 @@ macro(set_simd_source_file_properties INTRINSIC_TYPE)
           set(SIMD_LINK_ARG "-msse4.2")
         elseif("${INTRINSIC_TYPE}" STREQUAL "avx2")
           set(SIMD_LINK_ARG "-mavx2")
+        elseif("${INTRINSIC_TYPE}" STREQUAL "avx512")
+          set(SIMD_LINK_ARG "-mavx512f -mavx512bw")
         endif()
       endif()
     else()
@@ -86,6 +86,50 @@ extern "C"
 	FREERDP_API int persistent_cache_read_entry(rdpPersistentCache* persistent,
 	                                            PERSISTENT_CACHE_ENTRY* entry);
 
+	/** @brief Get the metadata of an entry from the index built when opening the cache
+	 *
+	 *  The bitmap data is not touched, \b entry->data is set to \b nullptr
+	 *
+	 *  @param persistent The cache opened for reading
+	 *  @param index The entry index, must be less than \b persistent_cache_get_count
+	 *  @param entry The entry to fill
+	 *
+	 *  @return 1 on success, -1 on failure
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API int persistent_cache_get_entry_info(rdpPersistentCache* persistent, size_t index,
+	                                                PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief Get an entry including its bitmap data
+	 *
+	 *  If the cache file could be mapped \b entry->data points into the mapping, otherwise
+	 *  to an internal buffer. In both cases the data is read only and valid until the next
+	 *  call to \b persistent_cache_get_entry, \b persistent_cache_read_entry or
+	 *  \b persistent_cache_close
+	 *
+	 *  @param persistent The cache opened for reading
+	 *  @param index The entry index, must be less than \b persistent_cache_get_count
+	 *  @param entry The entry to fill
+	 *
+	 *  @return 1 on success, -1 on failure
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API int persistent_cache_get_entry(rdpPersistentCache* persistent, size_t index,
+	                                           PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief Look up an entry by its key
+	 *
+	 *  @param persistent The cache opened for reading
+	 *  @param key64 The key to look up
+	 *
+	 *  @return the index of the entry or -1 if not found
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API SSIZE_T persistent_cache_find_entry(rdpPersistentCache* persistent, UINT64 key64);
+
 	WINPR_ATTR_NODISCARD
 	FREERDP_API int persistent_cache_write_entry(rdpPersistentCache* persistent,
 	                                             const PERSISTENT_CACHE_ENTRY* entry);
@@ -24,6 +24,8 @@
 #include <freerdp/types.h>
 #include <freerdp/config.h>
 
+#include <winpr/stream.h>
+
 #include <freerdp/codec/nsc.h>
 #include <freerdp/codec/color.h>
 
@@ -37,7 +39,7 @@ extern "C"
 	/** @brief compress an image to clear codec data
 	 *  @warning not implemented
 	 *  @bug The API does not allow to properly pass an image
-	 *  @deprecated should not be used
+	 *  @deprecated should not be used, use \ref clear_compress_to_stream instead
 	 */
 #if !defined(WITHOUT_FREERDP_3x_DEPRECATED)
 	WINPR_DEPRECATED_VAR("Broken API definition, compression was never implemented",
@@ -47,6 +49,34 @@ extern "C"
 	                         BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize));
 #endif
 
+	/** @brief compress an image to clear codec data
+	 *
+	 *  The encoder splits the image into a residual layer for flat areas, bands
+	 *  of vertical bars for text like content and subcodec rectangles (RLEX or
+	 *  NSCodec) for everything else. Images of up to 1024 pixels are stored in
+	 *  the glyph cache and repeated glyphs are sent as cache hits. The context
+	 *  keeps the vertical bar and glyph caches of the decoder in sync, so all
+	 *  data produced by a context must be decoded in order by a single decoder.
+	 *
+	 *  @param clear The context to use for compression, must not be \b nullptr, must have been
+	 * created with \ref Compressor = TRUE
+	 *  @param s The stream to append the compressed data to, must not be \b nullptr
+	 *  @param pSrcData A pointer to the image data to compress, must not be \b nullptr
+	 *  @param SrcFormat The bitmap format of the image data
+	 *  @param nSrcStep The size in bytes of a source image line
+	 *  @param nWidth The width in pixels of the image, must be in [1, 65535]
+	 *  @param nHeight The height in lines of the image, must be in [1, 65535]
+	 *
+	 *  @return \b 0 in case of success, a negative error code otherwise.
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API INT32 clear_compress_to_stream(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+	                                           wStream* WINPR_RESTRICT s,
+	                                           const BYTE* WINPR_RESTRICT pSrcData,
+	                                           UINT32 SrcFormat, UINT32 nSrcStep, UINT32 nWidth,
+	                                           UINT32 nHeight);
+
 	/** @brief decompress clear codec data
 	 *
 	 *  @param clear The context to use for decompression, must not be \b nullptr, must have been
@@ -24,6 +24,7 @@
 
 #include <winpr/crt.h>
 #include <freerdp/api.h>
+#include <freerdp/types.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -475,6 +476,92 @@ FREERDP_API DWORD FreeRDPAreColorFormatsEqualNoAlpha(DWORD first, DWORD second);
 	                                     UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
 	                                     UINT32 nSrcWidth, UINT32 nSrcHeight);
 
+	/** @brief Image scaler keeping its filter tables and scratch rows across calls
+	 *  @since version 3.25.0
+	 */
+	typedef struct S_FREERDP_IMAGE_SCALER FREERDP_IMAGE_SCALER;
+
+	/** @since version 3.25.0 */
+	typedef enum
+	{
+		FREERDP_IMAGE_SCALE_BILINEAR = 0,
+		FREERDP_IMAGE_SCALE_BICUBIC = 1
+	} FREERDP_IMAGE_SCALE_FILTER;
+
+	/** @since version 3.25.0 */
+	FREERDP_API void freerdp_image_scaler_free(FREERDP_IMAGE_SCALER* scaler);
+
+	/** @brief Create an image scaler
+	 *
+	 * @param filter The interpolation filter, when downscaling it is widened by the scale factor
+	 *
+	 * @return A new scaler or \b nullptr
+	 * @since version 3.25.0
+	 */
+	WINPR_ATTR_MALLOC(freerdp_image_scaler_free, 1)
+	WINPR_ATTR_NODISCARD
+	FREERDP_API FREERDP_IMAGE_SCALER* freerdp_image_scaler_new(FREERDP_IMAGE_SCALE_FILTER filter);
+
+	/** @brief Set the source and destination size. The filter tables are only rebuilt if the
+	 * sizes changed since the last call.
+	 *
+	 * @param scaler     The scaler
+	 * @param nSrcWidth  width of source in pixels
+	 * @param nSrcHeight height of source in pixels
+	 * @param nDstWidth  width of destination in pixels
+	 * @param nDstHeight height of destination in pixels
+	 *
+	 * @return          TRUE if success, FALSE otherwise
+	 * @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API BOOL freerdp_image_scaler_set_size(FREERDP_IMAGE_SCALER* scaler, UINT32 nSrcWidth,
+	                                               UINT32 nSrcHeight, UINT32 nDstWidth,
+	                                               UINT32 nDstHeight);
+
+	/** @brief Get the destination area depending on a source area.
+	 *
+	 * Use this to find what has to be rescaled after the source changed in \b src.
+	 *
+	 * @param scaler The scaler, \b freerdp_image_scaler_set_size must have been called
+	 * @param src    The source rectangle
+	 * @param dst    The destination rectangle, empty if \b src is empty
+	 *
+	 * @return          TRUE if success, FALSE otherwise
+	 * @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API BOOL freerdp_image_scaler_map_rect(const FREERDP_IMAGE_SCALER* scaler,
+	                                               const RECTANGLE_16* src, RECTANGLE_16* dst);
+
+	/** @brief Scale the source image to the size set with \b freerdp_image_scaler_set_size
+	 *
+	 * Only the destination pixels inside \b rect are written. Any 32bpp source format is
+	 * filtered directly, other formats are converted line by line first.
+	 *
+	 * @param scaler     The scaler
+	 * @param pDstData   destination buffer
+	 * @param DstFormat  destination buffer format
+	 * @param nDstStep   destination buffer stride (line in bytes) 0 for default
+	 * @param nXDst      destination buffer offset x of the scaled image
+	 * @param nYDst      destination buffer offset y of the scaled image
+	 * @param pSrcData   source buffer
+	 * @param SrcFormat  source buffer format
+	 * @param nSrcStep   source buffer stride (line in bytes) 0 for default
+	 * @param nXSrc      source buffer x offset in pixels
+	 * @param nYSrc      source buffer y offset in pixels
+	 * @param rect       area of the scaled image to write, relative to \b nXDst and \b nYDst.
+	 *                   \b nullptr for the whole image
+	 *
+	 * @return          TRUE if success, FALSE otherwise
+	 * @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API BOOL freerdp_image_scaler_scale(
+	    FREERDP_IMAGE_SCALER* scaler, BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat,
+	    UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst, const BYTE* WINPR_RESTRICT pSrcData,
+	    DWORD SrcFormat, UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc, const RECTANGLE_16* rect);
+
 	/** @brief fill an area with the color provided.
 	 *
 	 * @param pDstData  destination buffer
@@ -80,6 +80,35 @@ extern "C"
 	                                  const RECTANGLE_16* regionRect, BYTE** ppDstData,
 	                                  UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta);
 
+	/** @brief Compress the damaged parts of a frame to an AVC420 stream
+	 *
+	 *  Only the 64x64 tiles touched by \b damageRects are converted and compared with the
+	 *  previous frame, everything else is assumed unchanged since the last call. The changed
+	 *  tiles are returned in \b meta, tiles looking like text or UI elements get a lower
+	 *  quantization parameter than the configured one. Encoders supporting regions of interest
+	 *  are told to skip everything outside of the changed tiles.
+	 *
+	 *  @param h264 The h264 context to use
+	 *  @param pSrcData The source image
+	 *  @param SrcFormat The pixel format of the source image
+	 *  @param nSrcStep The size of a line in bytes of the source image
+	 *  @param nSrcWidth The width of the source image in pixels
+	 *  @param nSrcHeight The height of the source image
+	 *  @param damageRects The rectangles changed since the last call
+	 *  @param numDamageRects The number of rectangles in \b damageRects
+	 *  @param ppDstData A pointer that will hold the encoded frame
+	 *  @param pDstSize A pointer for the encoded frame size in bytes
+	 *  @param meta The metablock to fill with the changed regions
+	 *  @return \b 0 if nothing changed, \b >0 for success, \b <0 for an error
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API INT32 avc420_compress_region(H264_CONTEXT* h264, const BYTE* pSrcData,
+	                                         DWORD SrcFormat, UINT32 nSrcStep, UINT32 nSrcWidth,
+	                                         UINT32 nSrcHeight, const RECTANGLE_16* damageRects,
+	                                         UINT32 numDamageRects, BYTE** ppDstData,
+	                                         UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta);
+
 	/** @brief API for user to fill YUV I420 buffer before encoding
 	 *
 	 *  @param h264 The h264 context to query
@@ -121,6 +150,21 @@ extern "C"
 	                                  UINT32* pAuxDstSize, RDPGFX_H264_METABLOCK* meta,
 	                                  RDPGFX_H264_METABLOCK* auxMeta);
 
+	/** @brief Compress the damaged parts of a frame to an AVC444 stream
+	 *
+	 *  Like \b avc420_compress_region for the luma and the chroma frame of AVC444,
+	 *  \b op is set to the LC value of the frames that changed.
+	 *
+	 *  @return \b 0 if nothing changed, \b >0 for success, \b <0 for an error
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API INT32 avc444_compress_region(
+	    H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
+	    UINT32 nSrcWidth, UINT32 nSrcHeight, BYTE version, const RECTANGLE_16* damageRects,
+	    UINT32 numDamageRects, BYTE* op, BYTE** pDstData, UINT32* pDstSize, BYTE** pAuxDstData,
+	    UINT32* pAuxDstSize, RDPGFX_H264_METABLOCK* meta, RDPGFX_H264_METABLOCK* auxMeta);
+
 	WINPR_ATTR_NODISCARD
 	FREERDP_API INT32 avc444_decompress(H264_CONTEXT* h264, BYTE op,
 	                                    const RECTANGLE_16* regionRects, UINT32 numRegionRect,
@@ -138,6 +138,18 @@ extern "C"
 	WINPR_ATTR_NODISCARD
 	FREERDP_API NSC_CONTEXT* nsc_context_new(void);
 
+	/** @brief Create a new \ref NSC_CONTEXT
+	 *
+	 *  @param ThreadingFlags \b THREADING_FLAGS_DISABLE_THREADS to encode on the calling thread
+	 * only, \b 0 to split encoding across the thread pool
+	 *
+	 *  @return The new context or \b nullptr in case of failure
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_MALLOC(nsc_context_free, 1)
+	WINPR_ATTR_NODISCARD
+	FREERDP_API NSC_CONTEXT* nsc_context_new_ex(UINT32 ThreadingFlags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -59,6 +59,24 @@ extern "C"
 	FREERDP_API BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 width,
 	                                                                     UINT32 height);
 
+	/** @brief Create a new \ref BITMAP_PLANAR_CONTEXT
+	 *
+	 *  @param flags A combination of \b PLANAR_FORMAT_HEADER_* flags
+	 *  @param width The maximum width of bitmaps handled by the context
+	 *  @param height The maximum height of bitmaps handled by the context
+	 *  @param ThreadingFlags \b THREADING_FLAGS_DISABLE_THREADS to encode on the calling thread
+	 * only, \b 0 to encode the color planes of large bitmaps on the thread pool
+	 *
+	 *  @return The new context or \b nullptr in case of failure
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_MALLOC(freerdp_bitmap_planar_context_free, 1)
+	WINPR_ATTR_NODISCARD
+	FREERDP_API BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new_ex(DWORD flags,
+	                                                                        UINT32 width,
+	                                                                        UINT32 height,
+	                                                                        UINT32 ThreadingFlags);
+
 	FREERDP_API void freerdp_planar_switch_bgr(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 	                                           BOOL bgr);
 	FREERDP_API void freerdp_planar_topdown_image(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
@@ -46,6 +46,55 @@ extern "C"
 	                                     BYTE** WINPR_RESTRICT ppDstData,
 	                                     UINT32* WINPR_RESTRICT pDstSize);
 
+	/** Encode the first pass of a multi-pass progressive update.
+	 *
+	 *  Tiles touched by \b invalidRegion are sent at a coarse quality. Their transformed
+	 *  coefficients are kept in the surface context of \b surfaceId (created if it does not
+	 *  exist) to be refined later by \link progressive_compress_upgrade
+	 *
+	 *  @param progressive The progressive codec context, must be created as compressor
+	 *  @param surfaceId The surface the tiles belong to
+	 *  @param pSrcData The image to encode
+	 *  @param SrcSize The size of \b pSrcData in bytes
+	 *  @param SrcFormat The pixel format of \b pSrcData
+	 *  @param Width The width of the image
+	 *  @param Height The height of the image
+	 *  @param ScanLine The line stride of \b pSrcData, 0 for a packed image
+	 *  @param invalidRegion The region to encode or \b nullptr for the whole image
+	 *  @param ppDstData A pointer receiving the encoded data, owned by \b progressive
+	 *  @param pDstSize A pointer receiving the size of the encoded data
+	 *
+	 *  @since version 3.25.0
+	 *  @return 1 if data was encoded, 0 if there was nothing to encode, < 0 in case of an error
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API int progressive_compress_first(
+	    PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT16 surfaceId,
+	    const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize, UINT32 SrcFormat, UINT32 Width,
+	    UINT32 Height, UINT32 ScanLine, const REGION16* WINPR_RESTRICT invalidRegion,
+	    BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize);
+
+	/** Encode the next upgrade pass of a multi-pass progressive update.
+	 *
+	 *  Refines the tiles of \b surfaceId with the lowest quality by one level with SRL and RAW
+	 *  coded bits. Call it when idle or whenever bandwidth is available until it returns 0.
+	 *
+	 *  @param progressive The progressive codec context, must be created as compressor
+	 *  @param surfaceId The surface to refine
+	 *  @param maxSize The size the encoded data should not exceed, 0 for no limit. At least one
+	 *  tile is always encoded, the remaining tiles are left for the next call.
+	 *  @param ppDstData A pointer receiving the encoded data, owned by \b progressive
+	 *  @param pDstSize A pointer receiving the size of the encoded data
+	 *
+	 *  @since version 3.25.0
+	 *  @return 1 if data was encoded, 0 if all tiles are at full quality, < 0 in case of an error
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API int progressive_compress_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+	                                             UINT16 surfaceId, UINT32 maxSize,
+	                                             BYTE** WINPR_RESTRICT ppDstData,
+	                                             UINT32* WINPR_RESTRICT pDstSize);
+
 	WINPR_ATTR_NODISCARD
 	FREERDP_API INT32 progressive_decompress(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 	                                         const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
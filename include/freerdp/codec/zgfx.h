@@ -32,6 +32,15 @@
 
 #define ZGFX_SEGMENTED_MAXSIZE 65535
 
+/** @since version 3.25.0 */
+#define ZGFX_COMPRESSION_LEVEL_NONE 0
+/** @since version 3.25.0 */
+#define ZGFX_COMPRESSION_LEVEL_FAST 1
+/** @since version 3.25.0 */
+#define ZGFX_COMPRESSION_LEVEL_BEST 2
+/** @since version 3.25.0 */
+#define ZGFX_COMPRESSION_LEVEL_DEFAULT ZGFX_COMPRESSION_LEVEL_FAST
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -59,6 +68,34 @@ extern "C"
 
 	FREERDP_API void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, BOOL flush);
 
+	/** @brief Select the match search effort of a compressor context
+	 *
+	 *  Contexts created with \b zgfx_context_new(TRUE) use
+	 *  \b ZGFX_COMPRESSION_LEVEL_DEFAULT. \b ZGFX_COMPRESSION_LEVEL_NONE sends
+	 *  all segments uncompressed, \b ZGFX_COMPRESSION_LEVEL_FAST uses a short
+	 *  hash chain search and \b ZGFX_COMPRESSION_LEVEL_BEST a deep search with
+	 *  lazy matching for the best ratio.
+	 *
+	 *  @param zgfx The compressor context
+	 *  @param level One of the \b ZGFX_COMPRESSION_LEVEL_* values
+	 *
+	 *  @return \b TRUE for success, \b FALSE if the level is invalid
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+	                                                    UINT32 level);
+
+	/** @brief Get the compression level of a compressor context
+	 *
+	 *  @param zgfx The compressor context
+	 *
+	 *  @return The current \b ZGFX_COMPRESSION_LEVEL_* value
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API UINT32 zgfx_context_get_compression_level(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx);
+
 	FREERDP_API void zgfx_context_free(ZGFX_CONTEXT* zgfx);
 
 	WINPR_ATTR_MALLOC(zgfx_context_free, 1)
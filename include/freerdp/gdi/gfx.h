@@ -54,6 +54,7 @@ extern "C"
 #else
 	    void* reservedAV1;
 #endif
+		FREERDP_IMAGE_SCALER* scaler; /** @since version 3.25.0 */
 	};
 	typedef struct gdi_gfx_surface gdiGfxSurface;
 
@@ -37,6 +37,12 @@ extern "C"
 		UINT64 TotalCompressedBytes;
 		UINT64 TotalUncompressedBytes;
 		double TotalCompressionRatio;
+
+		UINT64 TotalFrames;        /** @since version 3.25.0 */
+		UINT64 TotalWriteSyscalls; /** @since version 3.25.0 */
+		UINT64 TotalTlsRecords;    /** @since version 3.25.0 */
+		double SyscallsPerFrame;   /** @since version 3.25.0 */
+		double TlsRecordsPerFrame; /** @since version 3.25.0 */
 	};
 	typedef struct rdp_metrics rdpMetrics;
 
@@ -44,6 +50,17 @@ extern "C"
 	FREERDP_API double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes,
 	                                       UINT32 CompressedBytes);
 
+	/** @brief Account the transport writes of a frame
+	 *
+	 *  @param metrics The metrics to update
+	 *  @param WriteSyscalls The number of socket writes the frame required
+	 *  @param TlsRecords The number of TLS records the frame was sent in
+	 *
+	 *  @since version 3.25.0
+	 */
+	FREERDP_API void metrics_write_frame(rdpMetrics* metrics, UINT64 WriteSyscalls,
+	                                     UINT64 TlsRecords);
+
 	FREERDP_API void metrics_free(rdpMetrics* metrics);
 
 	WINPR_ATTR_MALLOC(metrics_free, 1)
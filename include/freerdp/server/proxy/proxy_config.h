@@ -131,6 +131,10 @@ extern "C"
 		BOOL TargetSmartcardAuth;  /** @since version 3.25.0 */
 		char* TargetSmartcardCert; /** @since version 3.25.0 */
 		char* TargetSmartcardKey;  /** @since version 3.25.0 */
+
+		/* maintain a software GDI framebuffer for every session. If disabled, graphics updates
+		 * are forwarded without decoding unless a module requests a framebuffer */
+		BOOL SoftwareGdi; /** @since version 3.25.0 */
 	};
 
 	/**
@@ -142,6 +142,11 @@ extern "C"
 			char* c;
 			void* v;
 		} computerName;
+
+		/* software GDI handlers, only set while a framebuffer is maintained */
+		pBitmapUpdate gdi_bitmap_update; /** @since version 3.25.0 */
+		pSurfaceBits gdi_surface_bits;   /** @since version 3.25.0 */
+		pPalette gdi_palette;            /** @since version 3.25.0 */
 	};
 
 	/**
@@ -164,6 +169,9 @@ extern "C"
 		/* used to external modules to store per-session info */
 		wHashTable* modules_info;
 		psPeerReceiveChannelData server_receive_channel_data_original;
+
+		/* set by a module that needs the decoded session framebuffer */
+		volatile LONG framebuffer_requested; /** @since version 3.25.0 */
 	};
 
 	WINPR_ATTR_NODISCARD
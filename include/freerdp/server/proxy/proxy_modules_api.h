@@ -150,7 +150,13 @@ extern "C"
 		/* 3 used for aborting a session. */
 		void (*AbortConnect)(struct proxy_plugins_manager* mgr, proxyData*);
 
-		UINT64 reserved[128 - 4]; /* 4-127 reserved fields */
+		/* 4 used for requesting the decoded framebuffer (rdpContext::gdi of the client side).
+		 * Graphics updates are forwarded without decoding unless a module requested it.
+		 * @since version 3.25.0 */
+		WINPR_ATTR_NODISCARD BOOL (*RequestFramebuffer)(struct proxy_plugins_manager* mgr,
+		                                                proxyData*);
+
+		UINT64 reserved[128 - 5]; /* 5-127 reserved fields */
 	};
 
 	typedef BOOL (*proxyModuleEntryPoint)(proxyPluginsManager* plugins_manager, void* userdata);
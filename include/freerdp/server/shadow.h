@@ -59,6 +59,7 @@ extern "C"
 	typedef struct rdp_shadow_capture rdpShadowCapture;
 	typedef struct rdp_shadow_subsystem rdpShadowSubsystem;
 	typedef struct rdp_shadow_multiclient_event rdpShadowMultiClientEvent;
+	typedef struct rdp_shadow_encode_cache rdpShadowEncodeCache;
 
 	typedef struct S_RDP_SHADOW_ENTRY_POINTS RDP_SHADOW_ENTRY_POINTS;
 	typedef int (*pfnShadowSubsystemEntry)(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
@@ -187,6 +188,11 @@ extern "C"
 #else
 	    UINT32 reservedAV1[2];
 #endif
+		BOOL GfxClearCodec;                /** @since version 3.25.0 */
+		BOOL ShareEncodedFrames;           /** @since version 3.25.0 */
+		rdpShadowEncodeCache* encodeCache; /** @since version 3.25.0 */
+		BOOL CaptureTileHashes;            /** @since version 3.25.0 */
+		BOOL GfxProgressivePasses;         /** @since version 3.25.0 */
 	};
 
 	struct rdp_shadow_surface
@@ -406,6 +412,56 @@ extern "C"
 	                                                   UINT32 format2, UINT32 nStep2,
 	                                                   RECTANGLE_16* WINPR_RESTRICT rect);
 
+	/** @brief Compare two framebuffer images tile by tile
+	 *
+	 *  Like \b shadow_capture_compare_with_format but reports the changed 16x16
+	 *  tiles instead of their bounding rectangle.
+	 *
+	 *  @param pData1  A pointer to the data of image 1
+	 *  @param format1 The format of image 1
+	 *  @param nStep1  The line width in bytes of image 1
+	 *  @param nWidth  The line width in pixels of image 1
+	 *  @param nHeight The height of image 1
+	 *  @param pData2  A pointer to the data of image 2
+	 *  @param format2 The format of image 2
+	 *  @param nStep2  The line width in bytes of image 2
+	 *  @param region  An initialized region, set to the changed tiles
+	 *
+	 *  @return \b 0 if equal, \b >0 if not equal and \b <0 for any error
+	 *
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API int shadow_capture_compare_region(const BYTE* WINPR_RESTRICT pData1,
+	                                              UINT32 format1, UINT32 nStep1, UINT32 nWidth,
+	                                              UINT32 nHeight, const BYTE* WINPR_RESTRICT pData2,
+	                                              UINT32 format2, UINT32 nStep2,
+	                                              REGION16* WINPR_RESTRICT region);
+
+	/** @brief Find the tiles of a framebuffer image changed since the last call
+	 *
+	 *  Each 16x16 tile is hashed and compared with the hash of the previous
+	 *  image passed to \b capture, so the previous image is not needed. The
+	 *  first image and any change of size or format report all tiles.
+	 *
+	 *  @param capture The capture context keeping the tile hashes
+	 *  @param pData   A pointer to the image data
+	 *  @param format  The format of the image
+	 *  @param nStep   The line width in bytes of the image
+	 *  @param nWidth  The width of the image
+	 *  @param nHeight The height of the image
+	 *  @param region  An initialized region, set to the changed tiles
+	 *
+	 *  @return \b 0 if unchanged, \b >0 if changed and \b <0 for any error
+	 *
+	 *  @since version 3.25.0
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_API int shadow_capture_compare_hashed(rdpShadowCapture* capture,
+	                                              const BYTE* WINPR_RESTRICT pData, UINT32 format,
+	                                              UINT32 nStep, UINT32 nWidth, UINT32 nHeight,
+	                                              REGION16* WINPR_RESTRICT region);
+
 	FREERDP_API void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem);
 
 	WINPR_ATTR_NODISCARD
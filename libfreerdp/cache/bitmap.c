@@ -34,6 +34,7 @@
 
 #include "../gdi/gdi.h"
 #include "../core/graphics.h"
+#include "../core/activation.h"
 
 #include "bitmap.h"
 #include "cache.h"
@@ -44,6 +45,83 @@ static rdpBitmap* bitmap_cache_get(rdpBitmapCache* bitmapCache, UINT32 id, UINT3
 static BOOL bitmap_cache_put(rdpBitmapCache* bitmapCache, UINT32 id, UINT32 index,
                              rdpBitmap* bitmap);
 
+static rdpBitmap* bitmap_cache_load_persistent(rdpContext* context,
+                                               rdpPersistentCache* persistent, size_t index)
+{
+	PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+
+	WINPR_ASSERT(context);
+
+	const rdpGdi* gdi = context->gdi;
+	if (!gdi || (FreeRDPGetBytesPerPixel(gdi->dstFormat) != 4))
+		return nullptr;
+
+	if (persistent_cache_get_entry(persistent, index, &entry) < 1)
+		return nullptr;
+
+	rdpBitmap* bitmap = Bitmap_Alloc(context);
+
+	if (!bitmap)
+		return nullptr;
+
+	bitmap->key64 = entry.key64;
+
+	if (!Bitmap_SetDimensions(bitmap, entry.width, entry.height))
+		goto fail;
+
+	/* the cache file holds the decoded bitmap, only a copy out of the mapping is required */
+	bitmap->format = gdi->dstFormat;
+	bitmap->length = entry.size;
+	bitmap->data = (BYTE*)winpr_aligned_malloc(bitmap->length, 16);
+
+	if (!bitmap->data)
+		goto fail;
+
+	CopyMemory(bitmap->data, entry.data, bitmap->length);
+
+	if (!bitmap->New(context, bitmap))
+		goto fail;
+
+	return bitmap;
+
+fail:
+	Bitmap_Free(context, bitmap);
+	return nullptr;
+}
+
+/* Lookup for drawing orders. Indices the server knows from the persistent key list are loaded
+ * from the persistent cache on their first use. */
+static rdpBitmap* bitmap_cache_get_or_load(rdpContext* context, UINT32 id, UINT32 index)
+{
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->cache);
+
+	rdpBitmapCache* bitmapCache = context->cache->bitmap;
+	rdpBitmap* bitmap = bitmap_cache_get(bitmapCache, id, index);
+
+	if (bitmap || !bitmapCache->persistent || (id >= bitmapCache->maxCells))
+		return bitmap;
+
+	const BITMAP_V2_CELL* cell = &bitmapCache->cells[id];
+
+	if (index >= cell->persistentCount)
+		return nullptr;
+
+	bitmap = bitmap_cache_load_persistent(context, bitmapCache->persistent,
+	                                      1ull * cell->persistentFirst + index);
+
+	if (!bitmap)
+		return nullptr;
+
+	if (!bitmap_cache_put(bitmapCache, id, index, bitmap))
+	{
+		Bitmap_Free(context, bitmap);
+		return nullptr;
+	}
+
+	return bitmap;
+}
+
 static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 {
 	rdpBitmap* bitmap = nullptr;
@@ -54,7 +132,7 @@ static BOOL update_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt)
 	if (memblt->cacheId == 0xFF)
 		bitmap = offscreen_cache_get(cache->offscreen, memblt->cacheIndex);
 	else
-		bitmap = bitmap_cache_get(cache->bitmap, (BYTE)memblt->cacheId, memblt->cacheIndex);
+		bitmap = bitmap_cache_get_or_load(context, (BYTE)memblt->cacheId, memblt->cacheIndex);
 
 	/* XP-SP2 servers sometimes ask for cached bitmaps they've never defined. */
 	if (bitmap == nullptr)
@@ -74,7 +152,7 @@ static BOOL update_gdi_mem3blt(rdpContext* context, MEM3BLT_ORDER* mem3blt)
 	if (mem3blt->cacheId == 0xFF)
 		bitmap = offscreen_cache_get(cache->offscreen, mem3blt->cacheIndex);
 	else
-		bitmap = bitmap_cache_get(cache->bitmap, (BYTE)mem3blt->cacheId, mem3blt->cacheIndex);
+		bitmap = bitmap_cache_get_or_load(context, (BYTE)mem3blt->cacheId, mem3blt->cacheIndex);
 
 	/* XP-SP2 servers sometimes ask for cached bitmaps they've never defined. */
 	if (!bitmap)
@@ -325,6 +403,22 @@ static int bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
 				PERSISTENT_CACHE_ENTRY cacheEntry = WINPR_C_ARRAY_INIT;
 				rdpBitmap* bitmap = cell->entries[j];
 
+				/* entries never drawn this session are copied over without loading them */
+				if (!bitmap && bitmapCache->persistent && (j < cell->persistentCount))
+				{
+					if (persistent_cache_get_entry(bitmapCache->persistent,
+					                               1ull * cell->persistentFirst + j,
+					                               &cacheEntry) < 1)
+						continue;
+
+					if (persistent_cache_write_entry(persistent, &cacheEntry) < 1)
+					{
+						status = -1;
+						goto end;
+					}
+					continue;
+				}
+
 				if (!bitmap || !bitmap->key64)
 					continue;
 
@@ -351,10 +445,65 @@ static int bitmap_cache_save_persistent(rdpBitmapCache* bitmapCache)
 	status = 1;
 
 end:
+	/* release the mapping of the current file before it is replaced */
+	persistent_cache_free(bitmapCache->persistent);
+	bitmapCache->persistent = nullptr;
 	persistent_cache_free(persistent);
 	return status;
 }
 
+static void bitmap_cache_open_persistent(rdpBitmapCache* bitmapCache)
+{
+	WINPR_ASSERT(bitmapCache);
+	WINPR_ASSERT(bitmapCache->context);
+
+	const rdpSettings* settings = bitmapCache->context->settings;
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_ServerMode))
+		return;
+
+	if (freerdp_settings_get_uint32(settings, FreeRDP_BitmapCacheVersion) != 2)
+		return;
+
+	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
+		return;
+
+	const char* BitmapCachePersistFile =
+	    freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
+	if (!BitmapCachePersistFile)
+		return;
+
+	rdpPersistentCache* persistent = persistent_cache_new();
+
+	if (!persistent)
+		return;
+
+	if (persistent_cache_open(persistent, BitmapCachePersistFile, FALSE, 0) < 1)
+	{
+		persistent_cache_free(persistent);
+		return;
+	}
+
+	/* keys are assigned to the cells in the order rdp_send_client_persistent_key_list_pdu
+	 * announces them */
+	const int count = persistent_cache_get_count(persistent);
+	UINT32 remaining = (count > 0) ? MIN((UINT32)count, PERSIST_KEY_LIST_MAX_KEYS) : 0u;
+	UINT32 first = 0;
+
+	for (UINT32 i = 0; i < MIN(bitmapCache->maxCells, PERSIST_KEY_LIST_MAX_CELLS); i++)
+	{
+		BITMAP_V2_CELL* cell = &bitmapCache->cells[i];
+		const UINT32 num = MIN(remaining, cell->number);
+
+		cell->persistentFirst = first;
+		cell->persistentCount = num;
+		first += num;
+		remaining -= num;
+	}
+
+	bitmapCache->persistent = persistent;
+}
+
 rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 {
 	rdpSettings* settings = nullptr;
@@ -396,6 +545,7 @@ rdpBitmapCache* bitmap_cache_new(rdpContext* context)
 		cell->number = nr;
 	}
 
+	bitmap_cache_open_persistent(bitmapCache);
 	return bitmapCache;
 fail:
 	WINPR_PRAGMA_DIAG_PUSH
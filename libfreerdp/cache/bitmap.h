@@ -29,6 +29,8 @@ typedef struct
 {
 	UINT32 number;
 	rdpBitmap** entries;
+	UINT32 persistentFirst; /* persistent cache entry of index 0 */
+	UINT32 persistentCount; /* number of indices offered from the persistent cache */
 } BITMAP_V2_CELL;
 
 typedef struct
@@ -22,11 +22,40 @@
 #include <winpr/crt.h>
 #include <winpr/stream.h>
 #include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/string.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/constants.h>
 
 #include <freerdp/cache/persistent.h>
+#include <freerdp/log.h>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#else
+#include <io.h>
+#endif
+
+#define TAG FREERDP_TAG("cache.persistent")
+
+typedef struct
+{
+	UINT64 key64;
+	UINT64 offset; /* offset of the bitmap data in the file */
+	UINT32 size;
+	UINT32 flags;
+	UINT16 width;
+	UINT16 height;
+} PERSISTENT_CACHE_INDEX_ENTRY;
+
+typedef struct
+{
+	UINT64 key64;
+	size_t index;
+} PERSISTENT_CACHE_KEY;
 
 struct rdp_persistent_cache
 {
@@ -37,6 +66,21 @@ struct rdp_persistent_cache
 	char* filename;
 	BYTE* bmpData;
 	size_t bmpSize;
+
+	/* write mode: entries go to a temporary file that replaces the cache on close */
+	char* tmpname;
+	BOOL failed;
+
+	/* read mode: entry index built on open, file mapping if available */
+	PERSISTENT_CACHE_INDEX_ENTRY* index;
+	size_t indexSize;
+	PERSISTENT_CACHE_KEY* keys;
+	size_t cursor;
+	UINT64 fileSize;
+	const BYTE* map;
+#if defined(_WIN32)
+	HANDLE mapHandle;
+#endif
 };
 
 static const size_t PERSIST_ALIGN = 32;
@@ -54,121 +98,253 @@ int persistent_cache_get_count(rdpPersistentCache* persistent)
 	return persistent->count;
 }
 
-static int persistent_cache_read_entry_v2(rdpPersistentCache* persistent,
-                                          PERSISTENT_CACHE_ENTRY* entry)
+static BOOL persistent_cache_read_at(rdpPersistentCache* persistent, UINT64 offset, void* data,
+                                     size_t length)
 {
-	PERSISTENT_CACHE_ENTRY_V2 entry2 = WINPR_C_ARRAY_INIT;
-
 	WINPR_ASSERT(persistent);
-	WINPR_ASSERT(entry);
+	WINPR_ASSERT(data || (length == 0));
 
-	if (fread((void*)&entry2, sizeof(entry2), 1, persistent->fp) != 1)
-		return -1;
+	if ((offset > persistent->fileSize) || (length > persistent->fileSize - offset))
+		return FALSE;
 
-	entry->key64 = entry2.key64;
-	entry->width = entry2.width;
-	entry->height = entry2.height;
-	entry->size = entry2.width * entry2.height * 4;
-	entry->flags = entry2.flags;
+	if (persistent->map)
+	{
+		memcpy(data, &persistent->map[offset], length);
+		return TRUE;
+	}
 
-	entry->data = persistent->bmpData;
+	if (offset > INT64_MAX)
+		return FALSE;
 
-	if (fread((void*)entry->data, 0x4000, 1, persistent->fp) != 1)
-		return -1;
+	if (_fseeki64(persistent->fp, (INT64)offset, SEEK_SET) != 0)
+		return FALSE;
 
-	return 1;
+	return fread(data, length, 1, persistent->fp) == 1;
 }
 
-static int persistent_cache_write_entry_v2(rdpPersistentCache* persistent,
-                                           const PERSISTENT_CACHE_ENTRY* entry)
+static BOOL persistent_cache_map(rdpPersistentCache* persistent)
 {
-	PERSISTENT_CACHE_ENTRY_V2 entry2 = WINPR_C_ARRAY_INIT;
+	WINPR_ASSERT(persistent);
+
+	if ((persistent->fileSize == 0) || (persistent->fileSize > SIZE_MAX))
+		return FALSE;
+
+#if defined(_WIN32)
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(persistent->fp));
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	persistent->mapHandle = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!persistent->mapHandle)
+		return FALSE;
+
+	persistent->map = (const BYTE*)MapViewOfFile(persistent->mapHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!persistent->map)
+	{
+		(void)CloseHandle(persistent->mapHandle);
+		persistent->mapHandle = nullptr;
+		return FALSE;
+	}
+#else
+	const size_t size = (size_t)persistent->fileSize;
+	void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileno(persistent->fp), 0);
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	/* entries are pulled in on demand, don't read ahead the whole file */
+	(void)posix_madvise(map, size, POSIX_MADV_RANDOM);
+	persistent->map = (const BYTE*)map;
+#endif
+	return TRUE;
+}
+
+static void persistent_cache_unmap(rdpPersistentCache* persistent)
+{
+	WINPR_ASSERT(persistent);
 
+	if (!persistent->map)
+		return;
+
+#if defined(_WIN32)
+	(void)UnmapViewOfFile(persistent->map);
+	(void)CloseHandle(persistent->mapHandle);
+	persistent->mapHandle = nullptr;
+#else
+	(void)munmap(WINPR_CAST_CONST_PTR_AWAY(persistent->map, void*), (size_t)persistent->fileSize);
+#endif
+	persistent->map = nullptr;
+}
+
+static BOOL persistent_cache_index_add(rdpPersistentCache* persistent,
+                                       const PERSISTENT_CACHE_INDEX_ENTRY* entry)
+{
 	WINPR_ASSERT(persistent);
 	WINPR_ASSERT(entry);
-	entry2.key64 = entry->key64;
-	entry2.width = entry->width;
-	entry2.height = entry->height;
-	entry2.size = entry->size;
-	entry2.flags = entry->flags;
 
-	if (!entry2.flags)
-		entry2.flags = 0x00000011;
+	if (persistent->count >= INT32_MAX)
+		return FALSE;
 
-	if (fwrite(&entry2, sizeof(entry2), 1, persistent->fp) != 1)
+	const size_t count = WINPR_ASSERTING_INT_CAST(size_t, persistent->count);
+	if (count >= persistent->indexSize)
+	{
+		const size_t size = (persistent->indexSize > 0) ? persistent->indexSize * 2 : 64;
+		PERSISTENT_CACHE_INDEX_ENTRY* index = (PERSISTENT_CACHE_INDEX_ENTRY*)realloc(
+		    persistent->index, size * sizeof(PERSISTENT_CACHE_INDEX_ENTRY));
+
+		if (!index)
+			return FALSE;
+
+		persistent->index = index;
+		persistent->indexSize = size;
+	}
+
+	persistent->index[count] = *entry;
+	persistent->count++;
+	return TRUE;
+}
+
+int persistent_cache_get_entry_info(rdpPersistentCache* persistent, size_t index,
+                                    PERSISTENT_CACHE_ENTRY* entry)
+{
+	WINPR_ASSERT(persistent);
+	WINPR_ASSERT(entry);
+
+	if (persistent->write || (persistent->count < 0) ||
+	    (index >= WINPR_ASSERTING_INT_CAST(size_t, persistent->count)))
 		return -1;
 
-	if (fwrite(entry->data, entry->size, 1, persistent->fp) != 1)
+	const PERSISTENT_CACHE_INDEX_ENTRY* cur = &persistent->index[index];
+	entry->key64 = cur->key64;
+	entry->width = cur->width;
+	entry->height = cur->height;
+	entry->size = cur->size;
+	entry->flags = cur->flags;
+	entry->data = nullptr;
+	return 1;
+}
+
+int persistent_cache_get_entry(rdpPersistentCache* persistent, size_t index,
+                               PERSISTENT_CACHE_ENTRY* entry)
+{
+	if (persistent_cache_get_entry_info(persistent, index, entry) < 1)
 		return -1;
 
-	if (0x4000 > entry->size)
+	const PERSISTENT_CACHE_INDEX_ENTRY* cur = &persistent->index[index];
+
+	/* bounds were checked against the file size when building the index */
+	if (persistent->map)
 	{
-		const size_t padding = 0x4000 - entry->size;
+		entry->data = WINPR_CAST_CONST_PTR_AWAY(&persistent->map[cur->offset], BYTE*);
+		return 1;
+	}
 
-		if (fwrite(persistent->bmpData, padding, 1, persistent->fp) != 1)
+	if (cur->size > persistent->bmpSize)
+	{
+		BYTE* bmpData = (BYTE*)winpr_aligned_recalloc(persistent->bmpData, cur->size,
+		                                              sizeof(BYTE), PERSIST_ALIGN);
+
+		if (!bmpData)
 			return -1;
+
+		persistent->bmpData = bmpData;
+		persistent->bmpSize = cur->size;
 	}
 
-	persistent->count++;
+	if (!persistent_cache_read_at(persistent, cur->offset, persistent->bmpData, cur->size))
+		return -1;
 
+	entry->data = persistent->bmpData;
 	return 1;
 }
 
-static int persistent_cache_read_v2(rdpPersistentCache* persistent)
+static int persistent_cache_key_compare(const void* pa, const void* pb)
+{
+	const PERSISTENT_CACHE_KEY* a = pa;
+	const PERSISTENT_CACHE_KEY* b = pb;
+
+	if (a->key64 != b->key64)
+		return (a->key64 < b->key64) ? -1 : 1;
+
+	/* keep the first entry of duplicate keys in front */
+	if (a->index != b->index)
+		return (a->index < b->index) ? -1 : 1;
+	return 0;
+}
+
+SSIZE_T persistent_cache_find_entry(rdpPersistentCache* persistent, UINT64 key64)
 {
 	WINPR_ASSERT(persistent);
-	while (1)
+
+	if (persistent->write || (persistent->count <= 0))
+		return -1;
+
+	const size_t count = WINPR_ASSERTING_INT_CAST(size_t, persistent->count);
+
+	/* the sorted key table is only needed for lookups, build it on first use */
+	if (!persistent->keys)
 	{
-		PERSISTENT_CACHE_ENTRY_V2 entry = WINPR_C_ARRAY_INIT;
+		persistent->keys = (PERSISTENT_CACHE_KEY*)calloc(count, sizeof(PERSISTENT_CACHE_KEY));
+		if (!persistent->keys)
+			return -1;
 
-		if (fread((void*)&entry, sizeof(entry), 1, persistent->fp) != 1)
-			break;
+		for (size_t x = 0; x < count; x++)
+		{
+			persistent->keys[x].key64 = persistent->index[x].key64;
+			persistent->keys[x].index = x;
+		}
 
-		if (fseek(persistent->fp, 0x4000, SEEK_CUR) != 0)
-			break;
+		qsort(persistent->keys, count, sizeof(PERSISTENT_CACHE_KEY),
+		      persistent_cache_key_compare);
+	}
 
-		persistent->count++;
+	size_t lo = 0;
+	size_t hi = count;
+	while (lo < hi)
+	{
+		const size_t mid = lo + (hi - lo) / 2;
+		if (persistent->keys[mid].key64 < key64)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	return 1;
+	if ((lo >= count) || (persistent->keys[lo].key64 != key64))
+		return -1;
+
+	return WINPR_ASSERTING_INT_CAST(SSIZE_T, persistent->keys[lo].index);
 }
 
-static int persistent_cache_read_entry_v3(rdpPersistentCache* persistent,
-                                          PERSISTENT_CACHE_ENTRY* entry)
+static int persistent_cache_write_entry_v2(rdpPersistentCache* persistent,
+                                           const PERSISTENT_CACHE_ENTRY* entry)
 {
-	PERSISTENT_CACHE_ENTRY_V3 entry3 = WINPR_C_ARRAY_INIT;
+	PERSISTENT_CACHE_ENTRY_V2 entry2 = WINPR_C_ARRAY_INIT;
 
 	WINPR_ASSERT(persistent);
 	WINPR_ASSERT(entry);
+	entry2.key64 = entry->key64;
+	entry2.width = entry->width;
+	entry2.height = entry->height;
+	entry2.size = entry->size;
+	entry2.flags = entry->flags;
+
+	if (!entry2.flags)
+		entry2.flags = 0x00000011;
 
-	if (fread(&entry3, sizeof(entry3), 1, persistent->fp) != 1)
+	if (fwrite(&entry2, sizeof(entry2), 1, persistent->fp) != 1)
 		return -1;
 
-	entry->key64 = entry3.key64;
-	entry->width = entry3.width;
-	entry->height = entry3.height;
-	const UINT64 size = 4ull * entry3.width * entry3.height;
-	if (size > UINT32_MAX)
+	if (fwrite(entry->data, entry->size, 1, persistent->fp) != 1)
 		return -1;
-	entry->flags = 0;
 
-	if (size > persistent->bmpSize)
+	if (0x4000 > entry->size)
 	{
-		persistent->bmpSize = size;
-		BYTE* bmpData = (BYTE*)winpr_aligned_recalloc(persistent->bmpData, persistent->bmpSize,
-		                                              sizeof(BYTE), PERSIST_ALIGN);
+		const size_t padding = 0x4000 - entry->size;
 
-		if (!bmpData)
+		if (fwrite(persistent->bmpData, padding, 1, persistent->fp) != 1)
 			return -1;
-
-		persistent->bmpData = bmpData;
 	}
-	entry->size = WINPR_ASSERTING_INT_CAST(UINT32, size);
 
-	entry->data = persistent->bmpData;
-
-	if (fread((void*)entry->data, entry->size, 1, persistent->fp) != 1)
-		return -1;
+	persistent->count++;
 
 	return 1;
 }
@@ -196,57 +372,112 @@ static int persistent_cache_write_entry_v3(rdpPersistentCache* persistent,
 	return 1;
 }
 
-static int persistent_cache_read_v3(rdpPersistentCache* persistent)
+int persistent_cache_read_entry(rdpPersistentCache* persistent, PERSISTENT_CACHE_ENTRY* entry)
 {
 	WINPR_ASSERT(persistent);
-	while (1)
-	{
-		PERSISTENT_CACHE_ENTRY_V3 entry = WINPR_C_ARRAY_INIT;
-
-		if (fread((void*)&entry, sizeof(entry), 1, persistent->fp) != 1)
-			break;
-
-		if (_fseeki64(persistent->fp, (4LL * entry.width * entry.height), SEEK_CUR) != 0)
-			break;
+	WINPR_ASSERT(entry);
 
-		persistent->count++;
-	}
+	if (persistent_cache_get_entry(persistent, persistent->cursor, entry) < 1)
+		return -1;
 
+	persistent->cursor++;
 	return 1;
 }
 
-int persistent_cache_read_entry(rdpPersistentCache* persistent, PERSISTENT_CACHE_ENTRY* entry)
+int persistent_cache_write_entry(rdpPersistentCache* persistent,
+                                 const PERSISTENT_CACHE_ENTRY* entry)
 {
+	int rc = -1;
+
 	WINPR_ASSERT(persistent);
 	WINPR_ASSERT(entry);
 
 	if (persistent->version == 3)
-		return persistent_cache_read_entry_v3(persistent, entry);
+		rc = persistent_cache_write_entry_v3(persistent, entry);
 	else if (persistent->version == 2)
-		return persistent_cache_read_entry_v2(persistent, entry);
+		rc = persistent_cache_write_entry_v2(persistent, entry);
 
-	return -1;
+	if (rc < 1)
+		persistent->failed = TRUE;
+	return rc;
 }
 
-int persistent_cache_write_entry(rdpPersistentCache* persistent,
-                                 const PERSISTENT_CACHE_ENTRY* entry)
+static BOOL persistent_cache_index_v2(rdpPersistentCache* persistent)
 {
 	WINPR_ASSERT(persistent);
-	WINPR_ASSERT(entry);
 
-	if (persistent->version == 3)
-		return persistent_cache_write_entry_v3(persistent, entry);
-	else if (persistent->version == 2)
-		return persistent_cache_write_entry_v2(persistent, entry);
+	UINT64 offset = 0;
+	while (offset < persistent->fileSize)
+	{
+		PERSISTENT_CACHE_ENTRY_V2 entry2 = WINPR_C_ARRAY_INIT;
+
+		/* a truncated trailing entry is ignored, like a short read did before */
+		if (!persistent_cache_read_at(persistent, offset, &entry2, sizeof(entry2)))
+			break;
 
-	return -1;
+		offset += sizeof(entry2);
+		if ((persistent->fileSize - offset) < 0x4000)
+			break;
+
+		const UINT64 size = 4ull * entry2.width * entry2.height;
+		if (size > 0x4000)
+		{
+			WLog_WARN(TAG, "invalid v2 cache entry %" PRIu16 "x%" PRIu16 ", ignoring remainder",
+			          entry2.width, entry2.height);
+			break;
+		}
+
+		const PERSISTENT_CACHE_INDEX_ENTRY cur = { .key64 = entry2.key64,
+			                                       .offset = offset,
+			                                       .size = (UINT32)size,
+			                                       .flags = entry2.flags,
+			                                       .width = entry2.width,
+			                                       .height = entry2.height };
+		if (!persistent_cache_index_add(persistent, &cur))
+			return FALSE;
+
+		offset += 0x4000;
+	}
+
+	return TRUE;
+}
+
+static BOOL persistent_cache_index_v3(rdpPersistentCache* persistent)
+{
+	WINPR_ASSERT(persistent);
+
+	UINT64 offset = sizeof(PERSISTENT_CACHE_HEADER_V3);
+	while (offset < persistent->fileSize)
+	{
+		PERSISTENT_CACHE_ENTRY_V3 entry3 = WINPR_C_ARRAY_INIT;
+
+		if (!persistent_cache_read_at(persistent, offset, &entry3, sizeof(entry3)))
+			break;
+
+		offset += sizeof(entry3);
+
+		const UINT64 size = 4ull * entry3.width * entry3.height;
+		if ((size > UINT32_MAX) || ((persistent->fileSize - offset) < size))
+			break;
+
+		const PERSISTENT_CACHE_INDEX_ENTRY cur = { .key64 = entry3.key64,
+			                                       .offset = offset,
+			                                       .size = (UINT32)size,
+			                                       .flags = 0,
+			                                       .width = entry3.width,
+			                                       .height = entry3.height };
+		if (!persistent_cache_index_add(persistent, &cur))
+			return FALSE;
+
+		offset += size;
+	}
+
+	return TRUE;
 }
 
 static int persistent_cache_open_read(rdpPersistentCache* persistent)
 {
 	BYTE sig[8] = WINPR_C_ARRAY_INIT;
-	int status = 1;
-	long offset = 0;
 
 	WINPR_ASSERT(persistent);
 	persistent->fp = winpr_fopen(persistent->filename, "rb");
@@ -254,7 +485,20 @@ static int persistent_cache_open_read(rdpPersistentCache* persistent)
 	if (!persistent->fp)
 		return -1;
 
-	if (fread(sig, 8, 1, persistent->fp) != 1)
+	if (_fseeki64(persistent->fp, 0, SEEK_END) != 0)
+		return -1;
+
+	const INT64 fileSize = _ftelli64(persistent->fp);
+	if (fileSize < 0)
+		return -1;
+	persistent->fileSize = (UINT64)fileSize;
+
+	/* map the whole file, entry data is then referenced in place and only paged in
+	 * when it is actually used. stdio is the fallback if mapping is not possible. */
+	if (!persistent_cache_map(persistent))
+		WLog_DBG(TAG, "mapping %s failed, falling back to buffered reads", persistent->filename);
+
+	if (!persistent_cache_read_at(persistent, 0, sig, sizeof(sig)))
 		return -1;
 
 	if (memcmp(sig, sig_str, sizeof(sig_str)) == 0)
@@ -262,34 +506,29 @@ static int persistent_cache_open_read(rdpPersistentCache* persistent)
 	else
 		persistent->version = 2;
 
-	(void)fseek(persistent->fp, 0, SEEK_SET);
-
+	BOOL rc = FALSE;
 	if (persistent->version == 3)
-	{
-		PERSISTENT_CACHE_HEADER_V3 header;
-
-		if (fread(&header, sizeof(header), 1, persistent->fp) != 1)
-			return -1;
-
-		status = persistent_cache_read_v3(persistent);
-		offset = sizeof(header);
-	}
+		rc = persistent_cache_index_v3(persistent);
 	else
-	{
-		status = persistent_cache_read_v2(persistent);
-		offset = 0;
-	}
+		rc = persistent_cache_index_v2(persistent);
 
-	(void)fseek(persistent->fp, offset, SEEK_SET);
+	if (!rc)
+		return -1;
 
-	return status;
+	persistent->cursor = 0;
+	return 1;
 }
 
 static int persistent_cache_open_write(rdpPersistentCache* persistent)
 {
 	WINPR_ASSERT(persistent);
 
-	persistent->fp = winpr_fopen(persistent->filename, "w+b");
+	/* readers may still have the current file mapped, never truncate it in place */
+	size_t len = 0;
+	if (winpr_asprintf(&persistent->tmpname, &len, "%s.tmp", persistent->filename) < 0)
+		return -1;
+
+	persistent->fp = winpr_fopen(persistent->tmpname, "w+b");
 
 	if (!persistent->fp)
 		return -1;
@@ -325,7 +564,10 @@ int persistent_cache_open(rdpPersistentCache* persistent, const char* filename,
 	{
 		WINPR_ASSERT(version <= INT32_MAX);
 		persistent->version = (int)version;
-		return persistent_cache_open_write(persistent);
+		const int rc = persistent_cache_open_write(persistent);
+		if (rc < 1)
+			persistent->failed = TRUE;
+		return rc;
 	}
 
 	return persistent_cache_open_read(persistent);
@@ -333,14 +575,43 @@ int persistent_cache_open(rdpPersistentCache* persistent, const char* filename,
 
 int persistent_cache_close(rdpPersistentCache* persistent)
 {
+	int rc = 1;
+
 	WINPR_ASSERT(persistent);
+
+	persistent_cache_unmap(persistent);
+
+	free(persistent->index);
+	persistent->index = nullptr;
+	persistent->indexSize = 0;
+	free(persistent->keys);
+	persistent->keys = nullptr;
+	persistent->cursor = 0;
+
 	if (persistent->fp)
 	{
-		(void)fclose(persistent->fp);
+		if (fclose(persistent->fp) != 0)
+			persistent->failed = TRUE;
 		persistent->fp = nullptr;
 	}
 
-	return 1;
+	if (persistent->tmpname)
+	{
+		if (persistent->failed ||
+		    !winpr_MoveFileEx(persistent->tmpname, persistent->filename,
+		                      MOVEFILE_REPLACE_EXISTING))
+		{
+			WLog_WARN(TAG, "failed to update %s, keeping the previous cache",
+			          persistent->filename);
+			(void)winpr_DeleteFile(persistent->tmpname);
+			rc = -1;
+		}
+
+		free(persistent->tmpname);
+		persistent->tmpname = nullptr;
+	}
+
+	return rc;
 }
 
 rdpPersistentCache* persistent_cache_new(void)
@@ -0,0 +1,306 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Bitmap Cache Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/file.h>
+#include <winpr/path.h>
+#include <winpr/cast.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/cache/persistent.h>
+
+#define TEST_ENTRY_COUNT 37
+
+typedef struct
+{
+	UINT64 key64;
+	UINT16 width;
+	UINT16 height;
+	BYTE data[0x4000];
+} test_entry;
+
+static void fill_entries(test_entry* entries, size_t count, UINT32 seed)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		test_entry* cur = &entries[x];
+
+		/* v2 entries are limited to 64x64 pixels */
+		cur->key64 = 0x1000000000000001ull * (x + 1) + seed;
+		cur->width = (UINT16)(1 + (x * 7 + seed) % 64);
+		cur->height = (UINT16)(1 + (x * 13 + seed) % 64);
+
+		for (size_t y = 0; y < sizeof(cur->data); y++)
+			cur->data[y] = (BYTE)(x * 31 + y + seed);
+	}
+}
+
+static BOOL write_cache(const char* name, UINT32 version, const test_entry* entries, size_t count)
+{
+	BOOL rc = FALSE;
+	rdpPersistentCache* persistent = persistent_cache_new();
+
+	if (!persistent)
+		return FALSE;
+
+	if (persistent_cache_open(persistent, name, TRUE, version) < 1)
+		goto fail;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const test_entry* cur = &entries[x];
+		const PERSISTENT_CACHE_ENTRY entry = { .key64 = cur->key64,
+			                                   .width = cur->width,
+			                                   .height = cur->height,
+			                                   .size = 4u * cur->width * cur->height,
+			                                   .flags = 0,
+			                                   .data = WINPR_CAST_CONST_PTR_AWAY(&cur->data[0],
+			                                                                     BYTE*) };
+
+		if (persistent_cache_write_entry(persistent, &entry) < 1)
+			goto fail;
+	}
+
+	rc = persistent_cache_close(persistent) > 0;
+
+fail:
+	persistent_cache_free(persistent);
+	return rc;
+}
+
+static BOOL check_entry(const PERSISTENT_CACHE_ENTRY* entry, const test_entry* expect,
+                        BOOL withData)
+{
+	if ((entry->key64 != expect->key64) || (entry->width != expect->width) ||
+	    (entry->height != expect->height) || (entry->size != 4u * expect->width * expect->height))
+	{
+		(void)fprintf(stderr, "entry mismatch: key 0x%016" PRIx64 " %" PRIu16 "x%" PRIu16 "\n",
+		              entry->key64, entry->width, entry->height);
+		return FALSE;
+	}
+
+	if (!withData)
+		return entry->data == nullptr;
+
+	if (!entry->data || (memcmp(entry->data, expect->data, entry->size) != 0))
+	{
+		(void)fprintf(stderr, "data mismatch: key 0x%016" PRIx64 "\n", entry->key64);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL check_cache(const char* name, int version, const test_entry* entries, size_t count)
+{
+	BOOL rc = FALSE;
+	rdpPersistentCache* persistent = persistent_cache_new();
+
+	if (!persistent)
+		return FALSE;
+
+	if (persistent_cache_open(persistent, name, FALSE, 0) < 1)
+		goto fail;
+
+	if (persistent_cache_get_version(persistent) != version)
+		goto fail;
+
+	if (persistent_cache_get_count(persistent) != (int)count)
+		goto fail;
+
+	/* random access in reverse order, metadata only and with data */
+	for (size_t x = count; x > 0; x--)
+	{
+		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+
+		if (persistent_cache_get_entry_info(persistent, x - 1, &entry) < 1)
+			goto fail;
+		if (!check_entry(&entry, &entries[x - 1], FALSE))
+			goto fail;
+
+		if (persistent_cache_get_entry(persistent, x - 1, &entry) < 1)
+			goto fail;
+		if (!check_entry(&entry, &entries[x - 1], TRUE))
+			goto fail;
+	}
+
+	{
+		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+		if (persistent_cache_get_entry(persistent, count, &entry) > 0)
+			goto fail;
+	}
+
+	/* key lookup */
+	for (size_t x = 0; x < count; x++)
+	{
+		const SSIZE_T index = persistent_cache_find_entry(persistent, entries[x].key64);
+		if ((index < 0) || ((size_t)index != x))
+			goto fail;
+	}
+
+	if (persistent_cache_find_entry(persistent, 0x42) >= 0)
+		goto fail;
+
+	/* sequential reads still start at the first entry */
+	for (size_t x = 0; x < count; x++)
+	{
+		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+
+		if (persistent_cache_read_entry(persistent, &entry) < 1)
+			goto fail;
+		if (!check_entry(&entry, &entries[x], TRUE))
+			goto fail;
+	}
+
+	{
+		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+		if (persistent_cache_read_entry(persistent, &entry) > 0)
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	persistent_cache_free(persistent);
+	return rc;
+}
+
+static BOOL truncate_cache(const char* name, INT64 remove)
+{
+	BOOL rc = FALSE;
+	BYTE* data = nullptr;
+	FILE* fp = winpr_fopen(name, "rb");
+
+	if (!fp)
+		return FALSE;
+
+	if (_fseeki64(fp, 0, SEEK_END) != 0)
+		goto fail;
+
+	const INT64 size = _ftelli64(fp);
+	if ((size < remove) || (_fseeki64(fp, 0, SEEK_SET) != 0))
+		goto fail;
+
+	const size_t length = (size_t)(size - remove);
+	data = calloc(length + 1, sizeof(BYTE));
+	if (!data || (fread(data, length, 1, fp) != 1))
+		goto fail;
+
+	(void)fclose(fp);
+	fp = winpr_fopen(name, "wb");
+	if (!fp || (fwrite(data, length, 1, fp) != 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (fp)
+		(void)fclose(fp);
+	free(data);
+	return rc;
+}
+
+static BOOL test_persistent_cache(const char* name, UINT32 version)
+{
+	BOOL rc = FALSE;
+	rdpPersistentCache* reader = nullptr;
+	test_entry* first = calloc(TEST_ENTRY_COUNT, sizeof(test_entry));
+	test_entry* second = calloc(TEST_ENTRY_COUNT, sizeof(test_entry));
+
+	if (!first || !second)
+		goto fail;
+
+	fill_entries(first, TEST_ENTRY_COUNT, 0);
+	fill_entries(second, TEST_ENTRY_COUNT, 5);
+
+	if (!write_cache(name, version, first, TEST_ENTRY_COUNT))
+		goto fail;
+
+	if (!check_cache(name, (int)version, first, TEST_ENTRY_COUNT))
+		goto fail;
+
+#if !defined(_WIN32)
+	/* replace the file while a reader still has it open, the reader keeps its view.
+	 * Windows does not allow replacing a mapped file. */
+	reader = persistent_cache_new();
+	if (!reader || (persistent_cache_open(reader, name, FALSE, 0) < 1))
+		goto fail;
+
+	if (!write_cache(name, version, second, TEST_ENTRY_COUNT / 2))
+		goto fail;
+
+	{
+		PERSISTENT_CACHE_ENTRY entry = WINPR_C_ARRAY_INIT;
+		if (persistent_cache_get_entry(reader, TEST_ENTRY_COUNT - 1, &entry) < 1)
+			goto fail;
+		if (!check_entry(&entry, &first[TEST_ENTRY_COUNT - 1], TRUE))
+			goto fail;
+	}
+
+	persistent_cache_free(reader);
+	reader = nullptr;
+#else
+	if (!write_cache(name, version, second, TEST_ENTRY_COUNT / 2))
+		goto fail;
+#endif
+
+	if (!check_cache(name, (int)version, second, TEST_ENTRY_COUNT / 2))
+		goto fail;
+
+	/* a truncated trailing entry is not indexed */
+	if (!truncate_cache(name, 3))
+		goto fail;
+
+	if (!check_cache(name, (int)version, second, TEST_ENTRY_COUNT / 2 - 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	persistent_cache_free(reader);
+	free(first);
+	free(second);
+	if (!rc)
+		(void)fprintf(stderr, "persistent cache v%" PRIu32 " test failed\n", version);
+	return rc;
+}
+
+int TestPersistentCache(int argc, char* argv[])
+{
+	int rc = -1;
+	char name[64] = WINPR_C_ARRAY_INIT;
+	char* path = nullptr;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	(void)_snprintf(name, sizeof(name), "TestPersistentCache-%" PRIu32 "-%" PRIu32 ".bmc",
+	                GetCurrentProcessId(), (UINT32)winpr_GetTickCount64NS());
+	path = GetKnownSubPath(KNOWN_PATH_TEMP, name);
+	if (!path)
+		return -1;
+
+	if (!test_persistent_cache(path, 3))
+		goto fail;
+
+	if (!test_persistent_cache(path, 2))
+		goto fail;
+
+	rc = 0;
+fail:
+	(void)winpr_DeleteFile(path);
+	free(path);
+	return rc;
+}
@@ -22,1094 +22,816 @@
 
 #include <freerdp/config.h>
 
+#include <freerdp/log.h>
 #include <freerdp/codec/bitmap.h>
-#include <freerdp/codec/planar.h>
 
-struct count
+#include "../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED) && \
+    (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define BITMAP_SSE2
+#endif
+
+#define TAG FREERDP_TAG("codec")
+
+/* order header bytes */
+#define BITMAP_REGULAR_BG_RUN 0x00
+#define BITMAP_REGULAR_FG_RUN 0x20
+#define BITMAP_REGULAR_FGBG_IMAGE 0x40
+#define BITMAP_REGULAR_COLOR_RUN 0x60
+#define BITMAP_REGULAR_COLOR_IMAGE 0x80
+#define BITMAP_LITE_SET_FG_FG_RUN 0xC0
+#define BITMAP_LITE_SET_FG_FGBG_IMAGE 0xD0
+#define BITMAP_LITE_DITHERED_RUN 0xE0
+#define BITMAP_MEGA_MEGA_BG_RUN 0xF0
+#define BITMAP_MEGA_MEGA_FG_RUN 0xF1
+#define BITMAP_MEGA_MEGA_FGBG_IMAGE 0xF2
+#define BITMAP_MEGA_MEGA_COLOR_RUN 0xF3
+#define BITMAP_MEGA_MEGA_COLOR_IMAGE 0xF4
+#define BITMAP_MEGA_MEGA_SET_FG_RUN 0xF6
+#define BITMAP_MEGA_MEGA_SET_FGBG_IMAGE 0xF7
+#define BITMAP_MEGA_MEGA_DITHERED_RUN 0xF8
+#define BITMAP_SPECIAL_FGBG_1 0xF9
+#define BITMAP_SPECIAL_FGBG_2 0xFA
+#define BITMAP_SPECIAL_WHITE 0xFD
+#define BITMAP_SPECIAL_BLACK 0xFE
+
+#define BITMAP_MASK_SPECIAL_FGBG_1 0x03
+#define BITMAP_MASK_SPECIAL_FGBG_2 0x05
+
+/* lines are only added while the uncompressed data of a call stays below 32K */
+#define BITMAP_MAX_RAW_SIZE 32768
+
+/* color image headers are 1, 2 or 3 bytes long */
+#define BITMAP_IMAGE_CLASSES 3
+
+typedef enum
 {
-	ALIGN64 UINT16 bicolor_count;
-	ALIGN64 UINT16 fill_count;
-	ALIGN64 UINT16 color_count;
-	ALIGN64 UINT16 mix_count;
-	ALIGN64 UINT16 fom_count;
-	ALIGN64 size_t fom_mask_len;
-	ALIGN64 BOOL bicolor_spin;
-};
+	BITMAP_ORDER_NONE,
+	BITMAP_ORDER_BG_RUN,
+	BITMAP_ORDER_FG_RUN,
+	BITMAP_ORDER_SET_FG_RUN,
+	BITMAP_ORDER_DITHERED_RUN,
+	BITMAP_ORDER_COLOR_RUN,
+	BITMAP_ORDER_FGBG_IMAGE,
+	BITMAP_ORDER_SET_FGBG_IMAGE,
+	BITMAP_ORDER_COLOR_IMAGE,
+	BITMAP_ORDER_SPECIAL_FGBG_1,
+	BITMAP_ORDER_SPECIAL_FGBG_2,
+	BITMAP_ORDER_WHITE,
+	BITMAP_ORDER_BLACK
+} BITMAP_ORDER;
+
+/* Cheapest known way to encode all pixels in front of a position */
+typedef struct
+{
+	UINT32 cost;  /* encoded size in bytes */
+	UINT32 fgPel; /* foreground color of the decoder after the last order */
+	UINT16 start; /* first pixel of the last order */
+	BYTE order;   /* BITMAP_ORDER of the last order */
+	BYTE bgRun;   /* the last order is a background run */
+} BITMAP_NODE;
+
+/* A run order that may end at the current position, see bitmap_run_step */
+typedef struct
+{
+	BOOL active;
+	size_t start;
+	UINT32 key;
+} BITMAP_RUN;
 
-static inline void reset_counts(struct count* counts)
+typedef struct
+{
+	size_t width; /* pixels per line including the padding */
+	size_t count; /* pixels to encode */
+	UINT32 pixelSize;
+	UINT32 white;
+
+	UINT32* pixels;
+	UINT32* xored;     /* pixel XOR the pixel above, the pixel itself on the first line */
+	UINT16* dithered;  /* length of the two pixel pattern starting at a pixel */
+	UINT32* fgbgPel[2];    /* foreground of the longest FGBG image starting at a pixel */
+	UINT16* fgbgLength[2]; /* [0] with first line semantics, [1] for the other lines */
+	BITMAP_NODE* nodes;
+	BITMAP_NODE* images[BITMAP_IMAGE_CLASSES]; /* cheapest paths ending with a color image */
+	UINT16* links;
+} BITMAP_ENCODER;
+
+static inline UINT32 bitmap_regular_header_size(size_t length)
 {
-	const struct count empty = WINPR_C_ARRAY_INIT;
-	WINPR_ASSERT(counts);
-	*counts = empty;
+	if (length < 32)
+		return 1;
+	if (length < 256 + 32)
+		return 2;
+	return 3;
 }
 
-static inline UINT16 GETPIXEL16(const void* WINPR_RESTRICT d, UINT32 x, UINT32 y, UINT32 w)
+static inline UINT32 bitmap_lite_header_size(size_t length)
 {
-	const BYTE* WINPR_RESTRICT src = (const BYTE*)d + ((y * w + x) * sizeof(UINT16));
-	return WINPR_ASSERTING_INT_CAST(UINT16, ((UINT16)src[1] << 8) | (UINT16)src[0]);
+	if (length < 16)
+		return 1;
+	if (length < 256 + 16)
+		return 2;
+	return 3;
 }
 
-static inline UINT32 GETPIXEL32(const void* WINPR_RESTRICT d, UINT32 x, UINT32 y, UINT32 w)
+/* FGBG images store multiples of 8 in the header, other lengths in an extra byte */
+static inline UINT32 bitmap_fgbg_header_size(size_t length, size_t maxShort)
 {
-	const BYTE* WINPR_RESTRICT src = (const BYTE*)d + ((y * w + x) * sizeof(UINT32));
-	return (((UINT32)src[3]) << 24) | (((UINT32)src[2]) << 16) | (((UINT32)src[1]) << 8) |
-	       (src[0] & 0xFF);
+	if (((length % 8) == 0) && ((length / 8) < maxShort))
+		return 1;
+	if (length <= 256)
+		return 2;
+	return 3;
 }
 
-/*****************************************************************************/
-static inline UINT16 IN_PIXEL16(const void* WINPR_RESTRICT in_ptr, UINT32 in_x, UINT32 in_y,
-                                UINT32 in_w, UINT16 in_last_pixel)
+static inline void bitmap_write_pixel(wStream* WINPR_RESTRICT s, UINT32 pixelSize, UINT32 pixel)
 {
-	if (in_ptr == nullptr)
-		return 0;
-	else if (in_x < in_w)
-		return GETPIXEL16(in_ptr, in_x, in_y, in_w);
+	if (pixelSize == 3)
+	{
+		Stream_Write_UINT8(s, pixel & 0xFF);
+		Stream_Write_UINT8(s, (pixel >> 8) & 0xFF);
+		Stream_Write_UINT8(s, (pixel >> 16) & 0xFF);
+	}
 	else
-		return in_last_pixel;
+		Stream_Write_UINT16(s, pixel & 0xFFFF);
 }
 
-/*****************************************************************************/
-static inline UINT32 IN_PIXEL32(const void* WINPR_RESTRICT in_ptr, UINT32 in_x, UINT32 in_y,
-                                UINT32 in_w, UINT32 in_last_pixel)
+static inline void bitmap_write_regular(wStream* WINPR_RESTRICT s, BYTE code, BYTE mega,
+                                        size_t length)
 {
-	if (in_ptr == nullptr)
-		return 0;
-	else if (in_x < in_w)
-		return GETPIXEL32(in_ptr, in_x, in_y, in_w);
+	if (length < 32)
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, code | length));
+	else if (length < 256 + 32)
+	{
+		Stream_Write_UINT8(s, code);
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, length - 32));
+	}
 	else
-		return in_last_pixel;
+	{
+		Stream_Write_UINT8(s, mega);
+		Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, length));
+	}
 }
 
-/*****************************************************************************/
-/* color */
-static inline UINT16 out_color_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                       UINT16 in_data)
+static inline void bitmap_write_lite(wStream* WINPR_RESTRICT s, BYTE code, BYTE mega,
+                                     size_t length)
 {
-	if (in_count > 0)
+	if (length < 16)
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, code | length));
+	else if (length < 256 + 16)
 	{
-		if (in_count < 32)
-		{
-			const BYTE temp = ((0x3u << 5) | in_count) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x60);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf3);
-			Stream_Write_UINT16(in_s, in_count);
-		}
-
-		Stream_Write_UINT16(in_s, in_data);
+		Stream_Write_UINT8(s, code);
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, length - 16));
+	}
+	else
+	{
+		Stream_Write_UINT8(s, mega);
+		Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, length));
 	}
-
-	return 0;
 }
 
-/*****************************************************************************/
-/* color */
-static inline UINT16 out_color_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                       UINT32 in_data)
+static inline void bitmap_write_fgbg(wStream* WINPR_RESTRICT s, BYTE code, BYTE mega,
+                                     size_t maxShort, size_t length)
 {
-	if (in_count > 0)
+	if (((length % 8) == 0) && ((length / 8) < maxShort))
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, code | (length / 8)));
+	else if (length <= 256)
 	{
-		if (in_count < 32)
-		{
-			const BYTE temp = ((0x3u << 5) | in_count) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x60);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf3);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+		Stream_Write_UINT8(s, code);
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, length - 1));
+	}
+	else
+	{
+		Stream_Write_UINT8(s, mega);
+		Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, length));
+	}
+}
+
+/* number of leading elements with a[x] == b[x] */
+static inline size_t bitmap_match_length(const UINT32* a, const UINT32* b, size_t count)
+{
+	size_t x = 0;
 
-		Stream_Write_UINT8(in_s, in_data & 0xFF);
+	/* most runs are short, do not bother with vectors for those */
+	while ((x < MIN(count, 4)) && (a[x] == b[x]))
+		x++;
+	if (x < MIN(count, 4))
+		return x;
 
-		Stream_Write_UINT8(in_s, (in_data >> 8) & 0xFF);
-		Stream_Write_UINT8(in_s, (in_data >> 16) & 0xFF);
+#if defined(BITMAP_SSE2)
+	for (; x + 4 <= count; x += 4)
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i*)&a[x]);
+		const __m128i vb = _mm_loadu_si128((const __m128i*)&b[x]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(va, vb)) != 0xFFFF)
+			break;
 	}
+#endif
 
-	return 0;
+	while ((x < count) && (a[x] == b[x]))
+		x++;
+	return x;
 }
 
-/*****************************************************************************/
-/* copy */
-static inline UINT16 out_copy_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                      wStream* WINPR_RESTRICT in_data)
-
+static void bitmap_read_line(UINT32* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src,
+                             size_t width, size_t end, UINT32 pixelSize)
 {
-	if (in_count > 0)
+	size_t x = 0;
+
+	if (pixelSize == 3)
 	{
-		if (in_count < 32)
+		/* 24 bpp input is 32 bpp with the top byte ignored */
+#if defined(BITMAP_SSE2)
+		const __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+		for (; x + 4 <= width; x += 4)
 		{
-			const BYTE temp = ((0x4u << 5) | in_count) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
+			const __m128i v = _mm_loadu_si128((const __m128i*)&src[x * 4]);
+			_mm_storeu_si128((__m128i*)&dst[x], _mm_and_si128(v, mask));
 		}
-		else if (in_count < 256 + 32)
+#endif
+		for (; x < width; x++)
 		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x80);
-			Stream_Write_UINT8(in_s, temp);
+			const BYTE* px = &src[x * 4];
+			dst[x] = ((UINT32)px[2] << 16) | ((UINT32)px[1] << 8) | px[0];
 		}
-		else
+	}
+	else
+	{
+#if defined(BITMAP_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 8 <= width; x += 8)
 		{
-			Stream_Write_UINT8(in_s, 0xf4);
-			Stream_Write_UINT16(in_s, in_count);
+			const __m128i v = _mm_loadu_si128((const __m128i*)&src[x * 2]);
+			_mm_storeu_si128((__m128i*)&dst[x], _mm_unpacklo_epi16(v, zero));
+			_mm_storeu_si128((__m128i*)&dst[x + 4], _mm_unpackhi_epi16(v, zero));
 		}
-
-		Stream_Write(in_s, Stream_Buffer(in_data), 2ULL * in_count);
+#endif
+		for (; x < width; x++)
+			dst[x] = ((UINT32)src[x * 2 + 1] << 8) | src[x * 2];
 	}
 
-	Stream_ResetPosition(in_data);
-	return 0;
+	/* pixels right of the bitmap repeat the last one */
+	const UINT32 last = (width > 0) ? dst[width - 1] : 0;
+	for (x = width; x < end; x++)
+		dst[x] = last;
 }
 
-/*****************************************************************************/
-/* copy */
-static inline UINT16 out_copy_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                      wStream* WINPR_RESTRICT in_data)
+static void bitmap_xor_lines(UINT32* WINPR_RESTRICT dst, const UINT32* WINPR_RESTRICT pixels,
+                             size_t width, size_t count)
 {
-	if (in_count > 0)
-	{
-		if (in_count < 32)
-		{
-			const BYTE temp = ((0x4u << 5) | in_count) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x80);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf4);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+	size_t x = MIN(width, count);
 
-		Stream_Write(in_s, Stream_Pointer(in_data), 3ULL * in_count);
+	memcpy(dst, pixels, x * sizeof(UINT32));
+
+#if defined(BITMAP_SSE2)
+	for (; x + 4 <= count; x += 4)
+	{
+		const __m128i cur = _mm_loadu_si128((const __m128i*)&pixels[x]);
+		const __m128i above = _mm_loadu_si128((const __m128i*)&pixels[x - width]);
+		_mm_storeu_si128((__m128i*)&dst[x], _mm_xor_si128(cur, above));
 	}
+#endif
 
-	Stream_ResetPosition(in_data);
-	return 0;
+	for (; x < count; x++)
+		dst[x] = pixels[x] ^ pixels[x - width];
 }
 
-/*****************************************************************************/
-/* bicolor */
-static inline UINT16 out_bicolor_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                         UINT16 in_color1, UINT16 in_color2)
+/* length of the A B A B ... pattern starting at each pixel */
+static void bitmap_find_dithered(UINT16* WINPR_RESTRICT dithered, const UINT32* pixels,
+                                 size_t count)
 {
-	if (in_count > 0)
+	size_t x = 0;
+
+	while (x < count)
 	{
-		if (in_count / 2 < 16)
-		{
-			const BYTE temp = ((0xe << 4) | (in_count / 2)) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count / 2 < 256 + 16)
+		const size_t left = count - x;
+		if (left < 2)
 		{
-			const BYTE temp = (in_count / 2 - 16) & 0xFF;
-			Stream_Write_UINT8(in_s, 0xe0);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf8);
-			Stream_Write_UINT16(in_s, in_count / 2);
+			dithered[x++] = 1;
+			continue;
 		}
 
-		Stream_Write_UINT16(in_s, in_color1);
-		Stream_Write_UINT16(in_s, in_color2);
+		const size_t match = bitmap_match_length(&pixels[x], &pixels[x + 2], left - 2);
+		for (size_t y = 0; y <= match; y++)
+			dithered[x + y] = WINPR_ASSERTING_INT_CAST(UINT16, match - y + 2);
+		x += match + 1;
 	}
-
-	return 0;
 }
 
-/*****************************************************************************/
-/* bicolor */
-static inline UINT16 out_bicolor_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                         UINT32 in_color1, UINT32 in_color2)
+/* Longest FGBG image starting at each pixel of [first, count). \b values are the pixels
+ * XOR the background, the foreground is the first non zero value of the image. */
+static void bitmap_find_fgbg(UINT32* WINPR_RESTRICT fgPels, UINT16* WINPR_RESTRICT lengths,
+                             const UINT32* WINPR_RESTRICT values, size_t first, size_t count)
 {
-	if (in_count > 0)
+	size_t zeros = 0;
+	size_t nextLength = 0;
+	UINT32 nextPel = 0;
+
+	for (size_t x = count; x > first; x--)
 	{
-		if (in_count / 2 < 16)
-		{
-			const BYTE temp = ((0xe << 4) | (in_count / 2)) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count / 2 < 256 + 16)
+		const size_t cur = x - 1;
+		const UINT32 value = values[cur];
+		size_t length = 0;
+
+		if (value == 0)
 		{
-			const BYTE temp = (in_count / 2 - 16) & 0xFF;
-			Stream_Write_UINT8(in_s, 0xe0);
-			Stream_Write_UINT8(in_s, temp);
+			if (nextLength > 0)
+				length = nextLength + 1;
+			zeros++;
 		}
 		else
 		{
-			Stream_Write_UINT8(in_s, 0xf8);
-			Stream_Write_UINT16(in_s, in_count / 2);
+			/* continue with the following image if it has the same foreground, otherwise
+			 * with the background pixels in front of it */
+			if ((nextLength > 0) && (nextPel == value))
+				length = nextLength + 1;
+			else
+				length = zeros + 1;
+			nextPel = value;
+			zeros = 0;
 		}
 
-		Stream_Write_UINT8(in_s, in_color1 & 0xFF);
-		Stream_Write_UINT8(in_s, (in_color1 >> 8) & 0xFF);
-		Stream_Write_UINT8(in_s, (in_color1 >> 16) & 0xFF);
-		Stream_Write_UINT8(in_s, in_color2 & 0xFF);
-		Stream_Write_UINT8(in_s, (in_color2 >> 8) & 0xFF);
-		Stream_Write_UINT8(in_s, (in_color2 >> 16) & 0xFF);
+		fgPels[cur] = nextPel;
+		lengths[cur] = WINPR_ASSERTING_INT_CAST(UINT16, length);
+		nextLength = length;
 	}
+}
 
-	return 0;
+static inline void bitmap_relax(BITMAP_NODE* WINPR_RESTRICT node, UINT32 cost, UINT32 fgPel,
+                                size_t start, BITMAP_ORDER order, BOOL bgRun)
+{
+	if (cost >= node->cost)
+		return;
+
+	node->cost = cost;
+	node->fgPel = fgPel;
+	node->start = WINPR_ASSERTING_INT_CAST(UINT16, start);
+	node->order = WINPR_ASSERTING_INT_CAST(BYTE, order);
+	node->bgRun = bgRun ? 1 : 0;
 }
 
-/*****************************************************************************/
-/* fill */
-static inline UINT16 out_fill_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s)
+/* Add pixel \b pos to a run. Any pixel of the current run is a possible start of an order
+ * ending at the next position, the one with the smallest \b key is kept. */
+static inline void bitmap_run_step(BITMAP_RUN* WINPR_RESTRICT run, BOOL member, BOOL continued,
+                                   BOOL candidate, size_t pos, UINT32 key)
 {
-	if (in_count > 0)
+	if (!member)
 	{
-		if (in_count < 32)
-		{
-			Stream_Write_UINT8(in_s, in_count & 0xFF);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x0);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf0);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+		run->active = FALSE;
+		return;
 	}
 
-	return 0;
-}
+	if (!run->active || !continued)
+	{
+		run->active = TRUE;
+		run->start = SIZE_MAX;
+	}
 
-/*****************************************************************************/
-/* fill */
-static inline UINT16 out_fill_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s)
-{
-	if (in_count > 0)
+	if (candidate && ((run->start == SIZE_MAX) || (key <= run->key)))
 	{
-		if (in_count < 32)
-		{
-			Stream_Write_UINT8(in_s, in_count & 0xFF);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x0);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf0);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+		run->start = pos;
+		run->key = key;
 	}
+}
 
-	return 0;
+static inline BOOL bitmap_run_valid(const BITMAP_RUN* WINPR_RESTRICT run)
+{
+	return run->active && (run->start != SIZE_MAX);
 }
 
-/*****************************************************************************/
-/* mix */
-static inline UINT16 out_counts_mix_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s)
+enum
 {
-	if (in_count > 0)
+	BITMAP_RUN_COLOR,
+	BITMAP_RUN_BG_FIRST_LINE,
+	BITMAP_RUN_BG,
+	BITMAP_RUN_FG_FIRST_LINE,
+	BITMAP_RUN_FG,
+	BITMAP_RUN_COUNT
+};
+
+/* Relax node \b pos with the run orders ending there.
+ *
+ * Orders starting on the first line use the first line semantics for all of their pixels
+ * (black background, foreground without XOR), so runs started there are tracked separately.
+ * A background run directly following another one starts with a foreground pixel, such
+ * pairs are never emitted. */
+static void bitmap_parse_runs(BITMAP_ENCODER* WINPR_RESTRICT enc, BITMAP_RUN* WINPR_RESTRICT runs,
+                              size_t pos)
+{
+	const size_t last = pos - 1;
+	const UINT32* pixels = enc->pixels;
+	const UINT32* xored = enc->xored;
+	BITMAP_NODE* nodes = enc->nodes;
+	const BITMAP_NODE* from = &nodes[last];
+	const BOOL firstLine = last < enc->width;
+	const BOOL sameColor = (last > 0) && (pixels[last] == pixels[last - 1]);
+	const BOOL sameXor = (last > enc->width) && (xored[last] == xored[last - 1]);
+
+	bitmap_run_step(&runs[BITMAP_RUN_COLOR], TRUE, sameColor, TRUE, last, from->cost);
+	bitmap_run_step(&runs[BITMAP_RUN_BG_FIRST_LINE], pixels[last] == 0, TRUE,
+	                firstLine && !from->bgRun, last, from->cost);
+	bitmap_run_step(&runs[BITMAP_RUN_BG], !firstLine && (xored[last] == 0), TRUE, !from->bgRun,
+	                last, from->cost);
+	bitmap_run_step(&runs[BITMAP_RUN_FG_FIRST_LINE], pixels[last] != 0, sameColor, firstLine, last,
+	                from->cost + ((from->fgPel == pixels[last]) ? 0 : enc->pixelSize));
+	bitmap_run_step(&runs[BITMAP_RUN_FG], !firstLine && (xored[last] != 0), sameXor, TRUE, last,
+	                from->cost + ((from->fgPel == xored[last]) ? 0 : enc->pixelSize));
+
+	const BITMAP_RUN* run = &runs[BITMAP_RUN_COLOR];
+	if (bitmap_run_valid(run))
 	{
-		if (in_count < 32)
-		{
-			const BYTE temp = ((0x1u << 5) | in_count) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x20);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf1);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+		const BITMAP_NODE* start = &nodes[run->start];
+		bitmap_relax(&nodes[pos],
+		             start->cost + bitmap_regular_header_size(pos - run->start) + enc->pixelSize,
+		             start->fgPel, run->start, BITMAP_ORDER_COLOR_RUN, FALSE);
 	}
 
-	return 0;
-}
+	for (size_t x = BITMAP_RUN_BG_FIRST_LINE; x <= BITMAP_RUN_BG; x++)
+	{
+		run = &runs[x];
+		if (!bitmap_run_valid(run))
+			continue;
 
-/*****************************************************************************/
-/* mix */
-static inline UINT16 out_counts_mix_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s)
-{
-	if (in_count > 0)
+		const BITMAP_NODE* start = &nodes[run->start];
+		bitmap_relax(&nodes[pos], start->cost + bitmap_regular_header_size(pos - run->start),
+		             start->fgPel, run->start, BITMAP_ORDER_BG_RUN, TRUE);
+	}
+
+	for (size_t x = BITMAP_RUN_FG_FIRST_LINE; x <= BITMAP_RUN_FG; x++)
 	{
-		if (in_count < 32)
-		{
-			const BYTE temp = ((0x1u << 5) | in_count) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256 + 32)
-		{
-			const BYTE temp = (in_count - 32) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x20);
-			Stream_Write_UINT8(in_s, temp);
-		}
+		run = &runs[x];
+		if (!bitmap_run_valid(run))
+			continue;
+
+		const BITMAP_NODE* start = &nodes[run->start];
+		const size_t length = pos - run->start;
+		const UINT32 fgPel =
+		    (x == BITMAP_RUN_FG_FIRST_LINE) ? pixels[run->start] : xored[run->start];
+
+		if (start->fgPel == fgPel)
+			bitmap_relax(&nodes[pos], start->cost + bitmap_regular_header_size(length), fgPel,
+			             run->start, BITMAP_ORDER_FG_RUN, FALSE);
 		else
-		{
-			Stream_Write_UINT8(in_s, 0xf1);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+			bitmap_relax(&nodes[pos],
+			             start->cost + bitmap_lite_header_size(length) + enc->pixelSize, fgPel,
+			             run->start, BITMAP_ORDER_SET_FG_RUN, FALSE);
 	}
-
-	return 0;
 }
 
-/*****************************************************************************/
-/* fom */
-static inline UINT16 out_from_count_2(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                      const uint8_t* WINPR_RESTRICT in_mask, size_t in_mask_len)
+static BOOL bitmap_match_special(const UINT32* values, UINT32 fgPel, BYTE mask)
 {
-	if (in_count > 0)
+	for (size_t x = 0; x < 8; x++)
 	{
-		if ((in_count % 8) == 0 && in_count < 249)
-		{
-			const BYTE temp = ((0x2u << 5) | (in_count / 8)) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256)
-		{
-			const BYTE temp = (in_count - 1) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x40);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf2);
-			Stream_Write_UINT16(in_s, in_count);
-		}
-
-		Stream_Write(in_s, in_mask, in_mask_len);
+		const UINT32 expect = (mask & (1u << x)) ? fgPel : 0;
+		if (values[x] != expect)
+			return FALSE;
 	}
-
-	return 0;
+	return TRUE;
 }
 
-/*****************************************************************************/
-/* fill or mix (fom) */
-static inline UINT16 out_from_count_3(UINT16 in_count, wStream* WINPR_RESTRICT in_s,
-                                      const uint8_t* WINPR_RESTRICT in_mask, size_t in_mask_len)
+static void bitmap_parse_fgbg(BITMAP_ENCODER* WINPR_RESTRICT enc, size_t pos, size_t length,
+                              UINT32 fgPel)
 {
-	if (in_count > 0)
-	{
-		if ((in_count % 8) == 0 && in_count < 249)
-		{
-			const BYTE temp = ((0x2u << 5) | (in_count / 8)) & 0xFF;
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else if (in_count < 256)
-		{
-			const BYTE temp = (in_count - 1) & 0xFF;
-			Stream_Write_UINT8(in_s, 0x40);
-			Stream_Write_UINT8(in_s, temp);
-		}
-		else
-		{
-			Stream_Write_UINT8(in_s, 0xf2);
-			Stream_Write_UINT16(in_s, in_count);
-		}
+	const BITMAP_NODE* node = &enc->nodes[pos];
+	const UINT32 masks = WINPR_ASSERTING_INT_CAST(UINT32, (length + 7) / 8);
 
-		Stream_Write(in_s, in_mask, in_mask_len);
-	}
-
-	return 0;
+	if (node->fgPel == fgPel)
+		bitmap_relax(&enc->nodes[pos + length],
+		             node->cost + bitmap_fgbg_header_size(length, 32) + masks, fgPel, pos,
+		             BITMAP_ORDER_FGBG_IMAGE, FALSE);
+	else
+		bitmap_relax(&enc->nodes[pos + length],
+		             node->cost + bitmap_fgbg_header_size(length, 16) + enc->pixelSize + masks,
+		             fgPel, pos, BITMAP_ORDER_SET_FGBG_IMAGE, FALSE);
 }
 
-#define TEST_FILL ((last_line == 0 && pixel == 0) || (last_line != 0 && pixel == ypixel))
-#define TEST_MIX ((last_line == 0 && pixel == mix) || (last_line != 0 && pixel == (ypixel ^ mix)))
-#define TEST_FOM TEST_FILL || TEST_MIX
-#define TEST_COLOR pixel == last_pixel
-
-#define test_bicolor(counts)                                                          \
-	((pixel != last_pixel) &&                                                         \
-	 ((!(counts)->bicolor_spin && (pixel == bicolor1) && (last_pixel == bicolor2)) || \
-	  ((counts)->bicolor_spin && (pixel == bicolor2) && (last_pixel == bicolor1))))
-
-static inline SSIZE_T freerdp_bitmap_compress_24(const void* WINPR_RESTRICT srcData, UINT32 width,
-                                                 WINPR_ATTR_UNUSED UINT32 height,
-                                                 wStream* WINPR_RESTRICT s, UINT32 byte_limit,
-                                                 UINT32 start_line, wStream* WINPR_RESTRICT temp_s,
-                                                 UINT32 e)
+/* Relax the nodes reached by the orders starting at \b pos */
+static void bitmap_parse_orders(BITMAP_ENCODER* WINPR_RESTRICT enc, size_t pos)
 {
-	uint8_t fom_mask[8192] = WINPR_C_ARRAY_INIT; /* good for up to 64K bitmap */
-	SSIZE_T lines_sent = 0;
-	UINT16 count = 0;
-	UINT32 last_pixel = 0;
-	UINT32 last_ypixel = 0;
-	struct count counts = WINPR_C_ARRAY_INIT;
-	UINT32 bicolor1 = 0;
-	UINT32 bicolor2 = 0;
-	UINT32 end = width + e;
-	UINT32 out_count = end * 3;
-	const UINT32 mix = 0xFFFFFF;
-	const char* start = (const char*)srcData;
-	const char* line = start + 4ULL * width * start_line;
-	const char* last_line = nullptr;
-
-	while ((line >= start) && (out_count < 32768))
+	const BITMAP_NODE* node = &enc->nodes[pos];
+	const UINT32* pixels = enc->pixels;
+	const UINT32 pixel = pixels[pos];
+	const size_t mode = (pos < enc->width) ? 0 : 1;
+	const UINT32* values = (mode == 0) ? pixels : enc->xored;
+
+	/* Color images are extended pixel by pixel. The cheapest path ending with one is kept
+	 * apart for each header size, otherwise a path that is cheaper now but has to start a
+	 * new image would replace one that already paid for its long header. */
+	for (size_t x = 0; x < BITMAP_IMAGE_CLASSES; x++)
 	{
-		size_t i = Stream_GetPosition(s) + 3ULL * count;
-
-		if ((i - (3ULL * counts.color_count) >= byte_limit) &&
-		    (i - (3ULL * counts.bicolor_count) >= byte_limit) &&
-		    (i - (3ULL * counts.fill_count) >= byte_limit) &&
-		    (i - (3ULL * counts.mix_count) >= byte_limit) &&
-		    (i - (3ULL * counts.fom_count) >= byte_limit))
-		{
-			break;
-		}
-
-		out_count += end * 3;
+		const BITMAP_NODE* image = &enc->images[x][pos];
+		const size_t length = pos - image->start;
+		if ((image->cost == UINT32_MAX) || (length >= UINT16_MAX))
+			continue;
+
+		const UINT32 header = bitmap_regular_header_size(length + 1);
+		bitmap_relax(&enc->images[header - 1][pos + 1],
+		             image->cost + enc->pixelSize + header - bitmap_regular_header_size(length),
+		             image->fgPel, image->start, BITMAP_ORDER_COLOR_IMAGE, FALSE);
+	}
 
-		for (UINT32 j = 0; j < end; j++)
-		{
-			/* read next pixel */
-			const UINT32 pixel = IN_PIXEL32(line, j, 0, width, last_pixel);
-			const UINT32 ypixel = IN_PIXEL32(last_line, j, 0, width, last_ypixel);
-
-			if (!TEST_FILL)
-			{
-				if (counts.fill_count > 3 && counts.fill_count >= counts.color_count &&
-				    counts.fill_count >= counts.bicolor_count &&
-				    counts.fill_count >= counts.mix_count && counts.fill_count >= counts.fom_count)
-				{
-					if (counts.fill_count > count)
-						return -1;
-
-					count -= counts.fill_count;
-					count = out_copy_count_3(count, s, temp_s);
-					counts.fill_count = out_fill_count_3(counts.fill_count, s);
-					reset_counts(&counts);
-				}
-
-				counts.fill_count = 0;
-			}
-
-			if (!TEST_MIX)
-			{
-				if (counts.mix_count > 3 && counts.mix_count >= counts.fill_count &&
-				    counts.mix_count >= counts.bicolor_count &&
-				    counts.mix_count >= counts.color_count && counts.mix_count >= counts.fom_count)
-				{
-					if (counts.mix_count > count)
-						return -1;
-
-					count -= counts.mix_count;
-					count = out_copy_count_3(count, s, temp_s);
-					counts.mix_count = out_counts_mix_count_3(counts.mix_count, s);
-					reset_counts(&counts);
-				}
-
-				counts.mix_count = 0;
-			}
-
-			if (!(TEST_COLOR))
-			{
-				if (counts.color_count > 3 && counts.color_count >= counts.fill_count &&
-				    counts.color_count >= counts.bicolor_count &&
-				    counts.color_count >= counts.mix_count &&
-				    counts.color_count >= counts.fom_count)
-				{
-					if (counts.color_count > count)
-						return -1;
-
-					count -= counts.color_count;
-					count = out_copy_count_3(count, s, temp_s);
-					counts.color_count = out_color_count_3(counts.color_count, s, last_pixel);
-					reset_counts(&counts);
-				}
-
-				counts.color_count = 0;
-			}
-
-			if (!test_bicolor(&counts))
-			{
-				if (counts.bicolor_count > 3 && counts.bicolor_count >= counts.fill_count &&
-				    counts.bicolor_count >= counts.color_count &&
-				    counts.bicolor_count >= counts.mix_count &&
-				    counts.bicolor_count >= counts.fom_count)
-				{
-					if ((counts.bicolor_count % 2) != 0)
-						counts.bicolor_count--;
-
-					if (counts.bicolor_count > count)
-						return -1;
-
-					count -= counts.bicolor_count;
-					count = out_copy_count_3(count, s, temp_s);
-					counts.bicolor_count =
-					    out_bicolor_count_3(counts.bicolor_count, s, bicolor2, bicolor1);
-					reset_counts(&counts);
-				}
-
-				counts.bicolor_count = 0;
-				bicolor1 = last_pixel;
-				bicolor2 = pixel;
-				counts.bicolor_spin = FALSE;
-			}
-
-			if (!(TEST_FOM))
-			{
-				if (counts.fom_count > 3 && counts.fom_count >= counts.fill_count &&
-				    counts.fom_count >= counts.color_count &&
-				    counts.fom_count >= counts.mix_count &&
-				    counts.fom_count >= counts.bicolor_count)
-				{
-					if (counts.fom_count > count)
-						return -1;
-
-					count -= counts.fom_count;
-					count = out_copy_count_3(count, s, temp_s);
-					counts.fom_count =
-					    out_from_count_3(counts.fom_count, s, fom_mask, counts.fom_mask_len);
-					reset_counts(&counts);
-				}
-
-				counts.fom_count = 0;
-				counts.fom_mask_len = 0;
-			}
-
-			if (TEST_FILL)
-			{
-				counts.fill_count++;
-			}
-
-			if (TEST_MIX)
-			{
-				counts.mix_count++;
-			}
-
-			if (TEST_COLOR)
-			{
-				counts.color_count++;
-			}
-
-			if (test_bicolor(&counts))
-			{
-				counts.bicolor_spin = !counts.bicolor_spin;
-				counts.bicolor_count++;
-			}
-
-			if (TEST_FOM)
-			{
-				if ((counts.fom_count % 8) == 0)
-				{
-					fom_mask[counts.fom_mask_len] = 0;
-					counts.fom_mask_len++;
-				}
-
-				if (pixel == (ypixel ^ mix))
-				{
-					const uint8_t tmp = (1u << (counts.fom_count % 8)) & 0xFF;
-					const uint8_t val = fom_mask[counts.fom_mask_len - 1] | tmp;
-					fom_mask[counts.fom_mask_len - 1] = val;
-				}
-
-				counts.fom_count++;
-			}
-
-			Stream_Write_UINT8(temp_s, pixel & 0xff);
-			Stream_Write_UINT8(temp_s, (pixel >> 8) & 0xff);
-			Stream_Write_UINT8(temp_s, (pixel >> 16) & 0xff);
-			count++;
-			last_pixel = pixel;
-			last_ypixel = ypixel;
-		}
+	bitmap_relax(&enc->images[0][pos + 1], node->cost + 1 + enc->pixelSize, node->fgPel, pos,
+	             BITMAP_ORDER_COLOR_IMAGE, FALSE);
 
-		/* can't take fix, mix, or fom past first line */
-		if (last_line == nullptr)
-		{
-			if (counts.fill_count > 3 && counts.fill_count >= counts.color_count &&
-			    counts.fill_count >= counts.bicolor_count &&
-			    counts.fill_count >= counts.mix_count && counts.fill_count >= counts.fom_count)
-			{
-				if (counts.fill_count > count)
-					return -1;
-
-				count -= counts.fill_count;
-				count = out_copy_count_3(count, s, temp_s);
-				counts.fill_count = out_fill_count_3(counts.fill_count, s);
-				reset_counts(&counts);
-			}
-
-			counts.fill_count = 0;
-
-			if (counts.mix_count > 3 && counts.mix_count >= counts.fill_count &&
-			    counts.mix_count >= counts.bicolor_count &&
-			    counts.mix_count >= counts.color_count && counts.mix_count >= counts.fom_count)
-			{
-				if (counts.mix_count > count)
-					return -1;
-
-				count -= counts.mix_count;
-				count = out_copy_count_3(count, s, temp_s);
-				counts.mix_count = out_counts_mix_count_3(counts.mix_count, s);
-				reset_counts(&counts);
-			}
-
-			counts.mix_count = 0;
-
-			if (counts.fom_count > 3 && counts.fom_count >= counts.fill_count &&
-			    counts.fom_count >= counts.color_count && counts.fom_count >= counts.mix_count &&
-			    counts.fom_count >= counts.bicolor_count)
-			{
-				if (counts.fom_count > count)
-					return -1;
-
-				count -= counts.fom_count;
-				count = out_copy_count_3(count, s, temp_s);
-				counts.fom_count =
-				    out_from_count_3(counts.fom_count, s, fom_mask, counts.fom_mask_len);
-				reset_counts(&counts);
-			}
-
-			counts.fom_count = 0;
-			counts.fom_mask_len = 0;
-		}
-
-		last_line = line;
-		line = line - 4ULL * width;
-		start_line--;
-		lines_sent++;
+	for (size_t x = 0; x < BITMAP_IMAGE_CLASSES; x++)
+	{
+		const BITMAP_NODE* next = &enc->images[x][pos + 1];
+		bitmap_relax(&enc->nodes[pos + 1], next->cost, next->fgPel, next->start,
+		             BITMAP_ORDER_COLOR_IMAGE, FALSE);
 	}
 
-	Stream_ResetPosition(temp_s);
+	if (pixel == enc->white)
+		bitmap_relax(&enc->nodes[pos + 1], node->cost + 1, node->fgPel, pos, BITMAP_ORDER_WHITE,
+		             FALSE);
+	else if (pixel == 0)
+		bitmap_relax(&enc->nodes[pos + 1], node->cost + 1, node->fgPel, pos, BITMAP_ORDER_BLACK,
+		             FALSE);
 
-	if (counts.fill_count > 3 && counts.fill_count >= counts.color_count &&
-	    counts.fill_count >= counts.bicolor_count && counts.fill_count >= counts.mix_count &&
-	    counts.fill_count >= counts.fom_count)
-	{
-		if (counts.fill_count > count)
-			return -1;
+	const size_t pairs = MIN(enc->dithered[pos] / 2, UINT16_MAX);
+	if ((pairs >= 2) && (pixel != pixels[pos + 1]))
+		bitmap_relax(&enc->nodes[pos + 2 * pairs],
+		             node->cost + bitmap_lite_header_size(pairs) + 2 * enc->pixelSize,
+		             node->fgPel, pos, BITMAP_ORDER_DITHERED_RUN, FALSE);
 
-		count -= counts.fill_count;
-		(void)out_copy_count_3(count, s, temp_s);
-		counts.fill_count = out_fill_count_3(counts.fill_count, s);
-	}
-	else if (counts.mix_count > 3 && counts.mix_count >= counts.color_count &&
-	         counts.mix_count >= counts.bicolor_count && counts.mix_count >= counts.fill_count &&
-	         counts.mix_count >= counts.fom_count)
+	if ((pos + 8 <= enc->count) && (values[pos] == node->fgPel))
 	{
-		if (counts.mix_count > count)
-			return -1;
-
-		count -= counts.mix_count;
-		(void)out_copy_count_3(count, s, temp_s);
-		counts.mix_count = out_counts_mix_count_3(counts.mix_count, s);
+		if (bitmap_match_special(&values[pos], node->fgPel, BITMAP_MASK_SPECIAL_FGBG_1))
+			bitmap_relax(&enc->nodes[pos + 8], node->cost + 1, node->fgPel, pos,
+			             BITMAP_ORDER_SPECIAL_FGBG_1, FALSE);
+		else if (bitmap_match_special(&values[pos], node->fgPel, BITMAP_MASK_SPECIAL_FGBG_2))
+			bitmap_relax(&enc->nodes[pos + 8], node->cost + 1, node->fgPel, pos,
+			             BITMAP_ORDER_SPECIAL_FGBG_2, FALSE);
 	}
-	else if (counts.color_count > 3 && counts.color_count >= counts.mix_count &&
-	         counts.color_count >= counts.bicolor_count &&
-	         counts.color_count >= counts.fill_count && counts.color_count >= counts.fom_count)
-	{
-		if (counts.color_count > count)
-			return -1;
 
-		count -= counts.color_count;
-		(void)out_copy_count_3(count, s, temp_s);
-		counts.color_count = out_color_count_3(counts.color_count, s, last_pixel);
-	}
-	else if (counts.bicolor_count > 3 && counts.bicolor_count >= counts.mix_count &&
-	         counts.bicolor_count >= counts.color_count &&
-	         counts.bicolor_count >= counts.fill_count && counts.bicolor_count >= counts.fom_count)
+	/* the longest image and the longest one with a single byte header */
+	const size_t length = enc->fgbgLength[mode][pos];
+	if (length > 1)
 	{
-		if ((counts.bicolor_count % 2) != 0)
-			counts.bicolor_count--;
-
-		if (counts.bicolor_count > count)
-			return -1;
-
-		count -= counts.bicolor_count;
-		count = out_copy_count_3(count, s, temp_s);
-		counts.bicolor_count = out_bicolor_count_3(counts.bicolor_count, s, bicolor2, bicolor1);
+		const UINT32 fgPel = enc->fgbgPel[mode][pos];
+		bitmap_parse_fgbg(enc, pos, length, fgPel);
+		if ((length > 8) && ((length % 8) != 0))
+			bitmap_parse_fgbg(enc, pos, length & ~(size_t)7, fgPel);
+	}
+}
 
-		if (counts.bicolor_count > count)
-			return -1;
+/* Linear time parser: every node is relaxed by the orders starting at the nodes in front of
+ * it, the run orders are tracked incrementally so that runs may end at any pixel. */
+static void bitmap_parse(BITMAP_ENCODER* WINPR_RESTRICT enc)
+{
+	BITMAP_RUN runs[BITMAP_RUN_COUNT] = WINPR_C_ARRAY_INIT;
+	BITMAP_NODE* nodes = enc->nodes;
 
-		count -= counts.bicolor_count;
-		(void)out_copy_count_3(count, s, temp_s);
-		counts.bicolor_count = out_bicolor_count_3(counts.bicolor_count, s, bicolor1, bicolor2);
-	}
-	else if (counts.fom_count > 3 && counts.fom_count >= counts.mix_count &&
-	         counts.fom_count >= counts.color_count && counts.fom_count >= counts.fill_count &&
-	         counts.fom_count >= counts.bicolor_count)
+	for (size_t x = 0; x <= enc->count; x++)
 	{
-		if (counts.fom_count > count)
-			return -1;
-
-		count -= counts.fom_count;
-		(void)out_copy_count_3(count, s, temp_s);
-		counts.fom_count = out_from_count_3(counts.fom_count, s, fom_mask, counts.fom_mask_len);
+		const BITMAP_NODE empty = { .cost = UINT32_MAX };
+		nodes[x] = empty;
+		for (size_t y = 0; y < BITMAP_IMAGE_CLASSES; y++)
+			enc->images[y][x] = empty;
 	}
-	else
+
+	nodes[0].cost = 0;
+	nodes[0].fgPel = enc->white;
+	nodes[0].order = BITMAP_ORDER_NONE;
+
+	for (size_t pos = 0; pos < enc->count; pos++)
 	{
-		(void)out_copy_count_3(count, s, temp_s);
+		if (pos > 0)
+			bitmap_parse_runs(enc, runs, pos);
+		bitmap_parse_orders(enc, pos);
 	}
 
-	return lines_sent;
+	if (enc->count > 0)
+		bitmap_parse_runs(enc, runs, enc->count);
 }
 
-static inline SSIZE_T freerdp_bitmap_compress_16(const void* WINPR_RESTRICT srcData, UINT32 width,
-                                                 WINPR_ATTR_UNUSED UINT32 height,
-                                                 wStream* WINPR_RESTRICT s, UINT32 bpp,
-                                                 UINT32 byte_limit, UINT32 start_line,
-                                                 wStream* WINPR_RESTRICT temp_s, UINT32 e)
+static void bitmap_write_masks(wStream* WINPR_RESTRICT s, const UINT32* values, size_t length)
 {
-	uint8_t fom_mask[8192] = WINPR_C_ARRAY_INIT; /* good for up to 64K bitmap */
-	SSIZE_T lines_sent = 0;
-	UINT16 count = 0;
-	UINT16 last_pixel = 0;
-	UINT16 last_ypixel = 0;
-	struct count counts = WINPR_C_ARRAY_INIT;
-	UINT16 bicolor1 = 0;
-	UINT16 bicolor2 = 0;
-	UINT32 end = width + e;
-	UINT32 out_count = end * 2;
-	const UINT32 mix = (bpp == 15) ? 0xBA1F : 0xFFFF;
-	const char* start = (const char*)srcData;
-	const char* line = start + 2ULL * width * start_line;
-	const char* last_line = nullptr;
-
-	while ((line >= start) && (out_count < 32768))
+	for (size_t x = 0; x < length; x += 8)
 	{
-		size_t i = Stream_GetPosition(s) + 2ULL * count;
-
-		if ((i - (2ULL * counts.color_count) >= byte_limit) &&
-		    (i - (2ULL * counts.bicolor_count) >= byte_limit) &&
-		    (i - (2ULL * counts.fill_count) >= byte_limit) &&
-		    (i - (2ULL * counts.mix_count) >= byte_limit) &&
-		    (i - (2ULL * counts.fom_count) >= byte_limit))
+		BYTE mask = 0;
+		const size_t bits = MIN(8, length - x);
+		for (size_t y = 0; y < bits; y++)
 		{
-			break;
+			if (values[x + y] != 0)
+				mask |= (BYTE)(1u << y);
 		}
+		Stream_Write_UINT8(s, mask);
+	}
+}
 
-		out_count += end * 2;
+static void bitmap_write_order(const BITMAP_ENCODER* WINPR_RESTRICT enc,
+                               wStream* WINPR_RESTRICT s, size_t start, size_t end)
+{
+	const BITMAP_NODE* node = &enc->nodes[end];
+	const UINT32* pixels = enc->pixels;
+	const UINT32* values = (start < enc->width) ? pixels : enc->xored;
+	const size_t length = end - start;
 
-		for (UINT32 j = 0; j < end; j++)
-		{
-			/* read next pixel */
-			const UINT16 pixel = IN_PIXEL16(line, j, 0, width, last_pixel);
-			const UINT16 ypixel = IN_PIXEL16(last_line, j, 0, width, last_ypixel);
-
-			if (!TEST_FILL)
-			{
-				if (counts.fill_count > 3 && counts.fill_count >= counts.color_count &&
-				    counts.fill_count >= counts.bicolor_count &&
-				    counts.fill_count >= counts.mix_count && counts.fill_count >= counts.fom_count)
-				{
-					if (counts.fill_count > count)
-						return -1;
-
-					count -= counts.fill_count;
-					count = out_copy_count_2(count, s, temp_s);
-					counts.fill_count = out_fill_count_2(counts.fill_count, s);
-					reset_counts(&counts);
-				}
-
-				counts.fill_count = 0;
-			}
-
-			if (!TEST_MIX)
-			{
-				if (counts.mix_count > 3 && counts.mix_count >= counts.fill_count &&
-				    counts.mix_count >= counts.bicolor_count &&
-				    counts.mix_count >= counts.color_count && counts.mix_count >= counts.fom_count)
-				{
-					if (counts.mix_count > count)
-						return -1;
-
-					count -= counts.mix_count;
-					count = out_copy_count_2(count, s, temp_s);
-					counts.mix_count = out_counts_mix_count_2(counts.mix_count, s);
-					reset_counts(&counts);
-				}
-
-				counts.mix_count = 0;
-			}
-
-			if (!(TEST_COLOR))
-			{
-				if (counts.color_count > 3 && counts.color_count >= counts.fill_count &&
-				    counts.color_count >= counts.bicolor_count &&
-				    counts.color_count >= counts.mix_count &&
-				    counts.color_count >= counts.fom_count)
-				{
-					if (counts.color_count > count)
-						return -1;
-
-					count -= counts.color_count;
-					count = out_copy_count_2(count, s, temp_s);
-					counts.color_count = out_color_count_2(counts.color_count, s, last_pixel);
-					reset_counts(&counts);
-				}
-
-				counts.color_count = 0;
-			}
-
-			if (!test_bicolor(&counts))
-			{
-				if ((counts.bicolor_count > 3) && (counts.bicolor_count >= counts.fill_count) &&
-				    (counts.bicolor_count >= counts.color_count) &&
-				    (counts.bicolor_count >= counts.mix_count) &&
-				    (counts.bicolor_count >= counts.fom_count))
-				{
-					if ((counts.bicolor_count % 2) != 0)
-						counts.bicolor_count--;
-
-					if (counts.bicolor_count > count)
-						return -1;
-
-					count -= counts.bicolor_count;
-					count = out_copy_count_2(count, s, temp_s);
-					counts.bicolor_count =
-					    out_bicolor_count_2(counts.bicolor_count, s, bicolor2, bicolor1);
-					reset_counts(&counts);
-				}
-
-				counts.bicolor_count = 0;
-				bicolor1 = last_pixel;
-				bicolor2 = pixel;
-				counts.bicolor_spin = FALSE;
-			}
-
-			if (!(TEST_FOM))
-			{
-				if (counts.fom_count > 3 && counts.fom_count >= counts.fill_count &&
-				    counts.fom_count >= counts.color_count &&
-				    counts.fom_count >= counts.mix_count &&
-				    counts.fom_count >= counts.bicolor_count)
-				{
-					if (counts.fom_count > count)
-						return -1;
-
-					count -= counts.fom_count;
-					count = out_copy_count_2(count, s, temp_s);
-					counts.fom_count =
-					    out_from_count_2(counts.fom_count, s, fom_mask, counts.fom_mask_len);
-					reset_counts(&counts);
-				}
-
-				counts.fom_count = 0;
-				counts.fom_mask_len = 0;
-			}
-
-			if (TEST_FILL)
-			{
-				counts.fill_count++;
-			}
-
-			if (TEST_MIX)
-			{
-				counts.mix_count++;
-			}
-
-			if (TEST_COLOR)
-			{
-				counts.color_count++;
-			}
-
-			if (test_bicolor(&counts))
-			{
-				counts.bicolor_spin = !counts.bicolor_spin;
-				counts.bicolor_count++;
-			}
-
-			if (TEST_FOM)
-			{
-				if ((counts.fom_count % 8) == 0)
-				{
-					fom_mask[counts.fom_mask_len] = 0;
-					counts.fom_mask_len++;
-				}
-
-				if (pixel == (ypixel ^ mix))
-				{
-					const uint8_t tmp = (1u << (counts.fom_count % 8)) & 0xFF;
-					const uint8_t val = fom_mask[counts.fom_mask_len - 1] | tmp;
-					fom_mask[counts.fom_mask_len - 1] = val;
-				}
-
-				counts.fom_count++;
-			}
-
-			Stream_Write_UINT16(temp_s, pixel);
-			count++;
-			last_pixel = pixel;
-			last_ypixel = ypixel;
-		}
+	switch (node->order)
+	{
+		case BITMAP_ORDER_BG_RUN:
+			bitmap_write_regular(s, BITMAP_REGULAR_BG_RUN, BITMAP_MEGA_MEGA_BG_RUN, length);
+			break;
 
-		/* can't take fix, mix, or fom past first line */
-		if (last_line == nullptr)
-		{
-			if (counts.fill_count > 3 && counts.fill_count >= counts.color_count &&
-			    counts.fill_count >= counts.bicolor_count &&
-			    counts.fill_count >= counts.mix_count && counts.fill_count >= counts.fom_count)
-			{
-				if (counts.fill_count > count)
-					return -1;
-
-				count -= counts.fill_count;
-				count = out_copy_count_2(count, s, temp_s);
-				counts.fill_count = out_fill_count_2(counts.fill_count, s);
-				reset_counts(&counts);
-			}
-
-			counts.fill_count = 0;
-
-			if (counts.mix_count > 3 && counts.mix_count >= counts.fill_count &&
-			    counts.mix_count >= counts.bicolor_count &&
-			    counts.mix_count >= counts.color_count && counts.mix_count >= counts.fom_count)
-			{
-				if (counts.mix_count > count)
-					return -1;
-
-				count -= counts.mix_count;
-				count = out_copy_count_2(count, s, temp_s);
-				counts.mix_count = out_counts_mix_count_2(counts.mix_count, s);
-				reset_counts(&counts);
-			}
-
-			counts.mix_count = 0;
-
-			if (counts.fom_count > 3 && counts.fom_count >= counts.fill_count &&
-			    counts.fom_count >= counts.color_count && counts.fom_count >= counts.mix_count &&
-			    counts.fom_count >= counts.bicolor_count)
-			{
-				if (counts.fom_count > count)
-					return -1;
-
-				count -= counts.fom_count;
-				count = out_copy_count_2(count, s, temp_s);
-				counts.fom_count =
-				    out_from_count_2(counts.fom_count, s, fom_mask, counts.fom_mask_len);
-				reset_counts(&counts);
-			}
-
-			counts.fom_count = 0;
-			counts.fom_mask_len = 0;
-		}
+		case BITMAP_ORDER_FG_RUN:
+			bitmap_write_regular(s, BITMAP_REGULAR_FG_RUN, BITMAP_MEGA_MEGA_FG_RUN, length);
+			break;
 
-		last_line = line;
-		line = line - 2ULL * width;
-		start_line--;
-		lines_sent++;
-	}
+		case BITMAP_ORDER_SET_FG_RUN:
+			bitmap_write_lite(s, BITMAP_LITE_SET_FG_FG_RUN, BITMAP_MEGA_MEGA_SET_FG_RUN, length);
+			bitmap_write_pixel(s, enc->pixelSize, node->fgPel);
+			break;
 
-	Stream_ResetPosition(temp_s);
+		case BITMAP_ORDER_DITHERED_RUN:
+			bitmap_write_lite(s, BITMAP_LITE_DITHERED_RUN, BITMAP_MEGA_MEGA_DITHERED_RUN,
+			                  length / 2);
+			bitmap_write_pixel(s, enc->pixelSize, pixels[start]);
+			bitmap_write_pixel(s, enc->pixelSize, pixels[start + 1]);
+			break;
 
-	if (counts.fill_count > 3 && counts.fill_count >= counts.color_count &&
-	    counts.fill_count >= counts.bicolor_count && counts.fill_count >= counts.mix_count &&
-	    counts.fill_count >= counts.fom_count)
-	{
-		if (counts.fill_count > count)
-			return -1;
+		case BITMAP_ORDER_COLOR_RUN:
+			bitmap_write_regular(s, BITMAP_REGULAR_COLOR_RUN, BITMAP_MEGA_MEGA_COLOR_RUN, length);
+			bitmap_write_pixel(s, enc->pixelSize, pixels[start]);
+			break;
 
-		count -= counts.fill_count;
-		(void)out_copy_count_2(count, s, temp_s);
-		counts.fill_count = out_fill_count_2(counts.fill_count, s);
-	}
-	else if (counts.mix_count > 3 && counts.mix_count >= counts.color_count &&
-	         counts.mix_count >= counts.bicolor_count && counts.mix_count >= counts.fill_count &&
-	         counts.mix_count >= counts.fom_count)
-	{
-		if (counts.mix_count > count)
-			return -1;
+		case BITMAP_ORDER_FGBG_IMAGE:
+			bitmap_write_fgbg(s, BITMAP_REGULAR_FGBG_IMAGE, BITMAP_MEGA_MEGA_FGBG_IMAGE, 32,
+			                  length);
+			bitmap_write_masks(s, &values[start], length);
+			break;
 
-		count -= counts.mix_count;
-		(void)out_copy_count_2(count, s, temp_s);
-		counts.mix_count = out_counts_mix_count_2(counts.mix_count, s);
-	}
-	else if (counts.color_count > 3 && counts.color_count >= counts.mix_count &&
-	         counts.color_count >= counts.bicolor_count &&
-	         counts.color_count >= counts.fill_count && counts.color_count >= counts.fom_count)
-	{
-		if (counts.color_count > count)
-			return -1;
+		case BITMAP_ORDER_SET_FGBG_IMAGE:
+			bitmap_write_fgbg(s, BITMAP_LITE_SET_FG_FGBG_IMAGE, BITMAP_MEGA_MEGA_SET_FGBG_IMAGE,
+			                  16, length);
+			bitmap_write_pixel(s, enc->pixelSize, node->fgPel);
+			bitmap_write_masks(s, &values[start], length);
+			break;
 
-		count -= counts.color_count;
-		(void)out_copy_count_2(count, s, temp_s);
-		counts.color_count = out_color_count_2(counts.color_count, s, last_pixel);
-	}
-	else if (counts.bicolor_count > 3 && counts.bicolor_count >= counts.mix_count &&
-	         counts.bicolor_count >= counts.color_count &&
-	         counts.bicolor_count >= counts.fill_count && counts.bicolor_count >= counts.fom_count)
-	{
-		if ((counts.bicolor_count % 2) != 0)
-			counts.bicolor_count--;
+		case BITMAP_ORDER_COLOR_IMAGE:
+			bitmap_write_regular(s, BITMAP_REGULAR_COLOR_IMAGE, BITMAP_MEGA_MEGA_COLOR_IMAGE,
+			                     length);
+			for (size_t x = start; x < end; x++)
+				bitmap_write_pixel(s, enc->pixelSize, pixels[x]);
+			break;
 
-		if (counts.bicolor_count > count)
-			return -1;
+		case BITMAP_ORDER_SPECIAL_FGBG_1:
+			Stream_Write_UINT8(s, BITMAP_SPECIAL_FGBG_1);
+			break;
 
-		count -= counts.bicolor_count;
-		count = out_copy_count_2(count, s, temp_s);
-		counts.bicolor_count = out_bicolor_count_2(counts.bicolor_count, s, bicolor2, bicolor1);
+		case BITMAP_ORDER_SPECIAL_FGBG_2:
+			Stream_Write_UINT8(s, BITMAP_SPECIAL_FGBG_2);
+			break;
 
-		if (counts.bicolor_count > count)
-			return -1;
+		case BITMAP_ORDER_WHITE:
+			Stream_Write_UINT8(s, BITMAP_SPECIAL_WHITE);
+			break;
 
-		count -= counts.bicolor_count;
-		(void)out_copy_count_2(count, s, temp_s);
-		counts.bicolor_count = out_bicolor_count_2(counts.bicolor_count, s, bicolor1, bicolor2);
+		case BITMAP_ORDER_BLACK:
+			Stream_Write_UINT8(s, BITMAP_SPECIAL_BLACK);
+			break;
+
+		case BITMAP_ORDER_NONE:
+		default:
+			WINPR_ASSERT(FALSE);
+			break;
 	}
-	else if (counts.fom_count > 3 && counts.fom_count >= counts.mix_count &&
-	         counts.fom_count >= counts.color_count && counts.fom_count >= counts.fill_count &&
-	         counts.fom_count >= counts.bicolor_count)
-	{
-		if (counts.fom_count > count)
-			return -1;
+}
 
-		count -= counts.fom_count;
-		(void)out_copy_count_2(count, s, temp_s);
-		counts.fom_count = out_from_count_2(counts.fom_count, s, fom_mask, counts.fom_mask_len);
+static BOOL bitmap_write(BITMAP_ENCODER* WINPR_RESTRICT enc, wStream* WINPR_RESTRICT s,
+                         size_t count)
+{
+	if (!Stream_CheckAndLogRequiredCapacity(TAG, s, enc->nodes[count].cost))
+		return FALSE;
+
+	/* the nodes link each order to the one in front of it, reverse that */
+	for (size_t pos = count; pos > 0;)
+	{
+		const size_t start = enc->nodes[pos].start;
+		enc->links[start] = WINPR_ASSERTING_INT_CAST(UINT16, pos);
+		pos = start;
 	}
-	else
+
+	for (size_t pos = 0; pos < count;)
 	{
-		(void)out_copy_count_2(count, s, temp_s);
+		const size_t end = enc->links[pos];
+		bitmap_write_order(enc, s, pos, end);
+		pos = end;
 	}
 
-	return lines_sent;
+	return TRUE;
+}
+
+static BYTE* bitmap_scratch_take(BYTE** cur, size_t size)
+{
+	BYTE* ptr = *cur;
+	*cur += (size + 15) & ~(size_t)15;
+	return ptr;
 }
 
-SSIZE_T freerdp_bitmap_compress(const void* WINPR_RESTRICT srcData, UINT32 width, UINT32 height,
-                                wStream* WINPR_RESTRICT s, UINT32 bpp, UINT32 byte_limit,
-                                UINT32 start_line, wStream* WINPR_RESTRICT temp_s, UINT32 e)
+static BOOL bitmap_encoder_init(BITMAP_ENCODER* WINPR_RESTRICT enc, wStream* WINPR_RESTRICT temp_s)
 {
+	const size_t count = enc->count;
+	const size_t size32 = (count + 1) * sizeof(UINT32);
+	const size_t size16 = (count + 1) * sizeof(UINT16);
+	const size_t scratch =
+	    ((size32 + 15) & ~(size_t)15) * 4 + ((size16 + 15) & ~(size_t)15) * 4 +
+	    ((sizeof(BITMAP_NODE) * (count + 1) + 15) & ~(size_t)15) * (1 + BITMAP_IMAGE_CLASSES) + 16;
+
+	/* the temporary stream is reused as scratch memory so repeated calls do not allocate */
+	if (!Stream_EnsureCapacity(temp_s, scratch))
+		return FALSE;
+
+	BYTE* cur = Stream_Buffer(temp_s);
+	cur += (16 - ((uintptr_t)cur & 15)) & 15;
+
+	enc->pixels = (UINT32*)bitmap_scratch_take(&cur, size32);
+	enc->xored = (UINT32*)bitmap_scratch_take(&cur, size32);
+	enc->fgbgPel[0] = (UINT32*)bitmap_scratch_take(&cur, size32);
+	enc->fgbgPel[1] = (UINT32*)bitmap_scratch_take(&cur, size32);
+	enc->dithered = (UINT16*)bitmap_scratch_take(&cur, size16);
+	enc->fgbgLength[0] = (UINT16*)bitmap_scratch_take(&cur, size16);
+	enc->fgbgLength[1] = (UINT16*)bitmap_scratch_take(&cur, size16);
+	enc->links = (UINT16*)bitmap_scratch_take(&cur, size16);
+	enc->nodes = (BITMAP_NODE*)bitmap_scratch_take(&cur, sizeof(BITMAP_NODE) * (count + 1));
+	for (size_t x = 0; x < BITMAP_IMAGE_CLASSES; x++)
+		enc->images[x] = (BITMAP_NODE*)bitmap_scratch_take(&cur, sizeof(BITMAP_NODE) * (count + 1));
+	return TRUE;
+}
+
+SSIZE_T freerdp_bitmap_compress(const void* WINPR_RESTRICT srcData, UINT32 width,
+                                WINPR_ATTR_UNUSED UINT32 height, wStream* WINPR_RESTRICT s,
+                                UINT32 bpp, UINT32 byte_limit, UINT32 start_line,
+                                wStream* WINPR_RESTRICT temp_s, UINT32 e)
+{
+	BITMAP_ENCODER enc = WINPR_C_ARRAY_INIT;
+	const BYTE* src = srcData;
+	UINT32 srcPixelSize = 0;
+
+	WINPR_ASSERT(srcData);
+	WINPR_ASSERT(s);
+	WINPR_ASSERT(temp_s);
+
 	Stream_ResetPosition(temp_s);
 
 	switch (bpp)
 	{
 		case 15:
 		case 16:
-			return freerdp_bitmap_compress_16(srcData, width, height, s, bpp, byte_limit,
-			                                  start_line, temp_s, e);
+			enc.pixelSize = 2;
+			enc.white = 0xFFFF;
+			srcPixelSize = 2;
+			break;
 
 		case 24:
-			return freerdp_bitmap_compress_24(srcData, width, height, s, byte_limit, start_line,
-			                                  temp_s, e);
+			enc.pixelSize = 3;
+			enc.white = 0xFFFFFF;
+			srcPixelSize = 4;
+			break;
 
 		default:
 			return -1;
 	}
+
+	enc.width = 1ull * width + e;
+	if (enc.width == 0)
+		return 0;
+
+	const size_t lineSize = enc.width * enc.pixelSize;
+	const size_t lines = MIN(1ull * start_line + 1, (BITMAP_MAX_RAW_SIZE - 1) / lineSize);
+	if (lines == 0)
+		return 0;
+
+	enc.count = lines * enc.width;
+	WINPR_ASSERT(enc.count < UINT16_MAX);
+
+	if (!bitmap_encoder_init(&enc, temp_s))
+		return -1;
+
+	/* lines are encoded bottom up */
+	for (size_t y = 0; y < lines; y++)
+	{
+		const BYTE* line = &src[(start_line - y) * srcPixelSize * width];
+		bitmap_read_line(&enc.pixels[y * enc.width], line, width, enc.width, enc.pixelSize);
+	}
+
+	bitmap_xor_lines(enc.xored, enc.pixels, enc.width, enc.count);
+	bitmap_find_dithered(enc.dithered, enc.pixels, enc.count);
+	bitmap_find_fgbg(enc.fgbgPel[0], enc.fgbgLength[0], enc.pixels, 0, enc.count);
+	bitmap_find_fgbg(enc.fgbgPel[1], enc.fgbgLength[1], enc.xored, MIN(enc.width, enc.count),
+	                 enc.count);
+
+	bitmap_parse(&enc);
+
+	/* send as many lines as fit */
+	size_t sent = lines;
+	while ((sent > 0) &&
+	       (Stream_GetPosition(s) + enc.nodes[sent * enc.width].cost > byte_limit))
+		sent--;
+
+	if (!bitmap_write(&enc, s, sent * enc.width))
+		return -1;
+
+	return WINPR_ASSERTING_INT_CAST(SSIZE_T, sent);
 }
@@ -37,12 +37,37 @@
 
 #define CLEARCODEC_VBAR_SIZE 32768
 #define CLEARCODEC_VBAR_SHORT_SIZE 16384
+#define CLEARCODEC_GLYPH_CACHE_SIZE 4000
+#define CLEARCODEC_GLYPH_MAX_PIXELS 1024
+#define CLEARCODEC_VBAR_MAX_HEIGHT 52
+#define CLEARCODEC_PALETTE_MAX 127
+
+/* Encoder tuning: images are classified in square blocks, the block height is
+ * also the band height and must not exceed CLEARCODEC_VBAR_MAX_HEIGHT */
+#define CLEARCODEC_BLOCK_SIZE 32
+#define CLEARCODEC_VBAR_HASH_SIZE 65536
+#define CLEARCODEC_GLYPH_HASH_SIZE 4096
+
+typedef enum
+{
+	CLEAR_BLOCK_RESIDUAL,
+	CLEAR_BLOCK_BANDS,
+	CLEAR_BLOCK_RLEX,
+	CLEAR_BLOCK_IMAGE
+} CLEAR_BLOCK_TYPE;
+
+typedef struct
+{
+	CLEAR_BLOCK_TYPE type;
+	UINT32 bkg;
+} CLEAR_BLOCK;
 
 typedef struct
 {
 	UINT32 size;
 	UINT32 count;
 	UINT32* pixels;
+	UINT32 hash;
 } CLEAR_GLYPH_ENTRY;
 
 typedef struct
@@ -61,14 +86,36 @@ struct S_CLEAR_CONTEXT
 	size_t TempSize;
 	UINT32 format;
 	BOOL formatSet;
-	CLEAR_GLYPH_ENTRY GlyphCache[4000];
+	CLEAR_GLYPH_ENTRY GlyphCache[CLEARCODEC_GLYPH_CACHE_SIZE];
 	UINT32 VBarStorageCursor;
 	CLEAR_VBAR_ENTRY VBarStorage[CLEARCODEC_VBAR_SIZE];
 	UINT32 ShortVBarStorageCursor;
 	CLEAR_VBAR_ENTRY ShortVBarStorage[CLEARCODEC_VBAR_SHORT_SIZE];
 	wLog* log;
+
+	/* Compressor state, the caches above mirror the state of the decoder */
+	BOOL CacheResetPending;
+	UINT32 GlyphCursor;
+	UINT32* GlyphHash;
+	UINT32* VBarHash;
+	UINT32* ShortVBarHash;
+	CLEAR_BLOCK* Blocks;
+	size_t BlocksSize;
+	wStream* BandsStream;
+	wStream* SubcodecStream;
+	BYTE* NscBuffer;
+	size_t NscBufferSize;
 };
 
+typedef struct
+{
+	UINT32 count;
+	BOOL overflow;
+	UINT32 colors[CLEARCODEC_PALETTE_MAX];
+	UINT32 hits[CLEARCODEC_PALETTE_MAX];
+	BYTE slots[256];
+} CLEAR_PALETTE;
+
 static const UINT32 CLEAR_LOG2_FLOOR[256] = {
 	0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
 	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
@@ -960,7 +1007,7 @@ static BOOL clear_decompress_glyph_data(CLEAR_CONTEXT* WINPR_RESTRICT clear,
 
 	Stream_Read_UINT16(s, glyphIndex);
 
-	if (glyphIndex >= 4000)
+	if (glyphIndex >= CLEARCODEC_GLYPH_CACHE_SIZE)
 	{
 		WLog_Print(clear->log, WLOG_ERROR, "Invalid glyphIndex %" PRIu16 "", glyphIndex);
 		return FALSE;
@@ -1269,6 +1316,793 @@ fail:
 	return rc;
 }
 
+static inline UINT32 clear_hash_pixels(const UINT32* WINPR_RESTRICT pixels, UINT32 count)
+{
+	UINT32 hash = 2166136261u ^ count;
+
+	for (UINT32 x = 0; x < count; x++)
+	{
+		hash ^= pixels[x];
+		hash *= 16777619u;
+	}
+
+	return hash ^ (hash >> 16);
+}
+
+/* Pixels are 0xFFRRGGBB values in host byte order */
+static inline void clear_write_bgr(wStream* WINPR_RESTRICT s, UINT32 color)
+{
+	Stream_Write_UINT8(s, color & 0xFF);
+	Stream_Write_UINT8(s, (color >> 8) & 0xFF);
+	Stream_Write_UINT8(s, (color >> 16) & 0xFF);
+}
+
+static inline void clear_write_run_length(wStream* WINPR_RESTRICT s, UINT32 runLength)
+{
+	if (runLength < 0xFF)
+	{
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, runLength));
+		return;
+	}
+
+	Stream_Write_UINT8(s, 0xFF);
+
+	if (runLength < 0xFFFF)
+	{
+		Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, runLength));
+		return;
+	}
+
+	Stream_Write_UINT16(s, 0xFFFF);
+	Stream_Write_UINT32(s, runLength);
+}
+
+static inline void clear_palette_init(CLEAR_PALETTE* WINPR_RESTRICT palette)
+{
+	palette->count = 0;
+	palette->overflow = FALSE;
+	ZeroMemory(palette->slots, sizeof(palette->slots));
+}
+
+/* Returns the palette index of color, -1 if the palette is full */
+static inline INT32 clear_palette_index(CLEAR_PALETTE* WINPR_RESTRICT palette, UINT32 color)
+{
+	UINT32 slot = (color * 2654435761u) >> 24;
+
+	for (BYTE entry = palette->slots[slot]; entry != 0; entry = palette->slots[slot])
+	{
+		if (palette->colors[entry - 1] == color)
+			return entry - 1;
+
+		slot = (slot + 1) & 0xFF;
+	}
+
+	if (palette->count >= CLEARCODEC_PALETTE_MAX)
+	{
+		palette->overflow = TRUE;
+		return -1;
+	}
+
+	const UINT32 index = palette->count++;
+	palette->colors[index] = color;
+	palette->hits[index] = 0;
+	palette->slots[slot] = WINPR_ASSERTING_INT_CAST(BYTE, index + 1);
+	return WINPR_ASSERTING_INT_CAST(INT32, index);
+}
+
+static inline INT32 clear_vbar_lookup(const CLEAR_VBAR_ENTRY* WINPR_RESTRICT storage,
+                                      const UINT32* WINPR_RESTRICT hashTable, UINT32 hash,
+                                      const UINT32* WINPR_RESTRICT pixels, UINT32 count)
+{
+	const UINT32 entry = hashTable[hash % CLEARCODEC_VBAR_HASH_SIZE];
+
+	if (entry == 0)
+		return -1;
+
+	const CLEAR_VBAR_ENTRY* vBarEntry = &storage[entry - 1];
+
+	if (vBarEntry->count != count)
+		return -1;
+
+	if ((count > 0) && (memcmp(vBarEntry->pixels, pixels, count * sizeof(UINT32)) != 0))
+		return -1;
+
+	return WINPR_ASSERTING_INT_CAST(INT32, entry - 1);
+}
+
+static BOOL clear_vbar_insert(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                              CLEAR_VBAR_ENTRY* WINPR_RESTRICT storage,
+                              UINT32* WINPR_RESTRICT hashTable, UINT32 index, UINT32 hash,
+                              const UINT32* WINPR_RESTRICT pixels, UINT32 count)
+{
+	CLEAR_VBAR_ENTRY* vBarEntry = &storage[index];
+	vBarEntry->count = count;
+
+	if (!resize_vbar_entry(clear, vBarEntry))
+		return FALSE;
+
+	if (count > 0)
+		memcpy(vBarEntry->pixels, pixels, count * sizeof(UINT32));
+
+	hashTable[hash % CLEARCODEC_VBAR_HASH_SIZE] = index + 1;
+	return TRUE;
+}
+
+static inline void clear_get_vbar(const UINT32* WINPR_RESTRICT pixels, UINT32 stride, UINT32 x,
+                                  UINT32 yStart, UINT32 height, UINT32* WINPR_RESTRICT vBar)
+{
+	const UINT32* src = &pixels[1ull * yStart * stride + x];
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		vBar[y] = *src;
+		src += stride;
+	}
+}
+
+static inline void clear_get_vbar_extent(const UINT32* WINPR_RESTRICT vBar, UINT32 height,
+                                         UINT32 colorBkg, UINT32* WINPR_RESTRICT pYOn,
+                                         UINT32* WINPR_RESTRICT pYOff)
+{
+	UINT32 yOn = 0;
+	UINT32 yOff = height;
+
+	while ((yOn < height) && (vBar[yOn] == colorBkg))
+		yOn++;
+
+	if (yOn == height)
+	{
+		*pYOn = 0;
+		*pYOff = 0;
+		return;
+	}
+
+	while (vBar[yOff - 1] == colorBkg)
+		yOff--;
+
+	*pYOn = yOn;
+	*pYOff = yOff;
+}
+
+static UINT32 clear_estimate_bands(const CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                                   const UINT32* WINPR_RESTRICT pixels, UINT32 stride, UINT32 x0,
+                                   UINT32 y0, UINT32 width, UINT32 height, UINT32 colorBkg)
+{
+	UINT32 cost = 11;
+	UINT32 vBar[CLEARCODEC_VBAR_MAX_HEIGHT] = WINPR_C_ARRAY_INIT;
+
+	for (UINT32 x = x0; x < x0 + width; x++)
+	{
+		UINT32 yOn = 0;
+		UINT32 yOff = 0;
+
+		clear_get_vbar(pixels, stride, x, y0, height, vBar);
+
+		const UINT32 hash = clear_hash_pixels(vBar, height);
+
+		if (clear_vbar_lookup(clear->VBarStorage, clear->VBarHash, hash, vBar, height) >= 0)
+		{
+			cost += 2;
+			continue;
+		}
+
+		clear_get_vbar_extent(vBar, height, colorBkg, &yOn, &yOff);
+
+		const UINT32 shortHash = clear_hash_pixels(&vBar[yOn], yOff - yOn);
+
+		if (clear_vbar_lookup(clear->ShortVBarStorage, clear->ShortVBarHash, shortHash, &vBar[yOn],
+		                      yOff - yOn) >= 0)
+			cost += 3;
+		else
+			cost += 2 + 3 * (yOff - yOn);
+	}
+
+	return cost;
+}
+
+/**
+ * Pick the cheapest layer for a block: the residual layer for flat areas,
+ * bands for text like content over a background color, RLEX for other
+ * content with few colors and NSCodec or raw pixels for everything else.
+ */
+static void clear_classify_block(const CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                                 const UINT32* WINPR_RESTRICT pixels, UINT32 stride, UINT32 x0,
+                                 UINT32 y0, UINT32 width, UINT32 height,
+                                 CLEAR_BLOCK* WINPR_RESTRICT block)
+{
+	CLEAR_PALETTE palette;
+	UINT32 runs = 1;
+	UINT32 last = pixels[1ull * y0 * stride + x0];
+
+	clear_palette_init(&palette);
+
+	for (UINT32 y = y0; y < y0 + height; y++)
+	{
+		const UINT32* line = &pixels[1ull * y * stride];
+
+		for (UINT32 x = x0; x < x0 + width; x++)
+		{
+			const UINT32 color = line[x];
+
+			if (color != last)
+			{
+				runs++;
+				last = color;
+			}
+
+			const INT32 index = clear_palette_index(&palette, color);
+
+			if (index >= 0)
+				palette.hits[index]++;
+		}
+	}
+
+	block->type = CLEAR_BLOCK_RESIDUAL;
+	block->bkg = palette.colors[0];
+	UINT32 cost = 4 * runs;
+
+	if (palette.overflow)
+	{
+		if (3ull * width * height + 13 < cost)
+			block->type = CLEAR_BLOCK_IMAGE;
+
+		return;
+	}
+
+	for (UINT32 x = 1; x < palette.count; x++)
+	{
+		if (palette.hits[x] > palette.hits[0])
+		{
+			palette.hits[0] = palette.hits[x];
+			block->bkg = palette.colors[x];
+		}
+	}
+
+	const UINT32 bandsCost =
+	    clear_estimate_bands(clear, pixels, stride, x0, y0, width, height, block->bkg);
+
+	/* A vBar cache miss costs more than RLEX but fills the decoder caches,
+	 * later frames hit them for 2 or 3 bytes per column. */
+	if (bandsCost / 2 < cost)
+	{
+		cost = bandsCost / 2;
+		block->type = CLEAR_BLOCK_BANDS;
+	}
+
+	if (13 + 1 + 3 * palette.count + 2 * runs < cost)
+		block->type = CLEAR_BLOCK_RLEX;
+}
+
+static BOOL clear_compress_band(CLEAR_CONTEXT* WINPR_RESTRICT clear, wStream* WINPR_RESTRICT s,
+                                const UINT32* WINPR_RESTRICT pixels, UINT32 stride, UINT32 xStart,
+                                UINT32 xEnd, UINT32 yStart, UINT32 height, UINT32 colorBkg)
+{
+	UINT32 vBar[CLEARCODEC_VBAR_MAX_HEIGHT] = WINPR_C_ARRAY_INIT;
+
+	WINPR_ASSERT(height <= CLEARCODEC_VBAR_MAX_HEIGHT);
+
+	if (!Stream_EnsureRemainingCapacity(s, 11ull + (xEnd - xStart) * (3ull + 3ull * height)))
+		return FALSE;
+
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, xStart));
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, xEnd - 1));
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, yStart));
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, yStart + height - 1));
+	clear_write_bgr(s, colorBkg);
+
+	for (UINT32 x = xStart; x < xEnd; x++)
+	{
+		UINT32 yOn = 0;
+		UINT32 yOff = 0;
+
+		clear_get_vbar(pixels, stride, x, yStart, height, vBar);
+
+		const UINT32 hash = clear_hash_pixels(vBar, height);
+		const INT32 vBarIndex =
+		    clear_vbar_lookup(clear->VBarStorage, clear->VBarHash, hash, vBar, height);
+
+		if (vBarIndex >= 0) /* VBAR_CACHE_HIT */
+		{
+			Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, 0x8000 | vBarIndex));
+			continue;
+		}
+
+		clear_get_vbar_extent(vBar, height, colorBkg, &yOn, &yOff);
+
+		const UINT32 shortCount = yOff - yOn;
+		const UINT32 shortHash = clear_hash_pixels(&vBar[yOn], shortCount);
+		const INT32 shortIndex = clear_vbar_lookup(clear->ShortVBarStorage, clear->ShortVBarHash,
+		                                           shortHash, &vBar[yOn], shortCount);
+
+		if (shortIndex >= 0) /* SHORT_VBAR_CACHE_HIT */
+		{
+			Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, 0x4000 | shortIndex));
+			Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, yOn));
+		}
+		else /* SHORT_VBAR_CACHE_MISS */
+		{
+			Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, (yOff << 8) | yOn));
+
+			for (UINT32 y = yOn; y < yOff; y++)
+				clear_write_bgr(s, vBar[y]);
+
+			if (!clear_vbar_insert(clear, clear->ShortVBarStorage, clear->ShortVBarHash,
+			                       clear->ShortVBarStorageCursor, shortHash, &vBar[yOn],
+			                       shortCount))
+				return FALSE;
+
+			clear->ShortVBarStorageCursor =
+			    (clear->ShortVBarStorageCursor + 1) % CLEARCODEC_VBAR_SHORT_SIZE;
+		}
+
+		/* The decoder stores the expanded vBar for both short vBar cases */
+		if (!clear_vbar_insert(clear, clear->VBarStorage, clear->VBarHash,
+		                       clear->VBarStorageCursor, hash, vBar, height))
+			return FALSE;
+
+		clear->VBarStorageCursor = (clear->VBarStorageCursor + 1) % CLEARCODEC_VBAR_SIZE;
+	}
+
+	return TRUE;
+}
+
+static BOOL clear_write_subcodec_header(wStream* WINPR_RESTRICT s, size_t start, UINT32 x0,
+                                        UINT32 y0, UINT32 width, UINT32 height, BYTE subcodecId)
+{
+	const size_t end = Stream_GetPosition(s);
+	const size_t bitmapDataByteCount = end - start - 13;
+
+	if (!Stream_SetPosition(s, start))
+		return FALSE;
+
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, x0));
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, y0));
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, width));
+	Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, height));
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, bitmapDataByteCount));
+	Stream_Write_UINT8(s, subcodecId);
+	return Stream_SetPosition(s, end);
+}
+
+static BOOL clear_compress_subcodec_rlex(wStream* WINPR_RESTRICT s,
+                                         const UINT32* WINPR_RESTRICT pixels, UINT32 stride,
+                                         UINT32 x0, UINT32 y0, UINT32 width, UINT32 height)
+{
+	CLEAR_PALETTE palette;
+	BYTE indices[CLEARCODEC_BLOCK_SIZE * CLEARCODEC_BLOCK_SIZE] = WINPR_C_ARRAY_INIT;
+	const UINT32 pixelCount = width * height;
+
+	WINPR_ASSERT(pixelCount <= ARRAYSIZE(indices));
+	clear_palette_init(&palette);
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const UINT32* line = &pixels[1ull * (y0 + y) * stride + x0];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const INT32 index = clear_palette_index(&palette, line[x]);
+
+			if (index < 0)
+				return FALSE;
+
+			indices[y * width + x] = WINPR_ASSERTING_INT_CAST(BYTE, index);
+		}
+	}
+
+	const UINT32 numBits = CLEAR_LOG2_FLOOR[palette.count - 1] + 1;
+	const UINT32 maxSuiteDepth = CLEAR_8BIT_MASKS[8 - numBits];
+
+	if (!Stream_EnsureRemainingCapacity(s, 14ull + 3ull * palette.count + 4ull * pixelCount))
+		return FALSE;
+
+	const size_t start = Stream_GetPosition(s);
+	Stream_Seek(s, 13);
+	Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, palette.count));
+
+	for (UINT32 x = 0; x < palette.count; x++)
+		clear_write_bgr(s, palette.colors[x]);
+
+	/* Each segment is a run of the start color followed by a suite of
+	 * ascending palette indices starting with the start color. */
+	for (UINT32 x = 0; x < pixelCount;)
+	{
+		const BYTE startIndex = indices[x];
+		UINT32 runLength = 0;
+		UINT32 suiteDepth = 0;
+
+		while ((x + runLength + 1 < pixelCount) && (indices[x + runLength + 1] == startIndex))
+			runLength++;
+
+		x += runLength;
+
+		while ((suiteDepth < maxSuiteDepth) && (x + suiteDepth + 1 < pixelCount) &&
+		       (indices[x + suiteDepth + 1] == startIndex + suiteDepth + 1))
+			suiteDepth++;
+
+		x += suiteDepth + 1;
+		Stream_Write_UINT8(
+		    s, WINPR_ASSERTING_INT_CAST(BYTE, (suiteDepth << numBits) | (startIndex + suiteDepth)));
+		clear_write_run_length(s, runLength);
+	}
+
+	return clear_write_subcodec_header(s, start, x0, y0, width, height, 2);
+}
+
+static BOOL clear_compress_subcodec_image(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                                          wStream* WINPR_RESTRICT s,
+                                          const UINT32* WINPR_RESTRICT pixels, UINT32 stride,
+                                          UINT32 x0, UINT32 y0, UINT32 width, UINT32 height)
+{
+	BYTE subcodecId = 1;
+	const size_t rawSize = 3ull * width * height;
+	const UINT32* src = &pixels[1ull * y0 * stride + x0];
+
+	const size_t nscSize = 4ull * width * height;
+
+	if (!Stream_EnsureRemainingCapacity(s, 13ull + rawSize))
+		return FALSE;
+
+	if (nscSize > clear->NscBufferSize)
+	{
+		BYTE* tmp = winpr_aligned_recalloc(clear->NscBuffer, nscSize, sizeof(BYTE), 32);
+
+		if (!tmp)
+			return FALSE;
+
+		clear->NscBuffer = tmp;
+		clear->NscBufferSize = nscSize;
+	}
+
+	/* The NSCodec encoder expects bottom up BGRX32 images, the subcodec is top down */
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const UINT32* line = &src[1ull * y * stride];
+		BYTE* dst = &clear->NscBuffer[4ull * width * (height - y - 1)];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			*dst++ = line[x] & 0xFF;
+			*dst++ = (line[x] >> 8) & 0xFF;
+			*dst++ = (line[x] >> 16) & 0xFF;
+			*dst++ = 0xFF;
+		}
+	}
+
+	const size_t start = Stream_GetPosition(s);
+	Stream_Seek(s, 13);
+
+	/* Fall back to uncompressed pixels if NSCodec does not pay off */
+	if (!nsc_compose_message(clear->nsc, s, clear->NscBuffer, width, height, 4 * width) ||
+	    (Stream_GetPosition(s) - start - 13 >= rawSize))
+	{
+		subcodecId = 0;
+
+		if (!Stream_SetPosition(s, start + 13) || !Stream_EnsureRemainingCapacity(s, rawSize))
+			return FALSE;
+
+		for (UINT32 y = 0; y < height; y++)
+		{
+			for (UINT32 x = 0; x < width; x++)
+				clear_write_bgr(s, src[x]);
+
+			src += stride;
+		}
+	}
+
+	return clear_write_subcodec_header(s, start, x0, y0, width, height, subcodecId);
+}
+
+static BOOL clear_compress_residual(CLEAR_CONTEXT* WINPR_RESTRICT clear, wStream* WINPR_RESTRICT s,
+                                    const UINT32* WINPR_RESTRICT pixels, UINT32 width,
+                                    UINT32 height)
+{
+	BOOL haveColor = FALSE;
+	UINT32 color = 0;
+	UINT32 runLength = 0;
+	const UINT32 blocksPerRow = (width + CLEARCODEC_BLOCK_SIZE - 1) / CLEARCODEC_BLOCK_SIZE;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const UINT32* line = &pixels[1ull * y * width];
+		const CLEAR_BLOCK* blocks = &clear->Blocks[1ull * (y / CLEARCODEC_BLOCK_SIZE) * blocksPerRow];
+
+		for (UINT32 bx = 0; bx < blocksPerRow; bx++)
+		{
+			const UINT32 xStart = bx * CLEARCODEC_BLOCK_SIZE;
+			const UINT32 xEnd = MIN(xStart + CLEARCODEC_BLOCK_SIZE, width);
+
+			/* Pixels covered by bands or subcodecs are overwritten later,
+			 * extend the current run over them */
+			if (blocks[bx].type != CLEAR_BLOCK_RESIDUAL)
+			{
+				runLength += xEnd - xStart;
+				continue;
+			}
+
+			for (UINT32 x = xStart; x < xEnd; x++)
+			{
+				if (!haveColor)
+				{
+					color = line[x];
+					haveColor = TRUE;
+				}
+				else if (line[x] != color)
+				{
+					if (!Stream_EnsureRemainingCapacity(s, 10))
+						return FALSE;
+
+					clear_write_bgr(s, color);
+					clear_write_run_length(s, runLength);
+					color = line[x];
+					runLength = 0;
+				}
+
+				runLength++;
+			}
+		}
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 10))
+		return FALSE;
+
+	clear_write_bgr(s, color);
+	clear_write_run_length(s, runLength);
+	return TRUE;
+}
+
+static BOOL clear_compress_layers(CLEAR_CONTEXT* WINPR_RESTRICT clear,
+                                  const UINT32* WINPR_RESTRICT pixels, UINT32 width, UINT32 height,
+                                  BOOL* WINPR_RESTRICT pResidual)
+{
+	const UINT32 blocksPerRow = (width + CLEARCODEC_BLOCK_SIZE - 1) / CLEARCODEC_BLOCK_SIZE;
+	const UINT32 blocksPerColumn = (height + CLEARCODEC_BLOCK_SIZE - 1) / CLEARCODEC_BLOCK_SIZE;
+	const size_t blockCount = 1ull * blocksPerRow * blocksPerColumn;
+
+	if (blockCount > clear->BlocksSize)
+	{
+		CLEAR_BLOCK* tmp = (CLEAR_BLOCK*)realloc(clear->Blocks, blockCount * sizeof(CLEAR_BLOCK));
+
+		if (!tmp)
+			return FALSE;
+
+		clear->Blocks = tmp;
+		clear->BlocksSize = blockCount;
+	}
+
+	*pResidual = FALSE;
+
+	for (UINT32 by = 0; by < blocksPerColumn; by++)
+	{
+		const UINT32 y0 = by * CLEARCODEC_BLOCK_SIZE;
+		const UINT32 h = MIN(CLEARCODEC_BLOCK_SIZE, height - y0);
+		CLEAR_BLOCK* blocks = &clear->Blocks[1ull * by * blocksPerRow];
+
+		for (UINT32 bx = 0; bx < blocksPerRow; bx++)
+		{
+			const UINT32 x0 = bx * CLEARCODEC_BLOCK_SIZE;
+			const UINT32 w = MIN(CLEARCODEC_BLOCK_SIZE, width - x0);
+			clear_classify_block(clear, pixels, width, x0, y0, w, h, &blocks[bx]);
+		}
+
+		/* Encode the strip right away so the vBar caches already contain its
+		 * columns when classifying the next one. Neighbouring bands sharing a
+		 * background color and neighbouring image blocks are merged. */
+		for (UINT32 bx = 0; bx < blocksPerRow;)
+		{
+			const CLEAR_BLOCK* block = &blocks[bx];
+			const UINT32 x0 = bx * CLEARCODEC_BLOCK_SIZE;
+			UINT32 last = bx + 1;
+			BOOL rc = TRUE;
+
+			switch (block->type)
+			{
+				case CLEAR_BLOCK_BANDS:
+					while ((last < blocksPerRow) && (blocks[last].type == CLEAR_BLOCK_BANDS) &&
+					       (blocks[last].bkg == block->bkg))
+						last++;
+
+					rc = clear_compress_band(clear, clear->BandsStream, pixels, width, x0,
+					                         MIN(last * CLEARCODEC_BLOCK_SIZE, width), y0, h,
+					                         block->bkg);
+					break;
+
+				case CLEAR_BLOCK_RLEX:
+					rc = clear_compress_subcodec_rlex(clear->SubcodecStream, pixels, width, x0,
+					                                  y0, MIN(CLEARCODEC_BLOCK_SIZE, width - x0),
+					                                  h);
+					break;
+
+				case CLEAR_BLOCK_IMAGE:
+					while ((last < blocksPerRow) && (blocks[last].type == CLEAR_BLOCK_IMAGE))
+						last++;
+
+					rc = clear_compress_subcodec_image(
+					    clear, clear->SubcodecStream, pixels, width, x0, y0,
+					    MIN(last * CLEARCODEC_BLOCK_SIZE, width) - x0, h);
+					break;
+
+				case CLEAR_BLOCK_RESIDUAL:
+				default:
+					*pResidual = TRUE;
+					break;
+			}
+
+			if (!rc)
+				return FALSE;
+
+			bx = last;
+		}
+	}
+
+	return TRUE;
+}
+
+static INT32 clear_glyph_lookup(const CLEAR_CONTEXT* WINPR_RESTRICT clear, UINT32 hash,
+                                const UINT32* WINPR_RESTRICT pixels, UINT32 count)
+{
+	const UINT32 entry = clear->GlyphHash[hash % CLEARCODEC_GLYPH_HASH_SIZE];
+
+	if (entry == 0)
+		return -1;
+
+	const CLEAR_GLYPH_ENTRY* glyphEntry = &clear->GlyphCache[entry - 1];
+
+	if ((glyphEntry->count != count) || (glyphEntry->hash != hash))
+		return -1;
+
+	if (memcmp(glyphEntry->pixels, pixels, count * sizeof(UINT32)) != 0)
+		return -1;
+
+	return WINPR_ASSERTING_INT_CAST(INT32, entry - 1);
+}
+
+static BOOL clear_glyph_insert(CLEAR_CONTEXT* WINPR_RESTRICT clear, UINT32 hash,
+                               const UINT32* WINPR_RESTRICT pixels, UINT32 count,
+                               UINT16* WINPR_RESTRICT pGlyphIndex)
+{
+	const UINT32 glyphIndex = clear->GlyphCursor;
+	CLEAR_GLYPH_ENTRY* glyphEntry = &clear->GlyphCache[glyphIndex];
+
+	if (count > glyphEntry->size)
+	{
+		UINT32* tmp = winpr_aligned_recalloc(glyphEntry->pixels, count, sizeof(UINT32), 32);
+
+		if (!tmp)
+			return FALSE;
+
+		glyphEntry->pixels = tmp;
+		glyphEntry->size = count;
+	}
+
+	memcpy(glyphEntry->pixels, pixels, count * sizeof(UINT32));
+	glyphEntry->count = count;
+	glyphEntry->hash = hash;
+	clear->GlyphHash[hash % CLEARCODEC_GLYPH_HASH_SIZE] = glyphIndex + 1;
+	clear->GlyphCursor = (glyphIndex + 1) % CLEARCODEC_GLYPH_CACHE_SIZE;
+	*pGlyphIndex = WINPR_ASSERTING_INT_CAST(UINT16, glyphIndex);
+	return TRUE;
+}
+
+INT32 clear_compress_to_stream(CLEAR_CONTEXT* WINPR_RESTRICT clear, wStream* WINPR_RESTRICT s,
+                               const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcFormat,
+                               UINT32 nSrcStep, UINT32 nWidth, UINT32 nHeight)
+{
+	BYTE glyphFlags = 0;
+	UINT16 glyphIndex = 0;
+	BOOL residual = FALSE;
+
+	if (!clear || !s || !pSrcData)
+		return -1;
+
+	if (!clear->Compressor)
+	{
+		WLog_Print(clear->log, WLOG_ERROR, "context was not created for compression");
+		return -1;
+	}
+
+	if ((nWidth == 0) || (nHeight == 0))
+		return -1022;
+
+	if ((nWidth > 0xFFFF) || (nHeight > 0xFFFF))
+		return -1004;
+
+	if (!clear_resize_buffer(clear, nWidth, nHeight))
+		return -1;
+
+	/* The codec works on BGR triplets. Pixels are compared as 0xFFRRGGBB values in host byte
+	 * order, so the encoding does not depend on the byte order or on alpha */
+	if (!freerdp_image_copy_no_overlap(clear->TempBuffer, clear->format, nWidth * 4, 0, 0, nWidth,
+	                                   nHeight, pSrcData, SrcFormat, nSrcStep, 0, 0, nullptr,
+	                                   FREERDP_FLIP_NONE))
+		return -1;
+
+	const UINT32 pixelCount = nWidth * nHeight;
+	UINT32* pixels = (UINT32*)clear->TempBuffer;
+
+	for (UINT32 x = 0; x < pixelCount; x++)
+	{
+		const BYTE* bgrx = &clear->TempBuffer[4ull * x];
+		pixels[x] = 0xFF000000u | ((UINT32)bgrx[2] << 16) | ((UINT32)bgrx[1] << 8) | bgrx[0];
+	}
+
+	if (clear->CacheResetPending)
+	{
+		glyphFlags |= CLEARCODEC_FLAG_CACHE_RESET;
+		clear->VBarStorageCursor = 0;
+		clear->ShortVBarStorageCursor = 0;
+		clear->CacheResetPending = FALSE;
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 16))
+		return -1;
+
+	if (pixelCount <= CLEARCODEC_GLYPH_MAX_PIXELS)
+	{
+		const UINT32 hash = clear_hash_pixels(pixels, pixelCount);
+		const INT32 hit = clear_glyph_lookup(clear, hash, pixels, pixelCount);
+
+		if (hit >= 0)
+		{
+			Stream_Write_UINT8(s, glyphFlags | CLEARCODEC_FLAG_GLYPH_INDEX |
+			                          CLEARCODEC_FLAG_GLYPH_HIT);
+			Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, clear->seqNumber));
+			Stream_Write_UINT16(s, WINPR_ASSERTING_INT_CAST(UINT16, hit));
+			clear->seqNumber = (clear->seqNumber + 1) % 256;
+			return 0;
+		}
+
+		if (!clear_glyph_insert(clear, hash, pixels, pixelCount, &glyphIndex))
+			return -1;
+
+		glyphFlags |= CLEARCODEC_FLAG_GLYPH_INDEX;
+	}
+
+	Stream_Write_UINT8(s, glyphFlags);
+	Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(BYTE, clear->seqNumber));
+
+	if (glyphFlags & CLEARCODEC_FLAG_GLYPH_INDEX)
+		Stream_Write_UINT16(s, glyphIndex);
+
+	const size_t headerPos = Stream_GetPosition(s);
+	Stream_Seek(s, 12);
+
+	Stream_ResetPosition(clear->BandsStream);
+	Stream_ResetPosition(clear->SubcodecStream);
+
+	if (!clear_compress_layers(clear, pixels, nWidth, nHeight, &residual))
+		return -1;
+
+	const size_t residualPos = Stream_GetPosition(s);
+
+	if (residual && !clear_compress_residual(clear, s, pixels, nWidth, nHeight))
+		return -1;
+
+	const size_t residualByteCount = Stream_GetPosition(s) - residualPos;
+	const size_t bandsByteCount = Stream_GetPosition(clear->BandsStream);
+	const size_t subcodecByteCount = Stream_GetPosition(clear->SubcodecStream);
+
+	if (!Stream_EnsureRemainingCapacity(s, bandsByteCount + subcodecByteCount))
+		return -1;
+
+	Stream_Write(s, Stream_Buffer(clear->BandsStream), bandsByteCount);
+	Stream_Write(s, Stream_Buffer(clear->SubcodecStream), subcodecByteCount);
+
+	const size_t end = Stream_GetPosition(s);
+	if (!Stream_SetPosition(s, headerPos))
+		return -1;
+
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, residualByteCount));
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, bandsByteCount));
+	Stream_Write_UINT32(s, WINPR_ASSERTING_INT_CAST(UINT32, subcodecByteCount));
+
+	if (!Stream_SetPosition(s, end))
+		return -1;
+
+	clear->seqNumber = (clear->seqNumber + 1) % 256;
+	return 0;
+}
+
 #if !defined(WITHOUT_FREERDP_3x_DEPRECATED)
 int clear_compress(WINPR_ATTR_UNUSED CLEAR_CONTEXT* WINPR_RESTRICT clear,
                    WINPR_ATTR_UNUSED const BYTE* WINPR_RESTRICT pSrcData,
@@ -1319,6 +2153,22 @@ CLEAR_CONTEXT* clear_context_new(BOOL Compressor)
 	if (!clear_context_reset(clear))
 		goto error_nsc;
 
+	if (Compressor)
+	{
+		clear->GlyphHash = (UINT32*)calloc(CLEARCODEC_GLYPH_HASH_SIZE, sizeof(UINT32));
+		clear->VBarHash = (UINT32*)calloc(CLEARCODEC_VBAR_HASH_SIZE, sizeof(UINT32));
+		clear->ShortVBarHash = (UINT32*)calloc(CLEARCODEC_VBAR_HASH_SIZE, sizeof(UINT32));
+		clear->BandsStream = Stream_New(nullptr, 4096);
+		clear->SubcodecStream = Stream_New(nullptr, 4096);
+
+		if (!clear->GlyphHash || !clear->VBarHash || !clear->ShortVBarHash ||
+		    !clear->BandsStream || !clear->SubcodecStream)
+			goto error_nsc;
+
+		/* The peer might still hold caches of an earlier context */
+		clear->CacheResetPending = TRUE;
+	}
+
 	return clear;
 error_nsc:
 	WINPR_PRAGMA_DIAG_PUSH
@@ -1339,5 +2189,13 @@ void clear_context_free(CLEAR_CONTEXT* WINPR_RESTRICT clear)
 	clear_reset_vbar_storage(clear, TRUE);
 	clear_reset_glyph_cache(clear);
 
+	free(clear->GlyphHash);
+	free(clear->VBarHash);
+	free(clear->ShortVBarHash);
+	free(clear->Blocks);
+	winpr_aligned_free(clear->NscBuffer);
+	Stream_Free(clear->BandsStream, TRUE);
+	Stream_Free(clear->SubcodecStream, TRUE);
+
 	winpr_aligned_free(clear);
 }
@@ -31,14 +31,6 @@
 #include <freerdp/freerdp.h>
 #include <freerdp/primitives.h>
 
-#if defined(WITH_CAIRO)
-#include <cairo.h>
-#endif
-
-#if defined(WITH_SWSCALE)
-#include "image_ffmpeg.h"
-#endif
-
 #include "color.h"
 
 #define TAG FREERDP_TAG("color")
@@ -1207,29 +1199,6 @@ BOOL freerdp_image_fill_ex(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT3
 	return freerdp_image_fill(pDstData, DstFormat, nDstStep, nXDst, nYDst, nWidth, nHeight, color);
 }
 
-#if defined(WITH_SWSCALE)
-static enum AVPixelFormat av_format_for_buffer(UINT32 format)
-{
-	switch (format)
-	{
-		case PIXEL_FORMAT_ARGB32:
-			return AV_PIX_FMT_BGRA;
-
-		case PIXEL_FORMAT_XRGB32:
-			return AV_PIX_FMT_BGR0;
-
-		case PIXEL_FORMAT_BGRA32:
-			return AV_PIX_FMT_RGBA;
-
-		case PIXEL_FORMAT_BGRX32:
-			return AV_PIX_FMT_RGB0;
-
-		default:
-			return AV_PIX_FMT_NONE;
-	}
-}
-#endif
-
 BOOL freerdp_image_scale(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT32 nDstStep,
                          UINT32 nXDst, UINT32 nYDst, UINT32 nDstWidth, UINT32 nDstHeight,
                          const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
@@ -1243,11 +1212,6 @@ BOOL freerdp_image_scale(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT32
 	if (nSrcStep == 0)
 		nSrcStep = nSrcWidth * FreeRDPGetBytesPerPixel(SrcFormat);
 
-#if defined(WITH_SWSCALE) || defined(WITH_CAIRO)
-	const BYTE* src = &pSrcData[nXSrc * FreeRDPGetBytesPerPixel(SrcFormat) + nYSrc * nSrcStep];
-	BYTE* dst = &pDstData[nXDst * FreeRDPGetBytesPerPixel(DstFormat) + nYDst * nDstStep];
-#endif
-
 	/* direct copy is much faster than scaling, so check if we can simply copy... */
 	if ((nDstWidth == nSrcWidth) && (nDstHeight == nSrcHeight))
 	{
@@ -1255,86 +1219,17 @@ BOOL freerdp_image_scale(BYTE* WINPR_RESTRICT pDstData, DWORD DstFormat, UINT32
 		                                     nDstHeight, pSrcData, SrcFormat, nSrcStep, nXSrc,
 		                                     nYSrc, nullptr, FREERDP_FLIP_NONE);
 	}
-	else
-#if defined(WITH_SWSCALE)
-	{
-		int res = 0;
-		struct SwsContext* resize = nullptr;
-		enum AVPixelFormat srcFormat = av_format_for_buffer(SrcFormat);
-		enum AVPixelFormat dstFormat = av_format_for_buffer(DstFormat);
-		const int srcStep[1] = { (int)nSrcStep };
-		const int dstStep[1] = { (int)nDstStep };
-
-		if ((srcFormat == AV_PIX_FMT_NONE) || (dstFormat == AV_PIX_FMT_NONE))
-			return FALSE;
 
-		if (!freerdp_swscale_available())
-		{
-			WLog_WARN(TAG, "swscale not available");
-			return FALSE;
-		}
-
-		resize = freerdp_sws_getContext((int)nSrcWidth, (int)nSrcHeight, srcFormat, (int)nDstWidth,
-		                                (int)nDstHeight, dstFormat, SWS_BILINEAR, nullptr, nullptr,
-		                                nullptr);
-
-		if (!resize)
-			goto fail;
-
-		/* sws_scale expects arrays of pointers, not pointer-to-pointer */
-		const BYTE* srcSlice[4] = { src, nullptr, nullptr, nullptr };
-		BYTE* dstSlice[4] = { dst, nullptr, nullptr, nullptr };
-		const int srcSteps[4] = { srcStep[0], 0, 0, 0 };
-		const int dstSteps[4] = { dstStep[0], 0, 0, 0 };
-
-		res = freerdp_sws_scale(resize, srcSlice, srcSteps, 0, (int)nSrcHeight, dstSlice, dstSteps);
-		rc = (res == ((int)nDstHeight));
-	fail:
-		freerdp_sws_freeContext(resize);
-	}
-
-#elif defined(WITH_CAIRO)
-	{
-		const double sx = (double)nDstWidth / (double)nSrcWidth;
-		const double sy = (double)nDstHeight / (double)nSrcHeight;
-		cairo_t* cairo_context;
-		cairo_surface_t *csrc, *cdst;
-
-		if ((nSrcWidth > INT_MAX) || (nSrcHeight > INT_MAX) || (nSrcStep > INT_MAX))
-			return FALSE;
+	/* callers scaling the same size repeatedly should keep a FREERDP_IMAGE_SCALER around */
+	FREERDP_IMAGE_SCALER* scaler = freerdp_image_scaler_new(FREERDP_IMAGE_SCALE_BILINEAR);
+	if (!scaler)
+		return FALSE;
 
-		if ((nDstWidth > INT_MAX) || (nDstHeight > INT_MAX) || (nDstStep > INT_MAX))
-			return FALSE;
+	if (freerdp_image_scaler_set_size(scaler, nSrcWidth, nSrcHeight, nDstWidth, nDstHeight))
+		rc = freerdp_image_scaler_scale(scaler, pDstData, DstFormat, nDstStep, nXDst, nYDst,
+		                                pSrcData, SrcFormat, nSrcStep, nXSrc, nYSrc, nullptr);
 
-		csrc = cairo_image_surface_create_for_data((void*)src, CAIRO_FORMAT_ARGB32, (int)nSrcWidth,
-		                                           (int)nSrcHeight, (int)nSrcStep);
-		cdst = cairo_image_surface_create_for_data(dst, CAIRO_FORMAT_ARGB32, (int)nDstWidth,
-		                                           (int)nDstHeight, (int)nDstStep);
-
-		if (!csrc || !cdst)
-			goto fail;
-
-		cairo_context = cairo_create(cdst);
-
-		if (!cairo_context)
-			goto fail2;
-
-		cairo_scale(cairo_context, sx, sy);
-		cairo_set_operator(cairo_context, CAIRO_OPERATOR_SOURCE);
-		cairo_set_source_surface(cairo_context, csrc, 0, 0);
-		cairo_paint(cairo_context);
-		rc = TRUE;
-	fail2:
-		cairo_destroy(cairo_context);
-	fail:
-		cairo_surface_destroy(csrc);
-		cairo_surface_destroy(cdst);
-	}
-#else
-	{
-		WLog_WARN(TAG, "SmartScaling requested but compiled without libcairo support!");
-	}
-#endif
+	freerdp_image_scaler_free(scaler);
 	return rc;
 }
 
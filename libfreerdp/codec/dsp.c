@@ -31,6 +31,7 @@
 #include <freerdp/codec/dsp.h>
 
 #include "dsp.h"
+#include "dsp_resample.h"
 
 #if defined(WITH_FDK_AAC)
 #include "dsp_fdk_aac.h"
@@ -118,6 +119,8 @@ struct S_FREERDP_DSP_CONTEXT
 
 #if defined(WITH_SOXR)
 	soxr_t sox;
+#else
+	FREERDP_DSP_RESAMPLER* resampler;
 #endif
 };
 
@@ -177,13 +180,19 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 				if (!Stream_EnsureCapacity(context->common.channelmix, size * 2))
 					return FALSE;
 
-				for (size_t x = 0; x < samples; x++)
+				if (bpp == 2)
 				{
-					for (size_t y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->common.channelmix, src[x * bpp + y]);
-
-					for (size_t y = 0; y < bpp; y++)
-						Stream_Write_UINT8(context->common.channelmix, src[x * bpp + y]);
+					freerdp_dsp_get_kernels()->upmix(src, Stream_Buffer(context->common.channelmix),
+					                                 samples);
+					Stream_Seek(context->common.channelmix, samples * 4);
+				}
+				else
+				{
+					for (size_t x = 0; x < samples; x++)
+					{
+						Stream_Write_UINT8(context->common.channelmix, src[x]);
+						Stream_Write_UINT8(context->common.channelmix, src[x]);
+					}
 				}
 
 				Stream_SealLength(context->common.channelmix);
@@ -204,12 +213,20 @@ static BOOL freerdp_dsp_channel_mix(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 			if (!Stream_EnsureCapacity(context->common.channelmix, size / 2))
 				return FALSE;
 
-			/* Simply drop second channel.
-			 * TODO: Calculate average */
-			for (size_t x = 0; x < samples; x++)
+			if (bpp == 2)
+			{
+				freerdp_dsp_get_kernels()->downmix(src, Stream_Buffer(context->common.channelmix),
+				                                   samples);
+				Stream_Seek(context->common.channelmix, samples * 2);
+			}
+			else
 			{
-				for (size_t y = 0; y < bpp; y++)
-					Stream_Write_UINT8(context->common.channelmix, src[2 * x * bpp + y]);
+				for (size_t x = 0; x < samples; x++)
+				{
+					const UINT32 l = src[2 * x];
+					const UINT32 r = src[2 * x + 1];
+					Stream_Write_UINT8(context->common.channelmix, (BYTE)((l + r) / 2));
+				}
 			}
 
 			Stream_SealLength(context->common.channelmix);
@@ -294,8 +311,32 @@ static BOOL freerdp_dsp_resample(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 	*length = Stream_Length(context->common.resample);
 	return (error == 0) != 0;
 #else
-	WLog_ERR(TAG, "Missing resample support, recompile -DWITH_SOXR=ON or -DWITH_DSP_FFMPEG=ON");
-	return FALSE;
+	if (srcFormat->wBitsPerSample != 16)
+	{
+		WLog_ERR(TAG, "requires 16 bit sample input, got %" PRIu16, srcFormat->wBitsPerSample);
+		return FALSE;
+	}
+
+	const size_t channels = srcFormat->nChannels;
+	if (!freerdp_dsp_resampler_matches(context->resampler, srcFormat->nSamplesPerSec,
+	                                   context->common.format.nSamplesPerSec, channels))
+	{
+		freerdp_dsp_resampler_free(context->resampler);
+		context->resampler = freerdp_dsp_resampler_new(
+		    srcFormat->nSamplesPerSec, context->common.format.nSamplesPerSec, channels);
+		if (!context->resampler)
+			return FALSE;
+	}
+
+	Stream_ResetPosition(context->common.resample);
+	if (!freerdp_dsp_resampler_process(context->resampler, src, size / (2 * channels),
+	                                   context->common.resample))
+		return FALSE;
+
+	Stream_SealLength(context->common.resample);
+	*data = Stream_Buffer(context->common.resample);
+	*length = Stream_Length(context->common.resample);
+	return TRUE;
 #endif
 }
 
@@ -1355,6 +1396,8 @@ void freerdp_dsp_context_free(FREERDP_DSP_CONTEXT* context)
 #endif
 #if defined(WITH_SOXR)
 		soxr_delete(context->sox);
+#else
+		freerdp_dsp_resampler_free(context->resampler);
 #endif
 	    free(context);
 
@@ -1724,6 +1767,9 @@ BOOL freerdp_dsp_context_reset(FREERDP_DSP_CONTEXT* WINPR_RESTRICT context,
 		if (!context->sox || (error != nullptr))
 			return FALSE;
 	}
+#else
+	freerdp_dsp_resampler_free(context->resampler);
+	context->resampler = nullptr;
 #endif
 	return TRUE;
 #endif
@@ -0,0 +1,344 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - Built-in resampler and channel mixer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/endian.h>
+#include <winpr/synch.h>
+
+#include <freerdp/types.h>
+#include <freerdp/log.h>
+
+#include "dsp_resample.h"
+#include "sse/dsp_sse2.h"
+#include "neon/dsp_neon.h"
+
+#define TAG FREERDP_TAG("codec.dsp")
+
+/* Input frames converted per block, the history holds this plus one filter length */
+#define DSP_RESAMPLE_BLOCK 1024
+/* Upper bound of the filter bank size, this rejects rates without a small common divisor */
+#define DSP_RESAMPLE_MAX_COEFFS (1024 * 1024)
+/* Zero crossings of the prototype filter on each side when upsampling */
+#define DSP_RESAMPLE_ZEROS 32
+/* Passband edge relative to the lower Nyquist frequency and Kaiser window shape (~80dB) */
+#define DSP_RESAMPLE_CUTOFF 0.9
+#define DSP_RESAMPLE_BETA 8.0
+#define DSP_RESAMPLE_PI 3.14159265358979323846
+
+struct S_FREERDP_DSP_RESAMPLER
+{
+	UINT32 srcRate;
+	UINT32 dstRate;
+	size_t channels;
+
+	UINT32 up;
+	UINT32 down;
+	size_t taps;
+	float* coeffs;
+
+	UINT32 phase;
+	size_t pos;
+	size_t fill;
+	size_t capacity;
+	float* history;
+
+	const FREERDP_DSP_KERNELS* kernels;
+};
+
+static float freerdp_dsp_dot_generic(const float* WINPR_RESTRICT x, const float* WINPR_RESTRICT h,
+                                     size_t count)
+{
+	float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		acc[0] += x[i] * h[i];
+		acc[1] += x[i + 1] * h[i + 1];
+		acc[2] += x[i + 2] * h[i + 2];
+		acc[3] += x[i + 3] * h[i + 3];
+	}
+
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+static void freerdp_dsp_upmix_generic(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                      size_t frames)
+{
+	for (size_t x = 0; x < frames; x++)
+	{
+		memcpy(&dst[4 * x], &src[2 * x], 2);
+		memcpy(&dst[4 * x + 2], &src[2 * x], 2);
+	}
+}
+
+static void freerdp_dsp_downmix_generic(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                        size_t frames)
+{
+	for (size_t x = 0; x < frames; x++)
+	{
+		const INT32 l = winpr_Data_Get_INT16(&src[4 * x]);
+		const INT32 r = winpr_Data_Get_INT16(&src[4 * x + 2]);
+		winpr_Data_Write_INT16(&dst[2 * x], (INT16)((l + r) >> 1));
+	}
+}
+
+static const FREERDP_DSP_KERNELS freerdp_dsp_kernels_generic = { freerdp_dsp_dot_generic,
+	                                                             freerdp_dsp_upmix_generic,
+	                                                             freerdp_dsp_downmix_generic };
+
+static INIT_ONCE freerdp_dsp_kernels_InitOnce = INIT_ONCE_STATIC_INIT;
+static FREERDP_DSP_KERNELS freerdp_dsp_kernels_optimized = WINPR_C_ARRAY_INIT;
+
+static BOOL CALLBACK freerdp_dsp_init_kernels_cb(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                                 WINPR_ATTR_UNUSED PVOID param,
+                                                 WINPR_ATTR_UNUSED PVOID* context)
+{
+	freerdp_dsp_kernels_optimized = freerdp_dsp_kernels_generic;
+	freerdp_dsp_init_sse2(&freerdp_dsp_kernels_optimized);
+	freerdp_dsp_init_neon(&freerdp_dsp_kernels_optimized);
+	return TRUE;
+}
+
+const FREERDP_DSP_KERNELS* freerdp_dsp_get_kernels_generic(void)
+{
+	return &freerdp_dsp_kernels_generic;
+}
+
+const FREERDP_DSP_KERNELS* freerdp_dsp_get_kernels(void)
+{
+	if (!InitOnceExecuteOnce(&freerdp_dsp_kernels_InitOnce, freerdp_dsp_init_kernels_cb, nullptr,
+	                         nullptr))
+		return &freerdp_dsp_kernels_generic;
+	return &freerdp_dsp_kernels_optimized;
+}
+
+static UINT32 freerdp_dsp_gcd(UINT32 a, UINT32 b)
+{
+	while (b != 0)
+	{
+		const UINT32 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static double freerdp_dsp_bessel_i0(double x)
+{
+	const double q = x * x / 4.0;
+	double term = 1.0;
+	double sum = 1.0;
+
+	for (size_t k = 1; k < 64; k++)
+	{
+		term *= q / (double)(k * k);
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+/**
+ * Fill one filter per output phase from a Kaiser windowed sinc. Phase \b p
+ * interpolates the input at \b base + \b p / \b up, each phase is normalized to
+ * unity DC gain.
+ */
+static void freerdp_dsp_resampler_design(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler)
+{
+	const double ratio = (resampler->up < resampler->down)
+	                         ? (double)resampler->up / (double)resampler->down
+	                         : 1.0;
+	const double fc = DSP_RESAMPLE_CUTOFF * ratio;
+	const double half = (double)(resampler->taps / 2);
+	const double norm = freerdp_dsp_bessel_i0(DSP_RESAMPLE_BETA);
+
+	for (UINT32 p = 0; p < resampler->up; p++)
+	{
+		float* h = &resampler->coeffs[1ull * p * resampler->taps];
+		double sum = 0.0;
+
+		for (size_t k = 0; k < resampler->taps; k++)
+		{
+			const double t = (double)k - half - (double)p / (double)resampler->up;
+			const double w = t / (half + 1.0);
+			const double x = DSP_RESAMPLE_PI * fc * t;
+			const double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+			const double v =
+			    fc * sinc * freerdp_dsp_bessel_i0(DSP_RESAMPLE_BETA * sqrt(1.0 - w * w)) / norm;
+			h[k] = (float)v;
+			sum += v;
+		}
+
+		for (size_t k = 0; k < resampler->taps; k++)
+			h[k] = (float)(h[k] / sum);
+	}
+}
+
+void freerdp_dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler)
+{
+	if (!resampler)
+		return;
+
+	winpr_aligned_free(resampler->coeffs);
+	free(resampler->history);
+	free(resampler);
+}
+
+FREERDP_DSP_RESAMPLER* freerdp_dsp_resampler_new(UINT32 srcRate, UINT32 dstRate, size_t channels)
+{
+	if ((srcRate == 0) || (dstRate == 0) || (channels == 0))
+		return nullptr;
+
+	FREERDP_DSP_RESAMPLER* resampler = calloc(1, sizeof(FREERDP_DSP_RESAMPLER));
+	if (!resampler)
+		return nullptr;
+
+	const UINT32 g = freerdp_dsp_gcd(srcRate, dstRate);
+	resampler->srcRate = srcRate;
+	resampler->dstRate = dstRate;
+	resampler->channels = channels;
+	resampler->up = dstRate / g;
+	resampler->down = srcRate / g;
+	resampler->kernels = freerdp_dsp_get_kernels();
+
+	/* Widen the filter by the decimation ratio to keep the transition band steep */
+	const double ratio = (resampler->up < resampler->down)
+	                         ? (double)resampler->up / (double)resampler->down
+	                         : 1.0;
+	const size_t half = (size_t)ceil(DSP_RESAMPLE_ZEROS / ratio);
+	resampler->taps = 2 * ((half + 3) & ~(size_t)3);
+
+	if (1ull * resampler->up * resampler->taps > DSP_RESAMPLE_MAX_COEFFS)
+	{
+		WLog_ERR(TAG, "unsupported resample ratio %" PRIu32 " -> %" PRIu32, srcRate, dstRate);
+		goto fail;
+	}
+
+	resampler->coeffs =
+	    winpr_aligned_malloc(1ull * resampler->up * resampler->taps * sizeof(float), 16);
+	resampler->capacity = resampler->taps + DSP_RESAMPLE_BLOCK;
+	resampler->history = calloc(channels * resampler->capacity, sizeof(float));
+	if (!resampler->coeffs || !resampler->history)
+		goto fail;
+
+	freerdp_dsp_resampler_design(resampler);
+
+	/* Prime with half a filter of silence so the first output is centered on the first input */
+	resampler->fill = resampler->taps / 2;
+	return resampler;
+
+fail:
+	freerdp_dsp_resampler_free(resampler);
+	return nullptr;
+}
+
+BOOL freerdp_dsp_resampler_matches(const FREERDP_DSP_RESAMPLER* resampler, UINT32 srcRate,
+                                   UINT32 dstRate, size_t channels)
+{
+	if (!resampler)
+		return FALSE;
+	return (resampler->srcRate == srcRate) && (resampler->dstRate == dstRate) &&
+	       (resampler->channels == channels);
+}
+
+static INT16 freerdp_dsp_float_to_int16(float v)
+{
+	if (v >= 32767.0f)
+		return INT16_MAX;
+	if (v <= -32768.0f)
+		return INT16_MIN;
+	return (INT16)lrintf(v);
+}
+
+BOOL freerdp_dsp_resampler_process(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                   const BYTE* WINPR_RESTRICT src, size_t frames,
+                                   wStream* WINPR_RESTRICT out)
+{
+	WINPR_ASSERT(resampler);
+	WINPR_ASSERT(src || (frames == 0));
+	WINPR_ASSERT(out);
+
+	const size_t channels = resampler->channels;
+	const size_t frameSize = 2ull * channels;
+	const size_t capacity = resampler->capacity;
+
+	while (frames > 0)
+	{
+		const size_t count = MIN(frames, capacity - resampler->fill);
+
+		for (size_t c = 0; c < channels; c++)
+		{
+			float* hist = &resampler->history[c * capacity + resampler->fill];
+			const BYTE* s = &src[2 * c];
+
+			for (size_t x = 0; x < count; x++)
+				hist[x] = (float)winpr_Data_Get_INT16(&s[x * frameSize]);
+		}
+
+		resampler->fill += count;
+		src += count * frameSize;
+		frames -= count;
+
+		if (resampler->pos + resampler->taps <= resampler->fill)
+		{
+			const size_t avail = resampler->fill - resampler->pos - resampler->taps + 1;
+			const size_t outFrames = avail * resampler->up / resampler->down + 1;
+			if (!Stream_EnsureRemainingCapacity(out, outFrames * frameSize))
+				return FALSE;
+		}
+
+		while (resampler->pos + resampler->taps <= resampler->fill)
+		{
+			const float* h = &resampler->coeffs[1ull * resampler->phase * resampler->taps];
+			BYTE* dst = Stream_Pointer(out);
+
+			for (size_t c = 0; c < channels; c++)
+			{
+				const float* x = &resampler->history[c * capacity + resampler->pos];
+				const float v = resampler->kernels->dot(x, h, resampler->taps);
+				winpr_Data_Write_INT16(&dst[2 * c], freerdp_dsp_float_to_int16(v));
+			}
+
+			Stream_Seek(out, frameSize);
+			resampler->phase += resampler->down;
+			resampler->pos += resampler->phase / resampler->up;
+			resampler->phase %= resampler->up;
+		}
+
+		/* Drop consumed history, a decimating filter may skip past the buffered input */
+		const size_t consumed = MIN(resampler->pos, resampler->fill);
+		if (consumed > 0)
+		{
+			for (size_t c = 0; c < channels; c++)
+			{
+				float* hist = &resampler->history[c * capacity];
+				memmove(hist, &hist[consumed], (resampler->fill - consumed) * sizeof(float));
+			}
+			resampler->fill -= consumed;
+			resampler->pos -= consumed;
+		}
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,71 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - Built-in resampler and channel mixer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+#define FREERDP_LIB_CODEC_DSP_RESAMPLE_H
+
+#include <winpr/wtypes.h>
+#include <winpr/stream.h>
+
+#include <freerdp/api.h>
+
+typedef struct S_FREERDP_DSP_RESAMPLER FREERDP_DSP_RESAMPLER;
+
+typedef struct
+{
+	/** @return the dot product of \b count floats, \b h is 16 byte aligned and \b count a
+	 * multiple of 8 */
+	float (*dot)(const float* WINPR_RESTRICT x, const float* WINPR_RESTRICT h, size_t count);
+
+	/** Duplicate \b frames little endian 16bit mono samples to stereo */
+	void (*upmix)(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst, size_t frames);
+
+	/** Average \b frames little endian 16bit stereo samples to mono */
+	void (*downmix)(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst, size_t frames);
+} FREERDP_DSP_KERNELS;
+
+/** @return The portable kernels */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL const FREERDP_DSP_KERNELS* freerdp_dsp_get_kernels_generic(void);
+
+/** @return The fastest kernels for the running CPU */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL const FREERDP_DSP_KERNELS* freerdp_dsp_get_kernels(void);
+
+FREERDP_LOCAL void freerdp_dsp_resampler_free(FREERDP_DSP_RESAMPLER* resampler);
+
+/** Create a polyphase resampler for interleaved 16bit PCM
+ *
+ *  The resampler is streaming, filter history and phase are carried across
+ *  calls to \b freerdp_dsp_resampler_process
+ */
+WINPR_ATTR_MALLOC(freerdp_dsp_resampler_free, 1)
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL FREERDP_DSP_RESAMPLER* freerdp_dsp_resampler_new(UINT32 srcRate, UINT32 dstRate,
+                                                               size_t channels);
+
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL BOOL freerdp_dsp_resampler_matches(const FREERDP_DSP_RESAMPLER* resampler,
+                                                 UINT32 srcRate, UINT32 dstRate, size_t channels);
+
+/** Resample \b frames interleaved frames from \b src and append the result to \b out */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL BOOL freerdp_dsp_resampler_process(FREERDP_DSP_RESAMPLER* WINPR_RESTRICT resampler,
+                                                 const BYTE* WINPR_RESTRICT src, size_t frames,
+                                                 wStream* WINPR_RESTRICT out);
+
+#endif /* FREERDP_LIB_CODEC_DSP_RESAMPLE_H */
@@ -35,6 +35,12 @@
 
 #define TAG FREERDP_TAG("codec")
 
+/* granularity of the encoder change detection */
+#define H264_TILE_SIZE 64
+
+/* every n-th row of a tile is looked at to tell text from video */
+#define H264_TEXT_SAMPLE_ROWS 4
+
 static BOOL avc444_ensure_buffer(H264_CONTEXT* h264, DWORD nDstHeight);
 
 static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, UINT32 height)
@@ -97,6 +103,10 @@ static BOOL yuv_ensure_buffer(H264_CONTEXT* h264, UINT32 stride, UINT32 width, U
 		}
 		h264->width = width;
 		h264->height = height;
+
+		/* the change detection has no previous frame to compare with */
+		h264->firstLumaFrameDone = FALSE;
+		h264->firstChromaFrameDone = FALSE;
 	}
 
 	return TRUE;
@@ -169,117 +179,317 @@ INT32 avc420_decompress(H264_CONTEXT* h264, const BYTE* pSrcData, UINT32 SrcSize
 	return 1;
 }
 
-static BOOL allocate_h264_metablock(UINT32 QP, RECTANGLE_16* rectangles,
-                                    RDPGFX_H264_METABLOCK* meta, size_t count)
+/* Quantization of a changed region, text and UI content gets a finer quantizer than video */
+static UINT32 h264_region_qp(UINT32 QP, BOOL text)
+{
+	if (!text)
+		return QP;
+	if (QP > H264_TEXT_QP_DELTA)
+		return QP - H264_TEXT_QP_DELTA;
+	return 0;
+}
+
+static BOOL h264_fill_metablock(UINT32 QP, const H264_REGION* regions, UINT32 count,
+                                RDPGFX_H264_METABLOCK* meta)
 {
 	/* [MS-RDPEGFX] 2.2.4.4.2 RDPGFX_AVC420_QUANT_QUALITY */
 	if (!meta || (QP > UINT8_MAX))
-	{
-		free(rectangles);
 		return FALSE;
-	}
 
-	meta->regionRects = rectangles;
 	if (count == 0)
 		return TRUE;
 
-	if (count > UINT32_MAX)
-		return FALSE;
-
+	meta->regionRects = calloc(count, sizeof(RECTANGLE_16));
 	meta->quantQualityVals = calloc(count, sizeof(RDPGFX_H264_QUANT_QUALITY));
 
 	if (!meta->quantQualityVals || !meta->regionRects)
 		return FALSE;
-	meta->numRegionRects = (UINT32)count;
+	meta->numRegionRects = count;
 	for (size_t x = 0; x < count; x++)
 	{
 		RDPGFX_H264_QUANT_QUALITY* cur = &meta->quantQualityVals[x];
-		cur->qp = (UINT8)QP;
+		const UINT32 qp = h264_region_qp(QP, regions[x].text);
+
+		meta->regionRects[x] = regions[x].rect;
+		cur->qp = (UINT8)qp;
 
 		/* qpVal bit 6 and 7 are flags, so mask them out here.
 		 * qualityVal is [0-100] so 100 - qpVal [0-64] is always in range */
-		cur->qualityVal = 100 - (QP & 0x3F);
+		cur->qualityVal = 100 - (qp & 0x3F);
 	}
 	return TRUE;
 }
 
-static inline BOOL diff_tile(const RECTANGLE_16* regionRect, BYTE* pYUVData[3],
-                             BYTE* pOldYUVData[3], UINT32 const iStride[3])
+/* Samples of a tile in the planes of a frame. The chroma frame of AVC444v1 interleaves the
+ * rows of 16 line blocks, so tiles always cover complete blocks (the buffers are padded to 16).
+ * The chroma frame of AVC444v2 keeps the odd columns of U and V in the left and right half of
+ * its luma plane and every 4th column of the odd rows in the halves of its chroma planes, so a
+ * tile is found twice there, the second part at an offset of half the plane width. */
+static inline void tile_plane_rect(const H264_CONTEXT* h264, const RECTANGLE_16* tile,
+                                   size_t plane, BOOL v2, size_t* left, size_t* top,
+                                   size_t* width, size_t* bottom, size_t* half)
 {
-	size_t size = 0;
+	const size_t shift = (plane == 0) ? 0 : 1;
+	const size_t columnShift = v2 ? shift + 1 : shift;
+	const size_t round = (1ull << columnShift) - 1ull;
+	const size_t tileBottom = (tile->bottom + 15ull) & ~15ull;
+
+	*left = tile->left >> columnShift;
+	*top = tile->top >> shift;
+	*width = ((tile->right + round) >> columnShift) - *left;
+	*bottom = (tileBottom + shift) >> shift;
+	*half = v2 ? h264->width >> columnShift : 0;
+}
 
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride)
-		return FALSE;
-	size = regionRect->right - regionRect->left;
-	if (regionRect->right > iStride[0])
-		return FALSE;
-	if (regionRect->right / 2u > iStride[1])
-		return FALSE;
-	if (regionRect->right / 2u > iStride[2])
-		return FALSE;
+static void copy_tile(const H264_CONTEXT* h264, const RECTANGLE_16* tile, BOOL v2,
+                      BYTE* pDstData[3], BYTE* pSrcData[3])
+{
+	for (size_t plane = 0; plane < 3; plane++)
+	{
+		size_t left = 0;
+		size_t top = 0;
+		size_t width = 0;
+		size_t bottom = 0;
+		size_t half = 0;
+
+		if (!pDstData[plane] || !pSrcData[plane])
+			continue;
+
+		tile_plane_rect(h264, tile, plane, v2, &left, &top, &width, &bottom, &half);
+		for (size_t y = top; y < bottom; y++)
+		{
+			const size_t offset = y * h264->iStride[plane] + left;
+			memcpy(&pDstData[plane][offset], &pSrcData[plane][offset], width);
+			if (half > 0)
+				memcpy(&pDstData[plane][offset + half], &pSrcData[plane][offset + half], width);
+		}
+	}
+}
 
-	for (size_t y = regionRect->top; y < regionRect->bottom; y++)
+static inline BOOL diff_tile(const H264_CONTEXT* h264, const RECTANGLE_16* tile, BOOL v2,
+                             BYTE* pYUVData[3], BYTE* pOldYUVData[3])
+{
+	for (size_t plane = 0; plane < 3; plane++)
 	{
-		const BYTE* cur0 = &pYUVData[0][y * iStride[0]];
-		const BYTE* cur1 = &pYUVData[1][y * iStride[1]];
-		const BYTE* cur2 = &pYUVData[2][y * iStride[2]];
-		const BYTE* old0 = &pOldYUVData[0][y * iStride[0]];
-		const BYTE* old1 = &pOldYUVData[1][y * iStride[1]];
-		const BYTE* old2 = &pOldYUVData[2][y * iStride[2]];
+		size_t left = 0;
+		size_t top = 0;
+		size_t width = 0;
+		size_t bottom = 0;
+		size_t half = 0;
 
-		if (memcmp(&cur0[regionRect->left], &old0[regionRect->left], size) != 0)
-			return TRUE;
-		if (memcmp(&cur1[regionRect->left / 2], &old1[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
-		if (memcmp(&cur2[regionRect->left / 2], &old2[regionRect->left / 2], size / 2) != 0)
-			return TRUE;
+		if (!pYUVData[plane] || !pOldYUVData[plane])
+			continue;
+
+		tile_plane_rect(h264, tile, plane, v2, &left, &top, &width, &bottom, &half);
+		for (size_t y = top; y < bottom; y++)
+		{
+			const size_t offset = y * h264->iStride[plane] + left;
+			if (memcmp(&pYUVData[plane][offset], &pOldYUVData[plane][offset], width) != 0)
+				return TRUE;
+			if ((half > 0) && (memcmp(&pYUVData[plane][offset + half],
+			                          &pOldYUVData[plane][offset + half], width) != 0))
+				return TRUE;
+		}
 	}
 	return FALSE;
 }
 
-static BOOL detect_changes(BOOL firstFrameDone, const UINT32 QP, const RECTANGLE_16* regionRect,
-                           BYTE* pYUVData[3], BYTE* pOldYUVData[3], UINT32 const iStride[3],
-                           RDPGFX_H264_METABLOCK* meta)
+/* Text and UI elements are drawn on flat backgrounds, most neighbouring luma samples are equal.
+ * In video and photos they hardly ever are. */
+static BOOL is_text_tile(const RECTANGLE_16* tile, const BYTE* pLuma, UINT32 stride)
+{
+	size_t flat = 0;
+	size_t total = 0;
+
+	for (size_t y = tile->top; y < tile->bottom; y += H264_TEXT_SAMPLE_ROWS)
+	{
+		const BYTE* line = &pLuma[y * stride];
+		for (size_t x = tile->left + 1; x < tile->right; x++)
+		{
+			if (line[x] == line[x - 1])
+				flat++;
+		}
+		total += tile->right - tile->left - 1ull;
+	}
+
+	return flat * 2 >= total;
+}
+
+static BOOL h264_damage_ensure_buffer(H264_CONTEXT* h264)
 {
-	size_t count = 0;
-	size_t wc = 0;
-	size_t hc = 0;
-	RECTANGLE_16* rectangles = nullptr;
+	WINPR_ASSERT(h264);
 
-	if (!regionRect || !pYUVData || !pOldYUVData || !iStride || !meta)
+	const size_t tiles = 1ull * ((h264->width + H264_TILE_SIZE - 1) / H264_TILE_SIZE) *
+	                     ((h264->height + H264_TILE_SIZE - 1) / H264_TILE_SIZE);
+	if (tiles <= h264->tileCapacity)
+		return TRUE;
+
+	BYTE* state = realloc(h264->tileState, tiles);
+	if (!state)
+		return FALSE;
+	h264->tileState = state;
+
+	RECTANGLE_16* damage = realloc(h264->damageRects, tiles * sizeof(RECTANGLE_16));
+	if (!damage)
 		return FALSE;
+	h264->damageRects = damage;
 
-	wc = (regionRect->right - regionRect->left) / 64 + 1;
-	hc = (regionRect->bottom - regionRect->top) / 64 + 1;
-	rectangles = calloc(wc * hc, sizeof(RECTANGLE_16));
-	if (!rectangles)
+	RECTANGLE_16* rows = realloc(h264->damageRows, tiles * sizeof(RECTANGLE_16));
+	if (!rows)
 		return FALSE;
-	if (!firstFrameDone)
+	h264->damageRows = rows;
+
+	for (size_t x = 0; x < ARRAYSIZE(h264->regions); x++)
 	{
-		rectangles[0] = *regionRect;
-		count = 1;
+		H264_REGION* regions = realloc(h264->regions[x], tiles * sizeof(H264_REGION));
+		if (!regions)
+			return FALSE;
+		h264->regions[x] = regions;
 	}
-	else
+
+	h264->tileCapacity = tiles;
+	return TRUE;
+}
+
+/* Collect the tiles touched by the damage in runs of neighbouring tiles per tile row */
+static void h264_damage_tiles(H264_CONTEXT* h264, const RECTANGLE_16* damageRects,
+                              UINT32 numDamageRects)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(damageRects || (numDamageRects == 0));
+
+	const size_t tilesX = (h264->width + H264_TILE_SIZE - 1) / H264_TILE_SIZE;
+	const size_t tilesY = (h264->height + H264_TILE_SIZE - 1) / H264_TILE_SIZE;
+	BYTE* state = h264->tileState;
+
+	memset(state, 0, tilesX * tilesY);
+	h264->numDamageRects = 0;
+
+	for (size_t x = 0; x < numDamageRects; x++)
 	{
-		for (size_t y = regionRect->top; y < regionRect->bottom; y += 64)
+		const RECTANGLE_16* rect = &damageRects[x];
+		const size_t right = MIN(rect->right, h264->width);
+		const size_t bottom = MIN(rect->bottom, h264->height);
+
+		if ((rect->left >= right) || (rect->top >= bottom))
+			continue;
+
+		for (size_t ty = rect->top / H264_TILE_SIZE; ty <= (bottom - 1) / H264_TILE_SIZE; ty++)
+		{
+			memset(&state[ty * tilesX + rect->left / H264_TILE_SIZE], 1,
+			       (right - 1) / H264_TILE_SIZE - rect->left / H264_TILE_SIZE + 1);
+		}
+	}
+
+	for (size_t ty = 0; ty < tilesY; ty++)
+	{
+		size_t tx = 0;
+		while (tx < tilesX)
 		{
-			for (size_t x = regionRect->left; x < regionRect->right; x += 64)
+			if (!state[ty * tilesX + tx])
 			{
-				RECTANGLE_16 rect;
-				rect.left = (UINT16)MIN(UINT16_MAX, regionRect->left + x);
-				rect.top = (UINT16)MIN(UINT16_MAX, regionRect->top + y);
-				rect.right =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->left + x + 64, regionRect->right));
-				rect.bottom =
-				    (UINT16)MIN(UINT16_MAX, MIN(regionRect->top + y + 64, regionRect->bottom));
-				if (diff_tile(&rect, pYUVData, pOldYUVData, iStride))
-					rectangles[count++] = rect;
+				tx++;
+				continue;
 			}
+
+			const size_t first = tx;
+			while ((tx < tilesX) && state[ty * tilesX + tx])
+				tx++;
+
+			RECTANGLE_16* run = &h264->damageRects[h264->numDamageRects++];
+			run->left = (UINT16)(first * H264_TILE_SIZE);
+			run->top = (UINT16)(ty * H264_TILE_SIZE);
+			run->right = (UINT16)MIN(tx * H264_TILE_SIZE, h264->width);
+			run->bottom = (UINT16)MIN((ty + 1) * H264_TILE_SIZE, h264->height);
 		}
 	}
-	if (!allocate_h264_metablock(QP, rectangles, meta, count))
+}
+
+/* The AVC444v2 conversion places the chroma of a tile depending on the width it converts, so
+ * the tile rows touched by damage are converted in their full width */
+static void h264_damage_rows(H264_CONTEXT* h264)
+{
+	WINPR_ASSERT(h264);
+
+	h264->numDamageRows = 0;
+	for (size_t x = 0; x < h264->numDamageRects; x++)
+	{
+		const RECTANGLE_16* run = &h264->damageRects[x];
+		RECTANGLE_16* last =
+		    (h264->numDamageRows > 0) ? &h264->damageRows[h264->numDamageRows - 1] : nullptr;
+		if (last && (last->top == run->top))
+			continue;
+
+		h264->damageRows[h264->numDamageRows++] = (RECTANGLE_16){
+			.left = 0, .top = run->top, .right = (UINT16)h264->width, .bottom = run->bottom
+		};
+	}
+}
+
+/* Keep the previous content of the damaged tiles before the new frame is converted on top */
+static void h264_damage_save(H264_CONTEXT* h264, BOOL v2, BYTE* pYUVData[3], BYTE* pOldYUVData[3])
+{
+	WINPR_ASSERT(h264);
+
+	for (size_t x = 0; x < h264->numDamageRects; x++)
+		copy_tile(h264, &h264->damageRects[x], v2, pOldYUVData, pYUVData);
+}
+
+/* Changed tiles are reported in frame coordinates, for the chroma frame of AVC444v2 (v2) too */
+static BOOL detect_changes(H264_CONTEXT* h264, BOOL firstFrameDone, size_t frame, BOOL v2,
+                           BYTE* pYUVData[3], BYTE* pOldYUVData[3], RDPGFX_H264_METABLOCK* meta)
+{
+	UINT32 count = 0;
+
+	if (!h264 || !pYUVData || !pOldYUVData || !meta || (frame >= ARRAYSIZE(h264->regions)))
 		return FALSE;
-	return TRUE;
+
+	H264_REGION* regions = h264->regions[frame];
+	for (size_t x = 0; x < h264->numDamageRects; x++)
+	{
+		const RECTANGLE_16* run = &h264->damageRects[x];
+
+		for (size_t left = run->left; left < run->right; left += H264_TILE_SIZE)
+		{
+			const RECTANGLE_16 tile = { .left = (UINT16)left,
+				                        .top = run->top,
+				                        .right = (UINT16)MIN(left + H264_TILE_SIZE, run->right),
+				                        .bottom = run->bottom };
+
+			if (firstFrameDone && !diff_tile(h264, &tile, v2, pYUVData, pOldYUVData))
+				continue;
+
+			/* neighbouring changed tiles of the same kind are reported as one region */
+			const BOOL text = is_text_tile(&tile, pYUVData[0], h264->iStride[0]);
+			H264_REGION* last = (count > 0) ? &regions[count - 1] : nullptr;
+			if (last && (last->text == text) && (last->rect.top == tile.top) &&
+			    (last->rect.right == tile.left))
+				last->rect.right = tile.right;
+			else
+				regions[count++] = (H264_REGION){ .rect = tile, .text = text };
+		}
+	}
+
+	return h264_fill_metablock(h264->QP, regions, count, meta);
+}
+
+static INT32 h264_compress_frame(H264_CONTEXT* h264, BYTE* pYUVData[3], BOOL firstFrameDone,
+                                 size_t frame, BOOL v2, const RDPGFX_H264_METABLOCK* meta,
+                                 BYTE** ppDstData, UINT32* pDstSize)
+{
+	const BYTE* pcYUVData[3] = { pYUVData[0], pYUVData[1], pYUVData[2] };
+
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(meta);
+
+	/* after the first frame everything outside of the changed regions is unchanged. The regions
+	 * of the AVC444v2 chroma frame do not tell where its changed samples are, it has no ROI. */
+	h264->roiRegions = h264->regions[frame];
+	h264->numRoiRegions = (firstFrameDone && !v2) ? meta->numRegionRects : 0;
+	const INT32 rc = h264->subsystem->Compress(h264, pcYUVData, h264->iStride, ppDstData, pDstSize);
+	h264->roiRegions = nullptr;
+	h264->numRoiRegions = 0;
+	return rc;
 }
 
 INT32 h264_get_yuv_buffer(H264_CONTEXT* h264, UINT32 nSrcStride, UINT32 nSrcWidth,
@@ -313,13 +523,22 @@ INT32 h264_compress(H264_CONTEXT* h264, BYTE** ppDstData, UINT32* pDstSize)
 INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat, UINT32 nSrcStep,
                       UINT32 nSrcWidth, UINT32 nSrcHeight, const RECTANGLE_16* regionRect,
                       BYTE** ppDstData, UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta)
+{
+	if (!regionRect)
+		return -1;
+
+	return avc420_compress_region(h264, pSrcData, SrcFormat, nSrcStep, nSrcWidth, nSrcHeight,
+	                              regionRect, 1, ppDstData, pDstSize, meta);
+}
+
+INT32 avc420_compress_region(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
+                             UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight,
+                             const RECTANGLE_16* damageRects, UINT32 numDamageRects,
+                             BYTE** ppDstData, UINT32* pDstSize, RDPGFX_H264_METABLOCK* meta)
 {
 	INT32 rc = -1;
-	BYTE* pYUVData[3] = WINPR_C_ARRAY_INIT;
-	const BYTE* pcYUVData[3] = WINPR_C_ARRAY_INIT;
-	BYTE* pOldYUVData[3] = WINPR_C_ARRAY_INIT;
 
-	if (!h264 || !regionRect || !meta || !h264->Compressor)
+	if (!h264 || (!damageRects && (numDamageRects > 0)) || !meta || !h264->Compressor)
 		return -1;
 
 	if (!h264->subsystem->Compress)
@@ -328,30 +547,20 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	if (!avc420_ensure_buffer(h264, nSrcStep, nSrcWidth, nSrcHeight))
 		return -1;
 
-	if (h264->encodingBuffer)
-	{
-		for (size_t x = 0; x < 3; x++)
-		{
-			pYUVData[x] = h264->pYUVData[x];
-			pOldYUVData[x] = h264->pOldYUVData[x];
-		}
-	}
-	else
-	{
-		for (size_t x = 0; x < 3; x++)
-		{
-			pYUVData[x] = h264->pOldYUVData[x];
-			pOldYUVData[x] = h264->pYUVData[x];
-		}
-	}
-	h264->encodingBuffer = !h264->encodingBuffer;
+	if (!h264_damage_ensure_buffer(h264))
+		return -1;
 
-	if (!yuv420_context_encode(h264->yuv, pSrcData, nSrcStep, SrcFormat, h264->iStride, pYUVData,
-	                           regionRect, 1))
+	h264_damage_tiles(h264, damageRects, numDamageRects);
+	if (h264->numDamageRects == 0)
+		return 0;
+
+	h264_damage_save(h264, FALSE, h264->pYUVData, h264->pOldYUVData);
+	if (!yuv420_context_encode(h264->yuv, pSrcData, nSrcStep, SrcFormat, h264->iStride,
+	                           h264->pYUVData, h264->damageRects, h264->numDamageRects))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, regionRect, pYUVData, pOldYUVData,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, 0, FALSE, h264->pYUVData,
+	                    h264->pOldYUVData, meta))
 		goto fail;
 
 	if (meta->numRegionRects == 0)
@@ -360,10 +569,8 @@ INT32 avc420_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 		goto fail;
 	}
 
-	for (size_t x = 0; x < 3; x++)
-		pcYUVData[x] = pYUVData[x];
-
-	rc = h264->subsystem->Compress(h264, pcYUVData, h264->iStride, ppDstData, pDstSize);
+	rc = h264_compress_frame(h264, h264->pYUVData, h264->firstLumaFrameDone, 0, FALSE, meta,
+	                         ppDstData, pDstSize);
 	if (rc >= 0)
 		h264->firstLumaFrameDone = TRUE;
 
@@ -378,16 +585,28 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
                       BYTE* op, BYTE** ppDstData, UINT32* pDstSize, BYTE** ppAuxDstData,
                       UINT32* pAuxDstSize, RDPGFX_H264_METABLOCK* meta,
                       RDPGFX_H264_METABLOCK* auxMeta)
+{
+	if (!region)
+		return -1;
+
+	return avc444_compress_region(h264, pSrcData, SrcFormat, nSrcStep, nSrcWidth, nSrcHeight,
+	                              version, region, 1, op, ppDstData, pDstSize, ppAuxDstData,
+	                              pAuxDstSize, meta, auxMeta);
+}
+
+INT32 avc444_compress_region(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
+                             UINT32 nSrcStep, UINT32 nSrcWidth, UINT32 nSrcHeight, BYTE version,
+                             const RECTANGLE_16* damageRects, UINT32 numDamageRects, BYTE* op,
+                             BYTE** ppDstData, UINT32* pDstSize, BYTE** ppAuxDstData,
+                             UINT32* pAuxDstSize, RDPGFX_H264_METABLOCK* meta,
+                             RDPGFX_H264_METABLOCK* auxMeta)
 {
 	int rc = -1;
 	BYTE* coded = nullptr;
 	UINT32 codedSize = 0;
-	BYTE** pYUV444Data = nullptr;
-	BYTE** pOldYUV444Data = nullptr;
-	BYTE** pYUVData = nullptr;
-	BYTE** pOldYUVData = nullptr;
 
-	if (!h264 || !h264->Compressor)
+	if (!h264 || !h264->Compressor || (!damageRects && (numDamageRects > 0)) || !op || !meta ||
+	    !auxMeta)
 		return -1;
 
 	if (!h264->subsystem->Compress)
@@ -399,31 +618,33 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 	if (!avc444_ensure_buffer(h264, nSrcHeight))
 		return -1;
 
-	if (h264->encodingBuffer)
-	{
-		pYUV444Data = h264->pOldYUV444Data;
-		pOldYUV444Data = h264->pYUV444Data;
-		pYUVData = h264->pOldYUVData;
-		pOldYUVData = h264->pYUVData;
-	}
-	else
+	if (!h264_damage_ensure_buffer(h264))
+		return -1;
+
+	h264_damage_tiles(h264, damageRects, numDamageRects);
+	if (h264->numDamageRects == 0)
 	{
-		pYUV444Data = h264->pYUV444Data;
-		pOldYUV444Data = h264->pOldYUV444Data;
-		pYUVData = h264->pYUVData;
-		pOldYUVData = h264->pOldYUVData;
+		WLog_Print(h264->log, WLOG_TRACE, "no damage for luma or chroma frame");
+		return 0;
 	}
-	h264->encodingBuffer = !h264->encodingBuffer;
 
+	/* the luma frame is kept in the YUV444 buffers, the chroma frame in the YUV420 ones */
+	const BOOL v2 = (version == 2);
+	h264_damage_save(h264, FALSE, h264->pYUV444Data, h264->pOldYUV444Data);
+	h264_damage_save(h264, v2, h264->pYUVData, h264->pOldYUVData);
+	if (v2)
+		h264_damage_rows(h264);
 	if (!yuv444_context_encode(h264->yuv, version, pSrcData, nSrcStep, SrcFormat, h264->iStride,
-	                           pYUV444Data, pYUVData, region, 1))
+	                           h264->pYUV444Data, h264->pYUVData,
+	                           v2 ? h264->damageRows : h264->damageRects,
+	                           v2 ? h264->numDamageRows : h264->numDamageRects))
 		goto fail;
 
-	if (!detect_changes(h264->firstLumaFrameDone, h264->QP, region, pYUV444Data, pOldYUV444Data,
-	                    h264->iStride, meta))
+	if (!detect_changes(h264, h264->firstLumaFrameDone, 0, FALSE, h264->pYUV444Data,
+	                    h264->pOldYUV444Data, meta))
 		goto fail;
-	if (!detect_changes(h264->firstChromaFrameDone, h264->QP, region, pYUVData, pOldYUVData,
-	                    h264->iStride, auxMeta))
+	if (!detect_changes(h264, h264->firstChromaFrameDone, 1, v2, h264->pYUVData,
+	                    h264->pOldYUVData, auxMeta))
 		goto fail;
 
 	/* [MS-RDPEGFX] 2.2.4.5 RFX_AVC444_BITMAP_STREAM
@@ -447,9 +668,8 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 
 	if ((*op == 0) || (*op == 1))
 	{
-		const BYTE* pcYUV444Data[3] = { pYUV444Data[0], pYUV444Data[1], pYUV444Data[2] };
-
-		if (h264->subsystem->Compress(h264, pcYUV444Data, h264->iStride, &coded, &codedSize) < 0)
+		if (h264_compress_frame(h264, h264->pYUV444Data, h264->firstLumaFrameDone, 0, FALSE,
+		                        meta, &coded, &codedSize) < 0)
 			goto fail;
 		h264->firstLumaFrameDone = TRUE;
 		memcpy(h264->lumaData, coded, codedSize);
@@ -459,9 +679,8 @@ INT32 avc444_compress(H264_CONTEXT* h264, const BYTE* pSrcData, DWORD SrcFormat,
 
 	if ((*op == 0) || (*op == 2))
 	{
-		const BYTE* pcYUVData[3] = { pYUVData[0], pYUVData[1], pYUVData[2] };
-
-		if (h264->subsystem->Compress(h264, pcYUVData, h264->iStride, &coded, &codedSize) < 0)
+		if (h264_compress_frame(h264, h264->pYUVData, h264->firstChromaFrameDone, 1, v2,
+		                        auxMeta, &coded, &codedSize) < 0)
 			goto fail;
 		h264->firstChromaFrameDone = TRUE;
 		*ppAuxDstData = coded;
@@ -809,6 +1028,12 @@ void h264_context_free(H264_CONTEXT* h264)
 		}
 		winpr_aligned_free(h264->lumaData);
 
+		free(h264->tileState);
+		free(h264->damageRects);
+		free(h264->damageRows);
+		for (size_t x = 0; x < ARRAYSIZE(h264->regions); x++)
+			free(h264->regions[x]);
+
 		yuv_context_free(h264->yuv);
 		free(h264);
 	}
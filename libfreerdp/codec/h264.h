@@ -50,6 +50,15 @@ extern "C"
 		WINPR_ATTR_NODISCARD pfnH264SubsystemCompress Compress;
 	};
 
+/* quantizer offset of regions detected as text and UI */
+#define H264_TEXT_QP_DELTA 6
+
+	typedef struct
+	{
+		RECTANGLE_16 rect;
+		BOOL text;
+	} H264_REGION;
+
 	struct S_H264_CONTEXT
 	{
 		BOOL Compressor;
@@ -79,10 +88,23 @@ extern "C"
 		const H264_CONTEXT_SUBSYSTEM* subsystem;
 		YUV_CONTEXT* yuv;
 
-		BOOL encodingBuffer;
 		BOOL firstLumaFrameDone;
 		BOOL firstChromaFrameDone;
 
+		/* encoder damage tracking on a grid of 64x64 tiles */
+		size_t tileCapacity;
+		BYTE* tileState;
+		RECTANGLE_16* damageRects;
+		UINT32 numDamageRects;
+		RECTANGLE_16* damageRows;
+		UINT32 numDamageRows;
+		H264_REGION* regions[2];
+
+		/* changed regions of the frame passed to Compress, the rest of the frame is identical
+		 * to the previous one. 0 if the whole frame has to be encoded. */
+		const H264_REGION* roiRegions;
+		UINT32 numRoiRegions;
+
 		void* lumaData;
 		wLog* log;
 	};
@@ -374,6 +374,54 @@ fail:
 	return rc;
 }
 
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 29, 100)
+/* Text and UI elements in the changed regions of the frame are passed as regions of interest
+ * and get a finer quantizer. The rest of the frame keeps the configured one: unchanged
+ * macroblocks are coded as skip anyway, but are coded again in full on keyframes. */
+static BOOL libavcodec_set_roi(H264_CONTEXT* WINPR_RESTRICT h264, AVFrame* WINPR_RESTRICT frame)
+{
+	WINPR_ASSERT(h264);
+	WINPR_ASSERT(frame);
+
+	av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+
+	size_t count = 0;
+	for (size_t x = 0; x < h264->numRoiRegions; x++)
+	{
+		if (h264->roiRegions[x].text)
+			count++;
+	}
+	if (count == 0)
+		return TRUE;
+
+	AVFrameSideData* sd = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+	                                             count * sizeof(AVRegionOfInterest));
+	if (!sd)
+	{
+		WLog_Print(h264->log, WLOG_ERROR, "Failed to allocate regions of interest");
+		return FALSE;
+	}
+
+	AVRegionOfInterest* roi = (AVRegionOfInterest*)sd->data;
+	for (size_t x = 0; x < h264->numRoiRegions; x++)
+	{
+		const H264_REGION* region = &h264->roiRegions[x];
+		if (!region->text)
+			continue;
+
+		AVRegionOfInterest* cur = roi++;
+		cur->self_size = sizeof(AVRegionOfInterest);
+		cur->left = region->rect.left;
+		cur->top = region->rect.top;
+		cur->right = region->rect.right;
+		cur->bottom = region->rect.bottom;
+		cur->qoffset = av_make_q(-H264_TEXT_QP_DELTA, 51);
+	}
+
+	return TRUE;
+}
+#endif
+
 static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
                                const BYTE** WINPR_RESTRICT pSrcYuv,
                                const UINT32* WINPR_RESTRICT pStride,
@@ -461,6 +509,16 @@ static int libavcodec_compress(H264_CONTEXT* WINPR_RESTRICT h264,
 	}
 #endif
 
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 29, 100)
+#ifdef WITH_VAAPI_H264_ENCODING
+	if (!libavcodec_set_roi(h264, sys->hwctx ? sys->hwVideoFrame : sys->videoFrame))
+		goto fail;
+#else
+	if (!libavcodec_set_roi(h264, sys->videoFrame))
+		goto fail;
+#endif
+#endif
+
 	/* avcodec_encode_video2 is deprecated with libavcodec 57.48.101 */
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
 #ifdef WITH_VAAPI_H264_ENCODING
@@ -0,0 +1,542 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+
+#include "image_scale.h"
+#include "sse/image_scale_sse2.h"
+#include "sse/image_scale_avx2.h"
+#include "neon/image_scale_neon.h"
+
+#define TAG FREERDP_TAG("codec.scale")
+
+/* channel values the generic vertical filter accumulates at once */
+#define IMAGE_SCALE_BLOCK 256
+
+/* marks a slot of the row ring that holds no filtered row */
+#define IMAGE_SCALE_NO_ROW UINT32_MAX
+
+typedef struct
+{
+	UINT32 srcSize;
+	UINT32 dstSize;
+	UINT32 taps;
+	UINT32* offsets;
+	INT16* weights;
+} IMAGE_SCALE_AXIS;
+
+struct S_FREERDP_IMAGE_SCALER
+{
+	FREERDP_IMAGE_SCALE_FILTER filter;
+	const FREERDP_IMAGE_SCALE_KERNELS* kernels;
+
+	IMAGE_SCALE_AXIS h;
+	IMAGE_SCALE_AXIS v;
+
+	/* horizontally filtered source rows, v.taps slots of h.dstSize pixels indexed by row */
+	INT16* rows;
+	UINT32* rowSource;
+	const INT16** taps;
+
+	/* 32bpp copy of a source line for formats the kernels can not read */
+	BYTE* srcLine;
+	/* scaled line for destination formats the kernels can not write */
+	BYTE* dstLine;
+};
+
+static void image_scale_hscale_generic(const BYTE* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                                       const UINT32* WINPR_RESTRICT offsets,
+                                       const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                       UINT32 count)
+{
+	const UINT32 stride = image_scale_weight_stride(taps);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const BYTE* px = &src[4ull * offsets[x]];
+		const INT16* w = &weights[x * stride];
+		INT32 sum[4] = WINPR_C_ARRAY_INIT;
+
+		for (size_t t = 0; t < taps; t++)
+		{
+			for (size_t c = 0; c < 4; c++)
+				sum[c] += px[4 * t + c] * w[t];
+		}
+
+		for (size_t c = 0; c < 4; c++)
+			dst[4 * x + c] = image_scale_row_value(sum[c]);
+	}
+}
+
+static void image_scale_vscale_generic(const INT16* const* WINPR_RESTRICT rows,
+                                       const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                       BYTE* WINPR_RESTRICT dst, UINT32 count)
+{
+	/* accumulate a block of values tap by tap so the inner loop vectorizes */
+	for (size_t x = 0; x < count; x += IMAGE_SCALE_BLOCK)
+	{
+		const size_t block = MIN(IMAGE_SCALE_BLOCK, count - x);
+		INT32 sum[IMAGE_SCALE_BLOCK] = WINPR_C_ARRAY_INIT;
+
+		for (size_t t = 0; t < taps; t++)
+		{
+			const INT16* WINPR_RESTRICT row = &rows[t][x];
+			const INT32 w = weights[t];
+
+			for (size_t i = 0; i < block; i++)
+				sum[i] += row[i] * w;
+		}
+
+		for (size_t i = 0; i < block; i++)
+			dst[x + i] = image_scale_pixel_value(sum[i]);
+	}
+}
+
+static const FREERDP_IMAGE_SCALE_KERNELS image_scale_kernels_generic = {
+	image_scale_hscale_generic, image_scale_vscale_generic
+};
+
+static INIT_ONCE image_scale_kernels_InitOnce = INIT_ONCE_STATIC_INIT;
+static FREERDP_IMAGE_SCALE_KERNELS image_scale_kernels_optimized = WINPR_C_ARRAY_INIT;
+
+static BOOL CALLBACK image_scale_init_kernels_cb(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                                 WINPR_ATTR_UNUSED PVOID param,
+                                                 WINPR_ATTR_UNUSED PVOID* context)
+{
+	image_scale_kernels_optimized = image_scale_kernels_generic;
+	freerdp_image_scale_init_sse2(&image_scale_kernels_optimized);
+#if defined(WITH_AVX2)
+	freerdp_image_scale_init_avx2(&image_scale_kernels_optimized);
+#endif
+	freerdp_image_scale_init_neon(&image_scale_kernels_optimized);
+	return TRUE;
+}
+
+const FREERDP_IMAGE_SCALE_KERNELS* freerdp_image_scale_get_kernels_generic(void)
+{
+	return &image_scale_kernels_generic;
+}
+
+const FREERDP_IMAGE_SCALE_KERNELS* freerdp_image_scale_get_kernels(void)
+{
+	if (!InitOnceExecuteOnce(&image_scale_kernels_InitOnce, image_scale_init_kernels_cb, nullptr,
+	                         nullptr))
+		return &image_scale_kernels_generic;
+	return &image_scale_kernels_optimized;
+}
+
+static double image_scale_support(FREERDP_IMAGE_SCALE_FILTER filter)
+{
+	switch (filter)
+	{
+		case FREERDP_IMAGE_SCALE_BICUBIC:
+			return 2.0;
+		case FREERDP_IMAGE_SCALE_BILINEAR:
+		default:
+			return 1.0;
+	}
+}
+
+static double image_scale_kernel(FREERDP_IMAGE_SCALE_FILTER filter, double x)
+{
+	x = fabs(x);
+
+	switch (filter)
+	{
+		case FREERDP_IMAGE_SCALE_BICUBIC:
+			/* Keys cubic convolution with a = -0.5 (Catmull-Rom) */
+			if (x < 1.0)
+				return (1.5 * x - 2.5) * x * x + 1.0;
+			if (x < 2.0)
+				return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+			return 0.0;
+		case FREERDP_IMAGE_SCALE_BILINEAR:
+		default:
+			return (x < 1.0) ? 1.0 - x : 0.0;
+	}
+}
+
+static void image_scale_axis_free(IMAGE_SCALE_AXIS* axis)
+{
+	WINPR_ASSERT(axis);
+
+	free(axis->offsets);
+	free(axis->weights);
+	memset(axis, 0, sizeof(IMAGE_SCALE_AXIS));
+}
+
+/**
+ * Build the filter of one axis. Each destination pixel gets a window of \b taps consecutive
+ * source pixels, taps outside of the source are folded onto the edge pixels so the window
+ * never leaves it. The quantized weights of a pixel always add up to 1.0.
+ */
+static BOOL image_scale_axis_init(IMAGE_SCALE_AXIS* axis, FREERDP_IMAGE_SCALE_FILTER filter,
+                                  UINT32 srcSize, UINT32 dstSize)
+{
+	WINPR_ASSERT(axis);
+	WINPR_ASSERT(srcSize > 0);
+	WINPR_ASSERT(dstSize > 0);
+
+	BOOL rc = FALSE;
+	const double scale = (double)srcSize / (double)dstSize;
+	const double stretch = MAX(1.0, scale);
+	const double support = image_scale_support(filter) * stretch;
+	const UINT32 span = (UINT32)ceil(2.0 * support);
+	const UINT32 taps = MIN(span, srcSize);
+	const UINT32 stride = image_scale_weight_stride(taps);
+	double* w = calloc(taps, sizeof(double));
+
+	image_scale_axis_free(axis);
+	axis->offsets = calloc(dstSize, sizeof(UINT32));
+	axis->weights = calloc(1ull * dstSize * stride, sizeof(INT16));
+	if (!w || !axis->offsets || !axis->weights)
+		goto fail;
+
+	for (UINT32 x = 0; x < dstSize; x++)
+	{
+		const double center = ((double)x + 0.5) * scale - 0.5;
+		const INT64 first = (INT64)floor(center - support) + 1;
+		const INT64 start = MAX(0, MIN(first, (INT64)srcSize - taps));
+		INT16* weights = &axis->weights[1ull * x * stride];
+		double sum = 0.0;
+
+		memset(w, 0, taps * sizeof(double));
+		for (UINT32 t = 0; t < span; t++)
+		{
+			const INT64 pos = first + t;
+			const INT64 clamped = MAX(0, MIN(pos, (INT64)srcSize - 1));
+			const double k = image_scale_kernel(filter, ((double)pos - center) / stretch);
+			w[clamped - start] += k;
+			sum += k;
+		}
+
+		INT32 total = 0;
+		size_t largest = 0;
+		for (size_t t = 0; t < taps; t++)
+		{
+			const long q = lround(w[t] / sum * (1 << IMAGE_SCALE_WEIGHT_BITS));
+			weights[t] = (INT16)q;
+			total += weights[t];
+			if (fabs(w[t]) > fabs(w[largest]))
+				largest = t;
+		}
+
+		/* put the rounding error on the largest tap so flat areas stay exact */
+		weights[largest] = (INT16)(weights[largest] + (1 << IMAGE_SCALE_WEIGHT_BITS) - total);
+		axis->offsets[x] = (UINT32)start;
+	}
+
+	axis->srcSize = srcSize;
+	axis->dstSize = dstSize;
+	axis->taps = taps;
+	rc = TRUE;
+
+fail:
+	if (!rc)
+		image_scale_axis_free(axis);
+	free(w);
+	return rc;
+}
+
+/* Destination pixels [*first, *last) whose filter windows overlap source pixels [lo, hi) */
+static void image_scale_axis_map(const IMAGE_SCALE_AXIS* axis, UINT32 lo, UINT32 hi,
+                                 UINT32* first, UINT32* last)
+{
+	WINPR_ASSERT(axis);
+	WINPR_ASSERT(first);
+	WINPR_ASSERT(last);
+
+	/* the window offsets grow monotonically with the destination position */
+	UINT32 a = 0;
+	UINT32 b = axis->dstSize;
+	while (a < b)
+	{
+		const UINT32 m = a + (b - a) / 2;
+		if (axis->offsets[m] + axis->taps <= lo)
+			a = m + 1;
+		else
+			b = m;
+	}
+	*first = a;
+
+	b = axis->dstSize;
+	while (a < b)
+	{
+		const UINT32 m = a + (b - a) / 2;
+		if (axis->offsets[m] < hi)
+			a = m + 1;
+		else
+			b = m;
+	}
+	*last = a;
+}
+
+void freerdp_image_scaler_free(FREERDP_IMAGE_SCALER* scaler)
+{
+	if (!scaler)
+		return;
+
+	image_scale_axis_free(&scaler->h);
+	image_scale_axis_free(&scaler->v);
+	winpr_aligned_free(scaler->rows);
+	free(scaler->rowSource);
+	free(scaler->taps);
+	winpr_aligned_free(scaler->srcLine);
+	winpr_aligned_free(scaler->dstLine);
+	free(scaler);
+}
+
+FREERDP_IMAGE_SCALER* freerdp_image_scaler_new(FREERDP_IMAGE_SCALE_FILTER filter)
+{
+	switch (filter)
+	{
+		case FREERDP_IMAGE_SCALE_BILINEAR:
+		case FREERDP_IMAGE_SCALE_BICUBIC:
+			break;
+		default:
+			WLog_ERR(TAG, "unsupported scale filter %d", filter);
+			return nullptr;
+	}
+
+	FREERDP_IMAGE_SCALER* scaler = calloc(1, sizeof(FREERDP_IMAGE_SCALER));
+	if (!scaler)
+		return nullptr;
+
+	scaler->filter = filter;
+	scaler->kernels = freerdp_image_scale_get_kernels();
+	return scaler;
+}
+
+BOOL freerdp_image_scaler_set_size(FREERDP_IMAGE_SCALER* scaler, UINT32 nSrcWidth,
+                                   UINT32 nSrcHeight, UINT32 nDstWidth, UINT32 nDstHeight)
+{
+	WINPR_ASSERT(scaler);
+
+	if ((nSrcWidth == 0) || (nSrcHeight == 0) || (nDstWidth == 0) || (nDstHeight == 0))
+		return FALSE;
+
+	if ((nSrcWidth > INT32_MAX / 4) || (nDstWidth > INT32_MAX / 4))
+		return FALSE;
+
+	if ((scaler->h.srcSize == nSrcWidth) && (scaler->h.dstSize == nDstWidth) &&
+	    (scaler->v.srcSize == nSrcHeight) && (scaler->v.dstSize == nDstHeight))
+		return TRUE;
+
+	winpr_aligned_free(scaler->rows);
+	winpr_aligned_free(scaler->srcLine);
+	winpr_aligned_free(scaler->dstLine);
+	free(scaler->rowSource);
+	free(scaler->taps);
+	scaler->rows = nullptr;
+	scaler->srcLine = nullptr;
+	scaler->dstLine = nullptr;
+	scaler->rowSource = nullptr;
+	scaler->taps = nullptr;
+
+	if (!image_scale_axis_init(&scaler->h, scaler->filter, nSrcWidth, nDstWidth) ||
+	    !image_scale_axis_init(&scaler->v, scaler->filter, nSrcHeight, nDstHeight))
+		goto fail;
+
+	scaler->rows =
+	    winpr_aligned_malloc(4ull * nDstWidth * scaler->v.taps * sizeof(INT16), 32);
+	scaler->rowSource = calloc(scaler->v.taps, sizeof(UINT32));
+	scaler->taps = calloc(scaler->v.taps, sizeof(INT16*));
+	scaler->srcLine = winpr_aligned_malloc(4ull * nSrcWidth, 32);
+	scaler->dstLine = winpr_aligned_malloc(4ull * nDstWidth, 32);
+	if (!scaler->rows || !scaler->rowSource || !scaler->taps || !scaler->srcLine ||
+	    !scaler->dstLine)
+		goto fail;
+
+	return TRUE;
+
+fail:
+	image_scale_axis_free(&scaler->h);
+	image_scale_axis_free(&scaler->v);
+	return FALSE;
+}
+
+BOOL freerdp_image_scaler_map_rect(const FREERDP_IMAGE_SCALER* scaler, const RECTANGLE_16* src,
+                                   RECTANGLE_16* dst)
+{
+	WINPR_ASSERT(scaler);
+	WINPR_ASSERT(src);
+	WINPR_ASSERT(dst);
+
+	if (!scaler->h.offsets || !scaler->v.offsets)
+		return FALSE;
+
+	if ((scaler->h.dstSize > UINT16_MAX) || (scaler->v.dstSize > UINT16_MAX))
+		return FALSE;
+
+	const RECTANGLE_16 empty = WINPR_C_ARRAY_INIT;
+	const UINT32 right = MIN(src->right, scaler->h.srcSize);
+	const UINT32 bottom = MIN(src->bottom, scaler->v.srcSize);
+	if ((src->left >= right) || (src->top >= bottom))
+	{
+		*dst = empty;
+		return TRUE;
+	}
+
+	UINT32 left = 0;
+	UINT32 top = 0;
+	UINT32 dstRight = 0;
+	UINT32 dstBottom = 0;
+	image_scale_axis_map(&scaler->h, src->left, right, &left, &dstRight);
+	image_scale_axis_map(&scaler->v, src->top, bottom, &top, &dstBottom);
+
+	dst->left = (UINT16)left;
+	dst->top = (UINT16)top;
+	dst->right = (UINT16)dstRight;
+	dst->bottom = (UINT16)dstBottom;
+	return TRUE;
+}
+
+/* @return TRUE if the 32bpp kernel output can be stored as DstFormat without conversion */
+static BOOL image_scale_is_direct(UINT32 WorkFormat, UINT32 DstFormat)
+{
+	if (WorkFormat == DstFormat)
+		return TRUE;
+
+	/* the filtered padding byte is fine for a format that ignores it */
+	return !FreeRDPColorHasAlpha(DstFormat) &&
+	       FreeRDPAreColorFormatsEqualNoAlpha(WorkFormat, DstFormat);
+}
+
+static BOOL image_scale_filter_row(FREERDP_IMAGE_SCALER* WINPR_RESTRICT scaler, INT16* row,
+                                   const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat,
+                                   UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc, UINT32 x0,
+                                   UINT32 x1)
+{
+	const IMAGE_SCALE_AXIS* h = &scaler->h;
+	const BYTE* line = nullptr;
+
+	if (FreeRDPGetBytesPerPixel(SrcFormat) == 4)
+		line = &pSrcData[1ull * nYSrc * nSrcStep + 4ull * nXSrc];
+	else
+	{
+		/* only the source columns the filter windows of [x0, x1) read */
+		const UINT32 first = h->offsets[x0];
+		const UINT32 last = h->offsets[x1 - 1] + h->taps;
+		if (!freerdp_image_copy_no_overlap(scaler->srcLine, PIXEL_FORMAT_BGRA32, 0, first, 0,
+		                                   last - first, 1, pSrcData, SrcFormat, nSrcStep,
+		                                   nXSrc + first, nYSrc, nullptr, FREERDP_FLIP_NONE))
+			return FALSE;
+		line = scaler->srcLine;
+	}
+
+	scaler->kernels->hscale(line, &row[4ull * x0], &h->offsets[x0],
+	                        &h->weights[1ull * x0 * image_scale_weight_stride(h->taps)], h->taps,
+	                        x1 - x0);
+	return TRUE;
+}
+
+BOOL freerdp_image_scaler_scale(FREERDP_IMAGE_SCALER* scaler, BYTE* WINPR_RESTRICT pDstData,
+                                DWORD DstFormat, UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
+                                const BYTE* WINPR_RESTRICT pSrcData, DWORD SrcFormat,
+                                UINT32 nSrcStep, UINT32 nXSrc, UINT32 nYSrc,
+                                const RECTANGLE_16* rect)
+{
+	WINPR_ASSERT(scaler);
+	WINPR_ASSERT(pDstData);
+	WINPR_ASSERT(pSrcData);
+
+	const IMAGE_SCALE_AXIS* h = &scaler->h;
+	const IMAGE_SCALE_AXIS* v = &scaler->v;
+
+	if (!h->offsets || !v->offsets)
+	{
+		WLog_ERR(TAG, "freerdp_image_scaler_set_size was not called");
+		return FALSE;
+	}
+
+	if (nDstStep == 0)
+		nDstStep = h->dstSize * FreeRDPGetBytesPerPixel(DstFormat);
+
+	if (nSrcStep == 0)
+		nSrcStep = h->srcSize * FreeRDPGetBytesPerPixel(SrcFormat);
+
+	UINT32 x0 = 0;
+	UINT32 y0 = 0;
+	UINT32 x1 = h->dstSize;
+	UINT32 y1 = v->dstSize;
+	if (rect)
+	{
+		x0 = rect->left;
+		y0 = rect->top;
+		x1 = MIN(x1, rect->right);
+		y1 = MIN(y1, rect->bottom);
+	}
+
+	if ((x0 >= x1) || (y0 >= y1))
+		return TRUE;
+
+	const UINT32 WorkFormat =
+	    (FreeRDPGetBytesPerPixel(SrcFormat) == 4) ? SrcFormat : PIXEL_FORMAT_BGRA32;
+	const BOOL direct = image_scale_is_direct(WorkFormat, DstFormat);
+	const UINT32 dstBpp = FreeRDPGetBytesPerPixel(DstFormat);
+	const size_t rowStride = 4ull * h->dstSize;
+	const UINT32 vstride = image_scale_weight_stride(v->taps);
+
+	for (size_t x = 0; x < v->taps; x++)
+		scaler->rowSource[x] = IMAGE_SCALE_NO_ROW;
+
+	for (UINT32 y = y0; y < y1; y++)
+	{
+		const UINT32 start = v->offsets[y];
+
+		/* the windows only move down, each source row is filtered once per call */
+		for (UINT32 t = 0; t < v->taps; t++)
+		{
+			const UINT32 src = start + t;
+			const UINT32 slot = src % v->taps;
+			INT16* row = &scaler->rows[slot * rowStride];
+
+			if (scaler->rowSource[slot] != src)
+			{
+				if (!image_scale_filter_row(scaler, row, pSrcData, SrcFormat, nSrcStep, nXSrc,
+				                            nYSrc + src, x0, x1))
+					return FALSE;
+				scaler->rowSource[slot] = src;
+			}
+			scaler->taps[t] = &row[4ull * x0];
+		}
+
+		BYTE* dst = &pDstData[1ull * (nYDst + y) * nDstStep + 1ull * (nXDst + x0) * dstBpp];
+		BYTE* out = direct ? dst : &scaler->dstLine[4ull * x0];
+		scaler->kernels->vscale(scaler->taps, &v->weights[1ull * y * vstride], v->taps, out,
+		                        4 * (x1 - x0));
+
+		if (!direct)
+		{
+			if (!freerdp_image_copy_no_overlap(dst, DstFormat, nDstStep, 0, 0, x1 - x0, 1, out,
+			                                   WorkFormat, 0, 0, 0, nullptr, FREERDP_FLIP_NONE))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,87 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_IMAGE_SCALE_H
+#define FREERDP_LIB_CODEC_IMAGE_SCALE_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+/* filter weights are fixed point with this many fractional bits */
+#define IMAGE_SCALE_WEIGHT_BITS 14
+
+/* horizontally filtered rows keep this many fractional bits per channel */
+#define IMAGE_SCALE_ROW_BITS 6
+
+#define IMAGE_SCALE_H_SHIFT (IMAGE_SCALE_WEIGHT_BITS - IMAGE_SCALE_ROW_BITS)
+#define IMAGE_SCALE_V_SHIFT (IMAGE_SCALE_WEIGHT_BITS + IMAGE_SCALE_ROW_BITS)
+
+typedef struct
+{
+	/** Filter \b count destination pixels of a 32bpp row horizontally.
+	 *
+	 *  Destination pixel \b x uses the \b taps source pixels starting at \b offsets[x] and the
+	 *  weights at \b weights[x * image_scale_weight_stride(taps)]. The four channels are
+	 *  written to \b dst as 16 bit values with IMAGE_SCALE_ROW_BITS fractional bits.
+	 */
+	void (*hscale)(const BYTE* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+	               const UINT32* WINPR_RESTRICT offsets, const INT16* WINPR_RESTRICT weights,
+	               UINT32 taps, UINT32 count);
+
+	/** Filter \b count channel values of the \b taps horizontally filtered \b rows vertically
+	 *  and store them saturated to bytes. */
+	void (*vscale)(const INT16* const* WINPR_RESTRICT rows, const INT16* WINPR_RESTRICT weights,
+	               UINT32 taps, BYTE* WINPR_RESTRICT dst, UINT32 count);
+} FREERDP_IMAGE_SCALE_KERNELS;
+
+/** The weights of each destination pixel are padded to an even count with zero weights, so
+ *  vector kernels can always load them in pairs. */
+static inline UINT32 image_scale_weight_stride(UINT32 taps)
+{
+	return (taps + 1) & ~1u;
+}
+
+static inline INT16 image_scale_row_value(INT32 sum)
+{
+	const INT32 value = (sum + (1 << (IMAGE_SCALE_H_SHIFT - 1))) >> IMAGE_SCALE_H_SHIFT;
+	if (value < INT16_MIN)
+		return INT16_MIN;
+	if (value > INT16_MAX)
+		return INT16_MAX;
+	return (INT16)value;
+}
+
+static inline BYTE image_scale_pixel_value(INT32 sum)
+{
+	const INT32 value = (sum + (1 << (IMAGE_SCALE_V_SHIFT - 1))) >> IMAGE_SCALE_V_SHIFT;
+	if (value < 0)
+		return 0;
+	if (value > 0xFF)
+		return 0xFF;
+	return (BYTE)value;
+}
+
+/** @return The portable kernels */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL const FREERDP_IMAGE_SCALE_KERNELS* freerdp_image_scale_get_kernels_generic(void);
+
+/** @return The fastest kernels for the running CPU */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL const FREERDP_IMAGE_SCALE_KERNELS* freerdp_image_scale_get_kernels(void);
+
+#endif /* FREERDP_LIB_CODEC_IMAGE_SCALE_H */
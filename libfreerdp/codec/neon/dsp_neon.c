@@ -0,0 +1,105 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/endian.h>
+
+#include <freerdp/log.h>
+
+#include "dsp_neon.h"
+
+#include "../../core/simd.h"
+
+#define TAG FREERDP_TAG("codec.dsp.neon")
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static float freerdp_dsp_dot_neon(const float* WINPR_RESTRICT x, const float* WINPR_RESTRICT h,
+                                  size_t count)
+{
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		acc0 = vmlaq_f32(acc0, vld1q_f32(&x[i]), vld1q_f32(&h[i]));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(&x[i + 4]), vld1q_f32(&h[i + 4]));
+	}
+
+	const float32x4_t acc = vaddq_f32(acc0, acc1);
+	const float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+	return vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+
+static void freerdp_dsp_upmix_neon(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                   size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		int16x8x2_t v;
+		v.val[0] = vld1q_s16((const int16_t*)&src[2 * x]);
+		v.val[1] = v.val[0];
+		vst2q_s16((int16_t*)&dst[4 * x], v);
+	}
+
+	for (; x < frames; x++)
+	{
+		memcpy(&dst[4 * x], &src[2 * x], 2);
+		memcpy(&dst[4 * x + 2], &src[2 * x], 2);
+	}
+}
+
+static void freerdp_dsp_downmix_neon(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                     size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		const int16x8x2_t v = vld2q_s16((const int16_t*)&src[4 * x]);
+		vst1q_s16((int16_t*)&dst[2 * x], vhaddq_s16(v.val[0], v.val[1]));
+	}
+
+	for (; x < frames; x++)
+	{
+		const INT32 l = winpr_Data_Get_INT16(&src[4 * x]);
+		const INT32 r = winpr_Data_Get_INT16(&src[4 * x + 2]);
+		winpr_Data_Write_INT16(&dst[2 * x], (INT16)((l + r) >> 1));
+	}
+}
+#endif
+
+void freerdp_dsp_init_neon_int(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(NEON_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "NEON optimizations");
+	kernels->dot = freerdp_dsp_dot_neon;
+	kernels->upmix = freerdp_dsp_upmix_neon;
+	kernels->downmix = freerdp_dsp_downmix_neon;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or NEON intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
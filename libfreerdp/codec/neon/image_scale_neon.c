@@ -0,0 +1,108 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "image_scale_neon.h"
+
+#include "../../core/simd.h"
+
+#define TAG FREERDP_TAG("codec.scale.neon")
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static void image_scale_hscale_neon(const BYTE* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                                    const UINT32* WINPR_RESTRICT offsets,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    UINT32 count)
+{
+	const UINT32 stride = image_scale_weight_stride(taps);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const BYTE* px = &src[4ull * offsets[x]];
+		const INT16* w = &weights[x * stride];
+		int32x4_t acc = vdupq_n_s32(1 << (IMAGE_SCALE_H_SHIFT - 1));
+
+		for (size_t t = 0; t < taps; t++)
+		{
+			UINT32 pixel = 0;
+			memcpy(&pixel, &px[4 * t], sizeof(pixel));
+			const int16x4_t p = vget_low_s16(
+			    vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel)))));
+			acc = vmlal_n_s16(acc, p, w[t]);
+		}
+
+		vst1_s16(&dst[4 * x], vqmovn_s32(vshrq_n_s32(acc, IMAGE_SCALE_H_SHIFT)));
+	}
+}
+
+static void image_scale_vscale_neon(const INT16* const* WINPR_RESTRICT rows,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    BYTE* WINPR_RESTRICT dst, UINT32 count)
+{
+	const int32x4_t round = vdupq_n_s32(1 << (IMAGE_SCALE_V_SHIFT - 1));
+	size_t x = 0;
+
+	for (; x + 8 <= count; x += 8)
+	{
+		int32x4_t lo = round;
+		int32x4_t hi = round;
+
+		for (size_t t = 0; t < taps; t++)
+		{
+			const int16x8_t r = vld1q_s16(&rows[t][x]);
+			lo = vmlal_n_s16(lo, vget_low_s16(r), weights[t]);
+			hi = vmlal_n_s16(hi, vget_high_s16(r), weights[t]);
+		}
+
+		const int16x8_t v = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, IMAGE_SCALE_V_SHIFT)),
+		                                 vqmovn_s32(vshrq_n_s32(hi, IMAGE_SCALE_V_SHIFT)));
+		vst1_u8(&dst[x], vqmovun_s16(v));
+	}
+
+	for (; x < count; x++)
+	{
+		INT32 sum = 0;
+
+		for (size_t t = 0; t < taps; t++)
+			sum += rows[t][x] * weights[t];
+
+		dst[x] = image_scale_pixel_value(sum);
+	}
+}
+#endif
+
+void freerdp_image_scale_init_neon_int(FREERDP_IMAGE_SCALE_KERNELS* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(NEON_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "NEON optimizations");
+	kernels->hscale = image_scale_hscale_neon;
+	kernels->vscale = image_scale_vscale_neon;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or NEON intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,39 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_IMAGE_SCALE_NEON_H
+#define FREERDP_LIB_CODEC_IMAGE_SCALE_NEON_H
+
+#include <winpr/sysinfo.h>
+
+#include <freerdp/config.h>
+#include <freerdp/api.h>
+
+#include "../image_scale.h"
+
+FREERDP_LOCAL void
+freerdp_image_scale_init_neon_int(FREERDP_IMAGE_SCALE_KERNELS* WINPR_RESTRICT kernels);
+static inline void
+freerdp_image_scale_init_neon(FREERDP_IMAGE_SCALE_KERNELS* WINPR_RESTRICT kernels)
+{
+	if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	freerdp_image_scale_init_neon_int(kernels);
+}
+
+#endif /* FREERDP_LIB_CODEC_IMAGE_SCALE_NEON_H */
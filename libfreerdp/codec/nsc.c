@@ -32,11 +32,13 @@
 
 #include <freerdp/codec/nsc.h>
 #include <freerdp/codec/color.h>
+#include <freerdp/settings.h>
 
 #include "nsc_types.h"
 #include "nsc_encode.h"
 
 #include "sse/nsc_sse2.h"
+#include "sse/nsc_avx2.h"
 #include "neon/nsc_neon.h"
 
 #include <freerdp/log.h>
@@ -339,6 +341,11 @@ BOOL nsc_context_reset(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 width, UINT32
 }
 
 NSC_CONTEXT* nsc_context_new(void)
+{
+	return nsc_context_new_ex(0);
+}
+
+NSC_CONTEXT* nsc_context_new_ex(UINT32 ThreadingFlags)
 {
 	NSC_CONTEXT* context = (NSC_CONTEXT*)winpr_aligned_calloc(1, sizeof(NSC_CONTEXT), 32);
 
@@ -351,6 +358,7 @@ NSC_CONTEXT* nsc_context_new(void)
 		goto error;
 
 	context->priv->log = WLog_Get("com.freerdp.codec.nsc");
+	context->priv->UseThreads = (ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS) == 0;
 	context->BitmapData = nullptr;
 	context->decode = nsc_decode;
 	context->encode = nsc_encode;
@@ -364,6 +372,9 @@ NSC_CONTEXT* nsc_context_new(void)
 	context->ChromaSubsamplingLevel = 1;
 	/* init optimized methods */
 	nsc_init_sse2(context);
+#if defined(WITH_AVX2)
+	nsc_init_avx2(context);
+#endif
 	nsc_init_neon(context);
 	return context;
 error:
@@ -384,6 +395,11 @@ void nsc_context_free(NSC_CONTEXT* context)
 		for (size_t i = 0; i < 5; i++)
 			winpr_aligned_free(context->priv->PlaneBuffers[i]);
 
+		for (size_t i = 0; i < 3; i++)
+			winpr_aligned_free(context->priv->EncodeBuffers[i]);
+
+		codec_work_group_free(context->priv->WorkGroup);
+
 		nsc_profiler_print(context->priv);
 		PROFILER_FREE(context->priv->prof_nsc_rle_decompress_data)
 		PROFILER_FREE(context->priv->prof_nsc_decode)
@@ -35,6 +35,21 @@
 #include "nsc_types.h"
 #include "nsc_encode.h"
 
+#include "../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED) && \
+    (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define NSC_SSE2_RLE_SCAN
+#endif
+
+/* Bitmap rows converted by one job. Even, so the chroma subsampling of a band only reads rows
+ * converted by the same job. */
+#define NSC_ENCODE_BAND_ROWS 16
+
+/* Planes smaller than this are run length encoded on the calling thread */
+#define NSC_RLE_THREADING_MIN_SIZE 0x10000
+
 typedef struct
 {
 	UINT32 x;
@@ -56,6 +71,21 @@ typedef struct
 	UINT8 ChromaSubsamplingLevel;
 } NSC_MESSAGE;
 
+typedef struct
+{
+	NSC_CONTEXT* context;
+	const BYTE* data;
+	UINT32 scanline;
+} NSC_ENCODE_BAND_WORK_PARAM;
+
+typedef struct
+{
+	NSC_CONTEXT* context;
+	NSC_MESSAGE* message;
+	BYTE* planes[4];
+	BYTE* rle[4];
+} NSC_RLE_WORK_PARAM;
+
 static BOOL nsc_write_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s,
                               const NSC_MESSAGE* WINPR_RESTRICT message);
 
@@ -85,6 +115,29 @@ static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context)
 		context->priv->PlaneBuffersLength = length;
 	}
 
+	if (length > context->priv->EncodeBuffersLength)
+	{
+		for (size_t i = 0; i < 3; i++)
+		{
+			BYTE* tmp = (BYTE*)winpr_aligned_recalloc(context->priv->EncodeBuffers[i], length,
+			                                          sizeof(BYTE), 32);
+
+			if (!tmp)
+				return FALSE;
+
+			context->priv->EncodeBuffers[i] = tmp;
+		}
+
+		context->priv->EncodeBuffersLength = length;
+	}
+
+	if (!context->priv->WorkGroup)
+	{
+		context->priv->WorkGroup = codec_work_group_new(context->priv->UseThreads, 0);
+		if (!context->priv->WorkGroup)
+			return FALSE;
+	}
+
 	if (context->ChromaSubsamplingLevel)
 	{
 		context->OrgByteCount[0] = tempWidth * context->height;
@@ -112,184 +165,178 @@ fail:
 	return FALSE;
 }
 
-static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
-                                      const BYTE* WINPR_RESTRICT data, UINT32 scanline)
+void nsc_encode_argb_to_aycocg_pixels(NSC_CONTEXT* WINPR_RESTRICT context,
+                                      const BYTE* WINPR_RESTRICT src, UINT32 y, UINT32 x)
 {
-	size_t y = 0;
-	const BYTE* src = nullptr;
-	BYTE* yplane = nullptr;
-	BYTE* coplane = nullptr;
-	BYTE* cgplane = nullptr;
-	BYTE* aplane = nullptr;
 	INT16 r_val = 0;
 	INT16 g_val = 0;
 	INT16 b_val = 0;
 	BYTE a_val = 0;
 
-	UINT16 tempWidth = ROUND_UP_TO(context->width, 8);
-	const UINT16 rw = (context->ChromaSubsamplingLevel ? tempWidth : context->width);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(src);
+
+	const UINT32 tempWidth = ROUND_UP_TO(context->width, 8);
+	const size_t rw = (context->ChromaSubsamplingLevel ? tempWidth : context->width);
 	const BYTE ccl = WINPR_ASSERTING_INT_CAST(BYTE, context->ColorLossLevel);
 
-	for (; y < context->height; y++)
+	BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw + x;
+	BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw + x;
+	BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw + x;
+	BYTE* aplane = context->priv->PlaneBuffers[3] + 1ull * y * context->width + x;
+
+	for (; x < context->width; x++)
 	{
-		src = data + (context->height - 1 - y) * scanline;
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		aplane = context->priv->PlaneBuffers[3] + y * context->width;
-
-		UINT16 x = 0;
-		for (; x < context->width; x++)
+		switch (context->format)
 		{
-			switch (context->format)
+			case PIXEL_FORMAT_BGRX32:
+				b_val = *src++;
+				g_val = *src++;
+				r_val = *src++;
+				src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_BGRA32:
+				b_val = *src++;
+				g_val = *src++;
+				r_val = *src++;
+				a_val = *src++;
+				break;
+
+			case PIXEL_FORMAT_RGBX32:
+				r_val = *src++;
+				g_val = *src++;
+				b_val = *src++;
+				src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_RGBA32:
+				r_val = *src++;
+				g_val = *src++;
+				b_val = *src++;
+				a_val = *src++;
+				break;
+
+			case PIXEL_FORMAT_BGR24:
+				b_val = *src++;
+				g_val = *src++;
+				r_val = *src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_RGB24:
+				r_val = *src++;
+				g_val = *src++;
+				b_val = *src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_BGR16:
+				b_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
+				g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
+				r_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
+				a_val = 0xFF;
+				src += 2;
+				break;
+
+			case PIXEL_FORMAT_RGB16:
+				r_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
+				g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
+				b_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
+				a_val = 0xFF;
+				src += 2;
+				break;
+
+			case PIXEL_FORMAT_A4:
 			{
-				case PIXEL_FORMAT_BGRX32:
-					b_val = *src++;
-					g_val = *src++;
-					r_val = *src++;
-					src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_BGRA32:
-					b_val = *src++;
-					g_val = *src++;
-					r_val = *src++;
-					a_val = *src++;
-					break;
-
-				case PIXEL_FORMAT_RGBX32:
-					r_val = *src++;
-					g_val = *src++;
-					b_val = *src++;
-					src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_RGBA32:
-					r_val = *src++;
-					g_val = *src++;
-					b_val = *src++;
-					a_val = *src++;
-					break;
-
-				case PIXEL_FORMAT_BGR24:
-					b_val = *src++;
-					g_val = *src++;
-					r_val = *src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_RGB24:
-					r_val = *src++;
-					g_val = *src++;
-					b_val = *src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_BGR16:
-					b_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
-					g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
-					r_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
-					a_val = 0xFF;
-					src += 2;
-					break;
-
-				case PIXEL_FORMAT_RGB16:
-					r_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
-					g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
-					b_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
-					a_val = 0xFF;
-					src += 2;
-					break;
-
-				case PIXEL_FORMAT_A4:
-				{
-					int shift = 0;
-					BYTE idx = 0;
-					shift = (7 - (x % 8));
-					idx = ((*src) >> shift) & 1;
-					idx |= (((*(src + 1)) >> shift) & 1) << 1;
-					idx |= (((*(src + 2)) >> shift) & 1) << 2;
-					idx |= (((*(src + 3)) >> shift) & 1) << 3;
-					idx *= 3;
-					r_val = (INT16)context->palette[idx];
-					g_val = (INT16)context->palette[idx + 1];
-					b_val = (INT16)context->palette[idx + 2];
-
-					if (shift == 0)
-						src += 4;
-				}
-
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_RGB8:
-				{
-					int idx = (*src) * 3;
-					r_val = (INT16)context->palette[idx];
-					g_val = (INT16)context->palette[idx + 1];
-					b_val = (INT16)context->palette[idx + 2];
-					src++;
-				}
-
-					a_val = 0xFF;
-					break;
-
-				default:
-					r_val = g_val = b_val = a_val = 0;
-					break;
+				int shift = 0;
+				BYTE idx = 0;
+				shift = (7 - (x % 8));
+				idx = ((*src) >> shift) & 1;
+				idx |= (((*(src + 1)) >> shift) & 1) << 1;
+				idx |= (((*(src + 2)) >> shift) & 1) << 2;
+				idx |= (((*(src + 3)) >> shift) & 1) << 3;
+				idx *= 3;
+				r_val = (INT16)context->palette[idx];
+				g_val = (INT16)context->palette[idx + 1];
+				b_val = (INT16)context->palette[idx + 2];
+
+				if (shift == 0)
+					src += 4;
 			}
 
-			*yplane++ = (BYTE)((r_val >> 2) + (g_val >> 1) + (b_val >> 2));
-			/* Perform color loss reduction here */
-			*coplane++ = (BYTE)((r_val - b_val) >> ccl);
-			*cgplane++ = (BYTE)((-(r_val >> 1) + g_val - (b_val >> 1)) >> ccl);
-			*aplane++ = a_val;
-		}
+				a_val = 0xFF;
+				break;
 
-		if (context->ChromaSubsamplingLevel && (x % 2) == 1)
-		{
-			*yplane = *(yplane - 1);
-			*coplane = *(coplane - 1);
-			*cgplane = *(cgplane - 1);
+			case PIXEL_FORMAT_RGB8:
+			{
+				int idx = (*src) * 3;
+				r_val = (INT16)context->palette[idx];
+				g_val = (INT16)context->palette[idx + 1];
+				b_val = (INT16)context->palette[idx + 2];
+				src++;
+			}
+
+				a_val = 0xFF;
+				break;
+
+			default:
+				r_val = g_val = b_val = a_val = 0;
+				break;
 		}
+
+		*yplane++ = (BYTE)((r_val >> 2) + (g_val >> 1) + (b_val >> 2));
+		/* Perform color loss reduction here */
+		*coplane++ = (BYTE)((r_val - b_val) >> ccl);
+		*cgplane++ = (BYTE)((-(r_val >> 1) + g_val - (b_val >> 1)) >> ccl);
+		*aplane++ = a_val;
 	}
 
-	if (context->ChromaSubsamplingLevel && (y % 2) == 1)
+	if (context->ChromaSubsamplingLevel && (x % 2) == 1)
 	{
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		CopyMemory(yplane, yplane - rw, rw);
-		CopyMemory(coplane, coplane - rw, rw);
-		CopyMemory(cgplane, cgplane - rw, rw);
+		*yplane = *(yplane - 1);
+		*coplane = *(coplane - 1);
+		*cgplane = *(cgplane - 1);
 	}
-
-	return TRUE;
 }
 
-static BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context)
+void nsc_encode_duplicate_last_row(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 lastRow)
 {
-	UINT32 tempWidth = 0;
-	UINT32 tempHeight = 0;
+	WINPR_ASSERT(context);
+
+	if (!context->ChromaSubsamplingLevel || (lastRow != context->height) || ((lastRow % 2) == 0))
+		return;
+
+	const size_t rw = ROUND_UP_TO(context->width, 8);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		BYTE* plane = context->priv->PlaneBuffers[i] + lastRow * rw;
+		CopyMemory(plane, plane - rw, rw);
+	}
+}
 
+static BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 firstRow,
+                                   UINT32 lastRow)
+{
 	if (!context)
 		return FALSE;
 
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	tempHeight = ROUND_UP_TO(context->height, 2);
+	const size_t tempWidth = ROUND_UP_TO(context->width, 8);
+	const size_t tempHeight = ROUND_UP_TO(context->height, 2);
 
 	if (tempHeight == 0)
 		return FALSE;
 
-	if (tempWidth > context->priv->PlaneBuffersLength / tempHeight)
+	if (tempWidth > context->priv->EncodeBuffersLength / tempHeight)
 		return FALSE;
 
-	for (size_t y = 0; y < tempHeight >> 1; y++)
+	for (size_t y = firstRow >> 1; y < (lastRow + 1) >> 1; y++)
 	{
-		BYTE* co_dst = context->priv->PlaneBuffers[1] + y * (tempWidth >> 1);
-		BYTE* cg_dst = context->priv->PlaneBuffers[2] + y * (tempWidth >> 1);
+		BYTE* co_dst = context->priv->EncodeBuffers[0] + y * (tempWidth >> 1);
+		BYTE* cg_dst = context->priv->EncodeBuffers[1] + y * (tempWidth >> 1);
 		const INT8* co_src0 = (INT8*)context->priv->PlaneBuffers[1] + (y << 1) * tempWidth;
 		const INT8* co_src1 = co_src0 + tempWidth;
 		const INT8* cg_src0 = (INT8*)context->priv->PlaneBuffers[2] + (y << 1) * tempWidth;
@@ -314,106 +361,237 @@ static BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context)
 }
 
 BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT bmpdata,
-                UINT32 rowstride)
+                UINT32 rowstride, UINT32 firstRow, UINT32 lastRow)
 {
 	if (!context || !bmpdata || (rowstride == 0))
 		return FALSE;
 
-	if (!nsc_encode_argb_to_aycocg(context, bmpdata, rowstride))
-		return FALSE;
+	for (UINT32 y = firstRow; y < lastRow; y++)
+	{
+		const BYTE* src = bmpdata + 1ull * (context->height - 1 - y) * rowstride;
+		nsc_encode_argb_to_aycocg_pixels(context, src, y, 0);
+	}
+
+	nsc_encode_duplicate_last_row(context, lastRow);
 
 	if (context->ChromaSubsamplingLevel)
 	{
-		if (!nsc_encode_subsampling(context))
+		if (!nsc_encode_subsampling(context, firstRow, lastRow))
 			return FALSE;
 	}
 
 	return TRUE;
 }
 
-static UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT out,
-                             UINT32 originalSize)
+static BOOL nsc_encode_band_work(void* context, size_t index,
+                                 WINPR_ATTR_UNUSED BYTE* WINPR_RESTRICT arena)
+{
+	NSC_ENCODE_BAND_WORK_PARAM* param = context;
+	WINPR_ASSERT(param);
+
+	NSC_CONTEXT* nsc = param->context;
+	WINPR_ASSERT(nsc);
+
+	const UINT32 firstRow = WINPR_ASSERTING_INT_CAST(UINT32, index * NSC_ENCODE_BAND_ROWS);
+	const UINT32 lastRow = MIN(nsc->height, firstRow + NSC_ENCODE_BAND_ROWS);
+	return nsc->encode(nsc, param->data, param->scanline, firstRow, lastRow);
+}
+
+/* Returns the first position >= pos where in[pos] != in[pos + 1], or end */
+static inline UINT32 nsc_rle_run_end(const BYTE* WINPR_RESTRICT in, UINT32 pos, UINT32 end)
+{
+#if defined(NSC_SSE2_RLE_SCAN)
+	for (; pos + 16 <= end; pos += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(const void*)&in[pos]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)(const void*)&in[pos + 1]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+			break;
+	}
+#else
+	for (; pos + 8 <= end; pos += 8)
+	{
+		UINT64 a = 0;
+		UINT64 b = 0;
+		memcpy(&a, &in[pos], sizeof(a));
+		memcpy(&b, &in[pos + 1], sizeof(b));
+		if (a != b)
+			break;
+	}
+#endif
+
+	while ((pos < end) && (in[pos] == in[pos + 1]))
+		pos++;
+
+	return pos;
+}
+
+/* Returns the first position >= pos where in[pos] == in[pos + 1], or end */
+static inline UINT32 nsc_rle_literal_end(const BYTE* WINPR_RESTRICT in, UINT32 pos, UINT32 end)
+{
+#if defined(NSC_SSE2_RLE_SCAN)
+	for (; pos + 16 <= end; pos += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(const void*)&in[pos]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)(const void*)&in[pos + 1]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0)
+			break;
+	}
+#else
+	for (; pos + 8 <= end; pos += 8)
+	{
+		UINT64 a = 0;
+		UINT64 b = 0;
+		memcpy(&a, &in[pos], sizeof(a));
+		memcpy(&b, &in[pos + 1], sizeof(b));
+
+		/* any zero byte in a ^ b */
+		const UINT64 v = a ^ b;
+		if (((v - 0x0101010101010101ull) & ~v & 0x8080808080808080ull) != 0)
+			break;
+	}
+#endif
+
+	while ((pos < end) && (in[pos] != in[pos + 1]))
+		pos++;
+
+	return pos;
+}
+
+UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT out,
+                      UINT32 originalSize)
 {
-	UINT32 left = 0;
-	UINT32 runlength = 1;
 	UINT32 planeSize = 0;
-	left = originalSize;
+
+	/* The last 4 bytes are always stored as they are */
+	if (originalSize <= 4)
+		return 4;
+
+	/* last position handled by the loop, it never continues a run */
+	const UINT32 end = originalSize - 5;
 
 	/**
 	 * We quit the loop if the running compressed size is larger than the original.
 	 * In such cases data will be sent uncompressed.
 	 */
-	while (left > 4 && planeSize < originalSize - 4)
+	const UINT32 limit = originalSize - 4;
+
+	UINT32 pos = 0;
+	while ((pos <= end) && (planeSize < limit))
 	{
-		if (left > 5 && *in == *(in + 1))
-		{
-			runlength++;
-		}
-		else if (runlength == 1)
-		{
-			*out++ = *in;
-			planeSize++;
-		}
-		else if (runlength < 256)
+		UINT32 next = nsc_rle_run_end(in, pos, end);
+
+		if (next == pos)
 		{
-			*out++ = *in;
-			*out++ = *in;
-			WINPR_ASSERT(runlength >= 2);
-			*out++ = WINPR_ASSERTING_INT_CAST(BYTE, runlength - 2);
-			runlength = 1;
-			planeSize += 3;
+			/* copy all literals up to the start of the next run in one go */
+			next = nsc_rle_literal_end(in, pos + 1, end);
+			if (next >= end)
+				next = end + 1;
+
+			const UINT32 count = MIN(next - pos, limit - planeSize);
+			CopyMemory(out, &in[pos], count);
+			out += count;
+			planeSize += count;
+			pos += count;
 		}
 		else
 		{
-			*out++ = *in;
-			*out++ = *in;
-			*out++ = 0xFF;
-			*out++ = (runlength & 0x000000FF);
-			*out++ = (runlength & 0x0000FF00) >> 8;
-			*out++ = (runlength & 0x00FF0000) >> 16;
-			*out++ = (runlength & 0xFF000000) >> 24;
-			runlength = 1;
-			planeSize += 7;
-		}
+			const UINT32 runlength = next - pos + 1;
 
-		in++;
-		left--;
+			*out++ = in[pos];
+			*out++ = in[pos];
+
+			if (runlength < 256)
+			{
+				*out++ = WINPR_ASSERTING_INT_CAST(BYTE, runlength - 2);
+				planeSize += 3;
+			}
+			else
+			{
+				*out++ = 0xFF;
+				*out++ = (runlength & 0x000000FF);
+				*out++ = (runlength & 0x0000FF00) >> 8;
+				*out++ = (runlength & 0x00FF0000) >> 16;
+				*out++ = (runlength & 0xFF000000) >> 24;
+				planeSize += 7;
+			}
+
+			pos = next + 1;
+		}
 	}
 
-	if (planeSize < originalSize - 4)
-		CopyMemory(out, in, 4);
+	if (planeSize < limit)
+		CopyMemory(out, &in[pos], 4);
 
 	planeSize += 4;
 	return planeSize;
 }
 
-static void nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context)
+static BOOL nsc_rle_compress_work(void* context, size_t index,
+                                  WINPR_ATTR_UNUSED BYTE* WINPR_RESTRICT arena)
 {
+	NSC_RLE_WORK_PARAM* param = context;
+	WINPR_ASSERT(param);
+	WINPR_ASSERT(index < 4);
+
+	NSC_CONTEXT* nsc = param->context;
+	const UINT32 originalSize = nsc->OrgByteCount[index];
+	BYTE* plane = param->planes[index];
 	UINT32 planeSize = 0;
-	UINT32 originalSize = 0;
 
-	for (UINT16 i = 0; i < 4; i++)
+	if (originalSize > 0)
 	{
-		originalSize = context->OrgByteCount[i];
+		planeSize = nsc_rle_encode(plane, param->rle[index], originalSize);
 
-		if (originalSize == 0)
-		{
-			planeSize = 0;
-		}
+		/* the plane is sent as it is if it does not compress */
+		if (planeSize < originalSize)
+			plane = param->rle[index];
 		else
-		{
-			planeSize = nsc_rle_encode(context->priv->PlaneBuffers[i],
-			                           context->priv->PlaneBuffers[4], originalSize);
+			planeSize = originalSize;
+	}
 
-			if (planeSize < originalSize)
-				CopyMemory(context->priv->PlaneBuffers[i], context->priv->PlaneBuffers[4],
-				           planeSize);
-			else
-				planeSize = originalSize;
-		}
+	nsc->PlaneByteCount[index] = planeSize;
+	param->message->PlaneBuffers[index] = plane;
+	return TRUE;
+}
+
+static BOOL nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context,
+                                  NSC_MESSAGE* WINPR_RESTRICT message)
+{
+	NSC_CONTEXT_PRIV* priv = context->priv;
+	NSC_RLE_WORK_PARAM param = { .context = context, .message = message };
+
+	/* the subsampled chroma planes are stored in the encode buffers, the plane buffers they
+	 * were converted into take the RLE output then */
+	if (context->ChromaSubsamplingLevel)
+	{
+		BYTE* planes[4] = { priv->PlaneBuffers[0], priv->EncodeBuffers[0],
+			                priv->EncodeBuffers[1], priv->PlaneBuffers[3] };
+		BYTE* rle[4] = { priv->PlaneBuffers[4], priv->PlaneBuffers[1], priv->PlaneBuffers[2],
+			             priv->EncodeBuffers[2] };
+		memcpy(param.planes, planes, sizeof(planes));
+		memcpy(param.rle, rle, sizeof(rle));
+	}
+	else
+	{
+		BYTE* planes[4] = { priv->PlaneBuffers[0], priv->PlaneBuffers[1], priv->PlaneBuffers[2],
+			                priv->PlaneBuffers[3] };
+		BYTE* rle[4] = { priv->PlaneBuffers[4], priv->EncodeBuffers[0], priv->EncodeBuffers[1],
+			             priv->EncodeBuffers[2] };
+		memcpy(param.planes, planes, sizeof(planes));
+		memcpy(param.rle, rle, sizeof(rle));
+	}
 
-		context->PlaneByteCount[i] = planeSize;
+	if (context->OrgByteCount[0] >= NSC_RLE_THREADING_MIN_SIZE)
+		return codec_work_group_run(priv->WorkGroup, 4, nsc_rle_compress_work, &param);
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		if (!nsc_rle_compress_work(&param, i, nullptr))
+			return FALSE;
 	}
+
+	return TRUE;
 }
 
 BOOL nsc_write_message(WINPR_ATTR_UNUSED NSC_CONTEXT* WINPR_RESTRICT context,
@@ -472,21 +650,23 @@ BOOL nsc_compose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
 	if (!nsc_context_initialize_encode(context))
 		return FALSE;
 
-	/* ARGB to AYCoCg conversion, chroma subsampling and colorloss reduction */
+	/* ARGB to AYCoCg conversion, chroma subsampling and colorloss reduction in bands of rows */
+	NSC_ENCODE_BAND_WORK_PARAM param = { .context = context, .data = data, .scanline = scanline };
+	const size_t bands = (context->height + NSC_ENCODE_BAND_ROWS - 1) / NSC_ENCODE_BAND_ROWS;
+
 	PROFILER_ENTER(context->priv->prof_nsc_encode)
-	rc = context->encode(context, data, scanline);
+	rc = codec_work_group_run(context->priv->WorkGroup, bands, nsc_encode_band_work, &param);
 	PROFILER_EXIT(context->priv->prof_nsc_encode)
 	if (!rc)
 		return FALSE;
 
-	/* RLE encode */
+	/* RLE encode, the planes are independent */
 	PROFILER_ENTER(context->priv->prof_nsc_rle_compress_data)
-	nsc_rle_compress_data(context);
+	rc = nsc_rle_compress_data(context, &message);
 	PROFILER_EXIT(context->priv->prof_nsc_rle_compress_data)
-	message.PlaneBuffers[0] = context->priv->PlaneBuffers[0];
-	message.PlaneBuffers[1] = context->priv->PlaneBuffers[1];
-	message.PlaneBuffers[2] = context->priv->PlaneBuffers[2];
-	message.PlaneBuffers[3] = context->priv->PlaneBuffers[3];
+	if (!rc)
+		return FALSE;
+
 	message.LumaPlaneByteCount = context->PlaneByteCount[0];
 	message.OrangeChromaPlaneByteCount = context->PlaneByteCount[1];
 	message.GreenChromaPlaneByteCount = context->PlaneByteCount[2];
@@ -28,6 +28,21 @@
 
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context,
-                              const BYTE* WINPR_RESTRICT bmpdata, UINT32 rowstride);
+                              const BYTE* WINPR_RESTRICT bmpdata, UINT32 rowstride,
+                              UINT32 firstRow, UINT32 lastRow);
+
+/* Convert the pixels x to width - 1 of row y, src points to pixel x of the bitmap line.
+ * Used by the SIMD versions for the pixels that do not fill a whole vector. */
+FREERDP_LOCAL void nsc_encode_argb_to_aycocg_pixels(NSC_CONTEXT* WINPR_RESTRICT context,
+                                                    const BYTE* WINPR_RESTRICT src, UINT32 y,
+                                                    UINT32 x);
+
+/* Fill the padding row of a subsampled bitmap with an odd height once its last row is done */
+FREERDP_LOCAL void nsc_encode_duplicate_last_row(NSC_CONTEXT* WINPR_RESTRICT context,
+                                                 UINT32 lastRow);
+
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT out,
+                                    UINT32 originalSize);
 
 #endif /* FREERDP_LIB_CODEC_NSC_ENCODE_H */
@@ -32,12 +32,24 @@
 #include <freerdp/utils/profiler.h>
 #include <freerdp/codec/nsc.h>
 
+#include "work_group.h"
+
 #define ROUND_UP_TO(_b, _n) (_b + ((~(_b & (_n - 1)) + 0x1) & (_n - 1)))
 #define MINMAX(_v, _l, _h)                                             \
 	((_v) < (_l) ? WINPR_ASSERTING_INT_CAST(BYTE, (_l))                \
 	             : ((_v) > (_h) ? WINPR_ASSERTING_INT_CAST(BYTE, (_h)) \
 	                            : WINPR_ASSERTING_INT_CAST(BYTE, (_v))))
 
+/* Scalar version of the rounding 2x2 average used by the SIMD chroma subsampling */
+static inline BYTE nsc_subsample_avg(const BYTE* WINPR_RESTRICT src0,
+                                     const BYTE* WINPR_RESTRICT src1)
+{
+	/* the chroma values are signed, bias them for the unsigned averages */
+	const UINT32 t0 = ((src0[0] ^ 0x80u) + (src1[0] ^ 0x80u) + 1u) >> 1;
+	const UINT32 t1 = ((src0[1] ^ 0x80u) + (src1[1] ^ 0x80u) + 1u) >> 1;
+	return (BYTE)(((t0 + t1 + 1u) >> 1) ^ 0x80u);
+}
+
 typedef struct
 {
 	wLog* log;
@@ -45,6 +57,12 @@ typedef struct
 	BYTE* PlaneBuffers[5];     /* Decompressed Plane Buffers in the respective order */
 	UINT32 PlaneBuffersLength; /* Lengths of each plane buffer */
 
+	BYTE* EncodeBuffers[3];     /* Subsampled chroma planes and RLE output of the encoder */
+	UINT32 EncodeBuffersLength; /* Lengths of each encode buffer */
+
+	BOOL UseThreads;
+	CODEC_WORK_GROUP* WorkGroup; /* created by the first encode */
+
 	/* profilers */
 	PROFILER_DEFINE(prof_nsc_rle_decompress_data)
 	PROFILER_DEFINE(prof_nsc_decode)
@@ -72,8 +90,10 @@ struct S_NSC_CONTEXT
 	const BYTE* palette;
 
 	WINPR_ATTR_NODISCARD BOOL (*decode)(NSC_CONTEXT* WINPR_RESTRICT context);
+	/* convert the bitmap rows firstRow to lastRow - 1 and subsample the chroma of these rows */
 	WINPR_ATTR_NODISCARD BOOL (*encode)(NSC_CONTEXT* WINPR_RESTRICT context,
-	                                    const BYTE* WINPR_RESTRICT BitmapData, UINT32 rowstride);
+	                                    const BYTE* WINPR_RESTRICT BitmapData, UINT32 rowstride,
+	                                    UINT32 firstRow, UINT32 lastRow);
 
 	NSC_CONTEXT_PRIV* priv;
 };
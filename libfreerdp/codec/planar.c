@@ -29,11 +29,27 @@
 
 #include <freerdp/primitives.h>
 #include <freerdp/log.h>
+#include <freerdp/settings.h>
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
+#include "work_group.h"
+#include "../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED) && \
+    (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define PLANAR_SSE2
+#endif
+
 #define TAG FREERDP_TAG("codec")
 
+/* number of rows split into planes per job */
+#define PLANAR_ENCODE_BAND_ROWS 32
+
+/* smaller planes are encoded on the calling thread, waking up workers costs more */
+#define PLANAR_THREADING_MIN_SIZE 0x10000
+
 #define PLANAR_ALIGN(val, align) \
 	((val) % (align) == 0) ? (val) : ((val) + (align) - (val) % (align))
 
@@ -88,14 +104,31 @@ struct S_BITMAP_PLANAR_CONTEXT
 
 	BYTE* rlePlanes[4];
 	BYTE* rlePlanesBuffer;
+	UINT32 maxRlePlaneSize;
 
 	BYTE* pTempData;
 	UINT32 nTempStep;
 
 	BOOL bgr;
 	BOOL topdown;
+
+	BOOL UseThreads;
+	CODEC_WORK_GROUP* WorkGroup;
 };
 
+typedef struct
+{
+	BITMAP_PLANAR_CONTEXT* planar;
+	const BYTE* data;
+	UINT32 format;
+	UINT32 width;
+	UINT32 height;
+	UINT32 scanline;
+	BOOL bytePlanes;
+	BYTE offsets[4];
+	UINT32 dstSizes[4];
+} PLANAR_ENCODE_WORK_PARAM;
+
 static inline BYTE PLANAR_CONTROL_BYTE(UINT32 nRunLength, UINT32 cRawBytes)
 {
 	return WINPR_ASSERTING_INT_CAST(UINT8, ((nRunLength & 0x0F) | ((cRawBytes & 0x0F) << 4)));
@@ -1146,57 +1179,170 @@ BOOL freerdp_bitmap_decompress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT plan
 	return TRUE;
 }
 
-static inline BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
-                                              const BYTE* WINPR_RESTRICT data, UINT32 format,
-                                              UINT32 width, UINT32 height, UINT32 scanline,
-                                              BYTE* WINPR_RESTRICT planes[4])
+/* alpha offsets for formats without alpha channel and for a skipped alpha plane */
+#define PLANAR_ALPHA_OPAQUE 0xFE
+#define PLANAR_ALPHA_SKIP 0xFF
+
+/* Get the byte offsets of alpha, red, green and blue in a 32bpp pixel */
+static BOOL planar_split_layout(UINT32 format, BOOL skipAlpha, BYTE offsets[4])
 {
-	WINPR_ASSERT(planar);
+	/* FreeRDPReadColor reads 32bpp pixels most significant byte first */
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+			offsets[0] = (format == PIXEL_FORMAT_ARGB32) ? 0 : PLANAR_ALPHA_OPAQUE;
+			offsets[1] = 1;
+			offsets[2] = 2;
+			offsets[3] = 3;
+			break;
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			offsets[0] = (format == PIXEL_FORMAT_ABGR32) ? 0 : PLANAR_ALPHA_OPAQUE;
+			offsets[1] = 3;
+			offsets[2] = 2;
+			offsets[3] = 1;
+			break;
+		case PIXEL_FORMAT_RGBA32:
+		case PIXEL_FORMAT_RGBX32:
+			offsets[0] = (format == PIXEL_FORMAT_RGBA32) ? 3 : PLANAR_ALPHA_OPAQUE;
+			offsets[1] = 0;
+			offsets[2] = 1;
+			offsets[3] = 2;
+			break;
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_BGRX32:
+			offsets[0] = (format == PIXEL_FORMAT_BGRA32) ? 3 : PLANAR_ALPHA_OPAQUE;
+			offsets[1] = 2;
+			offsets[2] = 1;
+			offsets[3] = 0;
+			break;
+		default:
+			return FALSE;
+	}
 
-	if ((width > INT32_MAX) || (height > INT32_MAX) || (scanline > INT32_MAX))
-		return FALSE;
+	/* the alpha plane is not sent at all */
+	if (skipAlpha)
+		offsets[0] = PLANAR_ALPHA_SKIP;
+	return TRUE;
+}
 
-	if (scanline == 0)
-		scanline = width * FreeRDPGetBytesPerPixel(format);
+static inline void planar_split_row(const BYTE* WINPR_RESTRICT pixel, UINT32 format, UINT32 width,
+                                    BYTE* WINPR_RESTRICT planes[4], size_t k)
+{
+	const size_t bpp = FreeRDPGetBytesPerPixel(format);
 
-	if (planar->topdown)
+	for (UINT32 x = 0; x < width; x++)
 	{
-		UINT32 k = 0;
-		for (UINT32 i = 0; i < height; i++)
-		{
-			const BYTE* pixel = &data[1ULL * scanline * i];
+		const UINT32 color = FreeRDPReadColor(pixel, format);
+		pixel += bpp;
+		FreeRDPSplitColor(color, format, &planes[1][k + x], &planes[2][k + x], &planes[3][k + x],
+		                  &planes[0][k + x], nullptr);
+	}
+}
 
-			for (UINT32 j = 0; j < width; j++)
-			{
-				const UINT32 color = FreeRDPReadColor(pixel, format);
-				pixel += FreeRDPGetBytesPerPixel(format);
-				FreeRDPSplitColor(color, format, &planes[1][k], &planes[2][k], &planes[3][k],
-				                  &planes[0][k], nullptr);
-				k++;
-			}
+static inline void planar_split_row_32bpp(const BYTE* WINPR_RESTRICT pixel, UINT32 width,
+                                          const BYTE offsets[4], BYTE* WINPR_RESTRICT planes[4],
+                                          size_t k)
+{
+	const size_t first = (offsets[0] >= PLANAR_ALPHA_OPAQUE) ? 1 : 0;
+	UINT32 x = 0;
+
+	if (offsets[0] == PLANAR_ALPHA_OPAQUE)
+		memset(&planes[0][k], 0xFF, width);
+
+#if defined(PLANAR_SSE2)
+	const __m128i mask = _mm_set1_epi32(0xFF);
+
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i px[4];
+		for (size_t i = 0; i < 4; i++)
+			px[i] = _mm_loadu_si128((const __m128i*)(const void*)&pixel[4ull * (x + 4 * i)]);
+
+		for (size_t c = first; c < 4; c++)
+		{
+			const __m128i shift = _mm_cvtsi32_si128(8 * offsets[c]);
+			const __m128i v0 = _mm_and_si128(_mm_srl_epi32(px[0], shift), mask);
+			const __m128i v1 = _mm_and_si128(_mm_srl_epi32(px[1], shift), mask);
+			const __m128i v2 = _mm_and_si128(_mm_srl_epi32(px[2], shift), mask);
+			const __m128i v3 = _mm_and_si128(_mm_srl_epi32(px[3], shift), mask);
+			const __m128i lo = _mm_packs_epi32(v0, v1);
+			const __m128i hi = _mm_packs_epi32(v2, v3);
+			_mm_storeu_si128((__m128i*)(void*)&planes[c][k + x], _mm_packus_epi16(lo, hi));
 		}
 	}
-	else
+#endif
+
+	for (; x < width; x++)
 	{
-		UINT32 k = 0;
+		const BYTE* cur = &pixel[4ull * x];
+		for (size_t c = first; c < 4; c++)
+			planes[c][k + x] = cur[offsets[c]];
+	}
+}
 
-		for (INT64 i = (INT64)height - 1; i >= 0; i--)
-		{
-			const BYTE* pixel = &data[1ULL * scanline * (UINT32)i];
+static BOOL planar_split_band(void* context, size_t index,
+                              WINPR_ATTR_UNUSED BYTE* WINPR_RESTRICT arena)
+{
+	PLANAR_ENCODE_WORK_PARAM* param = context;
+	WINPR_ASSERT(param);
+	WINPR_ASSERT(param->planar);
 
-			for (UINT32 j = 0; j < width; j++)
-			{
-				const UINT32 color = FreeRDPReadColor(pixel, format);
-				pixel += FreeRDPGetBytesPerPixel(format);
-				FreeRDPSplitColor(color, format, &planes[1][k], &planes[2][k], &planes[3][k],
-				                  &planes[0][k], nullptr);
-				k++;
-			}
-		}
+	BYTE** planes = param->planar->planes;
+	const UINT32 first = WINPR_ASSERTING_INT_CAST(UINT32, index * PLANAR_ENCODE_BAND_ROWS);
+	const UINT32 last = MIN(param->height, first + PLANAR_ENCODE_BAND_ROWS);
+
+	for (UINT32 y = first; y < last; y++)
+	{
+		const UINT32 row = param->planar->topdown ? y : param->height - 1 - y;
+		const BYTE* pixel = &param->data[1ULL * param->scanline * row];
+		const size_t k = 1ULL * param->width * y;
+
+		if (param->bytePlanes)
+			planar_split_row_32bpp(pixel, param->width, param->offsets, planes, k);
+		else
+			planar_split_row(pixel, param->format, param->width, planes, k);
+	}
+
+	return TRUE;
+}
+
+static BOOL planar_run(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar, BOOL parallel, size_t count,
+                       codec_work_group_fn fn, void* param)
+{
+	WINPR_ASSERT(planar);
+
+	if (parallel)
+		return codec_work_group_run(planar->WorkGroup, count, fn, param);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (!fn(param, x, nullptr))
+			return FALSE;
 	}
 	return TRUE;
 }
 
+static inline BOOL freerdp_split_color_planes(PLANAR_ENCODE_WORK_PARAM* WINPR_RESTRICT param,
+                                              BOOL parallel)
+{
+	WINPR_ASSERT(param);
+
+	if ((param->width > INT32_MAX) || (param->height > INT32_MAX) ||
+	    (param->scanline > INT32_MAX))
+		return FALSE;
+
+	if (param->scanline == 0)
+		param->scanline = param->width * FreeRDPGetBytesPerPixel(param->format);
+
+	param->bytePlanes = planar_split_layout(param->format, param->planar->AllowSkipAlpha,
+	                                        param->offsets);
+
+	const size_t bands = (param->height + PLANAR_ENCODE_BAND_ROWS - 1) / PLANAR_ENCODE_BAND_ROWS;
+	return planar_run(param->planar, parallel, bands, planar_split_band, param);
+}
+
 static inline UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* WINPR_RESTRICT pInBuffer,
                                                            UINT32 cRawBytes, UINT32 nRunLength,
                                                            BYTE* WINPR_RESTRICT pOutBuffer,
@@ -1313,77 +1459,103 @@ static inline UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* WINPR_RES
 	return (UINT32)diff;
 }
 
+/* Returns the first position >= pos where in[pos] != in[pos - 1], or end */
+static inline UINT32 planar_rle_run_end(const BYTE* WINPR_RESTRICT in, UINT32 pos, UINT32 end)
+{
+	WINPR_ASSERT(pos > 0);
+
+#if defined(PLANAR_SSE2)
+	for (; pos + 16 <= end; pos += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(const void*)&in[pos]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)(const void*)&in[pos - 1]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+			break;
+	}
+#endif
+
+	while ((pos < end) && (in[pos] == in[pos - 1]))
+		pos++;
+
+	return pos;
+}
+
+/* Returns the first position >= pos where in[pos] == in[pos - 1], or end */
+static inline UINT32 planar_rle_raw_end(const BYTE* WINPR_RESTRICT in, UINT32 pos, UINT32 end)
+{
+	WINPR_ASSERT(pos > 0);
+
+#if defined(PLANAR_SSE2)
+	for (; pos + 16 <= end; pos += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(const void*)&in[pos]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)(const void*)&in[pos - 1]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0)
+			break;
+	}
+#endif
+
+	while ((pos < end) && (in[pos] != in[pos - 1]))
+		pos++;
+
+	return pos;
+}
+
 static inline UINT32 freerdp_bitmap_planar_encode_rle_bytes(const BYTE* WINPR_RESTRICT pInBuffer,
                                                             UINT32 inBufferSize,
                                                             BYTE* WINPR_RESTRICT pOutBuffer,
                                                             UINT32 outBufferSize)
 {
-	BYTE symbol = 0;
-	const BYTE* pInput = pInBuffer;
 	BYTE* pOutput = pOutBuffer;
-	const BYTE* pBytes = nullptr;
 	UINT32 cRawBytes = 0;
 	UINT32 nRunLength = 0;
-	UINT32 nBytesWritten = 0;
 	UINT32 nTotalBytesWritten = 0;
+	UINT32 pos = 0;
 
-	if (!outBufferSize)
+	if (!outBufferSize || !inBufferSize)
 		return 0;
 
-	do
-	{
-		if (!inBufferSize)
-			break;
+	/* A byte equal to its predecessor (0 for the first byte of a line) extends the run,
+	 * any other byte is raw. Runs shorter than 3 bytes are sent as raw bytes. */
+	if (pInBuffer[0] == 0)
+		pos = planar_rle_run_end(pInBuffer, 1, inBufferSize);
 
-		const UINT32 bSymbolMatch = (symbol == *pInput) != 0;
-		symbol = *pInput;
-		pInput++;
-		inBufferSize--;
+	nRunLength = pos;
 
-		if (nRunLength && !bSymbolMatch)
+	while (pos < inBufferSize)
+	{
+		if (nRunLength < 3)
+			cRawBytes += nRunLength;
+		else
 		{
-			if (nRunLength < 3)
-			{
-				cRawBytes += nRunLength;
-				nRunLength = 0;
-			}
-			else
-			{
-				pBytes = pInput - (cRawBytes + nRunLength + 1);
-				nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-				                                                      pOutput, outBufferSize);
-				nRunLength = 0;
+			const BYTE* pBytes = &pInBuffer[pos - cRawBytes - nRunLength];
+			const UINT32 nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(
+			    pBytes, cRawBytes, nRunLength, pOutput, outBufferSize);
 
-				if (!nBytesWritten || (nBytesWritten > outBufferSize))
-					return nRunLength;
+			if (!nBytesWritten || (nBytesWritten > outBufferSize))
+				return 0;
 
-				nTotalBytesWritten += nBytesWritten;
-				outBufferSize -= nBytesWritten;
-				pOutput += nBytesWritten;
-				cRawBytes = 0;
-			}
+			nTotalBytesWritten += nBytesWritten;
+			outBufferSize -= nBytesWritten;
+			pOutput += nBytesWritten;
+			cRawBytes = 0;
 		}
 
-		nRunLength += bSymbolMatch;
-		cRawBytes += (!bSymbolMatch) != 0;
-	} while (outBufferSize);
-
-	if (cRawBytes || nRunLength)
-	{
-		pBytes = pInput - (cRawBytes + nRunLength);
-		nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-		                                                      pOutput, outBufferSize);
-
-		if (!nBytesWritten)
-			return 0;
-
-		nTotalBytesWritten += nBytesWritten;
+		const UINT32 rawEnd = (pos == 0) ? planar_rle_raw_end(pInBuffer, 1, inBufferSize)
+		                                 : planar_rle_raw_end(pInBuffer, pos, inBufferSize);
+		cRawBytes += rawEnd - pos;
+		pos = planar_rle_run_end(pInBuffer, rawEnd, inBufferSize);
+		nRunLength = pos - rawEnd;
 	}
 
-	if (inBufferSize)
+	const BYTE* pBytes = &pInBuffer[inBufferSize - cRawBytes - nRunLength];
+	const UINT32 nBytesWritten =
+	    freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength, pOutput, outBufferSize);
+
+	if (!nBytesWritten)
 		return 0;
 
-	return nTotalBytesWritten;
+	return nTotalBytesWritten + nBytesWritten;
 }
 
 BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
@@ -1421,54 +1593,33 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane
 	return TRUE;
 }
 
-static inline BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRICT inPlanes[4],
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlanes,
-                                                             UINT32* WINPR_RESTRICT dstSizes,
-                                                             BOOL skipAlpha)
+static inline void planar_delta_encode_row(const BYTE* WINPR_RESTRICT cur,
+                                           const BYTE* WINPR_RESTRICT prev,
+                                           BYTE* WINPR_RESTRICT out, UINT32 width)
 {
-	UINT32 outPlanesSize = width * height * 4;
+	UINT32 x = 0;
 
-	/* AlphaPlane */
-	if (skipAlpha)
+#if defined(PLANAR_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 16 <= width; x += 16)
 	{
-		dstSizes[0] = 0;
+		const __m128i a = _mm_loadu_si128((const __m128i*)(const void*)&cur[x]);
+		const __m128i b = _mm_loadu_si128((const __m128i*)(const void*)&prev[x]);
+		const __m128i delta = _mm_sub_epi8(a, b);
+		const __m128i sign = _mm_cmpgt_epi8(zero, delta);
+		_mm_storeu_si128((__m128i*)(void*)&out[x],
+		                 _mm_xor_si128(_mm_add_epi8(delta, delta), sign));
 	}
-	else
-	{
-		dstSizes[0] = outPlanesSize;
-
-		if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[0], width, height, outPlanes,
-		                                              &dstSizes[0]))
-			return FALSE;
+#endif
 
-		outPlanes += dstSizes[0];
-		outPlanesSize -= dstSizes[0];
+	for (; x < width; x++)
+	{
+		/* twice the magnitude of the 8 bit delta, minus one for negative values */
+		const BYTE delta = (BYTE)(cur[x] - prev[x]);
+		const BYTE sign = (delta & 0x80) ? 0xFF : 0x00;
+		out[x] = (BYTE)((delta << 1) ^ sign);
 	}
-
-	/* LumaOrRedPlane */
-	dstSizes[1] = outPlanesSize;
-
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[1], width, height, outPlanes,
-	                                              &dstSizes[1]))
-		return FALSE;
-
-	outPlanes += dstSizes[1];
-	outPlanesSize -= dstSizes[1];
-	/* OrangeChromaOrGreenPlane */
-	dstSizes[2] = outPlanesSize;
-
-	if (!freerdp_bitmap_planar_compress_plane_rle(inPlanes[2], width, height, outPlanes,
-	                                              &dstSizes[2]))
-		return FALSE;
-
-	outPlanes += dstSizes[2];
-	outPlanesSize -= dstSizes[2];
-	/* GreenChromeOrBluePlane */
-	dstSizes[3] = outPlanesSize;
-
-	return (freerdp_bitmap_planar_compress_plane_rle(inPlanes[3], width, height, outPlanes,
-	                                                 &dstSizes[3]));
 }
 
 BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
@@ -1490,37 +1641,33 @@ BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlan
 	for (UINT32 y = 1; y < height; y++)
 	{
 		const size_t off = 1ull * width * y;
-		BYTE* outPtr = &outPlane[off];
-		const BYTE* srcPtr = &inPlane[off];
-		const BYTE* prevLinePtr = &inPlane[off - width];
-		for (UINT32 x = 0; x < width; x++)
-		{
-			const int delta = (int)srcPtr[x] - (int)prevLinePtr[x];
-			const int s2c1i = (delta >= 0) ? delta : (INT_MAX + delta) + 1;
-			const int8_t s2c1 = WINPR_CXX_COMPAT_CAST(int8_t, s2c1i);
-			const uint32_t s2c =
-			    (s2c1 >= 0) ? ((UINT32)s2c1 << 1) : (((UINT32)(~(s2c1) + 1) << 1) - 1);
-			outPtr[x] = (BYTE)s2c;
-		}
+		planar_delta_encode_row(&inPlane[off], &inPlane[off - width], &outPlane[off], width);
 	}
 
 	return outPlane;
 }
 
-static inline BOOL freerdp_bitmap_planar_delta_encode_planes(BYTE* WINPR_RESTRICT inPlanes[4],
-                                                             UINT32 width, UINT32 height,
-                                                             BYTE* WINPR_RESTRICT outPlanes[4])
+static BOOL planar_encode_plane(void* context, size_t index,
+                                WINPR_ATTR_UNUSED BYTE* WINPR_RESTRICT arena)
 {
-	for (UINT32 i = 0; i < 4; i++)
-	{
-		outPlanes[i] =
-		    freerdp_bitmap_planar_delta_encode_plane(inPlanes[i], width, height, outPlanes[i]);
+	PLANAR_ENCODE_WORK_PARAM* param = context;
+	WINPR_ASSERT(param);
 
-		if (!outPlanes[i])
-			return FALSE;
-	}
+	BITMAP_PLANAR_CONTEXT* planar = param->planar;
+	WINPR_ASSERT(planar);
 
-	return TRUE;
+	/* with a skipped alpha plane the jobs cover planes 1 to 3 */
+	const size_t plane = index + (planar->AllowSkipAlpha ? 1 : 0);
+	WINPR_ASSERT(plane < 4);
+
+	if (!freerdp_bitmap_planar_delta_encode_plane(planar->planes[plane], param->width,
+	                                              param->height, planar->deltaPlanes[plane]))
+		return FALSE;
+
+	param->dstSizes[plane] = planar->maxRlePlaneSize;
+	return freerdp_bitmap_planar_compress_plane_rle(planar->deltaPlanes[plane], param->width,
+	                                                param->height, planar->rlePlanes[plane],
+	                                                &param->dstSizes[plane]);
 }
 
 BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT context,
@@ -1544,39 +1691,43 @@ BYTE* freerdp_bitmap_compress_planar(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT conte
 	if (!context->AllowSkipAlpha)
 		format = planar_invert_format(context, TRUE, format);
 
-	if (!freerdp_split_color_planes(context, data, format, width, height, scanline,
-	                                context->planes))
+	if (planeSize > context->maxPlaneSize)
 		return nullptr;
 
-	if (context->AllowRunLengthEncoding)
+	if (!context->WorkGroup)
 	{
-		if (!freerdp_bitmap_planar_delta_encode_planes(context->planes, width, height,
-		                                               context->deltaPlanes))
+		context->WorkGroup = codec_work_group_new(context->UseThreads, 0);
+		if (!context->WorkGroup)
 			return nullptr;
+	}
+
+	PLANAR_ENCODE_WORK_PARAM param = { .planar = context,
+		                               .data = data,
+		                               .format = format,
+		                               .width = width,
+		                               .height = height,
+		                               .scanline = scanline };
+	const BOOL parallel = (planeSize >= PLANAR_THREADING_MIN_SIZE);
 
-		if (!freerdp_bitmap_planar_compress_planes_rle(context->deltaPlanes, width, height,
-		                                               context->rlePlanesBuffer, dstSizes,
-		                                               context->AllowSkipAlpha))
+	if (!freerdp_split_color_planes(&param, parallel))
+		return nullptr;
+
+	if (context->AllowRunLengthEncoding)
+	{
+		/* delta and RLE encoding of each plane into its own region of rlePlanesBuffer */
+		const size_t planes = context->AllowSkipAlpha ? 3 : 4;
+		if (!planar_run(context, parallel, planes, planar_encode_plane, &param))
 			return nullptr;
 
-		{
-			uint32_t offset = 0;
-			FormatHeader |= PLANAR_FORMAT_HEADER_RLE;
-			context->rlePlanes[0] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[0];
-			context->rlePlanes[1] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[1];
-			context->rlePlanes[2] = &context->rlePlanesBuffer[offset];
-			offset += dstSizes[2];
-			context->rlePlanes[3] = &context->rlePlanesBuffer[offset];
+		memcpy(dstSizes, param.dstSizes, sizeof(dstSizes));
+		FormatHeader |= PLANAR_FORMAT_HEADER_RLE;
 
 #if defined(WITH_DEBUG_CODECS)
-			WLog_DBG(TAG,
-			         "R: [%" PRIu32 "/%" PRIu32 "] G: [%" PRIu32 "/%" PRIu32 "] B: [%" PRIu32
-			         " / %" PRIu32 "] ",
-			         dstSizes[1], planeSize, dstSizes[2], planeSize, dstSizes[3], planeSize);
+		WLog_DBG(TAG,
+		         "R: [%" PRIu32 "/%" PRIu32 "] G: [%" PRIu32 "/%" PRIu32 "] B: [%" PRIu32
+		         " / %" PRIu32 "] ",
+		         dstSizes[1], planeSize, dstSizes[2], planeSize, dstSizes[3], planeSize);
 #endif
-		}
 	}
 
 	if (FormatHeader & PLANAR_FORMAT_HEADER_RLE)
@@ -1744,7 +1895,16 @@ BOOL freerdp_bitmap_planar_context_reset(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT c
 			return FALSE;
 		context->deltaPlanesBuffer = tmp;
 
-		tmp = winpr_aligned_recalloc(context->rlePlanesBuffer, context->maxPlaneSize, 4, 32);
+		/* room for incompressible planes: a control byte per 15 raw bytes and line */
+		{
+			const UINT64 rleSize = 16ull + context->maxPlaneSize + context->maxPlaneSize / 15ull +
+			                       context->maxHeight;
+			if (rleSize > UINT32_MAX / 4)
+				return FALSE;
+			context->maxRlePlaneSize = (UINT32)rleSize;
+		}
+
+		tmp = winpr_aligned_recalloc(context->rlePlanesBuffer, context->maxRlePlaneSize, 4, 32);
 		if (!tmp)
 			return FALSE;
 		context->rlePlanesBuffer = tmp;
@@ -1757,12 +1917,22 @@ BOOL freerdp_bitmap_planar_context_reset(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT c
 		context->deltaPlanes[1] = &context->deltaPlanesBuffer[1ULL * context->maxPlaneSize];
 		context->deltaPlanes[2] = &context->deltaPlanesBuffer[2ULL * context->maxPlaneSize];
 		context->deltaPlanes[3] = &context->deltaPlanesBuffer[3ULL * context->maxPlaneSize];
+		context->rlePlanes[0] = &context->rlePlanesBuffer[0ULL * context->maxRlePlaneSize];
+		context->rlePlanes[1] = &context->rlePlanesBuffer[1ULL * context->maxRlePlaneSize];
+		context->rlePlanes[2] = &context->rlePlanesBuffer[2ULL * context->maxRlePlaneSize];
+		context->rlePlanes[3] = &context->rlePlanesBuffer[3ULL * context->maxRlePlaneSize];
 	}
 	return TRUE;
 }
 
 BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 maxWidth,
                                                          UINT32 maxHeight)
+{
+	return freerdp_bitmap_planar_context_new_ex(flags, maxWidth, maxHeight, 0);
+}
+
+BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new_ex(DWORD flags, UINT32 maxWidth,
+                                                            UINT32 maxHeight, UINT32 ThreadingFlags)
 {
 	BITMAP_PLANAR_CONTEXT* context =
 	    (BITMAP_PLANAR_CONTEXT*)winpr_aligned_calloc(1, sizeof(BITMAP_PLANAR_CONTEXT), 32);
@@ -1780,6 +1950,7 @@ BITMAP_PLANAR_CONTEXT* freerdp_bitmap_planar_context_new(DWORD flags, UINT32 max
 		context->AllowColorSubsampling = TRUE;
 
 	context->ColorLossLevel = flags & PLANAR_FORMAT_HEADER_CLL_MASK;
+	context->UseThreads = (ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS) == 0;
 
 	if (context->ColorLossLevel)
 		context->AllowDynamicColorFidelity = TRUE;
@@ -1805,6 +1976,7 @@ void freerdp_bitmap_planar_context_free(BITMAP_PLANAR_CONTEXT* context)
 	winpr_aligned_free(context->planesBuffer);
 	winpr_aligned_free(context->deltaPlanesBuffer);
 	winpr_aligned_free(context->rlePlanesBuffer);
+	codec_work_group_free(context->WorkGroup);
 	winpr_aligned_free(context);
 }
 
@@ -39,6 +39,7 @@
 #include "rfx_rlgr.h"
 #include "rfx_constants.h"
 #include "rfx_types.h"
+#include "rfx_encode.h"
 #include "progressive.h"
 
 #define TAG FREERDP_TAG("codec.progressive")
@@ -56,6 +57,33 @@ typedef struct
 	BOOL mode;
 } RFX_PROGRESSIVE_UPGRADE_STATE;
 
+typedef struct
+{
+	BOOL nonLL;
+	wBitStream* srl;
+	wBitStream* raw;
+
+	/* SRL state */
+
+	UINT32 kp;
+	UINT32 nz;
+} RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE;
+
+static const RFX_COMPONENT_CODEC_QUANT progressive_encode_quant = { 6, 6, 6, 6, 6, 6, 7, 7, 7, 8 };
+
+/* The quality of the first pass and the intermediate upgrade pass, the last upgrade pass
+ * refines tiles to full quality (0xFF) */
+static const RFX_PROGRESSIVE_CODEC_QUANT progressive_encode_prog_quant[] = {
+	{ 30,
+	  { 2, 3, 3, 3, 5, 5, 5, 6, 6, 6 },
+	  { 3, 4, 4, 4, 6, 6, 6, 7, 7, 7 },
+	  { 3, 4, 4, 4, 6, 6, 6, 7, 7, 7 } },
+	{ 60,
+	  { 1, 1, 1, 1, 3, 3, 3, 3, 3, 3 },
+	  { 1, 2, 2, 2, 3, 3, 3, 4, 4, 4 },
+	  { 1, 2, 2, 2, 3, 3, 3, 4, 4, 4 } }
+};
+
 static inline void
 progressive_component_codec_quant_read(wStream* WINPR_RESTRICT s,
                                        RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT quantVal)
@@ -78,6 +106,17 @@ progressive_component_codec_quant_read(wStream* WINPR_RESTRICT s,
 	quantVal->HH1 = b >> 4;
 }
 
+static inline void
+progressive_component_codec_quant_write(wStream* WINPR_RESTRICT s,
+                                        const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT quantVal)
+{
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LL3 | (quantVal->HL3 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LH3 | (quantVal->HH3 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->HL2 | (quantVal->LH2 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->HH2 | (quantVal->HL1 << 4)));
+	Stream_Write_UINT8(s, (BYTE)(quantVal->LH1 | (quantVal->HH1 << 4)));
+}
+
 static inline void progressive_rfx_quant_add(const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT q1,
                                              const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT q2,
                                              RFX_COMPONENT_CODEC_QUANT* dst)
@@ -144,7 +183,7 @@ static inline BOOL progressive_rfx_quant_sub(const RFX_COMPONENT_CODEC_QUANT* WI
                                              const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT q2,
                                              RFX_COMPONENT_CODEC_QUANT* dst)
 {
-	if (q1->HH1 < q2->HL1)
+	if (q1->HL1 < q2->HL1)
 		return FALSE;
 	dst->HL1 = q1->HL1 - q2->HL1; /* HL1 */
 
@@ -806,14 +845,97 @@ void rfx_dwt_2d_extrapolate_decode(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RE
 	progressive_rfx_dwt_2d_decode_block(&buffer[0], dwt_buffer, 1);
 }
 
+/* Forward reduce-extrapolate DWT, the exact counterpart of progressive_rfx_idwt_x/y:
+ *
+ *   H[i] = (X[2i+1] - (X[2i] + X[2i+2]) / 2) / 2
+ *   L[i] = X[2i] + (H[i-1] + H[i]) / 2, with H[-1] = H[0]
+ *
+ * The last low band coefficients extrapolate the odd length edge. */
+static inline void progressive_rfx_dwt_1d(const INT16* WINPR_RESTRICT pSrc, size_t nSrcStep,
+                                          INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                                          INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                                          size_t nLowCount, size_t nHighCount)
+{
+	for (size_t i = 0; i < nHighCount; i++)
+	{
+		const int32_t X0 = pSrc[(2 * i) * nSrcStep];
+		const int32_t X1 = pSrc[(2 * i + 1) * nSrcStep];
+		const int32_t X2 = pSrc[(2 * i + 2) * nSrcStep];
+		pHighBand[i * nHighStep] = clampi16((X1 - ((X0 + X2) / 2)) / 2);
+	}
+
+	for (size_t i = 0; i < nHighCount; i++)
+	{
+		const int32_t H0 = pHighBand[((i > 0) ? (i - 1) : 0) * nHighStep];
+		const int32_t H1 = pHighBand[i * nHighStep];
+		pLowBand[i * nLowStep] = clampi16(pSrc[(2 * i) * nSrcStep] + ((H0 + H1) / 2));
+	}
+
+	const int32_t H = pHighBand[(nHighCount - 1) * nHighStep];
+	const int32_t X0 = pSrc[(2 * nHighCount) * nSrcStep];
+	if (nLowCount > (nHighCount + 1))
+	{
+		const int32_t X1 = pSrc[(2 * nHighCount + 1) * nSrcStep];
+		pLowBand[nHighCount * nLowStep] = clampi16(X0 + (H / 2));
+		pLowBand[(nHighCount + 1) * nLowStep] = clampi16((2 * X1) - X0);
+	}
+	else
+		pLowBand[nHighCount * nLowStep] = clampi16(X0 + H);
+}
+
+static inline void progressive_rfx_dwt_2d_encode_block(INT16* WINPR_RESTRICT buffer,
+                                                       INT16* WINPR_RESTRICT temp, size_t level)
+{
+	const size_t nBandL = progressive_rfx_get_band_l_count(level);
+	const size_t nBandH = progressive_rfx_get_band_h_count(level);
+	const size_t nSrcStep = nBandL + nBandH;
+
+	/* The source is read completely before the sub-bands overwrite it */
+	INT16* L = &temp[0];
+	INT16* H = &temp[nBandL * nSrcStep];
+
+	/* vertical (LL -> L + H) */
+	for (size_t x = 0; x < nSrcStep; x++)
+		progressive_rfx_dwt_1d(&buffer[x], nSrcStep, &L[x], nSrcStep, &H[x], nSrcStep, nBandL,
+		                       nBandH);
+
+	size_t offset = 0;
+	INT16* HL = &buffer[offset];
+	offset += (nBandH * nBandL);
+	INT16* LH = &buffer[offset];
+	offset += (nBandL * nBandH);
+	INT16* HH = &buffer[offset];
+	offset += (nBandH * nBandH);
+	INT16* LL = &buffer[offset];
+
+	/* horizontal (L -> LL + HL) */
+	for (size_t y = 0; y < nBandL; y++)
+		progressive_rfx_dwt_1d(&L[y * nSrcStep], 1, &LL[y * nBandL], 1, &HL[y * nBandH], 1,
+		                       nBandL, nBandH);
+
+	/* horizontal (H -> LH + HH) */
+	for (size_t y = 0; y < nBandH; y++)
+		progressive_rfx_dwt_1d(&H[y * nSrcStep], 1, &LH[y * nBandL], 1, &HH[y * nBandH], 1,
+		                       nBandL, nBandH);
+}
+
+static inline void progressive_rfx_dwt_2d_encode(INT16* WINPR_RESTRICT buffer,
+                                                 INT16* WINPR_RESTRICT temp)
+{
+	progressive_rfx_dwt_2d_encode_block(&buffer[0], temp, 1);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3007], temp, 2);
+	progressive_rfx_dwt_2d_encode_block(&buffer[3807], temp, 3);
+}
+
 static inline int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
                                                 INT16* WINPR_RESTRICT buffer,
-                                                INT16* WINPR_RESTRICT current, BOOL coeffDiff,
+                                                INT16* WINPR_RESTRICT current,
+                                                INT16* WINPR_RESTRICT temp, BOOL coeffDiff,
                                                 BOOL extrapolate, BOOL reverse)
 {
 	const primitives_t* prims = primitives_get();
 
-	if (!progressive || !buffer || !current)
+	if (!progressive || !buffer || !current || !temp)
 		return -1;
 
 	const uint32_t belements = 4096;
@@ -829,11 +951,6 @@ static inline int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* WINPR_RESTR
 			return -1;
 	}
 
-	INT16* temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
-
-	if (!temp)
-		return -2;
-
 	if (!extrapolate)
 	{
 		progressive->rfx_context->dwt_2d_decode(buffer, temp);
@@ -843,7 +960,6 @@ static inline int progressive_rfx_dwt_2d_decode(PROGRESSIVE_CONTEXT* WINPR_RESTR
 		WINPR_ASSERT(progressive->rfx_context->dwt_2d_extrapolate_decode);
 		progressive->rfx_context->dwt_2d_extrapolate_decode(buffer, temp);
 	}
-	BufferPool_Return(progressive->bufferPool, temp);
 	return 1;
 }
 
@@ -862,8 +978,9 @@ progressive_rfx_decode_component(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive
                                  const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT shift,
                                  const BYTE* WINPR_RESTRICT data, UINT32 length,
                                  INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT current,
-                                 INT16* WINPR_RESTRICT sign, BOOL coeffDiff,
-                                 WINPR_ATTR_UNUSED BOOL subbandDiff, BOOL extrapolate)
+                                 INT16* WINPR_RESTRICT sign, INT16* WINPR_RESTRICT temp,
+                                 BOOL coeffDiff, WINPR_ATTR_UNUSED BOOL subbandDiff,
+                                 BOOL extrapolate)
 {
 	int status = 0;
 	const primitives_t* prims = primitives_get();
@@ -922,21 +1039,22 @@ progressive_rfx_decode_component(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive
 		if (!progressive_rfx_decode_block(prims, &buffer[4015], 81, shift->LL3)) /* LL3 */
 			return -1;
 	}
-	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, coeffDiff, extrapolate,
-	                                     FALSE);
+	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, temp, coeffDiff,
+	                                     extrapolate, FALSE);
 }
 
 static inline int
 progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
                                   RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile,
                                   PROGRESSIVE_BLOCK_REGION* WINPR_RESTRICT region,
-                                  const PROGRESSIVE_BLOCK_CONTEXT* WINPR_RESTRICT context)
+                                  const PROGRESSIVE_BLOCK_CONTEXT* WINPR_RESTRICT context,
+                                  BYTE* WINPR_RESTRICT arena)
 {
 	int rc = 0;
 	BOOL diff = 0;
 	BOOL sub = 0;
 	BOOL extrapolate = 0;
-	BYTE* pBuffer = nullptr;
+	INT16* pTemp = nullptr;
 	INT16* pSign[3];
 	INT16* pSrcDst[3];
 	INT16* pCurrent[3];
@@ -1042,22 +1160,24 @@ progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressiv
 	pCurrent[1] = (INT16*)((&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pCurrent[2] = (INT16*)((&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
-	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
-	pSrcDst[0] = (INT16*)((&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
-	pSrcDst[1] = (INT16*)((&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
-	pSrcDst[2] = (INT16*)((&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	WINPR_ASSERT(arena);
+	pSrcDst[0] = (INT16*)((&arena[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pSrcDst[1] = (INT16*)((&arena[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pSrcDst[2] = (INT16*)((&arena[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	pTemp = (INT16*)(&arena[RFX_TILE_BUFFER_SIZE]);          /* DWT buffer */
 
 	rc = progressive_rfx_decode_component(progressive, &shiftY, tile->yData, tile->yLen, pSrcDst[0],
-	                                      pCurrent[0], pSign[0], diff, sub, extrapolate); /* Y */
+	                                      pCurrent[0], pSign[0], pTemp, diff, sub,
+	                                      extrapolate); /* Y */
 	if (rc < 0)
 		goto fail;
 	rc = progressive_rfx_decode_component(progressive, &shiftCb, tile->cbData, tile->cbLen,
-	                                      pSrcDst[1], pCurrent[1], pSign[1], diff, sub,
+	                                      pSrcDst[1], pCurrent[1], pSign[1], pTemp, diff, sub,
 	                                      extrapolate); /* Cb */
 	if (rc < 0)
 		goto fail;
 	rc = progressive_rfx_decode_component(progressive, &shiftCr, tile->crData, tile->crLen,
-	                                      pSrcDst[2], pCurrent[2], pSign[2], diff, sub,
+	                                      pSrcDst[2], pCurrent[2], pSign[2], pTemp, diff, sub,
 	                                      extrapolate); /* Cr */
 	if (rc < 0)
 		goto fail;
@@ -1068,7 +1188,6 @@ progressive_decompress_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressiv
 		                                    progressive->format, &roi_64x64);
 	}
 fail:
-	BufferPool_Return(progressive->bufferPool, pBuffer);
 	return rc;
 }
 
@@ -1260,9 +1379,9 @@ static inline int progressive_rfx_upgrade_component(
     const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT shift,
     const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT bitPos,
     const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT numBits, INT16* WINPR_RESTRICT buffer,
-    INT16* WINPR_RESTRICT current, INT16* WINPR_RESTRICT sign, const BYTE* WINPR_RESTRICT srlData,
-    UINT32 srlLen, const BYTE* WINPR_RESTRICT rawData, UINT32 rawLen, BOOL coeffDiff,
-    WINPR_ATTR_UNUSED BOOL subbandDiff, BOOL extrapolate)
+    INT16* WINPR_RESTRICT current, INT16* WINPR_RESTRICT sign, INT16* WINPR_RESTRICT temp,
+    const BYTE* WINPR_RESTRICT srlData, UINT32 srlLen, const BYTE* WINPR_RESTRICT rawData,
+    UINT32 rawLen, BOOL coeffDiff, WINPR_ATTR_UNUSED BOOL subbandDiff, BOOL extrapolate)
 {
 	int rc = 0;
 	UINT32 aRawLen = 0;
@@ -1349,21 +1468,22 @@ static inline int progressive_rfx_upgrade_component(
 		return -1;
 	}
 
-	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, coeffDiff, extrapolate,
-	                                     TRUE);
+	return progressive_rfx_dwt_2d_decode(progressive, buffer, current, temp, coeffDiff,
+	                                     extrapolate, TRUE);
 }
 
 static inline int
 progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
                                     RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile,
                                     PROGRESSIVE_BLOCK_REGION* WINPR_RESTRICT region,
-                                    const PROGRESSIVE_BLOCK_CONTEXT* WINPR_RESTRICT context)
+                                    const PROGRESSIVE_BLOCK_CONTEXT* WINPR_RESTRICT context,
+                                    BYTE* WINPR_RESTRICT arena)
 {
 	int status = 0;
 	BOOL coeffDiff = 0;
 	BOOL sub = 0;
 	BOOL extrapolate = 0;
-	BYTE* pBuffer = nullptr;
+	INT16* pTemp = nullptr;
 	INT16* pSign[3] = WINPR_C_ARRAY_INIT;
 	INT16* pSrcDst[3] = WINPR_C_ARRAY_INIT;
 	INT16* pCurrent[3] = WINPR_C_ARRAY_INIT;
@@ -1498,31 +1618,35 @@ progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progress
 	pCurrent[1] = (INT16*)((&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
 	pCurrent[2] = (INT16*)((&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
 
-	pBuffer = (BYTE*)BufferPool_Take(progressive->bufferPool, -1);
-	pSrcDst[0] = (INT16*)((&pBuffer[((8192 + 32) * 0) + 16])); /* Y/R buffer */
-	pSrcDst[1] = (INT16*)((&pBuffer[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
-	pSrcDst[2] = (INT16*)((&pBuffer[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	WINPR_ASSERT(arena);
+	pSrcDst[0] = (INT16*)((&arena[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pSrcDst[1] = (INT16*)((&arena[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pSrcDst[2] = (INT16*)((&arena[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+	pTemp = (INT16*)(&arena[RFX_TILE_BUFFER_SIZE]);          /* DWT buffer */
 
 	status = progressive_rfx_upgrade_component(progressive, &shiftY, quantProgY, &yNumBits,
-	                                           pSrcDst[0], pCurrent[0], pSign[0], tile->ySrlData,
-	                                           tile->ySrlLen, tile->yRawData, tile->yRawLen,
-	                                           coeffDiff, sub, extrapolate); /* Y */
+	                                           pSrcDst[0], pCurrent[0], pSign[0], pTemp,
+	                                           tile->ySrlData, tile->ySrlLen, tile->yRawData,
+	                                           tile->yRawLen, coeffDiff, sub,
+	                                           extrapolate); /* Y */
 
 	if (status < 0)
 		goto fail;
 
 	status = progressive_rfx_upgrade_component(progressive, &shiftCb, quantProgCb, &cbNumBits,
-	                                           pSrcDst[1], pCurrent[1], pSign[1], tile->cbSrlData,
-	                                           tile->cbSrlLen, tile->cbRawData, tile->cbRawLen,
-	                                           coeffDiff, sub, extrapolate); /* Cb */
+	                                           pSrcDst[1], pCurrent[1], pSign[1], pTemp,
+	                                           tile->cbSrlData, tile->cbSrlLen, tile->cbRawData,
+	                                           tile->cbRawLen, coeffDiff, sub,
+	                                           extrapolate); /* Cb */
 
 	if (status < 0)
 		goto fail;
 
 	status = progressive_rfx_upgrade_component(progressive, &shiftCr, quantProgCr, &crNumBits,
-	                                           pSrcDst[2], pCurrent[2], pSign[2], tile->crSrlData,
-	                                           tile->crSrlLen, tile->crRawData, tile->crRawLen,
-	                                           coeffDiff, sub, extrapolate); /* Cr */
+	                                           pSrcDst[2], pCurrent[2], pSign[2], pTemp,
+	                                           tile->crSrlData, tile->crSrlLen, tile->crRawData,
+	                                           tile->crRawLen, coeffDiff, sub,
+	                                           extrapolate); /* Cr */
 
 	if (status < 0)
 		goto fail;
@@ -1533,7 +1657,6 @@ progressive_decompress_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progress
 		                                        progressive->format, &roi_64x64);
 	}
 fail:
-	BufferPool_Return(progressive->bufferPool, pBuffer);
 	return status;
 }
 
@@ -1678,32 +1801,36 @@ progressive_tile_read(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, BOOL simp
 	return progressive_surface_tile_replace(surface, region, &tile, FALSE);
 }
 
-static void CALLBACK progressive_process_tiles_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                                  void* context, PTP_WORK work)
+static BOOL progressive_process_tiles_tile_work(void* context, size_t index,
+                                                BYTE* WINPR_RESTRICT arena)
 {
 	PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = (PROGRESSIVE_TILE_PROCESS_WORK_PARAM*)context;
 
-	WINPR_UNUSED(instance);
-	WINPR_UNUSED(work);
+	WINPR_ASSERT(param);
+	WINPR_ASSERT(param->region);
+	WINPR_ASSERT(index < param->region->numTiles);
+
+	RFX_PROGRESSIVE_TILE* tile = param->region->tiles[index];
 
-	switch (param->tile->blockType)
+	/* errors decoding a single tile are not fatal for the region */
+	switch (tile->blockType)
 	{
 		case PROGRESSIVE_WBT_TILE_SIMPLE:
 		case PROGRESSIVE_WBT_TILE_FIRST:
-			progressive_decompress_tile_first(param->progressive, param->tile, param->region,
-			                                  param->context);
+			progressive_decompress_tile_first(param->progressive, tile, param->region,
+			                                  param->context, arena);
 			break;
 
 		case PROGRESSIVE_WBT_TILE_UPGRADE:
-			progressive_decompress_tile_upgrade(param->progressive, param->tile, param->region,
-			                                    param->context);
+			progressive_decompress_tile_upgrade(param->progressive, tile, param->region,
+			                                    param->context, arena);
 			break;
 		default:
 			WLog_Print(param->progressive->log, WLOG_ERROR, "Invalid block type %04" PRIx16 " (%s)",
-			           param->tile->blockType,
-			           rfx_get_progressive_block_type_string(param->tile->blockType));
+			           tile->blockType, rfx_get_progressive_block_type_string(tile->blockType));
 			break;
 	}
+	return TRUE;
 }
 
 static inline SSIZE_T
@@ -1719,7 +1846,6 @@ progressive_process_tiles(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 	UINT16 blockType = 0;
 	UINT32 blockLen = 0;
 	UINT32 count = 0;
-	UINT16 close_cnt = 0;
 
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(region);
@@ -1801,55 +1927,17 @@ progressive_process_tiles(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
 		return -1044;
 	}
 
-	for (UINT32 idx = 0; idx < region->numTiles; idx++)
 	{
-		RFX_PROGRESSIVE_TILE* tile = region->tiles[idx];
-		PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = &progressive->params[idx];
-		param->progressive = progressive;
-		param->region = region;
-		param->context = context;
-		param->tile = tile;
+		PROGRESSIVE_TILE_PROCESS_WORK_PARAM param = { .progressive = progressive,
+			                                          .region = region,
+			                                          .context = context };
 
-		if (progressive->rfx_context->priv->UseThreads)
-		{
-			progressive->work_objects[idx] = CreateThreadpoolWork(
-			    progressive_process_tiles_tile_work_callback, (void*)param, nullptr);
-			if (!progressive->work_objects[idx])
-			{
-				WLog_Print(progressive->log, WLOG_ERROR,
-				           "Failed to create ThreadpoolWork for tile %" PRIu32, idx);
-				status = -1;
-				break;
-			}
-
-			SubmitThreadpoolWork(progressive->work_objects[idx]);
-
-			close_cnt = WINPR_ASSERTING_INT_CAST(UINT16, idx + 1);
-		}
-		else
-		{
-			progressive_process_tiles_tile_work_callback(nullptr, param, nullptr);
-		}
-
-		if (status < 0)
-		{
-			WLog_Print(progressive->log, WLOG_ERROR, "Failed to decompress %s at %" PRIu16,
-			           rfx_get_progressive_block_type_string(tile->blockType), idx);
-			goto fail;
-		}
+		/* the progressive decoder owns its RFX context, so its work group is free to use */
+		if (!codec_work_group_run(progressive->rfx_context->priv->WorkGroup, region->numTiles,
+		                          progressive_process_tiles_tile_work, &param))
+			status = -1;
 	}
 
-	if (progressive->rfx_context->priv->UseThreads)
-	{
-		for (UINT32 idx = 0; idx < close_cnt; idx++)
-		{
-			WaitForThreadpoolWorkCallbacks(progressive->work_objects[idx], FALSE);
-			CloseThreadpoolWork(progressive->work_objects[idx]);
-		}
-	}
-
-fail:
-
 	if (status < 0)
 		return -1;
 
@@ -2657,6 +2745,740 @@ fail:
 	return res;
 }
 
+static inline void progressive_rfx_quantize_block(const INT16* WINPR_RESTRICT src,
+                                                  INT16* WINPR_RESTRICT dst, size_t length,
+                                                  UINT32 bitPos, BOOL nonLL)
+{
+	const UINT32 shift = bitPos - 1;
+
+	for (size_t index = 0; index < length; index++)
+	{
+		const int32_t val = src[index];
+
+		/* LL3 is refined with unsigned RAW bits and needs a floor, the other bands are
+		 * refined by magnitude and truncate towards zero. */
+		if (nonLL && (val < 0))
+			dst[index] = WINPR_ASSERTING_INT_CAST(INT16, -((-val) >> shift));
+		else
+			dst[index] = WINPR_ASSERTING_INT_CAST(INT16, val >> shift);
+	}
+}
+
+static inline int
+progressive_rfx_encode_component(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                 const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT bitPos,
+                                 const INT16* WINPR_RESTRICT coeffs, INT16* WINPR_RESTRICT buffer,
+                                 BYTE* WINPR_RESTRICT dst, UINT32 dstSize)
+{
+	progressive_rfx_quantize_block(&coeffs[0], &buffer[0], 1023, bitPos->HL1, TRUE); /* HL1 */
+	progressive_rfx_quantize_block(&coeffs[1023], &buffer[1023], 1023, bitPos->LH1,
+	                               TRUE); /* LH1 */
+	progressive_rfx_quantize_block(&coeffs[2046], &buffer[2046], 961, bitPos->HH1,
+	                               TRUE); /* HH1 */
+	progressive_rfx_quantize_block(&coeffs[3007], &buffer[3007], 272, bitPos->HL2,
+	                               TRUE); /* HL2 */
+	progressive_rfx_quantize_block(&coeffs[3279], &buffer[3279], 272, bitPos->LH2,
+	                               TRUE); /* LH2 */
+	progressive_rfx_quantize_block(&coeffs[3551], &buffer[3551], 256, bitPos->HH2,
+	                               TRUE); /* HH2 */
+	progressive_rfx_quantize_block(&coeffs[3807], &buffer[3807], 72, bitPos->HL3, TRUE); /* HL3 */
+	progressive_rfx_quantize_block(&coeffs[3879], &buffer[3879], 72, bitPos->LH3, TRUE); /* LH3 */
+	progressive_rfx_quantize_block(&coeffs[3951], &buffer[3951], 64, bitPos->HH3, TRUE); /* HH3 */
+	progressive_rfx_quantize_block(&coeffs[4015], &buffer[4015], 81, bitPos->LL3,
+	                               FALSE); /* LL3 */
+	rfx_differential_encode(&buffer[4015], 81);
+
+	return progressive->rfx_context->rlgr_encode(RLGR1, buffer, 4096, dst, dstSize);
+}
+
+static inline void progressive_rfx_write_bits(wBitStream* WINPR_RESTRICT bs, UINT32 bits,
+                                              UINT32 nbits)
+{
+	if (nbits > 0)
+		BitStream_Write_Bits(bs, bits, nbits);
+}
+
+static inline void
+progressive_rfx_srl_write_zeros(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* WINPR_RESTRICT state)
+{
+	/* A '0' bit is a run of (1 << k) zeros, the decoder ignores the excess of the last one */
+	while (state->nz > 0)
+	{
+		const UINT32 k = state->kp / 8;
+		progressive_rfx_write_bits(state->srl, 0, 1);
+		state->nz -= MIN(state->nz, 1u << k);
+		state->kp = MIN(state->kp + 4, 80);
+	}
+}
+
+/* The counterpart of progressive_rfx_srl_read */
+static inline void
+progressive_rfx_srl_write(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* WINPR_RESTRICT state, INT16 value,
+                          UINT32 numBits)
+{
+	WINPR_ASSERT(state);
+
+	if (value == 0)
+	{
+		state->nz++;
+		return;
+	}
+
+	/* zero encoding */
+	UINT32 k = state->kp / 8;
+	while (state->nz >= (1u << k))
+	{
+		progressive_rfx_write_bits(state->srl, 0, 1);
+		state->nz -= (1u << k);
+		state->kp = MIN(state->kp + 4, 80);
+		k = state->kp / 8;
+	}
+
+	progressive_rfx_write_bits(state->srl, 1, 1);
+	progressive_rfx_write_bits(state->srl, state->nz, k);
+	state->nz = 0;
+
+	/* unary encoding */
+	progressive_rfx_write_bits(state->srl, (value < 0) ? 1 : 0, 1);
+
+	if (state->kp < 6)
+		state->kp = 0;
+	else
+		state->kp -= 6;
+
+	if (numBits == 1)
+		return;
+
+	const UINT32 mag = (UINT32)abs(value);
+	const UINT32 max = (1u << numBits) - 1;
+
+	for (UINT32 zeros = mag - 1; zeros > 0;)
+	{
+		const UINT32 n = MIN(zeros, 16);
+		progressive_rfx_write_bits(state->srl, 0, n);
+		zeros -= n;
+	}
+
+	if (mag < max)
+		progressive_rfx_write_bits(state->srl, 1, 1);
+}
+
+/* The counterpart of progressive_rfx_upgrade_block: coefficients significant at the previous
+ * bit position send their next \b numBits magnitude bits as RAW, all others are SRL coded. */
+static inline void
+progressive_rfx_upgrade_block_encode(RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE* WINPR_RESTRICT state,
+                                     const INT16* WINPR_RESTRICT coeffs, UINT32 length,
+                                     UINT32 bitPos, UINT32 numBits)
+{
+	if (numBits < 1)
+		return;
+
+	WINPR_ASSERT(bitPos > numBits);
+	const UINT32 shift = bitPos - numBits - 1;
+	const UINT32 mask = (1u << numBits) - 1;
+
+	if (!state->nonLL)
+	{
+		for (UINT32 index = 0; index < length; index++)
+		{
+			const int32_t val = coeffs[index];
+			progressive_rfx_write_bits(state->raw, (UINT32)(val >> shift) & mask, numBits);
+		}
+
+		return;
+	}
+
+	for (UINT32 index = 0; index < length; index++)
+	{
+		const int32_t val = coeffs[index];
+		const UINT32 mag = (UINT32)abs(val);
+		const UINT32 input = (mag >> shift) & mask;
+
+		if ((mag >> (bitPos - 1)) != 0)
+			progressive_rfx_write_bits(state->raw, input, numBits);
+		else
+		{
+			const INT16 ival = WINPR_ASSERTING_INT_CAST(INT16, input);
+			progressive_rfx_srl_write(state, (val < 0) ? (INT16)-ival : ival, numBits);
+		}
+	}
+}
+
+WINPR_ATTR_NODISCARD
+static inline BOOL progressive_rfx_upgrade_bitstream_len(wBitStream* WINPR_RESTRICT bs,
+                                                         UINT16* WINPR_RESTRICT len)
+{
+	const size_t bytes = (bs->position + 7ull) / 8ull;
+	if (bytes > bs->capacity)
+		return FALSE;
+
+	BitStream_Flush(bs);
+	*len = WINPR_ASSERTING_INT_CAST(UINT16, bytes);
+	return TRUE;
+}
+
+WINPR_ATTR_NODISCARD
+static inline BOOL progressive_rfx_upgrade_component_encode(
+    PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+    const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT bitPos,
+    const RFX_COMPONENT_CODEC_QUANT* WINPR_RESTRICT numBits, const INT16* WINPR_RESTRICT coeffs,
+    UINT16* WINPR_RESTRICT srlLen, UINT16* WINPR_RESTRICT rawLen)
+{
+	wBitStream s_srl = WINPR_C_ARRAY_INIT;
+	wBitStream s_raw = WINPR_C_ARRAY_INIT;
+	RFX_PROGRESSIVE_UPGRADE_ENCODE_STATE state = WINPR_C_ARRAY_INIT;
+
+	state.kp = 8;
+	state.srl = &s_srl;
+	state.raw = &s_raw;
+	BitStream_Attach(state.srl, progressive->srlBuffer, PROGRESSIVE_UPGRADE_BUFFER_SIZE);
+	BitStream_Attach(state.raw, progressive->rawBuffer, PROGRESSIVE_UPGRADE_BUFFER_SIZE);
+
+	state.nonLL = TRUE;
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[0], 1023, bitPos->HL1,
+	                                     numBits->HL1); /* HL1 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[1023], 1023, bitPos->LH1,
+	                                     numBits->LH1); /* LH1 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[2046], 961, bitPos->HH1,
+	                                     numBits->HH1); /* HH1 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[3007], 272, bitPos->HL2,
+	                                     numBits->HL2); /* HL2 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[3279], 272, bitPos->LH2,
+	                                     numBits->LH2); /* LH2 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[3551], 256, bitPos->HH2,
+	                                     numBits->HH2); /* HH2 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[3807], 72, bitPos->HL3,
+	                                     numBits->HL3); /* HL3 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[3879], 72, bitPos->LH3,
+	                                     numBits->LH3); /* LH3 */
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[3951], 64, bitPos->HH3,
+	                                     numBits->HH3); /* HH3 */
+
+	state.nonLL = FALSE;
+	progressive_rfx_upgrade_block_encode(&state, &coeffs[4015], 81, bitPos->LL3,
+	                                     numBits->LL3); /* LL3 */
+	progressive_rfx_srl_write_zeros(&state);
+
+	if (!progressive_rfx_upgrade_bitstream_len(state.srl, srlLen) ||
+	    !progressive_rfx_upgrade_bitstream_len(state.raw, rawLen))
+	{
+		WLog_Print(progressive->log, WLOG_ERROR, "RAW/SRL upgrade data exceeds %" PRIu32 " bytes",
+		           PROGRESSIVE_UPGRADE_BUFFER_SIZE);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static inline void progressive_tile_get_coefficients(RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile,
+                                                     INT16* WINPR_RESTRICT pCurrent[3])
+{
+	pCurrent[0] = (INT16*)((&tile->current[((8192 + 32) * 0) + 16])); /* Y/R buffer */
+	pCurrent[1] = (INT16*)((&tile->current[((8192 + 32) * 1) + 16])); /* Cb/G buffer */
+	pCurrent[2] = (INT16*)((&tile->current[((8192 + 32) * 2) + 16])); /* Cr/B buffer */
+}
+
+static inline const RFX_PROGRESSIVE_CODEC_QUANT*
+progressive_encode_get_prog_quant(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, BYTE quality)
+{
+	if (quality == 0xFF)
+		return &progressive->quantProgValFull;
+
+	WINPR_ASSERT(quality < ARRAYSIZE(progressive_encode_prog_quant));
+	return &progressive_encode_prog_quant[quality];
+}
+
+static inline BYTE progressive_encode_next_quality(BYTE quality)
+{
+	if ((quality == 0xFF) || (quality + 1u >= ARRAYSIZE(progressive_encode_prog_quant)))
+		return 0xFF;
+	return quality + 1;
+}
+
+/* Transform the source pixels of a tile and keep the coefficients for the upgrade passes */
+WINPR_ATTR_NODISCARD
+static BOOL progressive_tile_encode_coefficients(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                                 RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile,
+                                                 const BYTE* WINPR_RESTRICT pSrcData,
+                                                 UINT32 SrcFormat, UINT32 Width, UINT32 Height,
+                                                 UINT32 ScanLine)
+{
+	INT16* pCurrent[3] = WINPR_C_ARRAY_INIT;
+
+	const UINT32 x = tile->xIdx * 64u;
+	const UINT32 y = tile->yIdx * 64u;
+	WINPR_ASSERT(x < Width);
+	WINPR_ASSERT(y < Height);
+
+	const size_t bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+	const BYTE* data = &pSrcData[1ull * y * ScanLine + 1ull * x * bpp];
+	progressive_tile_get_coefficients(tile, pCurrent);
+	if (!rfx_encode_rgb_to_ycbcr(progressive->rfx_context, data, MIN(64, Width - x),
+	                             MIN(64, Height - y), ScanLine, pCurrent))
+		return FALSE;
+
+	INT16* temp = (INT16*)BufferPool_Take(progressive->bufferPool, -1); /* DWT buffer */
+	if (!temp)
+		return FALSE;
+
+	for (size_t index = 0; index < 3; index++)
+		progressive_rfx_dwt_2d_encode(pCurrent[index], temp);
+
+	BufferPool_Return(progressive->bufferPool, temp);
+	return TRUE;
+}
+
+WINPR_ATTR_NODISCARD
+static BOOL progressive_write_tile_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                         wStream* WINPR_RESTRICT s,
+                                         RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile)
+{
+	BOOL rc = FALSE;
+	INT16* pCurrent[3] = WINPR_C_ARRAY_INIT;
+	const RFX_COMPONENT_CODEC_QUANT* bitPos[3] = { &tile->yBitPos, &tile->cbBitPos,
+		                                           &tile->crBitPos };
+	const UINT32 maxLen = 8192;
+	UINT16 len[3] = WINPR_C_ARRAY_INIT;
+	const size_t start = Stream_GetPosition(s);
+
+	INT16* pBuffer = (INT16*)BufferPool_Take(progressive->bufferPool, -1);
+	if (!pBuffer)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 23))
+		goto fail;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_FIRST); /* blockType (2 bytes) */
+	Stream_Seek_UINT32(s);                              /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                           /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, tile->xIdx);                 /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, tile->yIdx);                 /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, 0);                           /* flags (1 byte) */
+	Stream_Write_UINT8(s, tile->quality);               /* quality (1 byte) */
+	Stream_Zero(s, 8); /* yLen, cbLen, crLen, tailLen (2 bytes each) */
+
+	progressive_tile_get_coefficients(tile, pCurrent);
+	for (size_t index = 0; index < 3; index++)
+	{
+		if (!Stream_EnsureRemainingCapacity(s, maxLen))
+			goto fail;
+
+		/* The RLGR encoder expects a zero initialized buffer */
+		BYTE* dst = Stream_Pointer(s);
+		ZeroMemory(dst, maxLen);
+		const int status =
+		    progressive_rfx_encode_component(progressive, bitPos[index], pCurrent[index], pBuffer,
+		                                     dst, maxLen);
+		if ((status < 0) || ((UINT32)status >= maxLen))
+			goto fail;
+
+		len[index] = WINPR_ASSERTING_INT_CAST(UINT16, status);
+		Stream_Seek(s, len[index]);
+	}
+
+	{
+		BYTE* header = Stream_Buffer(s) + start;
+		const size_t blockLen = Stream_GetPosition(s) - start;
+		winpr_Data_Write_UINT32(&header[2], WINPR_ASSERTING_INT_CAST(UINT32, blockLen));
+		winpr_Data_Write_UINT16(&header[15], len[0]);
+		winpr_Data_Write_UINT16(&header[17], len[1]);
+		winpr_Data_Write_UINT16(&header[19], len[2]);
+	}
+	rc = TRUE;
+
+fail:
+	BufferPool_Return(progressive->bufferPool, pBuffer);
+	return rc;
+}
+
+WINPR_ATTR_NODISCARD
+static BOOL progressive_write_tile_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                           wStream* WINPR_RESTRICT s,
+                                           RFX_PROGRESSIVE_TILE* WINPR_RESTRICT tile,
+                                           BYTE quality)
+{
+	INT16* pCurrent[3] = WINPR_C_ARRAY_INIT;
+	RFX_COMPONENT_CODEC_QUANT* bitPos[3] = { &tile->yBitPos, &tile->cbBitPos, &tile->crBitPos };
+	const RFX_PROGRESSIVE_CODEC_QUANT* quantProg =
+	    progressive_encode_get_prog_quant(progressive, quality);
+	const RFX_COMPONENT_CODEC_QUANT* quantProgVals[3] = { &quantProg->yQuantValues,
+		                                                  &quantProg->cbQuantValues,
+		                                                  &quantProg->crQuantValues };
+	const size_t start = Stream_GetPosition(s);
+
+	if (!Stream_EnsureRemainingCapacity(s, 26))
+		return FALSE;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_TILE_UPGRADE); /* blockType (2 bytes) */
+	Stream_Seek_UINT32(s);                                /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxY (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCb (1 byte) */
+	Stream_Write_UINT8(s, 0);                             /* quantIdxCr (1 byte) */
+	Stream_Write_UINT16(s, tile->xIdx);                   /* xIdx (2 bytes) */
+	Stream_Write_UINT16(s, tile->yIdx);                   /* yIdx (2 bytes) */
+	Stream_Write_UINT8(s, quality);                       /* quality (1 byte) */
+	Stream_Zero(s, 12); /* SRL and RAW lengths of Y, Cb and Cr (2 bytes each) */
+
+	progressive_tile_get_coefficients(tile, pCurrent);
+	for (size_t index = 0; index < 3; index++)
+	{
+		RFX_COMPONENT_CODEC_QUANT newBitPos = WINPR_C_ARRAY_INIT;
+		RFX_COMPONENT_CODEC_QUANT numBits = WINPR_C_ARRAY_INIT;
+		UINT16 srlLen = 0;
+		UINT16 rawLen = 0;
+
+		progressive_rfx_quant_add(&progressive_encode_quant, quantProgVals[index], &newBitPos);
+		if (!progressive_rfx_quant_sub(bitPos[index], &newBitPos, &numBits))
+			return FALSE;
+
+		if (!progressive_rfx_upgrade_component_encode(progressive, bitPos[index], &numBits,
+		                                              pCurrent[index], &srlLen, &rawLen))
+			return FALSE;
+
+		if (!Stream_EnsureRemainingCapacity(s, 1ull * srlLen + rawLen))
+			return FALSE;
+
+		Stream_Write(s, progressive->srlBuffer, srlLen);
+		Stream_Write(s, progressive->rawBuffer, rawLen);
+
+		BYTE* header = Stream_Buffer(s) + start;
+		winpr_Data_Write_UINT16(&header[14 + (4 * index)], srlLen);
+		winpr_Data_Write_UINT16(&header[16 + (4 * index)], rawLen);
+		*bitPos[index] = newBitPos;
+	}
+
+	{
+		BYTE* header = Stream_Buffer(s) + start;
+		const size_t blockLen = Stream_GetPosition(s) - start;
+		winpr_Data_Write_UINT32(&header[2], WINPR_ASSERTING_INT_CAST(UINT32, blockLen));
+	}
+
+	tile->quality = quality;
+	tile->pass++;
+	return TRUE;
+}
+
+/* Write a complete message with a single region from the encoded \b tiles */
+WINPR_ATTR_NODISCARD
+static BOOL progressive_write_message(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive,
+                                      PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surface,
+                                      wStream* WINPR_RESTRICT s,
+                                      const RFX_RECT* WINPR_RESTRICT rects, UINT16 numRects,
+                                      wStream* WINPR_RESTRICT tiles, UINT16 numTiles)
+{
+	const BYTE numProgQuant = ARRAYSIZE(progressive_encode_prog_quant);
+	const size_t tilesDataSize = Stream_GetPosition(tiles);
+	const size_t regionLen = 18ull + 8ull * numRects + 5ull + 16ull * numProgQuant + tilesDataSize;
+
+	if (regionLen > UINT32_MAX)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, 12ull + 10ull + 12ull + regionLen + 6ull))
+		return FALSE;
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_SYNC); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                   /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, 0xCACCACCA);           /* magic (4 bytes) */
+	Stream_Write_UINT16(s, 0x0100);               /* version (2 bytes) */
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_CONTEXT); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 10);                      /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 0);                        /* ctxId (1 byte) */
+	Stream_Write_UINT16(s, 64);                      /* tileSize (2 bytes) */
+	Stream_Write_UINT8(s, RFX_SUBBAND_DIFFING);      /* flags (1 byte) */
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_BEGIN); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 12);                          /* blockLen (4 bytes) */
+	Stream_Write_UINT32(s, surface->frameId++);          /* frameIndex (4 bytes) */
+	Stream_Write_UINT16(s, 1);                           /* regionCount (2 bytes) */
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_REGION);    /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)regionLen);         /* blockLen (4 bytes) */
+	Stream_Write_UINT8(s, 64);                         /* tileSize (1 byte) */
+	Stream_Write_UINT16(s, numRects);                  /* numRects (2 bytes) */
+	Stream_Write_UINT8(s, 1);                          /* numQuant (1 byte) */
+	Stream_Write_UINT8(s, numProgQuant);               /* numProgQuant (1 byte) */
+	Stream_Write_UINT8(s, RFX_DWT_REDUCE_EXTRAPOLATE); /* flags (1 byte) */
+	Stream_Write_UINT16(s, numTiles);                  /* numTiles (2 bytes) */
+	Stream_Write_UINT32(s, (UINT32)tilesDataSize);     /* tilesDataSize (4 bytes) */
+
+	for (UINT16 index = 0; index < numRects; index++)
+	{
+		const RFX_RECT* r = &rects[index];
+		Stream_Write_UINT16(s, r->x);      /* x (2 bytes) */
+		Stream_Write_UINT16(s, r->y);      /* y (2 bytes) */
+		Stream_Write_UINT16(s, r->width);  /* width (2 bytes) */
+		Stream_Write_UINT16(s, r->height); /* height (2 bytes) */
+	}
+
+	progressive_component_codec_quant_write(s, &progressive_encode_quant);
+	for (size_t index = 0; index < numProgQuant; index++)
+	{
+		const RFX_PROGRESSIVE_CODEC_QUANT* quantProgVal = &progressive_encode_prog_quant[index];
+		Stream_Write_UINT8(s, quantProgVal->quality);
+		progressive_component_codec_quant_write(s, &quantProgVal->yQuantValues);
+		progressive_component_codec_quant_write(s, &quantProgVal->cbQuantValues);
+		progressive_component_codec_quant_write(s, &quantProgVal->crQuantValues);
+	}
+	Stream_Write(s, Stream_Buffer(tiles), tilesDataSize);
+
+	Stream_Write_UINT16(s, PROGRESSIVE_WBT_FRAME_END); /* blockType (2 bytes) */
+	Stream_Write_UINT32(s, 6);                         /* blockLen (4 bytes) */
+	return TRUE;
+}
+
+static inline PROGRESSIVE_SURFACE_CONTEXT*
+progressive_encode_get_surface(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT16 surfaceId,
+                               UINT32 Width, UINT32 Height)
+{
+	if (progressive_create_surface_context(progressive, surfaceId, Width, Height) < 0)
+		return nullptr;
+
+	PROGRESSIVE_SURFACE_CONTEXT* surface = progressive_get_surface_data(progressive, surfaceId);
+	if (!surface)
+		return nullptr;
+
+	if ((Width > surface->width) || (Height > surface->height))
+	{
+		WLog_Print(progressive->log, WLOG_ERROR,
+		           "image %" PRIu32 "x%" PRIu32 " exceeds surface %" PRIu16 " %" PRIu32 "x%" PRIu32,
+		           Width, Height, surfaceId, surface->width, surface->height);
+		return nullptr;
+	}
+
+	return surface;
+}
+
+static inline BOOL progressive_encode_mark_tile(PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surface,
+                                                UINT32 xIdx, UINT32 yIdx)
+{
+	const size_t zIdx = (1ull * yIdx * surface->gridWidth) + xIdx;
+	if ((xIdx >= surface->gridWidth) || (zIdx >= surface->tilesSize))
+		return FALSE;
+
+	RFX_PROGRESSIVE_TILE* tile = surface->tiles[zIdx];
+	if (tile->dirty)
+		return TRUE;
+
+	WINPR_ASSERT(surface->numUpdatedTiles < surface->gridSize);
+	tile->xIdx = WINPR_ASSERTING_INT_CAST(UINT16, xIdx);
+	tile->yIdx = WINPR_ASSERTING_INT_CAST(UINT16, yIdx);
+	tile->x = xIdx * tile->width;
+	tile->y = yIdx * tile->height;
+	tile->dirty = TRUE;
+	surface->updatedTileIndices[surface->numUpdatedTiles++] = (UINT32)zIdx;
+	return TRUE;
+}
+
+static inline void
+progressive_encode_clear_marks(PROGRESSIVE_SURFACE_CONTEXT* WINPR_RESTRICT surface)
+{
+	for (UINT32 index = 0; index < surface->numUpdatedTiles; index++)
+		surface->tiles[surface->updatedTileIndices[index]]->dirty = FALSE;
+	surface->numUpdatedTiles = 0;
+}
+
+int progressive_compress_first(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT16 surfaceId,
+                               const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                               UINT32 SrcFormat, UINT32 Width, UINT32 Height, UINT32 ScanLine,
+                               const REGION16* WINPR_RESTRICT invalidRegion,
+                               BYTE** WINPR_RESTRICT ppDstData, UINT32* WINPR_RESTRICT pDstSize)
+{
+	int res = -1;
+	UINT32 numRects = 0;
+	RFX_RECT* rects = nullptr;
+
+	if (!progressive || !pSrcData || !ppDstData || !pDstSize || !progressive->srlBuffer)
+		return -1;
+
+	if (ScanLine == 0)
+		ScanLine = Width * FreeRDPGetBytesPerPixel(SrcFormat);
+
+	if ((ScanLine == 0) || (SrcSize < 1ull * Height * ScanLine))
+		return -4;
+
+	PROGRESSIVE_SURFACE_CONTEXT* surface =
+	    progressive_encode_get_surface(progressive, surfaceId, Width, Height);
+	if (!surface)
+		return -5;
+
+	if (invalidRegion)
+	{
+		const int nr = region16_n_rects(invalidRegion);
+		numRects = WINPR_ASSERTING_INT_CAST(uint32_t, nr);
+	}
+	else if ((Width > 0) && (Height > 0))
+		numRects = 1;
+
+	if (numRects == 0)
+		return 0;
+
+	if (numRects > UINT16_MAX)
+		return -5;
+
+	Stream_ResetPosition(progressive->rects);
+	if (!Stream_EnsureRemainingCapacity(progressive->rects, numRects * sizeof(RFX_RECT)))
+		return -5;
+	rects = Stream_BufferAs(progressive->rects, RFX_RECT);
+
+	rfx_context_set_pixel_format(progressive->rfx_context, SrcFormat);
+	Stream_ResetPosition(progressive->tiles);
+	progressive_encode_clear_marks(surface);
+
+	{
+		const RECTANGLE_16 full = { 0, 0, WINPR_ASSERTING_INT_CAST(UINT16, Width),
+			                        WINPR_ASSERTING_INT_CAST(UINT16, Height) };
+		const RECTANGLE_16* region_rects =
+		    invalidRegion ? region16_rects(invalidRegion, nullptr) : &full;
+		for (UINT32 index = 0; index < numRects; index++)
+		{
+			const RECTANGLE_16* r = &region_rects[index];
+			RFX_RECT* rect = &rects[index];
+
+			rect->x = MIN(r->left, Width);
+			rect->y = MIN(r->top, Height);
+			rect->width = WINPR_ASSERTING_INT_CAST(UINT16, MIN(r->right, Width) - rect->x);
+			rect->height = WINPR_ASSERTING_INT_CAST(UINT16, MIN(r->bottom, Height) - rect->y);
+
+			for (UINT32 y = rect->y / 64; y < (rect->y + rect->height + 63u) / 64; y++)
+			{
+				for (UINT32 x = rect->x / 64; x < (rect->x + rect->width + 63u) / 64; x++)
+				{
+					if (!progressive_encode_mark_tile(surface, x, y))
+						goto fail;
+				}
+			}
+		}
+	}
+
+	if (surface->numUpdatedTiles > UINT16_MAX)
+		goto fail;
+
+	for (UINT32 index = 0; index < surface->numUpdatedTiles; index++)
+	{
+		RFX_PROGRESSIVE_TILE* tile = surface->tiles[surface->updatedTileIndices[index]];
+		const RFX_PROGRESSIVE_CODEC_QUANT* quantProg = &progressive_encode_prog_quant[0];
+
+		tile->quality = 0;
+		tile->pass = 1;
+		progressive_rfx_quant_add(&progressive_encode_quant, &quantProg->yQuantValues,
+		                          &tile->yBitPos);
+		progressive_rfx_quant_add(&progressive_encode_quant, &quantProg->cbQuantValues,
+		                          &tile->cbBitPos);
+		progressive_rfx_quant_add(&progressive_encode_quant, &quantProg->crQuantValues,
+		                          &tile->crBitPos);
+
+		if (!progressive_tile_encode_coefficients(progressive, tile, pSrcData, SrcFormat, Width,
+		                                          Height, ScanLine))
+			goto fail;
+
+		if (!progressive_write_tile_first(progressive, progressive->tiles, tile))
+			goto fail;
+	}
+
+	Stream_ResetPosition(progressive->buffer);
+	if (!progressive_write_message(progressive, surface, progressive->buffer, rects,
+	                               (UINT16)numRects, progressive->tiles,
+	                               (UINT16)surface->numUpdatedTiles))
+		goto fail;
+
+	*pDstSize = WINPR_ASSERTING_INT_CAST(UINT32, Stream_GetPosition(progressive->buffer));
+	*ppDstData = Stream_Buffer(progressive->buffer);
+	res = 1;
+
+fail:
+	if (res < 0)
+	{
+		/* Tiles that were not sent have nothing to upgrade */
+		for (UINT32 index = 0; index < surface->numUpdatedTiles; index++)
+			surface->tiles[surface->updatedTileIndices[index]]->pass = 0;
+	}
+	progressive_encode_clear_marks(surface);
+	return res;
+}
+
+int progressive_compress_upgrade(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, UINT16 surfaceId,
+                                 UINT32 maxSize, BYTE** WINPR_RESTRICT ppDstData,
+                                 UINT32* WINPR_RESTRICT pDstSize)
+{
+	int res = -1;
+	BYTE quality = 0xFF;
+
+	if (!progressive || !ppDstData || !pDstSize || !progressive->srlBuffer)
+		return -1;
+
+	PROGRESSIVE_SURFACE_CONTEXT* surface = progressive_get_surface_data(progressive, surfaceId);
+	if (!surface)
+		return -1;
+
+	/* Refine the tiles furthest from full quality first */
+	for (size_t index = 0; index < surface->gridSize; index++)
+	{
+		const RFX_PROGRESSIVE_TILE* tile = surface->tiles[index];
+		if (tile->pass > 0)
+			quality = MIN(quality, tile->quality);
+	}
+
+	if (quality == 0xFF)
+		return 0;
+
+	const BYTE next = progressive_encode_next_quality(quality);
+	const size_t headerLen = 12ull + 10ull + 12ull + 18ull + 5ull +
+	                         16ull * ARRAYSIZE(progressive_encode_prog_quant) + 6ull;
+	size_t numRects = 0;
+
+	Stream_ResetPosition(progressive->rects);
+	Stream_ResetPosition(progressive->tiles);
+	for (size_t index = 0; (index < surface->gridSize) && (numRects < UINT16_MAX); index++)
+	{
+		RFX_PROGRESSIVE_TILE* tile = surface->tiles[index];
+		if ((tile->pass == 0) || (tile->quality != quality))
+			continue;
+
+		const RFX_PROGRESSIVE_TILE state = *tile;
+		const size_t pos = Stream_GetPosition(progressive->tiles);
+		if (!progressive_write_tile_upgrade(progressive, progressive->tiles, tile, next))
+			goto fail;
+
+		const size_t size =
+		    headerLen + 8ull * (numRects + 1) + Stream_GetPosition(progressive->tiles);
+		if ((maxSize > 0) && (numRects > 0) && (size > maxSize))
+		{
+			/* Out of budget, this tile is upgraded by the next call */
+			*tile = state;
+			if (!Stream_SetPosition(progressive->tiles, pos))
+				goto fail;
+			break;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(progressive->rects, sizeof(RFX_RECT)))
+			goto fail;
+
+		RFX_RECT* rect = Stream_PointerAs(progressive->rects, RFX_RECT);
+		rect->x = WINPR_ASSERTING_INT_CAST(UINT16, tile->x);
+		rect->y = WINPR_ASSERTING_INT_CAST(UINT16, tile->y);
+		rect->width = WINPR_ASSERTING_INT_CAST(UINT16, MIN(64, surface->width - tile->x));
+		rect->height = WINPR_ASSERTING_INT_CAST(UINT16, MIN(64, surface->height - tile->y));
+		Stream_Seek(progressive->rects, sizeof(RFX_RECT));
+		numRects++;
+	}
+
+	Stream_ResetPosition(progressive->buffer);
+	if (!progressive_write_message(progressive, surface, progressive->buffer,
+	                               Stream_BufferAs(progressive->rects, RFX_RECT), (UINT16)numRects,
+	                               progressive->tiles, (UINT16)numRects))
+		goto fail;
+
+	*pDstSize = WINPR_ASSERTING_INT_CAST(UINT32, Stream_GetPosition(progressive->buffer));
+	*ppDstData = Stream_Buffer(progressive->buffer);
+	res = 1;
+
+fail:
+	return res;
+}
+
 BOOL progressive_context_reset(PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive)
 {
 	return (progressive != nullptr);
@@ -2689,6 +3511,18 @@ PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor, UINT32 Threadin
 	progressive->rects = Stream_New(nullptr, 1024);
 	if (!progressive->rects)
 		goto fail;
+	if (Compressor)
+	{
+		progressive->tiles = Stream_New(nullptr, 1024);
+		if (!progressive->tiles)
+			goto fail;
+		progressive->srlBuffer = winpr_aligned_malloc(PROGRESSIVE_UPGRADE_BUFFER_SIZE, 16);
+		if (!progressive->srlBuffer)
+			goto fail;
+		progressive->rawBuffer = winpr_aligned_malloc(PROGRESSIVE_UPGRADE_BUFFER_SIZE, 16);
+		if (!progressive->rawBuffer)
+			goto fail;
+	}
 	progressive->bufferPool = BufferPool_New(TRUE, (8192LL + 32LL) * 3LL, 16);
 	if (!progressive->bufferPool)
 		goto fail;
@@ -2717,6 +3551,9 @@ void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
 
 	Stream_Free(progressive->buffer, TRUE);
 	Stream_Free(progressive->rects, TRUE);
+	Stream_Free(progressive->tiles, TRUE);
+	winpr_aligned_free(progressive->srlBuffer);
+	winpr_aligned_free(progressive->rawBuffer);
 	rfx_context_free(progressive->rfx_context);
 
 	BufferPool_Free(progressive->bufferPool);
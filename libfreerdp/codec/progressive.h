@@ -33,6 +33,8 @@
 
 #define RFX_DWT_REDUCE_EXTRAPOLATE 0x01
 
+#define PROGRESSIVE_UPGRADE_BUFFER_SIZE UINT16_MAX
+
 typedef struct
 {
 	BYTE LL3;
@@ -148,7 +150,6 @@ typedef struct
 	PROGRESSIVE_CONTEXT* progressive;
 	PROGRESSIVE_BLOCK_REGION* region;
 	const PROGRESSIVE_BLOCK_CONTEXT* context;
-	RFX_PROGRESSIVE_TILE* tile;
 } PROGRESSIVE_TILE_PROCESS_WORK_PARAM;
 
 struct S_PROGRESSIVE_BLOCK_REGION
@@ -227,9 +228,10 @@ struct S_PROGRESSIVE_CONTEXT
 	wLog* log;
 	wStream* buffer;
 	wStream* rects;
+	wStream* tiles;
+	BYTE* srlBuffer;
+	BYTE* rawBuffer;
 	RFX_CONTEXT* rfx_context;
-	PROGRESSIVE_TILE_PROCESS_WORK_PARAM params[0x10000];
-	PTP_WORK work_objects[0x10000];
 };
 
 #endif /* INTERNAL_CODEC_PROGRESSIVE_H */
@@ -250,9 +250,12 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 	 * Additionally we add 32 bytes (16 in front and 16 at the back of the buffer)
 	 * in order to allow optimized functions (SEE, NEON) to read from positions
 	 * that are actually in front/beyond the buffer. Offset calculations are
-	 * performed at the BufferPool_Take function calls in rfx_encode/decode.c.
+	 * performed in rfx_encode/decode.c.
 	 *
 	 * We then multiply by 3 to use a single, partionned buffer for all 3 channels.
+	 * The pool provides the encoded tile data, the scratch buffers used while
+	 * decoding or encoding a tile (RFX_TILE_ARENA_SIZE, the 3 channels followed by
+	 * the dwt_buffer) are owned by the workers of priv->WorkGroup.
 	 */
 	priv->BufferPool = BufferPool_New(TRUE, (8192ULL + 32ULL) * 3ULL, 16);
 
@@ -296,6 +299,10 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 			goto fail;
 	}
 
+	priv->WorkGroup = codec_work_group_new(priv->UseThreads, RFX_TILE_ARENA_SIZE);
+	if (!priv->WorkGroup)
+		goto fail;
+
 	/* initialize the default pixel format */
 	rfx_context_set_pixel_format(context, PIXEL_FORMAT_BGRX32);
 	/* create profilers for default decoding routines */
@@ -344,10 +351,9 @@ void rfx_context_free(RFX_CONTEXT* context)
 	if (priv)
 	{
 		ObjectPool_Free(priv->TilePool);
+		codec_work_group_free(priv->WorkGroup);
 		if (priv->UseThreads)
 		{
-			winpr_aligned_free((void*)priv->workObjects);
-			winpr_aligned_free(priv->tileWorkParams);
 #ifdef WITH_PROFILER
 			WLog_VRB(
 			    TAG,
@@ -769,21 +775,27 @@ static inline BOOL rfx_process_message_region(RFX_CONTEXT* WINPR_RESTRICT contex
 
 typedef struct
 {
-	RFX_TILE* tile;
 	RFX_CONTEXT* context;
+	RFX_MESSAGE* message;
 } RFX_TILE_PROCESS_WORK_PARAM;
 
-static inline void CALLBACK
-rfx_process_message_tile_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
-                                       void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+static BOOL rfx_process_message_tile_work(void* context, size_t index,
+                                          BYTE* WINPR_RESTRICT arena)
 {
 	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*)context;
 	WINPR_ASSERT(param);
 	WINPR_ASSERT(param->context);
 	WINPR_ASSERT(param->context->priv);
+	WINPR_ASSERT(param->message);
+	WINPR_ASSERT(index < param->message->numTiles);
 
-	if (!rfx_decode_rgb(param->context, param->tile, param->tile->data, 64 * 4))
+	const RFX_TILE* tile = param->message->tiles[index];
+	if (!rfx_decode_rgb(param->context, tile, tile->data, 64 * 4, arena))
+	{
 		WLog_Print(param->context->priv->log, WLOG_ERROR, "rfx_decode_rgb failed");
+		return FALSE;
+	}
+	return TRUE;
 }
 
 static inline BOOL rfx_allocate_tiles(RFX_MESSAGE* WINPR_RESTRICT message, size_t count,
@@ -814,7 +826,6 @@ static inline BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
                                                UINT16* WINPR_RESTRICT pExpectedBlockType)
 {
 	BOOL rc = 0;
-	size_t close_cnt = 0;
 	BYTE quant = 0;
 	RFX_TILE* tile = nullptr;
 	UINT32* quants = nullptr;
@@ -823,8 +834,6 @@ static inline BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 	UINT32 blockLen = 0;
 	UINT32 blockType = 0;
 	UINT32 tilesDataSize = 0;
-	PTP_WORK* work_objects = nullptr;
-	RFX_TILE_PROCESS_WORK_PARAM* params = nullptr;
 	void* pmem = nullptr;
 
 	WINPR_ASSERT(context);
@@ -918,27 +927,7 @@ static inline BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 	if (!rfx_allocate_tiles(message, numTiles, FALSE))
 		return FALSE;
 
-	if (context->priv->UseThreads)
-	{
-		work_objects = (PTP_WORK*)winpr_aligned_calloc(message->numTiles, sizeof(PTP_WORK), 32);
-		params = (RFX_TILE_PROCESS_WORK_PARAM*)winpr_aligned_recalloc(
-		    nullptr, message->numTiles, sizeof(RFX_TILE_PROCESS_WORK_PARAM), 32);
-
-		if (!work_objects)
-		{
-			winpr_aligned_free(params);
-			return FALSE;
-		}
-
-		if (!params)
-		{
-			winpr_aligned_free((void*)work_objects);
-			return FALSE;
-		}
-	}
-
 	/* tiles */
-	close_cnt = 0;
 	rc = FALSE;
 
 	if (Stream_GetRemainingLength(s) >= tilesDataSize)
@@ -1052,52 +1041,17 @@ static inline BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 			}
 			tile->x = tile->xIdx * 64;
 			tile->y = tile->yIdx * 64;
-
-			if (context->priv->UseThreads)
-			{
-				if (!params)
-				{
-					rc = FALSE;
-					break;
-				}
-
-				params[i].context = context;
-				params[i].tile = message->tiles[i];
-
-				if (!(work_objects[i] = CreateThreadpoolWork(rfx_process_message_tile_work_callback,
-				                                             (void*)&params[i], nullptr)))
-				{
-					WLog_Print(context->priv->log, WLOG_ERROR, "CreateThreadpoolWork failed.");
-					rc = FALSE;
-					break;
-				}
-
-				SubmitThreadpoolWork(work_objects[i]);
-				close_cnt = i + 1;
-			}
-			else
-			{
-				if (!rfx_decode_rgb(context, tile, tile->data, 64 * 4))
-				{
-					rc = FALSE;
-					break;
-				}
-			}
 		}
 	}
 
-	if (context->priv->UseThreads)
+	/* all tiles are parsed, decode them as a single batch */
+	if (rc)
 	{
-		for (size_t i = 0; i < close_cnt; i++)
-		{
-			WaitForThreadpoolWorkCallbacks(work_objects[i], FALSE);
-			CloseThreadpoolWork(work_objects[i]);
-		}
+		RFX_TILE_PROCESS_WORK_PARAM param = { .context = context, .message = message };
+		rc = codec_work_group_run(context->priv->WorkGroup, message->numTiles,
+		                          rfx_process_message_tile_work, &param);
 	}
 
-	winpr_aligned_free((void*)work_objects);
-	winpr_aligned_free(params);
-
 	for (size_t i = 0; i < message->numTiles; i++)
 	{
 		if (!(tile = message->tiles[i]))
@@ -1577,23 +1531,22 @@ static inline BOOL rfx_write_tile(wStream* WINPR_RESTRICT s, const RFX_TILE* WIN
 	return TRUE;
 }
 
-struct S_RFX_TILE_COMPOSE_WORK_PARAM
+static BOOL rfx_compose_message_tile_work(void* context, size_t index,
+                                          BYTE* WINPR_RESTRICT arena)
 {
-	RFX_TILE* tile;
-	RFX_CONTEXT* context;
-};
-
-static inline void CALLBACK
-rfx_compose_message_tile_work_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
-                                       void* context, WINPR_ATTR_UNUSED PTP_WORK work)
-{
-	RFX_TILE_COMPOSE_WORK_PARAM* param = (RFX_TILE_COMPOSE_WORK_PARAM*)context;
+	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*)context;
 	WINPR_ASSERT(param);
 	WINPR_ASSERT(param->context);
 	WINPR_ASSERT(param->context->priv);
+	WINPR_ASSERT(param->message);
+	WINPR_ASSERT(index < param->message->numTiles);
 
-	if (!rfx_encode_rgb(param->context, param->tile))
+	if (!rfx_encode_rgb(param->context, param->message->tiles[index], arena))
+	{
 		WLog_Print(param->context->priv->log, WLOG_ERROR, "rfx_encode_rgb failed");
+		return FALSE;
+	}
+	return TRUE;
 }
 
 static inline BOOL computeRegion(const RFX_RECT* WINPR_RESTRICT rects, size_t numRects,
@@ -1621,31 +1574,6 @@ static inline BOOL computeRegion(const RFX_RECT* WINPR_RESTRICT rects, size_t nu
 
 #define TILE_NO(v) ((v) / 64)
 
-static inline BOOL setupWorkers(RFX_CONTEXT* WINPR_RESTRICT context, size_t nbTiles)
-{
-	WINPR_ASSERT(context);
-
-	RFX_CONTEXT_PRIV* priv = context->priv;
-	WINPR_ASSERT(priv);
-
-	void* pmem = nullptr;
-
-	if (!context->priv->UseThreads)
-		return TRUE;
-
-	if (!(pmem = winpr_aligned_recalloc((void*)priv->workObjects, nbTiles, sizeof(PTP_WORK), 32)))
-		return FALSE;
-
-	priv->workObjects = (PTP_WORK*)pmem;
-
-	if (!(pmem = winpr_aligned_recalloc(priv->tileWorkParams, nbTiles,
-	                                    sizeof(RFX_TILE_COMPOSE_WORK_PARAM), 32)))
-		return FALSE;
-
-	priv->tileWorkParams = (RFX_TILE_COMPOSE_WORK_PARAM*)pmem;
-	return TRUE;
-}
-
 static inline BOOL rfx_ensure_tiles(RFX_MESSAGE* WINPR_RESTRICT message, size_t count)
 {
 	WINPR_ASSERT(message);
@@ -1665,8 +1593,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	const UINT32 height = h;
 	const UINT32 scanline = (UINT32)s;
 	RFX_MESSAGE* message = nullptr;
-	PTP_WORK* workObject = nullptr;
-	RFX_TILE_COMPOSE_WORK_PARAM* workParam = nullptr;
 	BOOL success = FALSE;
 	REGION16 rectsRegion = WINPR_C_ARRAY_INIT;
 	REGION16 tilesRegion = WINPR_C_ARRAY_INIT;
@@ -1725,15 +1651,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 
 			if (!rfx_ensure_tiles(message, maxNbTiles))
 				goto skip_encoding_loop;
-
-			if (!setupWorkers(context, maxNbTiles))
-				goto skip_encoding_loop;
-		}
-
-		if (context->priv->UseThreads)
-		{
-			workObject = context->priv->workObjects;
-			workParam = context->priv->tileWorkParams;
 		}
 
 		{
@@ -1833,28 +1750,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 							goto skip_encoding_loop;
 						message->tiles[message->numTiles++] = tile;
 
-						if (context->priv->UseThreads)
-						{
-							workParam->context = context;
-							workParam->tile = tile;
-
-							if (!(*workObject =
-							          CreateThreadpoolWork(rfx_compose_message_tile_work_callback,
-							                               (void*)workParam, nullptr)))
-							{
-								goto skip_encoding_loop;
-							}
-
-							SubmitThreadpoolWork(*workObject);
-							workObject++;
-							workParam++;
-						}
-						else
-						{
-							if (!rfx_encode_rgb(context, tile))
-								goto skip_encoding_loop;
-						}
-
 						if (!region16_union_rect(&tilesRegion, &tilesRegion, &currentTileRect))
 							goto skip_encoding_loop;
 					} /* xIdx */
@@ -1863,28 +1758,22 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 		}
 	}
 
+	{
+		RFX_TILE_PROCESS_WORK_PARAM param = { .context = context, .message = message };
+		if (!codec_work_group_run(context->priv->WorkGroup, message->numTiles,
+		                          rfx_compose_message_tile_work, &param))
+			goto skip_encoding_loop;
+	}
+
 	success = TRUE;
 skip_encoding_loop:
 
-	/* when using threads ensure all computations are done */
 	if (success)
 	{
 		message->tilesDataSize = 0;
-		workObject = context->priv->workObjects;
 
 		for (UINT32 i = 0; i < message->numTiles; i++)
 		{
-			if (context->priv->UseThreads)
-			{
-				if (*workObject)
-				{
-					WaitForThreadpoolWorkCallbacks(*workObject, FALSE);
-					CloseThreadpoolWork(*workObject);
-				}
-
-				workObject++;
-			}
-
 			const RFX_TILE* tile = message->tiles[i];
 			const size_t tlen = rfx_tile_length(tile);
 			message->tilesDataSize += WINPR_ASSERTING_INT_CAST(uint32_t, tlen);
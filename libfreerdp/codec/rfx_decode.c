@@ -39,10 +39,9 @@ WINPR_ATTR_NODISCARD
 static inline BOOL rfx_decode_component(RFX_CONTEXT* WINPR_RESTRICT context,
                                         const UINT32* WINPR_RESTRICT quantization_values,
                                         size_t nrQuantValues, const BYTE* WINPR_RESTRICT data,
-                                        size_t size, INT16* WINPR_RESTRICT buffer)
+                                        size_t size, INT16* WINPR_RESTRICT buffer,
+                                        INT16* WINPR_RESTRICT dwt_buffer)
 {
-	BOOL res = FALSE;
-	INT16* dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
 	WINPR_ASSERT(dwt_buffer);
 
 	PROFILER_ENTER(context->priv->prof_rfx_decode_component)
@@ -54,7 +53,7 @@ static inline BOOL rfx_decode_component(RFX_CONTEXT* WINPR_RESTRICT context,
 		if (rc < 0)
 		{
 			WLog_Print(context->priv->log, WLOG_ERROR, "context->rlgr_decode failed: %d", rc);
-			goto fail;
+			return FALSE;
 		}
 	}
 
@@ -64,24 +63,20 @@ static inline BOOL rfx_decode_component(RFX_CONTEXT* WINPR_RESTRICT context,
 	PROFILER_EXIT(context->priv->prof_rfx_differential_decode)
 	PROFILER_ENTER(context->priv->prof_rfx_quantization_decode)
 	if (!context->quantization_decode(buffer, quantization_values, nrQuantValues))
-		goto fail;
+		return FALSE;
 	PROFILER_EXIT(context->priv->prof_rfx_quantization_decode)
 	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_decode)
 	context->dwt_2d_decode(buffer, dwt_buffer);
 	PROFILER_EXIT(context->priv->prof_rfx_dwt_2d_decode)
 	PROFILER_EXIT(context->priv->prof_rfx_decode_component)
-
-	res = TRUE;
-fail:
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
-	return res;
+	return TRUE;
 }
 
 /* rfx_decode_ycbcr_to_rgb code now resides in the primitives library. */
 
 /* stride is bytes between rows in the output buffer. */
 BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_RESTRICT tile,
-                    BYTE* WINPR_RESTRICT rgb_buffer, UINT32 stride)
+                    BYTE* WINPR_RESTRICT rgb_buffer, UINT32 stride, BYTE* WINPR_RESTRICT arena)
 {
 	union
 	{
@@ -89,7 +84,6 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_R
 		INT16** pv;
 	} cnv;
 	BOOL rc = FALSE;
-	BYTE* pBuffer = nullptr;
 	INT16* pSrcDst[3];
 	UINT32* y_quants = nullptr;
 	UINT32* cb_quants = nullptr;
@@ -100,18 +94,19 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_R
 	y_quants = context->quants + (NR_QUANT_VALUES * tile->quantIdxY);
 	cb_quants = context->quants + (NR_QUANT_VALUES * tile->quantIdxCb);
 	cr_quants = context->quants + (NR_QUANT_VALUES * tile->quantIdxCr);
-	pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1);
-	pSrcDst[0] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 0ULL) + 16ULL]));        /* y_r_buffer */
-	pSrcDst[1] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 1ULL) + 16ULL]));        /* cb_g_buffer */
-	pSrcDst[2] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 2ULL) + 16ULL]));        /* cr_b_buffer */
+	WINPR_ASSERT(arena);
+	pSrcDst[0] = (INT16*)((&arena[((8192ULL + 32ULL) * 0ULL) + 16ULL])); /* y_r_buffer */
+	pSrcDst[1] = (INT16*)((&arena[((8192ULL + 32ULL) * 1ULL) + 16ULL])); /* cb_g_buffer */
+	pSrcDst[2] = (INT16*)((&arena[((8192ULL + 32ULL) * 2ULL) + 16ULL])); /* cr_b_buffer */
+	INT16* dwt_buffer = (INT16*)(&arena[RFX_TILE_BUFFER_SIZE]);
 	if (!rfx_decode_component(context, y_quants, NR_QUANT_VALUES, tile->YData, tile->YLen,
-	                          pSrcDst[0])) /* YData */
+	                          pSrcDst[0], dwt_buffer)) /* YData */
 		goto fail;
 	if (!rfx_decode_component(context, cb_quants, NR_QUANT_VALUES, tile->CbData, tile->CbLen,
-	                          pSrcDst[1])) /* CbData */
+	                          pSrcDst[1], dwt_buffer)) /* CbData */
 		goto fail;
 	if (!rfx_decode_component(context, cr_quants, NR_QUANT_VALUES, tile->CrData, tile->CrLen,
-	                          pSrcDst[2])) /* CrData */
+	                          pSrcDst[2], dwt_buffer)) /* CrData */
 		goto fail;
 	PROFILER_ENTER(context->priv->prof_rfx_ycbcr_to_rgb)
 
@@ -125,6 +120,5 @@ BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, const RFX_TILE* WINPR_R
 
 	rc = TRUE;
 fail:
-	BufferPool_Return(context->priv->BufferPool, pBuffer);
 	return rc;
 }
@@ -25,10 +25,12 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
-/* stride is bytes between rows in the output buffer. */
+/* stride is bytes between rows in the output buffer.
+ * arena is RFX_TILE_ARENA_SIZE bytes of 32 byte aligned scratch memory. */
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BOOL rfx_decode_rgb(RFX_CONTEXT* WINPR_RESTRICT context,
                                   const RFX_TILE* WINPR_RESTRICT tile,
-                                  BYTE* WINPR_RESTRICT rgb_buffer, UINT32 stride);
+                                  BYTE* WINPR_RESTRICT rgb_buffer, UINT32 stride,
+                                  BYTE* WINPR_RESTRICT arena);
 
 #endif /* FREERDP_LIB_CODEC_RFX_DECODE_H */
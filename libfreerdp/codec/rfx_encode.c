@@ -227,19 +227,49 @@ static void rfx_encode_format_rgb(const BYTE* WINPR_RESTRICT rgb_data, uint32_t
 	}
 }
 
+BOOL rfx_encode_rgb_to_ycbcr(RFX_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT data,
+                             UINT32 width, UINT32 height, UINT32 scanline,
+                             INT16* pSrcDst[3])
+{
+	union
+	{
+		const INT16** cpv;
+		INT16** pv;
+	} cnv;
+	BOOL rc = TRUE;
+	const primitives_t* prims = primitives_get();
+	static const prim_size_t roi_64x64 = { 64, 64 };
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(data);
+	WINPR_ASSERT(pSrcDst);
+
+	PROFILER_ENTER(context->priv->prof_rfx_encode_format_rgb)
+	rfx_encode_format_rgb(data, width, height, scanline, context->pixel_format, context->palette,
+	                      pSrcDst[0], pSrcDst[1], pSrcDst[2]);
+	PROFILER_EXIT(context->priv->prof_rfx_encode_format_rgb)
+	PROFILER_ENTER(context->priv->prof_rfx_rgb_to_ycbcr)
+
+	cnv.pv = pSrcDst;
+	if (prims->RGBToYCbCr_16s16s_P3P3(cnv.cpv, 64 * sizeof(INT16), pSrcDst, 64 * sizeof(INT16),
+	                                  &roi_64x64) != PRIMITIVES_SUCCESS)
+		rc = FALSE;
+
+	PROFILER_EXIT(context->priv->prof_rfx_rgb_to_ycbcr)
+	return rc;
+}
+
 /* rfx_encode_rgb_to_ycbcr code now resides in the primitives library. */
 WINPR_ATTR_NODISCARD
 static BOOL rfx_encode_component(RFX_CONTEXT* WINPR_RESTRICT context,
                                  const UINT32* WINPR_RESTRICT quantization_values,
                                  size_t nrQuantValues, INT16* WINPR_RESTRICT data,
                                  BYTE* WINPR_RESTRICT buffer, uint32_t buffer_size,
-                                 uint32_t* WINPR_RESTRICT size)
+                                 INT16* WINPR_RESTRICT dwt_buffer, uint32_t* WINPR_RESTRICT size)
 {
 	BOOL res = FALSE;
 	int rc = -1;
-	INT16* dwt_buffer = BufferPool_Take(context->priv->BufferPool, -1); /* dwt_buffer */
-	if (!dwt_buffer)
-		return FALSE;
+	WINPR_ASSERT(dwt_buffer);
 
 	PROFILER_ENTER(context->priv->prof_rfx_encode_component)
 	PROFILER_ENTER(context->priv->prof_rfx_dwt_2d_encode)
@@ -263,51 +293,33 @@ static BOOL rfx_encode_component(RFX_CONTEXT* WINPR_RESTRICT context,
 	res = TRUE;
 
 fail:
-	BufferPool_Return(context->priv->BufferPool, dwt_buffer);
-
 	*size = WINPR_ASSERTING_INT_CAST(uint32_t, rc);
 	return res;
 }
 
-BOOL rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRICT tile)
+BOOL rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRICT tile,
+                    BYTE* WINPR_RESTRICT arena)
 {
 	BOOL rc = FALSE;
-	union
-	{
-		const INT16** cpv;
-		INT16** pv;
-	} cnv;
 	INT16* pSrcDst[3] = WINPR_C_ARRAY_INIT;
 	uint32_t CbLen = 0;
 	uint32_t CrLen = 0;
-	primitives_t* prims = primitives_get();
-	static const prim_size_t roi_64x64 = { 64, 64 };
 
-	BYTE* pBuffer = (BYTE*)BufferPool_Take(context->priv->BufferPool, -1);
-	if (!pBuffer)
-		return FALSE;
+	WINPR_ASSERT(arena);
 
 	uint32_t YLen = CbLen = CrLen = 0;
 	UINT32* YQuant = context->quants + (NR_QUANT_VALUES * tile->quantIdxY);
 	UINT32* CbQuant = context->quants + (NR_QUANT_VALUES * tile->quantIdxCb);
 	UINT32* CrQuant = context->quants + (NR_QUANT_VALUES * tile->quantIdxCr);
-	pSrcDst[0] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 0ULL) + 16ULL])); /* y_r_buffer */
-	pSrcDst[1] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 1ULL) + 16ULL])); /* cb_g_buffer */
-	pSrcDst[2] = (INT16*)((&pBuffer[((8192ULL + 32ULL) * 2ULL) + 16ULL])); /* cr_b_buffer */
+	pSrcDst[0] = (INT16*)((&arena[((8192ULL + 32ULL) * 0ULL) + 16ULL])); /* y_r_buffer */
+	pSrcDst[1] = (INT16*)((&arena[((8192ULL + 32ULL) * 1ULL) + 16ULL])); /* cb_g_buffer */
+	pSrcDst[2] = (INT16*)((&arena[((8192ULL + 32ULL) * 2ULL) + 16ULL])); /* cr_b_buffer */
+	INT16* dwt_buffer = (INT16*)(&arena[RFX_TILE_BUFFER_SIZE]);
 	PROFILER_ENTER(context->priv->prof_rfx_encode_rgb)
-	PROFILER_ENTER(context->priv->prof_rfx_encode_format_rgb)
-	rfx_encode_format_rgb(tile->data, tile->width, tile->height, tile->scanline,
-	                      context->pixel_format, context->palette, pSrcDst[0], pSrcDst[1],
-	                      pSrcDst[2]);
-	PROFILER_EXIT(context->priv->prof_rfx_encode_format_rgb)
-	PROFILER_ENTER(context->priv->prof_rfx_rgb_to_ycbcr)
-
-	cnv.pv = pSrcDst;
-	if (prims->RGBToYCbCr_16s16s_P3P3(cnv.cpv, 64 * sizeof(INT16), pSrcDst, 64 * sizeof(INT16),
-	                                  &roi_64x64) != PRIMITIVES_SUCCESS)
+	if (!rfx_encode_rgb_to_ycbcr(context, tile->data, tile->width, tile->height, tile->scanline,
+	                             pSrcDst))
 		goto fail;
 
-	PROFILER_EXIT(context->priv->prof_rfx_rgb_to_ycbcr)
 	/**
 	 * We need to clear the buffers as the RLGR encoder expects it to be initialized to zero.
 	 * This allows simplifying and improving the performance of the encoding process.
@@ -316,13 +328,13 @@ BOOL rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRIC
 	ZeroMemory(tile->CbData, 4096);
 	ZeroMemory(tile->CrData, 4096);
 	if (!rfx_encode_component(context, YQuant, NR_QUANT_VALUES, pSrcDst[0], tile->YData, 4096,
-	                          &YLen))
+	                          dwt_buffer, &YLen))
 		goto fail;
 	if (!rfx_encode_component(context, CbQuant, NR_QUANT_VALUES, pSrcDst[1], tile->CbData, 4096,
-	                          &CbLen))
+	                          dwt_buffer, &CbLen))
 		goto fail;
 	if (!rfx_encode_component(context, CrQuant, NR_QUANT_VALUES, pSrcDst[2], tile->CrData, 4096,
-	                          &CrLen))
+	                          dwt_buffer, &CrLen))
 		goto fail;
 	tile->YLen = WINPR_ASSERTING_INT_CAST(UINT16, YLen);
 	tile->CbLen = WINPR_ASSERTING_INT_CAST(UINT16, CbLen);
@@ -332,7 +344,5 @@ BOOL rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context, RFX_TILE* WINPR_RESTRIC
 
 fail:
 	PROFILER_EXIT(context->priv->prof_rfx_encode_rgb)
-	if (!BufferPool_Return(context->priv->BufferPool, pBuffer))
-		return FALSE;
 	return rc;
 }
@@ -23,8 +23,19 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+/* arena is RFX_TILE_ARENA_SIZE bytes of 32 byte aligned scratch memory. */
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BOOL rfx_encode_rgb(RFX_CONTEXT* WINPR_RESTRICT context,
-                                  RFX_TILE* WINPR_RESTRICT tile);
+                                  RFX_TILE* WINPR_RESTRICT tile, BYTE* WINPR_RESTRICT arena);
+
+/** Convert a \b width x \b height pixel tile to 64x64 planar YCbCr
+ *
+ *  Tiles smaller than 64x64 are padded by repeating the last row and column.
+ */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL BOOL rfx_encode_rgb_to_ycbcr(RFX_CONTEXT* WINPR_RESTRICT context,
+                                           const BYTE* WINPR_RESTRICT data, UINT32 width,
+                                           UINT32 height, UINT32 scanline,
+                                           INT16* pSrcDst[3]);
 
 #endif /* FREERDP_LIB_CODEC_RFX_ENCODE_H */
@@ -40,6 +40,14 @@
 
 #include "rfx_rlgr.h"
 
+#include "../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED) && \
+    (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define RLGR_SSE2_ZERO_SCAN
+#endif
+
 /* Constants used in RLGR1/RLGR3 algorithm */
 #define KPMAX (80) /* max value for kp or krp */
 #define LSGR (3)   /* shift count to convert kp to k */
@@ -84,8 +92,14 @@ static inline uint32_t UpdateParam(uint32_t* param, int32_t deltaP)
 	return (*param) >> LSGR;
 }
 
+/* Number of zero run steps after which kp is saturated at KPMAX, whatever it started at */
+#define RLGR_RUN_STEPS (KPMAX / UP_GR)
+
 static BOOL g_LZCNT = FALSE;
 
+/* Run length represented by n zero bits in RL mode, starting at a given kp */
+static UINT16 g_RunLength[KPMAX + 1][RLGR_RUN_STEPS + 1] = WINPR_C_ARRAY_INIT;
+
 static INIT_ONCE rfx_rlgr_init_once = INIT_ONCE_STATIC_INIT;
 
 static BOOL CALLBACK rfx_rlgr_init(PINIT_ONCE once, PVOID param, PVOID* context)
@@ -95,6 +109,19 @@ static BOOL CALLBACK rfx_rlgr_init(PINIT_ONCE once, PVOID param, PVOID* context)
 	WINPR_UNUSED(context);
 
 	g_LZCNT = IsProcessorFeaturePresentEx(PF_EX_LZCNT);
+
+	for (UINT32 kp = 0; kp <= KPMAX; kp++)
+	{
+		UINT32 p = kp;
+		UINT32 run = 0;
+
+		for (UINT32 n = 1; n <= RLGR_RUN_STEPS; n++)
+		{
+			run += 1u << (p >> LSGR);
+			p = MIN(p + UP_GR, KPMAX);
+			g_RunLength[kp][n] = WINPR_ASSERTING_INT_CAST(UINT16, run);
+		}
+	}
 	return TRUE;
 }
 
@@ -149,8 +176,8 @@ static inline UINT32 lzcnt_s(UINT32 x)
 	return __lzcnt(x);
 }
 
-int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
-                    INT16* WINPR_RESTRICT pDstData, UINT32 rDstSize)
+int rfx_rlgr_decode_reference(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData,
+                              UINT32 SrcSize, INT16* WINPR_RESTRICT pDstData, UINT32 rDstSize)
 {
 	uint32_t vk = 0;
 	size_t run = 0;
@@ -653,8 +680,8 @@ static void rfx_rlgr_code_gr(RFX_BITSTREAM* bs, uint32_t* krp, UINT32 val)
 	}
 }
 
-int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 data_size,
-                    BYTE* WINPR_RESTRICT buffer, UINT32 buffer_size)
+int rfx_rlgr_encode_reference(RLGR_MODE mode, const INT16* WINPR_RESTRICT data,
+                              UINT32 data_size, BYTE* WINPR_RESTRICT buffer, UINT32 buffer_size)
 {
 	RFX_BITSTREAM* bs = (RFX_BITSTREAM*)winpr_aligned_calloc(1, sizeof(RFX_BITSTREAM), 32);
 
@@ -790,3 +817,500 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 
 	return WINPR_ASSERTING_INT_CAST(int, processed_size);
 }
+
+/*
+ * Word at a time bit reader for the table driven decoder.
+ * The unconsumed bits are kept left aligned in value, count of them are valid.
+ */
+typedef struct
+{
+	const BYTE* data;
+	size_t length;
+	size_t position;
+	UINT64 value;
+	UINT32 count;
+} RLGR_BIT_READER;
+
+/* value must not be 0 */
+static inline UINT32 rlgr_clz64(UINT64 value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (UINT32)__builtin_clzll(value);
+#else
+	const UINT32 hi = (UINT32)(value >> 32);
+	if (hi)
+		return lzcnt_s(hi);
+	return 32 + lzcnt_s((UINT32)value);
+#endif
+}
+
+static inline UINT64 rlgr_load_be64(const BYTE* WINPR_RESTRICT data)
+{
+	UINT64 value = 0;
+	memcpy(&value, data, sizeof(value));
+#if defined(__BIG_ENDIAN__)
+	return value;
+#else
+	return _byteswap_uint64(value);
+#endif
+}
+
+/* Refill the reader, there are at least 56 bits available afterwards unless the input ends */
+static inline void rlgr_reader_refill(RLGR_BIT_READER* WINPR_RESTRICT br)
+{
+	if (br->count > 56)
+		return;
+
+	if (br->length - br->position >= sizeof(UINT64))
+	{
+		/* the partially consumed last byte is loaded again with the next refill */
+		br->value |= rlgr_load_be64(&br->data[br->position]) >> br->count;
+		br->position += (63 - br->count) >> 3;
+		br->count |= 56;
+	}
+	else
+	{
+		while ((br->count <= 55) && (br->position < br->length))
+		{
+			br->value |= ((UINT64)br->data[br->position++]) << (56 - br->count);
+			br->count += 8;
+		}
+	}
+}
+
+/* Number of bits left in the input, exact if less than 56 */
+static inline UINT32 rlgr_reader_available(RLGR_BIT_READER* WINPR_RESTRICT br)
+{
+	rlgr_reader_refill(br);
+	return br->count;
+}
+
+static inline void rlgr_reader_skip(RLGR_BIT_READER* WINPR_RESTRICT br, UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= br->count);
+	br->value <<= nbits;
+	br->count -= nbits;
+}
+
+static inline UINT32 rlgr_reader_read(RLGR_BIT_READER* WINPR_RESTRICT br, UINT32 nbits)
+{
+	if (nbits == 0)
+		return 0;
+
+	const UINT32 bits = (UINT32)(br->value >> (64 - nbits));
+	rlgr_reader_skip(br, nbits);
+	return bits;
+}
+
+/* Consume and count the leading zero (or one) bits, stops at the end of the input */
+static inline UINT32 rlgr_reader_count(RLGR_BIT_READER* WINPR_RESTRICT br, BOOL ones)
+{
+	UINT32 total = 0;
+
+	while (rlgr_reader_available(br) > 0)
+	{
+		const UINT64 value = ones ? ~br->value : br->value;
+		const UINT32 n = MIN(value ? rlgr_clz64(value) : 64, br->count);
+
+		rlgr_reader_skip(br, n);
+		total += n;
+
+		/* the terminating bit is in the buffer */
+		if (br->count > 0)
+			break;
+	}
+
+	return total;
+}
+
+/* Read the unary and remainder part of a GR code and update the kr, krp params */
+static inline BOOL rlgr_reader_gr(RLGR_BIT_READER* WINPR_RESTRICT br, UINT32* WINPR_RESTRICT krp,
+                                  UINT32* WINPR_RESTRICT kr, UINT16* WINPR_RESTRICT code)
+{
+	const UINT32 vk = rlgr_reader_count(br, TRUE);
+
+	if (rlgr_reader_available(br) < 1)
+		return FALSE;
+	rlgr_reader_skip(br, 1);
+
+	if (rlgr_reader_available(br) < *kr)
+		return FALSE;
+
+	/* the code is 16 bit wide, just like with the reference implementation */
+	*code = (UINT16)(rlgr_reader_read(br, *kr) | (vk << *kr));
+
+	if (!vk)
+		*krp = (*krp > 2) ? *krp - 2 : 0;
+	else if (vk != 1)
+		*krp = MIN(*krp + vk, KPMAX);
+
+	*kr = *krp >> LSGR;
+	return TRUE;
+}
+
+/* Run length of vk zero bits in RL mode, updates kp */
+static inline size_t rlgr_run_length(UINT32* WINPR_RESTRICT kp, UINT32 vk)
+{
+	if (vk <= RLGR_RUN_STEPS)
+	{
+		const size_t run = g_RunLength[*kp][vk];
+		*kp = MIN(*kp + vk * UP_GR, KPMAX);
+		return run;
+	}
+
+	const size_t run = g_RunLength[*kp][RLGR_RUN_STEPS];
+	*kp = KPMAX;
+	return run + ((size_t)(vk - RLGR_RUN_STEPS) << (KPMAX >> LSGR));
+}
+
+static inline INT16 rlgr_two_mag_sign(UINT32 value)
+{
+	/* value = 2 * mag - sign */
+	if (value & 1)
+		return (INT16)(-(INT16)((value + 1) >> 1));
+	return (INT16)(value >> 1);
+}
+
+int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                    INT16* WINPR_RESTRICT pDstData, UINT32 rDstSize)
+{
+	UINT32 kp = 1u << LSGR;
+	UINT32 k = kp >> LSGR;
+	UINT32 krp = 1u << LSGR;
+	UINT32 kr = krp >> LSGR;
+	size_t offset = 0;
+
+	if (!InitOnceExecuteOnce(&rfx_rlgr_init_once, rfx_rlgr_init, nullptr, nullptr))
+		return -1;
+
+	if ((mode != RLGR1) && (mode != RLGR3))
+		mode = RLGR1;
+
+	if (!pSrcData || !SrcSize)
+		return -1;
+
+	if (!pDstData || !rDstSize)
+		return -1;
+
+	/* zero runs and zero symbols are skipped over below */
+	ZeroMemory(pDstData, sizeof(INT16) * rDstSize);
+
+	RLGR_BIT_READER br = {
+		.data = pSrcData, .length = SrcSize, .position = 0, .value = 0, .count = 0
+	};
+
+	while ((offset < rDstSize) && (rlgr_reader_available(&br) > 0))
+	{
+		UINT16 code = 0;
+
+		if (k)
+		{
+			/* Run-Length (RL) Mode */
+			const UINT32 vk = rlgr_reader_count(&br, FALSE);
+
+			if (rlgr_reader_available(&br) < 1)
+				break;
+			rlgr_reader_skip(&br, 1);
+
+			size_t run = rlgr_run_length(&kp, vk);
+			k = kp >> LSGR;
+
+			/* next k bits contain run length remainder */
+			if (rlgr_reader_available(&br) < k)
+				break;
+			run += rlgr_reader_read(&br, k);
+
+			if (rlgr_reader_available(&br) < 1)
+				break;
+			const UINT32 sign = rlgr_reader_read(&br, 1);
+
+			if (!rlgr_reader_gr(&br, &krp, &kr, &code))
+				break;
+
+			kp = (kp > DN_GR) ? kp - DN_GR : 0;
+			k = kp >> LSGR;
+
+			offset += MIN(run, rDstSize - offset);
+			if (offset < rDstSize)
+			{
+				const INT16 mag = (INT16)(code + 1);
+				pDstData[offset++] = sign ? (INT16)-mag : mag;
+			}
+		}
+		else
+		{
+			/* Golomb-Rice (GR) Mode */
+			if (!rlgr_reader_gr(&br, &krp, &kr, &code))
+				break;
+
+			if (mode == RLGR1)
+			{
+				if (!code)
+					kp = MIN(kp + UQ_GR, KPMAX);
+				else
+				{
+					kp = (kp > DQ_GR) ? kp - DQ_GR : 0;
+					pDstData[offset] = rlgr_two_mag_sign(code);
+				}
+				offset++;
+			}
+			else
+			{
+				/* codes above INT16_MAX are rejected by the reference implementation */
+				const UINT32 nIdx = code ? 32 - lzcnt_s(code) : 0;
+
+				if (rlgr_reader_available(&br) < nIdx)
+					break;
+
+				const UINT32 val1 = rlgr_reader_read(&br, nIdx);
+				const UINT32 val2 = code - val1;
+
+				if (val1 && val2)
+					kp = (kp > 2 * DQ_GR) ? kp - 2 * DQ_GR : 0;
+				else if (!val1 && !val2)
+					kp = MIN(kp + 2 * UQ_GR, KPMAX);
+
+				pDstData[offset++] = rlgr_two_mag_sign(val1);
+				if (offset < rDstSize)
+					pDstData[offset++] = rlgr_two_mag_sign(val2);
+			}
+
+			k = kp >> LSGR;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Word at a time bit writer for the encoder.
+ * Pending bits are kept right aligned in value, full 32 bit words are ORed into the output.
+ * Bits past the end of the output are dropped, position keeps counting.
+ */
+typedef struct
+{
+	BYTE* data;
+	size_t length;
+	size_t position;
+	UINT64 value;
+	UINT32 count;
+} RLGR_BIT_WRITER;
+
+static inline void rlgr_writer_store(RLGR_BIT_WRITER* WINPR_RESTRICT bw, UINT32 word,
+                                     size_t nbytes)
+{
+	for (size_t x = 0; x < nbytes; x++)
+	{
+		if (bw->position + x < bw->length)
+			bw->data[bw->position + x] |= (BYTE)(word >> (24 - 8 * x));
+	}
+	bw->position += nbytes;
+}
+
+/* Emit the lower nbits (at most 32) of bits */
+static inline void rlgr_writer_put(RLGR_BIT_WRITER* WINPR_RESTRICT bw, UINT32 nbits, UINT32 bits)
+{
+	WINPR_ASSERT(nbits <= 32);
+	WINPR_ASSERT((nbits == 32) || ((bits >> nbits) == 0));
+
+	bw->value = (bw->value << nbits) | bits;
+	bw->count += nbits;
+
+	if (bw->count >= 32)
+	{
+		bw->count -= 32;
+		rlgr_writer_store(bw, (UINT32)(bw->value >> bw->count), 4);
+	}
+}
+
+static inline void rlgr_writer_repeat(RLGR_BIT_WRITER* WINPR_RESTRICT bw, UINT32 count, BOOL one)
+{
+	const UINT32 bits = one ? UINT32_MAX : 0;
+
+	for (; count >= 32; count -= 32)
+		rlgr_writer_put(bw, 32, bits);
+
+	if (count > 0)
+		rlgr_writer_put(bw, count, bits >> (32 - count));
+}
+
+static inline size_t rlgr_writer_flush(RLGR_BIT_WRITER* WINPR_RESTRICT bw)
+{
+	/* rfx_bitstream_flush pads with as many zero bits as are used in the last byte,
+	 * which might add a trailing zero byte. Keep the output identical. */
+	const UINT32 pad = bw->count % 8;
+	if (pad)
+		rlgr_writer_put(bw, pad, 0);
+
+	if (bw->count > 0)
+	{
+		const UINT32 word = (UINT32)(bw->value << (32 - bw->count));
+		rlgr_writer_store(bw, word, (bw->count + 7) / 8);
+		bw->count = 0;
+	}
+
+	return MIN(bw->position, bw->length);
+}
+
+/* Outputs the Golomb/Rice encoding of a non-negative integer and updates krp */
+static inline void rlgr_writer_gr(RLGR_BIT_WRITER* WINPR_RESTRICT bw, UINT32* WINPR_RESTRICT krp,
+                                  UINT32 val)
+{
+	const UINT32 kr = *krp >> LSGR;
+	const UINT32 vk = val >> kr;
+	const UINT32 remainder = val & ((1u << kr) - 1);
+
+	/* unary part, terminating zero and remainder in a single word if possible */
+	if (vk + 1 + kr <= 32)
+		rlgr_writer_put(bw, vk + 1 + kr, (((1u << vk) - 1) << (kr + 1)) | remainder);
+	else
+	{
+		rlgr_writer_repeat(bw, vk, TRUE);
+		rlgr_writer_put(bw, 1 + kr, remainder);
+	}
+
+	if (vk == 0)
+		*krp = (*krp > 2) ? *krp - 2 : 0;
+	else if (vk > 1)
+		*krp = MIN(*krp + vk, KPMAX);
+}
+
+/* Returns the number of zero coefficients at the start of data */
+static inline size_t rlgr_zero_run(const INT16* WINPR_RESTRICT data, size_t count)
+{
+	size_t x = 0;
+
+#if defined(RLGR_SSE2_ZERO_SCAN)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 8 <= count; x += 8)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)(const void*)&data[x]);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) != 0xFFFF)
+			break;
+	}
+#else
+	for (; x + 4 <= count; x += 4)
+	{
+		UINT64 v = 0;
+		memcpy(&v, &data[x], sizeof(v));
+		if (v != 0)
+			break;
+	}
+#endif
+
+	while ((x < count) && (data[x] == 0))
+		x++;
+
+	return x;
+}
+
+static inline UINT32 rlgr_get_2magsign(INT16 input)
+{
+	const INT32 value = input;
+	return (UINT32)((value < 0) ? -2 * value - 1 : 2 * value);
+}
+
+int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 data_size,
+                    BYTE* WINPR_RESTRICT buffer, UINT32 buffer_size)
+{
+	RLGR_BIT_WRITER bw = {
+		.data = buffer, .length = buffer_size, .position = 0, .value = 0, .count = 0
+	};
+	UINT32 k = 1;
+	UINT32 kp = 1u << LSGR;
+	UINT32 krp = 1u << LSGR;
+	size_t offset = 0;
+
+	while (offset < data_size)
+	{
+		if (k)
+		{
+			/* RUN-LENGTH MODE */
+			UINT32 numZeros = 0;
+			INT16 input = 0;
+			const size_t zeros = rlgr_zero_run(&data[offset], data_size - offset);
+
+			if (offset + zeros < data_size)
+			{
+				numZeros = (UINT32)zeros;
+				input = data[offset + zeros];
+				offset += zeros + 1;
+			}
+			else
+			{
+				/* the last zero of the input is coded like a nonzero value */
+				numZeros = (UINT32)zeros - 1;
+				offset = data_size;
+			}
+
+			/* emit a zero bit for each full run, until kp saturates */
+			UINT32 zeroBits = 0;
+			while ((kp < KPMAX) && (numZeros >= (1u << k)))
+			{
+				numZeros -= 1u << k;
+				zeroBits++;
+				kp = MIN(kp + UP_GR, KPMAX);
+				k = kp >> LSGR;
+			}
+
+			if (numZeros >= (1u << k))
+			{
+				zeroBits += numZeros >> k;
+				numZeros &= (1u << k) - 1;
+			}
+
+			/* zero bits, the terminating 1 and the remaining run length using k bits */
+			if (zeroBits + 1 + k <= 32)
+				rlgr_writer_put(&bw, zeroBits + 1 + k, (1u << k) | numZeros);
+			else
+			{
+				rlgr_writer_repeat(&bw, zeroBits, FALSE);
+				rlgr_writer_put(&bw, 1 + k, (1u << k) | numZeros);
+			}
+
+			/* encode the nonzero value using GR coding */
+			const UINT32 mag = (UINT32)((input < 0) ? -input : input);
+			rlgr_writer_put(&bw, 1, (input < 0) ? 1 : 0);
+			rlgr_writer_gr(&bw, &krp, mag ? mag - 1 : 0);
+
+			kp = (kp > DN_GR) ? kp - DN_GR : 0;
+			k = kp >> LSGR;
+		}
+		else if (mode == RLGR1)
+		{
+			/* GOLOMB-RICE MODE, RLGR1 variant */
+			const UINT32 twoMs = rlgr_get_2magsign(data[offset++]);
+			rlgr_writer_gr(&bw, &krp, twoMs);
+
+			/* NOTE: as of Aug 2011, the algorithm is still wrongly documented
+			   and the update direction is reversed */
+			if (twoMs)
+				kp = (kp > DQ_GR) ? kp - DQ_GR : 0;
+			else
+				kp = MIN(kp + UQ_GR, KPMAX);
+			k = kp >> LSGR;
+		}
+		else
+		{
+			/* GOLOMB-RICE MODE, RLGR3 variant */
+			const UINT32 twoMs1 = rlgr_get_2magsign(data[offset++]);
+			const UINT32 twoMs2 = (offset < data_size) ? rlgr_get_2magsign(data[offset++]) : 0;
+			const UINT32 sum2Ms = twoMs1 + twoMs2;
+
+			rlgr_writer_gr(&bw, &krp, sum2Ms);
+
+			/* encode binary representation of the first input (twoMs1). */
+			if (sum2Ms)
+				rlgr_writer_put(&bw, 32 - lzcnt_s(sum2Ms), twoMs1);
+
+			if (twoMs1 && twoMs2)
+				kp = (kp > 2 * DQ_GR) ? kp - 2 * DQ_GR : 0;
+			else if (!twoMs1 && !twoMs2)
+				kp = MIN(kp + 2 * UQ_GR, KPMAX);
+			k = kp >> LSGR;
+		}
+	}
+
+	return WINPR_ASSERTING_INT_CAST(int, rlgr_writer_flush(&bw));
+}
@@ -23,13 +23,28 @@
 #include <freerdp/codec/rfx.h>
 #include <freerdp/api.h>
 
+/* Word-at-a-time encoder, bit-exact with rfx_rlgr_encode_reference.
+ * Bits are ORed into buffer, which is expected to be zero initialized. */
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data,
                                   UINT32 data_size, BYTE* WINPR_RESTRICT buffer,
                                   UINT32 buffer_size);
 
+/* Table driven decoder, produces the same output as rfx_rlgr_decode_reference. */
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData,
                                   UINT32 SrcSize, INT16* WINPR_RESTRICT pDstData, UINT32 rDstSize);
 
+/* Bit serial implementations following the [MS-RDPRFX] pseudocode,
+ * kept as reference for testing. */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL int rfx_rlgr_encode_reference(RLGR_MODE mode, const INT16* WINPR_RESTRICT data,
+                                            UINT32 data_size, BYTE* WINPR_RESTRICT buffer,
+                                            UINT32 buffer_size);
+
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL int rfx_rlgr_decode_reference(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData,
+                                            UINT32 SrcSize, INT16* WINPR_RESTRICT pDstData,
+                                            UINT32 rDstSize);
+
 #endif /* FREERDP_LIB_CODEC_RFX_RLGR_H */
@@ -31,6 +31,8 @@
 #include <freerdp/log.h>
 #include <freerdp/utils/profiler.h>
 
+#include "work_group.h"
+
 #define RFX_TAG FREERDP_TAG("codec.rfx")
 #ifdef WITH_DEBUG_RFX
 #define DEBUG_RFX(...) WLog_DBG(RFX_TAG, __VA_ARGS__)
@@ -57,7 +59,11 @@ typedef enum
 	RFX_STATE_FINAL
 } RFX_STATE;
 
-typedef struct S_RFX_TILE_COMPOSE_WORK_PARAM RFX_TILE_COMPOSE_WORK_PARAM;
+/* scratch memory needed to decode or encode a single tile:
+ * the three 64x64 INT16 component planes with 16 bytes of padding in front and behind each,
+ * followed by the DWT buffer. See rfx_context_new for details. */
+#define RFX_TILE_BUFFER_SIZE ((8192ULL + 32ULL) * 3ULL)
+#define RFX_TILE_ARENA_SIZE (RFX_TILE_BUFFER_SIZE + 8192ULL + 32ULL)
 
 typedef struct S_RFX_CONTEXT_PRIV RFX_CONTEXT_PRIV;
 struct S_RFX_CONTEXT_PRIV
@@ -66,8 +72,7 @@ struct S_RFX_CONTEXT_PRIV
 	wObjectPool* TilePool;
 
 	BOOL UseThreads;
-	PTP_WORK* workObjects;
-	RFX_TILE_COMPOSE_WORK_PARAM* tileWorkParams;
+	CODEC_WORK_GROUP* WorkGroup;
 
 	wBufferPool* BufferPool;
 
@@ -0,0 +1,111 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Digital Sound Processing - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/endian.h>
+
+#include <freerdp/log.h>
+
+#include "dsp_sse2.h"
+
+#include "../../core/simd.h"
+
+#define TAG FREERDP_TAG("codec.dsp.sse2")
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+static float freerdp_dsp_dot_sse2(const float* WINPR_RESTRICT x, const float* WINPR_RESTRICT h,
+                                  size_t count)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_load_ps(&h[i])));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&x[i + 4]), _mm_load_ps(&h[i + 4])));
+	}
+
+	__m128 acc = _mm_add_ps(acc0, acc1);
+	acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+	return _mm_cvtss_f32(acc);
+}
+
+static void freerdp_dsp_upmix_sse2(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                   size_t frames)
+{
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&src[2 * x]);
+		_mm_storeu_si128((__m128i*)&dst[4 * x], _mm_unpacklo_epi16(v, v));
+		_mm_storeu_si128((__m128i*)&dst[4 * x + 16], _mm_unpackhi_epi16(v, v));
+	}
+
+	for (; x < frames; x++)
+	{
+		memcpy(&dst[4 * x], &src[2 * x], 2);
+		memcpy(&dst[4 * x + 2], &src[2 * x], 2);
+	}
+}
+
+static void freerdp_dsp_downmix_sse2(const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT dst,
+                                     size_t frames)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	size_t x = 0;
+
+	for (; x + 8 <= frames; x += 8)
+	{
+		/* l + r of each frame as 32bit sum, halved and packed back to 16bit */
+		const __m128i lo = _mm_loadu_si128((const __m128i*)&src[4 * x]);
+		const __m128i hi = _mm_loadu_si128((const __m128i*)&src[4 * x + 16]);
+		const __m128i slo = _mm_srai_epi32(_mm_madd_epi16(lo, ones), 1);
+		const __m128i shi = _mm_srai_epi32(_mm_madd_epi16(hi, ones), 1);
+		_mm_storeu_si128((__m128i*)&dst[2 * x], _mm_packs_epi32(slo, shi));
+	}
+
+	for (; x < frames; x++)
+	{
+		const INT32 l = winpr_Data_Get_INT16(&src[4 * x]);
+		const INT32 r = winpr_Data_Get_INT16(&src[4 * x + 2]);
+		winpr_Data_Write_INT16(&dst[2 * x], (INT16)((l + r) >> 1));
+	}
+}
+#endif
+
+void freerdp_dsp_init_sse2_int(FREERDP_DSP_KERNELS* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "SSE2 optimizations");
+	kernels->dot = freerdp_dsp_dot_sse2;
+	kernels->upmix = freerdp_dsp_upmix_sse2;
+	kernels->downmix = freerdp_dsp_downmix_sse2;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or SSE2 intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
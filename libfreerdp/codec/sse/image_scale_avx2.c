@@ -0,0 +1,157 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "image_scale_avx2.h"
+
+#include "../../core/simd.h"
+
+#define TAG FREERDP_TAG("codec.scale.avx2")
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static inline __m256i image_scale_combine(__m128i lo, __m128i hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static inline __m128i image_scale_load_pixels(const BYTE* WINPR_RESTRICT px, BOOL pair)
+{
+	if (pair)
+		return _mm_loadl_epi64((const __m128i*)(const void*)px);
+
+	INT32 last = 0;
+	memcpy(&last, px, sizeof(last));
+	return _mm_cvtsi32_si128(last);
+}
+
+static inline INT32 image_scale_weight_pair(const INT16* WINPR_RESTRICT w)
+{
+	INT32 pair = 0;
+	memcpy(&pair, w, sizeof(pair));
+	return pair;
+}
+
+/* The AVX2 version filters two destination pixels per step, one per 128 bit lane */
+static void image_scale_hscale_avx2(const BYTE* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                                    const UINT32* WINPR_RESTRICT offsets,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    UINT32 count)
+{
+	const UINT32 stride = image_scale_weight_stride(taps);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(1 << (IMAGE_SCALE_H_SHIFT - 1));
+	size_t x = 0;
+
+	for (; x + 2 <= count; x += 2)
+	{
+		const BYTE* px0 = &src[4ull * offsets[x]];
+		const BYTE* px1 = &src[4ull * offsets[x + 1]];
+		const INT16* w0 = &weights[x * stride];
+		const INT16* w1 = &w0[stride];
+		__m256i acc = round;
+
+		for (size_t t = 0; t < taps; t += 2)
+		{
+			const BOOL pair = (t + 1 < taps);
+			const __m256i p = _mm256_unpacklo_epi8(
+			    image_scale_combine(image_scale_load_pixels(&px0[4 * t], pair),
+			                        image_scale_load_pixels(&px1[4 * t], pair)),
+			    zero);
+			const __m256i pairs = _mm256_unpacklo_epi16(p, _mm256_srli_si256(p, 8));
+			const __m256i w =
+			    image_scale_combine(_mm_set1_epi32(image_scale_weight_pair(&w0[t])),
+			                        _mm_set1_epi32(image_scale_weight_pair(&w1[t])));
+			acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, w));
+		}
+
+		acc = _mm256_srai_epi32(acc, IMAGE_SCALE_H_SHIFT);
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(acc, acc), 0x08);
+		_mm_storeu_si128((__m128i*)(void*)&dst[4 * x], _mm256_castsi256_si128(packed));
+	}
+
+	if (x < count)
+	{
+		const FREERDP_IMAGE_SCALE_KERNELS* generic = freerdp_image_scale_get_kernels_generic();
+		generic->hscale(src, &dst[4 * x], &offsets[x], &weights[x * stride], taps, count - x);
+	}
+}
+
+static void image_scale_vscale_avx2(const INT16* const* WINPR_RESTRICT rows,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    BYTE* WINPR_RESTRICT dst, UINT32 count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i round = _mm256_set1_epi32(1 << (IMAGE_SCALE_V_SHIFT - 1));
+	size_t x = 0;
+
+	for (; x + 16 <= count; x += 16)
+	{
+		__m256i lo = round;
+		__m256i hi = round;
+
+		for (size_t t = 0; t < taps; t += 2)
+		{
+			const __m256i a = _mm256_loadu_si256((const __m256i*)(const void*)&rows[t][x]);
+			const __m256i b =
+			    (t + 1 < taps)
+			        ? _mm256_loadu_si256((const __m256i*)(const void*)&rows[t + 1][x])
+			        : zero;
+			const __m256i w = _mm256_set1_epi32(image_scale_weight_pair(&weights[t]));
+			lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+			hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+		}
+
+		/* unpack and pack both work per 128 bit lane, the values stay in order */
+		const __m256i v = _mm256_packs_epi32(_mm256_srai_epi32(lo, IMAGE_SCALE_V_SHIFT),
+		                                     _mm256_srai_epi32(hi, IMAGE_SCALE_V_SHIFT));
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+		_mm_storeu_si128((__m128i*)(void*)&dst[x], _mm256_castsi256_si128(packed));
+	}
+
+	for (; x < count; x++)
+	{
+		INT32 sum = 0;
+
+		for (size_t t = 0; t < taps; t++)
+			sum += rows[t][x] * weights[t];
+
+		dst[x] = image_scale_pixel_value(sum);
+	}
+}
+#endif
+
+void freerdp_image_scale_init_avx2_int(FREERDP_IMAGE_SCALE_KERNELS* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "AVX2 optimizations");
+	kernels->hscale = image_scale_hscale_avx2;
+	kernels->vscale = image_scale_vscale_avx2;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or AVX2 intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
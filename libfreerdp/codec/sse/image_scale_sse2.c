@@ -0,0 +1,135 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "image_scale_sse2.h"
+
+#include "../../core/simd.h"
+
+#define TAG FREERDP_TAG("codec.scale.sse2")
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+/* Two 16 bit weights as the 32 bit lane _mm_madd_epi16 pairs them with */
+static inline __m128i image_scale_weight_pair(const INT16* WINPR_RESTRICT w)
+{
+	INT32 pair = 0;
+	memcpy(&pair, w, sizeof(pair));
+	return _mm_set1_epi32(pair);
+}
+
+static void image_scale_hscale_sse2(const BYTE* WINPR_RESTRICT src, INT16* WINPR_RESTRICT dst,
+                                    const UINT32* WINPR_RESTRICT offsets,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    UINT32 count)
+{
+	const UINT32 stride = image_scale_weight_stride(taps);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(1 << (IMAGE_SCALE_H_SHIFT - 1));
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const BYTE* px = &src[4ull * offsets[x]];
+		const INT16* w = &weights[x * stride];
+		__m128i acc = round;
+		size_t t = 0;
+
+		for (; t + 1 < taps; t += 2)
+		{
+			/* two neighbouring pixels, interleaved per channel to c0 c0' c1 c1' ... */
+			const __m128i p =
+			    _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(const void*)&px[4 * t]), zero);
+			const __m128i pairs = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(pairs, image_scale_weight_pair(&w[t])));
+		}
+
+		if (t < taps)
+		{
+			INT32 last = 0;
+			memcpy(&last, &px[4 * t], sizeof(last));
+			const __m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero);
+			const __m128i pairs = _mm_unpacklo_epi16(p, zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(pairs, image_scale_weight_pair(&w[t])));
+		}
+
+		acc = _mm_srai_epi32(acc, IMAGE_SCALE_H_SHIFT);
+		_mm_storel_epi64((__m128i*)(void*)&dst[4 * x], _mm_packs_epi32(acc, acc));
+	}
+}
+
+static void image_scale_vscale_sse2(const INT16* const* WINPR_RESTRICT rows,
+                                    const INT16* WINPR_RESTRICT weights, UINT32 taps,
+                                    BYTE* WINPR_RESTRICT dst, UINT32 count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(1 << (IMAGE_SCALE_V_SHIFT - 1));
+	size_t x = 0;
+
+	for (; x + 8 <= count; x += 8)
+	{
+		__m128i lo = round;
+		__m128i hi = round;
+
+		for (size_t t = 0; t < taps; t += 2)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)(const void*)&rows[t][x]);
+			const __m128i b =
+			    (t + 1 < taps) ? _mm_loadu_si128((const __m128i*)(const void*)&rows[t + 1][x])
+			                   : zero;
+			const __m128i w = image_scale_weight_pair(&weights[t]);
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+		}
+
+		const __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, IMAGE_SCALE_V_SHIFT),
+		                                  _mm_srai_epi32(hi, IMAGE_SCALE_V_SHIFT));
+		_mm_storel_epi64((__m128i*)(void*)&dst[x], _mm_packus_epi16(v, v));
+	}
+
+	for (; x < count; x++)
+	{
+		INT32 sum = 0;
+
+		for (size_t t = 0; t < taps; t++)
+			sum += rows[t][x] * weights[t];
+
+		dst[x] = image_scale_pixel_value(sum);
+	}
+}
+#endif
+
+void freerdp_image_scale_init_sse2_int(FREERDP_IMAGE_SCALE_KERNELS* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "SSE2 optimizations");
+	kernels->hscale = image_scale_hscale_sse2;
+	kernels->vscale = image_scale_vscale_sse2;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or SSE2 intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
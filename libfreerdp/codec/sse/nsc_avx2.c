@@ -0,0 +1,221 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * NSCodec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../nsc_types.h"
+#include "../nsc_encode.h"
+#include "nsc_sse2.h"
+#include "nsc_avx2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+#include <freerdp/codec/color.h>
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+/* Extract byte channel of 16 32bpp pixels into 16 bit lanes, in pixel order */
+static inline __m256i nsc_avx2_channel(__m256i p0, __m256i p1, int channel)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m128i shift = _mm_cvtsi32_si128(channel * 8);
+	const __m256i c0 = _mm256_and_si256(_mm256_srl_epi32(p0, shift), mask);
+	const __m256i c1 = _mm256_and_si256(_mm256_srl_epi32(p1, shift), mask);
+
+	/* the pack works per 128 bit lane, put the 64 bit groups back in pixel order */
+	return _mm256_permute4x64_epi64(_mm256_packus_epi32(c0, c1), 0xD8);
+}
+
+/* Store the 16 values of v saturated to 8 bit */
+static inline void nsc_avx2_store_epu8(BYTE* dst, __m256i v)
+{
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+	_mm_storeu_si128((__m128i*)(void*)dst, _mm256_castsi256_si128(packed));
+}
+
+static inline void nsc_avx2_store_epi8(BYTE* dst, __m256i v)
+{
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(v, v), 0x08);
+	_mm_storeu_si128((__m128i*)(void*)dst, _mm256_castsi256_si128(packed));
+}
+
+static void nsc_encode_argb_to_aycocg_avx2(NSC_CONTEXT* WINPR_RESTRICT context,
+                                           const BYTE* WINPR_RESTRICT data, UINT32 scanline,
+                                           UINT32 firstRow, UINT32 lastRow)
+{
+	const UINT16 tempWidth = ROUND_UP_TO(context->width, 8);
+	const size_t rw = (context->ChromaSubsamplingLevel > 0 ? tempWidth : context->width);
+	const __m128i ccl = _mm_cvtsi32_si128(WINPR_ASSERTING_INT_CAST(int, context->ColorLossLevel));
+
+	int rc = 0;
+	int bc = 0;
+	BOOL alpha = FALSE;
+
+	switch (context->format)
+	{
+		case PIXEL_FORMAT_BGRA32:
+			alpha = TRUE;
+			rc = 2;
+			break;
+		case PIXEL_FORMAT_BGRX32:
+			rc = 2;
+			break;
+		case PIXEL_FORMAT_RGBA32:
+			alpha = TRUE;
+			bc = 2;
+			break;
+		case PIXEL_FORMAT_RGBX32:
+		default:
+			bc = 2;
+			break;
+	}
+
+	for (size_t y = firstRow; y < lastRow; y++)
+	{
+		const BYTE* src = data + (context->height - 1 - y) * scanline;
+		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
+		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
+		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
+		BYTE* aplane = context->priv->PlaneBuffers[3] + y * context->width;
+
+		UINT32 x = 0;
+		for (; x + 16 <= context->width; x += 16)
+		{
+			const __m256i p0 = _mm256_loadu_si256((const __m256i*)(const void*)src);
+			const __m256i p1 = _mm256_loadu_si256((const __m256i*)(const void*)(src + 32));
+			src += 64;
+
+			const __m256i r_val = nsc_avx2_channel(p0, p1, rc);
+			const __m256i g_val = nsc_avx2_channel(p0, p1, 1);
+			const __m256i b_val = nsc_avx2_channel(p0, p1, bc);
+
+			__m256i y_val = _mm256_srai_epi16(r_val, 2);
+			y_val = _mm256_add_epi16(y_val, _mm256_srai_epi16(g_val, 1));
+			y_val = _mm256_add_epi16(y_val, _mm256_srai_epi16(b_val, 2));
+			__m256i co_val = _mm256_sub_epi16(r_val, b_val);
+			co_val = _mm256_sra_epi16(co_val, ccl);
+			__m256i cg_val = _mm256_sub_epi16(g_val, _mm256_srai_epi16(r_val, 1));
+			cg_val = _mm256_sub_epi16(cg_val, _mm256_srai_epi16(b_val, 1));
+			cg_val = _mm256_sra_epi16(cg_val, ccl);
+
+			nsc_avx2_store_epu8(yplane, y_val);
+			nsc_avx2_store_epi8(coplane, co_val);
+			nsc_avx2_store_epi8(cgplane, cg_val);
+
+			if (alpha)
+				nsc_avx2_store_epu8(aplane, nsc_avx2_channel(p0, p1, 3));
+			else
+				_mm_storeu_si128((__m128i*)(void*)aplane, _mm_set1_epi8((char)0xFF));
+
+			yplane += 16;
+			coplane += 16;
+			cgplane += 16;
+			aplane += 16;
+		}
+
+		nsc_encode_argb_to_aycocg_pixels(context, src, (UINT32)y, x);
+	}
+
+	nsc_encode_duplicate_last_row(context, lastRow);
+}
+
+static void nsc_encode_subsampling_avx2(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 firstRow,
+                                        UINT32 lastRow)
+{
+	const __m256i mask = _mm256_set1_epi16(0xFF);
+	const __m256i bias = _mm256_set1_epi8((char)0x80);
+	const size_t tempWidth = ROUND_UP_TO(context->width, 8);
+
+	for (size_t y = firstRow >> 1; y < (lastRow + 1) >> 1; y++)
+	{
+		for (size_t i = 0; i < 2; i++)
+		{
+			BYTE* dst = context->priv->EncodeBuffers[i] + y * (tempWidth >> 1);
+			const BYTE* src0 = context->priv->PlaneBuffers[i + 1] + (y << 1) * tempWidth;
+			const BYTE* src1 = src0 + tempWidth;
+
+			size_t x = 0;
+			for (; x + 16 <= tempWidth >> 1; x += 16)
+			{
+				/* same rounding as the SSE2 version */
+				const __m256i a =
+				    _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(const void*)src0), bias);
+				const __m256i b =
+				    _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(const void*)src1), bias);
+				const __m256i t = _mm256_avg_epu8(a, b);
+				__m256i val = _mm256_avg_epu16(_mm256_srli_epi16(t, 8), _mm256_and_si256(t, mask));
+				val = _mm256_permute4x64_epi64(_mm256_packus_epi16(val, val), 0x08);
+				val = _mm256_xor_si256(val, bias);
+				_mm_storeu_si128((__m128i*)(void*)dst, _mm256_castsi256_si128(val));
+				dst += 16;
+				src0 += 32;
+				src1 += 32;
+			}
+
+			for (; x < tempWidth >> 1; x++)
+			{
+				*dst++ = nsc_subsample_avg(src0, src1);
+				src0 += 2;
+				src1 += 2;
+			}
+		}
+	}
+}
+
+static BOOL nsc_encode_avx2(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT data,
+                            UINT32 scanline, UINT32 firstRow, UINT32 lastRow)
+{
+	if (!context || !data || (scanline == 0))
+		return FALSE;
+
+	switch (context->format)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+		case PIXEL_FORMAT_RGBX32:
+		case PIXEL_FORMAT_RGBA32:
+			break;
+		default:
+			return nsc_encode_sse2(context, data, scanline, firstRow, lastRow);
+	}
+
+	nsc_encode_argb_to_aycocg_avx2(context, data, scanline, firstRow, lastRow);
+
+	if (context->ChromaSubsamplingLevel > 0)
+		nsc_encode_subsampling_avx2(context, firstRow, lastRow);
+
+	return TRUE;
+}
+#endif
+
+void nsc_init_avx2_int(NSC_CONTEXT* WINPR_RESTRICT context)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+	PROFILER_RENAME(context->priv->prof_nsc_encode, "nsc_encode_avx2")
+	context->encode = nsc_encode_avx2;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(context);
+#endif
+}
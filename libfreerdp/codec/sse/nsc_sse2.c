@@ -23,6 +23,7 @@
 #include <freerdp/config.h>
 
 #include "../nsc_types.h"
+#include "../nsc_encode.h"
 #include "nsc_sse2.h"
 
 #include "../../core/simd.h"
@@ -303,19 +304,16 @@ static inline size_t nsc_encode_next_rgba(UINT32 format, const BYTE* src, const
 	}
 }
 
-static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
+static void nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* WINPR_RESTRICT context,
+                                           const BYTE* WINPR_RESTRICT data, UINT32 scanline,
+                                           UINT32 firstRow, UINT32 lastRow)
 {
-	size_t y = 0;
-
-	if (!context || !data || (scanline == 0))
-		return FALSE;
-
 	const UINT16 tempWidth = ROUND_UP_TO(context->width, 8);
-	const UINT16 rw = (context->ChromaSubsamplingLevel > 0 ? tempWidth : context->width);
+	const size_t rw = (context->ChromaSubsamplingLevel > 0 ? tempWidth : context->width);
 
 	const BYTE ccl = WINPR_ASSERTING_INT_CAST(BYTE, context->ColorLossLevel);
 
-	for (; y < context->height; y++)
+	for (size_t y = firstRow; y < lastRow; y++)
 	{
 		const BYTE* src = data + (context->height - 1 - y) * scanline;
 		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
@@ -323,7 +321,10 @@ static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* dat
 		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
 		BYTE* aplane = context->priv->PlaneBuffers[3] + y * context->width;
 
-		for (UINT16 x = 0; x < context->width; x += 8)
+		/* only whole groups of 8 pixels, neither read nor write past the end of a line so that
+		 * the bands of rows can be converted concurrently */
+		UINT32 x = 0;
+		for (; x + 8 <= context->width; x += 8)
 		{
 			__m128i r_val = WINPR_C_ARRAY_INIT;
 			__m128i g_val = WINPR_C_ARRAY_INIT;
@@ -343,100 +344,76 @@ static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* dat
 			cg_val = _mm_sub_epi16(cg_val, _mm_srai_epi16(b_val, 1));
 			cg_val = _mm_srai_epi16(cg_val, ccl);
 			y_val = _mm_packus_epi16(y_val, y_val);
-			STORE_SI128(yplane, y_val);
+			_mm_storel_epi64((__m128i*)(void*)yplane, y_val);
 			co_val = _mm_packs_epi16(co_val, co_val);
-			STORE_SI128(coplane, co_val);
+			_mm_storel_epi64((__m128i*)(void*)coplane, co_val);
 			cg_val = _mm_packs_epi16(cg_val, cg_val);
-			STORE_SI128(cgplane, cg_val);
+			_mm_storel_epi64((__m128i*)(void*)cgplane, cg_val);
 			a_val = _mm_packus_epi16(a_val, a_val);
-			STORE_SI128(aplane, a_val);
+			_mm_storel_epi64((__m128i*)(void*)aplane, a_val);
 			yplane += 8;
 			coplane += 8;
 			cgplane += 8;
 			aplane += 8;
 		}
 
-		if (context->ChromaSubsamplingLevel > 0 && (context->width % 2) == 1)
-		{
-			context->priv->PlaneBuffers[0][y * rw + context->width] =
-			    context->priv->PlaneBuffers[0][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[1][y * rw + context->width] =
-			    context->priv->PlaneBuffers[1][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[2][y * rw + context->width] =
-			    context->priv->PlaneBuffers[2][y * rw + context->width - 1];
-		}
-	}
-
-	if (context->ChromaSubsamplingLevel > 0 && (y % 2) == 1)
-	{
-		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
-		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
-		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		CopyMemory(yplane, yplane - rw, rw);
-		CopyMemory(coplane, coplane - rw, rw);
-		CopyMemory(cgplane, cgplane - rw, rw);
+		nsc_encode_argb_to_aycocg_pixels(context, src, (UINT32)y, x);
 	}
 
-	return TRUE;
+	nsc_encode_duplicate_last_row(context, lastRow);
 }
 
-static void nsc_encode_subsampling_sse2(NSC_CONTEXT* context)
+static void nsc_encode_subsampling_sse2(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 firstRow,
+                                        UINT32 lastRow)
 {
-	BYTE* co_dst = nullptr;
-	BYTE* cg_dst = nullptr;
-	INT8* co_src0 = nullptr;
-	INT8* co_src1 = nullptr;
-	INT8* cg_src0 = nullptr;
-	INT8* cg_src1 = nullptr;
-	UINT32 tempWidth = 0;
-	UINT32 tempHeight = 0;
-	__m128i t;
-	__m128i val;
-	__m128i mask = _mm_set1_epi16(0xFF);
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	tempHeight = ROUND_UP_TO(context->height, 2);
-
-	for (size_t y = 0; y < tempHeight >> 1; y++)
+	const __m128i mask = _mm_set1_epi16(0xFF);
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	const size_t tempWidth = ROUND_UP_TO(context->width, 8);
+
+	for (size_t y = firstRow >> 1; y < (lastRow + 1) >> 1; y++)
 	{
-		co_dst = context->priv->PlaneBuffers[1] + y * (tempWidth >> 1);
-		cg_dst = context->priv->PlaneBuffers[2] + y * (tempWidth >> 1);
-		co_src0 = (INT8*)context->priv->PlaneBuffers[1] + (y << 1) * tempWidth;
-		co_src1 = co_src0 + tempWidth;
-		cg_src0 = (INT8*)context->priv->PlaneBuffers[2] + (y << 1) * tempWidth;
-		cg_src1 = cg_src0 + tempWidth;
-
-		for (UINT32 x = 0; x < tempWidth >> 1; x += 8)
+		for (size_t i = 0; i < 2; i++)
 		{
-			t = LOAD_SI128(co_src0);
-			t = _mm_avg_epu8(t, LOAD_SI128(co_src1));
-			val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
-			val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
-			val = _mm_packus_epi16(val, val);
-			STORE_SI128(co_dst, val);
-			co_dst += 8;
-			co_src0 += 16;
-			co_src1 += 16;
-			t = LOAD_SI128(cg_src0);
-			t = _mm_avg_epu8(t, LOAD_SI128(cg_src1));
-			val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
-			val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
-			val = _mm_packus_epi16(val, val);
-			STORE_SI128(cg_dst, val);
-			cg_dst += 8;
-			cg_src0 += 16;
-			cg_src1 += 16;
+			BYTE* dst = context->priv->EncodeBuffers[i] + y * (tempWidth >> 1);
+			const BYTE* src0 = context->priv->PlaneBuffers[i + 1] + (y << 1) * tempWidth;
+			const BYTE* src1 = src0 + tempWidth;
+
+			size_t x = 0;
+			for (; x + 8 <= tempWidth >> 1; x += 8)
+			{
+				/* the chroma values are signed, bias them for the unsigned averages */
+				const __m128i a = _mm_xor_si128(LOAD_SI128(src0), bias);
+				const __m128i b = _mm_xor_si128(LOAD_SI128(src1), bias);
+				const __m128i t = _mm_avg_epu8(a, b);
+				__m128i val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
+				val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
+				val = _mm_xor_si128(_mm_packus_epi16(val, val), bias);
+				_mm_storel_epi64((__m128i*)(void*)dst, val);
+				dst += 8;
+				src0 += 16;
+				src1 += 16;
+			}
+
+			for (; x < tempWidth >> 1; x++)
+			{
+				*dst++ = nsc_subsample_avg(src0, src1);
+				src0 += 2;
+				src1 += 2;
+			}
 		}
 	}
 }
 
-static BOOL nsc_encode_sse2(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT data,
-                            UINT32 scanline)
+BOOL nsc_encode_sse2(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT data,
+                     UINT32 scanline, UINT32 firstRow, UINT32 lastRow)
 {
-	if (!nsc_encode_argb_to_aycocg_sse2(context, data, scanline))
+	if (!context || !data || (scanline == 0))
 		return FALSE;
 
+	nsc_encode_argb_to_aycocg_sse2(context, data, scanline, firstRow, lastRow);
+
 	if (context->ChromaSubsamplingLevel > 0)
-		nsc_encode_subsampling_sse2(context);
+		nsc_encode_subsampling_sse2(context, firstRow, lastRow);
 
 	return TRUE;
 }
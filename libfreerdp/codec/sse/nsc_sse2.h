@@ -25,6 +25,12 @@
 #include <freerdp/codec/nsc.h>
 #include <freerdp/api.h>
 
+/* Band encoder, also used by the AVX2 version for the formats it has no vector loads for */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL BOOL nsc_encode_sse2(NSC_CONTEXT* WINPR_RESTRICT context,
+                                   const BYTE* WINPR_RESTRICT data, UINT32 scanline,
+                                   UINT32 firstRow, UINT32 lastRow);
+
 FREERDP_LOCAL void nsc_init_sse2_int(NSC_CONTEXT* WINPR_RESTRICT context);
 static inline void nsc_init_sse2(NSC_CONTEXT* WINPR_RESTRICT context)
 {
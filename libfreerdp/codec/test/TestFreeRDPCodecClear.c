@@ -1,8 +1,22 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/platform.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/codec/clear.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/progressive.h>
+
+#include "TestFreeRDPHelpers.h"
+
+#define TEST_TEXT_WIDTH 640
+#define TEST_TEXT_HEIGHT 384
+#define TEST_TEXT_FRAMES 6
+#define TEST_GLYPH_COUNT 64
+#define TEST_GLYPH_WIDTH 7
+#define TEST_GLYPH_HEIGHT 12
+#define TEST_GLYPH_ADVANCE 8
+#define TEST_LINE_HEIGHT 16
 
 WINPR_PRAGMA_DIAG_PUSH
 WINPR_PRAGMA_DIAG_IGNORED_UNUSED_CONST_VAR
@@ -68,6 +82,309 @@ fail:
 	return rc;
 }
 
+static void test_write_pixel(BYTE* data, UINT32 step, UINT32 x, UINT32 y, UINT32 color)
+{
+	if (!FreeRDPWriteColor(&data[1ull * y * step + 4ull * x], PIXEL_FORMAT_BGRX32, color))
+		(void)fprintf(stderr, "FreeRDPWriteColor failed\n");
+}
+
+/* Render lines of anti aliased pseudo glyphs on a white background, the
+ * document is taller than a frame so frames can scroll through it. */
+static BYTE* test_text_document(UINT32 width, UINT32 height, UINT32 seed)
+{
+	BYTE glyphs[TEST_GLYPH_COUNT][TEST_GLYPH_HEIGHT][TEST_GLYPH_WIDTH] = WINPR_C_ARRAY_INIT;
+	const UINT32 inks[] = { FreeRDPGetColor(PIXEL_FORMAT_BGRX32, 0x00, 0x00, 0x00, 0xFF),
+		                    FreeRDPGetColor(PIXEL_FORMAT_BGRX32, 0x10, 0x40, 0xC0, 0xFF) };
+	const UINT32 step = width * 4;
+	UINT32 state = seed;
+	BYTE* data = malloc(1ull * step * height);
+
+	if (!data)
+		return nullptr;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+			test_write_pixel(data, step, x, y, 0xFFFFFFFF);
+	}
+
+	for (size_t g = 0; g < TEST_GLYPH_COUNT; g++)
+	{
+		for (size_t y = 2; y < TEST_GLYPH_HEIGHT; y++)
+		{
+			for (size_t x = 1; x < TEST_GLYPH_WIDTH; x++)
+			{
+				if ((test_codec_helper_rand(&state) % 3) == 0)
+					glyphs[g][y][x] = (BYTE)(1 + test_codec_helper_rand(&state) % 3);
+			}
+		}
+	}
+
+	for (UINT32 line = 0; (line + 1) * TEST_LINE_HEIGHT <= height; line++)
+	{
+		const UINT32 ink = inks[(line % 7) == 3 ? 1 : 0];
+		const UINT32 length = test_codec_helper_rand(&state) % (width / TEST_GLYPH_ADVANCE);
+
+		for (UINT32 c = 0; c < length; c++)
+		{
+			const UINT32 g = test_codec_helper_rand(&state) % (TEST_GLYPH_COUNT + 8);
+
+			if (g >= TEST_GLYPH_COUNT)
+				continue; /* space */
+
+			for (UINT32 y = 0; y < TEST_GLYPH_HEIGHT; y++)
+			{
+				for (UINT32 x = 0; x < TEST_GLYPH_WIDTH; x++)
+				{
+					const BYTE coverage = glyphs[g][y][x];
+					BYTE r = 0;
+					BYTE gr = 0;
+					BYTE b = 0;
+
+					if (coverage == 0)
+						continue;
+
+					FreeRDPSplitColor(ink, PIXEL_FORMAT_BGRX32, &r, &gr, &b, nullptr, nullptr);
+					r = (BYTE)(0xFF - ((0xFF - r) * coverage) / 3);
+					gr = (BYTE)(0xFF - ((0xFF - gr) * coverage) / 3);
+					b = (BYTE)(0xFF - ((0xFF - b) * coverage) / 3);
+					test_write_pixel(data, step, c * TEST_GLYPH_ADVANCE + x,
+					                 line * TEST_LINE_HEIGHT + y,
+					                 FreeRDPGetColor(PIXEL_FORMAT_BGRX32, r, gr, b, 0xFF));
+				}
+			}
+		}
+	}
+
+	return data;
+}
+
+static BOOL test_compare_images(const BYTE* src, const BYTE* dst, UINT32 width, UINT32 height,
+                                UINT32 step, BYTE tolerance)
+{
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const BYTE* a = &src[1ull * y * step + 4ull * x];
+			const BYTE* b = &dst[1ull * y * step + 4ull * x];
+
+			for (size_t c = 0; c < 3; c++)
+			{
+				const int d = abs((int)a[c] - (int)b[c]);
+
+				if (d > tolerance)
+				{
+					(void)fprintf(stderr, "pixel mismatch at %" PRIu32 "x%" PRIu32 "\n", x, y);
+					return FALSE;
+				}
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static BOOL test_clear_encode_decode(CLEAR_CONTEXT* encoder, CLEAR_CONTEXT* decoder, wStream* s,
+                                     const BYTE* src, UINT32 width, UINT32 height, UINT32 step,
+                                     BYTE tolerance)
+{
+	BOOL rc = FALSE;
+	BYTE* dst = malloc(1ull * step * height);
+
+	if (!dst)
+		return FALSE;
+
+	memset(dst, 0x5A, 1ull * step * height);
+	Stream_SetPosition(s, 0);
+
+	if (clear_compress_to_stream(encoder, s, src, PIXEL_FORMAT_BGRX32, step, width, height) != 0)
+		goto fail;
+
+	if (clear_decompress(decoder, Stream_Buffer(s), (UINT32)Stream_GetPosition(s), width, height,
+	                     dst, PIXEL_FORMAT_BGRX32, step, 0, 0, width, height, nullptr) != 0)
+		goto fail;
+
+	rc = test_compare_images(src, dst, width, height, step, tolerance);
+fail:
+	free(dst);
+	return rc;
+}
+
+static BOOL test_ClearCompressText(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = TEST_TEXT_WIDTH;
+	const UINT32 height = TEST_TEXT_HEIGHT;
+	const UINT32 step = width * 4;
+	const UINT32 docHeight = height + TEST_TEXT_FRAMES * TEST_LINE_HEIGHT;
+	BYTE* document = test_text_document(width, docHeight, 42);
+	CLEAR_CONTEXT* encoder = clear_context_new(TRUE);
+	CLEAR_CONTEXT* decoder = clear_context_new(FALSE);
+	wStream* s = Stream_New(nullptr, 1024);
+
+	if (!document || !encoder || !decoder || !s)
+		goto fail;
+
+	/* Scroll through the document, the short vBar cache picks up the columns
+	 * of the previous frames at their new positions. */
+	for (UINT32 frame = 0; frame < TEST_TEXT_FRAMES; frame++)
+	{
+		const BYTE* src = &document[1ull * frame * (TEST_LINE_HEIGHT + 3) / 2 * step];
+
+		if (!test_clear_encode_decode(encoder, decoder, s, src, width, height, step, 0))
+		{
+			(void)fprintf(stderr, "text frame %" PRIu32 " failed\n", frame);
+			goto fail;
+		}
+
+		(void)printf("clear text frame %" PRIu32 ": %" PRIuz " bytes\n", frame,
+		             Stream_GetPosition(s));
+	}
+
+	/* Small images go to the glyph cache, a repeated glyph is a 4 byte cache hit */
+	for (UINT32 x = 0; x < 2; x++)
+	{
+		if (!test_clear_encode_decode(encoder, decoder, s, document, 24, 16, step, 0))
+			goto fail;
+	}
+
+	if (Stream_GetPosition(s) != 4)
+	{
+		(void)fprintf(stderr, "glyph cache hit not used: %" PRIuz " bytes\n",
+		              Stream_GetPosition(s));
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	clear_context_free(encoder);
+	clear_context_free(decoder);
+	free(document);
+	return rc;
+}
+
+static BOOL test_ClearCompressImage(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 200;
+	const UINT32 height = 100;
+	const UINT32 step = width * 4;
+	UINT32 state = 7;
+	BYTE* image = malloc(1ull * step * height);
+	CLEAR_CONTEXT* encoder = clear_context_new(TRUE);
+	CLEAR_CONTEXT* decoder = clear_context_new(FALSE);
+	wStream* s = Stream_New(nullptr, 1024);
+
+	if (!image || !encoder || !decoder || !s)
+		goto fail;
+
+	/* Photo like content with too many colors for RLEX, a solid area for the
+	 * residual layer and a few colored lines */
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			UINT32 color = FreeRDPGetColor(PIXEL_FORMAT_BGRX32, 0x20, 0x80, 0x20, 0xFF);
+
+			if (x < 96)
+			{
+				const UINT32 noise = test_codec_helper_rand(&state) % 4;
+				color = FreeRDPGetColor(PIXEL_FORMAT_BGRX32, (BYTE)(x * 2 + noise), (BYTE)(y * 2),
+				                        (BYTE)(x + y), 0xFF);
+			}
+			else if ((y % 9) == 0)
+				color = FreeRDPGetColor(PIXEL_FORMAT_BGRX32, (BYTE)x, 0x00, 0xFF, 0xFF);
+
+			test_write_pixel(image, step, x, y, color);
+		}
+	}
+
+	if (!test_clear_encode_decode(encoder, decoder, s, image, width, height, step, 24))
+		goto fail;
+
+	(void)printf("clear image: %" PRIuz " bytes\n", Stream_GetPosition(s));
+	rc = TRUE;
+fail:
+	Stream_Free(s, TRUE);
+	clear_context_free(encoder);
+	clear_context_free(decoder);
+	free(image);
+	return rc;
+}
+
+/* Compare ClearCodec against planar and progressive on a text workload */
+static BOOL test_ClearCompressBenchmark(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = TEST_TEXT_WIDTH;
+	const UINT32 height = TEST_TEXT_HEIGHT;
+	const UINT32 step = width * 4;
+	const UINT32 docHeight = height + TEST_TEXT_FRAMES * TEST_LINE_HEIGHT;
+	size_t sizes[3] = WINPR_C_ARRAY_INIT;
+	UINT64 times[3] = WINPR_C_ARRAY_INIT;
+	const char* names[3] = { "clear", "planar", "progressive" };
+	BYTE* document = test_text_document(width, docHeight, 4711);
+	CLEAR_CONTEXT* clear = clear_context_new(TRUE);
+	BITMAP_PLANAR_CONTEXT* planar =
+	    freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_RLE, width, height);
+	PROGRESSIVE_CONTEXT* progressive = progressive_context_new(TRUE);
+	wStream* s = Stream_New(nullptr, 1024);
+
+	if (!document || !clear || !planar || !progressive || !s)
+		goto fail;
+
+	freerdp_planar_topdown_image(planar, TRUE);
+
+	for (UINT32 frame = 0; frame < TEST_TEXT_FRAMES; frame++)
+	{
+		const BYTE* src = &document[1ull * frame * TEST_LINE_HEIGHT * step];
+		UINT64 start = winpr_GetUnixTimeNS();
+
+		Stream_SetPosition(s, 0);
+		if (clear_compress_to_stream(clear, s, src, PIXEL_FORMAT_BGRX32, step, width, height) !=
+		    0)
+			goto fail;
+		sizes[0] += Stream_GetPosition(s);
+		times[0] += winpr_GetUnixTimeNS() - start;
+
+		UINT32 planarSize = 0;
+		start = winpr_GetUnixTimeNS();
+		BYTE* planarData = freerdp_bitmap_compress_planar(planar, src, PIXEL_FORMAT_BGRX32, width,
+		                                                  height, step, nullptr, &planarSize);
+		times[1] += winpr_GetUnixTimeNS() - start;
+		free(planarData);
+		if (!planarData)
+			goto fail;
+		sizes[1] += planarSize;
+
+		BYTE* progressiveData = nullptr;
+		UINT32 progressiveSize = 0;
+		start = winpr_GetUnixTimeNS();
+		const int status =
+		    progressive_compress(progressive, src, step * height, PIXEL_FORMAT_BGRX32, width,
+		                         height, step, nullptr, &progressiveData, &progressiveSize);
+		times[2] += winpr_GetUnixTimeNS() - start;
+		if (status < 0)
+			goto fail;
+		sizes[2] += progressiveSize;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+		(void)printf("%-12s %8" PRIuz " bytes/frame %8.3f ms/frame\n", names[x],
+		             sizes[x] / TEST_TEXT_FRAMES, (double)times[x] / TEST_TEXT_FRAMES / 1000000.0);
+
+	rc = sizes[0] < sizes[1];
+fail:
+	Stream_Free(s, TRUE);
+	progressive_context_free(progressive);
+	freerdp_bitmap_planar_context_free(planar);
+	clear_context_free(clear);
+	free(document);
+	return rc;
+}
+
 int TestFreeRDPCodecClear(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -87,5 +404,14 @@ int TestFreeRDPCodecClear(int argc, char* argv[])
 	if (!test_ClearDecompressExample(4, 7, 15, TEST_CLEAR_EXAMPLE_4, sizeof(TEST_CLEAR_EXAMPLE_4)))
 		return -1;
 
+	if (!test_ClearCompressText())
+		return -1;
+
+	if (!test_ClearCompressImage())
+		return -1;
+
+	if (!test_ClearCompressBenchmark())
+		return -1;
+
 	return 0;
 }
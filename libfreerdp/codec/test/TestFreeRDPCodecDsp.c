@@ -0,0 +1,321 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <winpr/crt.h>
+#include <winpr/endian.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/audio.h>
+#include <freerdp/codec/dsp.h>
+
+#define TEST_PI 3.14159265358979323846
+
+static AUDIO_FORMAT test_pcm_format(UINT32 rate, UINT16 channels)
+{
+	AUDIO_FORMAT format = { 0 };
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = channels;
+	format.nSamplesPerSec = rate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = 2 * channels;
+	format.nAvgBytesPerSec = rate * format.nBlockAlign;
+	return format;
+}
+
+static FREERDP_DSP_CONTEXT* test_context_new(UINT32 rate, UINT16 channels)
+{
+	const AUDIO_FORMAT format = test_pcm_format(rate, channels);
+	FREERDP_DSP_CONTEXT* context = freerdp_dsp_context_new(TRUE);
+	if (!context)
+		return nullptr;
+	if (!freerdp_dsp_context_reset(context, &format, 0))
+	{
+		freerdp_dsp_context_free(context);
+		return nullptr;
+	}
+	return context;
+}
+
+/* Fill interleaved samples with the sum of two tones, the same on every channel */
+static BYTE* test_tone_new(UINT32 rate, UINT16 channels, size_t frames, double f1, double f2,
+                           double amplitude)
+{
+	BYTE* data = calloc(frames, 2ull * channels);
+	if (!data)
+		return nullptr;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const double t = (double)x / rate;
+		double v = amplitude * sin(2.0 * TEST_PI * f1 * t);
+		if (f2 > 0.0)
+			v += amplitude * sin(2.0 * TEST_PI * f2 * t);
+		for (size_t c = 0; c < channels; c++)
+			winpr_Data_Write_INT16(&data[(x * channels + c) * 2], (INT16)lrint(v));
+	}
+	return data;
+}
+
+/** @return The ratio of a least squares fitted tone at \b f to the residual in dB */
+static double test_snr(const BYTE* data, size_t frames, UINT16 channels, UINT32 rate, double f)
+{
+	double ss = 0.0;
+	double cc = 0.0;
+	double sc = 0.0;
+	double sy = 0.0;
+	double cy = 0.0;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const double w = 2.0 * TEST_PI * f * (double)x / rate;
+		const double s = sin(w);
+		const double c = cos(w);
+		const double y = winpr_Data_Get_INT16(&data[x * channels * 2]);
+		ss += s * s;
+		cc += c * c;
+		sc += s * c;
+		sy += s * y;
+		cy += c * y;
+	}
+
+	const double det = ss * cc - sc * sc;
+	const double a = (sy * cc - cy * sc) / det;
+	const double b = (cy * ss - sy * sc) / det;
+	double signal = 0.0;
+	double noise = 0.0;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const double w = 2.0 * TEST_PI * f * (double)x / rate;
+		const double fit = a * sin(w) + b * cos(w);
+		const double y = winpr_Data_Get_INT16(&data[x * channels * 2]);
+		signal += fit * fit;
+		noise += (y - fit) * (y - fit);
+	}
+
+	if (noise <= 0.0)
+		return 200.0;
+	return 10.0 * log10(signal / noise);
+}
+
+static BOOL test_channel_mix(void)
+{
+	BOOL rc = FALSE;
+	const size_t frames = 1001;
+	const AUDIO_FORMAT mono = test_pcm_format(22050, 1);
+	const AUDIO_FORMAT stereo = test_pcm_format(22050, 2);
+	FREERDP_DSP_CONTEXT* toMono = test_context_new(22050, 1);
+	FREERDP_DSP_CONTEXT* toStereo = test_context_new(22050, 2);
+	BYTE* src = calloc(frames, 4);
+	wStream* out = Stream_New(nullptr, 1024);
+
+	if (!toMono || !toStereo || !src || !out)
+		goto fail;
+	if (winpr_RAND(src, frames * 4) < 0)
+		goto fail;
+
+	if (!freerdp_dsp_encode(toMono, &stereo, src, frames * 4, out))
+		goto fail;
+	if (Stream_GetPosition(out) != frames * 2)
+		goto fail;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const INT32 l = winpr_Data_Get_INT16(&src[4 * x]);
+		const INT32 r = winpr_Data_Get_INT16(&src[4 * x + 2]);
+		const INT16 m = winpr_Data_Get_INT16(Stream_BufferAs(out, BYTE) + 2 * x);
+		if (m != (INT16)((l + r) >> 1))
+		{
+			(void)fprintf(stderr, "[%s] downmix mismatch at %" PRIuz "\n", __func__, x);
+			goto fail;
+		}
+	}
+
+	Stream_ResetPosition(out);
+	if (!freerdp_dsp_encode(toStereo, &mono, src, frames * 2, out))
+		goto fail;
+	if (Stream_GetPosition(out) != frames * 4)
+		goto fail;
+
+	for (size_t x = 0; x < frames; x++)
+	{
+		const BYTE* d = Stream_BufferAs(out, BYTE) + 4 * x;
+		if ((memcmp(&d[0], &src[2 * x], 2) != 0) || (memcmp(&d[2], &src[2 * x], 2) != 0))
+		{
+			(void)fprintf(stderr, "[%s] upmix mismatch at %" PRIuz "\n", __func__, x);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(out, TRUE);
+	free(src);
+	freerdp_dsp_context_free(toMono);
+	freerdp_dsp_context_free(toStereo);
+	return rc;
+}
+
+/* Feeding the input in odd sized chunks must produce the same output as a single call */
+static BOOL test_resample_streaming(UINT32 srcRate, UINT32 dstRate, UINT16 channels)
+{
+	BOOL rc = FALSE;
+	const size_t frames = 3ull * srcRate / 2;
+	const size_t frameSize = 2ull * channels;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(srcRate, channels);
+	FREERDP_DSP_CONTEXT* once = test_context_new(dstRate, channels);
+	FREERDP_DSP_CONTEXT* chunked = test_context_new(dstRate, channels);
+	BYTE* src = test_tone_new(srcRate, channels, frames, 997.0, 0.0, 12000.0);
+	wStream* a = Stream_New(nullptr, 1024);
+	wStream* b = Stream_New(nullptr, 1024);
+
+	if (!once || !chunked || !src || !a || !b)
+		goto fail;
+
+	if (!freerdp_dsp_encode(once, &srcFormat, src, frames * frameSize, a))
+		goto fail;
+
+	for (size_t x = 0, chunk = 1; x < frames; chunk = (chunk * 7 + 13) % 1500)
+	{
+		const size_t count = MIN(chunk + 1, frames - x);
+		if (!freerdp_dsp_encode(chunked, &srcFormat, &src[x * frameSize], count * frameSize, b))
+			goto fail;
+		x += count;
+	}
+
+	const size_t expect = frames * dstRate / srcRate;
+	if ((Stream_GetPosition(a) != Stream_GetPosition(b)) ||
+	    (memcmp(Stream_Buffer(a), Stream_Buffer(b), Stream_GetPosition(a)) != 0))
+	{
+		(void)fprintf(stderr, "[%s] %" PRIu32 " -> %" PRIu32 " chunked output differs\n",
+		              __func__, srcRate, dstRate);
+		goto fail;
+	}
+
+	/* The filter delay holds back at most one filter length of input */
+	const size_t got = Stream_GetPosition(a) / frameSize;
+	if ((got > expect + 1) || (got + dstRate / 50 < expect))
+	{
+		(void)fprintf(stderr,
+		              "[%s] %" PRIu32 " -> %" PRIu32 " got %" PRIuz " frames, expected ~%" PRIuz
+		              "\n",
+		              __func__, srcRate, dstRate, got, expect);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(a, TRUE);
+	Stream_Free(b, TRUE);
+	free(src);
+	freerdp_dsp_context_free(once);
+	freerdp_dsp_context_free(chunked);
+	return rc;
+}
+
+/* A 1kHz tone must survive conversion cleanly, a tone above the target Nyquist must be removed */
+static BOOL test_resample_quality(UINT32 srcRate, UINT32 dstRate, double minSnr)
+{
+	BOOL rc = FALSE;
+	const UINT16 channels = 2;
+	const size_t frames = srcRate;
+	const double tone = 1000.0;
+	const double alias = (dstRate < srcRate) ? (srcRate + dstRate) / 4.0 : 0.0;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(srcRate, channels);
+	FREERDP_DSP_CONTEXT* context = test_context_new(dstRate, channels);
+	BYTE* src = test_tone_new(srcRate, channels, frames, tone, alias, 8000.0);
+	wStream* out = Stream_New(nullptr, 1024);
+
+	if (!context || !src || !out)
+		goto fail;
+
+	if (!freerdp_dsp_encode(context, &srcFormat, src, frames * 2ull * channels, out))
+		goto fail;
+
+	/* Skip the filter warm up and measure 100ms */
+	const size_t skip = dstRate / 10;
+	const size_t count = dstRate / 10;
+	if (Stream_GetPosition(out) < (skip + count) * 2ull * channels)
+		goto fail;
+
+	const double snr = test_snr(Stream_BufferAs(out, BYTE) + skip * 2ull * channels, count,
+	                            channels, dstRate, tone);
+	(void)fprintf(stdout, "[%s] %" PRIu32 " -> %" PRIu32 " SNR %.1lf dB%s\n", __func__, srcRate,
+	              dstRate, snr, (alias > 0.0) ? " (with out of band tone)" : "");
+	if (snr < minSnr)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	Stream_Free(out, TRUE);
+	free(src);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+static BOOL test_resample_throughput(UINT32 srcRate, UINT32 dstRate, UINT16 channels)
+{
+	BOOL rc = FALSE;
+	const size_t seconds = 10;
+	const size_t chunk = srcRate / 50;
+	const size_t frameSize = 2ull * channels;
+	const AUDIO_FORMAT srcFormat = test_pcm_format(srcRate, channels);
+	FREERDP_DSP_CONTEXT* context = test_context_new(dstRate, channels);
+	BYTE* src = test_tone_new(srcRate, channels, chunk * 50, 440.0, 0.0, 12000.0);
+	wStream* out = Stream_New(nullptr, 1024);
+
+	if (!context || !src || !out)
+		goto fail;
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < seconds * 50; x++)
+	{
+		Stream_ResetPosition(out);
+		if (!freerdp_dsp_encode(context, &srcFormat, &src[(x % 50) * chunk * frameSize],
+		                        chunk * frameSize, out))
+			goto fail;
+	}
+	const UINT64 end = winpr_GetTickCount64NS();
+
+	const double ms = (double)(end - start) / 1000000.0;
+	(void)fprintf(stdout,
+	              "[%s] %" PRIu32 " -> %" PRIu32 " %" PRIu16 "ch: %" PRIuz
+	              "s of audio in %.2lf ms (%.0lfx realtime)\n",
+	              __func__, srcRate, dstRate, channels, seconds, ms,
+	              (ms > 0.0) ? (double)seconds * 1000.0 / ms : 0.0);
+	rc = TRUE;
+fail:
+	Stream_Free(out, TRUE);
+	free(src);
+	freerdp_dsp_context_free(context);
+	return rc;
+}
+
+int TestFreeRDPCodecDsp(WINPR_ATTR_UNUSED int argc, WINPR_ATTR_UNUSED char* argv[])
+{
+	const UINT32 rates[][2] = { { 44100, 48000 }, { 48000, 44100 }, { 48000, 16000 },
+		                        { 16000, 48000 }, { 8000, 48000 },  { 48000, 8000 },
+		                        { 44100, 16000 }, { 22050, 44100 } };
+
+	if (!test_channel_mix())
+		return -1;
+
+	for (size_t x = 0; x < ARRAYSIZE(rates); x++)
+	{
+		if (!test_resample_streaming(rates[x][0], rates[x][1], 1))
+			return -1;
+		if (!test_resample_streaming(rates[x][0], rates[x][1], 2))
+			return -1;
+		if (!test_resample_quality(rates[x][0], rates[x][1], 70.0))
+			return -1;
+	}
+
+	if (!test_resample_throughput(44100, 48000, 2))
+		return -1;
+	if (!test_resample_throughput(48000, 16000, 1))
+		return -1;
+
+	return 0;
+}
@@ -143,6 +143,263 @@ fail:
 	return rc;
 }
 
+/* Mostly static desktop: a flat background with a window, some text being typed per frame */
+static void drawDesktop(uint8_t* rgb, uint32_t format, uint32_t width, uint32_t height,
+                        size_t stride, uint32_t frame, RECTANGLE_16* damage)
+{
+	const size_t bpp = FreeRDPGetBytesPerPixel(format);
+	const uint32_t glyph = 8;
+	const uint32_t columns = (width / 2) / glyph;
+	const uint32_t left = width / 4 + (frame % columns) * glyph;
+	const uint32_t top = height / 4 + ((frame / columns) % 8) * 2 * glyph;
+
+	if (frame == 0)
+	{
+		for (size_t y = 0; y < height; y++)
+		{
+			for (size_t x = 0; x < width; x++)
+			{
+				const BOOL window = (x >= width / 4) && (x < width * 3 / 4) && (y >= height / 4) &&
+				                    (y < height * 3 / 4);
+				const uint32_t color = window ? FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF)
+				                              : FreeRDPGetColor(format, 0x20, 0x60, 0xA0, 0xFF);
+				if (!FreeRDPWriteColor(&rgb[y * stride + x * bpp], format, color))
+					return;
+			}
+		}
+		*damage = (RECTANGLE_16){
+			.left = 0, .top = 0, .right = (UINT16)width, .bottom = (UINT16)height
+		};
+		return;
+	}
+
+	for (size_t y = top; (y < top + glyph) && (y < height); y++)
+	{
+		for (size_t x = left; (x < left + glyph) && (x < width); x++)
+		{
+			const BOOL set = ((x * 7 + y * 3 + frame) % 5) < 2;
+			const uint32_t color = set ? FreeRDPGetColor(format, 0, 0, 0, 0xFF)
+			                           : FreeRDPGetColor(format, 0xFF, 0xFF, 0xFF, 0xFF);
+			if (!FreeRDPWriteColor(&rgb[y * stride + x * bpp], format, color))
+				return;
+		}
+	}
+	*damage = (RECTANGLE_16){ .left = (UINT16)left,
+		                      .top = (UINT16)top,
+		                      .right = (UINT16)MIN(left + glyph, width),
+		                      .bottom = (UINT16)MIN(top + glyph, height) };
+}
+
+/* Encode time and bitrate of a mostly static desktop, with the full frame compared and
+ * converted each time and with only the damaged parts */
+static BOOL testStaticDesktop(BOOL damaged, uint32_t width, uint32_t height, uint32_t frames)
+{
+	BOOL rc = FALSE;
+	const uint32_t format = PIXEL_FORMAT_BGRX32;
+	const size_t stride = 4ull * width;
+	UINT64 duration = 0;
+	UINT64 bytes = 0;
+	uint8_t* rgb = calloc(stride, height);
+	H264_CONTEXT* h264 = h264_context_new(TRUE);
+	if (!rgb || !h264)
+		goto fail;
+
+	if (!h264_context_reset(h264, width, height))
+		goto fail;
+
+	for (uint32_t frame = 0; frame < frames; frame++)
+	{
+		RECTANGLE_16 damage = WINPR_C_ARRAY_INIT;
+		const RECTANGLE_16 full = { .left = 0,
+			                        .top = 0,
+			                        .right = (UINT16)width,
+			                        .bottom = (UINT16)height };
+		RDPGFX_H264_METABLOCK meta = WINPR_C_ARRAY_INIT;
+		uint8_t* dst = nullptr;
+		uint32_t dstsize = 0;
+
+		drawDesktop(rgb, format, width, height, stride, frame, &damage);
+
+		const UINT64 start = winpr_GetUnixTimeNS();
+		const INT32 status =
+		    damaged ? avc420_compress_region(h264, rgb, format, (UINT32)stride, width, height,
+		                                     &damage, 1, &dst, &dstsize, &meta)
+		            : avc420_compress(h264, rgb, format, (UINT32)stride, width, height, &full,
+		                              &dst, &dstsize, &meta);
+		duration += winpr_GetUnixTimeNS() - start;
+		free_h264_metablock(&meta);
+		if (status < 0)
+			goto fail;
+		if (status > 0)
+			bytes += dstsize;
+	}
+
+	printf("[%s] %s %" PRIu32 "x%" PRIu32 " %" PRIu32 " frames: %8.3f ms/frame %10" PRIu64
+	       " bytes\n",
+	       __func__, damaged ? "damage    " : "full frame", width, height, frames,
+	       (double)duration / frames / 1000000.0, bytes);
+	rc = TRUE;
+fail:
+	h264_context_free(h264);
+	free(rgb);
+	return rc;
+}
+
+/* Smooth content that differs from frame to frame, so samples ending up in the wrong place show */
+static void drawGradient(uint8_t* rgb, uint32_t format, size_t stride, const RECTANGLE_16* rect,
+                         uint32_t frame)
+{
+	const size_t bpp = FreeRDPGetBytesPerPixel(format);
+
+	for (size_t y = rect->top; y < rect->bottom; y++)
+	{
+		for (size_t x = rect->left; x < rect->right; x++)
+		{
+			const uint32_t color =
+			    FreeRDPGetColor(format, (BYTE)(x + 37 * frame), (BYTE)(y + 91 * frame),
+			                    (BYTE)(255 - x / 2 - 29 * frame), 0xFF);
+			if (!FreeRDPWriteColor(&rgb[y * stride + x * bpp], format, color))
+				return;
+		}
+	}
+}
+
+/* Mean difference of all color channels in a rectangle */
+static double diffRGB(const uint8_t* src, const uint8_t* dst, uint32_t format, size_t stride,
+                      const RECTANGLE_16* rect)
+{
+	const size_t bpp = FreeRDPGetBytesPerPixel(format);
+	UINT64 sum = 0;
+	UINT64 count = 0;
+
+	for (size_t y = rect->top; y < rect->bottom; y++)
+	{
+		for (size_t x = rect->left; x < rect->right; x++)
+		{
+			BYTE r[2] = WINPR_C_ARRAY_INIT;
+			BYTE g[2] = WINPR_C_ARRAY_INIT;
+			BYTE b[2] = WINPR_C_ARRAY_INIT;
+			const UINT32 a = FreeRDPReadColor(&src[y * stride + x * bpp], format);
+			const UINT32 c = FreeRDPReadColor(&dst[y * stride + x * bpp], format);
+
+			FreeRDPSplitColor(a, format, &r[0], &g[0], &b[0], nullptr, nullptr);
+			FreeRDPSplitColor(c, format, &r[1], &g[1], &b[1], nullptr, nullptr);
+			sum += (UINT64)abs(r[0] - r[1]) + (UINT64)abs(g[0] - g[1]) + (UINT64)abs(b[0] - b[1]);
+			count += 3;
+		}
+	}
+
+	return (count > 0) ? (double)sum / (double)count : 0.0;
+}
+
+static INT32 roundTripFrame(H264_CONTEXT* h264, H264_CONTEXT* h264dec, BYTE version,
+                            const uint8_t* src, uint8_t* out, uint32_t format, size_t stride,
+                            uint32_t width, uint32_t height, const RECTANGLE_16* damage)
+{
+	INT32 rc = -1;
+	RDPGFX_H264_METABLOCK meta = WINPR_C_ARRAY_INIT;
+	RDPGFX_H264_METABLOCK auxMeta = WINPR_C_ARRAY_INIT;
+	BYTE* dst = nullptr;
+	UINT32 dstsize = 0;
+	const UINT32 step = (UINT32)stride;
+
+	if (version == 0)
+	{
+		rc = avc420_compress_region(h264, src, format, step, width, height, damage, 1, &dst,
+		                            &dstsize, &meta);
+		if (rc > 0)
+		{
+			if (avc420_decompress(h264dec, dst, dstsize, out, format, step, width, height,
+			                      meta.regionRects, meta.numRegionRects) < 0)
+				rc = -1;
+		}
+	}
+	else
+	{
+		BYTE op = 0;
+		BYTE* auxDst = nullptr;
+		UINT32 auxDstsize = 0;
+		const UINT32 codecId = (version == 1) ? RDPGFX_CODECID_AVC444 : RDPGFX_CODECID_AVC444v2;
+
+		rc = avc444_compress_region(h264, src, format, step, width, height, version, damage, 1,
+		                            &op, &dst, &dstsize, &auxDst, &auxDstsize, &meta, &auxMeta);
+		if (rc > 0)
+		{
+			/* a chroma only frame is sent as the first stream */
+			const BOOL chroma = (op == 2);
+			if (avc444_decompress(h264dec, op, chroma ? auxMeta.regionRects : meta.regionRects,
+			                      chroma ? auxMeta.numRegionRects : meta.numRegionRects,
+			                      chroma ? auxDst : dst, chroma ? auxDstsize : dstsize,
+			                      auxMeta.regionRects, auxMeta.numRegionRects, auxDst, auxDstsize,
+			                      out, format, step, width, height, codecId) < 0)
+				rc = -1;
+		}
+	}
+
+	free_h264_metablock(&meta);
+	free_h264_metablock(&auxMeta);
+	return rc;
+}
+
+/* Frames with partial damage at offsets not aligned to anything are encoded and decoded, the
+ * decoded image has to follow the source */
+static BOOL testRoundTrip(BYTE version, uint32_t width, uint32_t height, uint32_t frames)
+{
+	BOOL rc = FALSE;
+	const uint32_t format = PIXEL_FORMAT_BGRX32;
+	const size_t stride = 4ull * width;
+	uint8_t* src = calloc(stride, height);
+	uint8_t* out = calloc(stride, height);
+	H264_CONTEXT* h264 = h264_context_new(TRUE);
+	H264_CONTEXT* h264dec = h264_context_new(FALSE);
+	if (!src || !out || !h264 || !h264dec)
+		goto fail;
+
+	if (!h264_context_reset(h264, width, height) || !h264_context_reset(h264dec, width, height))
+		goto fail;
+
+	for (uint32_t frame = 0; frame < frames; frame++)
+	{
+		const RECTANGLE_16 full = { .left = 0,
+			                        .top = 0,
+			                        .right = (UINT16)width,
+			                        .bottom = (UINT16)height };
+		RECTANGLE_16 damage = full;
+		if (frame > 0)
+		{
+			damage.left = (UINT16)((72 + 40 * frame) % (width - 48));
+			damage.top = (UINT16)((40 + 24 * frame) % (height - 40));
+			damage.right = damage.left + 48;
+			damage.bottom = damage.top + 40;
+		}
+
+		drawGradient(src, format, stride, &damage, frame);
+		if (roundTripFrame(h264, h264dec, version, src, out, format, stride, width, height,
+		                   &damage) < 0)
+			goto fail;
+
+		/* H.264 is lossy, a sample from another place is off by much more */
+		const double damageDiff = diffRGB(src, out, format, stride, &damage);
+		const double frameDiff = diffRGB(src, out, format, stride, &full);
+		if ((damageDiff > 8.0) || (frameDiff > 8.0))
+		{
+			(void)fprintf(stderr,
+			              "[%s] AVC%s frame %" PRIu32 ": mean difference %lf damage, %lf frame\n",
+			              __func__, (version == 0) ? "420" : ((version == 1) ? "444v1" : "444v2"),
+			              frame, damageDiff, frameDiff);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	h264_context_free(h264);
+	h264_context_free(h264dec);
+	free(src);
+	free(out);
+	return rc;
+}
+
 int TestFreeRDPCodecH264(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -192,5 +449,14 @@ int TestFreeRDPCodecH264(int argc, char* argv[])
 		}
 	}
 
+	for (BYTE version = 0; version <= 2; version++)
+	{
+		if (!testRoundTrip(version, 320, 192, 10))
+			return -1;
+	}
+
+	if (!testStaticDesktop(FALSE, 1920, 1080, 60) || !testStaticDesktop(TRUE, 1920, 1080, 60))
+		return -1;
+
 	return 0;
 }
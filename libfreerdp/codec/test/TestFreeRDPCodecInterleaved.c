@@ -7,6 +7,7 @@
 #include <winpr/print.h>
 #include <winpr/json.h>
 #include <winpr/path.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
@@ -163,6 +164,143 @@ fail:
 	return rc;
 }
 
+/* Desktop like tile: a window with a title bar, text like glyphs on a flat background,
+ * a gradient and a dithered pattern. With \b noise the lower right quarter is random. */
+static void test_tile(BYTE* data, UINT32 width, UINT32 height, size_t step, UINT32 format,
+                      UINT32 seed, BOOL noise)
+{
+	UINT32 state = seed;
+	const UINT32 bstep = FreeRDPGetBytesPerPixel(format);
+
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			BYTE r = 0xF0;
+			BYTE g = 0xF0;
+			BYTE b = 0xF0;
+			const UINT32 glyph = (UINT32)(((x + seed) / 6) * 7 + y / 10);
+
+			if (y < 8)
+			{
+				r = 0x00;
+				g = 0x40;
+				b = (BYTE)(0x80 + x);
+			}
+			else if ((y > 12) && (y < 40) && ((y % 10) < 7) && ((glyph % 5) != 0) &&
+			         (((x * 3 + y * 5 + glyph) % 4) == 0))
+			{
+				r = 0x00;
+				g = 0x00;
+				b = 0x00;
+			}
+			else if (y >= 40)
+			{
+				r = (BYTE)(x * 4);
+				g = (BYTE)(y * 2);
+				b = ((x + y) % 2) ? 0x20 : 0xC0;
+			}
+
+			if (noise && (x >= width / 2) && (y >= height / 2))
+			{
+				const UINT32 rnd = test_codec_helper_rand(&state);
+				r = (BYTE)rnd;
+				g = (BYTE)(rnd >> 8);
+				b = (BYTE)(rnd >> 16);
+			}
+
+			const UINT32 color = FreeRDPGetColor(format, r, g, b, 0xFF);
+			if (!FreeRDPWriteColor(&data[y * step + x * bstep], format, color))
+				return;
+		}
+	}
+}
+
+/* Compression ratio and throughput of the encoder, the result must decode losslessly
+ * (up to the precision of the color depth) */
+static bool test_ratio(UINT16 bpp, BOOL noise)
+{
+	bool rc = false;
+	const UINT32 w = 64;
+	const UINT32 h = 64;
+	const UINT32 frames = 100;
+	const UINT32 format = PIXEL_FORMAT_RGBX32;
+	const UINT32 bstep = FreeRDPGetBytesPerPixel(format);
+	const size_t step = 4ULL * w;
+	const size_t SrcSize = step * h;
+	const int maxDiff = (bpp < 24) ? 8 : 0;
+	UINT64 encodeTime = 0;
+	UINT64 decodeTime = 0;
+	UINT32 DstSize = 0;
+	BITMAP_INTERLEAVED_CONTEXT* encoder = bitmap_interleaved_context_new(true);
+	BITMAP_INTERLEAVED_CONTEXT* decoder = bitmap_interleaved_context_new(false);
+	BYTE* pSrcData = calloc(1, SrcSize);
+	BYTE* pDstData = calloc(1, SrcSize);
+	BYTE* tmp = calloc(1, SrcSize);
+
+	if (!encoder || !decoder || !pSrcData || !pDstData || !tmp)
+		goto fail;
+
+	test_tile(pSrcData, w, h, step, format, bpp, noise);
+
+	for (UINT32 frame = 0; frame < frames; frame++)
+	{
+		DstSize = WINPR_ASSERTING_INT_CAST(UINT32, SrcSize);
+		UINT64 start = winpr_GetTickCount64NS();
+		if (!interleaved_compress(encoder, tmp, &DstSize, w, h, pSrcData, format, step, 0, 0,
+		                          nullptr, bpp))
+			goto fail;
+		encodeTime += winpr_GetTickCount64NS() - start;
+
+		start = winpr_GetTickCount64NS();
+		if (!interleaved_decompress(decoder, tmp, DstSize, w, h, bpp, pDstData, format, step, 0,
+		                            0, w, h, nullptr))
+			goto fail;
+		decodeTime += winpr_GetTickCount64NS() - start;
+	}
+
+	for (size_t y = 0; y < h; y++)
+	{
+		for (size_t x = 0; x < w; x++)
+		{
+			BYTE r = 0;
+			BYTE g = 0;
+			BYTE b = 0;
+			BYTE dr = 0;
+			BYTE dg = 0;
+			BYTE db = 0;
+			const UINT32 srcColor = FreeRDPReadColor(&pSrcData[y * step + x * bstep], format);
+			const UINT32 dstColor = FreeRDPReadColor(&pDstData[y * step + x * bstep], format);
+			FreeRDPSplitColor(srcColor, format, &r, &g, &b, nullptr, nullptr);
+			FreeRDPSplitColor(dstColor, format, &dr, &dg, &db, nullptr, nullptr);
+
+			if ((abs(r - dr) > maxDiff) || (abs(g - dg) > maxDiff) || (abs(b - db) > maxDiff))
+			{
+				(void)fprintf(stderr, "%" PRIu16 "bpp pixel %" PRIuz "x%" PRIuz " differs\n", bpp,
+				              x, y);
+				goto fail;
+			}
+		}
+	}
+
+	{
+		const size_t raw = 1ULL * w * h * ((bpp + 7) / 8);
+		(void)printf("interleaved %2" PRIu16 "bpp %-7s %5" PRIu32 " of %5" PRIuz
+		             " bytes (%5.1f%%) compress %8.3f us decompress %8.3f us\n",
+		             bpp, noise ? "noise" : "desktop", DstSize, raw, 100.0 * DstSize / raw,
+		             (double)encodeTime / frames / 1000.0, (double)decodeTime / frames / 1000.0);
+	}
+
+	rc = true;
+fail:
+	bitmap_interleaved_context_free(encoder);
+	bitmap_interleaved_context_free(decoder);
+	free(pSrcData);
+	free(pDstData);
+	free(tmp);
+	return rc;
+}
+
 static bool TestColorConversion(void)
 {
 	const UINT32 formats[] = { PIXEL_FORMAT_RGB15,  PIXEL_FORMAT_BGR15, PIXEL_FORMAT_ABGR15,
@@ -443,6 +581,15 @@ int TestFreeRDPCodecInterleaved(int argc, char* argv[])
 	if (!TestColorConversion())
 		goto fail;
 
+	{
+		const UINT16 depths[] = { 24, 16, 15 };
+		for (size_t x = 0; x < ARRAYSIZE(depths); x++)
+		{
+			if (!test_ratio(depths[x], FALSE) || !test_ratio(depths[x], TRUE))
+				goto fail;
+		}
+	}
+
 	if (!TestEncoder())
 		goto fail;
 
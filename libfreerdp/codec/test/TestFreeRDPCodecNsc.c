@@ -0,0 +1,467 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * NSCodec Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/settings.h>
+#include <freerdp/codec/nsc.h>
+#include <freerdp/codec/color.h>
+
+#if defined(BUILD_TESTING_INTERNAL)
+#include "../nsc_encode.h"
+#endif
+
+#include "TestFreeRDPHelpers.h"
+
+#define TEST_BENCHMARK_FRAMES 3
+
+/* Desktop like content: flat windows, a gradient background and a noisy picture */
+static BYTE* test_frame(UINT32 width, UINT32 height, UINT32 bpp, UINT32 seed)
+{
+	UINT32 state = seed;
+	BYTE* data = calloc(1ull * width * height, bpp);
+	if (!data)
+		return nullptr;
+
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			BYTE* px = &data[(y * width + x) * bpp];
+			BYTE value[4] = { (BYTE)(x + seed), (BYTE)(y * 2), (BYTE)(x ^ y), 0xFF };
+
+			if ((x / 64 + y / 48) % 3 == 0)
+			{
+				value[0] = 0xF0;
+				value[1] = 0xF0;
+				value[2] = 0xF0;
+			}
+			else if ((x > width / 2) && (y > height / 2))
+			{
+				const UINT32 r = test_codec_helper_rand(&state);
+				value[0] = (BYTE)r;
+				value[1] = (BYTE)(r >> 8);
+				value[2] = (BYTE)(r >> 16);
+				value[3] = (BYTE)(r >> 24);
+			}
+
+			memcpy(px, value, bpp);
+		}
+	}
+
+	return data;
+}
+
+static NSC_CONTEXT* test_context(UINT32 ThreadingFlags, UINT32 format, UINT32 colorLoss,
+                                 UINT32 subsampling)
+{
+	NSC_CONTEXT* context = nsc_context_new_ex(ThreadingFlags);
+	if (!context)
+		return nullptr;
+
+	if (!nsc_context_set_parameters(context, NSC_COLOR_FORMAT, format) ||
+	    !nsc_context_set_parameters(context, NSC_COLOR_LOSS_LEVEL, colorLoss) ||
+	    !nsc_context_set_parameters(context, NSC_ALLOW_SUBSAMPLING, subsampling))
+	{
+		nsc_context_free(context);
+		return nullptr;
+	}
+
+	return context;
+}
+
+static BOOL test_decode(wStream* s, UINT32 width, UINT32 height, const BYTE* image,
+                        UINT32 maxDiff)
+{
+	BOOL rc = FALSE;
+	const UINT32 stride = width * 4;
+	BYTE* decoded = calloc(1ull * stride, height);
+	NSC_CONTEXT* decoder = nsc_context_new();
+
+	if (!decoded || !decoder)
+		goto fail;
+
+	if (!nsc_context_reset(decoder, width, height))
+		goto fail;
+
+	if (!nsc_process_message(decoder, 32, width, height, Stream_Buffer(s),
+	                         (UINT32)Stream_GetPosition(s), decoded, PIXEL_FORMAT_BGRX32, stride, 0,
+	                         0, width, height, FREERDP_FLIP_VERTICAL))
+	{
+		(void)fprintf(stderr, "nsc_process_message failed\n");
+		goto fail;
+	}
+
+	for (size_t x = 0; x < 1ull * stride * height; x++)
+	{
+		/* compare color channels only */
+		if ((x % 4) == 3)
+			continue;
+
+		const int diff = abs((int)decoded[x] - (int)image[x]);
+		if ((UINT32)diff > maxDiff)
+		{
+			(void)fprintf(stderr, "decoded pixel %" PRIuz " differs by %d\n", x / 4, diff);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	nsc_context_free(decoder);
+	free(decoded);
+	return rc;
+}
+
+/* The byte at a time RLE the vectorized one replaced */
+static UINT32 test_rle_reference(const BYTE* in, BYTE* out, UINT32 originalSize)
+{
+	UINT32 left = originalSize;
+	UINT32 runlength = 1;
+	UINT32 planeSize = 0;
+
+	while (left > 4 && planeSize < originalSize - 4)
+	{
+		if (left > 5 && *in == *(in + 1))
+		{
+			runlength++;
+		}
+		else if (runlength == 1)
+		{
+			*out++ = *in;
+			planeSize++;
+		}
+		else if (runlength < 256)
+		{
+			*out++ = *in;
+			*out++ = *in;
+			*out++ = (BYTE)(runlength - 2);
+			runlength = 1;
+			planeSize += 3;
+		}
+		else
+		{
+			*out++ = *in;
+			*out++ = *in;
+			*out++ = 0xFF;
+			*out++ = (BYTE)(runlength & 0x000000FF);
+			*out++ = (BYTE)((runlength & 0x0000FF00) >> 8);
+			*out++ = (BYTE)((runlength & 0x00FF0000) >> 16);
+			*out++ = (BYTE)((runlength & 0xFF000000) >> 24);
+			runlength = 1;
+			planeSize += 7;
+		}
+
+		in++;
+		left--;
+	}
+
+	if (planeSize < originalSize - 4)
+		CopyMemory(out, in, 4);
+
+	planeSize += 4;
+	return planeSize;
+}
+
+/* The scalar conversion and chroma subsampling used before the encoder was split into bands,
+ * for the 24 and 32bpp BGR formats */
+static void test_convert_reference(BYTE* planes[5], const BYTE* image, UINT32 width,
+                                   UINT32 height, UINT32 format, UINT32 colorLoss,
+                                   UINT32 subsampling)
+{
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	const UINT32 tempWidth = (width + 7) & ~7u;
+	const UINT32 tempHeight = (height + 1) & ~1u;
+	const UINT32 rw = subsampling ? tempWidth : width;
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const BYTE* src = &image[(height - 1 - y) * width * bpp];
+		BYTE* yplane = &planes[0][y * rw];
+		BYTE* coplane = &planes[1][y * rw];
+		BYTE* cgplane = &planes[2][y * rw];
+		BYTE* aplane = &planes[3][y * width];
+
+		for (size_t x = 0; x < width; x++)
+		{
+			const INT16 b = src[0];
+			const INT16 g = src[1];
+			const INT16 r = src[2];
+
+			yplane[x] = (BYTE)((r >> 2) + (g >> 1) + (b >> 2));
+			coplane[x] = (BYTE)((r - b) >> colorLoss);
+			cgplane[x] = (BYTE)((-(r >> 1) + g - (b >> 1)) >> colorLoss);
+			aplane[x] = (format == PIXEL_FORMAT_BGRA32) ? src[3] : 0xFF;
+			src += bpp;
+		}
+
+		if (subsampling && ((width % 2) == 1))
+		{
+			yplane[width] = yplane[width - 1];
+			coplane[width] = coplane[width - 1];
+			cgplane[width] = cgplane[width - 1];
+		}
+	}
+
+	if (!subsampling)
+		return;
+
+	if ((height % 2) == 1)
+	{
+		for (size_t i = 0; i < 3; i++)
+			memcpy(&planes[i][1ull * height * rw], &planes[i][(height - 1ull) * rw], rw);
+	}
+
+	for (size_t y = 0; y < tempHeight / 2; y++)
+	{
+		for (size_t i = 1; i < 3; i++)
+		{
+			BYTE* dst = &planes[i][y * (tempWidth / 2)];
+			const INT8* src0 = (const INT8*)&planes[i][2 * y * tempWidth];
+			const INT8* src1 = src0 + tempWidth;
+
+			for (size_t x = 0; x < tempWidth / 2; x++)
+			{
+				dst[x] = (BYTE)((src0[2 * x] + src0[2 * x + 1] + src1[2 * x] + src1[2 * x + 1]) >>
+				                2);
+			}
+		}
+	}
+}
+
+/* The whole single threaded encoder before the band split, the planes are reused per frame */
+static BOOL test_encode_reference(wStream* s, BYTE* planes[5], const BYTE* image, UINT32 width,
+                                  UINT32 height, UINT32 format, UINT32 colorLoss,
+                                  UINT32 subsampling)
+{
+	const UINT32 tempWidth = (width + 7) & ~7u;
+	const UINT32 tempHeight = (height + 1) & ~1u;
+	UINT32 orgByteCount[4] = { width * height, width * height, width * height, width * height };
+	UINT32 planeByteCount[4] = WINPR_C_ARRAY_INIT;
+
+	if (subsampling)
+	{
+		orgByteCount[0] = tempWidth * height;
+		orgByteCount[1] = tempWidth * tempHeight / 4;
+		orgByteCount[2] = tempWidth * tempHeight / 4;
+	}
+
+	test_convert_reference(planes, image, width, height, format, colorLoss, subsampling);
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		planeByteCount[i] = test_rle_reference(planes[i], planes[4], orgByteCount[i]);
+		if (planeByteCount[i] < orgByteCount[i])
+			memcpy(planes[i], planes[4], planeByteCount[i]);
+		else
+			planeByteCount[i] = orgByteCount[i];
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 20ull + planeByteCount[0] + planeByteCount[1] +
+	                                           planeByteCount[2] + planeByteCount[3]))
+		return FALSE;
+
+	for (size_t i = 0; i < 4; i++)
+		Stream_Write_UINT32(s, planeByteCount[i]);
+	Stream_Write_UINT8(s, (BYTE)colorLoss);
+	Stream_Write_UINT8(s, (BYTE)subsampling);
+	Stream_Write_UINT16(s, 0);
+	for (size_t i = 0; i < 4; i++)
+		Stream_Write(s, planes[i], planeByteCount[i]);
+	return TRUE;
+}
+
+/* Encode with and without the thread pool, the output must be the same. Without chroma
+ * subsampling it must also match the old encoder, the subsampling rounds differently now. */
+static BOOL test_nsc_threads(UINT32 width, UINT32 height, UINT32 format, UINT32 colorLoss,
+                             UINT32 subsampling, UINT32 frames)
+{
+	BOOL rc = FALSE;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	UINT64 times[3] = WINPR_C_ARRAY_INIT;
+	BYTE* planes[5] = WINPR_C_ARRAY_INIT;
+	BYTE* image = test_frame(width, height, bpp, width ^ height);
+	NSC_CONTEXT* serial =
+	    test_context(THREADING_FLAGS_DISABLE_THREADS, format, colorLoss, subsampling);
+	NSC_CONTEXT* threaded = test_context(0, format, colorLoss, subsampling);
+	wStream* serialStream = Stream_New(nullptr, 1024);
+	wStream* threadedStream = Stream_New(nullptr, 1024);
+	wStream* referenceStream = Stream_New(nullptr, 1024);
+
+	if (!image || !serial || !threaded || !serialStream || !threadedStream || !referenceStream)
+		goto fail;
+
+	for (size_t i = 0; i < ARRAYSIZE(planes); i++)
+	{
+		planes[i] = calloc(((width + 7ull) & ~7ull) * ((height + 1ull) & ~1ull) + 16, 1);
+		if (!planes[i])
+			goto fail;
+	}
+
+	for (UINT32 frame = 0; frame < frames; frame++)
+	{
+		Stream_ResetPosition(referenceStream);
+		UINT64 start = winpr_GetUnixTimeNS();
+		if (!test_encode_reference(referenceStream, planes, image, width, height, format,
+		                           colorLoss, subsampling))
+			goto fail;
+		times[2] += winpr_GetUnixTimeNS() - start;
+
+		Stream_ResetPosition(serialStream);
+		start = winpr_GetUnixTimeNS();
+		if (!nsc_compose_message(serial, serialStream, image, width, height, 0))
+			goto fail;
+		times[0] += winpr_GetUnixTimeNS() - start;
+
+		Stream_ResetPosition(threadedStream);
+		start = winpr_GetUnixTimeNS();
+		if (!nsc_compose_message(threaded, threadedStream, image, width, height, 0))
+			goto fail;
+		times[1] += winpr_GetUnixTimeNS() - start;
+	}
+
+	if ((Stream_GetPosition(serialStream) != Stream_GetPosition(threadedStream)) ||
+	    (memcmp(Stream_Buffer(serialStream), Stream_Buffer(threadedStream),
+	            Stream_GetPosition(serialStream)) != 0))
+	{
+		(void)fprintf(stderr, "threaded encoder output differs for %" PRIu32 "x%" PRIu32 "\n",
+		              width, height);
+		goto fail;
+	}
+
+	if (!subsampling &&
+	    ((Stream_GetPosition(serialStream) != Stream_GetPosition(referenceStream)) ||
+	     (memcmp(Stream_Buffer(serialStream), Stream_Buffer(referenceStream),
+	             Stream_GetPosition(serialStream)) != 0)))
+	{
+		(void)fprintf(stderr, "encoder output differs from the reference for %" PRIu32 "x%" PRIu32
+		                      "\n",
+		              width, height);
+		goto fail;
+	}
+
+	if (format == PIXEL_FORMAT_BGRX32)
+	{
+		/* without chroma subsampling only the color loss reduction is lossy */
+		const UINT32 maxDiff = subsampling ? 0xFF : 1u << colorLoss;
+		if (!test_decode(serialStream, width, height, image, maxDiff))
+			goto fail;
+	}
+
+	(void)printf("nsc %4" PRIu32 "x%-4" PRIu32 " %8" PRIuz " bytes/frame reference %8.3f "
+	             "ms/frame single thread %8.3f ms/frame thread pool %8.3f ms/frame\n",
+	             width, height, Stream_GetPosition(serialStream),
+	             (double)times[2] / frames / 1000000.0, (double)times[0] / frames / 1000000.0,
+	             (double)times[1] / frames / 1000000.0);
+
+	rc = TRUE;
+fail:
+	Stream_Free(serialStream, TRUE);
+	Stream_Free(threadedStream, TRUE);
+	Stream_Free(referenceStream, TRUE);
+	for (size_t i = 0; i < ARRAYSIZE(planes); i++)
+		free(planes[i]);
+	nsc_context_free(serial);
+	nsc_context_free(threaded);
+	free(image);
+	return rc;
+}
+
+#if defined(BUILD_TESTING_INTERNAL)
+#define RLE_TEST_SIZE 4096
+
+static BOOL test_nsc_rle(void)
+{
+	UINT32 state = 0x4e5343;
+	BYTE in[RLE_TEST_SIZE + 32] = WINPR_C_ARRAY_INIT;
+	BYTE expect[RLE_TEST_SIZE + 32] = WINPR_C_ARRAY_INIT;
+	BYTE out[RLE_TEST_SIZE + 32] = WINPR_C_ARRAY_INIT;
+
+	for (size_t iteration = 0; iteration < 2000; iteration++)
+	{
+		const UINT32 size = 5 + test_codec_helper_rand(&state) % (RLE_TEST_SIZE - 5);
+		const UINT32 runs = test_codec_helper_rand(&state) % 8;
+
+		/* runs of any length between stretches of literals, sometimes none at all */
+		for (size_t x = 0; x < size; x++)
+		{
+			const UINT32 r = test_codec_helper_rand(&state);
+			if ((x > 0) && ((r % 8) < runs))
+			{
+				const size_t run = MIN(size - x, (r >> 8) % ((r & 0x80) ? 400 : 20));
+				memset(&in[x], in[x - 1], run);
+				x += run;
+				if (x >= size)
+					break;
+			}
+			in[x] = (BYTE)(r >> 24);
+		}
+
+		const UINT32 expectSize = test_rle_reference(in, expect, size);
+		const UINT32 outSize = nsc_rle_encode(in, out, size);
+
+		if ((expectSize != outSize) ||
+		    ((outSize < size) && (memcmp(expect, out, outSize) != 0)))
+		{
+			(void)fprintf(stderr,
+			              "nsc_rle_encode mismatch for %" PRIu32 " bytes: %" PRIu32 " != %" PRIu32
+			              "\n",
+			              size, outSize, expectSize);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+#endif
+
+int TestFreeRDPCodecNsc(int argc, char* argv[])
+{
+	/* the full HD and 4K timing runs take a while, they run only when asked for */
+	const BOOL performance = argc > 1;
+	WINPR_UNUSED(argv);
+
+#if defined(BUILD_TESTING_INTERNAL)
+	if (!test_nsc_rle())
+		return -1;
+#endif
+
+	/* odd sizes exercise the padding of the subsampled planes and the last band */
+	if (!test_nsc_threads(333, 201, PIXEL_FORMAT_BGRX32, 3, 1, 1))
+		return -1;
+	if (!test_nsc_threads(333, 201, PIXEL_FORMAT_BGRX32, 1, 0, 1))
+		return -1;
+	if (!test_nsc_threads(333, 201, PIXEL_FORMAT_BGR24, 3, 1, 1))
+		return -1;
+	if (!test_nsc_threads(21, 7, PIXEL_FORMAT_BGRA32, 3, 1, 1))
+		return -1;
+
+	if (!performance)
+		return 0;
+
+	if (!test_nsc_threads(1920, 1080, PIXEL_FORMAT_BGRX32, 3, 1, TEST_BENCHMARK_FRAMES))
+		return -1;
+	if (!test_nsc_threads(1920, 1080, PIXEL_FORMAT_BGRX32, 3, 0, TEST_BENCHMARK_FRAMES))
+		return -1;
+	if (!test_nsc_threads(3840, 2160, PIXEL_FORMAT_BGRX32, 3, 1, TEST_BENCHMARK_FRAMES))
+		return -1;
+
+	return 0;
+}
@@ -6,14 +6,18 @@
 #include <winpr/print.h>
 #include <winpr/crypto.h>
 #include <winpr/path.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
+#include <freerdp/settings.h>
 #include <freerdp/codec/color.h>
 #include <freerdp/codec/bitmap.h>
 #include <freerdp/codec/planar.h>
 
 #include "TestFreeRDPHelpers.h"
 
+#define TEST_BENCHMARK_FRAMES 3
+
 static const UINT32 colorFormatList[] = {
 	PIXEL_FORMAT_RGB15,  PIXEL_FORMAT_BGR15,  PIXEL_FORMAT_RGB16,  PIXEL_FORMAT_BGR16,
 	PIXEL_FORMAT_RGB24,  PIXEL_FORMAT_BGR24,  PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_ABGR32,
@@ -406,10 +410,140 @@ fail:
 	return rc;
 }
 
+/* Desktop like content in BGRX32: flat windows, a gradient background and a noisy picture */
+static BYTE* test_frame(UINT32 width, UINT32 height, UINT32 seed)
+{
+	BYTE* data = calloc(1ull * width * height, 4);
+	if (!data)
+		return nullptr;
+
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			BYTE* px = &data[(y * width + x) * 4];
+			BYTE value[4] = { (BYTE)(x + seed), (BYTE)(y * 2), (BYTE)(x ^ y), 0xFF };
+
+			if ((x / 64 + y / 48) % 3 == 0)
+			{
+				value[0] = 0xF0;
+				value[1] = 0xF0;
+				value[2] = 0xF0;
+			}
+			else if ((x > width / 2) && (y > height / 2))
+			{
+				const UINT32 r = prand(UINT32_MAX);
+				value[0] = (BYTE)r;
+				value[1] = (BYTE)(r >> 8);
+				value[2] = (BYTE)(r >> 16);
+			}
+
+			memcpy(px, value, sizeof(value));
+		}
+	}
+
+	return data;
+}
+
+static BYTE* test_compress(BITMAP_PLANAR_CONTEXT* planar, const BYTE* image, UINT32 format,
+                           UINT32 width, UINT32 height, UINT32* size, UINT64* time)
+{
+	const UINT64 start = winpr_GetUnixTimeNS();
+	BYTE* data =
+	    freerdp_bitmap_compress_planar(planar, image, format, width, height, 0, nullptr, size);
+	*time += winpr_GetUnixTimeNS() - start;
+	return data;
+}
+
+/* Encode with and without the thread pool, the output must be the same. The 32bpp input is
+ * split with the byte shuffling fast path, compare against the generic path for 24bpp. */
+static BOOL test_planar_threads(UINT32 width, UINT32 height, DWORD flags, UINT32 frames)
+{
+	BOOL rc = FALSE;
+	UINT32 sizes[3] = WINPR_C_ARRAY_INIT;
+	BYTE* data[3] = WINPR_C_ARRAY_INIT;
+	UINT64 times[3] = WINPR_C_ARRAY_INIT;
+	BYTE* image = test_frame(width, height, width ^ height);
+	BYTE* image24 = calloc(1ull * width * height, 3);
+	BYTE* decoded = calloc(1ull * width * height, 4);
+	BITMAP_PLANAR_CONTEXT* serial = freerdp_bitmap_planar_context_new_ex(
+	    flags, width, height, THREADING_FLAGS_DISABLE_THREADS);
+	BITMAP_PLANAR_CONTEXT* threaded = freerdp_bitmap_planar_context_new_ex(flags, width, height, 0);
+
+	if (!image || !image24 || !decoded || !serial || !threaded)
+		goto fail;
+
+	freerdp_planar_topdown_image(serial, TRUE);
+	freerdp_planar_topdown_image(threaded, TRUE);
+
+	for (size_t x = 0; x < 1ull * width * height; x++)
+		memcpy(&image24[x * 3], &image[x * 4], 3);
+
+	for (UINT32 frame = 0; frame < frames; frame++)
+	{
+		for (size_t x = 0; x < ARRAYSIZE(data); x++)
+		{
+			free(data[x]);
+			data[x] = nullptr;
+		}
+
+		data[0] = test_compress(serial, image, PIXEL_FORMAT_BGRX32, width, height, &sizes[0],
+		                        &times[0]);
+		data[1] = test_compress(threaded, image, PIXEL_FORMAT_BGRX32, width, height, &sizes[1],
+		                        &times[1]);
+		data[2] = test_compress(serial, image24, PIXEL_FORMAT_BGR24, width, height, &sizes[2],
+		                        &times[2]);
+		if (!data[0] || !data[1] || !data[2])
+			goto fail;
+	}
+
+	for (size_t x = 1; x < ARRAYSIZE(data); x++)
+	{
+		if ((sizes[0] != sizes[x]) || (memcmp(data[0], data[x], sizes[0]) != 0))
+		{
+			(void)fprintf(stderr,
+			              "planar encoder output %" PRIuz " differs for %" PRIu32 "x%" PRIu32 "\n",
+			              x, width, height);
+			goto fail;
+		}
+	}
+
+	/* planar without color loss is lossless */
+	if (!freerdp_bitmap_decompress_planar(serial, data[0], sizes[0], width, height, decoded,
+	                                      PIXEL_FORMAT_BGRX32, 0, 0, 0, width, height, FALSE))
+		goto fail;
+
+	for (size_t x = 0; x < 1ull * width * height; x++)
+	{
+		if (memcmp(&decoded[x * 4], &image[x * 4], 3) != 0)
+		{
+			(void)fprintf(stderr, "decoded pixel %" PRIuz " differs\n", x);
+			goto fail;
+		}
+	}
+
+	(void)printf("planar %4" PRIu32 "x%-4" PRIu32 " %8" PRIu32 " bytes/frame single thread %8.3f "
+	             "ms/frame thread pool %8.3f ms/frame 24bpp %8.3f ms/frame\n",
+	             width, height, sizes[0], (double)times[0] / frames / 1000000.0,
+	             (double)times[1] / frames / 1000000.0, (double)times[2] / frames / 1000000.0);
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(data); x++)
+		free(data[x]);
+	freerdp_bitmap_planar_context_free(serial);
+	freerdp_bitmap_planar_context_free(threaded);
+	free(decoded);
+	free(image24);
+	free(image);
+	return rc;
+}
+
 int TestFreeRDPCodecPlanar(int argc, char* argv[])
 {
 	int rc = -1;
-	WINPR_UNUSED(argc);
+	/* the full HD and 4K timing runs take a while, they run only when asked for */
+	const BOOL performance = argc > 1;
 	WINPR_UNUSED(argv);
 
 	if (!FuzzPlanar())
@@ -421,6 +555,22 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 			goto fail;
 	}
 
+	/* odd sizes exercise the scalar tails, 333x201 is large enough for the thread pool */
+	const DWORD flags = PLANAR_FORMAT_HEADER_NA | PLANAR_FORMAT_HEADER_RLE;
+	if (!test_planar_threads(333, 201, flags, 1))
+		goto fail;
+	if (!test_planar_threads(333, 201, PLANAR_FORMAT_HEADER_RLE, 1))
+		goto fail;
+	if (!test_planar_threads(21, 7, flags, 1))
+		goto fail;
+	if (performance)
+	{
+		if (!test_planar_threads(1920, 1080, flags, TEST_BENCHMARK_FRAMES))
+			goto fail;
+		if (!test_planar_threads(3840, 2160, flags, TEST_BENCHMARK_FRAMES))
+			goto fail;
+	}
+
 	rc = 0;
 fail:
 	printf("test returned %d\n", rc);
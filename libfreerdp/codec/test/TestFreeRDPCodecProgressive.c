@@ -1116,6 +1116,104 @@ fail:
 	return res;
 }
 
+static double test_mean_abs_error(const wImage* image, const BYTE* data)
+{
+	UINT64 sum = 0;
+	for (size_t y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &data[y * image->scanline];
+		for (size_t x = 0; x < image->width * 4ull; x++)
+		{
+			if ((x % 4) != 3)
+				sum += (UINT64)abs(orig[x] - dec[x]);
+		}
+	}
+	return (double)sum / (3.0 * image->width * image->height);
+}
+
+static BOOL test_encode_decode_multipass(const char* path)
+{
+	BOOL res = FALSE;
+	int rc = 0;
+	BYTE* resultData = nullptr;
+	BYTE* dstData = nullptr;
+	UINT32 dstSize = 0;
+	UINT32 passes = 0;
+	double lastError = 256.0;
+	const UINT32 ColorFormat = PIXEL_FORMAT_BGRX32;
+	REGION16 invalidRegion = WINPR_C_ARRAY_INIT;
+	wImage* image = winpr_image_new();
+	char* name = GetCombinedPath(path, "progressive.bmp");
+	PROGRESSIVE_CONTEXT* progressiveEnc = progressive_context_new(TRUE);
+	PROGRESSIVE_CONTEXT* progressiveDec = progressive_context_new(FALSE);
+
+	region16_init(&invalidRegion);
+	if (!image || !name || !progressiveEnc || !progressiveDec)
+		goto fail;
+
+	rc = winpr_image_read(image, name);
+	if (rc <= 0)
+		goto fail;
+
+	resultData = calloc(image->scanline, image->height);
+	if (!resultData)
+		goto fail;
+
+	rc = progressive_create_surface_context(progressiveDec, 0, image->width, image->height);
+	if (rc <= 0)
+		goto fail;
+
+	rc = progressive_compress_first(progressiveEnc, 0, image->data,
+	                                image->scanline * image->height, ColorFormat, image->width,
+	                                image->height, image->scanline, nullptr, &dstData, &dstSize);
+	while (rc > 0)
+	{
+		rc = progressive_decompress(progressiveDec, dstData, dstSize, resultData, ColorFormat,
+		                            image->scanline, 0, 0, &invalidRegion, 0, passes);
+		if (rc < 0)
+			goto fail;
+
+		/* Upgrades are split in several messages, the error shrinks after each level */
+		const double error = test_mean_abs_error(image, resultData);
+		printf("pass %" PRIu32 ": %" PRIu32 " bytes, mean error %.3f\n", passes, dstSize, error);
+		if (error > lastError)
+			goto fail;
+		lastError = error;
+		passes++;
+
+		rc = progressive_compress_upgrade(progressiveEnc, 0, 16 * 1024, &dstData, &dstSize);
+	}
+	if ((rc < 0) || (passes < 3))
+		goto fail;
+
+	for (size_t y = 0; y < image->height; y++)
+	{
+		const BYTE* orig = &image->data[y * image->scanline];
+		const BYTE* dec = &resultData[y * image->scanline];
+		for (size_t x = 0; x < image->width; x++)
+		{
+			const DWORD a = FreeRDPReadColor(&orig[x * 4], ColorFormat);
+			const DWORD b = FreeRDPReadColor(&dec[x * 4], ColorFormat);
+			if (!colordiff(ColorFormat, a, b))
+			{
+				printf("xxxxxxx [%" PRIuz ":%" PRIuz "] [%s] %08X != %08X\n", x, y,
+				       FreeRDPGetColorFormatName(ColorFormat), a, b);
+				goto fail;
+			}
+		}
+	}
+	res = (lastError < 2.0);
+fail:
+	region16_uninit(&invalidRegion);
+	progressive_context_free(progressiveEnc);
+	progressive_context_free(progressiveDec);
+	winpr_image_free(image, TRUE);
+	free(resultData);
+	free(name);
+	return res;
+}
+
 static BOOL readUInt(FILE* fp, const char* prefix, const char* postfix, UINT32* pval)
 {
 	WINPR_ASSERT(fp);
@@ -1495,6 +1593,8 @@ int TestFreeRDPCodecProgressive(int argc, char* argv[])
 		    */
 		if (!test_encode_decode(ms_sample_path))
 			goto fail;
+		if (!test_encode_decode_multipass(ms_sample_path))
+			goto fail;
 		rc = 0;
 	}
 
@@ -1,9 +1,16 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/rfx.h>
 
+#if defined(BUILD_TESTING_INTERNAL)
+#include "../rfx_rlgr.h"
+#endif
+
+#include "TestFreeRDPHelpers.h"
+
 static BYTE encodeHeaderSample[] = {
 	/* as in 4.2.2 */
 	0xc0, 0xcc, 0x0c, 0x00, 0x00, 0x00, 0xca, 0xac, 0xcc, 0xca, 0x00, 0x01, 0xc3, 0xcc, 0x0d, 0x00,
@@ -842,6 +849,347 @@ static BOOL fuzzyCompareImage(const UINT32* crefImage, const BYTE* img, size_t n
 	return TRUE;
 }
 
+#define THREAD_TEST_WIDTH 328
+#define THREAD_TEST_HEIGHT 200
+
+/* Encode and decode a multi tile frame with ThreadingFlags, the result must not depend on
+ * the threading mode. */
+static BOOL test_rfx_encode_decode(UINT32 ThreadingFlags, const BYTE* image, wStream* s,
+                                   BYTE* decoded)
+{
+	BOOL rc = FALSE;
+	const UINT32 stride = THREAD_TEST_WIDTH * FORMAT_SIZE;
+	const RFX_RECT rect = { 0, 0, THREAD_TEST_WIDTH, THREAD_TEST_HEIGHT };
+	REGION16 region = WINPR_C_ARRAY_INIT;
+	RFX_MESSAGE* message = nullptr;
+	RFX_CONTEXT* encoder = rfx_context_new_ex(TRUE, ThreadingFlags);
+	RFX_CONTEXT* decoder = rfx_context_new_ex(FALSE, ThreadingFlags);
+
+	region16_init(&region);
+	if (!encoder || !decoder)
+		goto fail;
+
+	if (!rfx_context_reset(encoder, THREAD_TEST_WIDTH, THREAD_TEST_HEIGHT))
+		goto fail;
+	rfx_context_set_pixel_format(encoder, FORMAT);
+
+	message = rfx_encode_message(encoder, &rect, 1, image, THREAD_TEST_WIDTH, THREAD_TEST_HEIGHT,
+	                             stride);
+	if (!message)
+		goto fail;
+
+	Stream_SetPosition(s, 0);
+	if (!rfx_write_message(encoder, s, message))
+		goto fail;
+
+	if (!rfx_process_message(decoder, Stream_Buffer(s), Stream_GetPosition(s), 0, 0, decoded,
+	                         FORMAT, stride, THREAD_TEST_HEIGHT, &region))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	region16_uninit(&region);
+	rfx_message_free(encoder, message);
+	rfx_context_free(encoder);
+	rfx_context_free(decoder);
+	return rc;
+}
+
+static BOOL test_rfx_threads(void)
+{
+	BOOL rc = FALSE;
+	const size_t size = 1ull * THREAD_TEST_WIDTH * THREAD_TEST_HEIGHT * FORMAT_SIZE;
+	BYTE* image = calloc(size, 1);
+	BYTE* serial = calloc(size, 1);
+	BYTE* threaded = calloc(size, 1);
+	wStream* serialStream = Stream_New(nullptr, 1024);
+	wStream* threadedStream = Stream_New(nullptr, 1024);
+
+	if (!image || !serial || !threaded || !serialStream || !threadedStream)
+		goto fail;
+
+	for (size_t y = 0; y < THREAD_TEST_HEIGHT; y++)
+	{
+		for (size_t x = 0; x < THREAD_TEST_WIDTH; x++)
+		{
+			BYTE* px = &image[(y * THREAD_TEST_WIDTH + x) * FORMAT_SIZE];
+			px[0] = (BYTE)(x * 3 + y);
+			px[1] = (BYTE)((x ^ y) * 7);
+			px[2] = (BYTE)(y * 5 - x);
+			px[3] = 0xFF;
+		}
+	}
+
+	if (!test_rfx_encode_decode(THREADING_FLAGS_DISABLE_THREADS, image, serialStream, serial))
+		goto fail;
+	if (!test_rfx_encode_decode(0, image, threadedStream, threaded))
+		goto fail;
+
+	if ((Stream_GetPosition(serialStream) != Stream_GetPosition(threadedStream)) ||
+	    (memcmp(Stream_Buffer(serialStream), Stream_Buffer(threadedStream),
+	            Stream_GetPosition(serialStream)) != 0))
+	{
+		(void)fprintf(stderr, "threaded encoder output differs\n");
+		goto fail;
+	}
+
+	if (memcmp(serial, threaded, size) != 0)
+	{
+		(void)fprintf(stderr, "threaded decoder output differs\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	Stream_Free(serialStream, TRUE);
+	Stream_Free(threadedStream, TRUE);
+	free(image);
+	free(serial);
+	free(threaded);
+	return rc;
+}
+
+#if defined(BUILD_TESTING_INTERNAL)
+#define RLGR_TEST_COEFFS 4096
+#define RLGR_TEST_BUFFER 8192
+
+typedef int (*rlgr_encode_fn)(RLGR_MODE mode, const INT16* data, UINT32 data_size, BYTE* buffer,
+                              UINT32 buffer_size);
+typedef int (*rlgr_decode_fn)(RLGR_MODE mode, const BYTE* pSrcData, UINT32 SrcSize,
+                              INT16* pDstData, UINT32 rDstSize);
+
+/* Coefficients resembling a quantized tile: zero runs of varying length, mostly small values */
+static void fill_coefficients(UINT32* state, INT16* data, size_t count, UINT32 range)
+{
+	const UINT32 density = 1 + test_codec_helper_rand(state) % 7;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const UINT32 r = test_codec_helper_rand(state);
+		INT32 value = 0;
+
+		if ((r % 512) == 0)
+		{
+			/* a long zero run, saturates the run length parameter */
+			const size_t run = MIN(count - x, 64 + (r >> 9) % 1024);
+			memset(&data[x], 0, run * sizeof(INT16));
+			x += run - 1;
+			continue;
+		}
+
+		if ((r % 8) < density)
+		{
+			const UINT32 mag = ((r % 32) == 0) ? (r >> 8) % (range + 1) : (r >> 8) % MIN(range, 4);
+			value = (r & 0x80) ? -(INT32)mag : (INT32)mag;
+		}
+
+		data[x] = (INT16)MAX(INT16_MIN, MIN(INT16_MAX, value));
+	}
+}
+
+static BOOL test_rlgr_encode_compare(RLGR_MODE mode, const INT16* data, UINT32 count,
+                                     UINT32 size, BYTE fill)
+{
+	BYTE ref[RLGR_TEST_BUFFER] = WINPR_C_ARRAY_INIT;
+	BYTE fast[RLGR_TEST_BUFFER] = WINPR_C_ARRAY_INIT;
+
+	memset(ref, fill, sizeof(ref));
+	memset(fast, fill, sizeof(fast));
+
+	const int rcRef = rfx_rlgr_encode_reference(mode, data, count, ref, size);
+	const int rcFast = rfx_rlgr_encode(mode, data, count, fast, size);
+
+	if ((rcRef != rcFast) || (memcmp(ref, fast, sizeof(ref)) != 0))
+	{
+		(void)fprintf(stderr,
+		              "RLGR%d encode mismatch: %" PRIu32 " coefficients, %" PRIu32
+		              " byte buffer, %d != %d\n",
+		              (mode == RLGR1) ? 1 : 3, count, size, rcRef, rcFast);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_rlgr_decode_compare(RLGR_MODE mode, const BYTE* src, UINT32 size, UINT32 count)
+{
+	INT16 ref[RLGR_TEST_COEFFS] = WINPR_C_ARRAY_INIT;
+	INT16 fast[RLGR_TEST_COEFFS] = WINPR_C_ARRAY_INIT;
+
+	/* both implementations must overwrite the whole output */
+	memset(ref, 0x11, sizeof(ref));
+	memset(fast, 0x22, sizeof(fast));
+
+	const int rcRef = rfx_rlgr_decode_reference(mode, src, size, ref, count);
+	const int rcFast = rfx_rlgr_decode(mode, src, size, fast, count);
+
+	if ((rcRef != rcFast) || (memcmp(ref, fast, count * sizeof(INT16)) != 0))
+	{
+		(void)fprintf(stderr,
+		              "RLGR%d decode mismatch: %" PRIu32 " bytes, %" PRIu32
+		              " coefficients, %d != %d\n",
+		              (mode == RLGR1) ? 1 : 3, size, count, rcRef, rcFast);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_rlgr_fuzz(void)
+{
+	UINT32 state = 0x52464758;
+	INT16 coeffs[RLGR_TEST_COEFFS] = WINPR_C_ARRAY_INIT;
+	INT16 decoded[RLGR_TEST_COEFFS] = WINPR_C_ARRAY_INIT;
+	BYTE encoded[RLGR_TEST_BUFFER] = WINPR_C_ARRAY_INIT;
+	BYTE mutated[RLGR_TEST_BUFFER] = WINPR_C_ARRAY_INIT;
+
+	for (UINT32 iteration = 0; iteration < 512; iteration++)
+	{
+		const RLGR_MODE mode = (iteration & 1) ? RLGR3 : RLGR1;
+		const UINT32 count = (iteration % 5 == 0)
+		                         ? RLGR_TEST_COEFFS
+		                         : 1 + test_codec_helper_rand(&state) % RLGR_TEST_COEFFS;
+		/* corrupted RLGR1 streams are only decoded from small values, longer runs of 1 bits
+		 * overflow the 16 bit code which the reference implementation asserts on */
+		const BOOL corrupt = (mode == RLGR1) && (iteration % 4 == 0);
+		/* the reference decoder asserts on INT16_MIN and on RLGR3 sums above INT16_MAX */
+		const UINT32 limit = (mode == RLGR1) ? INT16_MAX : 8191;
+		const UINT32 range = corrupt ? 15 : ((iteration % 3 == 0) ? limit : 2048);
+
+		fill_coefficients(&state, coeffs, count, range);
+
+		if (!test_rlgr_encode_compare(mode, coeffs, count, RLGR_TEST_BUFFER, 0))
+			return FALSE;
+		if (!test_rlgr_encode_compare(mode, coeffs, count,
+		                              test_codec_helper_rand(&state) % 2048, 0))
+			return FALSE;
+		if (!test_rlgr_encode_compare(mode, coeffs, count, RLGR_TEST_BUFFER, 0xA5))
+			return FALSE;
+
+		memset(encoded, 0, sizeof(encoded));
+		const int length = rfx_rlgr_encode(mode, coeffs, count, encoded, sizeof(encoded));
+		if (length <= 0)
+			return FALSE;
+
+		/* roundtrip unless the output was truncated,
+		 * a trailing zero coded in run length mode decodes as 1 */
+		if (rfx_rlgr_decode(mode, encoded, (UINT32)length, decoded, count) < 0)
+			return FALSE;
+		if ((length < RLGR_TEST_BUFFER) && (coeffs[count - 1] != 0) &&
+		    (memcmp(coeffs, decoded, count * sizeof(INT16)) != 0))
+		{
+			(void)fprintf(stderr, "RLGR%d roundtrip mismatch: %" PRIu32 " coefficients\n",
+			              (mode == RLGR1) ? 1 : 3, count);
+			return FALSE;
+		}
+
+		if (!test_rlgr_decode_compare(mode, encoded, (UINT32)length, count))
+			return FALSE;
+		if (!test_rlgr_decode_compare(mode, encoded, (UINT32)length, RLGR_TEST_COEFFS))
+			return FALSE;
+		if (!test_rlgr_decode_compare(mode, encoded,
+		                              1 + test_codec_helper_rand(&state) % (UINT32)length, count))
+			return FALSE;
+
+		coeffs[test_codec_helper_rand(&state) % count] = INT16_MIN;
+		if (!test_rlgr_encode_compare(mode, coeffs, count, RLGR_TEST_BUFFER, 0))
+			return FALSE;
+
+		if (!corrupt)
+			continue;
+
+		for (size_t x = 0; x < 16; x++)
+		{
+			memcpy(mutated, encoded, (size_t)length);
+			for (size_t y = 0; y < 1 + x % 4; y++)
+			{
+				const UINT32 bit = test_codec_helper_rand(&state) % (8u * (UINT32)length);
+				mutated[bit / 8] ^= (BYTE)(0x80 >> (bit % 8));
+			}
+
+			if (!test_rlgr_decode_compare(mode, mutated, (UINT32)length, RLGR_TEST_COEFFS))
+				return FALSE;
+		}
+
+		for (size_t x = 0; x < sizeof(mutated); x++)
+			mutated[x] = (BYTE)test_codec_helper_rand(&state);
+
+		if (!test_rlgr_decode_compare(mode, mutated,
+		                              1 + test_codec_helper_rand(&state) % sizeof(mutated), count))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_rlgr_benchmark_run(const char* name, rlgr_encode_fn encode, rlgr_decode_fn decode,
+                                    const INT16* coeffs, size_t tiles)
+{
+	BOOL rc = FALSE;
+	BYTE* buffer = calloc(3, RLGR_TEST_BUFFER);
+	INT16* decoded = calloc(RLGR_TEST_COEFFS, sizeof(INT16));
+	int length[3] = WINPR_C_ARRAY_INIT;
+
+	if (!buffer || !decoded)
+		goto fail;
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < tiles; x++)
+	{
+		for (size_t c = 0; c < 3; c++)
+		{
+			BYTE* dst = &buffer[c * RLGR_TEST_BUFFER];
+
+			memset(dst, 0, RLGR_TEST_BUFFER);
+			length[c] = encode(RLGR1, &coeffs[c * RLGR_TEST_COEFFS], RLGR_TEST_COEFFS, dst,
+			                   RLGR_TEST_BUFFER);
+			if (length[c] <= 0)
+				goto fail;
+		}
+	}
+
+	const UINT64 encoded = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < tiles; x++)
+	{
+		for (size_t c = 0; c < 3; c++)
+		{
+			if (decode(RLGR1, &buffer[c * RLGR_TEST_BUFFER], (UINT32)length[c], decoded,
+			           RLGR_TEST_COEFFS) < 0)
+				goto fail;
+		}
+	}
+
+	const UINT64 decoded_end = winpr_GetTickCount64NS();
+	const double encodeSec = (double)MAX(encoded - start, 1) / 1000000000.0;
+	const double decodeSec = (double)MAX(decoded_end - encoded, 1) / 1000000000.0;
+
+	(void)printf("RLGR1 %s: encode %.0f tiles/sec, decode %.0f tiles/sec\n", name,
+	             (double)tiles / encodeSec, (double)tiles / decodeSec);
+	rc = TRUE;
+fail:
+	free(buffer);
+	free(decoded);
+	return rc;
+}
+
+static BOOL test_rlgr_benchmark(void)
+{
+	UINT32 state = 0x54494c45;
+	INT16* coeffs = calloc(3ull * RLGR_TEST_COEFFS, sizeof(INT16));
+
+	if (!coeffs)
+		return FALSE;
+
+	for (size_t c = 0; c < 3; c++)
+		fill_coefficients(&state, &coeffs[c * RLGR_TEST_COEFFS], RLGR_TEST_COEFFS, 1024);
+
+	const BOOL rc =
+	    test_rlgr_benchmark_run("reference", rfx_rlgr_encode_reference, rfx_rlgr_decode_reference,
+	                            coeffs, 256) &&
+	    test_rlgr_benchmark_run("fast", rfx_rlgr_encode, rfx_rlgr_decode, coeffs, 256);
+	free(coeffs);
+	return rc;
+}
+#endif
+
 int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 {
 	int rc = -1;
@@ -853,6 +1201,14 @@ int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 	WINPR_UNUSED(argc);
 	WINPR_UNUSED(argv);
 
+#if defined(BUILD_TESTING_INTERNAL)
+	if (!test_rlgr_fuzz() || !test_rlgr_benchmark())
+		goto fail;
+#endif
+
+	if (!test_rfx_threads())
+		goto fail;
+
 	/* use default threading options here, pass zero as
 	 * ThreadingFlags */
 	context = rfx_context_new(FALSE);
@@ -0,0 +1,498 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Image Scaling Tests
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/config.h>
+#include <freerdp/codec/color.h>
+
+#if defined(WITH_SWSCALE) && !defined(WITH_SWSCALE_LOADING)
+#include <libswscale/swscale.h>
+#endif
+
+#if defined(BUILD_TESTING_INTERNAL)
+#include "../image_scale.h"
+#endif
+
+#include "TestFreeRDPHelpers.h"
+
+#define TEST_BENCHMARK_FRAMES 3
+
+/* BGRA32 image with gradients, flat areas and noise */
+static BYTE* test_image(UINT32 width, UINT32 height, UINT32 seed)
+{
+	UINT32 state = seed;
+	BYTE* data = calloc(1ull * width * height, 4);
+	if (!data)
+		return nullptr;
+
+	for (size_t y = 0; y < height; y++)
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			BYTE* px = &data[(y * width + x) * 4];
+			px[0] = (BYTE)(x * 255 / width);
+			px[1] = (BYTE)(y * 255 / height);
+			px[2] = ((x / 16 + y / 16) % 2) ? 0x20 : 0xE0;
+			px[3] = (BYTE)test_codec_helper_rand(&state);
+		}
+	}
+
+	return data;
+}
+
+static double test_kernel(FREERDP_IMAGE_SCALE_FILTER filter, double x)
+{
+	x = fabs(x);
+	if (filter == FREERDP_IMAGE_SCALE_BICUBIC)
+	{
+		if (x < 1.0)
+			return (1.5 * x - 2.5) * x * x + 1.0;
+		if (x < 2.0)
+			return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+		return 0.0;
+	}
+	return (x < 1.0) ? 1.0 - x : 0.0;
+}
+
+/* Floating point weight of source position \b pos for destination position \b x */
+static void test_weights(FREERDP_IMAGE_SCALE_FILTER filter, UINT32 srcSize, UINT32 dstSize,
+                         UINT32 x, double* weights)
+{
+	const double scale = (double)srcSize / (double)dstSize;
+	const double stretch = MAX(1.0, scale);
+	const double support = ((filter == FREERDP_IMAGE_SCALE_BICUBIC) ? 2.0 : 1.0) * stretch;
+	const double center = ((double)x + 0.5) * scale - 0.5;
+	double sum = 0.0;
+
+	memset(weights, 0, srcSize * sizeof(double));
+	for (INT64 pos = (INT64)floor(center - support); pos <= (INT64)ceil(center + support); pos++)
+	{
+		const double k = test_kernel(filter, ((double)pos - center) / stretch);
+		weights[MAX(0, MIN(pos, (INT64)srcSize - 1))] += k;
+		sum += k;
+	}
+
+	for (size_t i = 0; i < srcSize; i++)
+		weights[i] /= sum;
+}
+
+/* Compare against a straightforward floating point implementation of the same filter */
+static BOOL test_scale_reference(FREERDP_IMAGE_SCALE_FILTER filter, UINT32 sw, UINT32 sh,
+                                 UINT32 dw, UINT32 dh)
+{
+	BOOL rc = FALSE;
+	BYTE* src = test_image(sw, sh, sw ^ dh);
+	BYTE* dst = calloc(1ull * dw * dh, 4);
+	double* wx = calloc(1ull * dw * sw, sizeof(double));
+	double* wy = calloc(1ull * dh * sh, sizeof(double));
+	FREERDP_IMAGE_SCALER* scaler = freerdp_image_scaler_new(filter);
+
+	if (!src || !dst || !wx || !wy || !scaler)
+		goto fail;
+
+	if (!freerdp_image_scaler_set_size(scaler, sw, sh, dw, dh))
+		goto fail;
+
+	if (!freerdp_image_scaler_scale(scaler, dst, PIXEL_FORMAT_BGRA32, 0, 0, 0, src,
+	                                PIXEL_FORMAT_BGRA32, 0, 0, 0, nullptr))
+		goto fail;
+
+	for (UINT32 x = 0; x < dw; x++)
+		test_weights(filter, sw, dw, x, &wx[1ull * x * sw]);
+	for (UINT32 y = 0; y < dh; y++)
+		test_weights(filter, sh, dh, y, &wy[1ull * y * sh]);
+
+	for (size_t y = 0; y < dh; y++)
+	{
+		for (size_t x = 0; x < dw; x++)
+		{
+			for (size_t c = 0; c < 4; c++)
+			{
+				double v = 0.0;
+				for (size_t sy = 0; sy < sh; sy++)
+				{
+					const double w = wy[y * sh + sy];
+					if (w == 0.0)
+						continue;
+					for (size_t sx = 0; sx < sw; sx++)
+						v += w * wx[x * sw + sx] * src[(sy * sw + sx) * 4 + c];
+				}
+
+				const double expect = MAX(0.0, MIN(255.0, v));
+				const BYTE got = dst[(y * dw + x) * 4 + c];
+				if (fabs(expect - got) > 1.5)
+				{
+					(void)fprintf(stderr,
+					              "%" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32
+					              " filter %d: pixel %" PRIuz "x%" PRIuz " channel %" PRIuz
+					              " is %" PRIu8 ", expected %.2f\n",
+					              sw, sh, dw, dh, filter, x, y, c, got, expect);
+					goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	freerdp_image_scaler_free(scaler);
+	free(wx);
+	free(wy);
+	free(dst);
+	free(src);
+	return rc;
+}
+
+/* Rescaling the mapped area of a changed source rectangle must give the same image as
+ * rescaling everything */
+static BOOL test_scale_dirty(FREERDP_IMAGE_SCALE_FILTER filter, UINT32 sw, UINT32 sh, UINT32 dw,
+                             UINT32 dh)
+{
+	BOOL rc = FALSE;
+	UINT32 state = 0x5ca1e;
+	BYTE* src = test_image(sw, sh, 7);
+	BYTE* full = calloc(1ull * dw * dh, 4);
+	BYTE* partial = calloc(1ull * dw * dh, 4);
+	FREERDP_IMAGE_SCALER* scaler = freerdp_image_scaler_new(filter);
+
+	if (!src || !full || !partial || !scaler)
+		goto fail;
+
+	if (!freerdp_image_scaler_set_size(scaler, sw, sh, dw, dh))
+		goto fail;
+
+	if (!freerdp_image_scaler_scale(scaler, partial, PIXEL_FORMAT_BGRX32, 0, 0, 0, src,
+	                                PIXEL_FORMAT_BGRX32, 0, 0, 0, nullptr))
+		goto fail;
+
+	for (size_t iteration = 0; iteration < 20; iteration++)
+	{
+		const UINT16 left = (UINT16)(test_codec_helper_rand(&state) % sw);
+		const UINT16 top = (UINT16)(test_codec_helper_rand(&state) % sh);
+		const UINT16 right = (UINT16)(left + 1 + test_codec_helper_rand(&state) % (sw - left));
+		const UINT16 bottom = (UINT16)(top + 1 + test_codec_helper_rand(&state) % (sh - top));
+		const RECTANGLE_16 changed = { left, top, right, bottom };
+		RECTANGLE_16 area = WINPR_C_ARRAY_INIT;
+
+		for (size_t y = changed.top; y < changed.bottom; y++)
+		{
+			for (size_t x = changed.left; x < changed.right; x++)
+			{
+				const UINT32 r = test_codec_helper_rand(&state);
+				memcpy(&src[(y * sw + x) * 4], &r, sizeof(r));
+			}
+		}
+
+		if (!freerdp_image_scaler_map_rect(scaler, &changed, &area))
+			goto fail;
+
+		if (!freerdp_image_scaler_scale(scaler, partial, PIXEL_FORMAT_BGRX32, 0, 0, 0, src,
+		                                PIXEL_FORMAT_BGRX32, 0, 0, 0, &area))
+			goto fail;
+
+		if (!freerdp_image_scaler_scale(scaler, full, PIXEL_FORMAT_BGRX32, 0, 0, 0, src,
+		                                PIXEL_FORMAT_BGRX32, 0, 0, 0, nullptr))
+			goto fail;
+
+		if (memcmp(full, partial, 4ull * dw * dh) != 0)
+		{
+			(void)fprintf(stderr,
+			              "dirty rescale of %" PRIu16 "x%" PRIu16 "-%" PRIu16 "x%" PRIu16
+			              " differs from full rescale\n",
+			              changed.left, changed.top, changed.right, changed.bottom);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	freerdp_image_scaler_free(scaler);
+	free(partial);
+	free(full);
+	free(src);
+	return rc;
+}
+
+/* Sources and destinations in other formats go through a line conversion */
+static BOOL test_scale_formats(void)
+{
+	const UINT32 sw = 97;
+	const UINT32 sh = 61;
+	const UINT32 dw = 150;
+	const UINT32 dh = 40;
+	BOOL rc = FALSE;
+	BYTE* src = test_image(sw, sh, 3);
+	BYTE* src24 = calloc(1ull * sw * sh, 3);
+	BYTE* expect = calloc(1ull * dw * dh, 4);
+	BYTE* dst = calloc(1ull * dw * dh, 4);
+	BYTE* dst24 = calloc(1ull * dw * dh, 3);
+
+	if (!src || !src24 || !expect || !dst || !dst24)
+		goto fail;
+
+	if (!freerdp_image_copy_no_overlap(src24, PIXEL_FORMAT_BGR24, 0, 0, 0, sw, sh, src,
+	                                   PIXEL_FORMAT_BGRX32, 0, 0, 0, nullptr, FREERDP_FLIP_NONE))
+		goto fail;
+
+	if (!freerdp_image_scale(expect, PIXEL_FORMAT_BGRX32, 0, 0, 0, dw, dh, src,
+	                         PIXEL_FORMAT_BGRX32, 0, 0, 0, sw, sh))
+		goto fail;
+
+	/* a 24bpp source is filtered as 32bpp with opaque alpha */
+	if (!freerdp_image_scale(dst, PIXEL_FORMAT_BGRX32, 0, 0, 0, dw, dh, src24, PIXEL_FORMAT_BGR24,
+	                         0, 0, 0, sw, sh))
+		goto fail;
+
+	for (size_t x = 0; x < 4ull * dw * dh; x++)
+	{
+		if (((x % 4) != 3) && (dst[x] != expect[x]))
+		{
+			(void)fprintf(stderr, "24bpp source differs at pixel %" PRIuz "\n", x / 4);
+			goto fail;
+		}
+	}
+
+	if (!freerdp_image_scale(dst24, PIXEL_FORMAT_BGR24, 0, 0, 0, dw, dh, src,
+	                         PIXEL_FORMAT_BGRX32, 0, 0, 0, sw, sh))
+		goto fail;
+
+	for (size_t x = 0; x < 1ull * dw * dh; x++)
+	{
+		if (memcmp(&dst24[x * 3], &expect[x * 4], 3) != 0)
+		{
+			(void)fprintf(stderr, "24bpp destination differs at pixel %" PRIuz "\n", x);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(dst24);
+	free(dst);
+	free(expect);
+	free(src24);
+	free(src);
+	return rc;
+}
+
+#if defined(BUILD_TESTING_INTERNAL)
+/* The vector kernels must give the same result as the portable ones */
+static BOOL test_scale_kernels(void)
+{
+	const FREERDP_IMAGE_SCALE_KERNELS* generic = freerdp_image_scale_get_kernels_generic();
+	const FREERDP_IMAGE_SCALE_KERNELS* optimized = freerdp_image_scale_get_kernels();
+	UINT32 state = 0x6b726e;
+	BYTE src[4 * 256] = WINPR_C_ARRAY_INIT;
+	UINT32 offsets[64] = WINPR_C_ARRAY_INIT;
+	INT16 weights[64 * 10] = WINPR_C_ARRAY_INIT;
+	INT16 rows[9][4 * 64] = WINPR_C_ARRAY_INIT;
+	const INT16* taps[9] = WINPR_C_ARRAY_INIT;
+	INT16 expectRow[4 * 64] = WINPR_C_ARRAY_INIT;
+	INT16 row[4 * 64] = WINPR_C_ARRAY_INIT;
+	BYTE expect[4 * 64] = WINPR_C_ARRAY_INIT;
+	BYTE out[4 * 64] = WINPR_C_ARRAY_INIT;
+
+	for (size_t iteration = 0; iteration < 200; iteration++)
+	{
+		const UINT32 ntaps = 1 + test_codec_helper_rand(&state) % 9;
+		const UINT32 stride = image_scale_weight_stride(ntaps);
+		const UINT32 count = 1 + test_codec_helper_rand(&state) % 64;
+
+		for (size_t x = 0; x < sizeof(src); x++)
+			src[x] = (BYTE)test_codec_helper_rand(&state);
+
+		/* weights with negative lobes as the bicubic filter has them */
+		for (size_t x = 0; x < count; x++)
+		{
+			offsets[x] = test_codec_helper_rand(&state) % (256 - ntaps);
+			for (size_t t = 0; t < stride; t++)
+			{
+				const INT32 w = (INT32)(test_codec_helper_rand(&state) % 12000) - 2000;
+				weights[x * stride + t] = (t < ntaps) ? (INT16)w : 0;
+			}
+		}
+
+		generic->hscale(src, expectRow, offsets, weights, ntaps, count);
+		optimized->hscale(src, row, offsets, weights, ntaps, count);
+		if (memcmp(expectRow, row, 4ull * count * sizeof(INT16)) != 0)
+		{
+			(void)fprintf(stderr, "hscale mismatch for %" PRIu32 " taps\n", ntaps);
+			return FALSE;
+		}
+
+		for (size_t t = 0; t < ntaps; t++)
+		{
+			for (size_t x = 0; x < 4ull * count; x++)
+				rows[t][x] = (INT16)((INT32)(test_codec_helper_rand(&state) % 20000) - 2000);
+			taps[t] = rows[t];
+		}
+
+		generic->vscale(taps, weights, ntaps, expect, 4 * count);
+		optimized->vscale(taps, weights, ntaps, out, 4 * count);
+		if (memcmp(expect, out, 4ull * count) != 0)
+		{
+			(void)fprintf(stderr, "vscale mismatch for %" PRIu32 " taps\n", ntaps);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+#endif
+
+#if defined(WITH_SWSCALE) && !defined(WITH_SWSCALE_LOADING)
+static double test_benchmark_swscale(const BYTE* src, UINT32 sw, UINT32 sh, BYTE* dst, UINT32 dw,
+                                     UINT32 dh)
+{
+	UINT64 total = 0;
+
+	for (size_t frame = 0; frame < TEST_BENCHMARK_FRAMES; frame++)
+	{
+		const UINT64 start = winpr_GetUnixTimeNS();
+
+		/* the context is created per call, as freerdp_image_scale used to do */
+		struct SwsContext* sws =
+		    sws_getContext((int)sw, (int)sh, AV_PIX_FMT_BGRA, (int)dw, (int)dh, AV_PIX_FMT_BGRA,
+		                   SWS_BILINEAR, nullptr, nullptr, nullptr);
+		if (!sws)
+			return -1.0;
+
+		const uint8_t* srcSlice[4] = { src, nullptr, nullptr, nullptr };
+		uint8_t* dstSlice[4] = { dst, nullptr, nullptr, nullptr };
+		const int srcSteps[4] = { (int)sw * 4, 0, 0, 0 };
+		const int dstSteps[4] = { (int)dw * 4, 0, 0, 0 };
+		const int res = sws_scale(sws, srcSlice, srcSteps, 0, (int)sh, dstSlice, dstSteps);
+		sws_freeContext(sws);
+		if (res != (int)dh)
+			return -1.0;
+
+		total += winpr_GetUnixTimeNS() - start;
+	}
+
+	return (double)total / TEST_BENCHMARK_FRAMES / 1000000.0;
+}
+#endif
+
+static BOOL test_scale_benchmark(FREERDP_IMAGE_SCALE_FILTER filter, UINT32 sw, UINT32 sh,
+                                 UINT32 dw, UINT32 dh)
+{
+	BOOL rc = FALSE;
+	UINT64 times[3] = WINPR_C_ARRAY_INIT;
+	BYTE* src = test_image(sw, sh, 11);
+	BYTE* dst = calloc(1ull * dw * dh, 4);
+	FREERDP_IMAGE_SCALER* scaler = freerdp_image_scaler_new(filter);
+
+	if (!src || !dst || !scaler)
+		goto fail;
+
+	for (size_t frame = 0; frame < TEST_BENCHMARK_FRAMES; frame++)
+	{
+		/* a changing 64x64 area, e.g. a blinking cursor or a progress bar */
+		const RECTANGLE_16 changed = { (UINT16)(sw / 2 + 64 * frame), (UINT16)(sh / 2),
+			                           (UINT16)(sw / 2 + 64 * frame + 64), (UINT16)(sh / 2 + 64) };
+		RECTANGLE_16 area = WINPR_C_ARRAY_INIT;
+
+		UINT64 start = winpr_GetUnixTimeNS();
+		if (filter == FREERDP_IMAGE_SCALE_BILINEAR)
+		{
+			if (!freerdp_image_scale(dst, PIXEL_FORMAT_BGRA32, 0, 0, 0, dw, dh, src,
+			                         PIXEL_FORMAT_BGRA32, 0, 0, 0, sw, sh))
+				goto fail;
+		}
+		times[0] += winpr_GetUnixTimeNS() - start;
+
+		start = winpr_GetUnixTimeNS();
+		if (!freerdp_image_scaler_set_size(scaler, sw, sh, dw, dh) ||
+		    !freerdp_image_scaler_scale(scaler, dst, PIXEL_FORMAT_BGRA32, 0, 0, 0, src,
+		                                PIXEL_FORMAT_BGRA32, 0, 0, 0, nullptr))
+			goto fail;
+		times[1] += winpr_GetUnixTimeNS() - start;
+
+		start = winpr_GetUnixTimeNS();
+		if (!freerdp_image_scaler_map_rect(scaler, &changed, &area) ||
+		    !freerdp_image_scaler_scale(scaler, dst, PIXEL_FORMAT_BGRA32, 0, 0, 0, src,
+		                                PIXEL_FORMAT_BGRA32, 0, 0, 0, &area))
+			goto fail;
+		times[2] += winpr_GetUnixTimeNS() - start;
+	}
+
+	(void)printf("scale %s %" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32
+	             ": freerdp_image_scale %8.3f ms scaler %8.3f ms 64x64 dirty %8.3f ms\n",
+	             (filter == FREERDP_IMAGE_SCALE_BICUBIC) ? "bicubic " : "bilinear", sw, sh, dw, dh,
+	             (double)times[0] / TEST_BENCHMARK_FRAMES / 1000000.0,
+	             (double)times[1] / TEST_BENCHMARK_FRAMES / 1000000.0,
+	             (double)times[2] / TEST_BENCHMARK_FRAMES / 1000000.0);
+
+#if defined(WITH_SWSCALE) && !defined(WITH_SWSCALE_LOADING)
+	if (filter == FREERDP_IMAGE_SCALE_BILINEAR)
+		(void)printf("swscale  %" PRIu32 "x%" PRIu32 " -> %" PRIu32 "x%" PRIu32 ": %8.3f ms\n",
+		             sw, sh, dw, dh, test_benchmark_swscale(src, sw, sh, dst, dw, dh));
+#endif
+
+	rc = TRUE;
+fail:
+	freerdp_image_scaler_free(scaler);
+	free(dst);
+	free(src);
+	return rc;
+}
+
+int TestFreeRDPCodecScale(int argc, char* argv[])
+{
+	/* the 4K timing runs take a while, they run only when asked for */
+	const BOOL performance = argc > 1;
+	WINPR_UNUSED(argv);
+
+#if defined(BUILD_TESTING_INTERNAL)
+	if (!test_scale_kernels())
+		return -1;
+#endif
+
+	const FREERDP_IMAGE_SCALE_FILTER filters[] = { FREERDP_IMAGE_SCALE_BILINEAR,
+		                                           FREERDP_IMAGE_SCALE_BICUBIC };
+	for (size_t x = 0; x < ARRAYSIZE(filters); x++)
+	{
+		/* up, down, mixed and degenerate sizes */
+		if (!test_scale_reference(filters[x], 37, 23, 80, 51))
+			return -1;
+		if (!test_scale_reference(filters[x], 97, 61, 40, 17))
+			return -1;
+		if (!test_scale_reference(filters[x], 64, 48, 61, 97))
+			return -1;
+		if (!test_scale_reference(filters[x], 1, 3, 5, 2))
+			return -1;
+
+		if (!test_scale_dirty(filters[x], 301, 173, 199, 257))
+			return -1;
+	}
+
+	if (!test_scale_formats())
+		return -1;
+
+	for (size_t x = 0; performance && (x < ARRAYSIZE(filters)); x++)
+	{
+		if (!test_scale_benchmark(filters[x], 3840, 2160, 1920, 1080))
+			return -1;
+	}
+
+	return 0;
+}
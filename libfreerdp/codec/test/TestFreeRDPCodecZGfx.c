@@ -1,6 +1,10 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/image.h>
+#include <winpr/path.h>
+#include <winpr/sysinfo.h>
+#include <winpr/crypto.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/zgfx.h>
@@ -253,6 +257,181 @@ fail:
 	return rc;
 }
 
+static BOOL test_ZGfxRoundTripPdu(ZGFX_CONTEXT* compressor, ZGFX_CONTEXT* decompressor,
+                                  const BYTE* pSrcData, UINT32 SrcSize, size_t* pCompressed,
+                                  UINT64* pTimeNS)
+{
+	BOOL rc = FALSE;
+	UINT32 Flags = 0;
+	UINT32 DstSize = 0;
+	BYTE* pDstData = nullptr;
+	UINT32 OutSize = 0;
+	BYTE* pOutData = nullptr;
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	if (zgfx_compress(compressor, pSrcData, SrcSize, &pDstData, &DstSize, &Flags) < 0)
+		goto fail;
+	*pTimeNS += winpr_GetTickCount64NS() - start;
+	*pCompressed += DstSize;
+
+	if (zgfx_decompress(decompressor, pDstData, DstSize, &pOutData, &OutSize, 0) < 0)
+	{
+		printf("%s: decompression failed\n", __func__);
+		goto fail;
+	}
+
+	if ((OutSize != SrcSize) || (memcmp(pOutData, pSrcData, SrcSize) != 0))
+	{
+		printf("%s: output mismatch (%" PRIu32 " != %" PRIu32 ")\n", __func__, OutSize,
+		       SrcSize);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(pDstData);
+	free(pOutData);
+	return rc;
+}
+
+static int test_ZGfxCompressLevel(UINT32 level, const wImage* image)
+{
+	int rc = -1;
+	size_t total = 0;
+	size_t compressed = 0;
+	UINT64 timeNS = 0;
+	BYTE* pdu = nullptr;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!compressor || !decompressor)
+		goto fail;
+
+	if (!zgfx_context_set_compression_level(compressor, level))
+		goto fail;
+
+	if (zgfx_context_get_compression_level(compressor) != level)
+		goto fail;
+
+	pdu = calloc(image->scanline, image->height);
+	if (!pdu)
+		goto fail;
+
+	/* Emulate a stream of surface updates: the full image, then 64x64 tiles
+	 * with a few changed pixels, so matches span segments and PDUs. */
+	for (UINT32 frame = 0; frame < 2; frame++)
+	{
+		const UINT32 size = image->scanline * image->height;
+		memcpy(pdu, image->data, size);
+		for (UINT32 x = 0; x < frame * 16; x++)
+			pdu[(x * 7919u) % size] ^= (BYTE)(frame + x);
+
+		if (!test_ZGfxRoundTripPdu(compressor, decompressor, pdu, size, &compressed, &timeNS))
+			goto fail;
+		total += size;
+
+		for (UINT32 y = 0; y + 64 <= image->height; y += 64)
+		{
+			for (UINT32 x = 0; x + 64 <= image->width; x += 64)
+			{
+				BYTE* dst = pdu;
+
+				for (UINT32 line = 0; line < 64; line++)
+				{
+					const BYTE* src =
+					    &image->data[(y + line) * image->scanline + x * image->bytesPerPixel];
+					memcpy(dst, src, 64ull * image->bytesPerPixel);
+					dst += 64ull * image->bytesPerPixel;
+				}
+
+				pdu[frame] ^= 0x55;
+				const UINT32 tileSize = WINPR_ASSERTING_INT_CAST(UINT32, dst - pdu);
+				if (!test_ZGfxRoundTripPdu(compressor, decompressor, pdu, tileSize, &compressed,
+				                           &timeNS))
+					goto fail;
+				total += tileSize;
+			}
+		}
+	}
+
+	{
+		const double seconds = (double)timeNS / 1000000000.0;
+		const double mb = (double)total / 1024.0 / 1024.0;
+		printf("ZGFX level %" PRIu32 ": %" PRIuz " -> %" PRIuz " bytes, ratio %.2f, %.2f MB/s\n",
+		       level, total, compressed, (double)total / (double)compressed,
+		       (seconds > 0.0) ? mb / seconds : 0.0);
+	}
+
+	rc = 0;
+fail:
+	free(pdu);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
+static int test_ZGfxCompressRoundTrip(void)
+{
+	int rc = -1;
+	char* name = GetCombinedPath(CMAKE_CURRENT_SOURCE_DIR, "progressive.bmp");
+	wImage* image = winpr_image_new();
+
+	if (!name || !image)
+		goto fail;
+
+	if (winpr_image_read(image, name) <= 0)
+		goto fail;
+
+	for (UINT32 level = ZGFX_COMPRESSION_LEVEL_NONE; level <= ZGFX_COMPRESSION_LEVEL_BEST;
+	     level++)
+	{
+		if (test_ZGfxCompressLevel(level, image) < 0)
+		{
+			printf("%s: level %" PRIu32 " failed\n", __func__, level);
+			goto fail;
+		}
+	}
+
+	rc = 0;
+fail:
+	winpr_image_free(image, TRUE);
+	free(name);
+	return rc;
+}
+
+static int test_ZGfxCompressIncompressible(void)
+{
+	int rc = -1;
+	size_t compressed = 0;
+	UINT64 timeNS = 0;
+	BYTE data[4096] = WINPR_C_ARRAY_INIT;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!compressor || !decompressor)
+		goto fail;
+
+	if (winpr_RAND(data, sizeof(data)) < 0)
+		goto fail;
+
+	if (!test_ZGfxRoundTripPdu(compressor, decompressor, data, sizeof(data), &compressed,
+	                           &timeNS))
+		goto fail;
+
+	/* raw segments must not expand beyond descriptor and header */
+	if (compressed != sizeof(data) + 2)
+	{
+		printf("%s: unexpected size %" PRIuz "\n", __func__, compressed);
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -270,5 +449,11 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxCompressIncompressible() < 0)
+		return -1;
+
+	if (test_ZGfxCompressRoundTrip() < 0)
+		return -1;
+
 	return 0;
 }
@@ -147,3 +147,17 @@ fail:
 	free(cmp);
 	return rc;
 }
+
+uint32_t test_codec_helper_rand(uint32_t* state)
+{
+	WINPR_ASSERT(state);
+
+	uint32_t x = *state;
+	if (x == 0)
+		x = 0x9E3779B9;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
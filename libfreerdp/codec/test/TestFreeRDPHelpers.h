@@ -20,6 +20,7 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 void* test_codec_helper_read_data(const char* codec, const char* type, const char* name,
@@ -28,3 +29,7 @@ void test_codec_helper_write_data(const char* codec, const char* type, const cha
                                   const void* data, size_t length);
 bool test_codec_helper_compare(const char* codec, const char* type, const char* name,
                                const void* data, size_t length);
+
+/* Deterministic pseudo random numbers (xorshift32), so failures and compression ratios are
+ * reproducible between runs. \b state holds the seed, 0 is replaced by a fixed seed. */
+uint32_t test_codec_helper_rand(uint32_t* state);
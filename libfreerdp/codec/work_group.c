@@ -0,0 +1,220 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Batch Work Group
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/crt.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/types.h>
+#include <freerdp/log.h>
+
+#include "work_group.h"
+
+#define TAG FREERDP_TAG("codec.workgroup")
+
+/* upper bound for the number of pool work objects of a group */
+#define CODEC_WORK_GROUP_MAX_WORKERS 32
+
+/* number of chunks a batch is split into per participating thread. More than one so that
+ * threads finishing early can help out, few enough that each chunk covers a run of
+ * neighbouring tiles. */
+#define CODEC_WORK_GROUP_CHUNKS_PER_WORKER 4
+
+typedef struct
+{
+	CODEC_WORK_GROUP* group;
+	PTP_WORK work;
+	BYTE* arena;
+} CODEC_WORKER;
+
+struct S_CODEC_WORK_GROUP
+{
+	size_t arenaSize;
+
+	/* pool workers, the last entry is used by the thread calling codec_work_group_run */
+	size_t nrWorkers;
+	CODEC_WORKER* workers;
+
+	/* current batch */
+	codec_work_group_fn fn;
+	void* context;
+	size_t count;
+	size_t chunk;
+	volatile LONG next;
+	volatile LONG failed;
+};
+
+static BYTE* codec_work_group_arena(CODEC_WORK_GROUP* group, CODEC_WORKER* worker)
+{
+	WINPR_ASSERT(group);
+	WINPR_ASSERT(worker);
+
+	if (group->arenaSize == 0)
+		return nullptr;
+
+	/* one per work object, allocated on first use and kept until the group is freed. Which
+	 * pool thread runs a work object changes between runs, so the memory has no thread affinity */
+	if (!worker->arena)
+		worker->arena = winpr_aligned_malloc(group->arenaSize, 32);
+	return worker->arena;
+}
+
+static void codec_work_group_set_failed(CODEC_WORK_GROUP* group)
+{
+	const LONG previous = InterlockedExchange(&group->failed, 1);
+	WINPR_UNUSED(previous);
+}
+
+static void codec_work_group_drain(CODEC_WORK_GROUP* group, CODEC_WORKER* worker)
+{
+	WINPR_ASSERT(group);
+
+	BYTE* arena = codec_work_group_arena(group, worker);
+	if (!arena && (group->arenaSize > 0))
+	{
+		WLog_ERR(TAG, "failed to allocate %" PRIuz " bytes of scratch memory", group->arenaSize);
+		codec_work_group_set_failed(group);
+		return;
+	}
+
+	for (;;)
+	{
+		const LONG first =
+		    InterlockedExchangeAdd(&group->next, WINPR_ASSERTING_INT_CAST(LONG, group->chunk));
+		if ((size_t)first >= group->count)
+			break;
+
+		const size_t last = MIN(group->count, (size_t)first + group->chunk);
+		for (size_t index = (size_t)first; index < last; index++)
+		{
+			if (!group->fn(group->context, index, arena))
+				codec_work_group_set_failed(group);
+		}
+	}
+}
+
+static void CALLBACK codec_work_group_callback(WINPR_ATTR_UNUSED PTP_CALLBACK_INSTANCE instance,
+                                               void* context, WINPR_ATTR_UNUSED PTP_WORK work)
+{
+	CODEC_WORKER* worker = context;
+	WINPR_ASSERT(worker);
+
+	codec_work_group_drain(worker->group, worker);
+}
+
+void codec_work_group_free(CODEC_WORK_GROUP* group)
+{
+	if (!group)
+		return;
+
+	if (group->workers)
+	{
+		for (size_t x = 0; x <= group->nrWorkers; x++)
+		{
+			CODEC_WORKER* worker = &group->workers[x];
+			if (worker->work)
+				CloseThreadpoolWork(worker->work);
+			winpr_aligned_free(worker->arena);
+		}
+	}
+
+	free(group->workers);
+	free(group);
+}
+
+CODEC_WORK_GROUP* codec_work_group_new(BOOL threaded, size_t arenaSize)
+{
+	CODEC_WORK_GROUP* group = calloc(1, sizeof(CODEC_WORK_GROUP));
+	if (!group)
+		return nullptr;
+
+	group->arenaSize = arenaSize;
+
+	if (threaded)
+	{
+		SYSTEM_INFO info = WINPR_C_ARRAY_INIT;
+		GetNativeSystemInfo(&info);
+
+		/* the calling thread works on the batch as well */
+		if (info.dwNumberOfProcessors > 1)
+			group->nrWorkers = MIN(info.dwNumberOfProcessors - 1, CODEC_WORK_GROUP_MAX_WORKERS);
+	}
+
+	group->workers = calloc(group->nrWorkers + 1, sizeof(CODEC_WORKER));
+	if (!group->workers)
+		goto fail;
+
+	for (size_t x = 0; x <= group->nrWorkers; x++)
+	{
+		CODEC_WORKER* worker = &group->workers[x];
+		worker->group = group;
+
+		if (x == group->nrWorkers)
+			break;
+
+		worker->work = CreateThreadpoolWork(codec_work_group_callback, worker, nullptr);
+		if (!worker->work)
+		{
+			WLog_ERR(TAG, "CreateThreadpoolWork failed");
+			goto fail;
+		}
+	}
+
+	return group;
+
+fail:
+	codec_work_group_free(group);
+	return nullptr;
+}
+
+BOOL codec_work_group_run(CODEC_WORK_GROUP* group, size_t count, codec_work_group_fn fn,
+                          void* context)
+{
+	WINPR_ASSERT(group);
+	WINPR_ASSERT(fn);
+
+	if (count == 0)
+		return TRUE;
+
+	if (count > INT32_MAX / 2)
+		return FALSE;
+
+	const size_t threads = group->nrWorkers + 1;
+	group->fn = fn;
+	group->context = context;
+	group->count = count;
+	group->chunk = MAX(1, count / (threads * CODEC_WORK_GROUP_CHUNKS_PER_WORKER));
+	group->next = 0;
+	group->failed = 0;
+
+	/* do not wake up more workers than there are chunks left for them */
+	const size_t chunks = (count + group->chunk - 1) / group->chunk;
+	const size_t submit = MIN(group->nrWorkers, chunks - 1);
+
+	for (size_t x = 0; x < submit; x++)
+		SubmitThreadpoolWork(group->workers[x].work);
+
+	codec_work_group_drain(group, &group->workers[group->nrWorkers]);
+
+	for (size_t x = 0; x < submit; x++)
+		WaitForThreadpoolWorkCallbacks(group->workers[x].work, FALSE);
+
+	return group->failed == 0;
+}
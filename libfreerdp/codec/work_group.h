@@ -0,0 +1,57 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Codec Batch Work Group
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CODEC_WORK_GROUP_H
+#define FREERDP_LIB_CODEC_WORK_GROUP_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+typedef struct S_CODEC_WORK_GROUP CODEC_WORK_GROUP;
+
+/** Process job \b index of a batch.
+ *
+ *  \b arena is scratch memory of the size given to codec_work_group_new. It belongs to the
+ *  worker running the job and is reused for all jobs that worker runs, its content is undefined
+ *  at the start of each job. It is \b nullptr for groups created without scratch memory.
+ */
+typedef BOOL (*codec_work_group_fn)(void* context, size_t index, BYTE* WINPR_RESTRICT arena);
+
+FREERDP_LOCAL void codec_work_group_free(CODEC_WORK_GROUP* group);
+
+/** Create a group of persistent thread pool work objects.
+ *
+ *  With \b threaded == FALSE (or on single core systems) all jobs run on the calling thread.
+ */
+WINPR_ATTR_MALLOC(codec_work_group_free, 1)
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL CODEC_WORK_GROUP* codec_work_group_new(BOOL threaded, size_t arenaSize);
+
+/** Run jobs \b 0 to \b count - 1 and wait for all of them to finish.
+ *
+ *  Jobs are handed out to the workers in chunks of consecutive indices, the calling thread
+ *  takes part in the processing. All jobs are run even if some of them fail.
+ *  A group runs one batch at a time.
+ *
+ *  @return \b TRUE if all jobs succeeded, \b FALSE otherwise
+ */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL BOOL codec_work_group_run(CODEC_WORK_GROUP* group, size_t count,
+                                        codec_work_group_fn fn, void* context);
+
+#endif /* FREERDP_LIB_CODEC_WORK_GROUP_H */
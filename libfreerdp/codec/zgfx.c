@@ -69,8 +69,50 @@ struct S_ZGFX_CONTEXT
 	BYTE HistoryBuffer[2500000];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
+
+	/* compressor state */
+	UINT32 CompressionLevel;
+	UINT32 HistoryFill;
+	UINT32* HashTable;
+	UINT32* HashChain;
+	UINT16 LiteralCode[256];
+	BYTE LiteralBits[256];
 };
 
+#define ZGFX_HASH_BITS 16
+#define ZGFX_HASH_SIZE (1u << ZGFX_HASH_BITS)
+#define ZGFX_HASH_INVALID UINT32_MAX
+#define ZGFX_MIN_MATCH 3
+
+typedef struct
+{
+	UINT32 maxChain;   /* number of hash chain candidates examined per position */
+	UINT32 niceLength; /* stop searching once a match of this length was found */
+	UINT32 maxInsert;  /* number of positions inside a match added to the hash chains */
+	BOOL lazy;         /* check the next position for a longer match before emitting */
+} ZGFX_LEVEL;
+
+static const ZGFX_LEVEL ZGFX_LEVELS[] = {
+	{ 0, 0, 0, FALSE },              /* ZGFX_COMPRESSION_LEVEL_NONE */
+	{ 8, 64, 16, FALSE },            /* ZGFX_COMPRESSION_LEVEL_FAST */
+	{ 256, 2048, UINT32_MAX, TRUE }, /* ZGFX_COMPRESSION_LEVEL_BEST */
+};
+
+typedef struct
+{
+	UINT32 length;
+	UINT32 distance;
+} ZGFX_MATCH;
+
+typedef struct
+{
+	BYTE* data;
+	size_t capacity;
+	size_t offset;
+	UINT64 accumulator;
+	UINT32 count;
+} ZGFX_BIT_WRITER;
+
 static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
 	// len code vbits type  vbase
 	{ 1, 0, 8, 0, 0 },           // 0
@@ -488,20 +530,350 @@ fail:
 	return status;
 }
 
-static BOOL zgfx_compress_segment(WINPR_ATTR_UNUSED ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
-                                  wStream* WINPR_RESTRICT s, const BYTE* WINPR_RESTRICT pSrcData,
-                                  UINT32 SrcSize, UINT32* WINPR_RESTRICT pFlags)
+static inline BOOL zgfx_write_bits(ZGFX_BIT_WRITER* WINPR_RESTRICT bw, UINT32 bits,
+                                   UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= 32);
+
+	bw->accumulator = (bw->accumulator << nbits) | (bits & ((1ull << nbits) - 1ull));
+	bw->count += nbits;
+
+	while (bw->count >= 8)
+	{
+		if (bw->offset >= bw->capacity)
+			return FALSE;
+
+		bw->count -= 8;
+		bw->data[bw->offset++] = (BYTE)(bw->accumulator >> bw->count);
+	}
+
+	return TRUE;
+}
+
+/* NumberOfBitsToDecode = ((NumberOfBytesToDecode - 1) * 8) - ValueOfLastByte */
+static inline BOOL zgfx_write_finish(ZGFX_BIT_WRITER* WINPR_RESTRICT bw)
+{
+	BYTE padding = 0;
+
+	if (bw->count > 0)
+	{
+		padding = (BYTE)(8 - bw->count);
+
+		if (!zgfx_write_bits(bw, 0, padding))
+			return FALSE;
+	}
+
+	if (bw->offset >= bw->capacity)
+		return FALSE;
+
+	bw->data[bw->offset++] = padding;
+	return TRUE;
+}
+
+static inline UINT32 zgfx_hash(const BYTE* WINPR_RESTRICT p)
+{
+	const UINT32 value = ((UINT32)p[0] << 16) | ((UINT32)p[1] << 8) | p[2];
+	return (value * 2654435761u) >> (32 - ZGFX_HASH_BITS);
+}
+
+static inline void zgfx_hash_insert(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 startIndex,
+                                    const BYTE* WINPR_RESTRICT src, UINT32 size, UINT32 i)
+{
+	if (i + ZGFX_MIN_MATCH > size)
+		return;
+
+	const UINT32 hash = zgfx_hash(&src[i]);
+	const UINT32 index = (startIndex + i) % zgfx->HistoryBufferSize;
+	zgfx->HashChain[index] = zgfx->HashTable[hash];
+	zgfx->HashTable[hash] = index;
+}
+
+static inline UINT32 zgfx_match_length(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 index,
+                                       const BYTE* WINPR_RESTRICT src, UINT32 maxLength)
+{
+	UINT32 length = 0;
+
+	while (length < maxLength)
+	{
+		const UINT32 chunk = MIN(maxLength - length, zgfx->HistoryBufferSize - index);
+		const BYTE* history = &zgfx->HistoryBuffer[index];
+		const BYTE* current = &src[length];
+		UINT32 x = 0;
+
+		while ((x < chunk) && (history[x] == current[x]))
+			x++;
+
+		length += x;
+
+		if (x < chunk)
+			break;
+
+		index = 0;
+	}
+
+	return length;
+}
+
+static inline ZGFX_MATCH zgfx_find_match(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                         const ZGFX_LEVEL* WINPR_RESTRICT level,
+                                         UINT32 startIndex, UINT32 fill,
+                                         const BYTE* WINPR_RESTRICT src, UINT32 size, UINT32 i)
+{
+	ZGFX_MATCH match = WINPR_C_ARRAY_INIT;
+
+	if (i + ZGFX_MIN_MATCH > size)
+		return match;
+
+	/* The segment is already in the history buffer, so anything older than
+	 * the bytes it replaced is gone. */
+	const UINT32 maxLength = size - i;
+	const UINT32 maxDistance = MIN(fill + i, zgfx->HistoryBufferSize - maxLength);
+	const UINT32 index = (startIndex + i) % zgfx->HistoryBufferSize;
+	UINT32 candidate = zgfx->HashTable[zgfx_hash(&src[i])];
+	UINT32 lastDistance = 0;
+
+	for (UINT32 chain = level->maxChain; (chain > 0) && (candidate != ZGFX_HASH_INVALID); chain--)
+	{
+		const UINT32 distance =
+		    (index + zgfx->HistoryBufferSize - candidate) % zgfx->HistoryBufferSize;
+
+		/* chain entries must get older, anything else is a stale link */
+		if ((distance <= lastDistance) || (distance > maxDistance))
+			break;
+
+		lastDistance = distance;
+
+		const UINT32 probe = (candidate + match.length) % zgfx->HistoryBufferSize;
+
+		if ((match.length == 0) || (zgfx->HistoryBuffer[probe] == src[i + match.length]))
+		{
+			const UINT32 length = zgfx_match_length(zgfx, candidate, &src[i], maxLength);
+
+			if (length > match.length)
+			{
+				match.length = length;
+				match.distance = distance;
+
+				if ((length >= level->niceLength) || (length == maxLength))
+					break;
+			}
+		}
+
+		candidate = zgfx->HashChain[candidate];
+	}
+
+	if (match.length < ZGFX_MIN_MATCH)
+		match.length = 0;
+
+	return match;
+}
+
+static inline const ZGFX_TOKEN* zgfx_match_token(UINT32 distance)
+{
+	for (size_t x = 0; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[x];
+
+		if (token->tokenType == 0)
+			continue;
+
+		if ((distance >= token->valueBase) &&
+		    (distance - token->valueBase < (1u << token->valueBits)))
+			return token;
+	}
+
+	return nullptr;
+}
+
+static inline UINT32 zgfx_match_bits(UINT32 distance, UINT32 length)
+{
+	const ZGFX_TOKEN* token = zgfx_match_token(distance);
+
+	if (!token)
+		return UINT32_MAX;
+
+	UINT32 bits = token->prefixLength + token->valueBits;
+
+	if (length == 3)
+		return bits + 1;
+
+	UINT32 k = 2;
+
+	while ((length >> (k + 1)) != 0)
+		k++;
+
+	return bits + 2 * k;
+}
+
+static inline BOOL zgfx_match_worthwhile(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                         const BYTE* WINPR_RESTRICT src,
+                                         const ZGFX_MATCH* WINPR_RESTRICT match)
+{
+	/* The shortest literal code is 5 bits, the most expensive match of 8 or
+	 * more bytes 39 bits, so only short matches need to be checked. */
+	if (match->length >= 8)
+		return TRUE;
+
+	UINT32 literalBits = 0;
+
+	for (UINT32 x = 0; x < match->length; x++)
+		literalBits += zgfx->LiteralBits[src[x]];
+
+	return zgfx_match_bits(match->distance, match->length) < literalBits;
+}
+
+static inline BOOL zgfx_write_literal(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
+                                      ZGFX_BIT_WRITER* WINPR_RESTRICT bw, BYTE c)
+{
+	return zgfx_write_bits(bw, zgfx->LiteralCode[c], zgfx->LiteralBits[c]);
+}
+
+static inline BOOL zgfx_write_match(ZGFX_BIT_WRITER* WINPR_RESTRICT bw,
+                                    const ZGFX_MATCH* WINPR_RESTRICT match)
+{
+	const ZGFX_TOKEN* token = zgfx_match_token(match->distance);
+
+	if (!token)
+		return FALSE;
+
+	if (!zgfx_write_bits(bw, token->prefixCode, token->prefixLength))
+		return FALSE;
+
+	if (!zgfx_write_bits(bw, match->distance - token->valueBase, token->valueBits))
+		return FALSE;
+
+	if (match->length == 3)
+		return zgfx_write_bits(bw, 0, 1);
+
+	/* 4-7: 10 + 2 bits, 8-15: 110 + 3 bits, 16-31: 1110 + 4 bits, ... */
+	UINT32 k = 2;
+
+	while ((match->length >> (k + 1)) != 0)
+		k++;
+
+	if (!zgfx_write_bits(bw, (1u << (k - 1)) - 1u, k - 1))
+		return FALSE;
+
+	if (!zgfx_write_bits(bw, 0, 1))
+		return FALSE;
+
+	return zgfx_write_bits(bw, match->length - (1u << k), k);
+}
+
+/**
+ * Encode a segment that was already appended to the history buffer.
+ *
+ * @return the size of the encoded data in zgfx->OutputBuffer or 0 if the
+ *         segment should be sent uncompressed.
+ */
+static size_t zgfx_compress_data(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 startIndex,
+                                 UINT32 fill, const BYTE* WINPR_RESTRICT src, UINT32 size)
+{
+	WINPR_ASSERT(zgfx->CompressionLevel < ARRAYSIZE(ZGFX_LEVELS));
+	const ZGFX_LEVEL* level = &ZGFX_LEVELS[zgfx->CompressionLevel];
+
+	/* only worth it if the result is smaller than the raw segment */
+	if (size < 4)
+		return 0;
+
+	ZGFX_BIT_WRITER bw = { zgfx->OutputBuffer, size - 1, 0, 0, 0 };
+	ZGFX_MATCH match = WINPR_C_ARRAY_INIT;
+	BOOL pending = FALSE;
+	UINT32 i = 0;
+
+	while (i < size)
+	{
+		if (!pending)
+			match = zgfx_find_match(zgfx, level, startIndex, fill, src, size, i);
+
+		pending = FALSE;
+		zgfx_hash_insert(zgfx, startIndex, src, size, i);
+
+		if ((match.length > 0) && !zgfx_match_worthwhile(zgfx, &src[i], &match))
+			match.length = 0;
+
+		if ((match.length > 0) && level->lazy && (match.length < level->niceLength))
+		{
+			const ZGFX_MATCH next =
+			    zgfx_find_match(zgfx, level, startIndex, fill, src, size, i + 1);
+
+			if (next.length > match.length)
+			{
+				if (!zgfx_write_literal(zgfx, &bw, src[i]))
+					return 0;
+
+				match = next;
+				pending = TRUE;
+				i++;
+				continue;
+			}
+		}
+
+		if (match.length > 0)
+		{
+			if (!zgfx_write_match(&bw, &match))
+				return 0;
+
+			const UINT32 insert = MIN(match.length, level->maxInsert);
+
+			for (UINT32 x = 1; x < insert; x++)
+				zgfx_hash_insert(zgfx, startIndex, src, size, i + x);
+
+			i += match.length;
+		}
+		else
+		{
+			if (!zgfx_write_literal(zgfx, &bw, src[i]))
+				return 0;
+
+			i++;
+		}
+	}
+
+	if (!zgfx_write_finish(&bw))
+		return 0;
+
+	return bw.offset;
+}
+
+static BOOL zgfx_compress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, wStream* WINPR_RESTRICT s,
+                                  const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                  UINT32* WINPR_RESTRICT pFlags)
 {
-	/* FIXME: Currently compression not implemented. Just copy the raw source */
+	size_t DstSize = 0;
+	const UINT32 startIndex = zgfx->HistoryIndex;
+	const UINT32 fill = zgfx->HistoryFill;
+
+	WINPR_ASSERT(SrcSize <= ZGFX_SEGMENTED_MAXSIZE);
+
 	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 1))
 	{
 		WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
 		return FALSE;
 	}
 
+	/* The decompressor appends every segment to its history, compressed or not */
+	zgfx_history_buffer_ring_write(zgfx, pSrcData, SrcSize);
+
+	if (zgfx->HashTable && (zgfx->CompressionLevel != ZGFX_COMPRESSION_LEVEL_NONE))
+		DstSize = zgfx_compress_data(zgfx, startIndex, fill, pSrcData, SrcSize);
+
+	zgfx->HistoryFill = MIN(zgfx->HistoryBufferSize, fill + SrcSize);
+
 	(*pFlags) |= ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
-	Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(uint8_t, *pFlags)); /* header (1 byte) */
-	Stream_Write(s, pSrcData, SrcSize);
+	const UINT32 header = (*pFlags) & (UINT32)~PACKET_COMPRESSED;
+
+	if (DstSize > 0)
+	{
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(uint8_t, header | PACKET_COMPRESSED));
+		Stream_Write(s, zgfx->OutputBuffer, DstSize);
+	}
+	else
+	{
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(uint8_t, header)); /* header (1 byte) */
+		Stream_Write(s, pSrcData, SrcSize);
+	}
+
 	return TRUE;
 }
 
@@ -615,6 +987,54 @@ int zgfx_compress(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT
 void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, WINPR_ATTR_UNUSED BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+	zgfx->HistoryFill = 0;
+
+	if (zgfx->HashTable)
+	{
+		for (size_t x = 0; x < ZGFX_HASH_SIZE; x++)
+			zgfx->HashTable[x] = ZGFX_HASH_INVALID;
+	}
+}
+
+BOOL zgfx_context_set_compression_level(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 level)
+{
+	WINPR_ASSERT(zgfx);
+
+	if (level >= ARRAYSIZE(ZGFX_LEVELS))
+	{
+		WLog_ERR(TAG, "Invalid compression level %" PRIu32, level);
+		return FALSE;
+	}
+
+	zgfx->CompressionLevel = level;
+	return TRUE;
+}
+
+UINT32 zgfx_context_get_compression_level(const ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	WINPR_ASSERT(zgfx);
+	return zgfx->CompressionLevel;
+}
+
+static void zgfx_init_literals(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	/* default literal: 0 + 8 bit value */
+	for (size_t x = 0; x < ARRAYSIZE(zgfx->LiteralCode); x++)
+	{
+		zgfx->LiteralCode[x] = (UINT16)x;
+		zgfx->LiteralBits[x] = 9;
+	}
+
+	for (size_t x = 0; ZGFX_TOKEN_TABLE[x].prefixLength != 0; x++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[x];
+
+		if ((token->tokenType != 0) || (token->valueBits != 0))
+			continue;
+
+		zgfx->LiteralCode[token->valueBase] = (UINT16)token->prefixCode;
+		zgfx->LiteralBits[token->valueBase] = (BYTE)token->prefixLength;
+	}
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -626,6 +1046,22 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 	{
 		zgfx->Compressor = Compressor;
 		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
+
+		if (Compressor)
+		{
+			zgfx->CompressionLevel = ZGFX_COMPRESSION_LEVEL_DEFAULT;
+			zgfx->HashTable = (UINT32*)calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+			zgfx->HashChain = (UINT32*)calloc(zgfx->HistoryBufferSize, sizeof(UINT32));
+
+			if (!zgfx->HashTable || !zgfx->HashChain)
+			{
+				zgfx_context_free(zgfx);
+				return nullptr;
+			}
+
+			zgfx_init_literals(zgfx);
+		}
+
 		zgfx_context_reset(zgfx, FALSE);
 	}
 
@@ -634,5 +1070,10 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	free(zgfx->HashTable);
+	free(zgfx->HashChain);
 	free(zgfx);
 }
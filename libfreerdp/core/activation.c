@@ -308,20 +308,21 @@ static UINT16 rdp_load_persistent_key_list(rdpRdp* rdp, UINT64** pKeyList)
 
 	{
 		const int count = persistent_cache_get_count(persistent);
-		if ((count < 0) || (count > UINT16_MAX))
+		if (count < 0)
 			goto error;
 
-		keyCount = (UINT16)count;
+		/* only the keys that are sent, the index has them without reading the bitmaps */
+		keyCount = (UINT16)MIN((UINT32)count, PERSIST_KEY_LIST_MAX_KEYS);
 		keyList = (UINT64*)calloc(keyCount, sizeof(UINT64));
 
 		if (!keyList)
 			goto error;
 
-		for (int index = 0; index < count; index++)
+		for (UINT16 index = 0; index < keyCount; index++)
 		{
 			PERSISTENT_CACHE_ENTRY cacheEntry = WINPR_C_ARRAY_INIT;
 
-			if (persistent_cache_read_entry(persistent, &cacheEntry) < 1)
+			if (persistent_cache_get_entry_info(persistent, index, &cacheEntry) < 1)
 				continue;
 
 			keyList[index] = cacheEntry.key64;
@@ -340,7 +341,7 @@ error:
 
 BOOL rdp_send_client_persistent_key_list_pdu(rdpRdp* rdp)
 {
-	UINT16 keyMaxFrag = 2042;
+	const UINT16 keyMaxFrag = PERSIST_KEY_LIST_MAX_KEYS;
 	UINT64* keyList = nullptr;
 	RDP_BITMAP_PERSISTENT_INFO info = WINPR_C_ARRAY_INIT;
 	WINPR_ASSERT(rdp);
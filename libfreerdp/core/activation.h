@@ -55,6 +55,11 @@ typedef struct
 #define PERSIST_FIRST_PDU 0x01
 #define PERSIST_LAST_PDU 0x02
 
+/* The client sends a single persistent key list PDU. Its keys are assigned to the bitmap
+ * cache cells in order, the bitmap cache relies on the same limits. */
+#define PERSIST_KEY_LIST_MAX_KEYS 2042u
+#define PERSIST_KEY_LIST_MAX_CELLS 5u
+
 #define FONTLIST_FIRST 0x0001
 #define FONTLIST_LAST 0x0002
 
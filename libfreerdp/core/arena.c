@@ -0,0 +1,163 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bump Allocator
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+
+#include <freerdp/types.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGNMENT 16
+/* a merged block is kept up to this many block sizes, larger rounds are rare PDUs that must not
+ * keep their memory for the rest of the session */
+#define ARENA_MAX_RETAINED_BLOCKS 8
+
+typedef struct s_arena_block
+{
+	struct s_arena_block* next;
+	size_t size;
+	size_t used;
+	BYTE* data;
+} ARENA_BLOCK;
+
+struct rdp_arena
+{
+	/* block allocations are served from */
+	ARENA_BLOCK* current;
+	/* blocks that ran full since the last reset */
+	ARENA_BLOCK* full;
+	size_t blockSize;
+	size_t total;
+};
+
+static size_t arena_align(size_t size)
+{
+	return (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+}
+
+static void arena_block_free(ARENA_BLOCK* block)
+{
+	while (block)
+	{
+		ARENA_BLOCK* next = block->next;
+		winpr_aligned_free(block->data);
+		free(block);
+		block = next;
+	}
+}
+
+static ARENA_BLOCK* arena_block_new(size_t size)
+{
+	ARENA_BLOCK* block = calloc(1, sizeof(ARENA_BLOCK));
+	if (!block)
+		return nullptr;
+
+	block->size = size;
+	block->data = winpr_aligned_malloc(size, ARENA_ALIGNMENT);
+	if (!block->data)
+	{
+		free(block);
+		return nullptr;
+	}
+	return block;
+}
+
+void arena_free(rdpArena* arena)
+{
+	if (!arena)
+		return;
+
+	arena_block_free(arena->current);
+	arena_block_free(arena->full);
+	free(arena);
+}
+
+rdpArena* arena_new(size_t blockSize)
+{
+	rdpArena* arena = calloc(1, sizeof(rdpArena));
+	if (!arena)
+		return nullptr;
+
+	arena->blockSize = arena_align(MAX(blockSize, ARENA_ALIGNMENT));
+	arena->current = arena_block_new(arena->blockSize);
+	if (!arena->current)
+	{
+		arena_free(arena);
+		return nullptr;
+	}
+	return arena;
+}
+
+void* arena_calloc(rdpArena* arena, size_t nmemb, size_t size)
+{
+	WINPR_ASSERT(arena);
+	WINPR_ASSERT(arena->current);
+
+	if ((size > 0) && (nmemb > (SIZE_MAX - ARENA_ALIGNMENT) / size))
+		return nullptr;
+
+	const size_t length = arena_align(nmemb * size);
+	ARENA_BLOCK* block = arena->current;
+
+	if (length > block->size - block->used)
+	{
+		ARENA_BLOCK* next = arena_block_new(MAX(arena->blockSize, length));
+		if (!next)
+			return nullptr;
+
+		block->next = arena->full;
+		arena->full = block;
+		arena->current = block = next;
+	}
+
+	BYTE* ptr = &block->data[block->used];
+	block->used += length;
+	arena->total += length;
+	memset(ptr, 0, length);
+	return ptr;
+}
+
+void arena_reset(rdpArena* arena)
+{
+	WINPR_ASSERT(arena);
+	WINPR_ASSERT(arena->current);
+
+	if (arena->full)
+	{
+		/* the last round did not fit into one block, replace all with a single larger one */
+		size_t size = arena_align(arena->total);
+		if (size / ARENA_MAX_RETAINED_BLOCKS > arena->blockSize)
+			size = arena->blockSize;
+
+		ARENA_BLOCK* block = arena_block_new(size);
+		if (block)
+		{
+			arena_block_free(arena->current);
+			arena->current = block;
+		}
+		arena_block_free(arena->full);
+		arena->full = nullptr;
+	}
+
+	arena->current->used = 0;
+	arena->total = 0;
+}
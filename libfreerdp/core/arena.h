@@ -0,0 +1,46 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Bump Allocator
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_CORE_ARENA_H
+#define FREERDP_LIB_CORE_ARENA_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+/**
+ * An arena hands out zeroed memory from large blocks. Allocations are never freed one by one,
+ * \b arena_reset releases all of them at once and keeps the memory for the next round.
+ */
+typedef struct rdp_arena rdpArena;
+
+FREERDP_LOCAL void arena_free(rdpArena* arena);
+
+WINPR_ATTR_MALLOC(arena_free, 1)
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL rdpArena* arena_new(size_t blockSize);
+
+/** @brief allocate \b nmemb zeroed elements of \b size bytes, valid until the next reset */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL void* arena_calloc(rdpArena* arena, size_t nmemb, size_t size);
+
+/** @brief invalidate all allocations, the blocks are merged into one big enough for the
+ * amount used since the last reset. Beyond a few times the block size the arena shrinks back
+ * to a single block of the initial size instead. */
+FREERDP_LOCAL void arena_reset(rdpArena* arena);
+
+#endif /* FREERDP_LIB_CORE_ARENA_H */
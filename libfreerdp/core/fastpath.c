@@ -66,6 +66,7 @@ struct rdp_fastpath
 	wStream* fs;
 	BYTE encryptionFlags;
 	BYTE numberEvents;
+	/* reassembly buffer of a fragmented update, taken from the transport receive pool */
 	wStream* updateData;
 	int fragmentation;
 };
@@ -305,7 +306,6 @@ static BOOL fastpath_recv_update_common(rdpUpdate* update, wStream* s)
 				return FALSE;
 
 			rc = IFCALLRESULT(defaultReturn, update->BitmapUpdate, context, bitmap_update);
-			free_bitmap_update(context, bitmap_update);
 		}
 		break;
 
@@ -317,7 +317,6 @@ static BOOL fastpath_recv_update_common(rdpUpdate* update, wStream* s)
 				return FALSE;
 
 			rc = IFCALLRESULT(defaultReturn, update->Palette, context, palette_update);
-			free_palette_update(context, palette_update);
 		}
 		break;
 
@@ -361,7 +360,6 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 	if (!fastpath || !fastpath->rdp || !s)
 		return -1;
 
-	Stream_SealLength(s);
 	Stream_ResetPosition(s);
 
 	rdpUpdate* update = fastpath->rdp->update;
@@ -427,11 +425,8 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 			POINTER_POSITION_UPDATE* pointer_position = update_read_pointer_position(update, s);
 
 			if (pointer_position)
-			{
 				rc = IFCALLRESULT(defaultReturn, pointer->PointerPosition, context,
 				                  pointer_position);
-				free_pointer_position_update(context, pointer_position);
-			}
 		}
 		break;
 
@@ -440,10 +435,7 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 			POINTER_COLOR_UPDATE* pointer_color = update_read_pointer_color(update, s, 24);
 
 			if (pointer_color)
-			{
 				rc = IFCALLRESULT(defaultReturn, pointer->PointerColor, context, pointer_color);
-				free_pointer_color_update(context, pointer_color);
-			}
 		}
 		break;
 
@@ -452,10 +444,7 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 			POINTER_CACHED_UPDATE* pointer_cached = update_read_pointer_cached(update, s);
 
 			if (pointer_cached)
-			{
 				rc = IFCALLRESULT(defaultReturn, pointer->PointerCached, context, pointer_cached);
-				free_pointer_cached_update(context, pointer_cached);
-			}
 		}
 		break;
 
@@ -464,10 +453,7 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 			POINTER_NEW_UPDATE* pointer_new = update_read_pointer_new(update, s);
 
 			if (pointer_new)
-			{
 				rc = IFCALLRESULT(defaultReturn, pointer->PointerNew, context, pointer_new);
-				free_pointer_new_update(context, pointer_new);
-			}
 		}
 		break;
 
@@ -476,16 +462,14 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 			POINTER_LARGE_UPDATE* pointer_large = update_read_pointer_large(update, s);
 
 			if (pointer_large)
-			{
 				rc = IFCALLRESULT(defaultReturn, pointer->PointerLarge, context, pointer_large);
-				free_pointer_large_update(context, pointer_large);
-			}
 		}
 		break;
 		default:
 			break;
 	}
 
+	update_reset_arena(update);
 	Stream_ResetPosition(s);
 	if (!rc)
 	{
@@ -497,6 +481,15 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 	return status;
 }
 
+static void fastpath_release_update_data(rdpFastPath* fastpath)
+{
+	WINPR_ASSERT(fastpath);
+
+	if (fastpath->updateData)
+		Stream_Release(fastpath->updateData);
+	fastpath->updateData = nullptr;
+}
+
 static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 {
 	int status = 0;
@@ -552,11 +545,6 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 		return -1;
 	}
 
-	if (!Stream_EnsureRemainingCapacity(fastpath->updateData, DstSize))
-		return -1;
-
-	Stream_Write(fastpath->updateData, pDstData, DstSize);
-
 	if (fragmentation == FASTPATH_FRAGMENT_SINGLE)
 	{
 		if (fastpath->fragmentation != -1)
@@ -565,7 +553,12 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 			goto out_fail;
 		}
 
-		status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
+		/* The update is complete, dispatch it straight from the transport buffer or the
+		 * decompressor output. Both stay valid until the next update is read. */
+		wStream sbuffer = WINPR_C_ARRAY_INIT;
+		wStream* us = Stream_StaticConstInit(&sbuffer, pDstData, DstSize);
+
+		status = fastpath_recv_update(fastpath, updateCode, us);
 
 		if (status < 0)
 		{
@@ -575,22 +568,12 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 	}
 	else
 	{
-		rdpContext* context = nullptr;
-		const size_t totalSize = Stream_GetPosition(fastpath->updateData);
-
-		context = transport_get_context(transport);
+		rdpContext* context = transport_get_context(transport);
 		WINPR_ASSERT(context);
 		WINPR_ASSERT(context->settings);
 
-		if (totalSize >
-		    freerdp_settings_get_uint32(context->settings, FreeRDP_MultifragMaxRequestSize))
-		{
-			WLog_ERR(
-			    TAG, "Total size (%" PRIuz ") exceeds MultifragMaxRequestSize (%" PRIu32 ")",
-			    totalSize,
-			    freerdp_settings_get_uint32(context->settings, FreeRDP_MultifragMaxRequestSize));
-			goto out_fail;
-		}
+		const UINT32 maxSize =
+		    freerdp_settings_get_uint32(context->settings, FreeRDP_MultifragMaxRequestSize);
 
 		if (fragmentation == FASTPATH_FRAGMENT_FIRST)
 		{
@@ -600,6 +583,11 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 				goto out_fail;
 			}
 
+			WINPR_ASSERT(!fastpath->updateData);
+			fastpath->updateData = transport_take_from_pool(transport, DstSize);
+			if (!fastpath->updateData)
+				goto out_fail;
+
 			fastpath->fragmentation = FASTPATH_FRAGMENT_FIRST;
 		}
 		else if (fragmentation == FASTPATH_FRAGMENT_NEXT)
@@ -623,7 +611,29 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 			}
 
 			fastpath->fragmentation = -1;
+		}
+
+		WINPR_ASSERT(fastpath->updateData);
+		const size_t totalSize = Stream_GetPosition(fastpath->updateData) + DstSize;
+
+		if (totalSize > maxSize)
+		{
+			WLog_ERR(TAG,
+			         "Total size (%" PRIuz ") exceeds MultifragMaxRequestSize (%" PRIu32 ")",
+			         totalSize, maxSize);
+			goto out_fail;
+		}
+
+		if (!Stream_EnsureRemainingCapacity(fastpath->updateData, DstSize))
+			goto out_fail;
+
+		Stream_Write(fastpath->updateData, pDstData, DstSize);
+
+		if (fragmentation == FASTPATH_FRAGMENT_LAST)
+		{
+			Stream_SealLength(fastpath->updateData);
 			status = fastpath_recv_update(fastpath, updateCode, fastpath->updateData);
+			fastpath_release_update_data(fastpath);
 
 			if (status < 0)
 			{
@@ -635,6 +645,8 @@ static int fastpath_recv_update_data(rdpFastPath* fastpath, wStream* s)
 
 	return status;
 out_fail:
+	fastpath_release_update_data(fastpath);
+	fastpath->fragmentation = -1;
 	return -1;
 }
 
@@ -1397,9 +1409,8 @@ rdpFastPath* fastpath_new(rdpRdp* rdp)
 	fastpath->rdp = rdp;
 	fastpath->fragmentation = -1;
 	fastpath->fs = Stream_New(nullptr, FASTPATH_MAX_PACKET_SIZE);
-	fastpath->updateData = Stream_New(nullptr, FASTPATH_MAX_PACKET_SIZE);
 
-	if (!fastpath->fs || !fastpath->updateData)
+	if (!fastpath->fs)
 		goto out_free;
 
 	return fastpath;
@@ -1412,7 +1423,7 @@ void fastpath_free(rdpFastPath* fastpath)
 {
 	if (fastpath)
 	{
-		Stream_Free(fastpath->updateData, TRUE);
+		fastpath_release_update_data(fastpath);
 		Stream_Free(fastpath->fs, TRUE);
 		free(fastpath);
 	}
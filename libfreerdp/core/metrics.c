@@ -37,6 +37,20 @@ double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32
 	return CompressionRatio;
 }
 
+void metrics_write_frame(rdpMetrics* metrics, UINT64 WriteSyscalls, UINT64 TlsRecords)
+{
+	WINPR_ASSERT(metrics);
+
+	metrics->TotalFrames++;
+	metrics->TotalWriteSyscalls += WriteSyscalls;
+	metrics->TotalTlsRecords += TlsRecords;
+
+	metrics->SyscallsPerFrame =
+	    ((double)metrics->TotalWriteSyscalls) / ((double)metrics->TotalFrames);
+	metrics->TlsRecordsPerFrame =
+	    ((double)metrics->TotalTlsRecords) / ((double)metrics->TotalFrames);
+}
+
 rdpMetrics* metrics_new(rdpContext* context)
 {
 	rdpMetrics* metrics = nullptr;
@@ -2308,7 +2308,6 @@ static BOOL update_read_ellipse_cb_order(const char* orderName, wStream* s,
 }
 
 /* Secondary Drawing Orders */
-WINPR_ATTR_MALLOC(free_cache_bitmap_order, 2)
 WINPR_ATTR_NODISCARD
 static CACHE_BITMAP_ORDER* update_read_cache_bitmap_order(rdpUpdate* update, wStream* s,
                                                           BOOL compressed, UINT16 flags)
@@ -2319,7 +2318,7 @@ static CACHE_BITMAP_ORDER* update_read_cache_bitmap_order(rdpUpdate* update, wSt
 	if (!update || !s)
 		return nullptr;
 
-	cache_bitmap = calloc(1, sizeof(CACHE_BITMAP_ORDER));
+	cache_bitmap = arena_calloc(up->arena, 1, sizeof(CACHE_BITMAP_ORDER));
 
 	if (!cache_bitmap)
 		goto fail;
@@ -2364,19 +2363,11 @@ static CACHE_BITMAP_ORDER* update_read_cache_bitmap_order(rdpUpdate* update, wSt
 	if (!Stream_CheckAndLogRequiredLength(TAG, s, cache_bitmap->bitmapLength))
 		goto fail;
 
-	cache_bitmap->bitmapDataStream = malloc(cache_bitmap->bitmapLength);
-
-	if (!cache_bitmap->bitmapDataStream)
-		goto fail;
-
-	Stream_Read(s, cache_bitmap->bitmapDataStream, cache_bitmap->bitmapLength);
+	cache_bitmap->bitmapDataStream = Stream_Pointer(s);
+	Stream_Seek(s, cache_bitmap->bitmapLength);
 	cache_bitmap->compressed = compressed;
 	return cache_bitmap;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_cache_bitmap_order(update->context, cache_bitmap);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -2431,7 +2422,6 @@ BOOL update_write_cache_bitmap_order(wStream* s, const CACHE_BITMAP_ORDER* cache
 	return TRUE;
 }
 
-WINPR_ATTR_MALLOC(free_cache_bitmap_v2_order, 2)
 WINPR_ATTR_NODISCARD
 static CACHE_BITMAP_V2_ORDER* update_read_cache_bitmap_v2_order(rdpUpdate* update, wStream* s,
                                                                 BOOL compressed, UINT16 flags)
@@ -2443,7 +2433,8 @@ static CACHE_BITMAP_V2_ORDER* update_read_cache_bitmap_v2_order(rdpUpdate* updat
 	if (!update || !s)
 		return nullptr;
 
-	cache_bitmap_v2 = calloc(1, sizeof(CACHE_BITMAP_V2_ORDER));
+	rdp_update_internal* up = update_cast(update);
+	cache_bitmap_v2 = arena_calloc(up->arena, 1, sizeof(CACHE_BITMAP_V2_ORDER));
 
 	if (!cache_bitmap_v2)
 		goto fail;
@@ -2512,19 +2503,11 @@ static CACHE_BITMAP_V2_ORDER* update_read_cache_bitmap_v2_order(rdpUpdate* updat
 	if (cache_bitmap_v2->bitmapLength == 0)
 		goto fail;
 
-	cache_bitmap_v2->bitmapDataStream = malloc(cache_bitmap_v2->bitmapLength);
-
-	if (!cache_bitmap_v2->bitmapDataStream)
-		goto fail;
-
-	Stream_Read(s, cache_bitmap_v2->bitmapDataStream, cache_bitmap_v2->bitmapLength);
+	cache_bitmap_v2->bitmapDataStream = Stream_Pointer(s);
+	Stream_Seek(s, cache_bitmap_v2->bitmapLength);
 	cache_bitmap_v2->compressed = compressed;
 	return cache_bitmap_v2;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_cache_bitmap_v2_order(update->context, cache_bitmap_v2);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -2617,7 +2600,6 @@ BOOL update_write_cache_bitmap_v2_order(wStream* s, CACHE_BITMAP_V2_ORDER* cache
 	return TRUE;
 }
 
-WINPR_ATTR_MALLOC(free_cache_bitmap_v3_order, 2)
 WINPR_ATTR_NODISCARD
 static CACHE_BITMAP_V3_ORDER* update_read_cache_bitmap_v3_order(rdpUpdate* update, wStream* s,
                                                                 UINT16 flags)
@@ -2626,14 +2608,13 @@ static CACHE_BITMAP_V3_ORDER* update_read_cache_bitmap_v3_order(rdpUpdate* updat
 	BYTE bitsPerPixelId = 0;
 	BITMAP_DATA_EX* bitmapData = nullptr;
 	UINT32 new_len = 0;
-	BYTE* new_data = nullptr;
 	CACHE_BITMAP_V3_ORDER* cache_bitmap_v3 = nullptr;
 	rdp_update_internal* up = update_cast(update);
 
 	if (!update || !s)
 		return nullptr;
 
-	cache_bitmap_v3 = calloc(1, sizeof(CACHE_BITMAP_V3_ORDER));
+	cache_bitmap_v3 = arena_calloc(up->arena, 1, sizeof(CACHE_BITMAP_V3_ORDER));
 
 	if (!cache_bitmap_v3)
 		goto fail;
@@ -2670,20 +2651,11 @@ static CACHE_BITMAP_V3_ORDER* update_read_cache_bitmap_v3_order(rdpUpdate* updat
 	if ((new_len == 0) || (!Stream_CheckAndLogRequiredLength(TAG, s, new_len)))
 		goto fail;
 
-	new_data = (BYTE*)realloc(bitmapData->data, new_len);
-
-	if (!new_data)
-		goto fail;
-
-	bitmapData->data = new_data;
+	bitmapData->data = Stream_Pointer(s);
 	bitmapData->length = new_len;
-	Stream_Read(s, bitmapData->data, bitmapData->length);
+	Stream_Seek(s, bitmapData->length);
 	return cache_bitmap_v3;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_cache_bitmap_v3_order(update->context, cache_bitmap_v3);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -2726,13 +2698,14 @@ BOOL update_write_cache_bitmap_v3_order(wStream* s, CACHE_BITMAP_V3_ORDER* cache
 	return TRUE;
 }
 
-WINPR_ATTR_MALLOC(free_cache_color_table_order, 2)
 WINPR_ATTR_NODISCARD
 static CACHE_COLOR_TABLE_ORDER* update_read_cache_color_table_order(rdpUpdate* update, wStream* s,
                                                                     WINPR_ATTR_UNUSED UINT16 flags)
 {
 	UINT32* colorTable = nullptr;
-	CACHE_COLOR_TABLE_ORDER* cache_color_table = calloc(1, sizeof(CACHE_COLOR_TABLE_ORDER));
+	rdp_update_internal* up = update_cast(update);
+	CACHE_COLOR_TABLE_ORDER* cache_color_table =
+	    arena_calloc(up->arena, 1, sizeof(CACHE_COLOR_TABLE_ORDER));
 
 	if (!cache_color_table)
 		goto fail;
@@ -2759,10 +2732,6 @@ static CACHE_COLOR_TABLE_ORDER* update_read_cache_color_table_order(rdpUpdate* u
 
 	return cache_color_table;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_cache_color_table_order(update->context, cache_color_table);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -2805,11 +2774,12 @@ BOOL update_write_cache_color_table_order(wStream* s,
 }
 static CACHE_GLYPH_ORDER* update_read_cache_glyph_order(rdpUpdate* update, wStream* s, UINT16 flags)
 {
-	CACHE_GLYPH_ORDER* cache_glyph_order = calloc(1, sizeof(CACHE_GLYPH_ORDER));
-
 	WINPR_ASSERT(update);
 	WINPR_ASSERT(s);
 
+	rdp_update_internal* up = update_cast(update);
+	CACHE_GLYPH_ORDER* cache_glyph_order = arena_calloc(up->arena, 1, sizeof(CACHE_GLYPH_ORDER));
+
 	if (!cache_glyph_order)
 		goto fail;
 
@@ -2837,17 +2807,14 @@ static CACHE_GLYPH_ORDER* update_read_cache_glyph_order(rdpUpdate* update, wStre
 		if (!Stream_CheckAndLogRequiredLength(TAG, s, glyph->cb))
 			goto fail;
 
-		glyph->aj = (BYTE*)malloc(glyph->cb);
-
-		if (!glyph->aj)
-			goto fail;
-
-		Stream_Read(s, glyph->aj, glyph->cb);
+		glyph->aj = Stream_Pointer(s);
+		Stream_Seek(s, glyph->cb);
 	}
 
 	if ((flags & CG_GLYPH_UNICODE_PRESENT) && (cache_glyph_order->cGlyphs > 0))
 	{
-		cache_glyph_order->unicodeCharacters = calloc(cache_glyph_order->cGlyphs, sizeof(WCHAR));
+		cache_glyph_order->unicodeCharacters =
+		    arena_calloc(up->arena, cache_glyph_order->cGlyphs, sizeof(WCHAR));
 
 		if (!cache_glyph_order->unicodeCharacters)
 			goto fail;
@@ -2863,7 +2830,6 @@ static CACHE_GLYPH_ORDER* update_read_cache_glyph_order(rdpUpdate* update, wStre
 
 	return cache_glyph_order;
 fail:
-	free_cache_glyph_order(update->context, cache_glyph_order);
 	return nullptr;
 }
 
@@ -2911,7 +2877,10 @@ BOOL update_write_cache_glyph_order(wStream* s, const CACHE_GLYPH_ORDER* cache_g
 static CACHE_GLYPH_V2_ORDER* update_read_cache_glyph_v2_order(rdpUpdate* update, wStream* s,
                                                               UINT16 flags)
 {
-	CACHE_GLYPH_V2_ORDER* cache_glyph_v2 = calloc(1, sizeof(CACHE_GLYPH_V2_ORDER));
+	WINPR_ASSERT(update);
+
+	rdp_update_internal* up = update_cast(update);
+	CACHE_GLYPH_V2_ORDER* cache_glyph_v2 = arena_calloc(up->arena, 1, sizeof(CACHE_GLYPH_V2_ORDER));
 
 	if (!cache_glyph_v2)
 		goto fail;
@@ -2942,17 +2911,14 @@ static CACHE_GLYPH_V2_ORDER* update_read_cache_glyph_v2_order(rdpUpdate* update,
 		if (!Stream_CheckAndLogRequiredLength(TAG, s, glyph->cb))
 			goto fail;
 
-		glyph->aj = (BYTE*)malloc(glyph->cb);
-
-		if (!glyph->aj)
-			goto fail;
-
-		Stream_Read(s, glyph->aj, glyph->cb);
+		glyph->aj = Stream_Pointer(s);
+		Stream_Seek(s, glyph->cb);
 	}
 
 	if ((flags & CG_GLYPH_UNICODE_PRESENT) && (cache_glyph_v2->cGlyphs > 0))
 	{
-		cache_glyph_v2->unicodeCharacters = calloc(cache_glyph_v2->cGlyphs, sizeof(WCHAR));
+		cache_glyph_v2->unicodeCharacters =
+		    arena_calloc(up->arena, cache_glyph_v2->cGlyphs, sizeof(WCHAR));
 
 		if (!cache_glyph_v2->unicodeCharacters)
 			goto fail;
@@ -2967,7 +2933,6 @@ static CACHE_GLYPH_V2_ORDER* update_read_cache_glyph_v2_order(rdpUpdate* update,
 
 	return cache_glyph_v2;
 fail:
-	free_cache_glyph_v2_order(update->context, cache_glyph_v2);
 	return nullptr;
 }
 
@@ -3061,7 +3026,7 @@ static CACHE_BRUSH_ORDER* update_read_cache_brush_order(rdpUpdate* update, wStre
 	BYTE iBitmapFormat = 0;
 	BOOL compressed = FALSE;
 	rdp_update_internal* up = update_cast(update);
-	CACHE_BRUSH_ORDER* cache_brush = calloc(1, sizeof(CACHE_BRUSH_ORDER));
+	CACHE_BRUSH_ORDER* cache_brush = arena_calloc(up->arena, 1, sizeof(CACHE_BRUSH_ORDER));
 
 	if (!cache_brush)
 		goto fail;
@@ -3137,7 +3102,6 @@ static CACHE_BRUSH_ORDER* update_read_cache_brush_order(rdpUpdate* update, wStre
 
 	return cache_brush;
 fail:
-	free_cache_brush_order(update->context, cache_brush);
 	return nullptr;
 }
 
@@ -4135,10 +4099,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 			    update_read_cache_bitmap_order(update, s, compressed, extraFlags);
 
 			if (order)
-			{
 				rc = IFCALLRESULT(defaultReturn, secondary->CacheBitmap, context, order);
-				free_cache_bitmap_order(context, order);
-			}
 		}
 		break;
 
@@ -4150,10 +4111,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 			    update_read_cache_bitmap_v2_order(update, s, compressed, extraFlags);
 
 			if (order)
-			{
 				rc = IFCALLRESULT(defaultReturn, secondary->CacheBitmapV2, context, order);
-				free_cache_bitmap_v2_order(context, order);
-			}
 		}
 		break;
 
@@ -4162,10 +4120,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 			CACHE_BITMAP_V3_ORDER* order = update_read_cache_bitmap_v3_order(update, s, extraFlags);
 
 			if (order)
-			{
 				rc = IFCALLRESULT(defaultReturn, secondary->CacheBitmapV3, context, order);
-				free_cache_bitmap_v3_order(context, order);
-			}
 		}
 		break;
 
@@ -4175,10 +4130,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 			    update_read_cache_color_table_order(update, s, extraFlags);
 
 			if (order)
-			{
 				rc = IFCALLRESULT(defaultReturn, secondary->CacheColorTable, context, order);
-				free_cache_color_table_order(context, order);
-			}
 		}
 		break;
 
@@ -4192,10 +4144,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 					CACHE_GLYPH_ORDER* order = update_read_cache_glyph_order(update, s, extraFlags);
 
 					if (order)
-					{
 						rc = IFCALLRESULT(defaultReturn, secondary->CacheGlyph, context, order);
-						free_cache_glyph_order(context, order);
-					}
 				}
 				break;
 
@@ -4205,10 +4154,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 					    update_read_cache_glyph_v2_order(update, s, extraFlags);
 
 					if (order)
-					{
 						rc = IFCALLRESULT(defaultReturn, secondary->CacheGlyphV2, context, order);
-						free_cache_glyph_v2_order(context, order);
-					}
 				}
 				break;
 
@@ -4225,10 +4171,7 @@ static BOOL update_recv_secondary_order(rdpUpdate* update, wStream* s, WINPR_ATT
 				CACHE_BRUSH_ORDER* order = update_read_cache_brush_order(update, s, extraFlags);
 
 				if (order)
-				{
 					rc = IFCALLRESULT(defaultReturn, secondary->CacheBrush, context, order);
-					free_cache_brush_order(context, order);
-				}
 			}
 			break;
 
@@ -2516,8 +2516,9 @@ static void rdp_reset_free(rdpRdp* rdp)
 	mcs_free(rdp->mcs);
 	nego_free(rdp->nego);
 	license_free(rdp->license);
-	transport_free(rdp->transport);
+	/* the fastpath reassembly buffer belongs to the transport stream pool */
 	fastpath_free(rdp->fastpath);
+	transport_free(rdp->transport);
 
 	rdp->aad = nullptr;
 	rdp->mcs = nullptr;
@@ -2576,6 +2577,7 @@ void rdp_free(rdpRdp* rdp)
 	if (rdp)
 	{
 		freerdp_timer_free(rdp->timer);
+		rdp->timer = nullptr;
 		rdp_reset_free(rdp);
 
 		freerdp_settings_free(rdp->settings);
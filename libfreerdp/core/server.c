@@ -612,6 +612,12 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptorEx(HANDLE hServer, BOOL autoOpen
 			return FALSE;
 	}
 
+	/* queued channel PDUs (e.g. all PDUs of a graphics pipeline frame) leave as one batch */
+	WINPR_ASSERT(vcm->rdp);
+	const BOOL batch = (MessageQueue_Size(vcm->queue) > 1);
+	if (batch)
+		transport_begin_batch(vcm->rdp->transport);
+
 	while (MessageQueue_Peek(vcm->queue, &message, TRUE))
 	{
 		BYTE* buffer = nullptr;
@@ -634,6 +640,9 @@ BOOL WTSVirtualChannelManagerCheckFileDescriptorEx(HANDLE hServer, BOOL autoOpen
 			break;
 	}
 
+	if (batch && !transport_end_batch(vcm->rdp->transport))
+		status = FALSE;
+
 	return status;
 }
 
@@ -39,6 +39,7 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <net/if.h>
@@ -133,6 +134,75 @@ static int transport_bio_simple_write(BIO* bio, const char* buf, int size)
 	return status;
 }
 
+static long transport_bio_simple_write_vector(BIO* bio, const DataChunk* chunks, long count)
+{
+	WINPR_BIO_SIMPLE_SOCKET* ptr = (WINPR_BIO_SIMPLE_SOCKET*)BIO_get_data(bio);
+	size_t total = 0;
+	long status = 0;
+
+	if (!chunks || (count <= 0) || (count > 4))
+		return 0;
+
+	BIO_clear_flags(bio, BIO_FLAGS_WRITE);
+#if defined(_WIN32)
+	WSABUF buffers[4] = WINPR_C_ARRAY_INIT;
+	for (long x = 0; x < count; x++)
+	{
+		if (chunks[x].size > UINT32_MAX - total)
+			return 0;
+		const BYTE* data = chunks[x].data;
+		buffers[x].len = (ULONG)chunks[x].size;
+		buffers[x].buf = WINPR_CAST_CONST_PTR_AWAY(data, CHAR*);
+		total += chunks[x].size;
+	}
+
+	DWORD sent = 0;
+	if (WSASend(ptr->socket, buffers, (DWORD)count, &sent, 0, nullptr, nullptr) == 0)
+		status = (long)sent;
+	else
+		status = -1;
+#else
+	struct iovec iov[4] = WINPR_C_ARRAY_INIT;
+	for (long x = 0; x < count; x++)
+	{
+		if (chunks[x].size > INT32_MAX - total)
+			return 0;
+		const BYTE* data = chunks[x].data;
+		iov[x].iov_base = WINPR_CAST_CONST_PTR_AWAY(data, void*);
+		iov[x].iov_len = chunks[x].size;
+		total += chunks[x].size;
+	}
+
+	struct msghdr msg = WINPR_C_ARRAY_INIT;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = WINPR_ASSERTING_INT_CAST(size_t, count);
+
+#if defined(MSG_NOSIGNAL)
+	status = sendmsg((int)ptr->socket, &msg, MSG_NOSIGNAL);
+#else
+	status = sendmsg((int)ptr->socket, &msg, 0);
+#endif
+#endif
+
+	if (status <= 0)
+	{
+		const int error = WSAGetLastError();
+
+		if ((error == WSAEWOULDBLOCK) || (error == WSAEINTR) || (error == WSAEINPROGRESS) ||
+		    (error == WSAEALREADY))
+		{
+			BIO_set_flags(bio, (BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY));
+		}
+		else
+		{
+			BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+		}
+		return -1;
+	}
+
+	return status;
+}
+
 static int transport_bio_simple_read(BIO* bio, char* buf, int size)
 {
 	int error = 0;
@@ -338,6 +408,9 @@ static long transport_bio_simple_ctrl(BIO* bio, int cmd, long arg1, void* arg2)
 			status = 1;
 			break;
 
+		case BIO_C_WRITE_VECTOR:
+			return transport_bio_simple_write_vector(bio, (const DataChunk*)arg2, arg1);
+
 		default:
 			status = 0;
 			break;
@@ -449,14 +522,51 @@ BIO_METHOD* BIO_s_simple_socket(void)
 
 /* Buffered Socket BIO */
 
+/* corked data is sent once this many bytes are queued */
+#define BUFFERED_CORK_LIMIT 0x10000
+
 typedef struct
 {
 	BIO* bufferedBio;
 	BOOL readBlocked;
 	BOOL writeBlocked;
+	BOOL corked;
 	RingBuffer xmitBuffer;
+	BIO_WRITE_STATS stats;
 } WINPR_BIO_BUFFERED_SOCKET;
 
+/* @return TRUE if the write should be retried right away */
+static BOOL transport_bio_buffered_retry(BIO* bio, BIO* next_bio, WINPR_BIO_BUFFERED_SOCKET* ptr,
+                                         int* ret)
+{
+	if (!BIO_should_retry(next_bio))
+	{
+		BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
+		*ret = -1; /* fatal error */
+		return FALSE;
+	}
+
+	if (BIO_should_write(next_bio))
+	{
+		BIO_set_flags(bio, BIO_FLAGS_WRITE);
+		ptr->writeBlocked = TRUE;
+		return FALSE; /* EWOULDBLOCK */
+	}
+
+	return TRUE;
+}
+
+static void transport_bio_buffered_consume(DataChunk* chunks, int nchunks, size_t count)
+{
+	for (int i = 0; (i < nchunks) && (count > 0); i++)
+	{
+		const size_t used = MIN(count, chunks[i].size);
+		chunks[i].size -= used;
+		chunks[i].data += used;
+		count -= used;
+	}
+}
+
 static int transport_bio_buffered_write(BIO* bio, const char* buf, int num)
 {
 	int ret = num;
@@ -477,15 +587,44 @@ static int transport_bio_buffered_write(BIO* bio, const char* buf, int num)
 	/* we directly append extra bytes in the xmit buffer, this could be prevented
 	 * but for now it makes the code more simple.
 	 */
-	if (buf && (num > 0) && !ringbuffer_write(&ptr->xmitBuffer, (const BYTE*)buf, (size_t)num))
+	if (buf && (num > 0))
 	{
-		WLog_ERR(TAG, "an error occurred when writing (num: %d)", num);
-		return -1;
+		if (!ringbuffer_write(&ptr->xmitBuffer, (const BYTE*)buf, (size_t)num))
+		{
+			WLog_ERR(TAG, "an error occurred when writing (num: %d)", num);
+			return -1;
+		}
+		ptr->stats.writes++;
+
+		if (ptr->corked && (ringbuffer_used(&ptr->xmitBuffer) < BUFFERED_CORK_LIMIT))
+			return ret;
 	}
 
 	nchunks = ringbuffer_peek(&ptr->xmitBuffer, chunks, ringbuffer_used(&ptr->xmitBuffer));
 	next_bio = BIO_next(bio);
 
+	/* a wrapped around ring buffer is sent with a single system call if the next BIO can */
+	while ((nchunks > 1) && (chunks[0].size > 0))
+	{
+		ERR_clear_error();
+		const long status = BIO_write_vector(next_bio, chunks, nchunks);
+
+		if (status == 0)
+			break;
+
+		if (status < 0)
+		{
+			if (!transport_bio_buffered_retry(bio, next_bio, ptr, &ret))
+				goto out;
+		}
+		else
+		{
+			ptr->stats.syscalls++;
+			committedBytes += (size_t)status;
+			transport_bio_buffered_consume(chunks, nchunks, (size_t)status);
+		}
+	}
+
 	for (int i = 0; i < nchunks; i++)
 	{
 		while (chunks[i].size)
@@ -497,22 +636,12 @@ static int transport_bio_buffered_write(BIO* bio, const char* buf, int num)
 
 			if (status <= 0)
 			{
-				if (!BIO_should_retry(next_bio))
-				{
-					BIO_clear_flags(bio, BIO_FLAGS_SHOULD_RETRY);
-					ret = -1; /* fatal error */
+				if (!transport_bio_buffered_retry(bio, next_bio, ptr, &ret))
 					goto out;
-				}
-
-				if (BIO_should_write(next_bio))
-				{
-					BIO_set_flags(bio, BIO_FLAGS_WRITE);
-					ptr->writeBlocked = TRUE;
-					goto out; /* EWOULDBLOCK */
-				}
 			}
 			else
 			{
+				ptr->stats.syscalls++;
 				committedBytes += (size_t)status;
 				chunks[i].size -= (size_t)status;
 				chunks[i].data += status;
@@ -600,6 +729,20 @@ static long transport_bio_buffered_ctrl(BIO* bio, int cmd, long arg1, void* arg2
 			status = (int)ptr->writeBlocked;
 			break;
 
+		case BIO_C_SET_CORK:
+			ptr->corked = (arg1 != 0);
+			status = 1;
+			if (!ptr->corked && ringbuffer_used(&ptr->xmitBuffer))
+				status = (transport_bio_buffered_write(bio, nullptr, 0) >= 0) ? 1 : -1;
+			break;
+
+		case BIO_C_GET_WRITE_STATS:
+			if (!arg2)
+				break;
+			*((BIO_WRITE_STATS*)arg2) = ptr->stats;
+			status = 1;
+			break;
+
 		default:
 			status = BIO_ctrl(BIO_next(bio), cmd, arg1, arg2);
 			break;
@@ -30,6 +30,7 @@
 #include <freerdp/transport_io.h>
 
 #include <winpr/crt.h>
+#include <winpr/cast.h>
 #include <winpr/synch.h>
 #include <winpr/stream.h>
 #include <winpr/winsock.h>
@@ -53,6 +54,16 @@
 #define BIO_C_WAIT_READ 1107
 #define BIO_C_WAIT_WRITE 1108
 #define BIO_C_SET_HANDLE 1109
+#define BIO_C_SET_CORK 1110
+#define BIO_C_WRITE_VECTOR 1111
+#define BIO_C_GET_WRITE_STATS 1112
+
+/** Write counters of the buffered socket BIO */
+typedef struct
+{
+	UINT64 writes;   /** write calls into the BIO, TLS records if a TLS BIO is on top of it */
+	UINT64 syscalls; /** writes to the socket */
+} BIO_WRITE_STATS;
 
 WINPR_ATTR_NODISCARD
 static inline long BIO_set_socket(BIO* b, SOCKET s, long c)
@@ -103,6 +114,26 @@ static inline long BIO_wait_write(BIO* b, long c)
 	return BIO_ctrl(b, BIO_C_WAIT_WRITE, c, nullptr);
 }
 
+/** While corked the buffered socket BIO queues data, uncorking flushes the queue */
+WINPR_ATTR_NODISCARD
+static inline long BIO_set_cork(BIO* b, long c)
+{
+	return BIO_ctrl(b, BIO_C_SET_CORK, c, nullptr);
+}
+
+/** Write \b c DataChunk elements from \b chunks with a single system call
+ *  @return the number of bytes written, 0 if not supported or < 0 on failure */
+WINPR_ATTR_NODISCARD
+static inline long BIO_write_vector(BIO* b, const DataChunk* chunks, long c)
+{
+	return BIO_ctrl(b, BIO_C_WRITE_VECTOR, c, WINPR_CAST_CONST_PTR_AWAY(chunks, void*));
+}
+
+static inline long BIO_get_write_stats(BIO* b, BIO_WRITE_STATS* stats)
+{
+	return BIO_ctrl(b, BIO_C_GET_WRITE_STATS, 0, stats);
+}
+
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BIO_METHOD* BIO_s_simple_socket(void);
 
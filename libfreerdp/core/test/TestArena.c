@@ -0,0 +1,125 @@
+#include <winpr/crt.h>
+
+#include "../arena.h"
+
+#define TEST_BLOCK_SIZE 1024
+#define TEST_CHUNK_SIZE 16
+
+/* Allocate \b count chunks, they must be zeroed and follow each other within one block */
+static BOOL test_contiguous(rdpArena* arena, size_t count, BYTE** plast)
+{
+	BYTE* last = nullptr;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		BYTE* ptr = arena_calloc(arena, 1, TEST_CHUNK_SIZE);
+		if (!ptr)
+			return FALSE;
+
+		for (size_t y = 0; y < TEST_CHUNK_SIZE; y++)
+		{
+			if (ptr[y] != 0)
+			{
+				(void)fprintf(stderr, "allocation %" PRIuz " is not zeroed\n", x);
+				return FALSE;
+			}
+		}
+
+		if (last && ((uintptr_t)ptr != (uintptr_t)last + TEST_CHUNK_SIZE))
+		{
+			(void)fprintf(stderr, "allocation %" PRIuz " of %" PRIuz " starts a new block\n", x,
+			              count);
+			return FALSE;
+		}
+
+		memset(ptr, 0xA5, TEST_CHUNK_SIZE);
+		last = ptr;
+	}
+
+	if (plast)
+		*plast = last;
+	return TRUE;
+}
+
+static BOOL test_round(rdpArena* arena, size_t length)
+{
+	for (size_t x = 0; x < length / TEST_CHUNK_SIZE; x++)
+	{
+		BYTE* ptr = arena_calloc(arena, 1, TEST_CHUNK_SIZE);
+		if (!ptr)
+			return FALSE;
+		memset(ptr, 0x5A, TEST_CHUNK_SIZE);
+	}
+
+	arena_reset(arena);
+	return TRUE;
+}
+
+static BOOL test_alignment(rdpArena* arena)
+{
+	const size_t sizes[] = { 1, 3, 17, 100, 4 * TEST_BLOCK_SIZE, 7 };
+
+	for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+	{
+		BYTE* ptr = arena_calloc(arena, sizes[x], 1);
+		if (!ptr || (((uintptr_t)ptr % 16) != 0))
+			return FALSE;
+		memset(ptr, 0xFF, sizes[x]);
+	}
+
+	if (arena_calloc(arena, SIZE_MAX / 2, 4))
+	{
+		(void)fprintf(stderr, "overflowing allocation succeeded\n");
+		return FALSE;
+	}
+
+	arena_reset(arena);
+	return TRUE;
+}
+
+int TestArena(int argc, char* argv[])
+{
+	int rc = -1;
+	rdpArena* arena = arena_new(TEST_BLOCK_SIZE);
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!arena)
+		return -1;
+
+	if (!test_alignment(arena))
+		goto fail;
+
+	/* a block of the initial size is used first */
+	if (!test_contiguous(arena, TEST_BLOCK_SIZE / TEST_CHUNK_SIZE, nullptr))
+		goto fail;
+	arena_reset(arena);
+
+	/* a round of a few blocks is merged into one */
+	if (!test_round(arena, 3 * TEST_BLOCK_SIZE) ||
+	    !test_contiguous(arena, 3 * TEST_BLOCK_SIZE / TEST_CHUNK_SIZE, nullptr))
+		goto fail;
+	arena_reset(arena);
+
+	/* an exceptionally large round must not be kept, the next one starts small again */
+	{
+		BYTE* last = nullptr;
+		if (!test_round(arena, 100 * TEST_BLOCK_SIZE) ||
+		    !test_contiguous(arena, TEST_BLOCK_SIZE / TEST_CHUNK_SIZE, &last))
+			goto fail;
+
+		const BYTE* next = arena_calloc(arena, 1, TEST_CHUNK_SIZE);
+		if (!next || ((uintptr_t)next == (uintptr_t)last + TEST_CHUNK_SIZE))
+		{
+			(void)fprintf(stderr, "arena kept %d bytes\n", 100 * TEST_BLOCK_SIZE);
+			goto fail;
+		}
+		arena_reset(arena);
+	}
+
+	rc = 0;
+fail:
+	arena_free(arena);
+	return rc;
+}
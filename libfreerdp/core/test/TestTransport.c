@@ -0,0 +1,337 @@
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <winpr/crt.h>
+#include <winpr/stream.h>
+#include <winpr/thread.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/metrics.h>
+#include <freerdp/settings.h>
+
+#include "../rdp.h"
+#include "../transport.h"
+
+#define TEST_PDU_SIZE 100
+#define TEST_PDU_COUNT 10
+
+typedef struct
+{
+	rdpTransport* transport;
+	BYTE tag;
+	int status;
+} TEST_WRITER;
+
+typedef struct
+{
+	int fd;
+	BYTE* data;
+	size_t size;
+	size_t received;
+} TEST_READER;
+
+static int test_write(rdpTransport* transport, BYTE tag)
+{
+	int status = -1;
+	wStream* s = Stream_New(nullptr, TEST_PDU_SIZE);
+	if (!s)
+		return -1;
+
+	for (size_t x = 0; x < TEST_PDU_SIZE; x++)
+		Stream_Write_UINT8(s, tag);
+
+	status = transport_write(transport, s);
+	Stream_Free(s, TRUE);
+	return status;
+}
+
+/* Read what arrived at the other end of the connection within timeout milliseconds */
+static size_t test_receive(int fd, BYTE* data, size_t size, int timeout)
+{
+	size_t received = 0;
+
+	while (received < size)
+	{
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		if (poll(&pfd, 1, timeout) <= 0)
+			break;
+
+		const ssize_t rc = recv(fd, &data[received], size - received, MSG_DONTWAIT);
+		if (rc <= 0)
+			break;
+		received += (size_t)rc;
+	}
+
+	return received;
+}
+
+static BOOL test_check(const BYTE* data, size_t length, BYTE tag)
+{
+	for (size_t x = 0; x < length; x++)
+	{
+		if (data[x] != tag)
+		{
+			(void)fprintf(stderr, "byte %" PRIuz ": got 0x%02" PRIx8 ", expected 0x%02" PRIx8 "\n",
+			              x, data[x], tag);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* All PDUs of a frame leave with a single write at the end of the batch */
+static BOOL test_batch(rdpContext* context, int fd)
+{
+	BYTE data[TEST_PDU_SIZE * TEST_PDU_COUNT] = WINPR_C_ARRAY_INIT;
+	rdpTransport* transport = context->rdp->transport;
+	rdpMetrics* metrics = context->metrics;
+	const UINT64 frames = metrics->TotalFrames;
+	const UINT64 syscalls = metrics->TotalWriteSyscalls;
+
+	if (!transport_begin_batch(transport))
+		return FALSE;
+
+	for (size_t x = 0; x < TEST_PDU_COUNT; x++)
+	{
+		if (test_write(transport, 0x42) < 0)
+			return FALSE;
+	}
+
+	if (test_receive(fd, data, sizeof(data), 0) != 0)
+	{
+		(void)fprintf(stderr, "batched PDUs were sent before the end of the frame\n");
+		return FALSE;
+	}
+
+	if (!transport_end_batch(transport))
+		return FALSE;
+
+	if ((test_receive(fd, data, sizeof(data), 1000) != sizeof(data)) ||
+	    !test_check(data, sizeof(data), 0x42))
+		return FALSE;
+
+	if ((metrics->TotalFrames != frames + 1) || (metrics->TotalWriteSyscalls != syscalls + 1))
+	{
+		(void)fprintf(stderr, "frame accounted %" PRIu64 " frames with %" PRIu64 " syscalls\n",
+		              metrics->TotalFrames - frames, metrics->TotalWriteSyscalls - syscalls);
+		return FALSE;
+	}
+
+	/* no TLS on the connection */
+	if ((metrics->SyscallsPerFrame != 1.0) || (metrics->TlsRecordsPerFrame != 0.0))
+	{
+		(void)fprintf(stderr, "%lf syscalls and %lf records per frame\n",
+		              metrics->SyscallsPerFrame, metrics->TlsRecordsPerFrame);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* A PDU does not wait for the end of a frame that takes too long */
+static BOOL test_latency(rdpContext* context, int fd)
+{
+	BYTE data[TEST_PDU_SIZE] = WINPR_C_ARRAY_INIT;
+	rdpTransport* transport = context->rdp->transport;
+
+	if (!transport_begin_batch(transport))
+		return FALSE;
+
+	if (test_write(transport, 0x17) < 0)
+		goto fail;
+
+	if ((test_receive(fd, data, sizeof(data), 1000) != sizeof(data)) ||
+	    !test_check(data, sizeof(data), 0x17))
+	{
+		(void)fprintf(stderr, "batched PDU was not flushed while the frame is open\n");
+		goto fail;
+	}
+
+	return transport_end_batch(transport);
+
+fail:
+	(void)transport_end_batch(transport);
+	return FALSE;
+}
+
+static DWORD WINAPI test_writer(LPVOID arg)
+{
+	TEST_WRITER* writer = arg;
+	WINPR_ASSERT(writer);
+
+	/* does not take over the batch of the main thread */
+	if (!transport_begin_batch(writer->transport))
+		return 0;
+	writer->status = test_write(writer->transport, writer->tag);
+	if (!transport_end_batch(writer->transport))
+		writer->status = -1;
+	return 0;
+}
+
+/* PDUs of other threads do not join the batch and do not overtake it */
+static BOOL test_foreign_writer(rdpContext* context, int fd)
+{
+	BYTE data[TEST_PDU_SIZE * 2] = WINPR_C_ARRAY_INIT;
+	rdpTransport* transport = context->rdp->transport;
+	TEST_WRITER writer = { .transport = transport, .tag = 0x33, .status = -1 };
+
+	if (!transport_begin_batch(transport))
+		return FALSE;
+
+	if (test_write(transport, 0x22) < 0)
+		goto fail;
+
+	{
+		HANDLE thread = CreateThread(nullptr, 0, test_writer, &writer, 0, nullptr);
+		if (!thread)
+			goto fail;
+		(void)WaitForSingleObject(thread, INFINITE);
+		(void)CloseHandle(thread);
+	}
+
+	if (writer.status < 0)
+		goto fail;
+
+	if ((test_receive(fd, data, sizeof(data), 1000) != sizeof(data)) ||
+	    !test_check(data, TEST_PDU_SIZE, 0x22) ||
+	    !test_check(&data[TEST_PDU_SIZE], TEST_PDU_SIZE, 0x33))
+	{
+		(void)fprintf(stderr, "PDUs of other threads were not sent in order\n");
+		goto fail;
+	}
+
+	if (test_write(transport, 0x44) < 0)
+		goto fail;
+	if (test_receive(fd, data, TEST_PDU_SIZE, 0) != 0)
+	{
+		(void)fprintf(stderr, "the batch ended with the one of another thread\n");
+		goto fail;
+	}
+
+	if (!transport_end_batch(transport))
+		return FALSE;
+
+	return (test_receive(fd, data, TEST_PDU_SIZE, 1000) == TEST_PDU_SIZE) &&
+	       test_check(data, TEST_PDU_SIZE, 0x44);
+
+fail:
+	(void)transport_end_batch(transport);
+	return FALSE;
+}
+
+static DWORD WINAPI test_reader(LPVOID arg)
+{
+	TEST_READER* reader = arg;
+	WINPR_ASSERT(reader);
+
+	reader->received = test_receive(reader->fd, reader->data, reader->size, 1000);
+	return 0;
+}
+
+/* A batch the socket only takes in parts is completely sent when waiting for the output */
+static BOOL test_partial_send(rdpContext* context, int fd)
+{
+	BOOL rc = FALSE;
+	const size_t count = 600;
+	rdpTransport* transport = context->rdp->transport;
+	TEST_READER reader = { .fd = fd, .size = count * TEST_PDU_SIZE };
+	HANDLE thread = nullptr;
+
+	reader.data = calloc(count, TEST_PDU_SIZE);
+	if (!reader.data)
+		return FALSE;
+
+	if (!freerdp_settings_set_bool(context->settings, FreeRDP_WaitForOutputBufferFlush, TRUE))
+		goto fail;
+
+	/* the latency timer might flush the batch before it ends */
+	thread = CreateThread(nullptr, 0, test_reader, &reader, 0, nullptr);
+	if (!thread)
+		goto fail;
+
+	if (!transport_begin_batch(transport))
+		goto fail;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (test_write(transport, 0x55) < 0)
+		{
+			(void)transport_end_batch(transport);
+			goto fail;
+		}
+	}
+
+	if (!transport_end_batch(transport))
+		goto fail;
+
+	(void)WaitForSingleObject(thread, INFINITE);
+	if ((reader.received != reader.size) || !test_check(reader.data, reader.size, 0x55))
+	{
+		(void)fprintf(stderr, "only %" PRIuz " of %" PRIuz " batched bytes were sent\n",
+		              reader.received, reader.size);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	if (thread)
+	{
+		(void)WaitForSingleObject(thread, INFINITE);
+		(void)CloseHandle(thread);
+	}
+	(void)freerdp_settings_set_bool(context->settings, FreeRDP_WaitForOutputBufferFlush, FALSE);
+	free(reader.data);
+	return rc;
+}
+
+int TestTransport(int argc, char* argv[])
+{
+	int result = -1;
+	int fds[2] = { -1, -1 };
+	freerdp_peer* client = nullptr;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+		return -1;
+
+	/* small socket buffers, so a large batch can not be sent at once */
+	{
+		const int size = 4096;
+		(void)setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+		(void)setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+
+	client = freerdp_peer_new(fds[0]);
+	if (!client)
+		goto fail;
+	fds[0] = -1;
+
+	if (!freerdp_peer_context_new(client))
+		goto fail;
+
+	if (!test_batch(client->context, fds[1]))
+		goto fail;
+
+	if (!test_latency(client->context, fds[1]))
+		goto fail;
+
+	if (!test_foreign_writer(client->context, fds[1]))
+		goto fail;
+
+	if (!test_partial_send(client->context, fds[1]))
+		goto fail;
+
+	result = 0;
+fail:
+	if (client)
+		freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+	if (fds[0] >= 0)
+		close(fds[0]);
+	if (fds[1] >= 0)
+		close(fds[1]);
+	return result;
+}
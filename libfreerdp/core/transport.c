@@ -25,6 +25,7 @@
 
 #include <winpr/crt.h>
 #include <winpr/synch.h>
+#include <winpr/sysinfo.h>
 #include <winpr/print.h>
 #include <winpr/stream.h>
 #include <winpr/winsock.h>
@@ -32,6 +33,7 @@
 
 #include <freerdp/log.h>
 #include <freerdp/error.h>
+#include <freerdp/timer.h>
 #include <freerdp/utils/ringbuffer.h>
 
 #include <openssl/bio.h>
@@ -65,6 +67,15 @@
 
 #define BUFFER_SIZE 16384
 
+/* PDUs of a frame are coalesced into writes of up to 4 full TLS records */
+#define TRANSPORT_BATCH_SIZE (4ull * 16384ull)
+
+/* and no coalesced PDU waits longer than 5ms for the end of its frame */
+#define TRANSPORT_BATCH_LATENCY_NS (5ull * 1000ull * 1000ull)
+
+/* retry interval of the latency timer while a writer holds the lock */
+#define TRANSPORT_BATCH_RETRY_NS (1000ull * 1000ull)
+
 struct rdp_transport
 {
 	TRANSPORT_LAYER layer;
@@ -90,6 +101,13 @@ struct rdp_transport
 	BOOL haveWriteLock;
 	CRITICAL_SECTION WriteLock;
 	UINT64 written;
+	wStream* batch;
+	size_t batchDepth;
+	size_t batchPdus;
+	DWORD batchOwner;
+	UINT64 batchStart;
+	BIO_WRITE_STATS batchStats;
+	FreeRDP_TimerID batchTimer;
 	HANDLE rereadEvent;
 	BOOL haveMoreBytesToRead;
 	wLog* log;
@@ -1200,6 +1218,239 @@ int transport_write(rdpTransport* transport, wStream* s)
 	return IFCALLRESULT(-1, transport->io.WritePdu, transport, s);
 }
 
+/* Must be called with WriteLock held */
+static BOOL transport_wait_output_flush(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	rdpContext* context = transport_get_context(transport);
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->settings);
+
+	if (!transport->blocking && !context->settings->WaitForOutputBufferFlush)
+		return TRUE;
+
+	while (BIO_write_blocked(transport->frontBio))
+	{
+		if (BIO_wait_write(transport->frontBio, 100) < 0)
+		{
+			WLog_Print(transport->log, WLOG_ERROR, "error when selecting for write");
+			return FALSE;
+		}
+
+		if (BIO_flush(transport->frontBio) < 1)
+		{
+			WLog_Print(transport->log, WLOG_ERROR, "error when flushing outputBuffer");
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Must be called with WriteLock held */
+static int transport_write_bio(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	int status = -1;
+	const size_t writtenlength = length;
+
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(data || (length == 0));
+
+	while (length > 0)
+	{
+		ERR_clear_error();
+		const int towrite = (length > INT32_MAX) ? INT32_MAX : (int)length;
+		status = BIO_write(transport->frontBio, data, towrite);
+
+		if (status <= 0)
+		{
+			/* the buffered BIO that is at the end of the chain always says OK for writing,
+			 * so a retry means that for any reason we need to read. The most probable
+			 * is a SSL or TSG BIO in the chain.
+			 */
+			if (!BIO_should_retry(transport->frontBio))
+			{
+				WLog_ERR_BIO(transport, "BIO_should_retry", transport->frontBio);
+				return -1;
+			}
+
+			/* non-blocking can live with blocked IOs */
+			if (!transport->blocking)
+			{
+				WLog_ERR_BIO(transport, "BIO_write", transport->frontBio);
+				return -1;
+			}
+
+			if (BIO_wait_write(transport->frontBio, 100) < 0)
+			{
+				WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
+				return -1;
+			}
+
+			continue;
+		}
+
+		if (!transport_wait_output_flush(transport))
+			return -1;
+
+		const size_t ustatus = (size_t)status;
+		if (ustatus > length)
+			return -1;
+
+		length -= ustatus;
+		data += ustatus;
+	}
+
+	transport->written += writtenlength;
+	return status;
+}
+
+/* Must be called with WriteLock held */
+static int transport_batch_flush(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	const size_t length = Stream_GetPosition(transport->batch);
+	if (length == 0)
+		return 0;
+
+	Stream_ResetPosition(transport->batch);
+
+	/* all TLS records of the batch leave with as few socket writes as possible */
+	const BOOL corked = (BIO_set_cork(transport->frontBio, 1) == 1);
+	int status = transport_write_bio(transport, Stream_Buffer(transport->batch), length);
+	if (!corked)
+		return status;
+
+	/* the batch is only sent when uncorking, a partial send stays in the output buffer */
+	if (BIO_set_cork(transport->frontBio, 0) < 0)
+	{
+		if (status >= 0)
+			WLog_ERR_BIO(transport, "BIO_set_cork", transport->frontBio);
+		return -1;
+	}
+
+	if ((status >= 0) && !transport_wait_output_flush(transport))
+		return -1;
+
+	return status;
+}
+
+/* Must be called with WriteLock held */
+static void transport_batch_failed(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	/* A write error indicates that the peer has dropped the connection */
+	transport->layer = TRANSPORT_LAYER_CLOSED;
+	freerdp_set_last_error_if_not(transport_get_context(transport),
+	                              FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+}
+
+/* Flushes batched PDUs that waited too long for the end of their frame.
+ * Runs on the timer thread which holds the timer list lock, so the WriteLock is
+ * only tried to not deadlock against a writer arming the timer. */
+static uint64_t transport_batch_timer(WINPR_ATTR_UNUSED rdpContext* context, void* userdata,
+                                      FreeRDP_TimerID timerID, uint64_t timestamp,
+                                      WINPR_ATTR_UNUSED uint64_t interval)
+{
+	uint64_t next = 0;
+	rdpTransport* transport = userdata;
+	WINPR_ASSERT(transport);
+
+	if (!TryEnterCriticalSection(&(transport->WriteLock)))
+		return TRANSPORT_BATCH_RETRY_NS;
+
+	if (transport->batchTimer != timerID)
+		goto out;
+
+	if (Stream_GetPosition(transport->batch) == 0)
+	{
+		transport->batchTimer = 0;
+		goto out;
+	}
+
+	{
+		const UINT64 start = transport->batchStart;
+		const UINT64 age = (timestamp > start) ? timestamp - start : 0;
+		if (age < TRANSPORT_BATCH_LATENCY_NS)
+		{
+			next = TRANSPORT_BATCH_LATENCY_NS - age;
+			goto out;
+		}
+	}
+
+	transport->batchTimer = 0;
+	if (transport->frontBio && (transport_batch_flush(transport) < 0))
+		transport_batch_failed(transport);
+
+out:
+	LeaveCriticalSection(&(transport->WriteLock));
+	return next;
+}
+
+/* Must be called with WriteLock held */
+static void transport_batch_timer_stop(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	if (transport->batchTimer == 0)
+		return;
+
+	rdpContext* context = transport_get_context(transport);
+	if (context && context->rdp && context->rdp->timer)
+		(void)freerdp_timer_remove(context, transport->batchTimer);
+	transport->batchTimer = 0;
+}
+
+/* Must be called with WriteLock held */
+static void transport_batch_timer_start(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	if (transport->batchTimer != 0)
+		return;
+
+	/* Without a timer the latency is only bound by the writes of the frame */
+	rdpContext* context = transport_get_context(transport);
+	if (context && context->rdp && context->rdp->timer)
+		transport->batchTimer = freerdp_timer_add(context, TRANSPORT_BATCH_LATENCY_NS,
+		                                          transport_batch_timer, transport, false);
+}
+
+/* Must be called with WriteLock held */
+static int transport_batch_append(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	WINPR_ASSERT(transport);
+
+	wStream* batch = transport->batch;
+	const UINT64 now = winpr_GetTickCount64NS();
+	if (Stream_GetPosition(batch) == 0)
+	{
+		transport->batchStart = now;
+		transport_batch_timer_start(transport);
+	}
+
+	if (!Stream_EnsureRemainingCapacity(batch, length))
+		return -1;
+	Stream_Write(batch, data, length);
+	transport->batchPdus++;
+
+	if ((Stream_GetPosition(batch) >= TRANSPORT_BATCH_SIZE) ||
+	    (now - transport->batchStart >= TRANSPORT_BATCH_LATENCY_NS))
+		return transport_batch_flush(transport);
+
+	return (length > INT32_MAX) ? INT32_MAX : (int)length;
+}
+
+/* Must be called with WriteLock held */
+static BOOL transport_batch_owned(const rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+	return (transport->batchDepth > 0) && (transport->batchOwner == GetCurrentThreadId());
+}
+
 static int transport_default_write(rdpTransport* transport, wStream* s)
 {
 	int status = -1;
@@ -1222,8 +1473,7 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 		goto out_cleanup;
 
 	{
-		size_t length = Stream_GetPosition(s);
-		size_t writtenlength = length;
+		const size_t length = Stream_GetPosition(s);
 		Stream_ResetPosition(s);
 
 		if (length > 0)
@@ -1232,88 +1482,87 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 			WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length, WLOG_PACKET_OUTBOUND);
 		}
 
-		while (length > 0)
-		{
-			ERR_clear_error();
-			const int towrite = (length > INT32_MAX) ? INT32_MAX : (int)length;
-			status = BIO_write(transport->frontBio, Stream_ConstPointer(s), towrite);
+		/* PDUs of other threads do not join the batch but must not overtake it */
+		if (transport_batch_owned(transport))
+			status = transport_batch_append(transport, Stream_ConstPointer(s), length);
+		else if (transport_batch_flush(transport) >= 0)
+			status = transport_write_bio(transport, Stream_ConstPointer(s), length);
+	}
+out_cleanup:
 
-			if (status <= 0)
-			{
-				/* the buffered BIO that is at the end of the chain always says OK for writing,
-				 * so a retry means that for any reason we need to read. The most probable
-				 * is a SSL or TSG BIO in the chain.
-				 */
-				if (!BIO_should_retry(transport->frontBio))
-				{
-					WLog_ERR_BIO(transport, "BIO_should_retry", transport->frontBio);
-					goto out_cleanup;
-				}
+	if (status < 0)
+		transport_batch_failed(transport);
 
-				/* non-blocking can live with blocked IOs */
-				if (!transport->blocking)
-				{
-					WLog_ERR_BIO(transport, "BIO_write", transport->frontBio);
-					goto out_cleanup;
-				}
+	LeaveCriticalSection(&(transport->WriteLock));
+fail:
+	Stream_Release(s);
+	return status;
+}
 
-				if (BIO_wait_write(transport->frontBio, 100) < 0)
-				{
-					WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
-					status = -1;
-					goto out_cleanup;
-				}
+BOOL transport_begin_batch(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
 
-				continue;
-			}
+	EnterCriticalSection(&(transport->WriteLock));
+	if (transport->batchDepth == 0)
+	{
+		BIO_WRITE_STATS stats = WINPR_C_ARRAY_INIT;
+		if (transport->frontBio)
+			BIO_get_write_stats(transport->frontBio, &stats);
+		transport->batchStats = stats;
+		transport->batchPdus = 0;
+		transport->batchOwner = GetCurrentThreadId();
+	}
 
-			WINPR_ASSERT(context->settings);
-			if (transport->blocking || context->settings->WaitForOutputBufferFlush)
-			{
-				while (BIO_write_blocked(transport->frontBio))
-				{
-					if (BIO_wait_write(transport->frontBio, 100) < 0)
-					{
-						WLog_Print(transport->log, WLOG_ERROR, "error when selecting for write");
-						status = -1;
-						goto out_cleanup;
-					}
+	/* the batch belongs to the thread that began it, others write directly */
+	if (transport->batchOwner == GetCurrentThreadId())
+		transport->batchDepth++;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return TRUE;
+}
 
-					if (BIO_flush(transport->frontBio) < 1)
-					{
-						WLog_Print(transport->log, WLOG_ERROR, "error when flushing outputBuffer");
-						status = -1;
-						goto out_cleanup;
-					}
-				}
-			}
+BOOL transport_end_batch(rdpTransport* transport)
+{
+	BOOL rc = TRUE;
+	WINPR_ASSERT(transport);
 
-			const size_t ustatus = (size_t)status;
-			if (ustatus > length)
-			{
-				status = -1;
-				goto out_cleanup;
-			}
+	rdpContext* context = transport_get_context(transport);
+	WINPR_ASSERT(context);
 
-			length -= ustatus;
-			Stream_Seek(s, ustatus);
-		}
+	EnterCriticalSection(&(transport->WriteLock));
+	if (!transport_batch_owned(transport))
+		goto out;
+
+	if (--transport->batchDepth > 0)
+		goto out;
 
-		transport->written += writtenlength;
+	if (!transport->frontBio)
+		goto out;
+
+	if (transport_batch_flush(transport) < 0)
+	{
+		transport_batch_failed(transport);
+		rc = FALSE;
+		goto out;
 	}
-out_cleanup:
 
-	if (status < 0)
+	/* only frames that wrote anything are accounted */
+	if (transport->batchPdus > 0)
 	{
-		/* A write error indicates that the peer has dropped the connection */
-		transport->layer = TRANSPORT_LAYER_CLOSED;
-		freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+		BIO_WRITE_STATS stats = WINPR_C_ARRAY_INIT;
+		if ((BIO_get_write_stats(transport->frontBio, &stats) == 1) && context->metrics)
+		{
+			const UINT64 records = (transport->layer == TRANSPORT_LAYER_TLS)
+			                           ? stats.writes - transport->batchStats.writes
+			                           : 0;
+			metrics_write_frame(context->metrics, stats.syscalls - transport->batchStats.syscalls,
+			                    records);
+		}
 	}
 
+out:
 	LeaveCriticalSection(&(transport->WriteLock));
-fail:
-	Stream_Release(s);
-	return status;
+	return rc;
 }
 
 BOOL transport_get_public_key(rdpTransport* transport, const BYTE** data, DWORD* length)
@@ -1693,6 +1942,9 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 	transport->frontBio = nullptr;
 	transport->layer = TRANSPORT_LAYER_TCP;
 	transport->earlyUserAuth = FALSE;
+	transport->batchDepth = 0;
+	Stream_ResetPosition(transport->batch);
+	transport_batch_timer_stop(transport);
 	LeaveCriticalSection(&(transport->WriteLock));
 	LeaveCriticalSection(&(transport->ReadLock));
 	return status;
@@ -1743,6 +1995,11 @@ rdpTransport* transport_new(rdpContext* context)
 	if (!transport->ioEvent || transport->ioEvent == INVALID_HANDLE_VALUE)
 		goto fail;
 
+	transport->batch = Stream_New(nullptr, TRANSPORT_BATCH_SIZE);
+
+	if (!transport->batch)
+		goto fail;
+
 	transport->haveMoreBytesToRead = FALSE;
 	transport->blocking = TRUE;
 	transport->GatewayEnabled = FALSE;
@@ -1794,10 +2051,14 @@ void transport_free(rdpTransport* transport)
 		EnterCriticalSection(&(transport->ReadLock));
 
 	if (transport->haveWriteLock)
+	{
 		EnterCriticalSection(&(transport->WriteLock));
+		transport_batch_timer_stop(transport);
+	}
 
 	nla_free(transport->nla);
 	StreamPool_Free(transport->ReceivePool);
+	Stream_Free(transport->batch, TRUE);
 	(void)CloseHandle(transport->connectedEvent);
 	(void)CloseHandle(transport->rereadEvent);
 	(void)CloseHandle(transport->ioEvent);
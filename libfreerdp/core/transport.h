@@ -134,6 +134,20 @@ FREERDP_LOCAL int transport_read_pdu(rdpTransport* transport, wStream* s);
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL int transport_write(rdpTransport* transport, wStream* s);
 
+/** Coalesce the PDUs written until the matching \b transport_end_batch
+ *
+ *  The PDUs of a frame are sent with large writes. Batches nest, the data is
+ *  flushed at the end of the outermost one, once enough data was queued or when
+ *  a queued PDU waited for too long.
+ *  The batch belongs to the calling thread, PDUs written by other threads in the
+ *  meantime flush it and are sent directly.
+ */
+FREERDP_LOCAL BOOL transport_begin_batch(rdpTransport* transport);
+
+/** Flush the PDUs of the batch and account the frame in the metrics */
+WINPR_ATTR_NODISCARD
+FREERDP_LOCAL BOOL transport_end_batch(rdpTransport* transport);
+
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BOOL transport_get_public_key(rdpTransport* transport, const BYTE** data,
                                             DWORD* length);
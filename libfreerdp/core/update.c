@@ -48,6 +48,9 @@
 
 #define FORCE_ASYNC_UPDATE_OFF
 
+/* initial size of the per PDU arena, it grows to the largest PDU seen */
+#define UPDATE_ARENA_BLOCK_SIZE 16384
+
 static const char* const UPDATE_TYPE_STRINGS[] = { "Orders", "Bitmap", "Palette", "Synchronize" };
 
 static const char* update_type_to_string(UINT16 updateType)
@@ -137,12 +140,7 @@ static BOOL update_read_bitmap_data(rdpUpdate* update, wStream* s, BITMAP_DATA*
 
 	if (bitmapData->bitmapLength > 0)
 	{
-		bitmapData->bitmapDataStream = malloc(bitmapData->bitmapLength);
-
-		if (!bitmapData->bitmapDataStream)
-			return FALSE;
-
-		memcpy(bitmapData->bitmapDataStream, Stream_ConstPointer(s), bitmapData->bitmapLength);
+		bitmapData->bitmapDataStream = Stream_Pointer(s);
 		Stream_Seek(s, bitmapData->bitmapLength);
 	}
 
@@ -231,8 +229,8 @@ static BOOL update_write_bitmap_data(rdpUpdate* update_pub, wStream* s, BITMAP_D
 
 BITMAP_UPDATE* update_read_bitmap_update(rdpUpdate* update, wStream* s)
 {
-	BITMAP_UPDATE* bitmapUpdate = calloc(1, sizeof(BITMAP_UPDATE));
 	rdp_update_internal* up = update_cast(update);
+	BITMAP_UPDATE* bitmapUpdate = arena_calloc(up->arena, 1, sizeof(BITMAP_UPDATE));
 
 	if (!bitmapUpdate)
 		goto fail;
@@ -243,7 +241,8 @@ BITMAP_UPDATE* update_read_bitmap_update(rdpUpdate* update, wStream* s)
 	Stream_Read_UINT16(s, bitmapUpdate->number); /* numberRectangles (2 bytes) */
 	WLog_Print(up->log, WLOG_TRACE, "BitmapUpdate: %" PRIu32 "", bitmapUpdate->number);
 
-	bitmapUpdate->rectangles = (BITMAP_DATA*)calloc(bitmapUpdate->number, sizeof(BITMAP_DATA));
+	bitmapUpdate->rectangles =
+	    (BITMAP_DATA*)arena_calloc(up->arena, bitmapUpdate->number, sizeof(BITMAP_DATA));
 
 	if (!bitmapUpdate->rectangles)
 		goto fail;
@@ -257,10 +256,6 @@ BITMAP_UPDATE* update_read_bitmap_update(rdpUpdate* update, wStream* s)
 
 	return bitmapUpdate;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_bitmap_update(update->context, bitmapUpdate);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -289,7 +284,8 @@ static BOOL update_write_bitmap_update(rdpUpdate* update, wStream* s,
 
 PALETTE_UPDATE* update_read_palette(rdpUpdate* update, wStream* s)
 {
-	PALETTE_UPDATE* palette_update = calloc(1, sizeof(PALETTE_UPDATE));
+	rdp_update_internal* up = update_cast(update);
+	PALETTE_UPDATE* palette_update = arena_calloc(up->arena, 1, sizeof(PALETTE_UPDATE));
 
 	if (!palette_update)
 		goto fail;
@@ -317,10 +313,6 @@ PALETTE_UPDATE* update_read_palette(rdpUpdate* update, wStream* s)
 
 	return palette_update;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_palette_update(update->context, palette_update);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -360,10 +352,12 @@ BOOL update_recv_play_sound(rdpUpdate* update, wStream* s)
 
 POINTER_POSITION_UPDATE* update_read_pointer_position(rdpUpdate* update, wStream* s)
 {
-	POINTER_POSITION_UPDATE* pointer_position = calloc(1, sizeof(POINTER_POSITION_UPDATE));
-
 	WINPR_ASSERT(update);
 
+	rdp_update_internal* up = update_cast(update);
+	POINTER_POSITION_UPDATE* pointer_position =
+	    arena_calloc(up->arena, 1, sizeof(POINTER_POSITION_UPDATE));
+
 	if (!pointer_position)
 		goto fail;
 
@@ -374,19 +368,17 @@ POINTER_POSITION_UPDATE* update_read_pointer_position(rdpUpdate* update, wStream
 	Stream_Read_UINT16(s, pointer_position->yPos); /* yPos (2 bytes) */
 	return pointer_position;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_pointer_position_update(update->context, pointer_position);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
 POINTER_SYSTEM_UPDATE* update_read_pointer_system(rdpUpdate* update, wStream* s)
 {
-	POINTER_SYSTEM_UPDATE* pointer_system = calloc(1, sizeof(POINTER_SYSTEM_UPDATE));
-
 	WINPR_ASSERT(update);
 
+	rdp_update_internal* up = update_cast(update);
+	POINTER_SYSTEM_UPDATE* pointer_system =
+	    arena_calloc(up->arena, 1, sizeof(POINTER_SYSTEM_UPDATE));
+
 	if (!pointer_system)
 		goto fail;
 
@@ -396,17 +388,12 @@ POINTER_SYSTEM_UPDATE* update_read_pointer_system(rdpUpdate* update, wStream* s)
 	Stream_Read_UINT32(s, pointer_system->type); /* systemPointerType (4 bytes) */
 	return pointer_system;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_pointer_system_update(update->context, pointer_system);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
 static BOOL s_update_read_pointer_color(wStream* s, POINTER_COLOR_UPDATE* pointer_color,
                                         BYTE xorBpp, UINT32 flags)
 {
-	BYTE* newMask = nullptr;
 	UINT32 scanlineSize = 0;
 	UINT32 max = 32;
 
@@ -483,13 +470,8 @@ static BOOL s_update_read_pointer_color(wStream* s, POINTER_COLOR_UPDATE* pointe
 			goto fail;
 		}
 
-		newMask = realloc(pointer_color->xorMaskData, pointer_color->lengthXorMask);
-
-		if (!newMask)
-			goto fail;
-
-		pointer_color->xorMaskData = newMask;
-		Stream_Read(s, pointer_color->xorMaskData, pointer_color->lengthXorMask);
+		pointer_color->xorMaskData = Stream_Pointer(s);
+		Stream_Seek(s, pointer_color->lengthXorMask);
 	}
 
 	if (pointer_color->lengthAndMask > 0)
@@ -514,13 +496,8 @@ static BOOL s_update_read_pointer_color(wStream* s, POINTER_COLOR_UPDATE* pointe
 			goto fail;
 		}
 
-		newMask = realloc(pointer_color->andMaskData, pointer_color->lengthAndMask);
-
-		if (!newMask)
-			goto fail;
-
-		pointer_color->andMaskData = newMask;
-		Stream_Read(s, pointer_color->andMaskData, pointer_color->lengthAndMask);
+		pointer_color->andMaskData = Stream_Pointer(s);
+		Stream_Seek(s, pointer_color->lengthAndMask);
 	}
 
 	if (Stream_GetRemainingLength(s) > 0)
@@ -533,10 +510,11 @@ fail:
 
 POINTER_COLOR_UPDATE* update_read_pointer_color(rdpUpdate* update, wStream* s, BYTE xorBpp)
 {
-	POINTER_COLOR_UPDATE* pointer_color = calloc(1, sizeof(POINTER_COLOR_UPDATE));
-
 	WINPR_ASSERT(update);
 
+	rdp_update_internal* up = update_cast(update);
+	POINTER_COLOR_UPDATE* pointer_color = arena_calloc(up->arena, 1, sizeof(POINTER_COLOR_UPDATE));
+
 	if (!pointer_color)
 		goto fail;
 
@@ -546,16 +524,11 @@ POINTER_COLOR_UPDATE* update_read_pointer_color(rdpUpdate* update, wStream* s, B
 
 	return pointer_color;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_pointer_color_update(update->context, pointer_color);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
 static BOOL s_update_read_pointer_large(wStream* s, POINTER_LARGE_UPDATE* pointer)
 {
-	BYTE* newMask = nullptr;
 	UINT32 scanlineSize = 0;
 
 	if (!pointer)
@@ -613,13 +586,8 @@ static BOOL s_update_read_pointer_large(wStream* s, POINTER_LARGE_UPDATE* pointe
 			goto fail;
 		}
 
-		newMask = realloc(pointer->xorMaskData, pointer->lengthXorMask);
-
-		if (!newMask)
-			goto fail;
-
-		pointer->xorMaskData = newMask;
-		Stream_Read(s, pointer->xorMaskData, pointer->lengthXorMask);
+		pointer->xorMaskData = Stream_Pointer(s);
+		Stream_Seek(s, pointer->lengthXorMask);
 	}
 
 	if (pointer->lengthAndMask > 0)
@@ -644,13 +612,8 @@ static BOOL s_update_read_pointer_large(wStream* s, POINTER_LARGE_UPDATE* pointe
 			goto fail;
 		}
 
-		newMask = realloc(pointer->andMaskData, pointer->lengthAndMask);
-
-		if (!newMask)
-			goto fail;
-
-		pointer->andMaskData = newMask;
-		Stream_Read(s, pointer->andMaskData, pointer->lengthAndMask);
+		pointer->andMaskData = Stream_Pointer(s);
+		Stream_Seek(s, pointer->lengthAndMask);
 	}
 
 	if (Stream_GetRemainingLength(s) > 0)
@@ -663,10 +626,11 @@ fail:
 
 POINTER_LARGE_UPDATE* update_read_pointer_large(rdpUpdate* update, wStream* s)
 {
-	POINTER_LARGE_UPDATE* pointer = calloc(1, sizeof(POINTER_LARGE_UPDATE));
-
 	WINPR_ASSERT(update);
 
+	rdp_update_internal* up = update_cast(update);
+	POINTER_LARGE_UPDATE* pointer = arena_calloc(up->arena, 1, sizeof(POINTER_LARGE_UPDATE));
+
 	if (!pointer)
 		goto fail;
 
@@ -675,19 +639,16 @@ POINTER_LARGE_UPDATE* update_read_pointer_large(rdpUpdate* update, wStream* s)
 
 	return pointer;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_pointer_large_update(update->context, pointer);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
 POINTER_NEW_UPDATE* update_read_pointer_new(rdpUpdate* update, wStream* s)
 {
-	POINTER_NEW_UPDATE* pointer_new = calloc(1, sizeof(POINTER_NEW_UPDATE));
-
 	WINPR_ASSERT(update);
 
+	rdp_update_internal* up = update_cast(update);
+	POINTER_NEW_UPDATE* pointer_new = arena_calloc(up->arena, 1, sizeof(POINTER_NEW_UPDATE));
+
 	if (!pointer_new)
 		goto fail;
 
@@ -710,19 +671,16 @@ POINTER_NEW_UPDATE* update_read_pointer_new(rdpUpdate* update, wStream* s)
 
 	return pointer_new;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_pointer_new_update(update->context, pointer_new);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
 POINTER_CACHED_UPDATE* update_read_pointer_cached(rdpUpdate* update, wStream* s)
 {
-	POINTER_CACHED_UPDATE* pointer = calloc(1, sizeof(POINTER_CACHED_UPDATE));
-
 	WINPR_ASSERT(update);
 
+	rdp_update_internal* up = update_cast(update);
+	POINTER_CACHED_UPDATE* pointer = arena_calloc(up->arena, 1, sizeof(POINTER_CACHED_UPDATE));
+
 	if (!pointer)
 		goto fail;
 
@@ -732,10 +690,6 @@ POINTER_CACHED_UPDATE* update_read_pointer_cached(rdpUpdate* update, wStream* s)
 	Stream_Read_UINT16(s, pointer->cacheIndex); /* cacheIndex (2 bytes) */
 	return pointer;
 fail:
-	WINPR_PRAGMA_DIAG_PUSH
-	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
-	free_pointer_cached_update(update->context, pointer);
-	WINPR_PRAGMA_DIAG_POP
 	return nullptr;
 }
 
@@ -762,10 +716,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			POINTER_POSITION_UPDATE* pointer_position = update_read_pointer_position(update, s);
 
 			if (pointer_position)
-			{
 				rc = IFCALLRESULT(FALSE, pointer->PointerPosition, context, pointer_position);
-				free_pointer_position_update(context, pointer_position);
-			}
 		}
 		break;
 
@@ -774,10 +725,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			POINTER_SYSTEM_UPDATE* pointer_system = update_read_pointer_system(update, s);
 
 			if (pointer_system)
-			{
 				rc = IFCALLRESULT(FALSE, pointer->PointerSystem, context, pointer_system);
-				free_pointer_system_update(context, pointer_system);
-			}
 		}
 		break;
 
@@ -786,10 +734,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			POINTER_COLOR_UPDATE* pointer_color = update_read_pointer_color(update, s, 24);
 
 			if (pointer_color)
-			{
 				rc = IFCALLRESULT(FALSE, pointer->PointerColor, context, pointer_color);
-				free_pointer_color_update(context, pointer_color);
-			}
 		}
 		break;
 
@@ -798,10 +743,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			POINTER_LARGE_UPDATE* pointer_large = update_read_pointer_large(update, s);
 
 			if (pointer_large)
-			{
 				rc = IFCALLRESULT(FALSE, pointer->PointerLarge, context, pointer_large);
-				free_pointer_large_update(context, pointer_large);
-			}
 		}
 		break;
 
@@ -810,10 +752,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			POINTER_NEW_UPDATE* pointer_new = update_read_pointer_new(update, s);
 
 			if (pointer_new)
-			{
 				rc = IFCALLRESULT(FALSE, pointer->PointerNew, context, pointer_new);
-				free_pointer_new_update(context, pointer_new);
-			}
 		}
 		break;
 
@@ -822,10 +761,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			POINTER_CACHED_UPDATE* pointer_cached = update_read_pointer_cached(update, s);
 
 			if (pointer_cached)
-			{
 				rc = IFCALLRESULT(FALSE, pointer->PointerCached, context, pointer_cached);
-				free_pointer_cached_update(context, pointer_cached);
-			}
 		}
 		break;
 
@@ -833,6 +769,7 @@ BOOL update_recv_pointer(rdpUpdate* update, wStream* s)
 			break;
 	}
 
+	update_reset_arena(update);
 	return rc;
 }
 
@@ -871,7 +808,6 @@ BOOL update_recv(rdpUpdate* update, wStream* s)
 			}
 
 			rc = IFCALLRESULT(FALSE, update->BitmapUpdate, context, bitmap_update);
-			free_bitmap_update(context, bitmap_update);
 		}
 		break;
 
@@ -886,7 +822,6 @@ BOOL update_recv(rdpUpdate* update, wStream* s)
 			}
 
 			rc = IFCALLRESULT(FALSE, update->Palette, context, palette_update);
-			free_palette_update(context, palette_update);
 		}
 		break;
 
@@ -901,6 +836,7 @@ BOOL update_recv(rdpUpdate* update, wStream* s)
 	}
 
 fail:
+	update_reset_arena(update);
 
 	if (!update_end_paint(update))
 		rc = FALSE;
@@ -915,6 +851,15 @@ fail:
 	return TRUE;
 }
 
+void update_reset_arena(rdpUpdate* update)
+{
+	WINPR_ASSERT(update);
+
+	rdp_update_internal* up = update_cast(update);
+
+	arena_reset(up->arena);
+}
+
 void update_reset_state(rdpUpdate* update)
 {
 	rdp_update_internal* up = update_cast(update);
@@ -1041,7 +986,7 @@ static BOOL s_update_begin_paint(rdpContext* context)
 	update->combineUpdates = TRUE;
 	update->numberOrders = 0;
 	update->us = s;
-	return TRUE;
+	return transport_begin_batch(context->rdp->transport);
 }
 
 static BOOL s_update_end_paint(rdpContext* context)
@@ -1078,6 +1023,8 @@ static BOOL s_update_end_paint(rdpContext* context)
 	rc = TRUE;
 fail:
 	Stream_Free(s, TRUE);
+	if (!transport_end_batch(context->rdp->transport))
+		rc = FALSE;
 	return rc;
 }
 
@@ -3354,6 +3301,11 @@ rdpUpdate* update_new(rdpRdp* rdp)
 	if (!update->common.pointer)
 		goto fail;
 
+	update->arena = arena_new(UPDATE_ARENA_BLOCK_SIZE);
+
+	if (!update->arena)
+		goto fail;
+
 	{
 		rdp_primary_update_internal* primary =
 		    (rdp_primary_update_internal*)calloc(1, sizeof(rdp_primary_update_internal));
@@ -3447,6 +3399,7 @@ void update_free(rdpUpdate* update)
 
 		MessageQueue_Free(up->queue);
 		DeleteCriticalSection(&up->mux);
+		arena_free(up->arena);
 
 		if (up->us)
 			Stream_Free(up->us, TRUE);
@@ -22,6 +22,7 @@
 
 #include "rdp.h"
 #include "orders.h"
+#include "arena.h"
 
 #include <freerdp/types.h>
 #include <freerdp/update.h>
@@ -65,6 +66,9 @@ typedef struct
 	rdpBounds previousBounds;
 	CRITICAL_SECTION mux;
 	BOOL withinBeginEndPaint;
+
+	/* decoded updates and secondary orders of the PDU being processed */
+	rdpArena* arena;
 } rdp_update_internal;
 
 typedef struct
@@ -183,6 +187,8 @@ FREERDP_LOCAL rdpUpdate* update_new(rdpRdp* rdp);
 
 FREERDP_LOCAL void update_reset_state(rdpUpdate* update);
 
+FREERDP_LOCAL void update_reset_arena(rdpUpdate* update);
+
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BOOL update_post_connect(rdpUpdate* update);
 
@@ -197,29 +203,33 @@ FREERDP_LOCAL BOOL update_recv_pointer(rdpUpdate* update, wStream* s);
 WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BOOL update_recv(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_bitmap_update, 2)
+/* The update_read_* functions below return structures allocated from the update arena, their
+ * data fields point into \b s. Both stay valid until update_reset_arena is called after the
+ * PDU was dispatched, callbacks that keep an update must copy it (as the message queue does).
+ */
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL BITMAP_UPDATE* update_read_bitmap_update(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_palette_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL PALETTE_UPDATE* update_read_palette(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_pointer_system_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL POINTER_SYSTEM_UPDATE* update_read_pointer_system(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_pointer_position_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL POINTER_POSITION_UPDATE* update_read_pointer_position(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_pointer_color_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL POINTER_COLOR_UPDATE* update_read_pointer_color(rdpUpdate* update, wStream* s,
                                                               BYTE xorBpp);
 
-WINPR_ATTR_MALLOC(free_pointer_large_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL POINTER_LARGE_UPDATE* update_read_pointer_large(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_pointer_new_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL POINTER_NEW_UPDATE* update_read_pointer_new(rdpUpdate* update, wStream* s);
 
-WINPR_ATTR_MALLOC(free_pointer_cached_update, 2)
+WINPR_ATTR_NODISCARD
 FREERDP_LOCAL POINTER_CACHED_UPDATE* update_read_pointer_cached(rdpUpdate* update, wStream* s);
 
 WINPR_ATTR_NODISCARD
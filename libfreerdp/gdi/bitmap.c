@@ -37,6 +37,7 @@
 
 #include "brush.h"
 #include "clipping.h"
+#include "rop.h"
 #include "../gdi/gdi.h"
 
 #define TAG FREERDP_TAG("gdi.bitmap")
@@ -352,6 +353,249 @@ static inline BOOL BitBlt_write(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXDest, I
 	return FreeRDPWriteColor(dstp, hdcDest->format, dstColor);
 }
 
+/* Fill a row with a repeating run of pixels, doubling the copied range each step */
+static void BitBlt_repeat_row(BYTE* WINPR_RESTRICT row, size_t length, size_t period)
+{
+	size_t done = period;
+
+	while (done < length)
+	{
+		const size_t count = (length - done < done) ? (length - done) : done;
+		memcpy(&row[done], row, count);
+		done += count;
+	}
+}
+
+/* Source pixels converted to the destination format as (color & keep) | set.
+ * This holds for any identical formats, the unused channel of X formats is forced. */
+static BOOL BitBlt_source_mask(UINT32 SrcFormat, UINT32 DstFormat, const gdiPalette* palette,
+                               UINT32* keep, UINT32* set)
+{
+	const UINT32 samples[] = { 0x12345678, 0x9ABCDEF0, 0x0F1E2D3C, 0xA5C3E1F0, 0x5A3C1E0F };
+	const size_t bpp = FreeRDPGetBytesPerPixel(DstFormat);
+
+	if ((SrcFormat != DstFormat) || (bpp < 2) || (bpp > 4))
+		return FALSE;
+
+	const UINT32 full = (bpp == 4) ? UINT32_MAX : ((1u << (8 * bpp)) - 1u);
+	const UINT32 zero = FreeRDPConvertColor(0, SrcFormat, DstFormat, palette);
+	const UINT32 ones = FreeRDPConvertColor(full, SrcFormat, DstFormat, palette);
+	const UINT32 k = (zero ^ ones) & full;
+	const UINT32 c = zero & ~k & full;
+
+	for (size_t x = 0; x < ARRAYSIZE(samples); x++)
+	{
+		const UINT32 color = samples[x] & full;
+		if (FreeRDPConvertColor(color, SrcFormat, DstFormat, palette) != ((color & k) | c))
+			return FALSE;
+	}
+
+	*keep = k;
+	*set = c;
+	return TRUE;
+}
+
+static BOOL BitBlt_kernel_supported(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                                    INT32 nHeight, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc,
+                                    BOOL useSrc, BOOL usePat, UINT32 style)
+{
+	const HGDI_BITMAP hDstBmp = (HGDI_BITMAP)hdcDest->selectedObject;
+
+	/* 15bpp and palette formats are masked on read, all others are raw bytes */
+	switch (FreeRDPGetBitsPerPixel(hdcDest->format))
+	{
+		case 16:
+		case 24:
+		case 32:
+			break;
+		default:
+			return FALSE;
+	}
+
+	if (!hDstBmp || (nXDest < 0) || (nYDest < 0) || (nXDest + nWidth > hDstBmp->width) ||
+	    (nYDest + nHeight > hDstBmp->height))
+		return FALSE;
+
+	if (useSrc)
+	{
+		const HGDI_BITMAP hSrcBmp = (HGDI_BITMAP)hdcSrc->selectedObject;
+
+		if (!hSrcBmp || (nXSrc < 0) || (nYSrc < 0) || (nXSrc + nWidth > hSrcBmp->width) ||
+		    (nYSrc + nHeight > hSrcBmp->height))
+			return FALSE;
+	}
+
+	if (usePat && (style != GDI_BS_SOLID))
+	{
+		const HGDI_BITMAP pattern = hdcDest->brush->pattern;
+
+		if (!pattern || (pattern->width <= 0) || (pattern->height <= 0) ||
+		    (FreeRDPGetBytesPerPixel(pattern->format) !=
+		     FreeRDPGetBytesPerPixel(hdcDest->format)) ||
+		    (hdcDest->brush->nXOrg < 0) || (hdcDest->brush->nYOrg < 0))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Expand the brush pattern to the row of destination line y */
+static void BitBlt_pattern_row(HGDI_DC hdcDest, INT32 nXDest, INT32 y, BYTE* row, size_t length)
+{
+	const HGDI_BITMAP pattern = hdcDest->brush->pattern;
+	const size_t bpp = FreeRDPGetBytesPerPixel(hdcDest->format);
+	const UINT32 w = WINPR_ASSERTING_INT_CAST(UINT32, pattern->width);
+	const UINT32 h = WINPR_ASSERTING_INT_CAST(UINT32, pattern->height);
+	const UINT32 nXOrg = WINPR_ASSERTING_INT_CAST(UINT32, hdcDest->brush->nXOrg);
+	const UINT32 nYOrg = WINPR_ASSERTING_INT_CAST(UINT32, hdcDest->brush->nYOrg);
+	const UINT32 px = (WINPR_ASSERTING_INT_CAST(UINT32, nXDest) + w - (nXOrg % w)) % w;
+	const UINT32 py = (WINPR_ASSERTING_INT_CAST(UINT32, y) + h - (nYOrg % h)) % h;
+	const BYTE* line = &pattern->data[1ULL * py * pattern->scanline];
+	const size_t period = (length < w * bpp) ? length : w * bpp;
+
+	for (size_t x = 0; x < period / bpp; x++)
+		memcpy(&row[x * bpp], &line[((px + x) % w) * bpp], bpp);
+
+	BitBlt_repeat_row(row, length, period);
+}
+
+/* Convert a source line to the destination format */
+static void BitBlt_source_row(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXSrc, INT32 y, BYTE* row,
+                              size_t width, BOOL masked, UINT32 keep, UINT32 set,
+                              const gdiPalette* palette)
+{
+	const HGDI_BITMAP hSrcBmp = (HGDI_BITMAP)hdcSrc->selectedObject;
+	const size_t srcBpp = FreeRDPGetBytesPerPixel(hdcSrc->format);
+	const size_t dstBpp = FreeRDPGetBytesPerPixel(hdcDest->format);
+	const size_t offset = 1ULL * WINPR_ASSERTING_INT_CAST(size_t, y) * hSrcBmp->scanline +
+	                      WINPR_ASSERTING_INT_CAST(size_t, nXSrc) * srcBpp;
+	const BYTE* src = &hSrcBmp->data[offset];
+
+	if (masked && (keep == UINT32_MAX >> (8 * (4 - dstBpp))))
+		memcpy(row, src, width * dstBpp);
+	else if (masked && (dstBpp == 4))
+	{
+		BYTE k[4] = WINPR_C_ARRAY_INIT;
+		BYTE c[4] = WINPR_C_ARRAY_INIT;
+		UINT32 rawKeep = 0;
+		UINT32 rawSet = 0;
+
+		/* masks in memory byte order */
+		(void)FreeRDPWriteColor(k, hdcDest->format, keep);
+		(void)FreeRDPWriteColor(c, hdcDest->format, set);
+		memcpy(&rawKeep, k, sizeof(rawKeep));
+		memcpy(&rawSet, c, sizeof(rawSet));
+
+		for (size_t x = 0; x < width; x++)
+		{
+			UINT32 color = 0;
+			memcpy(&color, &src[x * 4], sizeof(color));
+			color = (color & rawKeep) | rawSet;
+			memcpy(&row[x * 4], &color, sizeof(color));
+		}
+	}
+	else
+	{
+		for (size_t x = 0; x < width; x++)
+		{
+			UINT32 color = FreeRDPReadColor(&src[x * srcBpp], hdcSrc->format);
+			color = FreeRDPConvertColor(color, hdcSrc->format, hdcDest->format, palette);
+			(void)FreeRDPWriteColor(&row[x * dstBpp], hdcDest->format, color);
+		}
+	}
+}
+
+/* Row wise BitBlt with the ROP3 kernels.
+ *
+ * Rows are processed in the same order as the per pixel loops and each source
+ * line is copied before the destination line is written, so overlapping blits
+ * produce the same result as the reference implementation. */
+static BOOL BitBlt_kernel(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                          INT32 nHeight, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, BYTE rop3,
+                          const BYTE* constant, BOOL useSrc, BOOL usePat, UINT32 style,
+                          const gdiPalette* palette)
+{
+	BOOL rc = FALSE;
+	BYTE* srcRow = nullptr;
+	BYTE* patRow = nullptr;
+	UINT32 keep = 0;
+	UINT32 set = 0;
+	const HGDI_BITMAP hDstBmp = (HGDI_BITMAP)hdcDest->selectedObject;
+	const size_t bpp = FreeRDPGetBytesPerPixel(hdcDest->format);
+	const size_t width = WINPR_ASSERTING_INT_CAST(size_t, nWidth);
+	const size_t length = width * bpp;
+	const gdiRop3RowFn* kernels = gdi_rop3_get();
+
+	if (!kernels)
+		return FALSE;
+
+	if ((nWidth == 0) || (nHeight == 0))
+		return TRUE;
+
+	const BOOL masked =
+	    useSrc && BitBlt_source_mask(hdcSrc->format, hdcDest->format, palette, &keep, &set);
+
+	if (useSrc)
+	{
+		srcRow = winpr_aligned_malloc(length, 32);
+		if (!srcRow)
+			goto fail;
+	}
+
+	if (usePat || constant)
+	{
+		patRow = winpr_aligned_malloc(length, 32);
+		if (!patRow)
+			goto fail;
+
+		if (constant || (style == GDI_BS_SOLID))
+		{
+			if (constant)
+				memcpy(patRow, constant, bpp);
+			else if (!FreeRDPWriteColor(patRow, hdcDest->format, hdcDest->brush->color))
+				goto fail;
+			BitBlt_repeat_row(patRow, length, bpp);
+		}
+	}
+
+	{
+		const gdiRop3RowFn kernel = kernels[rop3];
+		const BOOL pattern = usePat && (style != GDI_BS_SOLID);
+		const BOOL bottomUp = nYDest > nYSrc;
+		INT32 patLine = -1;
+
+		for (INT32 i = 0; i < nHeight; i++)
+		{
+			const INT32 y = bottomUp ? nHeight - 1 - i : i;
+			BYTE* dst = &hDstBmp->data[1ULL * WINPR_ASSERTING_INT_CAST(size_t, nYDest + y) *
+			                               hDstBmp->scanline +
+			                           WINPR_ASSERTING_INT_CAST(size_t, nXDest) * bpp];
+
+			if (useSrc)
+				BitBlt_source_row(hdcDest, hdcSrc, nXSrc, nYSrc + y, srcRow, width, masked, keep,
+				                  set, palette);
+
+			if (pattern)
+			{
+				const INT32 line = (nYDest + y) % hdcDest->brush->pattern->height;
+				if (line != patLine)
+				{
+					BitBlt_pattern_row(hdcDest, nXDest, nYDest + y, patRow, length);
+					patLine = line;
+				}
+			}
+
+			kernel(dst, srcRow, patRow, length);
+		}
+	}
+
+	rc = TRUE;
+fail:
+	winpr_aligned_free(srcRow);
+	winpr_aligned_free(patRow);
+	return rc;
+}
+
 static BOOL adjust_src_coordinates(HGDI_DC hdcSrc, INT32 nWidth, INT32 nHeight, INT32* px,
                                    INT32* py)
 {
@@ -465,7 +709,7 @@ static BOOL adjust_src_dst_coordinates(HGDI_DC hdcDest, INT32* pnXSrc, INT32* pn
 
 static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth, INT32 nHeight,
                            HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, const char* rop,
-                           const gdiPalette* palette)
+                           const gdiPalette* palette, BOOL useKernels)
 {
 	UINT32 style = 0;
 	BOOL useSrc = FALSE;
@@ -521,6 +765,27 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
 		}
 	}
 
+	if (useKernels && BitBlt_kernel_supported(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc,
+	                                          nXSrc, nYSrc, useSrc, usePat, style))
+	{
+		BYTE rop3 = 0;
+
+		if (gdi_rop3_compile(rop, &rop3))
+			return BitBlt_kernel(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc,
+			                     rop3, nullptr, useSrc, usePat, style, palette);
+
+		/* BLACKNESS and WHITENESS, fill with the color as a pattern copy */
+		if (!useSrc && !usePat && !strchr(rop, 'D'))
+		{
+			BYTE constant[4] = WINPR_C_ARRAY_INIT;
+			const UINT32 color = process_rop(0, 0, 0, rop, hdcDest->format);
+
+			if (FreeRDPWriteColor(constant, hdcDest->format, color))
+				return BitBlt_kernel(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc,
+				                     nYSrc, 0xF0, constant, FALSE, FALSE, style, palette);
+		}
+	}
+
 	if ((nXDest > nXSrc) && (nYDest > nYSrc))
 	{
 		for (INT32 y = nHeight - 1; y >= 0; y--)
@@ -665,7 +930,7 @@ BOOL gdi_BitBlt(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth, INT32
 
 		default:
 			if (!BitBlt_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc,
-			                    gdi_rop_to_string(rop), palette))
+			                    gdi_rop_to_string(rop), palette, TRUE))
 				return FALSE;
 
 			break;
@@ -673,3 +938,20 @@ BOOL gdi_BitBlt(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth, INT32
 
 	return gdi_InvalidateRegion(hdcDest, nXDest, nYDest, nWidth, nHeight);
 }
+
+BOOL gdi_BitBlt_reference(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                          INT32 nHeight, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, DWORD rop,
+                          const gdiPalette* palette)
+{
+	if (!hdcDest)
+		return FALSE;
+
+	if (!gdi_ClipCoords(hdcDest, &nXDest, &nYDest, &nWidth, &nHeight, &nXSrc, &nYSrc))
+		return TRUE;
+
+	if (!BitBlt_process(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc,
+	                    gdi_rop_to_string(rop), palette, FALSE))
+		return FALSE;
+
+	return gdi_InvalidateRegion(hdcDest, nXDest, nYDest, nWidth, nHeight);
+}
@@ -171,6 +171,86 @@ fail:
 	return rc;
 }
 
+/**
+ * Scale the invalid parts of a surface to its output target. Only the target pixels the
+ * filters of the changed source pixels reach are recomputed.
+ */
+static UINT gdi_OutputUpdateScaled(rdpGdi* gdi, gdiGfxSurface* surface,
+                                   const RECTANGLE_16* rects, UINT32 nbRects)
+{
+	UINT rc = ERROR_INTERNAL_ERROR;
+	UINT32 nbDstRects = 0;
+	REGION16 region = WINPR_C_ARRAY_INIT;
+
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(surface);
+	WINPR_ASSERT(rects || (nbRects == 0));
+
+	region16_init(&region);
+
+	const UINT32 surfaceX = surface->outputOriginX;
+	const UINT32 surfaceY = surface->outputOriginY;
+	const UINT32 width = (UINT32)MAX(0, gdi->width);
+	const UINT32 height = (UINT32)MAX(0, gdi->height);
+	if ((surfaceX >= width) || (surfaceY >= height))
+	{
+		rc = CHANNEL_RC_OK;
+		goto fail;
+	}
+
+	if (!surface->scaler)
+	{
+		surface->scaler = freerdp_image_scaler_new(FREERDP_IMAGE_SCALE_BILINEAR);
+		if (!surface->scaler)
+			goto fail;
+	}
+
+	if (!freerdp_image_scaler_set_size(surface->scaler, surface->mappedWidth,
+	                                   surface->mappedHeight, surface->outputTargetWidth,
+	                                   surface->outputTargetHeight))
+		goto fail;
+
+	for (UINT32 i = 0; i < nbRects; i++)
+	{
+		RECTANGLE_16 dst = WINPR_C_ARRAY_INIT;
+
+		if (!freerdp_image_scaler_map_rect(surface->scaler, &rects[i], &dst))
+			goto fail;
+		if (!region16_union_rect(&region, &region, &dst))
+			goto fail;
+	}
+
+	/* the part of the output target that lies on the primary surface */
+	const RECTANGLE_16 visible = { 0, 0, (UINT16)MIN(UINT16_MAX, width - surfaceX),
+		                           (UINT16)MIN(UINT16_MAX, height - surfaceY) };
+	if (!region16_intersect_rect(&region, &region, &visible))
+		goto fail;
+
+	const RECTANGLE_16* dstRects = region16_rects(&region, &nbDstRects);
+	for (UINT32 i = 0; i < nbDstRects; i++)
+	{
+		const RECTANGLE_16* rect = &dstRects[i];
+
+		if (!freerdp_image_scaler_scale(surface->scaler, gdi->primary_buffer, gdi->dstFormat,
+		                                gdi->stride, surfaceX, surfaceY, surface->data,
+		                                surface->format, surface->scanline, 0, 0, rect))
+		{
+			rc = CHANNEL_RC_NULL_DATA;
+			goto fail;
+		}
+
+		if (!gdi_InvalidateRegion(gdi->primary->hdc, (INT32)(surfaceX + rect->left),
+		                          (INT32)(surfaceY + rect->top), rect->right - rect->left,
+		                          rect->bottom - rect->top))
+			goto fail;
+	}
+
+	rc = CHANNEL_RC_OK;
+fail:
+	region16_uninit(&region);
+	return rc;
+}
+
 static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 {
 	UINT rc = ERROR_INTERNAL_ERROR;
@@ -214,6 +294,13 @@ static UINT gdi_OutputUpdate(rdpGdi* gdi, gdiGfxSurface* surface)
 	if (!update_begin_paint(update))
 		goto fail;
 
+	if ((surface->outputTargetWidth != surface->mappedWidth) ||
+	    (surface->outputTargetHeight != surface->mappedHeight))
+	{
+		rc = gdi_OutputUpdateScaled(gdi, surface, rects, nbRects);
+		goto clear;
+	}
+
 	for (UINT32 i = 0; i < nbRects; i++)
 	{
 		const UINT32 nXSrc = rects[i].left;
@@ -1351,6 +1438,7 @@ static UINT gdi_DeleteSurface(RdpgfxClientContext* context,
 #if defined(WITH_GFX_AV1)
 		freerdp_av1_context_free(surface->av1);
 #endif
+		freerdp_image_scaler_free(surface->scaler);
 		region16_uninit(&surface->invalidRegion);
 		codecs = surface->codecs;
 		winpr_aligned_free(surface->data);
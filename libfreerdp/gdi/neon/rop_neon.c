@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Blit Kernels - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include "../rop.h"
+
+#include "../../core/simd.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static inline uint8x16_t gdi_rop3_load_neon(const BYTE* WINPR_RESTRICT ptr)
+{
+	return vld1q_u8(ptr);
+}
+
+static inline void gdi_rop3_store_neon(BYTE* WINPR_RESTRICT ptr, uint8x16_t val)
+{
+	vst1q_u8(ptr, val);
+}
+
+GDI_ROP3_DEFINE_EVAL(gdi_rop3_eval_neon, uint8x16_t, vdupq_n_u8(0), vdupq_n_u8(0xFF), vandq_u8,
+                     veorq_u8)
+
+#define GDI_ROP3_NEON_KERNEL(rop)                                                           \
+	GDI_ROP3_DEFINE_KERNEL(gdi_rop3_row_neon_, rop, uint8x16_t, 16, gdi_rop3_load_neon,      \
+	                       gdi_rop3_store_neon, vdupq_n_u8(0), gdi_rop3_eval_neon)
+GDI_ROP3_FOREACH(GDI_ROP3_NEON_KERNEL)
+#endif
+
+void gdi_rop3_init_neon_int(gdiRop3RowFn* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(NEON_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "NEON optimizations");
+#define GDI_ROP3_NEON_ENTRY(rop) kernels[rop] = gdi_rop3_row_neon_##rop;
+	GDI_ROP3_FOREACH(GDI_ROP3_NEON_ENTRY)
+#undef GDI_ROP3_NEON_ENTRY
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or NEON intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,148 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Blit Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+
+#include "rop.h"
+
+static inline UINT64 gdi_rop3_load64(const BYTE* WINPR_RESTRICT ptr)
+{
+	UINT64 val = 0;
+	memcpy(&val, ptr, sizeof(val));
+	return val;
+}
+
+static inline void gdi_rop3_store64(BYTE* WINPR_RESTRICT ptr, UINT64 val)
+{
+	memcpy(ptr, &val, sizeof(val));
+}
+
+#define GDI_ROP3_GENERIC_KERNEL(rop)                                                         \
+	GDI_ROP3_DEFINE_KERNEL(gdi_rop3_row_generic_, rop, UINT64, 8, gdi_rop3_load64,           \
+	                       gdi_rop3_store64, 0, gdi_rop3_eval64)
+GDI_ROP3_FOREACH(GDI_ROP3_GENERIC_KERNEL)
+
+static gdiRop3RowFn gdi_rop3_generic[256] = WINPR_C_ARRAY_INIT;
+static gdiRop3RowFn gdi_rop3_optimized[256] = WINPR_C_ARRAY_INIT;
+
+static INIT_ONCE gdi_rop3_generic_InitOnce = INIT_ONCE_STATIC_INIT;
+static INIT_ONCE gdi_rop3_optimized_InitOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK gdi_rop3_init_generic_cb(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                              WINPR_ATTR_UNUSED PVOID param,
+                                              WINPR_ATTR_UNUSED PVOID* context)
+{
+#define GDI_ROP3_GENERIC_ENTRY(rop) gdi_rop3_generic[rop] = gdi_rop3_row_generic_##rop;
+	GDI_ROP3_FOREACH(GDI_ROP3_GENERIC_ENTRY)
+#undef GDI_ROP3_GENERIC_ENTRY
+	return TRUE;
+}
+
+static BOOL CALLBACK gdi_rop3_init_optimized_cb(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                                WINPR_ATTR_UNUSED PVOID param,
+                                                WINPR_ATTR_UNUSED PVOID* context)
+{
+	const gdiRop3RowFn* generic = gdi_rop3_get_generic();
+	if (!generic)
+		return FALSE;
+
+	memcpy(gdi_rop3_optimized, generic, sizeof(gdi_rop3_optimized));
+	gdi_rop3_init_sse2(gdi_rop3_optimized);
+#if defined(WITH_AVX2)
+	gdi_rop3_init_avx2(gdi_rop3_optimized);
+#endif
+	gdi_rop3_init_neon(gdi_rop3_optimized);
+	return TRUE;
+}
+
+const gdiRop3RowFn* gdi_rop3_get_generic(void)
+{
+	if (!InitOnceExecuteOnce(&gdi_rop3_generic_InitOnce, gdi_rop3_init_generic_cb, nullptr,
+	                         nullptr))
+		return nullptr;
+	return gdi_rop3_generic;
+}
+
+const gdiRop3RowFn* gdi_rop3_get(void)
+{
+	if (!InitOnceExecuteOnce(&gdi_rop3_optimized_InitOnce, gdi_rop3_init_optimized_cb, nullptr,
+	                         nullptr))
+		return nullptr;
+	return gdi_rop3_optimized;
+}
+
+BOOL gdi_rop3_compile(const char* rop, BYTE* index)
+{
+	BYTE stack[10] = WINPR_C_ARRAY_INIT;
+	size_t stackp = 0;
+	BOOL operands = FALSE;
+
+	WINPR_ASSERT(index);
+	if (!rop)
+		return FALSE;
+
+	/* Run the program on the truth table columns of P, S and D */
+	while (*rop != '\0')
+	{
+		const char op = *rop++;
+
+		switch (op)
+		{
+			case 'D':
+			case 'S':
+			case 'P':
+				if (stackp >= ARRAYSIZE(stack))
+					return FALSE;
+				stack[stackp++] = (op == 'D') ? 0xAA : ((op == 'S') ? 0xCC : 0xF0);
+				operands = TRUE;
+				break;
+
+			case 'n':
+				if (stackp < 1)
+					return FALSE;
+				stack[stackp - 1] = (BYTE)~stack[stackp - 1];
+				break;
+
+			case 'a':
+			case 'o':
+			case 'x':
+				if (stackp < 2)
+					return FALSE;
+				stackp--;
+				if (op == 'a')
+					stack[stackp - 1] &= stack[stackp];
+				else if (op == 'o')
+					stack[stackp - 1] |= stack[stackp];
+				else
+					stack[stackp - 1] ^= stack[stackp];
+				break;
+
+			default:
+				/* Constants are colors, not bit patterns */
+				return FALSE;
+		}
+	}
+
+	if (!operands || (stackp != 1))
+		return FALSE;
+
+	*index = stack[0];
+	return TRUE;
+}
@@ -0,0 +1,213 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Blit Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_ROP_H
+#define FREERDP_LIB_GDI_ROP_H
+
+#include <string.h>
+
+#include <winpr/wtypes.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/api.h>
+#include <freerdp/gdi/gdi.h>
+
+/*
+ * A ROP3 is identified by its truth table: bit (P << 2 | S << 1 | D) of the
+ * index holds the result for the pattern, source and destination bits P, S and D.
+ * The kernels operate bitwise on raw pixel bytes, so one kernel serves every
+ * pixel format whose in memory representation is not altered by the operation.
+ */
+#define GDI_ROP3_USES_PATTERN(rop) ((((rop) >> 4) & 0x0F) != ((rop) & 0x0F))
+#define GDI_ROP3_USES_SOURCE(rop) ((((rop) >> 2) & 0x33) != ((rop) & 0x33))
+#define GDI_ROP3_USES_DEST(rop) ((((rop) >> 1) & 0x55) != ((rop) & 0x55))
+
+#define GDI_ROP3_FOREACH(X) \
+	X(0x00) X(0x01) X(0x02) X(0x03) X(0x04) X(0x05) X(0x06) X(0x07) \
+	X(0x08) X(0x09) X(0x0A) X(0x0B) X(0x0C) X(0x0D) X(0x0E) X(0x0F) \
+	X(0x10) X(0x11) X(0x12) X(0x13) X(0x14) X(0x15) X(0x16) X(0x17) \
+	X(0x18) X(0x19) X(0x1A) X(0x1B) X(0x1C) X(0x1D) X(0x1E) X(0x1F) \
+	X(0x20) X(0x21) X(0x22) X(0x23) X(0x24) X(0x25) X(0x26) X(0x27) \
+	X(0x28) X(0x29) X(0x2A) X(0x2B) X(0x2C) X(0x2D) X(0x2E) X(0x2F) \
+	X(0x30) X(0x31) X(0x32) X(0x33) X(0x34) X(0x35) X(0x36) X(0x37) \
+	X(0x38) X(0x39) X(0x3A) X(0x3B) X(0x3C) X(0x3D) X(0x3E) X(0x3F) \
+	X(0x40) X(0x41) X(0x42) X(0x43) X(0x44) X(0x45) X(0x46) X(0x47) \
+	X(0x48) X(0x49) X(0x4A) X(0x4B) X(0x4C) X(0x4D) X(0x4E) X(0x4F) \
+	X(0x50) X(0x51) X(0x52) X(0x53) X(0x54) X(0x55) X(0x56) X(0x57) \
+	X(0x58) X(0x59) X(0x5A) X(0x5B) X(0x5C) X(0x5D) X(0x5E) X(0x5F) \
+	X(0x60) X(0x61) X(0x62) X(0x63) X(0x64) X(0x65) X(0x66) X(0x67) \
+	X(0x68) X(0x69) X(0x6A) X(0x6B) X(0x6C) X(0x6D) X(0x6E) X(0x6F) \
+	X(0x70) X(0x71) X(0x72) X(0x73) X(0x74) X(0x75) X(0x76) X(0x77) \
+	X(0x78) X(0x79) X(0x7A) X(0x7B) X(0x7C) X(0x7D) X(0x7E) X(0x7F) \
+	X(0x80) X(0x81) X(0x82) X(0x83) X(0x84) X(0x85) X(0x86) X(0x87) \
+	X(0x88) X(0x89) X(0x8A) X(0x8B) X(0x8C) X(0x8D) X(0x8E) X(0x8F) \
+	X(0x90) X(0x91) X(0x92) X(0x93) X(0x94) X(0x95) X(0x96) X(0x97) \
+	X(0x98) X(0x99) X(0x9A) X(0x9B) X(0x9C) X(0x9D) X(0x9E) X(0x9F) \
+	X(0xA0) X(0xA1) X(0xA2) X(0xA3) X(0xA4) X(0xA5) X(0xA6) X(0xA7) \
+	X(0xA8) X(0xA9) X(0xAA) X(0xAB) X(0xAC) X(0xAD) X(0xAE) X(0xAF) \
+	X(0xB0) X(0xB1) X(0xB2) X(0xB3) X(0xB4) X(0xB5) X(0xB6) X(0xB7) \
+	X(0xB8) X(0xB9) X(0xBA) X(0xBB) X(0xBC) X(0xBD) X(0xBE) X(0xBF) \
+	X(0xC0) X(0xC1) X(0xC2) X(0xC3) X(0xC4) X(0xC5) X(0xC6) X(0xC7) \
+	X(0xC8) X(0xC9) X(0xCA) X(0xCB) X(0xCC) X(0xCD) X(0xCE) X(0xCF) \
+	X(0xD0) X(0xD1) X(0xD2) X(0xD3) X(0xD4) X(0xD5) X(0xD6) X(0xD7) \
+	X(0xD8) X(0xD9) X(0xDA) X(0xDB) X(0xDC) X(0xDD) X(0xDE) X(0xDF) \
+	X(0xE0) X(0xE1) X(0xE2) X(0xE3) X(0xE4) X(0xE5) X(0xE6) X(0xE7) \
+	X(0xE8) X(0xE9) X(0xEA) X(0xEB) X(0xEC) X(0xED) X(0xEE) X(0xEF) \
+	X(0xF0) X(0xF1) X(0xF2) X(0xF3) X(0xF4) X(0xF5) X(0xF6) X(0xF7) \
+	X(0xF8) X(0xF9) X(0xFA) X(0xFB) X(0xFC) X(0xFD) X(0xFE) X(0xFF)
+
+/*
+ * Evaluate a ROP3 as a multiplexer tree over D, S and P. The ROP is a compile
+ * time constant in the kernels, so the compiler folds the tree to the few
+ * logical operations the ROP really needs.
+ */
+#define GDI_ROP3_DEFINE_EVAL(name, T, ZERO, ONES, AND, XOR)                                      \
+	static inline T name##_d(BYTE bits, T d)                                                     \
+	{                                                                                            \
+		switch (bits & 0x03)                                                                     \
+		{                                                                                        \
+			case 0x00:                                                                           \
+				return ZERO;                                                                     \
+			case 0x01:                                                                           \
+				return XOR(d, ONES);                                                             \
+			case 0x02:                                                                           \
+				return d;                                                                        \
+			default:                                                                             \
+				return ONES;                                                                     \
+		}                                                                                        \
+	}                                                                                            \
+                                                                                                 \
+	static inline T name##_sd(BYTE bits, T s, T d)                                               \
+	{                                                                                            \
+		const T a = name##_d((BYTE)(bits >> 2), d);                                              \
+		if (((bits >> 2) & 0x03) == (bits & 0x03))                                               \
+			return a;                                                                            \
+		const T b = name##_d(bits, d);                                                           \
+		return XOR(b, AND(XOR(a, b), s));                                                        \
+	}                                                                                            \
+                                                                                                 \
+	static inline T name(BYTE rop, T p, T s, T d)                                                \
+	{                                                                                            \
+		const T a = name##_sd((BYTE)(rop >> 4), s, d);                                           \
+		if (((rop >> 4) & 0x0F) == (rop & 0x0F))                                                 \
+			return a;                                                                            \
+		const T b = name##_sd(rop, s, d);                                                        \
+		return XOR(b, AND(XOR(a, b), p));                                                        \
+	}
+
+#define GDI_ROP3_AND(a, b) ((a) & (b))
+#define GDI_ROP3_XOR(a, b) ((a) ^ (b))
+
+GDI_ROP3_DEFINE_EVAL(gdi_rop3_eval64, UINT64, 0, UINT64_MAX, GDI_ROP3_AND, GDI_ROP3_XOR)
+
+static inline void gdi_rop3_row_tail(BYTE rop, BYTE* WINPR_RESTRICT dst,
+                                     const BYTE* WINPR_RESTRICT src,
+                                     const BYTE* WINPR_RESTRICT pat, size_t length)
+{
+	for (size_t x = 0; x < length; x++)
+	{
+		const UINT64 s = GDI_ROP3_USES_SOURCE(rop) ? src[x] : 0;
+		const UINT64 p = GDI_ROP3_USES_PATTERN(rop) ? pat[x] : 0;
+		dst[x] = (BYTE)gdi_rop3_eval64(rop, p, s, dst[x]);
+	}
+}
+
+/*
+ * Kernel template, WIDTH bytes per step with LOAD and STORE on unaligned
+ * memory. src and pat are only accessed if the ROP uses them.
+ */
+#define GDI_ROP3_DEFINE_KERNEL(prefix, rop, T, WIDTH, LOAD, STORE, ZERO, EVAL)                   \
+	static void prefix##rop(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src,            \
+	                        const BYTE* WINPR_RESTRICT pat, size_t length)                       \
+	{                                                                                            \
+		size_t x = 0;                                                                            \
+		for (; x + (WIDTH) <= length; x += (WIDTH))                                              \
+		{                                                                                        \
+			const T d = LOAD(&dst[x]);                                                           \
+			const T s = GDI_ROP3_USES_SOURCE(rop) ? LOAD(&src[x]) : (ZERO);                      \
+			const T p = GDI_ROP3_USES_PATTERN(rop) ? LOAD(&pat[x]) : (ZERO);                     \
+			STORE(&dst[x], EVAL(rop, p, s, d));                                                  \
+		}                                                                                        \
+		gdi_rop3_row_tail(rop, &dst[x], GDI_ROP3_USES_SOURCE(rop) ? &src[x] : nullptr,           \
+		                  GDI_ROP3_USES_PATTERN(rop) ? &pat[x] : nullptr, length - x);           \
+	}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** Apply a ROP3 to \b length bytes, dst = rop(pat, src, dst) */
+	typedef void (*gdiRop3RowFn)(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src,
+	                             const BYTE* WINPR_RESTRICT pat, size_t length);
+
+	/** @return The 256 portable kernels, indexed by ROP3 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_LOCAL const gdiRop3RowFn* gdi_rop3_get_generic(void);
+
+	/** @return The 256 fastest kernels for the running CPU, indexed by ROP3 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_LOCAL const gdiRop3RowFn* gdi_rop3_get(void);
+
+	/** Compile a ROP in reverse polish notation (see \b gdi_rop_to_string) to its ROP3 index
+	 *
+	 *  @return \b FALSE if the ROP does not depend on any of P, S or D (BLACKNESS, WHITENESS)
+	 */
+	WINPR_ATTR_NODISCARD
+	FREERDP_LOCAL BOOL gdi_rop3_compile(const char* rop, BYTE* index);
+
+	/** BitBlt evaluating the ROP per pixel, the reference for the kernels */
+	WINPR_ATTR_NODISCARD
+	FREERDP_LOCAL BOOL gdi_BitBlt_reference(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest,
+	                                        INT32 nWidth, INT32 nHeight, HGDI_DC hdcSrc,
+	                                        INT32 nXSrc, INT32 nYSrc, DWORD rop,
+	                                        const gdiPalette* palette);
+
+	FREERDP_LOCAL void gdi_rop3_init_sse2_int(gdiRop3RowFn* WINPR_RESTRICT kernels);
+	static inline void gdi_rop3_init_sse2(gdiRop3RowFn* WINPR_RESTRICT kernels)
+	{
+		if (!IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+			return;
+
+		gdi_rop3_init_sse2_int(kernels);
+	}
+
+#if defined(WITH_AVX2)
+	FREERDP_LOCAL void gdi_rop3_init_avx2_int(gdiRop3RowFn* WINPR_RESTRICT kernels);
+	static inline void gdi_rop3_init_avx2(gdiRop3RowFn* WINPR_RESTRICT kernels)
+	{
+		if (!IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+			return;
+
+		gdi_rop3_init_avx2_int(kernels);
+	}
+#endif
+
+	FREERDP_LOCAL void gdi_rop3_init_neon_int(gdiRop3RowFn* WINPR_RESTRICT kernels);
+	static inline void gdi_rop3_init_neon(gdiRop3RowFn* WINPR_RESTRICT kernels)
+	{
+		if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+			return;
+
+		gdi_rop3_init_neon_int(kernels);
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_ROP_H */
@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Blit Kernels - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include "../rop.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static inline __m256i gdi_rop3_load_avx2(const BYTE* WINPR_RESTRICT ptr)
+{
+	return _mm256_loadu_si256((const __m256i*)ptr);
+}
+
+static inline void gdi_rop3_store_avx2(BYTE* WINPR_RESTRICT ptr, __m256i val)
+{
+	_mm256_storeu_si256((__m256i*)ptr, val);
+}
+
+GDI_ROP3_DEFINE_EVAL(gdi_rop3_eval_avx2, __m256i, _mm256_setzero_si256(), _mm256_set1_epi32(-1),
+                     _mm256_and_si256, _mm256_xor_si256)
+
+#define GDI_ROP3_AVX2_KERNEL(rop)                                                           \
+	GDI_ROP3_DEFINE_KERNEL(gdi_rop3_row_avx2_, rop, __m256i, 32, gdi_rop3_load_avx2,         \
+	                       gdi_rop3_store_avx2, _mm256_setzero_si256(), gdi_rop3_eval_avx2)
+GDI_ROP3_FOREACH(GDI_ROP3_AVX2_KERNEL)
+#endif
+
+void gdi_rop3_init_avx2_int(gdiRop3RowFn* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+#define GDI_ROP3_AVX2_ENTRY(rop) kernels[rop] = gdi_rop3_row_avx2_##rop;
+	GDI_ROP3_FOREACH(GDI_ROP3_AVX2_ENTRY)
+#undef GDI_ROP3_AVX2_ENTRY
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
@@ -0,0 +1,60 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI ROP3 Blit Kernels - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include "../rop.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+static inline __m128i gdi_rop3_load_sse2(const BYTE* WINPR_RESTRICT ptr)
+{
+	return _mm_loadu_si128((const __m128i*)ptr);
+}
+
+static inline void gdi_rop3_store_sse2(BYTE* WINPR_RESTRICT ptr, __m128i val)
+{
+	_mm_storeu_si128((__m128i*)ptr, val);
+}
+
+GDI_ROP3_DEFINE_EVAL(gdi_rop3_eval_sse2, __m128i, _mm_setzero_si128(), _mm_set1_epi32(-1),
+                     _mm_and_si128, _mm_xor_si128)
+
+#define GDI_ROP3_SSE2_KERNEL(rop)                                                           \
+	GDI_ROP3_DEFINE_KERNEL(gdi_rop3_row_sse2_, rop, __m128i, 16, gdi_rop3_load_sse2,         \
+	                       gdi_rop3_store_sse2, _mm_setzero_si128(), gdi_rop3_eval_sse2)
+GDI_ROP3_FOREACH(GDI_ROP3_SSE2_KERNEL)
+#endif
+
+void gdi_rop3_init_sse2_int(gdiRop3RowFn* WINPR_RESTRICT kernels)
+{
+	WINPR_ASSERT(kernels);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(PRIM_TAG, "SSE2 optimizations");
+#define GDI_ROP3_SSE2_ENTRY(rop) kernels[rop] = gdi_rop3_row_sse2_##rop;
+	GDI_ROP3_FOREACH(GDI_ROP3_SSE2_ENTRY)
+#undef GDI_ROP3_SSE2_ENTRY
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or SSE2 intrinsics not available");
+	WINPR_UNUSED(kernels);
+#endif
+}
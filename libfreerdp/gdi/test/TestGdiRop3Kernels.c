@@ -0,0 +1,315 @@
+#include <stdio.h>
+
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/dc.h>
+#include <freerdp/gdi/bitmap.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include "brush.h"
+#include "rop.h"
+
+#define TEST_WIDTH 67
+#define TEST_HEIGHT 23
+
+static BYTE rop3_reference(BYTE rop, BYTE p, BYTE s, BYTE d)
+{
+	BYTE result = 0;
+
+	for (size_t bit = 0; bit < 8; bit++)
+	{
+		const size_t index =
+		    (((p >> bit) & 1u) << 2) | (((s >> bit) & 1u) << 1) | ((d >> bit) & 1u);
+		result |= (BYTE)(((rop >> index) & 1u) << bit);
+	}
+	return result;
+}
+
+static BOOL test_rop3_rows(const char* name, const gdiRop3RowFn* kernels)
+{
+	const size_t lengths[] = { 0, 1, 7, 8, 15, 16, 31, 33, 64, 100 };
+	BYTE src[128] = WINPR_C_ARRAY_INIT;
+	BYTE pat[128] = WINPR_C_ARRAY_INIT;
+	BYTE dst[128] = WINPR_C_ARRAY_INIT;
+	BYTE expected[128] = WINPR_C_ARRAY_INIT;
+
+	if (!kernels)
+		return FALSE;
+
+	for (size_t rop = 0; rop < 256; rop++)
+	{
+		for (size_t x = 0; x < ARRAYSIZE(lengths); x++)
+		{
+			const size_t length = lengths[x];
+
+			if ((winpr_RAND(src, sizeof(src)) < 0) || (winpr_RAND(pat, sizeof(pat)) < 0) ||
+			    (winpr_RAND(dst, sizeof(dst)) < 0))
+				return FALSE;
+
+			memcpy(expected, dst, sizeof(dst));
+			for (size_t i = 0; i < length; i++)
+				expected[i] = rop3_reference((BYTE)rop, pat[i], src[i], dst[i]);
+
+			kernels[rop](dst, src, pat, length);
+			if (memcmp(dst, expected, sizeof(dst)) != 0)
+			{
+				(void)fprintf(stderr, "[%s] %s kernel ROP3 0x%02" PRIXz " length %" PRIuz
+				                      " mismatch\n",
+				              __func__, name, rop, length);
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static HGDI_BITMAP test_random_bitmap(UINT32 width, UINT32 height, UINT32 format)
+{
+	const size_t size = 1ull * width * height * FreeRDPGetBytesPerPixel(format);
+	BYTE* data = winpr_aligned_malloc(size, 16);
+
+	if (!data)
+		return nullptr;
+
+	if (winpr_RAND(data, size) < 0)
+	{
+		winpr_aligned_free(data);
+		return nullptr;
+	}
+
+	HGDI_BITMAP bmp = gdi_CreateBitmap(width, height, format, data);
+	if (!bmp)
+		winpr_aligned_free(data);
+	return bmp;
+}
+
+static BOOL test_rop3_blit(UINT32 SrcFormat, UINT32 DstFormat, UINT32 style, BOOL overlap)
+{
+	BOOL rc = FALSE;
+	HGDI_DC hdcDst = nullptr;
+	HGDI_DC hdcRef = nullptr;
+	HGDI_DC hdcSrc = nullptr;
+	HGDI_BITMAP hBmpDst = nullptr;
+	HGDI_BITMAP hBmpRef = nullptr;
+	HGDI_BITMAP hBmpSrc = nullptr;
+	HGDI_BITMAP hBmpPattern = nullptr;
+	HGDI_BRUSH brush = nullptr;
+	BYTE* original = nullptr;
+	gdiPalette palette = WINPR_C_ARRAY_INIT;
+	/* destination x, y, width, height and source x, y */
+	const INT32 blits[][6] = {
+		{ 5, 3, 50, 17, 2, 4 }, { 2, 4, 50, 17, 5, 3 }, { 0, 0, 67, 23, 0, 0 }, { 9, 1, 1, 9, 3, 3 }
+	};
+
+	palette.format = DstFormat;
+	for (UINT32 x = 0; x < 256; x++)
+		palette.palette[x] = FreeRDPGetColor(DstFormat, (BYTE)x, (BYTE)(x * 3), (BYTE)~x, 0xFF);
+
+	hdcDst = gdi_GetDC();
+	hdcRef = gdi_GetDC();
+	hdcSrc = gdi_GetDC();
+	if (!hdcDst || !hdcRef || !hdcSrc)
+		goto fail;
+
+	hdcDst->format = DstFormat;
+	hdcRef->format = DstFormat;
+	hdcSrc->format = SrcFormat;
+
+	hBmpDst = test_random_bitmap(TEST_WIDTH, TEST_HEIGHT, DstFormat);
+	hBmpRef = gdi_CreateCompatibleBitmap(hdcRef, TEST_WIDTH, TEST_HEIGHT);
+	hBmpSrc = test_random_bitmap(TEST_WIDTH, TEST_HEIGHT, SrcFormat);
+	if (!hBmpDst || !hBmpRef || !hBmpSrc)
+		goto fail;
+
+	const size_t size = 1ull * hBmpDst->scanline * TEST_HEIGHT;
+	original = malloc(size);
+	if (!original)
+		goto fail;
+	memcpy(original, hBmpDst->data, size);
+
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+	gdi_SelectObject(hdcRef, (HGDIOBJECT)hBmpRef);
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+
+	if (style == GDI_BS_SOLID)
+		brush = gdi_CreateSolidBrush(FreeRDPGetColor(DstFormat, 0x12, 0x9A, 0xE7, 0xFF));
+	else
+	{
+		hBmpPattern = test_random_bitmap(8, 8, DstFormat);
+		if (!hBmpPattern)
+			goto fail;
+		brush = gdi_CreatePatternBrush(hBmpPattern);
+		if (brush)
+		{
+			brush->nXOrg = 3;
+			brush->nYOrg = 5;
+		}
+	}
+	if (!brush)
+		goto fail;
+	hdcDst->brush = brush;
+	hdcRef->brush = brush;
+
+	for (size_t rop = 0; rop < 256; rop++)
+	{
+		/* SRCCOPY and DSTCOPY are plain image copies in gdi_BitBlt */
+		if ((rop == 0xCC) || (rop == 0xAA))
+			continue;
+
+		for (size_t x = 0; x < ARRAYSIZE(blits); x++)
+		{
+			const INT32* b = blits[x];
+			const DWORD code = gdi_rop3_code((BYTE)rop);
+
+			memcpy(hBmpDst->data, original, size);
+			memcpy(hBmpRef->data, original, size);
+
+			const BOOL actual = gdi_BitBlt(hdcDst, b[0], b[1], b[2], b[3],
+			                               overlap ? hdcDst : hdcSrc, b[4], b[5], code, &palette);
+			const BOOL expected = gdi_BitBlt_reference(
+			    hdcRef, b[0], b[1], b[2], b[3], overlap ? hdcRef : hdcSrc, b[4], b[5], code,
+			    &palette);
+
+			if ((actual != expected) || (memcmp(hBmpDst->data, hBmpRef->data, size) != 0))
+			{
+				(void)fprintf(stderr,
+				              "[%s] %s -> %s style %" PRIu32 " overlap %d ROP %s blit %" PRIuz
+				              " mismatch\n",
+				              __func__, FreeRDPGetColorFormatName(SrcFormat),
+				              FreeRDPGetColorFormatName(DstFormat), style, overlap,
+				              gdi_rop3_code_string((BYTE)rop), x);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	if (hdcDst)
+		hdcDst->brush = nullptr;
+	if (hdcRef)
+		hdcRef->brush = nullptr;
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	gdi_DeleteObject((HGDIOBJECT)hBmpPattern);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteObject((HGDIOBJECT)hBmpRef);
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteDC(hdcDst);
+	gdi_DeleteDC(hdcRef);
+	gdi_DeleteDC(hdcSrc);
+	free(original);
+	return rc;
+}
+
+static double test_rop3_mpixel(UINT64 start, UINT64 end, size_t pixels)
+{
+	const UINT64 diff = (end > start) ? (end - start) : 1;
+	return (1000.0 * (double)pixels) / (double)diff;
+}
+
+/* Throughput of the kernels compared to the per pixel reference for a pattern brush */
+static BOOL test_rop3_benchmark(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 format = PIXEL_FORMAT_BGRX32;
+	const UINT32 width = 1024;
+	const UINT32 height = 64;
+	const size_t rounds = 16;
+	HGDI_DC hdcDst = gdi_GetDC();
+	HGDI_DC hdcSrc = gdi_GetDC();
+	HGDI_BITMAP hBmpDst = test_random_bitmap(width, height, format);
+	HGDI_BITMAP hBmpSrc = test_random_bitmap(width, height, format);
+	HGDI_BITMAP hBmpPattern = test_random_bitmap(8, 8, format);
+	HGDI_BRUSH brush = nullptr;
+	gdiPalette palette = WINPR_C_ARRAY_INIT;
+
+	palette.format = format;
+	if (!hdcDst || !hdcSrc || !hBmpDst || !hBmpSrc || !hBmpPattern)
+		goto fail;
+
+	brush = gdi_CreatePatternBrush(hBmpPattern);
+	if (!brush)
+		goto fail;
+
+	hdcDst->format = format;
+	hdcSrc->format = format;
+	hdcDst->brush = brush;
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+
+	for (size_t rop = 0; rop < 256; rop++)
+	{
+		const DWORD code = gdi_rop3_code((BYTE)rop);
+		const INT32 w = (INT32)width;
+		const INT32 h = (INT32)height;
+
+		const UINT64 start = winpr_GetTickCount64NS();
+		for (size_t x = 0; x < rounds; x++)
+		{
+			if (!gdi_BitBlt(hdcDst, 0, 0, w, h, hdcSrc, 0, 0, code, &palette))
+				goto fail;
+		}
+		const UINT64 mid = winpr_GetTickCount64NS();
+		if (!gdi_BitBlt_reference(hdcDst, 0, 0, w, h, hdcSrc, 0, 0, code, &palette))
+			goto fail;
+		const UINT64 end = winpr_GetTickCount64NS();
+
+		printf("ROP3 0x%02" PRIXz " %-10s kernel %8.1f Mpixel/s, reference %6.1f Mpixel/s\n", rop,
+		       gdi_rop3_code_string((BYTE)rop),
+		       test_rop3_mpixel(start, mid, 1ull * rounds * width * height),
+		       test_rop3_mpixel(mid, end, 1ull * width * height));
+	}
+
+	rc = TRUE;
+fail:
+	if (hdcDst)
+		hdcDst->brush = nullptr;
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	gdi_DeleteObject((HGDIOBJECT)hBmpPattern);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteDC(hdcDst);
+	gdi_DeleteDC(hdcSrc);
+	return rc;
+}
+
+int TestGdiRop3Kernels(int argc, char* argv[])
+{
+	const UINT32 formats[][2] = {
+		{ PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRX32 }, { PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRA32 },
+		{ PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_XRGB32 }, { PIXEL_FORMAT_RGB24, PIXEL_FORMAT_RGB24 },
+		{ PIXEL_FORMAT_RGB16, PIXEL_FORMAT_RGB16 },   { PIXEL_FORMAT_RGB15, PIXEL_FORMAT_RGB15 },
+		{ PIXEL_FORMAT_RGB16, PIXEL_FORMAT_BGRX32 },  { PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_RGB24 },
+		{ PIXEL_FORMAT_RGB8, PIXEL_FORMAT_BGRX32 }
+	};
+	const UINT32 styles[] = { GDI_BS_SOLID, GDI_BS_PATTERN };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_rop3_rows("generic", gdi_rop3_get_generic()))
+		return -1;
+	if (!test_rop3_rows("optimized", gdi_rop3_get()))
+		return -1;
+
+	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(styles); y++)
+		{
+			if (!test_rop3_blit(formats[x][0], formats[x][1], styles[y], FALSE))
+				return -1;
+		}
+
+		if ((formats[x][0] == formats[x][1]) &&
+		    !test_rop3_blit(formats[x][0], formats[x][1], GDI_BS_PATTERN, TRUE))
+			return -1;
+	}
+
+	if (!test_rop3_benchmark())
+		return -1;
+
+	return 0;
+}
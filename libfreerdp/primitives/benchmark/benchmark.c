@@ -200,6 +200,33 @@ static BOOL primitives_RGB2444_benchmark_run(primitives_YUV_benchmark* bench, pr
 	return TRUE;
 }
 
+static BOOL primitives_RGB2AVC444_benchmark_run(primitives_YUV_benchmark* bench,
+                                                primitives_t* prims, UINT32 version)
+{
+	const char* name = (version == 1) ? "RGBToAVC444YUV" : "RGBToAVC444YUVv2";
+	fn_RGBToAVC444YUV_t fkt = (version == 1) ? prims->RGBToAVC444YUV : prims->RGBToAVC444YUVv2;
+
+	for (size_t x = 0; x < 10; x++)
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		pstatus_t status = fkt(bench->rgbBuffer, bench->testedFormat, bench->outputStride,
+		                       bench->outputChannels, bench->steps, bench->channels, bench->steps,
+		                       &bench->roi);
+		const UINT64 end = winpr_GetTickCount64NS();
+		if (status != PRIMITIVES_SUCCESS)
+		{
+			(void)fprintf(stderr, "Running %s failed\n", name);
+			return FALSE;
+		}
+		const UINT64 diff = end - start;
+		char buffer[32] = WINPR_C_ARRAY_INIT;
+		printf("[%" PRIuz "] %s %" PRIu32 "x%" PRIu32 " took %sns\n", x, name, bench->roi.width,
+		       bench->roi.height, print_time(diff, buffer, sizeof(buffer)));
+	}
+
+	return TRUE;
+}
+
 int main(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -247,6 +274,18 @@ int main(int argc, char* argv[])
 			goto fail;
 		}
 		printf("\n");
+
+		for (UINT32 version = 1; version <= 2; version++)
+		{
+			printf("Running RGB -> AVC444 v%" PRIu32 " benchmark on %s implementation:\n", version,
+			       hintstr);
+			if (!primitives_RGB2AVC444_benchmark_run(&bench, prim, version))
+			{
+				(void)fprintf(stderr, "RGB -> AVC444 v%" PRIu32 " benchmark failed\n", version);
+				goto fail;
+			}
+			printf("\n");
+		}
 	}
 fail:
 	primitives_YUV_benchmark_free(&bench);
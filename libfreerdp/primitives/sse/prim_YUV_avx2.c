@@ -0,0 +1,1202 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized YUV/RGB conversion operations using AVX2
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/wtypes.h>
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_avxsse.h"
+#include "prim_YUV.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static primitives_t* generic = nullptr;
+
+/* The kernels below evaluate the integer formulas of prim_internal.h exactly,
+ * so the results are bit identical to the generic implementation. */
+
+static inline __m256i avx2_load(const void* WINPR_RESTRICT ptr)
+{
+	return _mm256_loadu_si256((const __m256i*)ptr);
+}
+
+static inline void avx2_store(void* WINPR_RESTRICT ptr, __m256i val)
+{
+	_mm256_storeu_si256((__m256i*)ptr, val);
+}
+
+/* A pair of 16 bit factors for _mm256_madd_epi16, lo applies to the even word */
+static inline __m256i avx2_factors(INT16 lo, INT16 hi)
+{
+	const UINT32 val = ((UINT32)(UINT16)hi << 16) | (UINT16)lo;
+	return _mm256_set1_epi32(WINPR_CXX_COMPAT_CAST(INT32, val));
+}
+
+/* 16 words (values 0 - 255) to 16 bytes */
+static inline __m128i avx2_pack_words(__m256i words)
+{
+	const __m256i packed = _mm256_packus_epi16(words, words);
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x08));
+}
+
+/* 4x 8 dwords (values 0 - 255) to 32 bytes */
+static inline __m256i avx2_pack_dwords(__m256i a, __m256i b, __m256i c, __m256i d)
+{
+	const __m256i ab = _mm256_packs_epi32(a, b);
+	const __m256i cd = _mm256_packs_epi32(c, d);
+	const __m256i packed = _mm256_packus_epi16(ab, cd);
+	return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+/* 16 bytes [a b c ...] to 32 bytes [a a b b c c ...] */
+static inline __m256i avx2_duplicate(const BYTE* WINPR_RESTRICT data)
+{
+	const __m256i val = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)data));
+	return _mm256_or_si256(val, _mm256_slli_epi16(val, 8));
+}
+
+/****************************************************************************/
+/* avx2 YUV -> RGB conversion                                               */
+/****************************************************************************/
+
+/* Y, D = U - 128 and E = V - 128 as 16 bit values, 256 * Y >> 8 is Y */
+static inline __m256i avx2_yuv2r(__m256i Y, __m256i E)
+{
+	const __m256i r = _mm256_mulhi_epi16(_mm256_slli_epi16(E, 8), _mm256_set1_epi16(403));
+	return _mm256_add_epi16(Y, r);
+}
+
+static inline __m256i avx2_yuv2g(__m256i Y, __m256i D, __m256i E)
+{
+	const __m256i gd = _mm256_mullo_epi16(D, _mm256_set1_epi16(-48));
+	const __m256i ge = _mm256_mullo_epi16(E, _mm256_set1_epi16(-120));
+	return _mm256_add_epi16(Y, _mm256_srai_epi16(_mm256_add_epi16(gd, ge), 8));
+}
+
+static inline __m256i avx2_yuv2b(__m256i Y, __m256i D)
+{
+	const __m256i b = _mm256_mulhi_epi16(_mm256_slli_epi16(D, 8), _mm256_set1_epi16(475));
+	return _mm256_add_epi16(Y, b);
+}
+
+/* Convert 32 pixels to BGRX, the X byte of the destination is preserved */
+static inline void avx2_YUV444ToBGRX_32(BYTE* WINPR_RESTRICT pDst, __m256i Y, __m256i U,
+                                        __m256i V)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i c128 = _mm256_set1_epi16(128);
+	const __m256i Ylo = _mm256_unpacklo_epi8(Y, zero);
+	const __m256i Yhi = _mm256_unpackhi_epi8(Y, zero);
+	const __m256i Dlo = _mm256_sub_epi16(_mm256_unpacklo_epi8(U, zero), c128);
+	const __m256i Dhi = _mm256_sub_epi16(_mm256_unpackhi_epi8(U, zero), c128);
+	const __m256i Elo = _mm256_sub_epi16(_mm256_unpacklo_epi8(V, zero), c128);
+	const __m256i Ehi = _mm256_sub_epi16(_mm256_unpackhi_epi8(V, zero), c128);
+
+	const __m256i R = _mm256_packus_epi16(avx2_yuv2r(Ylo, Elo), avx2_yuv2r(Yhi, Ehi));
+	const __m256i G =
+	    _mm256_packus_epi16(avx2_yuv2g(Ylo, Dlo, Elo), avx2_yuv2g(Yhi, Dhi, Ehi));
+	const __m256i B = _mm256_packus_epi16(avx2_yuv2b(Ylo, Dlo), avx2_yuv2b(Yhi, Dhi));
+
+	const __m256i bglo = _mm256_unpacklo_epi8(B, G);
+	const __m256i bghi = _mm256_unpackhi_epi8(B, G);
+	const __m256i r0lo = _mm256_unpacklo_epi8(R, zero);
+	const __m256i r0hi = _mm256_unpackhi_epi8(R, zero);
+
+	/* pixels [0-3 | 16-19], [4-7 | 20-23], [8-11 | 24-27], [12-15 | 28-31] */
+	const __m256i p0 = _mm256_unpacklo_epi16(bglo, r0lo);
+	const __m256i p1 = _mm256_unpackhi_epi16(bglo, r0lo);
+	const __m256i p2 = _mm256_unpacklo_epi16(bghi, r0hi);
+	const __m256i p3 = _mm256_unpackhi_epi16(bghi, r0hi);
+	const __m256i bgrx[] = { _mm256_permute2x128_si256(p0, p1, 0x20),
+		                     _mm256_permute2x128_si256(p2, p3, 0x20),
+		                     _mm256_permute2x128_si256(p0, p1, 0x31),
+		                     _mm256_permute2x128_si256(p2, p3, 0x31) };
+	const __m256i xmask = _mm256_set1_epi32(WINPR_CXX_COMPAT_CAST(INT32, 0xFF000000));
+
+	for (size_t x = 0; x < ARRAYSIZE(bgrx); x++)
+	{
+		BYTE* dst = &pDst[x * sizeof(__m256i)];
+		const __m256i X = _mm256_and_si256(avx2_load(dst), xmask);
+		avx2_store(dst, _mm256_or_si256(bgrx[x], X));
+	}
+}
+
+static inline pstatus_t avx2_YUV420ToRGB_BGRX(const BYTE* WINPR_RESTRICT pSrc[],
+                                              const UINT32* WINPR_RESTRICT srcStep,
+                                              BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                              const prim_size_t* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	const UINT32 pad = roi->width % 32;
+
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		BYTE* dst = pDst + dstStep * y;
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + (y / 2) * srcStep[1];
+		const BYTE* VData = pSrc[2] + (y / 2) * srcStep[2];
+
+		size_t x = 0;
+		for (; x < nWidth - pad; x += 32)
+		{
+			const __m256i Y = avx2_load(&YData[x]);
+			const __m256i U = avx2_duplicate(&UData[x / 2]);
+			const __m256i V = avx2_duplicate(&VData[x / 2]);
+			avx2_YUV444ToBGRX_32(&dst[4 * x], Y, U, V);
+		}
+
+		for (; x < nWidth; x++)
+		{
+			(void)writeYUVPixel(&dst[4 * x], PIXEL_FORMAT_BGRX32, YData[x], UData[x / 2],
+			                    VData[x / 2], writePixelBGRX);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV420ToRGB(const BYTE* WINPR_RESTRICT pSrc[3], const UINT32 srcStep[3],
+                                  BYTE* WINPR_RESTRICT pDst, UINT32 dstStep, UINT32 DstFormat,
+                                  const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUV420ToRGB_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->YUV420ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/* Clip value and keep the original byte if the result is close to it, like CONDITIONAL_CLIP.
+ * original holds the even bytes of row, the odd bytes of row are passed through. */
+static inline __m256i avx2_conditional_clip(__m256i row, __m256i original, __m256i value)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	const __m256i clipped =
+	    _mm256_min_epi16(_mm256_max_epi16(value, _mm256_setzero_si256()), mask);
+	const __m256i diff = _mm256_abs_epi16(_mm256_sub_epi16(clipped, original));
+	const __m256i keep = _mm256_cmpgt_epi16(_mm256_set1_epi16(30), diff);
+	const __m256i filtered = _mm256_blendv_epi8(clipped, original, keep);
+	return _mm256_or_si256(_mm256_andnot_si256(mask, row), filtered);
+}
+
+/* The decoder side chroma filter of the top left value of each 2x2 block */
+static inline __m256i avx2_filter(__m256i row0, __m256i row1)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	const __m256i e0 = _mm256_and_si256(row0, mask);
+	const __m256i o0 = _mm256_srli_epi16(row0, 8);
+	const __m256i e1 = _mm256_and_si256(row1, mask);
+	const __m256i o1 = _mm256_srli_epi16(row1, 8);
+	const __m256i sum = _mm256_add_epi16(o0, _mm256_add_epi16(e1, o1));
+	const __m256i avg = _mm256_sub_epi16(_mm256_slli_epi16(e0, 2), sum);
+	return avx2_conditional_clip(row0, e0, avg);
+}
+
+static inline void BGRX_fillRGB(size_t offset, BYTE* WINPR_RESTRICT pRGB[2],
+                                const BYTE* WINPR_RESTRICT pY[2], const BYTE* WINPR_RESTRICT pU[2],
+                                const BYTE* WINPR_RESTRICT pV[2])
+{
+	WINPR_ASSERT(pRGB);
+	WINPR_ASSERT(pY);
+	WINPR_ASSERT(pU);
+	WINPR_ASSERT(pV);
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		for (size_t j = 0; j < 2; j++)
+		{
+			const BYTE Y = pY[i][offset + j];
+			BYTE U = pU[i][offset + j];
+			BYTE V = pV[i][offset + j];
+			if ((i == 0) && (j == 0))
+			{
+				const INT32 avgU =
+				    4 * pU[0][offset] - pU[0][offset + 1] - pU[1][offset] - pU[1][offset + 1];
+				const INT32 avgV =
+				    4 * pV[0][offset] - pV[0][offset + 1] - pV[1][offset] - pV[1][offset + 1];
+
+				U = CONDITIONAL_CLIP(avgU, pU[0][offset]);
+				V = CONDITIONAL_CLIP(avgV, pV[0][offset]);
+			}
+
+			(void)writeYUVPixel(&pRGB[i][(j + offset) * 4], PIXEL_FORMAT_BGRX32, Y, U, V,
+			                    writePixelBGRX);
+		}
+	}
+}
+
+static inline void avx2_YUV444ToRGB_BGRX_DOUBLE_ROW(BYTE* WINPR_RESTRICT pDst[2],
+                                                    const BYTE* WINPR_RESTRICT YData[2],
+                                                    const BYTE* WINPR_RESTRICT UData[2],
+                                                    const BYTE* WINPR_RESTRICT VData[2],
+                                                    UINT32 nWidth)
+{
+	WINPR_ASSERT((nWidth % 2) == 0);
+	const UINT32 pad = nWidth % 32;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 32)
+	{
+		const __m256i U1 = avx2_load(&UData[1][x]);
+		const __m256i V1 = avx2_load(&VData[1][x]);
+		const __m256i U0 = avx2_filter(avx2_load(&UData[0][x]), U1);
+		const __m256i V0 = avx2_filter(avx2_load(&VData[0][x]), V1);
+
+		avx2_YUV444ToBGRX_32(&pDst[0][4 * x], avx2_load(&YData[0][x]), U0, V0);
+		avx2_YUV444ToBGRX_32(&pDst[1][4 * x], avx2_load(&YData[1][x]), U1, V1);
+	}
+
+	for (; x < nWidth; x += 2)
+	{
+		BGRX_fillRGB(x, pDst, YData, UData, VData);
+	}
+}
+
+static inline void avx2_YUV444ToRGB_BGRX_SINGLE_ROW(BYTE* WINPR_RESTRICT pDst,
+                                                    const BYTE* WINPR_RESTRICT YData,
+                                                    const BYTE* WINPR_RESTRICT UData,
+                                                    const BYTE* WINPR_RESTRICT VData, UINT32 nWidth)
+{
+	const UINT32 pad = nWidth % 32;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 32)
+	{
+		avx2_YUV444ToBGRX_32(&pDst[4 * x], avx2_load(&YData[x]), avx2_load(&UData[x]),
+		                     avx2_load(&VData[x]));
+	}
+
+	for (; x < nWidth; x++)
+	{
+		(void)writeYUVPixel(&pDst[4 * x], PIXEL_FORMAT_BGRX32, YData[x], UData[x], VData[x],
+		                    writePixelBGRX);
+	}
+}
+
+static inline pstatus_t avx2_YUV444ToRGB_8u_P3AC4R_BGRX(const BYTE* WINPR_RESTRICT pSrc[],
+                                                        const UINT32 srcStep[],
+                                                        BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                                        const prim_size_t* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+
+	size_t y = 0;
+	for (; y < nHeight - nHeight % 2; y += 2)
+	{
+		BYTE* dst[] = { (pDst + dstStep * y), (pDst + dstStep * (y + 1)) };
+		const BYTE* YData[] = { pSrc[0] + y * srcStep[0], pSrc[0] + (y + 1) * srcStep[0] };
+		const BYTE* UData[] = { pSrc[1] + y * srcStep[1], pSrc[1] + (y + 1) * srcStep[1] };
+		const BYTE* VData[] = { pSrc[2] + y * srcStep[2], pSrc[2] + (y + 1) * srcStep[2] };
+
+		avx2_YUV444ToRGB_BGRX_DOUBLE_ROW(dst, YData, UData, VData, nWidth);
+	}
+
+	for (; y < nHeight; y++)
+	{
+		BYTE* dst = (pDst + dstStep * y);
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + y * srcStep[1];
+		const BYTE* VData = pSrc[2] + y * srcStep[2];
+
+		avx2_YUV444ToRGB_BGRX_SINGLE_ROW(dst, YData, UData, VData, nWidth);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV444ToRGB_8u_P3AC4R(const BYTE* WINPR_RESTRICT pSrc[],
+                                            const UINT32 srcStep[], BYTE* WINPR_RESTRICT pDst,
+                                            UINT32 dstStep, UINT32 DstFormat,
+                                            const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_YUV444ToRGB_8u_P3AC4R_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx2 RGB -> YUV conversion                                               */
+/****************************************************************************/
+
+/* 8 BGRX pixels to 8 dwords of Y, U or V.
+ * br holds the (B, R) and gx the (G, X) words of each pixel. */
+static inline __m256i avx2_BGRXToY_8(__m256i br, __m256i gx)
+{
+	const __m256i y = _mm256_add_epi32(_mm256_madd_epi16(br, avx2_factors(18, 54)),
+	                                   _mm256_madd_epi16(gx, avx2_factors(183, 0)));
+	return _mm256_srli_epi32(y, 8);
+}
+
+static inline __m256i avx2_BGRXToU_8(__m256i br, __m256i gx)
+{
+	const __m256i u = _mm256_add_epi32(_mm256_madd_epi16(br, avx2_factors(128, -29)),
+	                                   _mm256_madd_epi16(gx, avx2_factors(-99, 0)));
+	return _mm256_add_epi32(_mm256_srai_epi32(u, 8), _mm256_set1_epi32(128));
+}
+
+static inline __m256i avx2_BGRXToV_8(__m256i br, __m256i gx)
+{
+	const __m256i v = _mm256_add_epi32(_mm256_madd_epi16(br, avx2_factors(-12, 128)),
+	                                   _mm256_madd_epi16(gx, avx2_factors(-116, 0)));
+	return _mm256_add_epi32(_mm256_srai_epi32(v, 8), _mm256_set1_epi32(128));
+}
+
+static inline __m256i avx2_BGRX_br(__m256i bgrx)
+{
+	return _mm256_and_si256(bgrx, _mm256_set1_epi16(0x00FF));
+}
+
+static inline __m256i avx2_BGRX_gx(__m256i bgrx)
+{
+	return _mm256_srli_epi16(bgrx, 8);
+}
+
+static inline __m256i avx2_BGRXToY_32(const BYTE* WINPR_RESTRICT src)
+{
+	__m256i y[4] = WINPR_C_ARRAY_INIT;
+	for (size_t x = 0; x < ARRAYSIZE(y); x++)
+	{
+		const __m256i bgrx = avx2_load(&src[x * sizeof(__m256i)]);
+		y[x] = avx2_BGRXToY_8(avx2_BGRX_br(bgrx), avx2_BGRX_gx(bgrx));
+	}
+	return avx2_pack_dwords(y[0], y[1], y[2], y[3]);
+}
+
+static inline void avx2_BGRXToYUV_32(const BYTE* WINPR_RESTRICT src, __m256i* WINPR_RESTRICT Y,
+                                     __m256i* WINPR_RESTRICT U, __m256i* WINPR_RESTRICT V)
+{
+	__m256i y[4] = WINPR_C_ARRAY_INIT;
+	__m256i u[4] = WINPR_C_ARRAY_INIT;
+	__m256i v[4] = WINPR_C_ARRAY_INIT;
+	for (size_t x = 0; x < ARRAYSIZE(y); x++)
+	{
+		const __m256i bgrx = avx2_load(&src[x * sizeof(__m256i)]);
+		const __m256i br = avx2_BGRX_br(bgrx);
+		const __m256i gx = avx2_BGRX_gx(bgrx);
+		y[x] = avx2_BGRXToY_8(br, gx);
+		u[x] = avx2_BGRXToU_8(br, gx);
+		v[x] = avx2_BGRXToV_8(br, gx);
+	}
+	*Y = avx2_pack_dwords(y[0], y[1], y[2], y[3]);
+	*U = avx2_pack_dwords(u[0], u[1], u[2], u[3]);
+	*V = avx2_pack_dwords(v[0], v[1], v[2], v[3]);
+}
+
+/* (a + b + c + d) / 4 of each 2x2 block of 32 byte wide rows */
+static inline __m128i avx2_average_2x2(__m256i row0, __m256i row1)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	const __m256i sum0 = _mm256_add_epi16(_mm256_and_si256(row0, mask), _mm256_srli_epi16(row0, 8));
+	const __m256i sum1 = _mm256_add_epi16(_mm256_and_si256(row1, mask), _mm256_srli_epi16(row1, 8));
+	return avx2_pack_words(_mm256_srli_epi16(_mm256_add_epi16(sum0, sum1), 2));
+}
+
+static inline __m128i avx2_odd_bytes(__m256i val)
+{
+	return avx2_pack_words(_mm256_srli_epi16(val, 8));
+}
+
+/* bytes 4n in the low and bytes 4n + 2 in the high 8 bytes */
+static inline __m128i avx2_quarter_bytes(__m256i val)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256i q0 = _mm256_and_si256(val, mask);
+	const __m256i q2 = _mm256_and_si256(_mm256_srli_epi32(val, 16), mask);
+	const __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q2), 0xD8);
+	return avx2_pack_words(words);
+}
+
+static inline void BGRX_fillYUV(size_t offset, const BYTE* WINPR_RESTRICT pRGB[2],
+                                BYTE* WINPR_RESTRICT pY[2], BYTE* WINPR_RESTRICT pU[2],
+                                BYTE* WINPR_RESTRICT pV[2])
+{
+	WINPR_ASSERT(pRGB);
+	WINPR_ASSERT(pY);
+	WINPR_ASSERT(pU);
+	WINPR_ASSERT(pV);
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		for (size_t j = 0; j < 2; j++)
+		{
+			const BYTE* src = &pRGB[i][(offset + j) * 4];
+			const BYTE B = src[0];
+			const BYTE G = src[1];
+			const BYTE R = src[2];
+			pY[i][offset + j] = RGB2Y(R, G, B);
+			pU[i][offset + j] = RGB2U(R, G, B);
+			pV[i][offset + j] = RGB2V(R, G, B);
+		}
+	}
+
+	/* Apply chroma filter */
+	const INT32 avgU = (pU[0][offset] + pU[0][offset + 1] + pU[1][offset] + pU[1][offset + 1]) / 4;
+	pU[0][offset] = CONDITIONAL_CLIP(avgU, pU[0][offset]);
+	const INT32 avgV = (pV[0][offset] + pV[0][offset + 1] + pV[1][offset] + pV[1][offset + 1]) / 4;
+	pV[0][offset] = CONDITIONAL_CLIP(avgV, pV[0][offset]);
+}
+
+/* The encoder side chroma filter of the top left value of each 2x2 block */
+static inline __m256i avx2_average_filter(__m256i row0, __m256i row1)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	const __m256i e0 = _mm256_and_si256(row0, mask);
+	const __m256i sum0 = _mm256_add_epi16(e0, _mm256_srli_epi16(row0, 8));
+	const __m256i sum1 = _mm256_add_epi16(_mm256_and_si256(row1, mask), _mm256_srli_epi16(row1, 8));
+	const __m256i avg = _mm256_srli_epi16(_mm256_add_epi16(sum0, sum1), 2);
+	return avx2_conditional_clip(row0, e0, avg);
+}
+
+static inline void avx2_RGBToYUV444_BGRX_DOUBLE_ROW(const BYTE* WINPR_RESTRICT pRGB[2],
+                                                    BYTE* WINPR_RESTRICT pY[2],
+                                                    BYTE* WINPR_RESTRICT pU[2],
+                                                    BYTE* WINPR_RESTRICT pV[2], UINT32 nWidth)
+{
+	WINPR_ASSERT((nWidth % 2) == 0);
+	const UINT32 pad = nWidth % 32;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 32)
+	{
+		__m256i Y[2] = WINPR_C_ARRAY_INIT;
+		__m256i U[2] = WINPR_C_ARRAY_INIT;
+		__m256i V[2] = WINPR_C_ARRAY_INIT;
+		avx2_BGRXToYUV_32(&pRGB[0][4 * x], &Y[0], &U[0], &V[0]);
+		avx2_BGRXToYUV_32(&pRGB[1][4 * x], &Y[1], &U[1], &V[1]);
+
+		avx2_store(&pY[0][x], Y[0]);
+		avx2_store(&pY[1][x], Y[1]);
+		avx2_store(&pU[0][x], avx2_average_filter(U[0], U[1]));
+		avx2_store(&pU[1][x], U[1]);
+		avx2_store(&pV[0][x], avx2_average_filter(V[0], V[1]));
+		avx2_store(&pV[1][x], V[1]);
+	}
+
+	for (; x < nWidth; x += 2)
+	{
+		BGRX_fillYUV(x, pRGB, pY, pU, pV);
+	}
+}
+
+static inline void avx2_RGBToYUV444_BGRX_SINGLE_ROW(const BYTE* WINPR_RESTRICT pRGB,
+                                                    BYTE* WINPR_RESTRICT pY,
+                                                    BYTE* WINPR_RESTRICT pU,
+                                                    BYTE* WINPR_RESTRICT pV, UINT32 nWidth)
+{
+	const UINT32 pad = nWidth % 32;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 32)
+	{
+		__m256i Y = _mm256_setzero_si256();
+		__m256i U = _mm256_setzero_si256();
+		__m256i V = _mm256_setzero_si256();
+		avx2_BGRXToYUV_32(&pRGB[4 * x], &Y, &U, &V);
+		avx2_store(&pY[x], Y);
+		avx2_store(&pU[x], U);
+		avx2_store(&pV[x], V);
+	}
+
+	for (; x < nWidth; x++)
+	{
+		const BYTE* src = &pRGB[4 * x];
+		pY[x] = RGB2Y(src[2], src[1], src[0]);
+		pU[x] = RGB2U(src[2], src[1], src[0]);
+		pV[x] = RGB2V(src[2], src[1], src[0]);
+	}
+}
+
+static pstatus_t avx2_RGBToYUV444_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                       BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+
+	size_t y = 0;
+	for (; y < nHeight - nHeight % 2; y += 2)
+	{
+		const BYTE* pRGB[] = { pSrc + y * srcStep, pSrc + (y + 1) * srcStep };
+		BYTE* pY[] = { pDst[0] + y * dstStep[0], pDst[0] + (y + 1) * dstStep[0] };
+		BYTE* pU[] = { pDst[1] + y * dstStep[1], pDst[1] + (y + 1) * dstStep[1] };
+		BYTE* pV[] = { pDst[2] + y * dstStep[2], pDst[2] + (y + 1) * dstStep[2] };
+
+		avx2_RGBToYUV444_BGRX_DOUBLE_ROW(pRGB, pY, pU, pV, nWidth);
+	}
+
+	for (; y < nHeight; y++)
+	{
+		const BYTE* pRGB = pSrc + y * srcStep;
+		BYTE* pY = pDst[0] + y * dstStep[0];
+		BYTE* pU = pDst[1] + y * dstStep[1];
+		BYTE* pV = pDst[2] + y * dstStep[2];
+
+		avx2_RGBToYUV444_BGRX_SINGLE_ROW(pRGB, pY, pU, pV, nWidth);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV444(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                  UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[3],
+                                  const UINT32 dstStep[3], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV444_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV444_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/* The 2x2 average of 8 BGRX pixels of two rows as 4 pixels of 16 bit words */
+static inline __m256i avx2_BGRX_average(__m256i row0, __m256i row1)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i lo =
+	    _mm256_add_epi16(_mm256_unpacklo_epi8(row0, zero), _mm256_unpacklo_epi8(row1, zero));
+	const __m256i hi =
+	    _mm256_add_epi16(_mm256_unpackhi_epi8(row0, zero), _mm256_unpackhi_epi8(row1, zero));
+	const __m256i sumlo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+	const __m256i sumhi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+	return _mm256_srli_epi16(_mm256_unpacklo_epi64(sumlo, sumhi), 2);
+}
+
+static inline void avx2_RGBToYUV420_BGRX_DOUBLE_ROW(const BYTE* WINPR_RESTRICT src0,
+                                                    const BYTE* WINPR_RESTRICT src1,
+                                                    BYTE* WINPR_RESTRICT ydst0,
+                                                    BYTE* WINPR_RESTRICT ydst1,
+                                                    BYTE* WINPR_RESTRICT udst,
+                                                    BYTE* WINPR_RESTRICT vdst, UINT32 width)
+{
+	size_t x = 0;
+	for (; x < width - width % 32; x += 32)
+	{
+		__m256i avg[4] = WINPR_C_ARRAY_INIT;
+		for (size_t i = 0; i < ARRAYSIZE(avg); i++)
+		{
+			const size_t offset = 4 * x + i * sizeof(__m256i);
+			avg[i] = avx2_BGRX_average(avx2_load(&src0[offset]), avx2_load(&src1[offset]));
+		}
+
+		const __m256i bgrx0 = _mm256_permute4x64_epi64(_mm256_packus_epi16(avg[0], avg[1]), 0xD8);
+		const __m256i bgrx1 = _mm256_permute4x64_epi64(_mm256_packus_epi16(avg[2], avg[3]), 0xD8);
+		const __m256i br0 = avx2_BGRX_br(bgrx0);
+		const __m256i gx0 = avx2_BGRX_gx(bgrx0);
+		const __m256i br1 = avx2_BGRX_br(bgrx1);
+		const __m256i gx1 = avx2_BGRX_gx(bgrx1);
+		const __m256i u = _mm256_permute4x64_epi64(
+		    _mm256_packs_epi32(avx2_BGRXToU_8(br0, gx0), avx2_BGRXToU_8(br1, gx1)), 0xD8);
+		const __m256i v = _mm256_permute4x64_epi64(
+		    _mm256_packs_epi32(avx2_BGRXToV_8(br0, gx0), avx2_BGRXToV_8(br1, gx1)), 0xD8);
+
+		_mm_storeu_si128((__m128i*)&udst[x / 2], avx2_pack_words(u));
+		_mm_storeu_si128((__m128i*)&vdst[x / 2], avx2_pack_words(v));
+		avx2_store(&ydst0[x], avx2_BGRXToY_32(&src0[4 * x]));
+		avx2_store(&ydst1[x], avx2_BGRXToY_32(&src1[4 * x]));
+	}
+
+	for (; x < width; x += 2)
+	{
+		const BYTE* p[] = { &src0[4 * x], &src0[4 * x + 4], &src1[4 * x], &src1[4 * x + 4] };
+		const size_t count = (x + 1 < width) ? 4 : 2;
+		INT32 B = 0;
+		INT32 G = 0;
+		INT32 R = 0;
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			if ((count == 2) && (i % 2))
+				continue;
+			BYTE* ydst = (i < 2) ? ydst0 : ydst1;
+			ydst[x + i % 2] = RGB2Y(p[i][2], p[i][1], p[i][0]);
+			B += p[i][0];
+			G += p[i][1];
+			R += p[i][2];
+		}
+
+		udst[x / 2] = RGB2U(R >> 2, G >> 2, B >> 2);
+		vdst[x / 2] = RGB2V(R >> 2, G >> 2, B >> 2);
+	}
+}
+
+static pstatus_t avx2_RGBToYUV420_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                       BYTE* WINPR_RESTRICT pDst[], const UINT32 dstStep[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* line1 = &pSrc[y * srcStep];
+		const BYTE* line2 = &pSrc[(1ULL + y) * srcStep];
+		BYTE* ydst1 = &pDst[0][y * dstStep[0]];
+		BYTE* ydst2 = &pDst[0][(1ULL + y) * dstStep[0]];
+		BYTE* udst = &pDst[1][y / 2 * dstStep[1]];
+		BYTE* vdst = &pDst[2][y / 2 * dstStep[2]];
+
+		avx2_RGBToYUV420_BGRX_DOUBLE_ROW(line1, line2, ydst1, ydst2, udst, vdst, roi->width);
+	}
+
+	if (y < roi->height)
+	{
+		/* The last odd line is converted by the generic code, it uses the averages of only
+		 * two pixels for the chroma values. */
+		const BYTE* line = &pSrc[y * srcStep];
+		BYTE* dst[] = { &pDst[0][y * dstStep[0]], &pDst[1][y / 2 * dstStep[1]],
+			            &pDst[2][y / 2 * dstStep[2]] };
+		const prim_size_t row = { .width = roi->width, .height = 1 };
+		return generic->RGBToYUV420_8u_P3AC4R(line, PIXEL_FORMAT_BGRX32, srcStep, dst, dstStep,
+		                                      &row);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToYUV420(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                  UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[],
+                                  const UINT32 dstStep[], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToYUV420_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx2 RGB -> AVC444-YUV conversion                                        */
+/****************************************************************************/
+
+static inline void avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT b1Even, BYTE* WINPR_RESTRICT b1Odd, BYTE* WINPR_RESTRICT b2,
+    BYTE* WINPR_RESTRICT b3, BYTE* WINPR_RESTRICT b4, BYTE* WINPR_RESTRICT b5,
+    BYTE* WINPR_RESTRICT b6, BYTE* WINPR_RESTRICT b7, UINT32 width)
+{
+	size_t x = 0;
+	for (; x < width - width % 32; x += 32)
+	{
+		__m256i Ye = _mm256_setzero_si256();
+		__m256i Ue = _mm256_setzero_si256();
+		__m256i Ve = _mm256_setzero_si256();
+		__m256i Yo = _mm256_setzero_si256();
+		__m256i Uo = _mm256_setzero_si256();
+		__m256i Vo = _mm256_setzero_si256();
+		avx2_BGRXToYUV_32(&srcEven[4 * x], &Ye, &Ue, &Ve);
+		avx2_BGRXToYUV_32(&srcOdd[4 * x], &Yo, &Uo, &Vo);
+
+		/* Y [b1] */
+		avx2_store(&b1Even[x], Ye);
+		avx2_store(&b1Odd[x], Yo);
+
+		/* 2x 2y [b2, b3] */
+		_mm_storeu_si128((__m128i*)&b2[x / 2], avx2_average_2x2(Ue, Uo));
+		_mm_storeu_si128((__m128i*)&b3[x / 2], avx2_average_2x2(Ve, Vo));
+
+		/* x, 2y + 1 [b4, b5] */
+		avx2_store(&b4[x], Uo);
+		avx2_store(&b5[x], Vo);
+
+		/* 2x + 1, 2y [b6, b7] */
+		_mm_storeu_si128((__m128i*)&b6[x / 2], avx2_odd_bytes(Ue));
+		_mm_storeu_si128((__m128i*)&b7[x / 2], avx2_odd_bytes(Ve));
+	}
+
+	general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(x, srcEven, srcOdd, &b1Even[x], &b1Odd[x], &b2[x / 2],
+	                                       &b3[x / 2], &b4[x], &b5[x], &b6[x / 2], &b7[x / 2],
+	                                       width);
+}
+
+static pstatus_t avx2_RGBToAVC444YUV_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                          BYTE* WINPR_RESTRICT pDst1[], const UINT32 dst1Step[],
+                                          BYTE* WINPR_RESTRICT pDst2[], const UINT32 dst2Step[],
+                                          const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		const BYTE* srcOdd = pSrc + (y + 1) * srcStep;
+		const size_t i = y >> 1;
+		const size_t n = (i & (size_t)~7) + i;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b1Odd = (b1Even + dst1Step[0]);
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + 1ULL * dst2Step[0] * n;
+		BYTE* b5 = b4 + 8ULL * dst2Step[0];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		avx2_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6, b7,
+		                                    roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(0, srcEven, nullptr, b1Even, nullptr, b2, b3,
+		                                       nullptr, nullptr, b6, b7, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUV(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                     UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                     const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                     const UINT32 dst2Step[], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUV_BGRX(pSrc, srcStep, pDst1, dst1Step, pDst2, dst2Step, roi);
+
+		default:
+			return generic->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                               dst2Step, roi);
+	}
+}
+
+/* see sse41_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW for the mapping of arguments */
+static inline void avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT yLumaDstEven, BYTE* WINPR_RESTRICT yLumaDstOdd,
+    BYTE* WINPR_RESTRICT uLumaDst, BYTE* WINPR_RESTRICT vLumaDst,
+    BYTE* WINPR_RESTRICT yEvenChromaDst1, BYTE* WINPR_RESTRICT yEvenChromaDst2,
+    BYTE* WINPR_RESTRICT yOddChromaDst1, BYTE* WINPR_RESTRICT yOddChromaDst2,
+    BYTE* WINPR_RESTRICT uChromaDst1, BYTE* WINPR_RESTRICT uChromaDst2,
+    BYTE* WINPR_RESTRICT vChromaDst1, BYTE* WINPR_RESTRICT vChromaDst2, UINT32 width)
+{
+	size_t x = 0;
+	for (; x < width - width % 32; x += 32)
+	{
+		__m256i Ye = _mm256_setzero_si256();
+		__m256i Ue = _mm256_setzero_si256();
+		__m256i Ve = _mm256_setzero_si256();
+		__m256i Yo = _mm256_setzero_si256();
+		__m256i Uo = _mm256_setzero_si256();
+		__m256i Vo = _mm256_setzero_si256();
+		avx2_BGRXToYUV_32(&srcEven[4 * x], &Ye, &Ue, &Ve);
+		avx2_BGRXToYUV_32(&srcOdd[4 * x], &Yo, &Uo, &Vo);
+
+		/* Y [b1] */
+		avx2_store(&yLumaDstEven[x], Ye);
+		avx2_store(&yLumaDstOdd[x], Yo);
+
+		/* 2x 2y [b2, b3] */
+		_mm_storeu_si128((__m128i*)&uLumaDst[x / 2], avx2_average_2x2(Ue, Uo));
+		_mm_storeu_si128((__m128i*)&vLumaDst[x / 2], avx2_average_2x2(Ve, Vo));
+
+		/* 2x + 1, y [b4, b5] */
+		_mm_storeu_si128((__m128i*)&yEvenChromaDst1[x / 2], avx2_odd_bytes(Ue));
+		_mm_storeu_si128((__m128i*)&yEvenChromaDst2[x / 2], avx2_odd_bytes(Ve));
+		_mm_storeu_si128((__m128i*)&yOddChromaDst1[x / 2], avx2_odd_bytes(Uo));
+		_mm_storeu_si128((__m128i*)&yOddChromaDst2[x / 2], avx2_odd_bytes(Vo));
+
+		/* 4x, 2y + 1 [b6, b7] and 4x + 2, 2y + 1 [b8, b9] */
+		const __m128i u = avx2_quarter_bytes(Uo);
+		const __m128i v = avx2_quarter_bytes(Vo);
+		_mm_storel_epi64((__m128i*)&uChromaDst1[x / 4], u);
+		_mm_storel_epi64((__m128i*)&vChromaDst1[x / 4], _mm_unpackhi_epi64(u, u));
+		_mm_storel_epi64((__m128i*)&uChromaDst2[x / 4], v);
+		_mm_storel_epi64((__m128i*)&vChromaDst2[x / 4], _mm_unpackhi_epi64(v, v));
+	}
+
+	general_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+	    x, srcEven, srcOdd, &yLumaDstEven[x], &yLumaDstOdd[x], &uLumaDst[x / 2], &vLumaDst[x / 2],
+	    &yEvenChromaDst1[x / 2], &yEvenChromaDst2[x / 2], &yOddChromaDst1[x / 2],
+	    &yOddChromaDst2[x / 2], &uChromaDst1[x / 4], &uChromaDst2[x / 4], &vChromaDst1[x / 4],
+	    &vChromaDst2[x / 4], width);
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                            BYTE* WINPR_RESTRICT pDst1[], const UINT32 dst1Step[],
+                                            BYTE* WINPR_RESTRICT pDst2[], const UINT32 dst2Step[],
+                                            const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* srcEven = (pSrc + y * srcStep);
+		const BYTE* srcOdd = (srcEven + srcStep);
+		BYTE* dstLumaYEven = (pDst1[0] + y * dst1Step[0]);
+		BYTE* dstLumaYOdd = (dstLumaYEven + dst1Step[0]);
+		BYTE* dstLumaU = (pDst1[1] + (y / 2) * dst1Step[1]);
+		BYTE* dstLumaV = (pDst1[2] + (y / 2) * dst1Step[2]);
+		BYTE* dstEvenChromaY1 = (pDst2[0] + y * dst2Step[0]);
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstOddChromaY1 = dstEvenChromaY1 + dst2Step[0];
+		BYTE* dstOddChromaY2 = dstEvenChromaY2 + dst2Step[0];
+		BYTE* dstChromaU1 = (pDst2[1] + (y / 2) * dst2Step[1]);
+		BYTE* dstChromaV1 = (pDst2[2] + (y / 2) * dst2Step[2]);
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		avx2_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(srcEven, srcOdd, dstLumaYEven, dstLumaYOdd, dstLumaU,
+		                                      dstLumaV, dstEvenChromaY1, dstEvenChromaY2,
+		                                      dstOddChromaY1, dstOddChromaY2, dstChromaU1,
+		                                      dstChromaU2, dstChromaV1, dstChromaV2, roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* srcEven = (pSrc + y * srcStep);
+		BYTE* dstLumaYEven = (pDst1[0] + y * dst1Step[0]);
+		BYTE* dstLumaU = (pDst1[1] + (y / 2) * dst1Step[1]);
+		BYTE* dstLumaV = (pDst1[2] + (y / 2) * dst1Step[2]);
+		BYTE* dstEvenChromaY1 = (pDst2[0] + y * dst2Step[0]);
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstChromaU1 = (pDst2[1] + (y / 2) * dst2Step[1]);
+		BYTE* dstChromaV1 = (pDst2[2] + (y / 2) * dst2Step[2]);
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		general_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(0, srcEven, nullptr, dstLumaYEven, nullptr,
+		                                         dstLumaU, dstLumaV, dstEvenChromaY1,
+		                                         dstEvenChromaY2, nullptr, nullptr, dstChromaU1,
+		                                         dstChromaU2, dstChromaV1, dstChromaV2, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_RGBToAVC444YUVv2(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                       UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                       const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                       const UINT32 dst2Step[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx2_RGBToAVC444YUVv2_BGRX(pSrc, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+			                                  roi);
+
+		default:
+			return generic->RGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                 dst2Step, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx2 AVC444 -> YUV444 combination                                        */
+/****************************************************************************/
+
+/* Only whole 16 (half width) or 8 (quarter width) source bytes that lie inside of the
+ * destination width take the vector paths, the remainder is copied byte wise. */
+
+static pstatus_t avx2_LumaToYUV444(const BYTE* WINPR_RESTRICT pSrcRaw[], const UINT32 srcStep[],
+                                   BYTE* WINPR_RESTRICT pDstRaw[], const UINT32 dstStep[],
+                                   const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + 1ULL * roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + 1ULL * roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + 1ULL * roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + 1ULL * roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + 1ULL * roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + 1ULL * roi->top * dstStep[2] + roi->left };
+
+	/* B1 */
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		const BYTE* Ym = pSrc[0] + y * srcStep[0];
+		BYTE* pY = pDst[0] + y * dstStep[0];
+		memcpy(pY, Ym, nWidth);
+	}
+
+	/* B2 and B3 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* Um = pSrc[1] + 1ULL * srcStep[1] * y;
+		const BYTE* Vm = pSrc[2] + 1ULL * srcStep[2] * y;
+		BYTE* pU = pDst[1] + 1ULL * dstStep[1] * 2 * y;
+		BYTE* pV = pDst[2] + 1ULL * dstStep[2] * 2 * y;
+		BYTE* pU1 = pU + dstStep[1];
+		BYTE* pV1 = pV + dstStep[2];
+
+		size_t x = 0;
+		for (; 2 * (x + 16) <= nWidth; x += 16)
+		{
+			const __m256i u = avx2_duplicate(&Um[x]);
+			const __m256i v = avx2_duplicate(&Vm[x]);
+			avx2_store(&pU[2 * x], u);
+			avx2_store(&pU1[2 * x], u);
+			avx2_store(&pV[2 * x], v);
+			avx2_store(&pV1[2 * x], v);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			pU[2 * x] = pU[2 * x + 1] = pU1[2 * x] = pU1[2 * x + 1] = Um[x];
+			pV[2 * x] = pV[2 * x + 1] = pV1[2 * x] = pV1[2 * x + 1] = Vm[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* Write 16 bytes to the odd bytes of 32 destination bytes */
+static inline void avx2_store_odd(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT src)
+{
+	const __m256i val = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src));
+	const __m256i even = _mm256_and_si256(avx2_load(dst), _mm256_set1_epi16(0x00FF));
+	avx2_store(dst, _mm256_or_si256(even, _mm256_slli_epi16(val, 8)));
+}
+
+static pstatus_t avx2_ChromaV1ToYUV444(const BYTE* WINPR_RESTRICT pSrcRaw[3],
+                                       const UINT32 srcStep[3], BYTE* WINPR_RESTRICT pDstRaw[3],
+                                       const UINT32 dstStep[3],
+                                       const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 mod = 16;
+	UINT32 uY = 0;
+	UINT32 vY = 0;
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	/* The auxiliary frame is aligned to multiples of 16x16.
+	 * We need the padded height for B4 and B5 conversion. */
+	const UINT32 padHeigth = nHeight + 16 - nHeight % 16;
+	const BYTE* pSrc[3] = { pSrcRaw[0] + 1ULL * roi->top * srcStep[0] + roi->left,
+		                    pSrcRaw[1] + 1ULL * roi->top / 2 * srcStep[1] + roi->left / 2,
+		                    pSrcRaw[2] + 1ULL * roi->top / 2 * srcStep[2] + roi->left / 2 };
+	BYTE* pDst[3] = { pDstRaw[0] + 1ULL * roi->top * dstStep[0] + roi->left,
+		              pDstRaw[1] + 1ULL * roi->top * dstStep[1] + roi->left,
+		              pDstRaw[2] + 1ULL * roi->top * dstStep[2] + roi->left };
+
+	/* B4 and B5 */
+	for (size_t y = 0; y < padHeigth; y++)
+	{
+		const BYTE* Ya = pSrc[0] + 1ULL * srcStep[0] * y;
+		BYTE* pX = nullptr;
+
+		if ((y) % mod < (mod + 1) / 2)
+		{
+			const UINT32 pos = (2 * uY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[1] + 1ULL * dstStep[1] * pos;
+		}
+		else
+		{
+			const UINT32 pos = (2 * vY++ + 1);
+
+			if (pos >= nHeight)
+				continue;
+
+			pX = pDst[2] + 1ULL * dstStep[2] * pos;
+		}
+
+		memcpy(pX, Ya, nWidth);
+	}
+
+	/* B6 and B7 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* Ua = pSrc[1] + srcStep[1] * y;
+		const BYTE* Va = pSrc[2] + srcStep[2] * y;
+		BYTE* pU = pDst[1] + dstStep[1] * 2 * y;
+		BYTE* pV = pDst[2] + dstStep[2] * 2 * y;
+
+		size_t x = 0;
+		for (; 2 * (x + 16) <= nWidth; x += 16)
+		{
+			avx2_store_odd(&pU[2 * x], &Ua[x]);
+			avx2_store_odd(&pV[2 * x], &Va[x]);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			pU[2 * x + 1] = Ua[x];
+			pV[2 * x + 1] = Va[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* Write 8 bytes of a and b to the bytes 4n and 4n + 2 of 32 destination bytes */
+static inline void avx2_store_quarter(BYTE* WINPR_RESTRICT dst, const BYTE* WINPR_RESTRICT a,
+                                      const BYTE* WINPR_RESTRICT b)
+{
+	const __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)a));
+	const __m256i vb = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)b));
+	const __m256i mask = _mm256_set1_epi32(WINPR_CXX_COMPAT_CAST(INT32, 0xFF00FF00));
+	const __m256i odd = _mm256_and_si256(avx2_load(dst), mask);
+	avx2_store(dst, _mm256_or_si256(odd, _mm256_or_si256(va, _mm256_slli_epi32(vb, 16))));
+}
+
+static pstatus_t avx2_ChromaV2ToYUV444(const BYTE* WINPR_RESTRICT pSrc[3], const UINT32 srcStep[3],
+                                       UINT32 nTotalWidth, WINPR_ATTR_UNUSED UINT32 nTotalHeight,
+                                       BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                       const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->right - roi->left;
+	const UINT32 nHeight = roi->bottom - roi->top;
+	const UINT32 halfWidth = (nWidth + 1) / 2;
+	const UINT32 halfHeight = (nHeight + 1) / 2;
+	const UINT32 quaterWidth = (nWidth + 3) / 4;
+
+	/* B4 and B5: odd UV values for width/2, height */
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		const size_t yTop = y + roi->top;
+		const BYTE* pYaU = pSrc[0] + srcStep[0] * yTop + roi->left / 2;
+		const BYTE* pYaV = pYaU + nTotalWidth / 2;
+		BYTE* pU = pDst[1] + 1ULL * dstStep[1] * yTop + roi->left;
+		BYTE* pV = pDst[2] + 1ULL * dstStep[2] * yTop + roi->left;
+
+		size_t x = 0;
+		for (; 2 * (x + 16) <= nWidth; x += 16)
+		{
+			avx2_store_odd(&pU[2 * x], &pYaU[x]);
+			avx2_store_odd(&pV[2 * x], &pYaV[x]);
+		}
+
+		for (; x < halfWidth; x++)
+		{
+			const size_t odd = 2ULL * x + 1;
+			pU[odd] = pYaU[x];
+			pV[odd] = pYaV[x];
+		}
+	}
+
+	/* B6 - B9 */
+	for (size_t y = 0; y < halfHeight; y++)
+	{
+		const BYTE* pUaU = pSrc[1] + srcStep[1] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pUaV = pUaU + nTotalWidth / 4;
+		const BYTE* pVaU = pSrc[2] + srcStep[2] * (y + roi->top / 2) + roi->left / 4;
+		const BYTE* pVaV = pVaU + nTotalWidth / 4;
+		BYTE* pU = pDst[1] + dstStep[1] * (2 * y + 1 + roi->top) + roi->left;
+		BYTE* pV = pDst[2] + dstStep[2] * (2 * y + 1 + roi->top) + roi->left;
+
+		size_t x = 0;
+		for (; 4 * (x + 8) <= nWidth; x += 8)
+		{
+			avx2_store_quarter(&pU[4 * x], &pUaU[x], &pVaU[x]);
+			avx2_store_quarter(&pV[4 * x], &pUaV[x], &pVaV[x]);
+		}
+
+		for (; x < quaterWidth; x++)
+		{
+			pU[4 * x + 0] = pUaU[x];
+			pV[4 * x + 0] = pUaV[x];
+			pU[4 * x + 2] = pVaU[x];
+			pV[4 * x + 2] = pVaV[x];
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_YUV420CombineToYUV444(avc444_frame_type type,
+                                            const BYTE* WINPR_RESTRICT pSrc[3],
+                                            const UINT32 srcStep[3], UINT32 nWidth, UINT32 nHeight,
+                                            BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                            const RECTANGLE_16* WINPR_RESTRICT roi)
+{
+	if (!pSrc || !pSrc[0] || !pSrc[1] || !pSrc[2])
+		return -1;
+
+	if (!pDst || !pDst[0] || !pDst[1] || !pDst[2])
+		return -1;
+
+	if (!roi)
+		return -1;
+
+	switch (type)
+	{
+		case AVC444_LUMA:
+			return avx2_LumaToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv1:
+			return avx2_ChromaV1ToYUV444(pSrc, srcStep, pDst, dstStep, roi);
+
+		case AVC444_CHROMAv2:
+			return avx2_ChromaV2ToYUV444(pSrc, srcStep, nWidth, nHeight, pDst, dstStep, roi);
+
+		default:
+			return -1;
+	}
+}
+#endif
+
+void primitives_init_YUV_avx2_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+
+	WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+	prims->RGBToYUV420_8u_P3AC4R = avx2_RGBToYUV420;
+	prims->RGBToYUV444_8u_P3AC4R = avx2_RGBToYUV444;
+	prims->RGBToAVC444YUV = avx2_RGBToAVC444YUV;
+	prims->RGBToAVC444YUVv2 = avx2_RGBToAVC444YUVv2;
+	prims->YUV420ToRGB_8u_P3AC4R = avx2_YUV420ToRGB;
+	prims->YUV444ToRGB_8u_P3AC4R = avx2_YUV444ToRGB_8u_P3AC4R;
+	prims->YUV420CombineToYUV444 = avx2_YUV420CombineToYUV444;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or avx2 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
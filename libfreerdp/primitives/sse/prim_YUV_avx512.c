@@ -0,0 +1,950 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Optimized YUV/RGB conversion operations using AVX-512BW
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/wtypes.h>
+#include <freerdp/config.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/crt.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_avxsse.h"
+#include "prim_YUV.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static primitives_t* generic = nullptr;
+
+/* Same arithmetic as prim_YUV_avx2.c on 64 pixels per step. The AVC444 combination is
+ * a memory bound byte shuffle, it stays with the AVX2 version. */
+
+static inline __m512i avx512_load(const void* WINPR_RESTRICT ptr)
+{
+	return _mm512_loadu_si512(ptr);
+}
+
+static inline void avx512_store(void* WINPR_RESTRICT ptr, __m512i val)
+{
+	_mm512_storeu_si512(ptr, val);
+}
+
+static inline void avx512_store256(void* WINPR_RESTRICT ptr, __m256i val)
+{
+	_mm256_storeu_si256((__m256i*)ptr, val);
+}
+
+/* A pair of 16 bit factors for _mm512_madd_epi16, lo applies to the even word */
+static inline __m512i avx512_factors(INT16 lo, INT16 hi)
+{
+	const UINT32 val = ((UINT32)(UINT16)hi << 16) | (UINT16)lo;
+	return _mm512_set1_epi32(WINPR_CXX_COMPAT_CAST(INT32, val));
+}
+
+/* 4x 16 dwords (values 0 - 255) to 64 bytes */
+static inline __m512i avx512_pack_dwords(__m512i a, __m512i b, __m512i c, __m512i d)
+{
+	const __m512i ab = _mm512_packs_epi32(a, b);
+	const __m512i cd = _mm512_packs_epi32(c, d);
+	const __m512i packed = _mm512_packus_epi16(ab, cd);
+	const __m512i index =
+	    _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	return _mm512_permutexvar_epi32(index, packed);
+}
+
+/* 32 bytes [a b c ...] to 64 bytes [a a b b c c ...] */
+static inline __m512i avx512_duplicate(const BYTE* WINPR_RESTRICT data)
+{
+	const __m512i val = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)data));
+	return _mm512_or_si512(val, _mm512_slli_epi16(val, 8));
+}
+
+/****************************************************************************/
+/* avx512 YUV -> RGB conversion                                             */
+/****************************************************************************/
+
+/* Y, D = U - 128 and E = V - 128 as 16 bit values, 256 * Y >> 8 is Y */
+static inline __m512i avx512_yuv2r(__m512i Y, __m512i E)
+{
+	const __m512i r = _mm512_mulhi_epi16(_mm512_slli_epi16(E, 8), _mm512_set1_epi16(403));
+	return _mm512_add_epi16(Y, r);
+}
+
+static inline __m512i avx512_yuv2g(__m512i Y, __m512i D, __m512i E)
+{
+	const __m512i gd = _mm512_mullo_epi16(D, _mm512_set1_epi16(-48));
+	const __m512i ge = _mm512_mullo_epi16(E, _mm512_set1_epi16(-120));
+	return _mm512_add_epi16(Y, _mm512_srai_epi16(_mm512_add_epi16(gd, ge), 8));
+}
+
+static inline __m512i avx512_yuv2b(__m512i Y, __m512i D)
+{
+	const __m512i b = _mm512_mulhi_epi16(_mm512_slli_epi16(D, 8), _mm512_set1_epi16(475));
+	return _mm512_add_epi16(Y, b);
+}
+
+/* Convert 64 pixels to BGRX, the X byte of the destination is preserved */
+static inline void avx512_YUV444ToBGRX_64(BYTE* WINPR_RESTRICT pDst, __m512i Y, __m512i U,
+                                          __m512i V)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i c128 = _mm512_set1_epi16(128);
+	const __m512i Ylo = _mm512_unpacklo_epi8(Y, zero);
+	const __m512i Yhi = _mm512_unpackhi_epi8(Y, zero);
+	const __m512i Dlo = _mm512_sub_epi16(_mm512_unpacklo_epi8(U, zero), c128);
+	const __m512i Dhi = _mm512_sub_epi16(_mm512_unpackhi_epi8(U, zero), c128);
+	const __m512i Elo = _mm512_sub_epi16(_mm512_unpacklo_epi8(V, zero), c128);
+	const __m512i Ehi = _mm512_sub_epi16(_mm512_unpackhi_epi8(V, zero), c128);
+
+	const __m512i R = _mm512_packus_epi16(avx512_yuv2r(Ylo, Elo), avx512_yuv2r(Yhi, Ehi));
+	const __m512i G =
+	    _mm512_packus_epi16(avx512_yuv2g(Ylo, Dlo, Elo), avx512_yuv2g(Yhi, Dhi, Ehi));
+	const __m512i B = _mm512_packus_epi16(avx512_yuv2b(Ylo, Dlo), avx512_yuv2b(Yhi, Dhi));
+
+	const __m512i bglo = _mm512_unpacklo_epi8(B, G);
+	const __m512i bghi = _mm512_unpackhi_epi8(B, G);
+	const __m512i r0lo = _mm512_unpacklo_epi8(R, zero);
+	const __m512i r0hi = _mm512_unpackhi_epi8(R, zero);
+
+	/* lane n of p0 - p3 holds the pixels 16n + [0-3], [4-7], [8-11] and [12-15] */
+	const __m512i p0 = _mm512_unpacklo_epi16(bglo, r0lo);
+	const __m512i p1 = _mm512_unpackhi_epi16(bglo, r0lo);
+	const __m512i p2 = _mm512_unpacklo_epi16(bghi, r0hi);
+	const __m512i p3 = _mm512_unpackhi_epi16(bghi, r0hi);
+
+	/* transpose the 4x4 lanes */
+	const __m512i t0 = _mm512_shuffle_i64x2(p0, p1, 0x44);
+	const __m512i t1 = _mm512_shuffle_i64x2(p0, p1, 0xEE);
+	const __m512i t2 = _mm512_shuffle_i64x2(p2, p3, 0x44);
+	const __m512i t3 = _mm512_shuffle_i64x2(p2, p3, 0xEE);
+	const __m512i bgrx[] = { _mm512_shuffle_i64x2(t0, t2, 0x88),
+		                     _mm512_shuffle_i64x2(t0, t2, 0xDD),
+		                     _mm512_shuffle_i64x2(t1, t3, 0x88),
+		                     _mm512_shuffle_i64x2(t1, t3, 0xDD) };
+	const __mmask64 bgr = 0x7777777777777777ULL;
+
+	for (size_t x = 0; x < ARRAYSIZE(bgrx); x++)
+		_mm512_mask_storeu_epi8(&pDst[x * sizeof(__m512i)], bgr, bgrx[x]);
+}
+
+static inline pstatus_t avx512_YUV420ToRGB_BGRX(const BYTE* WINPR_RESTRICT pSrc[],
+                                                const UINT32* WINPR_RESTRICT srcStep,
+                                                BYTE* WINPR_RESTRICT pDst, UINT32 dstStep,
+                                                const prim_size_t* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+	const UINT32 pad = roi->width % 64;
+
+	for (size_t y = 0; y < nHeight; y++)
+	{
+		BYTE* dst = pDst + dstStep * y;
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + (y / 2) * srcStep[1];
+		const BYTE* VData = pSrc[2] + (y / 2) * srcStep[2];
+
+		size_t x = 0;
+		for (; x < nWidth - pad; x += 64)
+		{
+			const __m512i Y = avx512_load(&YData[x]);
+			const __m512i U = avx512_duplicate(&UData[x / 2]);
+			const __m512i V = avx512_duplicate(&VData[x / 2]);
+			avx512_YUV444ToBGRX_64(&dst[4 * x], Y, U, V);
+		}
+
+		for (; x < nWidth; x++)
+		{
+			(void)writeYUVPixel(&dst[4 * x], PIXEL_FORMAT_BGRX32, YData[x], UData[x / 2],
+			                    VData[x / 2], writePixelBGRX);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_YUV420ToRGB(const BYTE* WINPR_RESTRICT pSrc[3], const UINT32 srcStep[3],
+                                    BYTE* WINPR_RESTRICT pDst, UINT32 dstStep, UINT32 DstFormat,
+                                    const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_YUV420ToRGB_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->YUV420ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/* Clip value and keep the original byte if the result is close to it, like CONDITIONAL_CLIP.
+ * original holds the even bytes of row, the odd bytes of row are passed through. */
+static inline __m512i avx512_conditional_clip(__m512i row, __m512i original, __m512i value)
+{
+	const __m512i mask = _mm512_set1_epi16(0x00FF);
+	const __m512i clipped =
+	    _mm512_min_epi16(_mm512_max_epi16(value, _mm512_setzero_si512()), mask);
+	const __m512i diff = _mm512_abs_epi16(_mm512_sub_epi16(clipped, original));
+	const __mmask32 keep = _mm512_cmpgt_epi16_mask(_mm512_set1_epi16(30), diff);
+	const __m512i filtered = _mm512_mask_blend_epi16(keep, clipped, original);
+	return _mm512_or_si512(_mm512_andnot_si512(mask, row), filtered);
+}
+
+/* The decoder side chroma filter of the top left value of each 2x2 block */
+static inline __m512i avx512_filter(__m512i row0, __m512i row1)
+{
+	const __m512i mask = _mm512_set1_epi16(0x00FF);
+	const __m512i e0 = _mm512_and_si512(row0, mask);
+	const __m512i o0 = _mm512_srli_epi16(row0, 8);
+	const __m512i e1 = _mm512_and_si512(row1, mask);
+	const __m512i o1 = _mm512_srli_epi16(row1, 8);
+	const __m512i sum = _mm512_add_epi16(o0, _mm512_add_epi16(e1, o1));
+	const __m512i avg = _mm512_sub_epi16(_mm512_slli_epi16(e0, 2), sum);
+	return avx512_conditional_clip(row0, e0, avg);
+}
+
+static inline void BGRX_fillRGB(size_t offset, BYTE* WINPR_RESTRICT pRGB[2],
+                                const BYTE* WINPR_RESTRICT pY[2], const BYTE* WINPR_RESTRICT pU[2],
+                                const BYTE* WINPR_RESTRICT pV[2])
+{
+	WINPR_ASSERT(pRGB);
+	WINPR_ASSERT(pY);
+	WINPR_ASSERT(pU);
+	WINPR_ASSERT(pV);
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		for (size_t j = 0; j < 2; j++)
+		{
+			const BYTE Y = pY[i][offset + j];
+			BYTE U = pU[i][offset + j];
+			BYTE V = pV[i][offset + j];
+			if ((i == 0) && (j == 0))
+			{
+				const INT32 avgU =
+				    4 * pU[0][offset] - pU[0][offset + 1] - pU[1][offset] - pU[1][offset + 1];
+				const INT32 avgV =
+				    4 * pV[0][offset] - pV[0][offset + 1] - pV[1][offset] - pV[1][offset + 1];
+
+				U = CONDITIONAL_CLIP(avgU, pU[0][offset]);
+				V = CONDITIONAL_CLIP(avgV, pV[0][offset]);
+			}
+
+			(void)writeYUVPixel(&pRGB[i][(j + offset) * 4], PIXEL_FORMAT_BGRX32, Y, U, V,
+			                    writePixelBGRX);
+		}
+	}
+}
+
+static inline void avx512_YUV444ToRGB_BGRX_DOUBLE_ROW(BYTE* WINPR_RESTRICT pDst[2],
+                                                      const BYTE* WINPR_RESTRICT YData[2],
+                                                      const BYTE* WINPR_RESTRICT UData[2],
+                                                      const BYTE* WINPR_RESTRICT VData[2],
+                                                      UINT32 nWidth)
+{
+	WINPR_ASSERT((nWidth % 2) == 0);
+	const UINT32 pad = nWidth % 64;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 64)
+	{
+		const __m512i U1 = avx512_load(&UData[1][x]);
+		const __m512i V1 = avx512_load(&VData[1][x]);
+		const __m512i U0 = avx512_filter(avx512_load(&UData[0][x]), U1);
+		const __m512i V0 = avx512_filter(avx512_load(&VData[0][x]), V1);
+
+		avx512_YUV444ToBGRX_64(&pDst[0][4 * x], avx512_load(&YData[0][x]), U0, V0);
+		avx512_YUV444ToBGRX_64(&pDst[1][4 * x], avx512_load(&YData[1][x]), U1, V1);
+	}
+
+	for (; x < nWidth; x += 2)
+	{
+		BGRX_fillRGB(x, pDst, YData, UData, VData);
+	}
+}
+
+static inline void avx512_YUV444ToRGB_BGRX_SINGLE_ROW(BYTE* WINPR_RESTRICT pDst,
+                                                      const BYTE* WINPR_RESTRICT YData,
+                                                      const BYTE* WINPR_RESTRICT UData,
+                                                      const BYTE* WINPR_RESTRICT VData,
+                                                      UINT32 nWidth)
+{
+	const UINT32 pad = nWidth % 64;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 64)
+	{
+		avx512_YUV444ToBGRX_64(&pDst[4 * x], avx512_load(&YData[x]), avx512_load(&UData[x]),
+		                       avx512_load(&VData[x]));
+	}
+
+	for (; x < nWidth; x++)
+	{
+		(void)writeYUVPixel(&pDst[4 * x], PIXEL_FORMAT_BGRX32, YData[x], UData[x], VData[x],
+		                    writePixelBGRX);
+	}
+}
+
+static inline pstatus_t avx512_YUV444ToRGB_8u_P3AC4R_BGRX(const BYTE* WINPR_RESTRICT pSrc[],
+                                                          const UINT32 srcStep[],
+                                                          BYTE* WINPR_RESTRICT pDst,
+                                                          UINT32 dstStep,
+                                                          const prim_size_t* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+
+	size_t y = 0;
+	for (; y < nHeight - nHeight % 2; y += 2)
+	{
+		BYTE* dst[] = { (pDst + dstStep * y), (pDst + dstStep * (y + 1)) };
+		const BYTE* YData[] = { pSrc[0] + y * srcStep[0], pSrc[0] + (y + 1) * srcStep[0] };
+		const BYTE* UData[] = { pSrc[1] + y * srcStep[1], pSrc[1] + (y + 1) * srcStep[1] };
+		const BYTE* VData[] = { pSrc[2] + y * srcStep[2], pSrc[2] + (y + 1) * srcStep[2] };
+
+		avx512_YUV444ToRGB_BGRX_DOUBLE_ROW(dst, YData, UData, VData, nWidth);
+	}
+
+	for (; y < nHeight; y++)
+	{
+		BYTE* dst = (pDst + dstStep * y);
+		const BYTE* YData = pSrc[0] + y * srcStep[0];
+		const BYTE* UData = pSrc[1] + y * srcStep[1];
+		const BYTE* VData = pSrc[2] + y * srcStep[2];
+
+		avx512_YUV444ToRGB_BGRX_SINGLE_ROW(dst, YData, UData, VData, nWidth);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_YUV444ToRGB_8u_P3AC4R(const BYTE* WINPR_RESTRICT pSrc[],
+                                              const UINT32 srcStep[], BYTE* WINPR_RESTRICT pDst,
+                                              UINT32 dstStep, UINT32 DstFormat,
+                                              const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (DstFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_YUV444ToRGB_8u_P3AC4R_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->YUV444ToRGB_8u_P3AC4R(pSrc, srcStep, pDst, dstStep, DstFormat, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx512 RGB -> YUV conversion                                             */
+/****************************************************************************/
+
+/* 16 BGRX pixels to 16 dwords of Y, U or V.
+ * br holds the (B, R) and gx the (G, X) words of each pixel. */
+static inline __m512i avx512_BGRXToY_16(__m512i br, __m512i gx)
+{
+	const __m512i y = _mm512_add_epi32(_mm512_madd_epi16(br, avx512_factors(18, 54)),
+	                                   _mm512_madd_epi16(gx, avx512_factors(183, 0)));
+	return _mm512_srli_epi32(y, 8);
+}
+
+static inline __m512i avx512_BGRXToU_16(__m512i br, __m512i gx)
+{
+	const __m512i u = _mm512_add_epi32(_mm512_madd_epi16(br, avx512_factors(128, -29)),
+	                                   _mm512_madd_epi16(gx, avx512_factors(-99, 0)));
+	return _mm512_add_epi32(_mm512_srai_epi32(u, 8), _mm512_set1_epi32(128));
+}
+
+static inline __m512i avx512_BGRXToV_16(__m512i br, __m512i gx)
+{
+	const __m512i v = _mm512_add_epi32(_mm512_madd_epi16(br, avx512_factors(-12, 128)),
+	                                   _mm512_madd_epi16(gx, avx512_factors(-116, 0)));
+	return _mm512_add_epi32(_mm512_srai_epi32(v, 8), _mm512_set1_epi32(128));
+}
+
+static inline __m512i avx512_BGRX_br(__m512i bgrx)
+{
+	return _mm512_and_si512(bgrx, _mm512_set1_epi16(0x00FF));
+}
+
+static inline __m512i avx512_BGRX_gx(__m512i bgrx)
+{
+	return _mm512_srli_epi16(bgrx, 8);
+}
+
+static inline __m512i avx512_BGRXToY_64(const BYTE* WINPR_RESTRICT src)
+{
+	__m512i y[4] = WINPR_C_ARRAY_INIT;
+	for (size_t x = 0; x < ARRAYSIZE(y); x++)
+	{
+		const __m512i bgrx = avx512_load(&src[x * sizeof(__m512i)]);
+		y[x] = avx512_BGRXToY_16(avx512_BGRX_br(bgrx), avx512_BGRX_gx(bgrx));
+	}
+	return avx512_pack_dwords(y[0], y[1], y[2], y[3]);
+}
+
+static inline void avx512_BGRXToYUV_64(const BYTE* WINPR_RESTRICT src, __m512i* WINPR_RESTRICT Y,
+                                       __m512i* WINPR_RESTRICT U, __m512i* WINPR_RESTRICT V)
+{
+	__m512i y[4] = WINPR_C_ARRAY_INIT;
+	__m512i u[4] = WINPR_C_ARRAY_INIT;
+	__m512i v[4] = WINPR_C_ARRAY_INIT;
+	for (size_t x = 0; x < ARRAYSIZE(y); x++)
+	{
+		const __m512i bgrx = avx512_load(&src[x * sizeof(__m512i)]);
+		const __m512i br = avx512_BGRX_br(bgrx);
+		const __m512i gx = avx512_BGRX_gx(bgrx);
+		y[x] = avx512_BGRXToY_16(br, gx);
+		u[x] = avx512_BGRXToU_16(br, gx);
+		v[x] = avx512_BGRXToV_16(br, gx);
+	}
+	*Y = avx512_pack_dwords(y[0], y[1], y[2], y[3]);
+	*U = avx512_pack_dwords(u[0], u[1], u[2], u[3]);
+	*V = avx512_pack_dwords(v[0], v[1], v[2], v[3]);
+}
+
+/* (a + b + c + d) / 4 of each 2x2 block of 64 byte wide rows */
+static inline __m256i avx512_average_2x2(__m512i row0, __m512i row1)
+{
+	const __m512i mask = _mm512_set1_epi16(0x00FF);
+	const __m512i sum0 =
+	    _mm512_add_epi16(_mm512_and_si512(row0, mask), _mm512_srli_epi16(row0, 8));
+	const __m512i sum1 =
+	    _mm512_add_epi16(_mm512_and_si512(row1, mask), _mm512_srli_epi16(row1, 8));
+	return _mm512_cvtepi16_epi8(_mm512_srli_epi16(_mm512_add_epi16(sum0, sum1), 2));
+}
+
+static inline __m256i avx512_odd_bytes(__m512i val)
+{
+	return _mm512_cvtepi16_epi8(_mm512_srli_epi16(val, 8));
+}
+
+static inline void BGRX_fillYUV(size_t offset, const BYTE* WINPR_RESTRICT pRGB[2],
+                                BYTE* WINPR_RESTRICT pY[2], BYTE* WINPR_RESTRICT pU[2],
+                                BYTE* WINPR_RESTRICT pV[2])
+{
+	WINPR_ASSERT(pRGB);
+	WINPR_ASSERT(pY);
+	WINPR_ASSERT(pU);
+	WINPR_ASSERT(pV);
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		for (size_t j = 0; j < 2; j++)
+		{
+			const BYTE* src = &pRGB[i][(offset + j) * 4];
+			const BYTE B = src[0];
+			const BYTE G = src[1];
+			const BYTE R = src[2];
+			pY[i][offset + j] = RGB2Y(R, G, B);
+			pU[i][offset + j] = RGB2U(R, G, B);
+			pV[i][offset + j] = RGB2V(R, G, B);
+		}
+	}
+
+	/* Apply chroma filter */
+	const INT32 avgU = (pU[0][offset] + pU[0][offset + 1] + pU[1][offset] + pU[1][offset + 1]) / 4;
+	pU[0][offset] = CONDITIONAL_CLIP(avgU, pU[0][offset]);
+	const INT32 avgV = (pV[0][offset] + pV[0][offset + 1] + pV[1][offset] + pV[1][offset + 1]) / 4;
+	pV[0][offset] = CONDITIONAL_CLIP(avgV, pV[0][offset]);
+}
+
+/* The encoder side chroma filter of the top left value of each 2x2 block */
+static inline __m512i avx512_average_filter(__m512i row0, __m512i row1)
+{
+	const __m512i mask = _mm512_set1_epi16(0x00FF);
+	const __m512i e0 = _mm512_and_si512(row0, mask);
+	const __m512i sum0 = _mm512_add_epi16(e0, _mm512_srli_epi16(row0, 8));
+	const __m512i sum1 =
+	    _mm512_add_epi16(_mm512_and_si512(row1, mask), _mm512_srli_epi16(row1, 8));
+	const __m512i avg = _mm512_srli_epi16(_mm512_add_epi16(sum0, sum1), 2);
+	return avx512_conditional_clip(row0, e0, avg);
+}
+
+static inline void avx512_RGBToYUV444_BGRX_DOUBLE_ROW(const BYTE* WINPR_RESTRICT pRGB[2],
+                                                      BYTE* WINPR_RESTRICT pY[2],
+                                                      BYTE* WINPR_RESTRICT pU[2],
+                                                      BYTE* WINPR_RESTRICT pV[2], UINT32 nWidth)
+{
+	WINPR_ASSERT((nWidth % 2) == 0);
+	const UINT32 pad = nWidth % 64;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 64)
+	{
+		__m512i Y[2] = WINPR_C_ARRAY_INIT;
+		__m512i U[2] = WINPR_C_ARRAY_INIT;
+		__m512i V[2] = WINPR_C_ARRAY_INIT;
+		avx512_BGRXToYUV_64(&pRGB[0][4 * x], &Y[0], &U[0], &V[0]);
+		avx512_BGRXToYUV_64(&pRGB[1][4 * x], &Y[1], &U[1], &V[1]);
+
+		avx512_store(&pY[0][x], Y[0]);
+		avx512_store(&pY[1][x], Y[1]);
+		avx512_store(&pU[0][x], avx512_average_filter(U[0], U[1]));
+		avx512_store(&pU[1][x], U[1]);
+		avx512_store(&pV[0][x], avx512_average_filter(V[0], V[1]));
+		avx512_store(&pV[1][x], V[1]);
+	}
+
+	for (; x < nWidth; x += 2)
+	{
+		BGRX_fillYUV(x, pRGB, pY, pU, pV);
+	}
+}
+
+static inline void avx512_RGBToYUV444_BGRX_SINGLE_ROW(const BYTE* WINPR_RESTRICT pRGB,
+                                                      BYTE* WINPR_RESTRICT pY,
+                                                      BYTE* WINPR_RESTRICT pU,
+                                                      BYTE* WINPR_RESTRICT pV, UINT32 nWidth)
+{
+	const UINT32 pad = nWidth % 64;
+
+	size_t x = 0;
+	for (; x < nWidth - pad; x += 64)
+	{
+		__m512i Y = _mm512_setzero_si512();
+		__m512i U = _mm512_setzero_si512();
+		__m512i V = _mm512_setzero_si512();
+		avx512_BGRXToYUV_64(&pRGB[4 * x], &Y, &U, &V);
+		avx512_store(&pY[x], Y);
+		avx512_store(&pU[x], U);
+		avx512_store(&pV[x], V);
+	}
+
+	for (; x < nWidth; x++)
+	{
+		const BYTE* src = &pRGB[4 * x];
+		pY[x] = RGB2Y(src[2], src[1], src[0]);
+		pU[x] = RGB2U(src[2], src[1], src[0]);
+		pV[x] = RGB2V(src[2], src[1], src[0]);
+	}
+}
+
+static pstatus_t avx512_RGBToYUV444_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                         BYTE* WINPR_RESTRICT pDst[3], const UINT32 dstStep[3],
+                                         const prim_size_t* WINPR_RESTRICT roi)
+{
+	const UINT32 nWidth = roi->width;
+	const UINT32 nHeight = roi->height;
+
+	size_t y = 0;
+	for (; y < nHeight - nHeight % 2; y += 2)
+	{
+		const BYTE* pRGB[] = { pSrc + y * srcStep, pSrc + (y + 1) * srcStep };
+		BYTE* pY[] = { pDst[0] + y * dstStep[0], pDst[0] + (y + 1) * dstStep[0] };
+		BYTE* pU[] = { pDst[1] + y * dstStep[1], pDst[1] + (y + 1) * dstStep[1] };
+		BYTE* pV[] = { pDst[2] + y * dstStep[2], pDst[2] + (y + 1) * dstStep[2] };
+
+		avx512_RGBToYUV444_BGRX_DOUBLE_ROW(pRGB, pY, pU, pV, nWidth);
+	}
+
+	for (; y < nHeight; y++)
+	{
+		const BYTE* pRGB = pSrc + y * srcStep;
+		BYTE* pY = pDst[0] + y * dstStep[0];
+		BYTE* pU = pDst[1] + y * dstStep[1];
+		BYTE* pV = pDst[2] + y * dstStep[2];
+
+		avx512_RGBToYUV444_BGRX_SINGLE_ROW(pRGB, pY, pU, pV, nWidth);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_RGBToYUV444(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                    UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[3],
+                                    const UINT32 dstStep[3], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_RGBToYUV444_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV444_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/* The 2x2 average of 16 BGRX pixels of two rows as 8 BGRX pixels */
+static inline __m256i avx512_BGRX_average(__m512i row0, __m512i row1)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i lo =
+	    _mm512_add_epi16(_mm512_unpacklo_epi8(row0, zero), _mm512_unpacklo_epi8(row1, zero));
+	const __m512i hi =
+	    _mm512_add_epi16(_mm512_unpackhi_epi8(row0, zero), _mm512_unpackhi_epi8(row1, zero));
+	const __m512i sumlo = _mm512_add_epi16(lo, _mm512_bsrli_epi128(lo, 8));
+	const __m512i sumhi = _mm512_add_epi16(hi, _mm512_bsrli_epi128(hi, 8));
+	return _mm512_cvtepi16_epi8(_mm512_srli_epi16(_mm512_unpacklo_epi64(sumlo, sumhi), 2));
+}
+
+static inline void avx512_RGBToYUV420_BGRX_DOUBLE_ROW(const BYTE* WINPR_RESTRICT src0,
+                                                      const BYTE* WINPR_RESTRICT src1,
+                                                      BYTE* WINPR_RESTRICT ydst0,
+                                                      BYTE* WINPR_RESTRICT ydst1,
+                                                      BYTE* WINPR_RESTRICT udst,
+                                                      BYTE* WINPR_RESTRICT vdst, UINT32 width)
+{
+	size_t x = 0;
+	for (; x < width - width % 64; x += 64)
+	{
+		for (size_t i = 0; i < 2; i++)
+		{
+			const size_t offset = 4 * x + i * 2 * sizeof(__m512i);
+			const __m256i avg0 = avx512_BGRX_average(avx512_load(&src0[offset]),
+			                                         avx512_load(&src1[offset]));
+			const __m256i avg1 =
+			    avx512_BGRX_average(avx512_load(&src0[offset + sizeof(__m512i)]),
+			                        avx512_load(&src1[offset + sizeof(__m512i)]));
+			const __m512i bgrx = _mm512_inserti64x4(_mm512_castsi256_si512(avg0), avg1, 1);
+			const __m512i br = avx512_BGRX_br(bgrx);
+			const __m512i gx = avx512_BGRX_gx(bgrx);
+
+			_mm_storeu_si128((__m128i*)&udst[x / 2 + 16 * i],
+			                 _mm512_cvtepi32_epi8(avx512_BGRXToU_16(br, gx)));
+			_mm_storeu_si128((__m128i*)&vdst[x / 2 + 16 * i],
+			                 _mm512_cvtepi32_epi8(avx512_BGRXToV_16(br, gx)));
+		}
+
+		avx512_store(&ydst0[x], avx512_BGRXToY_64(&src0[4 * x]));
+		avx512_store(&ydst1[x], avx512_BGRXToY_64(&src1[4 * x]));
+	}
+
+	for (; x < width; x += 2)
+	{
+		const BYTE* p[] = { &src0[4 * x], &src0[4 * x + 4], &src1[4 * x], &src1[4 * x + 4] };
+		const size_t count = (x + 1 < width) ? 4 : 2;
+		INT32 B = 0;
+		INT32 G = 0;
+		INT32 R = 0;
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			if ((count == 2) && (i % 2))
+				continue;
+			BYTE* ydst = (i < 2) ? ydst0 : ydst1;
+			ydst[x + i % 2] = RGB2Y(p[i][2], p[i][1], p[i][0]);
+			B += p[i][0];
+			G += p[i][1];
+			R += p[i][2];
+		}
+
+		udst[x / 2] = RGB2U(R >> 2, G >> 2, B >> 2);
+		vdst[x / 2] = RGB2V(R >> 2, G >> 2, B >> 2);
+	}
+}
+
+static pstatus_t avx512_RGBToYUV420_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                         BYTE* WINPR_RESTRICT pDst[], const UINT32 dstStep[],
+                                         const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* line1 = &pSrc[y * srcStep];
+		const BYTE* line2 = &pSrc[(1ULL + y) * srcStep];
+		BYTE* ydst1 = &pDst[0][y * dstStep[0]];
+		BYTE* ydst2 = &pDst[0][(1ULL + y) * dstStep[0]];
+		BYTE* udst = &pDst[1][y / 2 * dstStep[1]];
+		BYTE* vdst = &pDst[2][y / 2 * dstStep[2]];
+
+		avx512_RGBToYUV420_BGRX_DOUBLE_ROW(line1, line2, ydst1, ydst2, udst, vdst, roi->width);
+	}
+
+	if (y < roi->height)
+	{
+		/* The last odd line is converted by the generic code, it uses the averages of only
+		 * two pixels for the chroma values. */
+		const BYTE* line = &pSrc[y * srcStep];
+		BYTE* dst[] = { &pDst[0][y * dstStep[0]], &pDst[1][y / 2 * dstStep[1]],
+			            &pDst[2][y / 2 * dstStep[2]] };
+		const prim_size_t row = { .width = roi->width, .height = 1 };
+		return generic->RGBToYUV420_8u_P3AC4R(line, PIXEL_FORMAT_BGRX32, srcStep, dst, dstStep,
+		                                      &row);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_RGBToYUV420(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                    UINT32 srcStep, BYTE* WINPR_RESTRICT pDst[],
+                                    const UINT32 dstStep[], const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_RGBToYUV420_BGRX(pSrc, srcStep, pDst, dstStep, roi);
+
+		default:
+			return generic->RGBToYUV420_8u_P3AC4R(pSrc, srcFormat, srcStep, pDst, dstStep, roi);
+	}
+}
+
+/****************************************************************************/
+/* avx512 RGB -> AVC444-YUV conversion                                      */
+/****************************************************************************/
+
+static inline void avx512_RGBToAVC444YUV_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT b1Even, BYTE* WINPR_RESTRICT b1Odd, BYTE* WINPR_RESTRICT b2,
+    BYTE* WINPR_RESTRICT b3, BYTE* WINPR_RESTRICT b4, BYTE* WINPR_RESTRICT b5,
+    BYTE* WINPR_RESTRICT b6, BYTE* WINPR_RESTRICT b7, UINT32 width)
+{
+	size_t x = 0;
+	for (; x < width - width % 64; x += 64)
+	{
+		__m512i Ye = _mm512_setzero_si512();
+		__m512i Ue = _mm512_setzero_si512();
+		__m512i Ve = _mm512_setzero_si512();
+		__m512i Yo = _mm512_setzero_si512();
+		__m512i Uo = _mm512_setzero_si512();
+		__m512i Vo = _mm512_setzero_si512();
+		avx512_BGRXToYUV_64(&srcEven[4 * x], &Ye, &Ue, &Ve);
+		avx512_BGRXToYUV_64(&srcOdd[4 * x], &Yo, &Uo, &Vo);
+
+		/* Y [b1] */
+		avx512_store(&b1Even[x], Ye);
+		avx512_store(&b1Odd[x], Yo);
+
+		/* 2x 2y [b2, b3] */
+		avx512_store256(&b2[x / 2], avx512_average_2x2(Ue, Uo));
+		avx512_store256(&b3[x / 2], avx512_average_2x2(Ve, Vo));
+
+		/* x, 2y + 1 [b4, b5] */
+		avx512_store(&b4[x], Uo);
+		avx512_store(&b5[x], Vo);
+
+		/* 2x + 1, 2y [b6, b7] */
+		avx512_store256(&b6[x / 2], avx512_odd_bytes(Ue));
+		avx512_store256(&b7[x / 2], avx512_odd_bytes(Ve));
+	}
+
+	general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(x, srcEven, srcOdd, &b1Even[x], &b1Odd[x], &b2[x / 2],
+	                                       &b3[x / 2], &b4[x], &b5[x], &b6[x / 2], &b7[x / 2],
+	                                       width);
+}
+
+static pstatus_t avx512_RGBToAVC444YUV_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                            BYTE* WINPR_RESTRICT pDst1[], const UINT32 dst1Step[],
+                                            BYTE* WINPR_RESTRICT pDst2[], const UINT32 dst2Step[],
+                                            const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		const BYTE* srcOdd = pSrc + (y + 1) * srcStep;
+		const size_t i = y >> 1;
+		const size_t n = (i & (size_t)~7) + i;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b1Odd = (b1Even + dst1Step[0]);
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b4 = pDst2[0] + 1ULL * dst2Step[0] * n;
+		BYTE* b5 = b4 + 8ULL * dst2Step[0];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		avx512_RGBToAVC444YUV_BGRX_DOUBLE_ROW(srcEven, srcOdd, b1Even, b1Odd, b2, b3, b4, b5, b6,
+		                                      b7, roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* srcEven = pSrc + y * srcStep;
+		BYTE* b1Even = pDst1[0] + y * dst1Step[0];
+		BYTE* b2 = pDst1[1] + (y / 2) * dst1Step[1];
+		BYTE* b3 = pDst1[2] + (y / 2) * dst1Step[2];
+		BYTE* b6 = pDst2[1] + (y / 2) * dst2Step[1];
+		BYTE* b7 = pDst2[2] + (y / 2) * dst2Step[2];
+		general_RGBToAVC444YUV_BGRX_DOUBLE_ROW(0, srcEven, nullptr, b1Even, nullptr, b2, b3,
+		                                       nullptr, nullptr, b6, b7, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_RGBToAVC444YUV(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                       UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                       const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                       const UINT32 dst2Step[],
+                                       const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_RGBToAVC444YUV_BGRX(pSrc, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+			                                  roi);
+
+		default:
+			return generic->RGBToAVC444YUV(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                               dst2Step, roi);
+	}
+}
+
+/* see sse41_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW for the mapping of arguments */
+static inline void avx512_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+    const BYTE* WINPR_RESTRICT srcEven, const BYTE* WINPR_RESTRICT srcOdd,
+    BYTE* WINPR_RESTRICT yLumaDstEven, BYTE* WINPR_RESTRICT yLumaDstOdd,
+    BYTE* WINPR_RESTRICT uLumaDst, BYTE* WINPR_RESTRICT vLumaDst,
+    BYTE* WINPR_RESTRICT yEvenChromaDst1, BYTE* WINPR_RESTRICT yEvenChromaDst2,
+    BYTE* WINPR_RESTRICT yOddChromaDst1, BYTE* WINPR_RESTRICT yOddChromaDst2,
+    BYTE* WINPR_RESTRICT uChromaDst1, BYTE* WINPR_RESTRICT uChromaDst2,
+    BYTE* WINPR_RESTRICT vChromaDst1, BYTE* WINPR_RESTRICT vChromaDst2, UINT32 width)
+{
+	size_t x = 0;
+	for (; x < width - width % 64; x += 64)
+	{
+		__m512i Ye = _mm512_setzero_si512();
+		__m512i Ue = _mm512_setzero_si512();
+		__m512i Ve = _mm512_setzero_si512();
+		__m512i Yo = _mm512_setzero_si512();
+		__m512i Uo = _mm512_setzero_si512();
+		__m512i Vo = _mm512_setzero_si512();
+		avx512_BGRXToYUV_64(&srcEven[4 * x], &Ye, &Ue, &Ve);
+		avx512_BGRXToYUV_64(&srcOdd[4 * x], &Yo, &Uo, &Vo);
+
+		/* Y [b1] */
+		avx512_store(&yLumaDstEven[x], Ye);
+		avx512_store(&yLumaDstOdd[x], Yo);
+
+		/* 2x 2y [b2, b3] */
+		avx512_store256(&uLumaDst[x / 2], avx512_average_2x2(Ue, Uo));
+		avx512_store256(&vLumaDst[x / 2], avx512_average_2x2(Ve, Vo));
+
+		/* 2x + 1, y [b4, b5] */
+		avx512_store256(&yEvenChromaDst1[x / 2], avx512_odd_bytes(Ue));
+		avx512_store256(&yEvenChromaDst2[x / 2], avx512_odd_bytes(Ve));
+		avx512_store256(&yOddChromaDst1[x / 2], avx512_odd_bytes(Uo));
+		avx512_store256(&yOddChromaDst2[x / 2], avx512_odd_bytes(Vo));
+
+		/* 4x, 2y + 1 [b6, b7] and 4x + 2, 2y + 1 [b8, b9] */
+		_mm_storeu_si128((__m128i*)&uChromaDst1[x / 4], _mm512_cvtepi32_epi8(Uo));
+		_mm_storeu_si128((__m128i*)&vChromaDst1[x / 4],
+		                 _mm512_cvtepi32_epi8(_mm512_srli_epi32(Uo, 16)));
+		_mm_storeu_si128((__m128i*)&uChromaDst2[x / 4], _mm512_cvtepi32_epi8(Vo));
+		_mm_storeu_si128((__m128i*)&vChromaDst2[x / 4],
+		                 _mm512_cvtepi32_epi8(_mm512_srli_epi32(Vo, 16)));
+	}
+
+	general_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+	    x, srcEven, srcOdd, &yLumaDstEven[x], &yLumaDstOdd[x], &uLumaDst[x / 2], &vLumaDst[x / 2],
+	    &yEvenChromaDst1[x / 2], &yEvenChromaDst2[x / 2], &yOddChromaDst1[x / 2],
+	    &yOddChromaDst2[x / 2], &uChromaDst1[x / 4], &uChromaDst2[x / 4], &vChromaDst1[x / 4],
+	    &vChromaDst2[x / 4], width);
+}
+
+static pstatus_t avx512_RGBToAVC444YUVv2_BGRX(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcStep,
+                                              BYTE* WINPR_RESTRICT pDst1[],
+                                              const UINT32 dst1Step[],
+                                              BYTE* WINPR_RESTRICT pDst2[],
+                                              const UINT32 dst2Step[],
+                                              const prim_size_t* WINPR_RESTRICT roi)
+{
+	if (roi->height < 1 || roi->width < 1)
+		return !PRIMITIVES_SUCCESS;
+
+	size_t y = 0;
+	for (; y < roi->height - roi->height % 2; y += 2)
+	{
+		const BYTE* srcEven = (pSrc + y * srcStep);
+		const BYTE* srcOdd = (srcEven + srcStep);
+		BYTE* dstLumaYEven = (pDst1[0] + y * dst1Step[0]);
+		BYTE* dstLumaYOdd = (dstLumaYEven + dst1Step[0]);
+		BYTE* dstLumaU = (pDst1[1] + (y / 2) * dst1Step[1]);
+		BYTE* dstLumaV = (pDst1[2] + (y / 2) * dst1Step[2]);
+		BYTE* dstEvenChromaY1 = (pDst2[0] + y * dst2Step[0]);
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstOddChromaY1 = dstEvenChromaY1 + dst2Step[0];
+		BYTE* dstOddChromaY2 = dstEvenChromaY2 + dst2Step[0];
+		BYTE* dstChromaU1 = (pDst2[1] + (y / 2) * dst2Step[1]);
+		BYTE* dstChromaV1 = (pDst2[2] + (y / 2) * dst2Step[2]);
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		avx512_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(
+		    srcEven, srcOdd, dstLumaYEven, dstLumaYOdd, dstLumaU, dstLumaV, dstEvenChromaY1,
+		    dstEvenChromaY2, dstOddChromaY1, dstOddChromaY2, dstChromaU1, dstChromaU2, dstChromaV1,
+		    dstChromaV2, roi->width);
+	}
+
+	for (; y < roi->height; y++)
+	{
+		const BYTE* srcEven = (pSrc + y * srcStep);
+		BYTE* dstLumaYEven = (pDst1[0] + y * dst1Step[0]);
+		BYTE* dstLumaU = (pDst1[1] + (y / 2) * dst1Step[1]);
+		BYTE* dstLumaV = (pDst1[2] + (y / 2) * dst1Step[2]);
+		BYTE* dstEvenChromaY1 = (pDst2[0] + y * dst2Step[0]);
+		BYTE* dstEvenChromaY2 = dstEvenChromaY1 + roi->width / 2;
+		BYTE* dstChromaU1 = (pDst2[1] + (y / 2) * dst2Step[1]);
+		BYTE* dstChromaV1 = (pDst2[2] + (y / 2) * dst2Step[2]);
+		BYTE* dstChromaU2 = dstChromaU1 + roi->width / 4;
+		BYTE* dstChromaV2 = dstChromaV1 + roi->width / 4;
+		general_RGBToAVC444YUVv2_BGRX_DOUBLE_ROW(0, srcEven, nullptr, dstLumaYEven, nullptr,
+		                                         dstLumaU, dstLumaV, dstEvenChromaY1,
+		                                         dstEvenChromaY2, nullptr, nullptr, dstChromaU1,
+		                                         dstChromaU2, dstChromaV1, dstChromaV2, roi->width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx512_RGBToAVC444YUVv2(const BYTE* WINPR_RESTRICT pSrc, UINT32 srcFormat,
+                                         UINT32 srcStep, BYTE* WINPR_RESTRICT pDst1[],
+                                         const UINT32 dst1Step[], BYTE* WINPR_RESTRICT pDst2[],
+                                         const UINT32 dst2Step[],
+                                         const prim_size_t* WINPR_RESTRICT roi)
+{
+	switch (srcFormat)
+	{
+		case PIXEL_FORMAT_BGRX32:
+		case PIXEL_FORMAT_BGRA32:
+			return avx512_RGBToAVC444YUVv2_BGRX(pSrc, srcStep, pDst1, dst1Step, pDst2, dst2Step,
+			                                    roi);
+
+		default:
+			return generic->RGBToAVC444YUVv2(pSrc, srcFormat, srcStep, pDst1, dst1Step, pDst2,
+			                                 dst2Step, roi);
+	}
+}
+#endif
+
+void primitives_init_YUV_avx512_int(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+
+	WLog_VRB(PRIM_TAG, "AVX-512BW optimizations");
+	prims->RGBToYUV420_8u_P3AC4R = avx512_RGBToYUV420;
+	prims->RGBToYUV444_8u_P3AC4R = avx512_RGBToYUV444;
+	prims->RGBToAVC444YUV = avx512_RGBToAVC444YUV;
+	prims->RGBToAVC444YUVv2 = avx512_RGBToAVC444YUVv2;
+	prims->YUV420ToRGB_8u_P3AC4R = avx512_YUV420ToRGB;
+	prims->YUV444ToRGB_8u_P3AC4R = avx512_YUV444ToRGB_8u_P3AC4R;
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or avx512 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -15,6 +15,9 @@
 #include <freerdp/utils/profiler.h>
 
 #include "../prim_internal.h"
+#if defined(BUILD_TESTING_INTERNAL)
+#include "../prim_YUV.h"
+#endif
 
 #define TAG __FILE__
 
@@ -1036,7 +1039,7 @@ static BOOL yuv444_to_rgb(BYTE* rgb, size_t stride, const BYTE* yuv[3], const UI
 /* Check the result of generic matches the optimized routine.
  *
  */
-static BOOL compare_yuv444_to_rgb(prim_size_t roi, DWORD type)
+static BOOL compare_yuv444_to_rgb(prim_size_t roi, primitives_t* prims)
 {
 	BOOL rc = FALSE;
 	const UINT32 format = PIXEL_FORMAT_BGRA32;
@@ -1044,12 +1047,7 @@ static BOOL compare_yuv444_to_rgb(prim_size_t roi, DWORD type)
 	const UINT32 yuvStep[3] = { roi.width, roi.width, roi.width };
 	const size_t stride = 4ULL * roi.width;
 
-	primitives_t* prims = primitives_get_by_type(type);
-	if (!prims)
-	{
-		printf("primitives type %" PRIu32 " not supported, skipping\n", type);
-		return TRUE;
-	}
+	WINPR_ASSERT(prims);
 
 	BYTE* rgb1 = calloc(roi.height, stride);
 	BYTE* rgb2 = calloc(roi.height, stride);
@@ -1142,7 +1140,7 @@ fail:
 /* Check the result of generic matches the optimized routine.
  *
  */
-static BOOL compare_rgb_to_yuv444(prim_size_t roi, DWORD type)
+static BOOL compare_rgb_to_yuv444(prim_size_t roi, primitives_t* prims)
 {
 	BOOL rc = FALSE;
 	const UINT32 format = PIXEL_FORMAT_BGRA32;
@@ -1151,12 +1149,7 @@ static BOOL compare_rgb_to_yuv444(prim_size_t roi, DWORD type)
 	BYTE* yuv1[3] = WINPR_C_ARRAY_INIT;
 	BYTE* yuv2[3] = WINPR_C_ARRAY_INIT;
 
-	primitives_t* prims = primitives_get_by_type(type);
-	if (!prims)
-	{
-		printf("primitives type %" PRIu32 " not supported, skipping\n", type);
-		return TRUE;
-	}
+	WINPR_ASSERT(prims);
 
 	BYTE* rgb = calloc(roi.height, stride);
 
@@ -1209,7 +1202,7 @@ fail:
 /* Check the result of generic matches the optimized routine.
  *
  */
-static BOOL compare_yuv420_to_rgb(prim_size_t roi, DWORD type)
+static BOOL compare_yuv420_to_rgb(prim_size_t roi, primitives_t* prims)
 {
 	BOOL rc = FALSE;
 	const UINT32 format = PIXEL_FORMAT_BGRA32;
@@ -1217,12 +1210,7 @@ static BOOL compare_yuv420_to_rgb(prim_size_t roi, DWORD type)
 	const UINT32 yuvStep[3] = { roi.width, roi.width / 2, roi.width / 2 };
 	const size_t stride = 4ULL * roi.width;
 
-	primitives_t* prims = primitives_get_by_type(type);
-	if (!prims)
-	{
-		printf("primitives type %" PRIu32 " not supported, skipping\n", type);
-		return TRUE;
-	}
+	WINPR_ASSERT(prims);
 
 	BYTE* rgb1 = calloc(roi.height, stride);
 	BYTE* rgb2 = calloc(roi.height, stride);
@@ -1337,7 +1325,7 @@ static int similarY(const BYTE* a, const BYTE* b, size_t size, size_t type)
 /* Check the result of generic matches the optimized routine.
  *
  */
-static BOOL compare_rgb_to_yuv420(prim_size_t roi, DWORD type)
+static BOOL compare_rgb_to_yuv420(prim_size_t roi, primitives_t* prims)
 {
 	BOOL rc = FALSE;
 	const UINT32 format = PIXEL_FORMAT_BGRA32;
@@ -1346,12 +1334,7 @@ static BOOL compare_rgb_to_yuv420(prim_size_t roi, DWORD type)
 	BYTE* yuv1[3] = WINPR_C_ARRAY_INIT;
 	BYTE* yuv2[3] = WINPR_C_ARRAY_INIT;
 
-	primitives_t* prims = primitives_get_by_type(type);
-	if (!prims)
-	{
-		printf("primitives type %" PRIu32 " not supported, skipping\n", type);
-		return TRUE;
-	}
+	WINPR_ASSERT(prims);
 
 	BYTE* rgb = calloc(roi.height, stride);
 	BYTE* rgbcopy = calloc(roi.height, stride);
@@ -1420,6 +1403,72 @@ fail:
 	return rc;
 }
 
+static BOOL compare_to_generic(prim_size_t roi, primitives_t* prims)
+{
+	if (!compare_yuv444_to_rgb(roi, prims))
+		return FALSE;
+	if (!compare_rgb_to_yuv444(roi, prims))
+		return FALSE;
+
+	if (!compare_yuv420_to_rgb(roi, prims))
+		return FALSE;
+	return compare_rgb_to_yuv420(roi, prims);
+}
+
+#if defined(BUILD_TESTING_INTERNAL)
+typedef struct
+{
+	const char* name;
+	void (*init)(primitives_t* WINPR_RESTRICT prims);
+} YUV_TIER;
+
+/* The optimized primitives only use the best tier the CPU supports, check every tier
+ * against generic on its own */
+static BOOL compare_tiers(prim_size_t roi)
+{
+	const YUV_TIER tiers[] = {
+		{ "SSE4.1", primitives_init_YUV_sse41 },
+#if defined(WITH_AVX2)
+		{ "AVX2", primitives_init_YUV_avx2 },
+#endif
+#if defined(WITH_AVX512)
+		{ "AVX-512BW", primitives_init_YUV_avx512 },
+#endif
+		{ "NEON", primitives_init_YUV_neon },
+	};
+
+	primitives_t* generic = primitives_get_generic();
+	if (!generic)
+		return FALSE;
+
+	for (size_t x = 0; x < ARRAYSIZE(tiers); x++)
+	{
+		const YUV_TIER* tier = &tiers[x];
+		primitives_t prims = *generic;
+
+		/* every tier has its own YUV444 to RGB conversion */
+		tier->init(&prims);
+		if (prims.YUV444ToRGB_8u_P3AC4R == generic->YUV444ToRGB_8u_P3AC4R)
+		{
+			printf("%s YUV primitives not supported, skipping\n", tier->name);
+			continue;
+		}
+
+		printf("-------------------- %s ------------------------\n", tier->name);
+		if (!compare_to_generic(roi, &prims) || !TestPrimitiveYUVCombine(&prims, roi) ||
+		    !TestPrimitiveRgbToLumaChroma(&prims, roi, 1) ||
+		    !TestPrimitiveRgbToLumaChroma(&prims, roi, 2))
+		{
+			(void)fprintf(stderr, "%s YUV primitives differ from generic\n", tier->name);
+			return FALSE;
+		}
+		printf("---------------------- END --------------------------\n");
+	}
+
+	return TRUE;
+}
+#endif
+
 int TestPrimitivesYUV(int argc, char* argv[])
 {
 	BOOL large = (argc > 1);
@@ -1457,17 +1506,22 @@ int TestPrimitivesYUV(int argc, char* argv[])
 
 	for (UINT32 type = PRIMITIVES_PURE_SOFT; type <= PRIMITIVES_AUTODETECT; type++)
 	{
-		if (!compare_yuv444_to_rgb(roi, type))
-			goto end;
-		if (!compare_rgb_to_yuv444(roi, type))
-			goto end;
+		primitives_t* prims = primitives_get_by_type(type);
+		if (!prims)
+		{
+			printf("primitives type %" PRIu32 " not supported, skipping\n", type);
+			continue;
+		}
 
-		if (!compare_yuv420_to_rgb(roi, type))
-			goto end;
-		if (!compare_rgb_to_yuv420(roi, type))
+		if (!compare_to_generic(roi, prims))
 			goto end;
 	}
 
+#if defined(BUILD_TESTING_INTERNAL)
+	if (!compare_tiers(roi))
+		goto end;
+#endif
+
 	if (!run_tests(roi))
 		goto end;
 
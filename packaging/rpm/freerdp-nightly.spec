@@ -45,7 +45,6 @@ BuildRequires: libXv-devel
 BuildRequires: libXdamage-devel
 BuildRequires: libXtst-devel
 BuildRequires: cups-devel
-BuildRequires: cairo-devel
 BuildRequires: pcsc-lite-devel
 BuildRequires: zlib-devel
 BuildRequires: krb5-devel
@@ -196,7 +195,6 @@ cp %{_sourcedir}/source_version freerdp-nightly-%{version}/.source_version
     -DCHANNEL_SSHAGENT=ON \
     -DCHANNEL_SSHAGENT_CLIENT=ON \
     -DWITH_SERVER=ON \
-    -DWITH_CAIRO=ON \
     -DBUILD_TESTING=ON \
     -DBUILD_TESTING_NO_H264=ON \
     -DCMAKE_CTEST_ARGUMENTS="-DExperimentalTest;--output-on-failure;--no-compress-output" \
@@ -27,7 +27,6 @@
 #include <freerdp/config.h>
 
 #include <freerdp/freerdp.h>
-#include <freerdp/gdi/gdi.h>
 #include <freerdp/client/cmdline.h>
 
 #include <freerdp/server/proxy/proxy_log.h>
@@ -559,10 +558,14 @@ static BOOL pf_client_post_connect(freerdp* instance)
 	if (!pf_modules_run_hook(pc->pdata->module, HOOK_TYPE_CLIENT_POST_CONNECT, pc->pdata, pc))
 		return FALSE;
 
-	if (!gdi_init(instance, PIXEL_FORMAT_BGRA32))
-		return FALSE;
-
-	WINPR_ASSERT(freerdp_settings_get_bool(context->settings, FreeRDP_SoftwareGdi));
+	/* Without a software GDI graphics updates are forwarded without decoding, a module
+	 * requesting the framebuffer later on creates it lazily. */
+	WINPR_ASSERT(pc->pdata->config);
+	if (pc->pdata->config->SoftwareGdi || (pc->pdata->framebuffer_requested != 0))
+	{
+		if (!pf_client_gdi_init(pc))
+			return FALSE;
+	}
 
 	pf_client_register_update_callbacks(update);
 
@@ -615,7 +618,7 @@ static void pf_client_post_disconnect(freerdp* instance)
 	(void)pf_modules_run_hook(pc->pdata->module, HOOK_TYPE_CLIENT_POST_DISCONNECT, pc->pdata, pc);
 
 	PubSub_UnsubscribeErrorInfo(instance->context->pubSub, pf_client_on_error_info);
-	gdi_free(instance);
+	pf_client_gdi_free(pc);
 
 	/* Only close the connection if NLA fallback process is done */
 	if (!pc->allow_next_conn_failure)
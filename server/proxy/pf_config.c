@@ -90,6 +90,7 @@ static const char* key_plugins_required = "Required";
 static const char* section_codecs = "Codecs";
 static const char* key_codecs_rfx = "RFX";
 static const char* key_codecs_nsc = "NSC";
+static const char* key_codecs_gdi = "SoftwareGdi";
 
 static const char* section_channels = "Channels";
 static const char* key_channels_gfx = "GFX";
@@ -409,6 +410,7 @@ static BOOL pf_config_load_codecs(wIniFile* ini, proxyConfig* config)
 	WINPR_ASSERT(config);
 	config->RFX = pf_config_get_bool(ini, section_codecs, key_codecs_rfx, TRUE);
 	config->NSC = pf_config_get_bool(ini, section_codecs, key_codecs_nsc, TRUE);
+	config->SoftwareGdi = pf_config_get_bool(ini, section_codecs, key_codecs_gdi, TRUE);
 	return TRUE;
 }
 
@@ -770,6 +772,8 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueString(ini, section_codecs, key_codecs_nsc, bool_str_true) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueString(ini, section_codecs, key_codecs_gdi, bool_str_true) < 0)
+		goto fail;
 
 	/* Channel configuration */
 	if (IniFile_SetKeyValueString(ini, section_channels, key_channels_gfx, bool_str_true) < 0)
@@ -976,6 +980,7 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_SECTION(section_codecs);
 	CONFIG_PRINT_BOOL(config, RFX);
 	CONFIG_PRINT_BOOL(config, NSC);
+	CONFIG_PRINT_BOOL(config, SoftwareGdi);
 
 	CONFIG_PRINT_SECTION(section_channels);
 	CONFIG_PRINT_BOOL(config, GFX);
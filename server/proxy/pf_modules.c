@@ -23,6 +23,7 @@
 #include <winpr/assert.h>
 
 #include <winpr/file.h>
+#include <winpr/interlocked.h>
 #include <winpr/wlog.h>
 #include <winpr/path.h>
 #include <winpr/library.h>
@@ -399,6 +400,21 @@ static void pf_modules_abort_connect(WINPR_ATTR_UNUSED proxyPluginsManager* mgr,
 	proxy_data_abort_connect(pdata);
 }
 
+/*
+ * requests a decoded framebuffer for the session.
+ *
+ * the framebuffer is created lazily by the client side of the session on the next paint.
+ */
+WINPR_ATTR_NODISCARD
+static BOOL pf_modules_request_framebuffer(WINPR_ATTR_UNUSED proxyPluginsManager* mgr,
+                                           proxyData* pdata)
+{
+	WINPR_ASSERT(pdata);
+	if (InterlockedExchange(&pdata->framebuffer_requested, 1) == 0)
+		WLog_DBG(TAG, "framebuffer requested for session %s", pdata->session_id);
+	return TRUE;
+}
+
 WINPR_ATTR_NODISCARD
 static BOOL pf_modules_register_ArrayList_ForEachFkt(void* data, size_t index, va_list ap)
 {
@@ -666,6 +682,7 @@ proxyModule* pf_modules_new(const char* root_dir, const char** modules, size_t c
 	module->mgr.SetPluginData = pf_modules_set_plugin_data;
 	module->mgr.GetPluginData = pf_modules_get_plugin_data;
 	module->mgr.AbortConnect = pf_modules_abort_connect;
+	module->mgr.RequestFramebuffer = pf_modules_request_framebuffer;
 	module->plugins = ArrayList_New(FALSE);
 
 	if (module->plugins == nullptr)
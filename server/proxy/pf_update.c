@@ -73,6 +73,93 @@ static BOOL pf_server_suppress_output(rdpContext* context, BYTE allow, const REC
 
 /* Proxy from PC to PS */
 
+BOOL pf_client_gdi_init(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	rdpContext* context = &pc->context;
+	if (context->gdi)
+		return TRUE;
+
+	if (!gdi_init(context->instance, PIXEL_FORMAT_BGRA32))
+		return FALSE;
+
+	WINPR_ASSERT(freerdp_settings_get_bool(context->settings, FreeRDP_SoftwareGdi));
+
+	if (freerdp_settings_get_bool(context->settings, FreeRDP_DeactivateClientDecoding))
+	{
+		WLog_WARN(TAG, "client decoding is deactivated, the framebuffer will not be updated");
+		return TRUE;
+	}
+
+	/* keep the decoders, pf_client_register_update_callbacks replaces them with forwarders */
+	rdpUpdate* update = context->update;
+	WINPR_ASSERT(update);
+	pc->gdi_bitmap_update = update->BitmapUpdate;
+	pc->gdi_surface_bits = update->SurfaceBits;
+	pc->gdi_palette = update->Palette;
+	return TRUE;
+}
+
+void pf_client_gdi_free(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	pc->gdi_bitmap_update = nullptr;
+	pc->gdi_surface_bits = nullptr;
+	pc->gdi_palette = nullptr;
+	gdi_free(pc->context.instance);
+}
+
+/**
+ * Graphics updates are only decoded if a module asked for the framebuffer,
+ * otherwise they are forwarded as they are.
+ */
+WINPR_ATTR_NODISCARD
+static BOOL pf_client_decode_graphics(const pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(pc->pdata);
+
+	if (!pc->context.gdi)
+		return FALSE;
+	return pc->pdata->framebuffer_requested != 0;
+}
+
+/**
+ * A framebuffer requested by a module after the connection was established is created
+ * here. The whole desktop is refreshed so that it does not start out black.
+ */
+WINPR_ATTR_NODISCARD
+static BOOL pf_client_gdi_init_lazy(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(pc->pdata);
+
+	rdpContext* context = &pc->context;
+	if (context->gdi || (pc->pdata->framebuffer_requested == 0))
+		return TRUE;
+
+	WLog_INFO(TAG, "framebuffer requested, enabling software GDI");
+	if (!pf_client_gdi_init(pc))
+		return FALSE;
+
+	rdpUpdate* update = context->update;
+	pf_client_register_update_callbacks(update);
+
+	const UINT32 width = freerdp_settings_get_uint32(context->settings, FreeRDP_DesktopWidth);
+	const UINT32 height = freerdp_settings_get_uint32(context->settings, FreeRDP_DesktopHeight);
+	if ((width == 0) || (height == 0))
+		return TRUE;
+
+	const RECTANGLE_16 area = { .left = 0,
+		                        .top = 0,
+		                        .right = WINPR_ASSERTING_INT_CAST(UINT16, width - 1),
+		                        .bottom = WINPR_ASSERTING_INT_CAST(UINT16, height - 1) };
+	WINPR_ASSERT(update->RefreshRect);
+	return update->RefreshRect(context, 1, &area);
+}
+
 /**
  * This function is called whenever a new frame starts.
  * It can be used to reset invalidated areas.
@@ -91,13 +178,17 @@ static BOOL pf_client_begin_paint(rdpContext* context)
 	WINPR_ASSERT(ps->update);
 	WINPR_ASSERT(ps->update->BeginPaint);
 	WLog_DBG(TAG, "called");
+
+	if (!pf_client_gdi_init_lazy(pc))
+		return FALSE;
+
 	return ps->update->BeginPaint(ps);
 }
 
 /**
  * This function is called when the library completed composing a new
  * frame. Read out the changed areas and blit them to your output device.
- * The image buffer will have the format specified by gdi_init
+ * The image buffer, if a module requested one, will have the format specified by gdi_init
  */
 WINPR_ATTR_NODISCARD
 static BOOL pf_client_end_paint(rdpContext* context)
@@ -139,6 +230,13 @@ static BOOL pf_client_bitmap_update(rdpContext* context, const BITMAP_UPDATE* bi
 	WINPR_ASSERT(ps->update);
 	WINPR_ASSERT(ps->update->BitmapUpdate);
 	WLog_DBG(TAG, "called");
+
+	if (pf_client_decode_graphics(pc))
+	{
+		if (pc->gdi_bitmap_update && !pc->gdi_bitmap_update(context, bitmap))
+			return FALSE;
+	}
+
 	return ps->update->BitmapUpdate(ps, bitmap);
 }
 
@@ -162,6 +260,15 @@ static BOOL pf_client_desktop_resize(rdpContext* context)
 		return FALSE;
 	if (!freerdp_settings_copy_item(ps->settings, context->settings, FreeRDP_DesktopHeight))
 		return FALSE;
+
+	if (context->gdi)
+	{
+		if (!gdi_resize(context->gdi,
+		                freerdp_settings_get_uint32(context->settings, FreeRDP_DesktopWidth),
+		                freerdp_settings_get_uint32(context->settings, FreeRDP_DesktopHeight)))
+			return FALSE;
+	}
+
 	return ps->update->DesktopResize(ps);
 }
 
@@ -401,9 +508,33 @@ static BOOL pf_client_SurfaceBits(rdpContext* context,
 	WINPR_ASSERT(ps->update->SurfaceBits);
 
 	WLog_DBG(TAG, "called");
+
+	if (pf_client_decode_graphics(pc))
+	{
+		if (pc->gdi_surface_bits && !pc->gdi_surface_bits(context, surfaceBitsCommand))
+			return FALSE;
+	}
+
 	return ps->update->SurfaceBits(ps, surfaceBitsCommand);
 }
 
+/**
+ * Palette updates can not be forwarded, they only keep the framebuffer colors
+ * up to date if there is one.
+ */
+WINPR_ATTR_NODISCARD
+static BOOL pf_client_palette(rdpContext* context, const PALETTE_UPDATE* palette)
+{
+	pClientContext* pc = (pClientContext*)context;
+	WINPR_ASSERT(pc);
+
+	WLog_DBG(TAG, "called");
+
+	if (!pc->gdi_palette)
+		return TRUE;
+	return pc->gdi_palette(context, palette);
+}
+
 WINPR_ATTR_NODISCARD
 static BOOL pf_client_SurfaceFrameMarker(rdpContext* context,
                                          const SURFACE_FRAME_MARKER* surfaceFrameMarker)
@@ -685,6 +816,7 @@ void pf_client_register_update_callbacks(rdpUpdate* update)
 	/* see gdi_register_update_callbacks */
 	update->SurfaceBits = pf_client_SurfaceBits;
 	update->SurfaceFrameMarker = pf_client_SurfaceFrameMarker;
+	update->Palette = pf_client_palette;
 
 	/* Rail window updates */
 	update->window->WindowCreate = pf_client_window_create;
@@ -31,4 +31,7 @@
 void pf_server_register_update_callbacks(rdpUpdate* update);
 void pf_client_register_update_callbacks(rdpUpdate* update);
 
+WINPR_ATTR_NODISCARD BOOL pf_client_gdi_init(pClientContext* pc);
+void pf_client_gdi_free(pClientContext* pc);
+
 #endif /* FREERDP_SERVER_PROXY_PFUPDATE_H */
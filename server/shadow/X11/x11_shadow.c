@@ -810,13 +810,32 @@ static int x11_shadow_error_handler_for_capture(Display* display, XErrorEvent* e
 	return 0;
 }
 
+WINPR_ATTR_NODISCARD
+static int x11_shadow_compare_locked(x11ShadowSubsystem* subsystem, const BYTE* data,
+                                     UINT32 scanline, REGION16* invalidRegion)
+{
+	rdpShadowServer* server = subsystem->common.server;
+	rdpShadowSurface* surface = server->surface;
+
+#if !defined(USE_SHADOW_BLEND_CURSOR)
+	/* The blended cursor modifies the surface, only a comparison with it restores the screen */
+	if (server->CaptureTileHashes)
+		return shadow_capture_compare_hashed(server->capture, data, subsystem->format, scanline,
+		                                     surface->width, surface->height, invalidRegion);
+#endif
+
+	return shadow_capture_compare_region(surface->data, surface->format, surface->scanline,
+	                                     surface->width, surface->height, data, subsystem->format,
+	                                     scanline, invalidRegion);
+}
+
 WINPR_ATTR_NODISCARD
 static int x11_shadow_screen_grab_disp_locked(x11ShadowSubsystem* subsystem, XImage** ppimage,
-                                              RECTANGLE_16* invalidRect)
+                                              REGION16* invalidRegion)
 {
 	WINPR_ASSERT(subsystem);
 	WINPR_ASSERT(ppimage);
-	WINPR_ASSERT(invalidRect);
+	WINPR_ASSERT(invalidRegion);
 
 	rdpShadowServer* server = subsystem->common.server;
 	WINPR_ASSERT(server);
@@ -836,10 +855,9 @@ static int x11_shadow_screen_grab_disp_locked(x11ShadowSubsystem* subsystem, XIm
 		          subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
 
 		EnterCriticalSection(&surface->lock);
-		status = shadow_capture_compare_with_format(
-		    surface->data, surface->format, surface->scanline, surface->width, surface->height,
-		    (BYTE*)&(image->data[surface->width * 4ull]), subsystem->format,
-		    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), invalidRect);
+		status = x11_shadow_compare_locked(
+		    subsystem, (BYTE*)&(image->data[surface->width * 4ull]),
+		    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), invalidRegion);
 		LeaveCriticalSection(&surface->lock);
 	}
 	else
@@ -851,10 +869,9 @@ static int x11_shadow_screen_grab_disp_locked(x11ShadowSubsystem* subsystem, XIm
 
 		if (image)
 		{
-			status = shadow_capture_compare_with_format(
-			    surface->data, surface->format, surface->scanline, surface->width, surface->height,
-			    (BYTE*)image->data, subsystem->format,
-			    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), invalidRect);
+			status = x11_shadow_compare_locked(
+			    subsystem, (BYTE*)image->data,
+			    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), invalidRegion);
 		}
 		*ppimage = image;
 		LeaveCriticalSection(&surface->lock);
@@ -865,16 +882,20 @@ static int x11_shadow_screen_grab_disp_locked(x11ShadowSubsystem* subsystem, XIm
 
 WINPR_ATTR_NODISCARD
 static BOOL x11_shadow_surface_update_invalid(rdpShadowSurface* surface,
-                                              const RECTANGLE_16* invalidRect,
+                                              const REGION16* invalidRegion,
                                               const RECTANGLE_16* surfaceRect)
 {
 	WINPR_ASSERT(surface);
-	WINPR_ASSERT(invalidRect);
+	WINPR_ASSERT(invalidRegion);
 	WINPR_ASSERT(surfaceRect);
 
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(invalidRegion, &numRects);
+	BOOL rc1 = TRUE;
+
 	EnterCriticalSection(&surface->lock);
-	const BOOL rc1 =
-	    region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), invalidRect);
+	for (UINT32 x = 0; rc1 && (x < numRects); x++)
+		rc1 = region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &rects[x]);
 	const BOOL rc2 =
 	    region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), surfaceRect);
 	const BOOL empty = region16_is_empty(&(surface->invalidRegion));
@@ -888,24 +909,25 @@ static BOOL x11_shadow_surface_update_contents(rdpShadowSurface* surface, UINT32
 {
 	WINPR_ASSERT(surface);
 	WINPR_ASSERT(image);
+	WINPR_ASSERT(image->bytes_per_line >= 0);
+
+	BOOL success = TRUE;
+	UINT32 numRects = 0;
 
 	EnterCriticalSection(&surface->lock);
-	const RECTANGLE_16* extents = region16_extents(&(surface->invalidRegion));
-	const UINT16 x = extents->left;
-	const UINT16 y = extents->top;
-	const UINT16 width = extents->right - extents->left;
-	const UINT16 height = extents->bottom - extents->top;
-	WINPR_ASSERT(image);
-	WINPR_ASSERT(image->bytes_per_line >= 0);
-	WINPR_ASSERT(width >= 0);
-	WINPR_ASSERT(height >= 0);
-	const BOOL success = freerdp_image_copy_no_overlap(
-	    surface->data, surface->format, surface->scanline, WINPR_ASSERTING_INT_CAST(uint32_t, x),
-	    WINPR_ASSERTING_INT_CAST(uint32_t, y), WINPR_ASSERTING_INT_CAST(uint32_t, width),
-	    WINPR_ASSERTING_INT_CAST(uint32_t, height), (BYTE*)image->data, format,
-	    WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line),
-	    WINPR_ASSERTING_INT_CAST(UINT32, x), WINPR_ASSERTING_INT_CAST(UINT32, y), nullptr,
-	    FREERDP_FLIP_NONE);
+	const RECTANGLE_16* rects = region16_rects(&(surface->invalidRegion), &numRects);
+	for (UINT32 x = 0; success && (x < numRects); x++)
+	{
+		const RECTANGLE_16* rect = &rects[x];
+		const UINT32 width = rect->right - rect->left;
+		const UINT32 height = rect->bottom - rect->top;
+
+		success = freerdp_image_copy_no_overlap(
+		    surface->data, surface->format, surface->scanline, rect->left, rect->top, width,
+		    height, (BYTE*)image->data, format,
+		    WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line), rect->left, rect->top,
+		    nullptr, FREERDP_FLIP_NONE);
+	}
 	LeaveCriticalSection(&surface->lock);
 	return success;
 }
@@ -937,8 +959,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	}
 
 	XImage* image = nullptr;
-	RECTANGLE_16 invalidRect = WINPR_C_ARRAY_INIT;
+	REGION16 invalidRegion;
 	int status = -1;
+
+	region16_init(&invalidRegion);
 	{
 		XLockDisplay(subsystem->display);
 		/*
@@ -947,7 +971,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		 */
 		XSetErrorHandler(x11_shadow_error_handler_for_capture);
 
-		status = x11_shadow_screen_grab_disp_locked(subsystem, &image, &invalidRect);
+		status = x11_shadow_screen_grab_disp_locked(subsystem, &image, &invalidRegion);
 		if (status < 0)
 			goto fail_capture;
 
@@ -959,7 +983,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 	if (status)
 	{
-		const BOOL empty = x11_shadow_surface_update_invalid(surface, &invalidRect, &surfaceRect);
+		const BOOL empty =
+		    x11_shadow_surface_update_invalid(surface, &invalidRegion, &surfaceRect);
 
 		if (!empty)
 		{
@@ -995,6 +1020,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 	rc = 1;
 fail_capture:
+	region16_uninit(&invalidRegion);
 	if (!subsystem->use_xshm && image)
 		XDestroyImage(image);
 
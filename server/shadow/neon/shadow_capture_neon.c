@@ -0,0 +1,66 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server Tile Compare - NEON Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "../shadow_capture.h"
+
+#include "../../../libfreerdp/core/simd.h"
+
+#define TAG SERVER_TAG("shadow.capture")
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static inline uint32x4_t shadow_capture_xor_neon(const BYTE* WINPR_RESTRICT pData1,
+                                                 const BYTE* WINPR_RESTRICT pData2)
+{
+	return vreinterpretq_u32_u8(veorq_u8(vld1q_u8(pData1), vld1q_u8(pData2)));
+}
+
+static inline BOOL shadow_capture_tile_equal_neon(const BYTE* WINPR_RESTRICT pData1,
+                                                  const BYTE* WINPR_RESTRICT pData2,
+                                                  uint32x4_t vmask)
+{
+	const uint32x4_t d0 = shadow_capture_xor_neon(&pData1[0], &pData2[0]);
+	const uint32x4_t d1 = shadow_capture_xor_neon(&pData1[16], &pData2[16]);
+	const uint32x4_t d2 = shadow_capture_xor_neon(&pData1[32], &pData2[32]);
+	const uint32x4_t d3 = shadow_capture_xor_neon(&pData1[48], &pData2[48]);
+	const uint32x4_t d = vandq_u32(vorrq_u32(vorrq_u32(d0, d1), vorrq_u32(d2, d3)), vmask);
+	const uint64x2_t d64 = vreinterpretq_u64_u32(d);
+	return (vgetq_lane_u64(d64, 0) | vgetq_lane_u64(d64, 1)) == 0;
+}
+
+SHADOW_CAPTURE_DEFINE_TILE_DIFF(shadow_capture_tile_diff_neon, uint32x4_t, vdupq_n_u32,
+                                shadow_capture_tile_equal_neon)
+#endif
+
+void shadow_capture_init_neon_int(shadowTileDiffFn* WINPR_RESTRICT fn)
+{
+	WINPR_ASSERT(fn);
+#if defined(NEON_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "NEON optimizations");
+	*fn = shadow_capture_tile_diff_neon;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or NEON intrinsics not available");
+	WINPR_UNUSED(fn);
+#endif
+}
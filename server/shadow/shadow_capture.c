@@ -218,102 +218,543 @@ static pixel_equal_fn_t get_comparison_fn(DWORD format1, DWORD format2)
 		return pixel_equal_no_alpha;
 }
 
+#define SHADOW_CAPTURE_MAX_COLUMNS \
+	((UINT16_MAX + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE)
+
+#define SHADOW_CAPTURE_HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define SHADOW_CAPTURE_HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define SHADOW_CAPTURE_HASH_PRIME3 0x165667B19E3779F9ULL
+
+static INIT_ONCE shadow_capture_tile_diff_InitOnce = INIT_ONCE_STATIC_INIT;
+static shadowTileDiffFn shadow_capture_tile_diff_optimized = nullptr;
+
+static inline UINT32 shadow_capture_setmask_generic(UINT32 mask)
+{
+	return mask;
+}
+
+WINPR_ATTR_NODISCARD
+static inline BOOL shadow_capture_tile_equal_generic(const BYTE* WINPR_RESTRICT pData1,
+                                                     const BYTE* WINPR_RESTRICT pData2,
+                                                     UINT32 mask)
+{
+	return shadow_capture_pixels_equal32(pData1, pData2, SHADOW_CAPTURE_TILE_SIZE, mask);
+}
+
+SHADOW_CAPTURE_DEFINE_TILE_DIFF(shadow_capture_tile_diff_generic, UINT32,
+                                shadow_capture_setmask_generic, shadow_capture_tile_equal_generic)
+
+static BOOL CALLBACK shadow_capture_init_tile_diff_cb(WINPR_ATTR_UNUSED PINIT_ONCE once,
+                                                      WINPR_ATTR_UNUSED PVOID param,
+                                                      WINPR_ATTR_UNUSED PVOID* context)
+{
+	shadow_capture_tile_diff_optimized = shadow_capture_tile_diff_generic;
+	shadow_capture_init_sse2(&shadow_capture_tile_diff_optimized);
+#if defined(WITH_AVX2)
+	shadow_capture_init_avx2(&shadow_capture_tile_diff_optimized);
+#endif
+	shadow_capture_init_neon(&shadow_capture_tile_diff_optimized);
+	return TRUE;
+}
+
+shadowTileDiffFn shadow_capture_get_tile_diff_generic(void)
+{
+	return shadow_capture_tile_diff_generic;
+}
+
+shadowTileDiffFn shadow_capture_get_tile_diff(void)
+{
+	if (!InitOnceExecuteOnce(&shadow_capture_tile_diff_InitOnce, shadow_capture_init_tile_diff_cb,
+	                         nullptr, nullptr))
+		return shadow_capture_tile_diff_generic;
+	return shadow_capture_tile_diff_optimized;
+}
+
+/* Mask of the color bits of a 32bpp pixel as loaded from memory */
+WINPR_ATTR_NODISCARD
+static UINT32 shadow_capture_color_mask(UINT32 format)
+{
+	BYTE bytes[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+	UINT32 mask = 0;
+
+	switch (format)
+	{
+		case PIXEL_FORMAT_ARGB32:
+		case PIXEL_FORMAT_XRGB32:
+		case PIXEL_FORMAT_ABGR32:
+		case PIXEL_FORMAT_XBGR32:
+			bytes[0] = 0;
+			break;
+		default:
+			bytes[3] = 0;
+			break;
+	}
+
+	memcpy(&mask, bytes, sizeof(mask));
+	return mask;
+}
+
+typedef struct
+{
+	shadowTileDiffFn diff;
+	pixel_equal_fn_t equal;
+	UINT32 mask;
+} shadow_tile_compare;
+
+static void shadow_capture_get_tile_compare(UINT32 format1, UINT32 format2,
+                                            shadow_tile_compare* WINPR_RESTRICT cmp)
+{
+	WINPR_ASSERT(cmp);
+
+	cmp->diff = nullptr;
+	cmp->equal = get_comparison_fn(format1, format2);
+	cmp->mask = UINT32_MAX;
+
+	if ((FreeRDPGetBitsPerPixel(format1) != 32) || (FreeRDPGetBitsPerPixel(format2) != 32))
+		return;
+
+	if (format1 == format2)
+		cmp->diff = shadow_capture_get_tile_diff();
+	else if (FreeRDPAreColorFormatsEqualNoAlpha(format1, format2))
+	{
+		/* Only one of the formats carries alpha, compare the color channels only */
+		cmp->diff = shadow_capture_get_tile_diff();
+		cmp->mask = shadow_capture_color_mask(format1);
+	}
+}
+
+WINPR_ATTR_NODISCARD
+static UINT32 shadow_capture_tile_diff_pixels(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                              UINT32 nStep1, const BYTE* WINPR_RESTRICT pData2,
+                                              UINT32 format2, UINT32 nStep2, UINT32 nWidth,
+                                              UINT32 nHeight, pixel_equal_fn_t equal,
+                                              BYTE* WINPR_RESTRICT dirty)
+{
+	const size_t bppA = FreeRDPGetBytesPerPixel(format1);
+	const size_t bppB = FreeRDPGetBytesPerPixel(format2);
+	const UINT32 ncol = (nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	UINT32 dirtyCount = 0;
+
+	for (UINT32 y = 0; (y < nHeight) && (dirtyCount < ncol); y++)
+	{
+		for (UINT32 tx = 0; tx < ncol; tx++)
+		{
+			const UINT32 x = tx * SHADOW_CAPTURE_TILE_SIZE;
+			const UINT32 tw = MIN(SHADOW_CAPTURE_TILE_SIZE, nWidth - x);
+
+			if (dirty[tx])
+				continue;
+
+			if (!equal(&pData1[x * bppA], format1, &pData2[x * bppB], format2, tw))
+			{
+				dirty[tx] = 1;
+				dirtyCount++;
+			}
+		}
+
+		pData1 += nStep1;
+		pData2 += nStep2;
+	}
+
+	return dirtyCount;
+}
+
+/** Called for each row of tiles with at least one changed tile */
+typedef BOOL (*shadow_tile_row_fn)(void* arg, UINT32 ty, const BYTE* WINPR_RESTRICT dirty,
+                                   UINT32 ncol);
+
+WINPR_ATTR_NODISCARD
+static int shadow_capture_diff_tiles(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                     UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                     const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                     UINT32 nStep2, shadow_tile_row_fn fn, void* arg)
+{
+	BYTE dirty[SHADOW_CAPTURE_MAX_COLUMNS] = WINPR_C_ARRAY_INIT;
+	shadow_tile_compare cmp = WINPR_C_ARRAY_INIT;
+	const UINT32 nrow = (nHeight + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const UINT32 ncol = (nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	int rc = 0;
+
+	WINPR_ASSERT(fn);
+
+	if ((nWidth > UINT16_MAX) || (nHeight > UINT16_MAX))
+		return -1;
+
+	shadow_capture_get_tile_compare(format1, format2, &cmp);
+
+	for (UINT32 ty = 0; ty < nrow; ty++)
+	{
+		const size_t y = 1ULL * ty * SHADOW_CAPTURE_TILE_SIZE;
+		const UINT32 th = MIN(SHADOW_CAPTURE_TILE_SIZE, nHeight - (UINT32)y);
+		const BYTE* p1 = &pData1[y * nStep1];
+		const BYTE* p2 = &pData2[y * nStep2];
+		UINT32 dirtyCount = 0;
+
+		memset(dirty, 0, ncol);
+
+		if (cmp.diff)
+			dirtyCount = cmp.diff(p1, nStep1, p2, nStep2, nWidth, th, cmp.mask, dirty, 0);
+		else
+			dirtyCount = shadow_capture_tile_diff_pixels(p1, format1, nStep1, p2, format2, nStep2,
+			                                             nWidth, th, cmp.equal, dirty);
+
+		if (dirtyCount == 0)
+			continue;
+
+		rc = 1;
+		if (!fn(arg, ty, dirty, ncol))
+			return -1;
+	}
+
+	return rc;
+}
+
+typedef struct
+{
+	UINT32 l;
+	UINT32 t;
+	UINT32 r;
+	UINT32 b;
+} shadow_tile_bounds;
+
+WINPR_ATTR_NODISCARD
+static BOOL shadow_capture_bounds_add_row(void* arg, UINT32 ty, const BYTE* WINPR_RESTRICT dirty,
+                                          UINT32 ncol)
+{
+	shadow_tile_bounds* bounds = arg;
+	WINPR_ASSERT(bounds);
+
+	for (UINT32 tx = 0; tx < ncol; tx++)
+	{
+		if (!dirty[tx])
+			continue;
+
+		bounds->l = MIN(bounds->l, tx);
+		bounds->r = MAX(bounds->r, tx);
+	}
+
+	bounds->t = MIN(bounds->t, ty);
+	bounds->b = MAX(bounds->b, ty);
+	return TRUE;
+}
+
+/* Changed tiles are collected as runs per row of tiles. Rows with the same runs as the row
+ * above extend the pending rectangles, so a changed block costs one region union. */
+typedef struct
+{
+	REGION16* region;
+	UINT32 nWidth;
+	UINT32 nHeight;
+	RECTANGLE_16* pending;
+	size_t count;
+	UINT32 lastRow;
+} shadow_tile_region;
+
+WINPR_ATTR_NODISCARD
+static BOOL shadow_capture_region_flush(shadow_tile_region* ctx)
+{
+	WINPR_ASSERT(ctx);
+
+	for (size_t x = 0; x < ctx->count; x++)
+	{
+		if (!region16_union_rect(ctx->region, ctx->region, &ctx->pending[x]))
+			return FALSE;
+	}
+
+	ctx->count = 0;
+	return TRUE;
+}
+
+WINPR_ATTR_NODISCARD
+static BOOL shadow_capture_region_add_row(void* arg, UINT32 ty, const BYTE* WINPR_RESTRICT dirty,
+                                          UINT32 ncol)
+{
+	shadow_tile_region* ctx = arg;
+	WINPR_ASSERT(ctx);
+
+	const UINT16 top = WINPR_ASSERTING_INT_CAST(UINT16, ty * SHADOW_CAPTURE_TILE_SIZE);
+	const UINT16 bottom = WINPR_ASSERTING_INT_CAST(
+	    UINT16, MIN((ty + 1) * SHADOW_CAPTURE_TILE_SIZE, ctx->nHeight));
+	BOOL extend = (ctx->count > 0) && (ctx->lastRow + 1 == ty);
+	size_t index = 0;
+
+	for (UINT32 tx = 0; tx < ncol; tx++)
+	{
+		if (!dirty[tx])
+			continue;
+
+		UINT32 end = tx + 1;
+		while ((end < ncol) && dirty[end])
+			end++;
+
+		const UINT16 left = WINPR_ASSERTING_INT_CAST(UINT16, tx * SHADOW_CAPTURE_TILE_SIZE);
+		const UINT16 right = WINPR_ASSERTING_INT_CAST(
+		    UINT16, MIN(end * SHADOW_CAPTURE_TILE_SIZE, ctx->nWidth));
+
+		if (extend && ((index >= ctx->count) || (ctx->pending[index].left != left) ||
+		               (ctx->pending[index].right != right)))
+			extend = FALSE;
+
+		index++;
+		tx = end;
+	}
+
+	if (extend && (index == ctx->count))
+	{
+		for (size_t x = 0; x < ctx->count; x++)
+			ctx->pending[x].bottom = bottom;
+	}
+	else
+	{
+		if (!shadow_capture_region_flush(ctx))
+			return FALSE;
+
+		for (UINT32 tx = 0; tx < ncol; tx++)
+		{
+			if (!dirty[tx])
+				continue;
+
+			UINT32 end = tx + 1;
+			while ((end < ncol) && dirty[end])
+				end++;
+
+			RECTANGLE_16* rect = &ctx->pending[ctx->count++];
+			rect->left = WINPR_ASSERTING_INT_CAST(UINT16, tx * SHADOW_CAPTURE_TILE_SIZE);
+			rect->top = top;
+			rect->right =
+			    WINPR_ASSERTING_INT_CAST(UINT16, MIN(end * SHADOW_CAPTURE_TILE_SIZE, ctx->nWidth));
+			rect->bottom = bottom;
+			tx = end;
+		}
+	}
+
+	ctx->lastRow = ty;
+	return TRUE;
+}
+
+WINPR_ATTR_NODISCARD
+static BOOL shadow_capture_region_init(shadow_tile_region* ctx, REGION16* region, UINT32 nWidth,
+                                       UINT32 nHeight)
+{
+	WINPR_ASSERT(ctx);
+	WINPR_ASSERT(region);
+
+	const size_t ncol = (nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+
+	ctx->region = region;
+	ctx->nWidth = nWidth;
+	ctx->nHeight = nHeight;
+	ctx->count = 0;
+	ctx->lastRow = 0;
+	/* At most every second column starts a run */
+	ctx->pending = calloc((ncol + 1) / 2 + 1, sizeof(RECTANGLE_16));
+	return ctx->pending != nullptr;
+}
+
 int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
                                        UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
                                        const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
                                        UINT32 nStep2, RECTANGLE_16* WINPR_RESTRICT rect)
 {
-	pixel_equal_fn_t pixel_equal_fn = get_comparison_fn(format1, format2);
-	BOOL allEqual = TRUE;
-	UINT32 tw = 0;
-	const UINT32 nrow = (nHeight + 15) / 16;
-	const UINT32 ncol = (nWidth + 15) / 16;
-	UINT32 l = ncol + 1;
-	UINT32 t = nrow + 1;
-	UINT32 r = 0;
-	UINT32 b = 0;
-	const size_t bppA = FreeRDPGetBytesPerPixel(format1);
-	const size_t bppB = FreeRDPGetBytesPerPixel(format2);
+	shadow_tile_bounds bounds = { UINT32_MAX, UINT32_MAX, 0, 0 };
 	const RECTANGLE_16 empty = WINPR_C_ARRAY_INIT;
 	WINPR_ASSERT(rect);
 
 	*rect = empty;
 
-	for (size_t ty = 0; ty < nrow; ty++)
-	{
-		BOOL rowEqual = TRUE;
-		size_t th = ((ty + 1) == nrow) ? (nHeight % 16) : 16;
+	const int rc = shadow_capture_diff_tiles(pData1, format1, nStep1, nWidth, nHeight, pData2,
+	                                         format2, nStep2, shadow_capture_bounds_add_row,
+	                                         &bounds);
+	if (rc <= 0)
+		return rc;
+
+	rect->left = WINPR_ASSERTING_INT_CAST(UINT16, bounds.l * SHADOW_CAPTURE_TILE_SIZE);
+	rect->top = WINPR_ASSERTING_INT_CAST(UINT16, bounds.t * SHADOW_CAPTURE_TILE_SIZE);
+	rect->right = WINPR_ASSERTING_INT_CAST(
+	    UINT16, MIN((bounds.r + 1) * SHADOW_CAPTURE_TILE_SIZE, nWidth));
+	rect->bottom = WINPR_ASSERTING_INT_CAST(
+	    UINT16, MIN((bounds.b + 1) * SHADOW_CAPTURE_TILE_SIZE, nHeight));
+	return 1;
+}
 
-		if (!th)
-			th = 16;
+int shadow_capture_compare_region(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                  UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                  const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                  UINT32 nStep2, REGION16* WINPR_RESTRICT region)
+{
+	shadow_tile_region ctx = WINPR_C_ARRAY_INIT;
 
-		for (size_t tx = 0; tx < ncol; tx++)
-		{
-			BOOL equal = TRUE;
-			tw = ((tx + 1) == ncol) ? (nWidth % 16) : 16;
+	WINPR_ASSERT(region);
+	region16_clear(region);
 
-			if (!tw)
-				tw = 16;
+	if (!shadow_capture_region_init(&ctx, region, nWidth, nHeight))
+		return -1;
 
-			const BYTE* p1 = &pData1[(ty * 16ULL * nStep1) + (tx * 16ull * bppA)];
-			const BYTE* p2 = &pData2[(ty * 16ULL * nStep2) + (tx * 16ull * bppB)];
+	int rc = shadow_capture_diff_tiles(pData1, format1, nStep1, nWidth, nHeight, pData2, format2,
+	                                   nStep2, shadow_capture_region_add_row, &ctx);
+	if ((rc > 0) && !shadow_capture_region_flush(&ctx))
+		rc = -1;
 
-			for (size_t k = 0; k < th; k++)
-			{
-				if (!pixel_equal_fn(p1, format1, p2, format2, tw))
-				{
-					equal = FALSE;
-					break;
-				}
+	free(ctx.pending);
+	return rc;
+}
 
-				p1 += nStep1;
-				p2 += nStep2;
-			}
+static inline UINT64 shadow_capture_hash_round(UINT64 acc, UINT64 value)
+{
+	acc += value * SHADOW_CAPTURE_HASH_PRIME2;
+	acc = (acc << 31) | (acc >> 33);
+	return acc * SHADOW_CAPTURE_HASH_PRIME1;
+}
 
-			if (!equal)
-			{
-				rowEqual = FALSE;
-				if (l > tx)
-					l = (UINT32)tx;
+static inline UINT64 shadow_capture_hash_rotl(UINT64 value, unsigned bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
 
-				if (r < tx)
-					r = (UINT32)tx;
-			}
+/* 64 bit hash of a tile, bits cleared in mask (the X channel) are ignored */
+WINPR_ATTR_NODISCARD
+static UINT64 shadow_capture_hash_tile(const BYTE* WINPR_RESTRICT pData, UINT32 nStep,
+                                       size_t rowBytes, UINT32 nHeight, UINT64 mask)
+{
+	UINT64 lanes[4] = { SHADOW_CAPTURE_HASH_PRIME1 + SHADOW_CAPTURE_HASH_PRIME2,
+		                SHADOW_CAPTURE_HASH_PRIME2, 0, 0 - SHADOW_CAPTURE_HASH_PRIME1 };
+
+	for (UINT32 y = 0; y < nHeight; y++)
+	{
+		const BYTE* row = &pData[1ULL * y * nStep];
+		size_t x = 0;
+
+		for (; x + sizeof(UINT64) <= rowBytes; x += sizeof(UINT64))
+		{
+			UINT64 value = 0;
+			memcpy(&value, &row[x], sizeof(value));
+			const size_t lane = (x / sizeof(UINT64)) & 3;
+			lanes[lane] = shadow_capture_hash_round(lanes[lane], value & mask);
 		}
 
-		if (!rowEqual)
+		if (x < rowBytes)
 		{
-			allEqual = FALSE;
+			UINT64 value = 0;
+			memcpy(&value, &row[x], rowBytes - x);
+			lanes[3] = shadow_capture_hash_round(lanes[3], value & mask);
+		}
+	}
 
-			if (t > ty)
-				t = (UINT32)ty;
+	UINT64 hash = shadow_capture_hash_rotl(lanes[0], 1) + shadow_capture_hash_rotl(lanes[1], 7) +
+	              shadow_capture_hash_rotl(lanes[2], 12) + shadow_capture_hash_rotl(lanes[3], 18);
+	hash ^= hash >> 33;
+	hash *= SHADOW_CAPTURE_HASH_PRIME2;
+	hash ^= hash >> 29;
+	hash *= SHADOW_CAPTURE_HASH_PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
 
-			if (b < ty)
-				b = (UINT32)ty;
-		}
+WINPR_ATTR_NODISCARD
+static BOOL shadow_capture_hashes_reset(rdpShadowCapture* capture, UINT32 format, UINT32 nWidth,
+                                        UINT32 nHeight)
+{
+	WINPR_ASSERT(capture);
+
+	const size_t ncol = (nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const size_t nrow = (nHeight + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const size_t count = ncol * nrow;
+
+	if (count > capture->tileHashCount)
+	{
+		UINT64* tmp = realloc(capture->tileHashes, count * sizeof(UINT64));
+		if (!tmp)
+			return FALSE;
+		capture->tileHashes = tmp;
+		capture->tileHashCount = count;
+	}
+
+	capture->hashWidth = nWidth;
+	capture->hashHeight = nHeight;
+	capture->hashFormat = format;
+	return TRUE;
+}
+
+int shadow_capture_compare_hashed(rdpShadowCapture* capture, const BYTE* WINPR_RESTRICT pData,
+                                  UINT32 format, UINT32 nStep, UINT32 nWidth, UINT32 nHeight,
+                                  REGION16* WINPR_RESTRICT region)
+{
+	BYTE dirty[SHADOW_CAPTURE_MAX_COLUMNS] = WINPR_C_ARRAY_INIT;
+	shadow_tile_region ctx = WINPR_C_ARRAY_INIT;
+	const UINT32 nrow = (nHeight + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const UINT32 ncol = (nWidth + SHADOW_CAPTURE_TILE_SIZE - 1) / SHADOW_CAPTURE_TILE_SIZE;
+	const size_t bpp = FreeRDPGetBytesPerPixel(format);
+	UINT64 mask = UINT64_MAX;
+	int rc = -1;
+
+	WINPR_ASSERT(capture);
+	WINPR_ASSERT(pData);
+	WINPR_ASSERT(region);
+
+	region16_clear(region);
+
+	if ((nWidth > UINT16_MAX) || (nHeight > UINT16_MAX) || (bpp == 0))
+		return -1;
+
+	if ((bpp == 4) && !FreeRDPColorHasAlpha(format))
+	{
+		const UINT64 mask32 = shadow_capture_color_mask(format);
+		mask = (mask32 << 32) | mask32;
 	}
 
-	if (allEqual)
-		return 0;
+	if (!shadow_capture_region_init(&ctx, region, nWidth, nHeight))
+		return -1;
+
+	EnterCriticalSection(&capture->lock);
 
-	WINPR_ASSERT(l * 16 <= UINT16_MAX);
-	WINPR_ASSERT(t * 16 <= UINT16_MAX);
-	WINPR_ASSERT((r + 1) * 16 <= UINT16_MAX);
-	WINPR_ASSERT((b + 1) * 16 <= UINT16_MAX);
-	rect->left = (UINT16)l * 16;
-	rect->top = (UINT16)t * 16;
-	rect->right = (UINT16)(r + 1) * 16;
-	rect->bottom = (UINT16)(b + 1) * 16;
+	/* Without hashes of a previous frame of this size everything changed */
+	const BOOL reset = !capture->tileHashes || (capture->hashWidth != nWidth) ||
+	                   (capture->hashHeight != nHeight) || (capture->hashFormat != format);
+	if (reset && !shadow_capture_hashes_reset(capture, format, nWidth, nHeight))
+		goto fail;
 
-	WINPR_ASSERT(nWidth <= UINT16_MAX);
-	if (rect->right > nWidth)
-		rect->right = (UINT16)nWidth;
+	rc = 0;
+	for (UINT32 ty = 0; ty < nrow; ty++)
+	{
+		const size_t y = 1ULL * ty * SHADOW_CAPTURE_TILE_SIZE;
+		const UINT32 th = MIN(SHADOW_CAPTURE_TILE_SIZE, nHeight - (UINT32)y);
+		UINT64* hashes = &capture->tileHashes[1ULL * ty * ncol];
+		BOOL changed = FALSE;
+
+		for (UINT32 tx = 0; tx < ncol; tx++)
+		{
+			const size_t x = 1ULL * tx * SHADOW_CAPTURE_TILE_SIZE;
+			const size_t tw = MIN(SHADOW_CAPTURE_TILE_SIZE, nWidth - x);
+			const UINT64 hash =
+			    shadow_capture_hash_tile(&pData[y * nStep + x * bpp], nStep, tw * bpp, th, mask);
+
+			dirty[tx] = (reset || (hashes[tx] != hash)) ? 1 : 0;
+			changed |= dirty[tx];
+			hashes[tx] = hash;
+		}
 
-	WINPR_ASSERT(nHeight <= UINT16_MAX);
-	if (rect->bottom > nHeight)
-		rect->bottom = (UINT16)nHeight;
+		if (!changed)
+			continue;
 
-	return 1;
+		rc = 1;
+		if (!shadow_capture_region_add_row(&ctx, ty, dirty, ncol))
+		{
+			rc = -1;
+			break;
+		}
+	}
+
+	if ((rc > 0) && !shadow_capture_region_flush(&ctx))
+		rc = -1;
+
+	/* The stored hashes are only partially updated, start over with the next frame */
+	if (rc < 0)
+		capture->hashWidth = 0;
+
+fail:
+	LeaveCriticalSection(&capture->lock);
+	free(ctx.pending);
+	return rc;
 }
 
 rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
@@ -345,5 +786,6 @@ void shadow_capture_free(rdpShadowCapture* capture)
 		return;
 
 	DeleteCriticalSection(&(capture->lock));
+	free(capture->tileHashes);
 	free(capture);
 }
@@ -24,6 +24,9 @@
 #include <winpr/crt.h>
 #include <winpr/winpr.h>
 #include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#define SHADOW_CAPTURE_TILE_SIZE 16
 
 struct rdp_shadow_capture
 {
@@ -33,19 +36,131 @@ struct rdp_shadow_capture
 	int height;
 
 	CRITICAL_SECTION lock;
+
+	UINT64* tileHashes;
+	size_t tileHashCount;
+	UINT32 hashWidth;
+	UINT32 hashHeight;
+	UINT32 hashFormat;
 };
 
+WINPR_ATTR_NODISCARD
+static inline BOOL shadow_capture_pixels_equal32(const BYTE* WINPR_RESTRICT pData1,
+                                                 const BYTE* WINPR_RESTRICT pData2, UINT32 count,
+                                                 UINT32 mask)
+{
+	for (UINT32 x = 0; x < count; x++)
+	{
+		UINT32 a = 0;
+		UINT32 b = 0;
+		memcpy(&a, &pData1[4ULL * x], sizeof(a));
+		memcpy(&b, &pData2[4ULL * x], sizeof(b));
+		if (((a ^ b) & mask) != 0)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/** Define a \b shadowTileDiffFn from \b EQUAL(pData1, pData2, vmask), which compares
+ *  one row of a full tile. \b vmask is of type \b T and created with \b SETMASK(mask).
+ */
+#define SHADOW_CAPTURE_DEFINE_TILE_DIFF(name, T, SETMASK, EQUAL)                                  \
+	static UINT32 name(const BYTE* WINPR_RESTRICT pData1, UINT32 nStep1,                         \
+	                   const BYTE* WINPR_RESTRICT pData2, UINT32 nStep2, UINT32 nWidth,          \
+	                   UINT32 nHeight, UINT32 mask, BYTE* WINPR_RESTRICT dirty,                  \
+	                   UINT32 dirtyCount)                                                        \
+	{                                                                                            \
+		const T vmask = SETMASK(mask);                                                           \
+		const UINT32 full = nWidth / SHADOW_CAPTURE_TILE_SIZE;                                   \
+		const UINT32 tail = nWidth % SHADOW_CAPTURE_TILE_SIZE;                                   \
+		const UINT32 ncol = full + ((tail != 0) ? 1 : 0);                                        \
+		const size_t tileStep = 4ULL * SHADOW_CAPTURE_TILE_SIZE;                                 \
+		for (UINT32 y = 0; (y < nHeight) && (dirtyCount < ncol); y++)                            \
+		{                                                                                        \
+			for (UINT32 tx = 0; tx < full; tx++)                                                 \
+			{                                                                                    \
+				if (dirty[tx])                                                                   \
+					continue;                                                                    \
+				if (!EQUAL(&pData1[tileStep * tx], &pData2[tileStep * tx], vmask))               \
+				{                                                                                \
+					dirty[tx] = 1;                                                               \
+					dirtyCount++;                                                                \
+				}                                                                                \
+			}                                                                                    \
+			if ((tail != 0) && !dirty[full] &&                                                   \
+			    !shadow_capture_pixels_equal32(&pData1[tileStep * full],                         \
+			                                   &pData2[tileStep * full], tail, mask))            \
+			{                                                                                    \
+				dirty[full] = 1;                                                                 \
+				dirtyCount++;                                                                    \
+			}                                                                                    \
+			pData1 += nStep1;                                                                    \
+			pData2 += nStep2;                                                                    \
+		}                                                                                        \
+		return dirtyCount;                                                                       \
+	}
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+	/** Compare \b nHeight rows of 32bpp pixels tile column by tile column
+	 *
+	 *  \b dirty holds one flag per \b SHADOW_CAPTURE_TILE_SIZE pixel wide column,
+	 *  columns already flagged are skipped and \b dirtyCount is their number.
+	 *  Bits cleared in \b mask are ignored.
+	 *
+	 *  @return The number of flagged columns
+	 */
+	typedef UINT32 (*shadowTileDiffFn)(const BYTE* WINPR_RESTRICT pData1, UINT32 nStep1,
+	                                   const BYTE* WINPR_RESTRICT pData2, UINT32 nStep2,
+	                                   UINT32 nWidth, UINT32 nHeight, UINT32 mask,
+	                                   BYTE* WINPR_RESTRICT dirty, UINT32 dirtyCount);
+
 	void shadow_capture_free(rdpShadowCapture* capture);
 
 	WINPR_ATTR_MALLOC(shadow_capture_free, 1)
 	WINPR_ATTR_NODISCARD
 	rdpShadowCapture* shadow_capture_new(rdpShadowServer* server);
 
+	/** @return The portable tile comparator */
+	WINPR_ATTR_NODISCARD
+	FREERDP_LOCAL shadowTileDiffFn shadow_capture_get_tile_diff_generic(void);
+
+	/** @return The fastest tile comparator for the running CPU */
+	WINPR_ATTR_NODISCARD
+	FREERDP_LOCAL shadowTileDiffFn shadow_capture_get_tile_diff(void);
+
+	FREERDP_LOCAL void shadow_capture_init_sse2_int(shadowTileDiffFn* WINPR_RESTRICT fn);
+	static inline void shadow_capture_init_sse2(shadowTileDiffFn* WINPR_RESTRICT fn)
+	{
+		if (!IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+			return;
+
+		shadow_capture_init_sse2_int(fn);
+	}
+
+#if defined(WITH_AVX2)
+	FREERDP_LOCAL void shadow_capture_init_avx2_int(shadowTileDiffFn* WINPR_RESTRICT fn);
+	static inline void shadow_capture_init_avx2(shadowTileDiffFn* WINPR_RESTRICT fn)
+	{
+		if (!IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+			return;
+
+		shadow_capture_init_avx2_int(fn);
+	}
+#endif
+
+	FREERDP_LOCAL void shadow_capture_init_neon_int(shadowTileDiffFn* WINPR_RESTRICT fn);
+	static inline void shadow_capture_init_neon(shadowTileDiffFn* WINPR_RESTRICT fn)
+	{
+		if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+			return;
+
+		shadow_capture_init_neon_int(fn);
+	}
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,10 @@
 
 #define TAG CLIENT_TAG("shadow")
 
+/* Progressive upgrade passes: time to wait for an idle client and size of one pass */
+#define SHADOW_PROGRESSIVE_UPGRADE_INTERVAL_MS 50
+#define SHADOW_PROGRESSIVE_UPGRADE_SIZE (64u * 1024u)
+
 typedef struct
 {
 	BOOL gfxOpened;
@@ -171,6 +175,14 @@ static inline BOOL shadow_client_rdpgfx_release_surface(rdpShadowClient* client)
 	context = client->rdpgfx;
 	WINPR_ASSERT(context);
 
+	rdpShadowEncoder* encoder = client->encoder;
+	if (encoder && encoder->progressive)
+	{
+		(void)progressive_delete_surface_context(
+		    encoder->progressive, WINPR_ASSERTING_INT_CAST(UINT16, client->surfaceId));
+		encoder->progressiveUpgrade = FALSE;
+	}
+
 	pdu.surfaceId = client->surfaceId++;
 	IFCALLRET(context->DeleteSurface, error, context, &pdu);
 
@@ -1287,11 +1299,13 @@ static BOOL shadow_client_send_av1(rdpShadowClient* client, const BYTE* pSrcData
 WINPR_ATTR_NODISCARD
 static BOOL shadow_client_send_avc444(rdpShadowClient* client, const BYTE* pSrcData,
                                       UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nWidth,
-                                      UINT16 nHeight, RDPGFX_SURFACE_COMMAND* cmd,
+                                      UINT16 nHeight, const REGION16* damage,
+                                      RDPGFX_SURFACE_COMMAND* cmd,
                                       const RDPGFX_START_FRAME_PDU* cmdstart,
                                       const RDPGFX_END_FRAME_PDU* cmdend)
 {
 	WINPR_ASSERT(client);
+	WINPR_ASSERT(damage);
 
 	rdpShadowEncoder* encoder = client->encoder;
 	WINPR_ASSERT(encoder);
@@ -1299,7 +1313,8 @@ static BOOL shadow_client_send_avc444(rdpShadowClient* client, const BYTE* pSrcD
 	UINT error = CHANNEL_RC_OK;
 	INT32 rc = 0;
 	RDPGFX_AVC444_BITMAP_STREAM avc444 = WINPR_C_ARRAY_INIT;
-	RECTANGLE_16 regionRect = WINPR_C_ARRAY_INIT;
+	UINT32 numDamageRects = 0;
+	const RECTANGLE_16* damageRects = region16_rects(damage, &numDamageRects);
 	const BOOL GfxAVC444v2 = (cmd->codecId == RDPGFX_CODECID_AVC444v2);
 	BYTE version = GfxAVC444v2 ? 2 : 1;
 
@@ -1309,19 +1324,12 @@ static BOOL shadow_client_send_avc444(rdpShadowClient* client, const BYTE* pSrcD
 		return FALSE;
 	}
 
-	WINPR_ASSERT(cmd->left <= UINT16_MAX);
-	WINPR_ASSERT(cmd->top <= UINT16_MAX);
-	WINPR_ASSERT(cmd->right <= UINT16_MAX);
-	WINPR_ASSERT(cmd->bottom <= UINT16_MAX);
-	regionRect.left = (UINT16)cmd->left;
-	regionRect.top = (UINT16)cmd->top;
-	regionRect.right = (UINT16)cmd->right;
-	regionRect.bottom = (UINT16)cmd->bottom;
-	rc = avc444_compress(encoder->h264, pSrcData, SrcFormat, nSrcStep, nWidth, nHeight, version,
-	                     &regionRect, &avc444.LC, &avc444.bitstream[0].data,
-	                     &avc444.bitstream[0].length, &avc444.bitstream[1].data,
-	                     &avc444.bitstream[1].length, &avc444.bitstream[0].meta,
-	                     &avc444.bitstream[1].meta);
+	/* only the damaged parts are converted, unchanged macroblocks are left to the encoder */
+	rc = avc444_compress_region(encoder->h264, pSrcData, SrcFormat, nSrcStep, nWidth, nHeight,
+	                            version, damageRects, numDamageRects, &avc444.LC,
+	                            &avc444.bitstream[0].data, &avc444.bitstream[0].length,
+	                            &avc444.bitstream[1].data, &avc444.bitstream[1].length,
+	                            &avc444.bitstream[0].meta, &avc444.bitstream[1].meta);
 	if (rc < 0)
 	{
 		WLog_ERR(TAG, "avc420_compress failed for avc444");
@@ -1351,11 +1359,13 @@ static BOOL shadow_client_send_avc444(rdpShadowClient* client, const BYTE* pSrcD
 WINPR_ATTR_NODISCARD
 static BOOL shadow_client_send_avc420(rdpShadowClient* client, const BYTE* pSrcData,
                                       UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nWidth,
-                                      UINT16 nHeight, RDPGFX_SURFACE_COMMAND* cmd,
+                                      UINT16 nHeight, const REGION16* damage,
+                                      RDPGFX_SURFACE_COMMAND* cmd,
                                       const RDPGFX_START_FRAME_PDU* cmdstart,
                                       const RDPGFX_END_FRAME_PDU* cmdend)
 {
 	WINPR_ASSERT(client);
+	WINPR_ASSERT(damage);
 
 	rdpShadowEncoder* encoder = client->encoder;
 	WINPR_ASSERT(encoder);
@@ -1363,7 +1373,8 @@ static BOOL shadow_client_send_avc420(rdpShadowClient* client, const BYTE* pSrcD
 	UINT error = CHANNEL_RC_OK;
 	INT32 rc = 0;
 	RDPGFX_AVC420_BITMAP_STREAM avc420 = WINPR_C_ARRAY_INIT;
-	RECTANGLE_16 regionRect;
+	UINT32 numDamageRects = 0;
+	const RECTANGLE_16* damageRects = region16_rects(damage, &numDamageRects);
 
 	if (shadow_encoder_prepare(encoder, FREERDP_CODEC_AVC420) < 0)
 	{
@@ -1371,16 +1382,9 @@ static BOOL shadow_client_send_avc420(rdpShadowClient* client, const BYTE* pSrcD
 		return FALSE;
 	}
 
-	WINPR_ASSERT(cmd->left <= UINT16_MAX);
-	WINPR_ASSERT(cmd->top <= UINT16_MAX);
-	WINPR_ASSERT(cmd->right <= UINT16_MAX);
-	WINPR_ASSERT(cmd->bottom <= UINT16_MAX);
-	regionRect.left = (UINT16)cmd->left;
-	regionRect.top = (UINT16)cmd->top;
-	regionRect.right = (UINT16)cmd->right;
-	regionRect.bottom = (UINT16)cmd->bottom;
-	rc = avc420_compress(encoder->h264, pSrcData, SrcFormat, nSrcStep, nWidth, nHeight, &regionRect,
-	                     &avc420.data, &avc420.length, &avc420.meta);
+	rc = avc420_compress_region(encoder->h264, pSrcData, SrcFormat, nSrcStep, nWidth, nHeight,
+	                            damageRects, numDamageRects, &avc420.data, &avc420.length,
+	                            &avc420.meta);
 	if (rc < 0)
 	{
 		WLog_ERR(TAG, "avc420_compress failed");
@@ -1406,6 +1410,81 @@ static BOOL shadow_client_send_avc420(rdpShadowClient* client, const BYTE* pSrcD
 	return TRUE;
 }
 
+/* Shared encodings are only worth the synchronization with more than one client */
+WINPR_ATTR_NODISCARD
+static rdpShadowEncodeCache* shadow_client_encode_cache(rdpShadowClient* client)
+{
+	WINPR_ASSERT(client);
+
+	rdpShadowServer* server = client->server;
+	if (!server || !server->encodeCache)
+		return nullptr;
+
+	if (ArrayList_Count(server->clients) < 2)
+		return nullptr;
+	return server->encodeCache;
+}
+
+WINPR_ATTR_NODISCARD
+static SHADOW_ENCODED_DATA*
+shadow_client_encode_cache_acquire(rdpShadowEncodeCache* cache, UINT32 codecId, UINT32 params,
+                                   const BYTE* pSrcData, UINT32 nSrcStep, UINT32 SrcFormat,
+                                   const RDPGFX_SURFACE_COMMAND* cmd, BOOL* produce)
+{
+	WINPR_ASSERT(cmd);
+
+	if (!cache)
+		return nullptr;
+
+	const SHADOW_ENCODE_KEY key = { .codecId = codecId,
+		                            .params = params,
+		                            .data = pSrcData,
+		                            .step = nSrcStep,
+		                            .format = SrcFormat,
+		                            .rect = { .left = WINPR_ASSERTING_INT_CAST(UINT16, cmd->left),
+		                                      .top = WINPR_ASSERTING_INT_CAST(UINT16, cmd->top),
+		                                      .right = WINPR_ASSERTING_INT_CAST(UINT16, cmd->right),
+		                                      .bottom =
+		                                          WINPR_ASSERTING_INT_CAST(UINT16, cmd->bottom) },
+		                            .width = cmd->width,
+		                            .height = cmd->height };
+	return shadow_encode_cache_acquire(cache, &key, produce);
+}
+
+WINPR_ATTR_NODISCARD
+static BOOL shadow_client_send_encoded(rdpShadowClient* client, rdpShadowEncodeCache* cache,
+                                       SHADOW_ENCODED_DATA* encoded, UINT32 codecId,
+                                       RDPGFX_SURFACE_COMMAND* cmd,
+                                       const RDPGFX_START_FRAME_PDU* cmdstart,
+                                       const RDPGFX_END_FRAME_PDU* cmdend)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(encoded);
+	WINPR_ASSERT(cmd);
+
+	UINT error = CHANNEL_RC_OK;
+
+	/* An empty encoding means nothing changed for this codec */
+	if (encoded->length > 0)
+	{
+		cmd->codecId = codecId;
+		cmd->data = encoded->data;
+		cmd->length = encoded->length;
+
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, cmdstart,
+		          cmdend);
+		cmd->data = nullptr;
+	}
+
+	shadow_encode_cache_release(cache, encoded);
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 WINPR_ATTR_NODISCARD
 static BOOL shadow_client_send_rfx(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
                                    UINT32 SrcFormat, UINT16 nWidth, UINT16 nHeight,
@@ -1436,6 +1515,22 @@ static BOOL shadow_client_send_rfx(rdpShadowClient* client, const BYTE* pSrcData
 		return FALSE;
 	}
 
+	BOOL produce = FALSE;
+	rdpShadowEncodeCache* cache = shadow_client_encode_cache(client);
+	SHADOW_ENCODED_DATA* encoded = shadow_client_encode_cache_acquire(
+	    cache, RDPGFX_CODECID_CAVIDEO, rfx_context_get_mode(encoder->rfx), pSrcData, nSrcStep,
+	    SrcFormat, cmd, &produce);
+	if (encoded && !produce)
+		return shadow_client_send_encoded(client, cache, encoded, RDPGFX_CODECID_CAVIDEO, cmd,
+		                                  cmdstart, cmdend);
+
+	/* A shared message must be decodable by every client, so it always carries the headers */
+	if (encoded && !rfx_context_reset(encoder->rfx, nWidth, nHeight))
+	{
+		shadow_encode_cache_abort(cache, encoded);
+		return FALSE;
+	}
+
 	wStream* s = Stream_New(nullptr, 1024);
 	WINPR_ASSERT(s);
 
@@ -1454,9 +1549,22 @@ static BOOL shadow_client_send_rfx(rdpShadowClient* client, const BYTE* pSrcData
 	{
 		WLog_ERR(TAG, "rfx_compose_message failed");
 		Stream_Free(s, TRUE);
+		if (encoded)
+			shadow_encode_cache_abort(cache, encoded);
 		return FALSE;
 	}
 
+	if (encoded)
+	{
+		const size_t pos = Stream_GetPosition(s);
+		WINPR_ASSERT(pos <= UINT32_MAX);
+
+		shadow_encode_cache_publish(cache, encoded, Stream_Buffer(s), (UINT32)pos);
+		Stream_Free(s, FALSE);
+		return shadow_client_send_encoded(client, cache, encoded, RDPGFX_CODECID_CAVIDEO, cmd,
+		                                  cmdstart, cmdend);
+	}
+
 	/* rc > 0 means new data */
 	if (rc > 0)
 	{
@@ -1481,10 +1589,125 @@ static BOOL shadow_client_send_rfx(rdpShadowClient* client, const BYTE* pSrcData
 	return TRUE;
 }
 
+/* Send the damaged tiles at a coarse quality, shadow_client_send_progressive_upgrade refines
+ * them later. The coefficients are kept per client, so the passes are never shared. */
+WINPR_ATTR_NODISCARD
+static BOOL shadow_client_send_progressive_first(rdpShadowClient* client, const BYTE* pSrcData,
+                                                 UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nWidth,
+                                                 UINT16 nHeight, const REGION16* damage,
+                                                 RDPGFX_SURFACE_COMMAND* cmd,
+                                                 const RDPGFX_START_FRAME_PDU* cmdstart,
+                                                 const RDPGFX_END_FRAME_PDU* cmdend)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(cmd);
+	WINPR_ASSERT(cmdstart);
+
+	UINT error = CHANNEL_RC_OK;
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	const int rc = progressive_compress_first(
+	    encoder->progressive, WINPR_ASSERTING_INT_CAST(UINT16, cmd->surfaceId), pSrcData,
+	    nSrcStep * nHeight, SrcFormat, nWidth, nHeight, nSrcStep, damage, &cmd->data, &cmd->length);
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "progressive_compress_first failed");
+		return FALSE;
+	}
+
+	if (rc > 0)
+	{
+		cmd->codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, cmdstart,
+		          cmdend);
+		encoder->progressiveUpgrade = TRUE;
+		encoder->progressiveFrameId = cmdstart->frameId;
+	}
+	cmd->data = nullptr;
+
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+WINPR_ATTR_NODISCARD
+static BOOL shadow_client_progressive_upgrade_pending(const rdpShadowClient* client,
+                                                      const SHADOW_GFX_STATUS* pStatus)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(pStatus);
+
+	const rdpShadowEncoder* encoder = client->encoder;
+	if (!encoder || !encoder->progressive || !encoder->progressiveUpgrade)
+		return FALSE;
+	return client->activated && !client->suppressOutput && pStatus->gfxSurfaceCreated;
+}
+
+/* Refine the coarsest tiles by one quality level once the client acknowledged the previous
+ * pass. New frames always take precedence, they are sent before the acknowledgement. */
+WINPR_ATTR_NODISCARD
+static BOOL shadow_client_send_progressive_upgrade(rdpShadowClient* client,
+                                                   const SHADOW_GFX_STATUS* pStatus)
+{
+	UINT error = CHANNEL_RC_OK;
+	RDPGFX_SURFACE_COMMAND cmd = WINPR_C_ARRAY_INIT;
+	RDPGFX_START_FRAME_PDU cmdstart = WINPR_C_ARRAY_INIT;
+	RDPGFX_END_FRAME_PDU cmdend = WINPR_C_ARRAY_INIT;
+	SYSTEMTIME sTime = WINPR_C_ARRAY_INIT;
+
+	if (!shadow_client_progressive_upgrade_pending(client, pStatus))
+		return TRUE;
+
+	rdpShadowEncoder* encoder = client->encoder;
+	if ((encoder->queueDepth != SUSPEND_FRAME_ACKNOWLEDGEMENT) &&
+	    ((INT32)(encoder->lastAckframeId - encoder->progressiveFrameId) < 0))
+		return TRUE;
+
+	const int rc = progressive_compress_upgrade(
+	    encoder->progressive, WINPR_ASSERTING_INT_CAST(UINT16, client->surfaceId),
+	    SHADOW_PROGRESSIVE_UPGRADE_SIZE, &cmd.data, &cmd.length);
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "progressive_compress_upgrade failed");
+		return FALSE;
+	}
+
+	if (rc == 0)
+	{
+		encoder->progressiveUpgrade = FALSE;
+		return TRUE;
+	}
+
+	cmdstart.frameId = shadow_encoder_create_frame_id(encoder);
+	GetSystemTime(&sTime);
+	cmdstart.timestamp = (UINT32)(sTime.wHour << 22U | sTime.wMinute << 16U | sTime.wSecond << 10U |
+	                              sTime.wMilliseconds);
+	cmdend.frameId = cmdstart.frameId;
+	cmd.surfaceId = client->surfaceId;
+	cmd.codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+	cmd.format = PIXEL_FORMAT_BGRX32;
+	encoder->progressiveFrameId = cmdstart.frameId;
+
+	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
+	          &cmdend);
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 WINPR_ATTR_NODISCARD
 static BOOL shadow_client_send_progressive(rdpShadowClient* client, const BYTE* pSrcData,
                                            UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nWidth,
-                                           UINT16 nHeight, RDPGFX_SURFACE_COMMAND* cmd,
+                                           UINT16 nHeight, const REGION16* damage,
+                                           RDPGFX_SURFACE_COMMAND* cmd,
                                            const RDPGFX_START_FRAME_PDU* cmdstart,
                                            const RDPGFX_END_FRAME_PDU* cmdend)
 {
@@ -1504,6 +1727,10 @@ static BOOL shadow_client_send_progressive(rdpShadowClient* client, const BYTE*
 		return FALSE;
 	}
 
+	if (client->server && client->server->GfxProgressivePasses)
+		return shadow_client_send_progressive_first(client, pSrcData, nSrcStep, SrcFormat, nWidth,
+		                                            nHeight, damage, cmd, cmdstart, cmdend);
+
 	WINPR_ASSERT(cmd->left <= UINT16_MAX);
 	WINPR_ASSERT(cmd->top <= UINT16_MAX);
 	WINPR_ASSERT(cmd->right <= UINT16_MAX);
@@ -1512,10 +1739,22 @@ static BOOL shadow_client_send_progressive(rdpShadowClient* client, const BYTE*
 	regionRect.top = (UINT16)cmd->top;
 	regionRect.right = (UINT16)cmd->right;
 	regionRect.bottom = (UINT16)cmd->bottom;
+
+	BOOL produce = FALSE;
+	rdpShadowEncodeCache* cache = shadow_client_encode_cache(client);
+	SHADOW_ENCODED_DATA* encoded =
+	    shadow_client_encode_cache_acquire(cache, RDPGFX_CODECID_CAPROGRESSIVE, 0, pSrcData,
+	                                       nSrcStep, SrcFormat, cmd, &produce);
+	if (encoded && !produce)
+		return shadow_client_send_encoded(client, cache, encoded, RDPGFX_CODECID_CAPROGRESSIVE,
+		                                  cmd, cmdstart, cmdend);
+
 	region16_init(&region);
 	if (!region16_union_rect(&region, &region, &regionRect))
 	{
 		region16_uninit(&region);
+		if (encoded)
+			shadow_encode_cache_abort(cache, encoded);
 		return FALSE;
 	}
 	rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight, SrcFormat, nWidth,
@@ -1524,9 +1763,33 @@ static BOOL shadow_client_send_progressive(rdpShadowClient* client, const BYTE*
 	if (rc < 0)
 	{
 		WLog_ERR(TAG, "progressive_compress failed");
+		if (encoded)
+			shadow_encode_cache_abort(cache, encoded);
 		return FALSE;
 	}
 
+	if (encoded)
+	{
+		/* The progressive output buffer belongs to the context, publish a copy */
+		BYTE* data = nullptr;
+		const UINT32 length = (rc > 0) ? cmd->length : 0;
+		if (length > 0)
+		{
+			data = malloc(length);
+			if (!data)
+			{
+				shadow_encode_cache_abort(cache, encoded);
+				return FALSE;
+			}
+			memcpy(data, cmd->data, length);
+		}
+		cmd->data = nullptr;
+
+		shadow_encode_cache_publish(cache, encoded, data, length);
+		return shadow_client_send_encoded(client, cache, encoded, RDPGFX_CODECID_CAPROGRESSIVE,
+		                                  cmd, cmdstart, cmdend);
+	}
+
 	/* rc > 0 means new data */
 	if (rc > 0)
 	{
@@ -1568,9 +1831,25 @@ static BOOL shadow_client_send_planar(rdpShadowClient* client, const BYTE* pSrcD
 		return FALSE;
 	}
 
+	/* The planar header flags depend on the client settings */
+	const rdpSettings* settings = ((rdpContext*)client)->settings;
+	const UINT32 params = freerdp_settings_get_bool(settings, FreeRDP_DrawAllowSkipAlpha) ? 1 : 0;
+
+	BOOL produce = FALSE;
+	rdpShadowEncodeCache* cache = shadow_client_encode_cache(client);
+	SHADOW_ENCODED_DATA* encoded = shadow_client_encode_cache_acquire(
+	    cache, RDPGFX_CODECID_PLANAR, params, pSrcData, nSrcStep, SrcFormat, cmd, &produce);
+	if (encoded && !produce)
+		return shadow_client_send_encoded(client, cache, encoded, RDPGFX_CODECID_PLANAR, cmd,
+		                                  cmdstart, cmdend);
+
 	const BOOL rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
 	if (!rc)
+	{
+		if (encoded)
+			shadow_encode_cache_abort(cache, encoded);
 		return FALSE;
+	}
 
 	freerdp_planar_topdown_image(encoder->planar, TRUE);
 
@@ -1578,6 +1857,19 @@ static BOOL shadow_client_send_planar(rdpShadowClient* client, const BYTE* pSrcD
 	                                           nullptr, &cmd->length);
 	WINPR_ASSERT(cmd->data || (cmd->length == 0));
 
+	if (encoded)
+	{
+		if (!cmd->data)
+			shadow_encode_cache_abort(cache, encoded);
+		else
+		{
+			shadow_encode_cache_publish(cache, encoded, cmd->data, cmd->length);
+			cmd->data = nullptr;
+			return shadow_client_send_encoded(client, cache, encoded, RDPGFX_CODECID_PLANAR, cmd,
+			                                  cmdstart, cmdend);
+		}
+	}
+
 	cmd->codecId = RDPGFX_CODECID_PLANAR;
 
 	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, cmdstart, cmdend);
@@ -1592,6 +1884,53 @@ static BOOL shadow_client_send_planar(rdpShadowClient* client, const BYTE* pSrcD
 	return TRUE;
 }
 
+WINPR_ATTR_NODISCARD
+static BOOL shadow_client_send_clear(rdpShadowClient* client, const BYTE* pSrcData, UINT32 nSrcStep,
+                                     UINT32 SrcFormat, RDPGFX_SURFACE_COMMAND* cmd,
+                                     const RDPGFX_START_FRAME_PDU* cmdstart,
+                                     const RDPGFX_END_FRAME_PDU* cmdend)
+{
+	WINPR_ASSERT(client);
+
+	rdpShadowEncoder* encoder = client->encoder;
+	WINPR_ASSERT(encoder);
+
+	UINT error = CHANNEL_RC_OK;
+	const UINT32 w = cmd->right - cmd->left;
+	const UINT32 h = cmd->bottom - cmd->top;
+	const BYTE* src =
+	    &pSrcData[cmd->top * nSrcStep + cmd->left * FreeRDPGetBytesPerPixel(SrcFormat)];
+	if (shadow_encoder_prepare(encoder, FREERDP_CODEC_CLEARCODEC) < 0)
+	{
+		WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_CLEARCODEC");
+		return FALSE;
+	}
+
+	wStream* s = encoder->bs;
+	Stream_ResetPosition(s);
+
+	const INT32 rc = clear_compress_to_stream(encoder->clear, s, src, SrcFormat, nSrcStep, w, h);
+	if (rc < 0)
+	{
+		WLog_ERR(TAG, "clear_compress_to_stream failed with %" PRId32, rc);
+		return FALSE;
+	}
+
+	cmd->data = Stream_Buffer(s);
+	cmd->length = WINPR_ASSERTING_INT_CAST(UINT32, Stream_GetPosition(s));
+	cmd->codecId = RDPGFX_CODECID_CLEARCODEC;
+
+	IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, cmdstart, cmdend);
+	cmd->data = nullptr;
+
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 WINPR_ATTR_NODISCARD
 static BOOL shadow_client_send_uncompressed(rdpShadowClient* client, const BYTE* pSrcData,
                                             UINT32 nSrcStep, UINT32 SrcFormat,
@@ -1672,7 +2011,8 @@ static BOOL shadow_avc420_enabled(const rdpShadowClient* client)
 WINPR_ATTR_NODISCARD
 static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE* pSrcData,
                                            UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nXSrc,
-                                           UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight)
+                                           UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight,
+                                           const REGION16* damage)
 {
 	const rdpContext* context = (const rdpContext*)client;
 	RDPGFX_SURFACE_COMMAND cmd = WINPR_C_ARRAY_INIT;
@@ -1680,7 +2020,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	RDPGFX_END_FRAME_PDU cmdend = WINPR_C_ARRAY_INIT;
 	SYSTEMTIME sTime = WINPR_C_ARRAY_INIT;
 
-	if (!context || !pSrcData)
+	if (!context || !pSrcData || !damage)
 		return FALSE;
 
 	const rdpSettings* settings = context->settings;
@@ -1735,18 +2075,24 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		{
 			cmd.codecId = GfxAVC444v2 ? RDPGFX_CODECID_AVC444v2 : RDPGFX_CODECID_AVC444;
 			return shadow_client_send_avc444(client, pSrcData, nSrcStep, SrcFormat, nWidth, nHeight,
-			                                 &cmd, &cmdstart, &cmdend);
+			                                 damage, &cmd, &cmdstart, &cmdend);
 		}
 	}
 
 	if (GfxH264 && shadow_avc420_enabled(client))
 	{
 		return shadow_client_send_avc420(client, pSrcData, nSrcStep, SrcFormat, nWidth, nHeight,
-		                                 &cmd, &cmdstart, &cmdend);
+		                                 damage, &cmd, &cmdstart, &cmdend);
 	}
 
 #endif
-	    if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (id != 0))
+	    if (client->server && client->server->GfxClearCodec)
+	{
+		return shadow_client_send_clear(client, pSrcData, nSrcStep, SrcFormat, &cmd, &cmdstart,
+		                                &cmdend);
+	}
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (id != 0))
 	{
 		return shadow_client_send_rfx(client, pSrcData, nSrcStep, SrcFormat, nWidth, nHeight, &cmd,
 		                              &cmdstart, &cmdend);
@@ -1755,7 +2101,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
 	{
 		return shadow_client_send_progressive(client, pSrcData, nSrcStep, SrcFormat, nWidth,
-		                                      nHeight, &cmd, &cmdstart, &cmdend);
+		                                      nHeight, damage, &cmd, &cmdstart, &cmdend);
 	}
 
 	if (freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
@@ -2179,6 +2525,33 @@ out:
 	return ret;
 }
 
+/* The invalid region relative to the shared (sub) surface, GFX encodes it as a whole */
+WINPR_ATTR_NODISCARD
+static BOOL shadow_client_gfx_damage(const rdpShadowServer* server, const REGION16* invalidRegion,
+                                     REGION16* damage)
+{
+	WINPR_ASSERT(server);
+
+	if (!server->shareSubRect)
+		return region16_copy(damage, invalidRegion);
+
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = region16_rects(invalidRegion, &numRects);
+
+	region16_clear(damage);
+	for (UINT32 index = 0; index < numRects; index++)
+	{
+		/* the invalid region was clipped to the sub rect before */
+		const RECTANGLE_16 rect = { .left = rects[index].left - server->subRect.left,
+			                        .top = rects[index].top - server->subRect.top,
+			                        .right = rects[index].right - server->subRect.left,
+			                        .bottom = rects[index].bottom - server->subRect.top };
+		if (!region16_union_rect(damage, damage, &rect))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * Function description
  *
@@ -2197,6 +2570,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	rdpShadowServer* server = nullptr;
 	rdpShadowSurface* surface = nullptr;
 	REGION16 invalidRegion;
+	REGION16 damage;
 	RECTANGLE_16 surfaceRect;
 	const RECTANGLE_16* extents = nullptr;
 	BYTE* pSrcData = nullptr;
@@ -2222,6 +2596,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	{
 		EnterCriticalSection(&(client->lock));
 		region16_init(&invalidRegion);
+		region16_init(&damage);
 
 		const BOOL res = region16_copy(&invalidRegion, &(client->invalidRegion));
 		region16_clear(&(client->invalidRegion));
@@ -2314,8 +2689,9 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 			WINPR_ASSERT(nWidth <= UINT16_MAX);
 			WINPR_ASSERT(nHeight >= 0);
 			WINPR_ASSERT(nHeight <= UINT16_MAX);
-			ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
-			                                     (UINT16)nWidth, (UINT16)nHeight);
+			ret = shadow_client_gfx_damage(server, &invalidRegion, &damage) &&
+			      shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
+			                                     (UINT16)nWidth, (UINT16)nHeight, &damage);
 		}
 		else
 		{
@@ -2352,6 +2728,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 out:
 	LeaveCriticalSection(&surface->lock);
 	region16_uninit(&invalidRegion);
+	region16_uninit(&damage);
 	return ret;
 }
 
@@ -2686,7 +3063,11 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 			events[nCount++] = gfxevent;
 #endif
 
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+		/* Progressive upgrade passes are sent whenever the client is idle */
+		const DWORD timeout = shadow_client_progressive_upgrade_pending(client, &gfxstatus)
+		                          ? SHADOW_PROGRESSIVE_UPGRADE_INTERVAL_MS
+		                          : INFINITE;
+		status = WaitForMultipleObjects(nCount, events, FALSE, timeout);
 
 		if (status == WAIT_FAILED)
 			goto fail;
@@ -2826,6 +3207,12 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 		}
 #endif
 
+		if (!shadow_client_send_progressive_upgrade(client, &gfxstatus))
+		{
+			WLog_ERR(TAG, "Failed to send progressive upgrade");
+			goto fail;
+		}
+
 		if (WaitForSingleObject(MessageQueue_Event(MsgQueue), 0) == WAIT_OBJECT_0)
 		{
 			/* Drain messages. Pointer update could be accumulated. */
@@ -0,0 +1,255 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared encode cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <freerdp/log.h>
+
+#include "shadow_encode_cache.h"
+
+#define TAG SERVER_TAG("shadow.encodecache")
+
+typedef struct S_SHADOW_ENCODE_CACHE_ENTRY SHADOW_ENCODE_CACHE_ENTRY;
+
+struct S_SHADOW_ENCODE_CACHE_ENTRY
+{
+	SHADOW_ENCODED_DATA encoded; /* must be first, handed out to the clients */
+	SHADOW_ENCODE_KEY key;
+	HANDLE doneEvent;
+	BOOL ready;
+	BOOL aborted;
+	BOOL linked;
+	size_t refCount;
+	SHADOW_ENCODE_CACHE_ENTRY* next;
+};
+
+struct rdp_shadow_encode_cache
+{
+	CRITICAL_SECTION lock;
+	SHADOW_ENCODE_CACHE_ENTRY* entries;
+	UINT64 hits;
+	UINT64 misses;
+};
+
+static void shadow_encode_cache_entry_free(SHADOW_ENCODE_CACHE_ENTRY* entry)
+{
+	if (!entry)
+		return;
+
+	if (entry->doneEvent)
+		(void)CloseHandle(entry->doneEvent);
+	free(entry->encoded.data);
+	free(entry);
+}
+
+static BOOL shadow_encode_key_equal(const SHADOW_ENCODE_KEY* a, const SHADOW_ENCODE_KEY* b)
+{
+	return (a->codecId == b->codecId) && (a->params == b->params) && (a->data == b->data) &&
+	       (a->step == b->step) && (a->format == b->format) && (a->width == b->width) &&
+	       (a->height == b->height) && (a->rect.left == b->rect.left) &&
+	       (a->rect.top == b->rect.top) && (a->rect.right == b->rect.right) &&
+	       (a->rect.bottom == b->rect.bottom);
+}
+
+/* cache->lock must be held */
+static void shadow_encode_cache_unlink(rdpShadowEncodeCache* cache,
+                                       SHADOW_ENCODE_CACHE_ENTRY* entry)
+{
+	SHADOW_ENCODE_CACHE_ENTRY** cur = &cache->entries;
+
+	while (*cur)
+	{
+		if (*cur == entry)
+		{
+			*cur = entry->next;
+			break;
+		}
+		cur = &(*cur)->next;
+	}
+
+	entry->next = nullptr;
+	entry->linked = FALSE;
+}
+
+/* cache->lock must be held */
+static void shadow_encode_cache_unref(SHADOW_ENCODE_CACHE_ENTRY* entry)
+{
+	WINPR_ASSERT(entry->refCount > 0);
+	entry->refCount--;
+
+	if ((entry->refCount == 0) && !entry->linked)
+		shadow_encode_cache_entry_free(entry);
+}
+
+rdpShadowEncodeCache* shadow_encode_cache_new(void)
+{
+	rdpShadowEncodeCache* cache = (rdpShadowEncodeCache*)calloc(1, sizeof(rdpShadowEncodeCache));
+
+	if (!cache)
+		return nullptr;
+
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		free(cache);
+		return nullptr;
+	}
+
+	return cache;
+}
+
+void shadow_encode_cache_free(rdpShadowEncodeCache* cache)
+{
+	if (!cache)
+		return;
+
+	shadow_encode_cache_next_frame(cache);
+	WLog_DBG(TAG, "%" PRIu64 " shared encodings reused, %" PRIu64 " produced", cache->hits,
+	         cache->misses);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+void shadow_encode_cache_next_frame(rdpShadowEncodeCache* cache)
+{
+	if (!cache)
+		return;
+
+	EnterCriticalSection(&cache->lock);
+	while (cache->entries)
+	{
+		SHADOW_ENCODE_CACHE_ENTRY* entry = cache->entries;
+		shadow_encode_cache_unlink(cache, entry);
+
+		/* Still referenced entries are freed by the last release */
+		if (entry->refCount == 0)
+			shadow_encode_cache_entry_free(entry);
+	}
+	LeaveCriticalSection(&cache->lock);
+}
+
+SHADOW_ENCODED_DATA* shadow_encode_cache_acquire(rdpShadowEncodeCache* cache,
+                                                 const SHADOW_ENCODE_KEY* key, BOOL* produce)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(key);
+	WINPR_ASSERT(produce);
+
+	*produce = FALSE;
+
+	EnterCriticalSection(&cache->lock);
+	while (1)
+	{
+		SHADOW_ENCODE_CACHE_ENTRY* entry = cache->entries;
+		while (entry && !shadow_encode_key_equal(&entry->key, key))
+			entry = entry->next;
+
+		if (!entry)
+			break;
+
+		entry->refCount++;
+		if (!entry->ready)
+		{
+			/* Another client is encoding this right now, wait for it */
+			LeaveCriticalSection(&cache->lock);
+			(void)WaitForSingleObject(entry->doneEvent, INFINITE);
+			EnterCriticalSection(&cache->lock);
+		}
+
+		if (entry->ready)
+		{
+			cache->hits++;
+			LeaveCriticalSection(&cache->lock);
+			return &entry->encoded;
+		}
+
+		/* The producer gave up, retry and produce it ourselves */
+		WINPR_ASSERT(entry->aborted);
+		shadow_encode_cache_unref(entry);
+	}
+
+	SHADOW_ENCODE_CACHE_ENTRY* entry =
+	    (SHADOW_ENCODE_CACHE_ENTRY*)calloc(1, sizeof(SHADOW_ENCODE_CACHE_ENTRY));
+	if (!entry)
+		goto fail;
+
+	entry->doneEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	if (!entry->doneEvent)
+		goto fail;
+
+	entry->key = *key;
+	entry->refCount = 1;
+	entry->linked = TRUE;
+	entry->next = cache->entries;
+	cache->entries = entry;
+	cache->misses++;
+	LeaveCriticalSection(&cache->lock);
+
+	*produce = TRUE;
+	return &entry->encoded;
+
+fail:
+	LeaveCriticalSection(&cache->lock);
+	shadow_encode_cache_entry_free(entry);
+	return nullptr;
+}
+
+void shadow_encode_cache_publish(rdpShadowEncodeCache* cache, SHADOW_ENCODED_DATA* encoded,
+                                 BYTE* data, UINT32 length)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(encoded);
+
+	SHADOW_ENCODE_CACHE_ENTRY* entry = (SHADOW_ENCODE_CACHE_ENTRY*)encoded;
+
+	EnterCriticalSection(&cache->lock);
+	WINPR_ASSERT(!entry->ready);
+	entry->encoded.data = data;
+	entry->encoded.length = length;
+	entry->ready = TRUE;
+	(void)SetEvent(entry->doneEvent);
+	LeaveCriticalSection(&cache->lock);
+}
+
+void shadow_encode_cache_abort(rdpShadowEncodeCache* cache, SHADOW_ENCODED_DATA* encoded)
+{
+	WINPR_ASSERT(cache);
+	WINPR_ASSERT(encoded);
+
+	SHADOW_ENCODE_CACHE_ENTRY* entry = (SHADOW_ENCODE_CACHE_ENTRY*)encoded;
+
+	EnterCriticalSection(&cache->lock);
+	WINPR_ASSERT(!entry->ready);
+	entry->aborted = TRUE;
+	if (entry->linked)
+		shadow_encode_cache_unlink(cache, entry);
+	(void)SetEvent(entry->doneEvent);
+	shadow_encode_cache_unref(entry);
+	LeaveCriticalSection(&cache->lock);
+}
+
+void shadow_encode_cache_release(rdpShadowEncodeCache* cache, SHADOW_ENCODED_DATA* encoded)
+{
+	if (!cache || !encoded)
+		return;
+
+	SHADOW_ENCODE_CACHE_ENTRY* entry = (SHADOW_ENCODE_CACHE_ENTRY*)encoded;
+
+	EnterCriticalSection(&cache->lock);
+	shadow_encode_cache_unref(entry);
+	LeaveCriticalSection(&cache->lock);
+}
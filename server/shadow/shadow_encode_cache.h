@@ -0,0 +1,89 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared encode cache
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_ENCODE_CACHE_H
+#define FREERDP_SERVER_SHADOW_ENCODE_CACHE_H
+
+#include <freerdp/server/shadow.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+/*
+ * Clients showing the same surface with the same stateless codec configuration
+ * produce identical bitstreams for a frame. The first client to need an encoding
+ * produces it, the others reuse it by reference. Entries live for one frame.
+ */
+
+typedef struct
+{
+	UINT32 codecId; /* RDPGFX_CODECID_* */
+	UINT32 params;  /* codec specific configuration affecting the bitstream */
+	const BYTE* data;
+	UINT32 step;
+	UINT32 format;
+	RECTANGLE_16 rect;
+	UINT32 width;
+	UINT32 height;
+} SHADOW_ENCODE_KEY;
+
+typedef struct
+{
+	BYTE* data;
+	UINT32 length;
+} SHADOW_ENCODED_DATA;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	void shadow_encode_cache_free(rdpShadowEncodeCache* cache);
+
+	WINPR_ATTR_MALLOC(shadow_encode_cache_free, 1)
+	WINPR_ATTR_NODISCARD
+	rdpShadowEncodeCache* shadow_encode_cache_new(void);
+
+	/** Drop the encodings of the previous frame, called before a new frame is published */
+	void shadow_encode_cache_next_frame(rdpShadowEncodeCache* cache);
+
+	/** Look up an encoding of the current frame.
+	 *
+	 *  Waits while another client produces the same encoding. If no encoding exists
+	 *  \b produce is set, the caller must then encode and call \b shadow_encode_cache_publish
+	 *  (or \b shadow_encode_cache_abort) with the returned entry.
+	 *
+	 *  @return A referenced entry, release it with \b shadow_encode_cache_release
+	 */
+	WINPR_ATTR_NODISCARD
+	SHADOW_ENCODED_DATA* shadow_encode_cache_acquire(rdpShadowEncodeCache* cache,
+	                                                 const SHADOW_ENCODE_KEY* key, BOOL* produce);
+
+	/** Complete a produced entry, the cache takes ownership of \b data (allocated with malloc) */
+	void shadow_encode_cache_publish(rdpShadowEncodeCache* cache, SHADOW_ENCODED_DATA* entry,
+	                                 BYTE* data, UINT32 length);
+
+	/** Give up producing an entry, a waiting client produces it instead */
+	void shadow_encode_cache_abort(rdpShadowEncodeCache* cache, SHADOW_ENCODED_DATA* entry);
+
+	void shadow_encode_cache_release(rdpShadowEncodeCache* cache, SHADOW_ENCODED_DATA* entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_ENCODE_CACHE_H */
@@ -163,7 +163,8 @@ static int shadow_encoder_init_nsc(rdpShadowEncoder* encoder)
 	rdpSettings* settings = context->settings;
 
 	if (!encoder->nsc)
-		encoder->nsc = nsc_context_new();
+		encoder->nsc =
+		    nsc_context_new_ex(freerdp_settings_get_uint32(settings, FreeRDP_ThreadingFlags));
 
 	if (!encoder->nsc)
 		goto fail;
@@ -206,8 +207,9 @@ static int shadow_encoder_init_planar(rdpShadowEncoder* encoder)
 
 	if (!encoder->planar)
 	{
-		encoder->planar = freerdp_bitmap_planar_context_new(planarFlags, encoder->maxTileWidth,
-		                                                    encoder->maxTileHeight);
+		encoder->planar = freerdp_bitmap_planar_context_new_ex(
+		    planarFlags, encoder->maxTileWidth, encoder->maxTileHeight,
+		    freerdp_settings_get_uint32(settings, FreeRDP_ThreadingFlags));
 	}
 
 	if (!encoder->planar)
@@ -224,6 +226,26 @@ fail:
 	return -1;
 }
 
+WINPR_ATTR_NODISCARD
+static int shadow_encoder_init_clear(rdpShadowEncoder* encoder)
+{
+	if (!encoder->clear)
+		encoder->clear = clear_context_new(TRUE);
+
+	if (!encoder->clear)
+		goto fail;
+
+	if (!clear_context_reset(encoder->clear))
+		goto fail;
+
+	encoder->codecs |= FREERDP_CODEC_CLEARCODEC;
+	return 1;
+fail:
+	clear_context_free(encoder->clear);
+	encoder->clear = nullptr;
+	return -1;
+}
+
 WINPR_ATTR_NODISCARD
 static int shadow_encoder_init_interleaved(rdpShadowEncoder* encoder)
 {
@@ -388,6 +410,18 @@ static int shadow_encoder_uninit_planar(rdpShadowEncoder* encoder)
 	return 1;
 }
 
+static int shadow_encoder_uninit_clear(rdpShadowEncoder* encoder)
+{
+	if (encoder->clear)
+	{
+		clear_context_free(encoder->clear);
+		encoder->clear = nullptr;
+	}
+
+	encoder->codecs &= (UINT32)~FREERDP_CODEC_CLEARCODEC;
+	return 1;
+}
+
 static int shadow_encoder_uninit_interleaved(rdpShadowEncoder* encoder)
 {
 	if (encoder->interleaved)
@@ -434,6 +468,7 @@ static int shadow_encoder_uninit_progressive(rdpShadowEncoder* encoder)
 		encoder->progressive = nullptr;
 	}
 
+	encoder->progressiveUpgrade = FALSE;
 	encoder->codecs &= (UINT32)~FREERDP_CODEC_PROGRESSIVE;
 	return 1;
 }
@@ -454,6 +489,8 @@ static int shadow_encoder_uninit(rdpShadowEncoder* encoder)
 
 	shadow_encoder_uninit_planar(encoder);
 
+	shadow_encoder_uninit_clear(encoder);
+
 	shadow_encoder_uninit_interleaved(encoder);
 	shadow_encoder_uninit_h264(encoder);
 #if defined(WITH_GFX_AV1)
@@ -525,6 +562,15 @@ int shadow_encoder_prepare(rdpShadowEncoder* encoder, UINT32 codecs)
 			return -1;
 	}
 
+	if ((codecs & FREERDP_CODEC_CLEARCODEC) && !(encoder->codecs & FREERDP_CODEC_CLEARCODEC))
+	{
+		WLog_DBG(TAG, "initializing ClearCodec encoder");
+		status = shadow_encoder_init_clear(encoder);
+
+		if (status < 0)
+			return -1;
+	}
+
 	if ((codecs & FREERDP_CODEC_INTERLEAVED) && !(encoder->codecs & FREERDP_CODEC_INTERLEAVED))
 	{
 		WLog_DBG(TAG, "initializing interleaved bitmap encoder");
@@ -51,6 +51,7 @@ struct rdp_shadow_encoder
 	BITMAP_INTERLEAVED_CONTEXT* interleaved;
 	H264_CONTEXT* h264;
 	PROGRESSIVE_CONTEXT* progressive;
+	CLEAR_CONTEXT* clear;
 #if defined(WITH_GFX_AV1)
 	FREERDP_AV1_CONTEXT* av1;
 #endif
@@ -60,6 +61,9 @@ struct rdp_shadow_encoder
 	UINT32 frameId;
 	UINT32 lastAckframeId;
 	UINT32 queueDepth;
+
+	BOOL progressiveUpgrade;   /* tiles of the progressive surface are below full quality */
+	UINT32 progressiveFrameId; /* frame of the last progressive pass */
 };
 
 #ifdef __cplusplus
@@ -577,6 +577,22 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxPlanar, arg->Value != nullptr))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "gfx-progressive-passes")
+		{
+			server->GfxProgressivePasses = arg->Value != nullptr;
+		}
+		CommandLineSwitchCase(arg, "gfx-clear")
+		{
+			server->GfxClearCodec = arg->Value != nullptr;
+		}
+		CommandLineSwitchCase(arg, "shared-encode")
+		{
+			server->ShareEncodedFrames = arg->Value != nullptr;
+		}
+		CommandLineSwitchCase(arg, "capture-hash")
+		{
+			server->CaptureTileHashes = arg->Value != nullptr;
+		}
 		CommandLineSwitchCase(arg, "gfx-avc420")
 		{
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxH264, arg->Value != nullptr))
@@ -1079,6 +1095,15 @@ int shadow_server_init(rdpShadowServer* server)
 	server->listener->info = (void*)server;
 	server->listener->CheckPeerAcceptRestrictions = shadow_server_check_peer_restrictions;
 	server->listener->PeerAccepted = shadow_client_accepted;
+
+	if (server->ShareEncodedFrames)
+	{
+		server->encodeCache = shadow_encode_cache_new();
+
+		if (!server->encodeCache)
+			goto fail;
+	}
+
 	server->subsystem = shadow_subsystem_new();
 
 	if (!server->subsystem)
@@ -1105,6 +1130,8 @@ int shadow_server_uninit(rdpShadowServer* server)
 	shadow_subsystem_uninit(server->subsystem);
 	shadow_subsystem_free(server->subsystem);
 	server->subsystem = nullptr;
+	shadow_encode_cache_free(server->encodeCache);
+	server->encodeCache = nullptr;
 	freerdp_listener_free(server->listener);
 	server->listener = nullptr;
 	free(server->CertificateFile);
@@ -1138,6 +1165,7 @@ rdpShadowServer* shadow_server_new(void)
 	server->h264FrameRate = 30;
 	server->h264QP = 0;
 	server->authentication = TRUE;
+	server->ShareEncodedFrames = TRUE;
 #if defined(WITH_GFX_AV1)
 	server->AV1BitRate = 500;
 	server->AV1RateControlMode = FREERDP_AV1_VBR;
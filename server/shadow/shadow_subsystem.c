@@ -292,5 +292,10 @@ int shadow_subsystem_pointer_convert_alpha_pointer_data_to_format(
 
 void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem)
 {
+	WINPR_ASSERT(subsystem);
+
+	/* All clients consumed the previous frame, its shared encodings are stale now */
+	if (subsystem->server)
+		shadow_encode_cache_next_frame(subsystem->server->encodeCache);
 	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
 }
@@ -0,0 +1,68 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server Tile Compare - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "../shadow_capture.h"
+
+#include "../../../libfreerdp/core/simd.h"
+
+#define TAG SERVER_TAG("shadow.capture")
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+static inline __m256i shadow_capture_xor_avx2(const BYTE* WINPR_RESTRICT pData1,
+                                              const BYTE* WINPR_RESTRICT pData2)
+{
+	return _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)pData1),
+	                        _mm256_loadu_si256((const __m256i*)pData2));
+}
+
+static inline BOOL shadow_capture_tile_equal_avx2(const BYTE* WINPR_RESTRICT pData1,
+                                                  const BYTE* WINPR_RESTRICT pData2,
+                                                  __m256i vmask)
+{
+	const __m256i d0 = shadow_capture_xor_avx2(&pData1[0], &pData2[0]);
+	const __m256i d1 = shadow_capture_xor_avx2(&pData1[32], &pData2[32]);
+	return _mm256_testz_si256(_mm256_or_si256(d0, d1), vmask) != 0;
+}
+
+static inline __m256i shadow_capture_setmask_avx2(UINT32 mask)
+{
+	return _mm256_set1_epi32((int)mask);
+}
+
+SHADOW_CAPTURE_DEFINE_TILE_DIFF(shadow_capture_tile_diff_avx2, __m256i, shadow_capture_setmask_avx2,
+                                shadow_capture_tile_equal_avx2)
+#endif
+
+void shadow_capture_init_avx2_int(shadowTileDiffFn* WINPR_RESTRICT fn)
+{
+	WINPR_ASSERT(fn);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "AVX2 optimizations");
+	*fn = shadow_capture_tile_diff_avx2;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(fn);
+#endif
+}
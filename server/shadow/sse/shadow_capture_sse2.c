@@ -0,0 +1,73 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shadow Server Tile Compare - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+
+#include <freerdp/log.h>
+
+#include "../shadow_capture.h"
+
+#include "../../../libfreerdp/core/simd.h"
+
+#define TAG SERVER_TAG("shadow.capture")
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+static inline __m128i shadow_capture_xor_sse2(const BYTE* WINPR_RESTRICT pData1,
+                                              const BYTE* WINPR_RESTRICT pData2)
+{
+	return _mm_xor_si128(_mm_loadu_si128((const __m128i*)pData1),
+	                     _mm_loadu_si128((const __m128i*)pData2));
+}
+
+static inline BOOL shadow_capture_tile_equal_sse2(const BYTE* WINPR_RESTRICT pData1,
+                                                  const BYTE* WINPR_RESTRICT pData2,
+                                                  __m128i vmask)
+{
+	const __m128i d0 = shadow_capture_xor_sse2(&pData1[0], &pData2[0]);
+	const __m128i d1 = shadow_capture_xor_sse2(&pData1[16], &pData2[16]);
+	const __m128i d2 = shadow_capture_xor_sse2(&pData1[32], &pData2[32]);
+	const __m128i d3 = shadow_capture_xor_sse2(&pData1[48], &pData2[48]);
+	const __m128i d01 = _mm_or_si128(d0, d1);
+	const __m128i d23 = _mm_or_si128(d2, d3);
+	const __m128i d = _mm_and_si128(_mm_or_si128(d01, d23), vmask);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128())) == 0xFFFF;
+}
+
+static inline __m128i shadow_capture_setmask_sse2(UINT32 mask)
+{
+	return _mm_set1_epi32((int)mask);
+}
+
+SHADOW_CAPTURE_DEFINE_TILE_DIFF(shadow_capture_tile_diff_sse2, __m128i, shadow_capture_setmask_sse2,
+                                shadow_capture_tile_equal_sse2)
+#endif
+
+void shadow_capture_init_sse2_int(shadowTileDiffFn* WINPR_RESTRICT fn)
+{
+	WINPR_ASSERT(fn);
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	WLog_VRB(TAG, "SSE2 optimizations");
+	*fn = shadow_capture_tile_diff_sse2;
+#else
+	WLog_VRB(TAG, "undefined WITH_SIMD or SSE2 intrinsics not available");
+	WINPR_UNUSED(fn);
+#endif
+}
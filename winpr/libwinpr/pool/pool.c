@@ -19,12 +19,16 @@
 
 #include <winpr/config.h>
 
+#include <winpr/assert.h>
 #include <winpr/crt.h>
 #include <winpr/sysinfo.h>
 #include <winpr/pool.h>
 #include <winpr/library.h>
+#include <winpr/interlocked.h>
 
 #include "pool.h"
+#include "../log.h"
+#define TAG WINPR_TAG("pool")
 
 #ifdef WINPR_THREAD_POOL
 
@@ -51,81 +55,566 @@ static BOOL CALLBACK init_module(PINIT_ONCE once, PVOID param, PVOID* context)
 }
 #endif
 
+/**
+ * Every worker owns a Chase-Lev work stealing deque. Work submitted from a pool thread is pushed
+ * to the deque of that thread, work from other threads goes to the pool injection queue, from
+ * where idle workers take it in batches. Workers without local work steal from the top of the
+ * other deques and park on WaitOnAddress (a futex on linux) when the whole pool is idle.
+ */
+#define TP_DEQUE_SIZE 1024
+#define TP_DEQUE_MASK (TP_DEQUE_SIZE - 1)
+#define TP_INJECT_BATCH 32
+#define TP_INSTANCE_CACHE 256
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define tp_memory_barrier() MemoryBarrier()
+#else
+#define tp_memory_barrier() __sync_synchronize()
+#endif
+
+struct S_TP_WORKER
+{
+	PTP_POOL Pool;
+	HANDLE Thread;
+	size_t Index;
+	BOOL Retired; /* protected by Pool->Lock */
+	UINT32 Seed;
+	PTP_CALLBACK_INSTANCE FreeList;
+	size_t FreeCount;
+
+	/* Top is advanced by thieves, Bottom only by the owner. Keep them on separate lines */
+	BYTE Padding0[64];
+	volatile LONG Top;
+	BYTE Padding1[64 - sizeof(LONG)];
+	volatile LONG Bottom;
+	PTP_CALLBACK_INSTANCE Deque[TP_DEQUE_SIZE];
+};
+
 static TP_POOL DEFAULT_POOL = {
-	0,       /* DWORD Minimum */
-	500,     /* DWORD Maximum */
-	nullptr, /* wArrayList* Threads */
-	nullptr, /* wQueue* PendingQueue */
-	nullptr, /* HANDLE TerminateEvent */
-	nullptr, /* wCountdownEvent* WorkComplete */
+	0,   /* DWORD Minimum */
+	500, /* DWORD Maximum */
 };
 
-static DWORD WINAPI thread_pool_work_func(LPVOID arg)
+static INIT_ONCE tp_init_once = INIT_ONCE_STATIC_INIT;
+static DWORD tp_worker_tls = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION tp_default_lock;
+
+static BOOL CALLBACK tp_init(WINPR_ATTR_UNUSED PINIT_ONCE once, WINPR_ATTR_UNUSED PVOID param,
+                             WINPR_ATTR_UNUSED PVOID* context)
 {
-	DWORD status = 0;
-	PTP_POOL pool = nullptr;
-	PTP_WORK work = nullptr;
-	HANDLE events[2];
-	PTP_CALLBACK_INSTANCE callbackInstance = nullptr;
+	tp_worker_tls = TlsAlloc();
+	if (tp_worker_tls == TLS_OUT_OF_INDEXES)
+		return FALSE;
+	return InitializeCriticalSectionAndSpinCount(&tp_default_lock, 4000);
+}
+
+static void tp_park(volatile LONG* address, LONG value)
+{
+#if defined(_WIN32)
+	/* WaitOnAddress is not available on the systems that use this implementation */
+	if (*address == value)
+		Sleep(1);
+#else
+	if (!WaitOnAddress(address, &value, sizeof(value), INFINITE))
+		WLog_WARN(TAG, "WaitOnAddress failed with %" PRIu32, GetLastError());
+#endif
+}
+
+static void tp_unpark(volatile LONG* address, BOOL all)
+{
+#if defined(_WIN32)
+	WINPR_UNUSED(address);
+	WINPR_UNUSED(all);
+#else
+	if (all)
+		WakeByAddressAll((PVOID)address);
+	else
+		WakeByAddressSingle((PVOID)address);
+#endif
+}
 
-	pool = (PTP_POOL)arg;
+static BOOL tp_deque_push(TP_WORKER* worker, PTP_CALLBACK_INSTANCE instance)
+{
+	const LONG bottom = worker->Bottom;
+	const LONG top = worker->Top;
 
-	events[0] = pool->TerminateEvent;
-	events[1] = Queue_Event(pool->PendingQueue);
+	if ((UINT32)bottom - (UINT32)top >= TP_DEQUE_SIZE)
+		return FALSE;
 
-	while (1)
+	worker->Deque[(UINT32)bottom & TP_DEQUE_MASK] = instance;
+	tp_memory_barrier();
+	worker->Bottom = (LONG)((UINT32)bottom + 1);
+	return TRUE;
+}
+
+static PTP_CALLBACK_INSTANCE tp_deque_pop(TP_WORKER* worker)
+{
+	const LONG bottom = (LONG)((UINT32)worker->Bottom - 1);
+	worker->Bottom = bottom;
+	tp_memory_barrier();
+
+	const LONG top = worker->Top;
+	const INT32 size = (INT32)((UINT32)bottom - (UINT32)top);
+	if (size < 0)
 	{
-		status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+		worker->Bottom = (LONG)((UINT32)bottom + 1);
+		return nullptr;
+	}
 
-		if (status == WAIT_OBJECT_0)
-			break;
+	PTP_CALLBACK_INSTANCE instance = worker->Deque[(UINT32)bottom & TP_DEQUE_MASK];
+	if (size > 0)
+		return instance;
 
-		if (status != (WAIT_OBJECT_0 + 1))
-			break;
+	/* Last element, race against the thieves */
+	if (InterlockedCompareExchange(&worker->Top, (LONG)((UINT32)top + 1), top) != top)
+		instance = nullptr;
+	worker->Bottom = (LONG)((UINT32)top + 1);
+	return instance;
+}
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue);
+static PTP_CALLBACK_INSTANCE tp_deque_steal(TP_WORKER* worker)
+{
+	const LONG top = worker->Top;
+	tp_memory_barrier();
+	const LONG bottom = worker->Bottom;
+	tp_memory_barrier();
 
-		if (callbackInstance)
+	if ((INT32)((UINT32)bottom - (UINT32)top) <= 0)
+		return nullptr;
+
+	PTP_CALLBACK_INSTANCE instance = worker->Deque[(UINT32)top & TP_DEQUE_MASK];
+	if (InterlockedCompareExchange(&worker->Top, (LONG)((UINT32)top + 1), top) != top)
+		return nullptr;
+	return instance;
+}
+
+static BOOL tp_deque_empty(const TP_WORKER* worker)
+{
+	return (INT32)((UINT32)worker->Bottom - (UINT32)worker->Top) <= 0;
+}
+
+/* QueueLock must be held */
+static void tp_queue_push(PTP_POOL pool, PTP_CALLBACK_INSTANCE instance)
+{
+	instance->Next = nullptr;
+	if (pool->QueueTail)
+		pool->QueueTail->Next = instance;
+	else
+		pool->QueueHead = instance;
+	pool->QueueTail = instance;
+	pool->QueueCount++;
+}
+
+/* QueueLock must be held */
+static PTP_CALLBACK_INSTANCE tp_queue_pop(PTP_POOL pool)
+{
+	PTP_CALLBACK_INSTANCE instance = pool->QueueHead;
+	if (!instance)
+		return nullptr;
+
+	pool->QueueHead = instance->Next;
+	if (!pool->QueueHead)
+		pool->QueueTail = nullptr;
+	pool->QueueCount--;
+	instance->Next = nullptr;
+	return instance;
+}
+
+static void tp_instance_list_free(PTP_CALLBACK_INSTANCE instance)
+{
+	while (instance)
+	{
+		PTP_CALLBACK_INSTANCE next = instance->Next;
+		free(instance);
+		instance = next;
+	}
+}
+
+static PTP_CALLBACK_INSTANCE tp_worker_instance_new(TP_WORKER* worker)
+{
+	PTP_POOL pool = worker->Pool;
+
+	if (!worker->FreeList)
+	{
+		EnterCriticalSection(&pool->QueueLock);
+		for (size_t x = 0; (x < TP_INJECT_BATCH) && pool->FreeList; x++)
 		{
-			work = callbackInstance->Work;
-			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
-			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			PTP_CALLBACK_INSTANCE instance = pool->FreeList;
+			pool->FreeList = instance->Next;
+			instance->Next = worker->FreeList;
+			worker->FreeList = instance;
+			worker->FreeCount++;
 		}
+		LeaveCriticalSection(&pool->QueueLock);
 	}
 
+	PTP_CALLBACK_INSTANCE instance = worker->FreeList;
+	if (!instance)
+		return (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+
+	worker->FreeList = instance->Next;
+	worker->FreeCount--;
+	instance->Next = nullptr;
+	return instance;
+}
+
+static void tp_worker_instance_free(TP_WORKER* worker, PTP_CALLBACK_INSTANCE instance)
+{
+	instance->Work = nullptr;
+	instance->Next = worker->FreeList;
+	worker->FreeList = instance;
+	worker->FreeCount++;
+
+	if (worker->FreeCount <= TP_INSTANCE_CACHE)
+		return;
+
+	/* Return half of the cache, external submitters allocate from the pool free list */
+	PTP_POOL pool = worker->Pool;
+	EnterCriticalSection(&pool->QueueLock);
+	while (worker->FreeCount > TP_INSTANCE_CACHE / 2)
+	{
+		PTP_CALLBACK_INSTANCE cur = worker->FreeList;
+		worker->FreeList = cur->Next;
+		worker->FreeCount--;
+		cur->Next = pool->FreeList;
+		pool->FreeList = cur;
+	}
+	LeaveCriticalSection(&pool->QueueLock);
+}
+
+static void tp_notify(PTP_POOL pool)
+{
+	tp_memory_barrier();
+	if (pool->Sleepers <= 0)
+		return;
+
+	InterlockedIncrement(&pool->ParkSequence);
+	tp_unpark(&pool->ParkSequence, FALSE);
+}
+
+static void tp_work_complete(PTP_WORK work)
+{
+	/* work might be closed as soon as Pending drops, the wakeup only uses the address */
+	if (InterlockedDecrement(&work->Pending) == TP_WORK_WAITER_FLAG)
+		tp_unpark(&work->Pending, TRUE);
+}
+
+static PTP_CALLBACK_INSTANCE tp_take_injected(PTP_POOL pool, TP_WORKER* worker)
+{
+	if (pool->QueueCount <= 0)
+		return nullptr;
+
+	size_t moved = 0;
+	EnterCriticalSection(&pool->QueueLock);
+	PTP_CALLBACK_INSTANCE instance = tp_queue_pop(pool);
+	if (instance)
+	{
+		/* Take a fair share to the local deque, other workers steal from there */
+		size_t batch = (size_t)pool->QueueCount / pool->WorkerCount + 1;
+		if (batch > TP_INJECT_BATCH)
+			batch = TP_INJECT_BATCH;
+
+		for (; moved < batch; moved++)
+		{
+			PTP_CALLBACK_INSTANCE cur = tp_queue_pop(pool);
+			if (!cur)
+				break;
+			if (!tp_deque_push(worker, cur))
+			{
+				tp_queue_push(pool, cur);
+				break;
+			}
+		}
+	}
+	LeaveCriticalSection(&pool->QueueLock);
+
+	if (moved > 0)
+		tp_notify(pool);
+	return instance;
+}
+
+/* The array only grows and replaced arrays stay valid, read the count before the array */
+static TP_WORKER** tp_get_workers(PTP_POOL pool, size_t* count)
+{
+	*count = pool->WorkerCount;
+	tp_memory_barrier();
+	return pool->Workers;
+}
+
+static PTP_CALLBACK_INSTANCE tp_steal(PTP_POOL pool, TP_WORKER* worker)
+{
+	size_t count = 0;
+	TP_WORKER** workers = tp_get_workers(pool, &count);
+
+	/* xorshift32, spreads the thieves over the victims */
+	worker->Seed ^= worker->Seed << 13;
+	worker->Seed ^= worker->Seed >> 17;
+	worker->Seed ^= worker->Seed << 5;
+
+	const size_t start = worker->Seed % count;
+	for (size_t x = 0; x < count; x++)
+	{
+		TP_WORKER* victim = workers[(start + x) % count];
+		if (victim == worker)
+			continue;
+
+		PTP_CALLBACK_INSTANCE instance = tp_deque_steal(victim);
+		if (instance)
+			return instance;
+	}
+
+	return nullptr;
+}
+
+static BOOL tp_has_work(PTP_POOL pool)
+{
+	if (pool->QueueCount > 0)
+		return TRUE;
+
+	size_t count = 0;
+	TP_WORKER** workers = tp_get_workers(pool, &count);
+	for (size_t x = 0; x < count; x++)
+	{
+		if (!tp_deque_empty(workers[x]))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void tp_wait_for_work(PTP_POOL pool)
+{
+	const LONG sequence = pool->ParkSequence;
+	InterlockedIncrement(&pool->Sleepers);
+
+	/* A submitter either sees us sleeping and bumps the sequence, or we see its work here */
+	if (!pool->Terminate && !tp_has_work(pool))
+		tp_park(&pool->ParkSequence, sequence);
+
+	InterlockedDecrement(&pool->Sleepers);
+}
+
+/* Idle workers above the limit exit on their own, shrinking never waits for callbacks */
+static BOOL tp_worker_retire(PTP_POOL pool, TP_WORKER* worker)
+{
+	if (worker->Index < pool->Limit)
+		return FALSE;
+
+	EnterCriticalSection(&pool->Lock);
+	const BOOL retire = (worker->Index >= pool->Limit);
+	if (retire)
+		worker->Retired = TRUE;
+	LeaveCriticalSection(&pool->Lock);
+	return retire;
+}
+
+static DWORD WINAPI thread_pool_work_func(LPVOID arg)
+{
+	TP_WORKER* worker = (TP_WORKER*)arg;
+	WINPR_ASSERT(worker);
+
+	PTP_POOL pool = worker->Pool;
+	WINPR_ASSERT(pool);
+
+	if (!TlsSetValue(tp_worker_tls, worker))
+		WLog_WARN(TAG, "TlsSetValue failed, nested work is queued globally");
+
+	while (!pool->Terminate)
+	{
+		PTP_CALLBACK_INSTANCE callbackInstance = tp_deque_pop(worker);
+
+		if (!callbackInstance)
+			callbackInstance = tp_take_injected(pool, worker);
+
+		if (!callbackInstance)
+			callbackInstance = tp_steal(pool, worker);
+
+		if (!callbackInstance)
+		{
+			if (tp_worker_retire(pool, worker))
+				break;
+
+			tp_wait_for_work(pool);
+			continue;
+		}
+
+		PTP_WORK work = callbackInstance->Work;
+		work->WorkCallback(callbackInstance, work->CallbackParameter, work);
+		tp_worker_instance_free(worker, callbackInstance);
+		tp_work_complete(work);
+	}
+
+	/* Hand unfinished work and cached instances back to the pool */
+	EnterCriticalSection(&pool->QueueLock);
+	PTP_CALLBACK_INSTANCE instance = nullptr;
+	while ((instance = tp_deque_pop(worker)))
+		tp_queue_push(pool, instance);
+
+	while (worker->FreeList)
+	{
+		instance = worker->FreeList;
+		worker->FreeList = instance->Next;
+		instance->Next = pool->FreeList;
+		pool->FreeList = instance;
+	}
+	worker->FreeCount = 0;
+	LeaveCriticalSection(&pool->QueueLock);
+
+	if (!TlsSetValue(tp_worker_tls, nullptr))
+		WLog_WARN(TAG, "TlsSetValue failed");
 	ExitThread(0);
 	return 0;
 }
 
-static void threads_close(void* thread)
+/* pool->Lock must be held */
+static void tp_pool_stop(PTP_POOL pool)
+{
+	pool->Terminate = 1;
+	InterlockedIncrement(&pool->ParkSequence);
+	tp_unpark(&pool->ParkSequence, TRUE);
+
+	for (size_t x = 0; x < pool->WorkerCount; x++)
+	{
+		TP_WORKER* worker = pool->Workers[x];
+		if (worker->Thread)
+		{
+			(void)WaitForSingleObject(worker->Thread, INFINITE);
+			(void)CloseHandle(worker->Thread);
+		}
+	}
+
+	for (size_t x = 0; x < pool->WorkerCount; x++)
+		winpr_aligned_free(pool->Workers[x]);
+
+	for (size_t x = 0; x < pool->RetiredCount; x++)
+		free((void*)pool->Retired[x]);
+
+	free((void*)pool->Retired);
+	free((void*)pool->Workers);
+	pool->Retired = nullptr;
+	pool->RetiredCount = 0;
+	pool->Workers = nullptr;
+	pool->WorkerCount = 0;
+	pool->Limit = 0;
+	pool->Terminate = 0;
+}
+
+/* pool->Lock must be held */
+static BOOL tp_worker_start(TP_WORKER* worker)
+{
+	if (worker->Thread)
+	{
+		/* A retired worker only hands back its cache after leaving the lock, wait for that */
+		(void)WaitForSingleObject(worker->Thread, INFINITE);
+		(void)CloseHandle(worker->Thread);
+		worker->Thread = nullptr;
+	}
+
+	worker->Retired = FALSE;
+	worker->Thread = CreateThread(nullptr, 0, thread_pool_work_func, worker, 0, nullptr);
+	if (!worker->Thread)
+	{
+		worker->Retired = TRUE;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* pool->Lock must be held */
+static BOOL tp_pool_grow(PTP_POOL pool, size_t count)
 {
-	(void)WaitForSingleObject(thread, INFINITE);
-	(void)CloseHandle(thread);
+	const size_t old = pool->WorkerCount;
+	WINPR_ASSERT(count > old);
+
+	/* Reserve the retired slot first, publishing must not fail */
+	TP_WORKER*** retired =
+	    (TP_WORKER***)realloc((void*)pool->Retired, (pool->RetiredCount + 1) * sizeof(TP_WORKER**));
+	if (!retired)
+		return FALSE;
+	pool->Retired = retired;
+
+	TP_WORKER** workers = (TP_WORKER**)calloc(count, sizeof(TP_WORKER*));
+	if (!workers)
+		return FALSE;
+
+	for (size_t x = 0; x < old; x++)
+		workers[x] = pool->Workers[x];
+
+	for (size_t x = old; x < count; x++)
+	{
+		workers[x] = (TP_WORKER*)winpr_aligned_calloc(1, sizeof(TP_WORKER), 64);
+		if (!workers[x])
+		{
+			for (size_t y = old; y < x; y++)
+				winpr_aligned_free(workers[y]);
+			free((void*)workers);
+			return FALSE;
+		}
+
+		workers[x]->Pool = pool;
+		workers[x]->Index = x;
+		workers[x]->Retired = TRUE;
+		workers[x]->Seed = 0x9E3779B9u * (UINT32)(x + 1);
+	}
+
+	/* Running thieves may still iterate the old array, it is released on close */
+	if (pool->Workers)
+		pool->Retired[pool->RetiredCount++] = pool->Workers;
+
+	pool->Workers = workers;
+	tp_memory_barrier();
+	pool->WorkerCount = count;
+	return TRUE;
+}
+
+/**
+ * Adjust the number of active workers without stopping the pool, it may be resized from
+ * within a callback. Workers above the limit are retired once they run out of work.
+ * pool->Lock must be held.
+ */
+static BOOL tp_pool_resize(PTP_POOL pool, DWORD count)
+{
+	if ((count > pool->WorkerCount) && !tp_pool_grow(pool, count))
+		return FALSE;
+
+	pool->Limit = count;
+
+	for (size_t x = 0; x < count; x++)
+	{
+		TP_WORKER* worker = pool->Workers[x];
+		if (worker->Retired && !tp_worker_start(worker))
+			return FALSE;
+	}
+
+	if (count < pool->WorkerCount)
+	{
+		InterlockedIncrement(&pool->ParkSequence);
+		tp_unpark(&pool->ParkSequence, TRUE);
+	}
+
+	return TRUE;
 }
 
 static BOOL InitializeThreadpool(PTP_POOL pool)
 {
 	BOOL rc = FALSE;
-	wObject* obj = nullptr;
 
-	if (pool->Threads)
+	if (pool->Initialized)
 		return TRUE;
 
-	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
-		goto fail;
-
-	if (!(pool->WorkComplete = CountdownEvent_New(0)))
-		goto fail;
+	if (!InitOnceExecuteOnce(&tp_init_once, tp_init, nullptr, nullptr))
+		return FALSE;
 
-	if (!(pool->TerminateEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr)))
-		goto fail;
+	if (!InitializeCriticalSectionAndSpinCount(&pool->Lock, 4000))
+		return FALSE;
 
-	if (!(pool->Threads = ArrayList_New(TRUE)))
-		goto fail;
+	if (!InitializeCriticalSectionAndSpinCount(&pool->QueueLock, 4000))
+	{
+		DeleteCriticalSection(&pool->Lock);
+		return FALSE;
+	}
 
-	obj = ArrayList_Object(pool->Threads);
-	obj->fnObjectFree = threads_close;
+	pool->Initialized = TRUE;
 
 #if !defined(WINPR_THREADPOOL_DEFAULT_MIN_COUNT)
 #error "WINPR_THREADPOOL_DEFAULT_MIN_COUNT must be defined"
@@ -163,12 +652,97 @@ PTP_POOL GetDefaultThreadpool(void)
 {
 	PTP_POOL pool = &DEFAULT_POOL;
 
-	if (!InitializeThreadpool(pool))
+	if (!InitOnceExecuteOnce(&tp_init_once, tp_init, nullptr, nullptr))
+		return nullptr;
+
+	EnterCriticalSection(&tp_default_lock);
+	const BOOL rc = InitializeThreadpool(pool);
+	LeaveCriticalSection(&tp_default_lock);
+
+	if (!rc)
 		return nullptr;
 
 	return pool;
 }
 
+BOOL ThreadpoolSubmitWork(PTP_POOL pool, PTP_WORK work)
+{
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(work);
+
+	PTP_CALLBACK_INSTANCE callbackInstance = nullptr;
+	TP_WORKER* worker = (TP_WORKER*)TlsGetValue(tp_worker_tls);
+
+	InterlockedIncrement(&work->Pending);
+
+	if (worker && (worker->Pool == pool))
+	{
+		callbackInstance = tp_worker_instance_new(worker);
+		if (!callbackInstance)
+			goto fail;
+
+		callbackInstance->Work = work;
+		if (!tp_deque_push(worker, callbackInstance))
+		{
+			EnterCriticalSection(&pool->QueueLock);
+			tp_queue_push(pool, callbackInstance);
+			LeaveCriticalSection(&pool->QueueLock);
+		}
+	}
+	else
+	{
+		EnterCriticalSection(&pool->QueueLock);
+		callbackInstance = pool->FreeList;
+		if (callbackInstance)
+			pool->FreeList = callbackInstance->Next;
+		else
+		{
+			LeaveCriticalSection(&pool->QueueLock);
+			callbackInstance = (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+			if (!callbackInstance)
+				goto fail;
+			EnterCriticalSection(&pool->QueueLock);
+		}
+
+		callbackInstance->Work = work;
+		tp_queue_push(pool, callbackInstance);
+		LeaveCriticalSection(&pool->QueueLock);
+	}
+
+	tp_notify(pool);
+	return TRUE;
+
+fail:
+	tp_work_complete(work);
+	return FALSE;
+}
+
+VOID ThreadpoolWaitForWork(PTP_WORK work)
+{
+	WINPR_ASSERT(work);
+
+	while (1)
+	{
+		LONG pending = work->Pending;
+		if ((pending & ~TP_WORK_WAITER_FLAG) == 0)
+			break;
+
+		if ((pending & TP_WORK_WAITER_FLAG) == 0)
+		{
+			const LONG flagged = pending | TP_WORK_WAITER_FLAG;
+			if (InterlockedCompareExchange(&work->Pending, flagged, pending) != pending)
+				continue;
+			pending = flagged;
+		}
+
+		tp_park(&work->Pending, pending);
+	}
+
+	/* Do not wake anyone for later submissions nobody waits for */
+	const LONG cleared = InterlockedCompareExchange(&work->Pending, 0, TP_WORK_WAITER_FLAG);
+	WINPR_UNUSED(cleared);
+}
+
 PTP_POOL winpr_CreateThreadpool(PVOID reserved)
 {
 	PTP_POOL pool = nullptr;
@@ -203,50 +777,52 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 		return;
 	}
 #endif
-	(void)SetEvent(ptpp->TerminateEvent);
+	WINPR_ASSERT(ptpp);
 
-	ArrayList_Free(ptpp->Threads);
-	Queue_Free(ptpp->PendingQueue);
-	CountdownEvent_Free(ptpp->WorkComplete);
-	(void)CloseHandle(ptpp->TerminateEvent);
+	if (!InitOnceExecuteOnce(&tp_init_once, tp_init, nullptr, nullptr))
+		return;
+
+	if (ptpp == &DEFAULT_POOL)
+		EnterCriticalSection(&tp_default_lock);
+
+	if (ptpp->Initialized)
+	{
+		EnterCriticalSection(&ptpp->Lock);
+		tp_pool_stop(ptpp);
+		LeaveCriticalSection(&ptpp->Lock);
+
+		tp_instance_list_free(ptpp->QueueHead);
+		tp_instance_list_free(ptpp->FreeList);
+		DeleteCriticalSection(&ptpp->QueueLock);
+		DeleteCriticalSection(&ptpp->Lock);
+	}
 
 	{
 		TP_POOL empty = WINPR_C_ARRAY_INIT;
 		*ptpp = empty;
 	}
 
-	if (ptpp != &DEFAULT_POOL)
+	if (ptpp == &DEFAULT_POOL)
+		LeaveCriticalSection(&tp_default_lock);
+	else
 		free(ptpp);
 }
 
 BOOL winpr_SetThreadpoolThreadMinimum(PTP_POOL ptpp, DWORD cthrdMic)
 {
-	BOOL rc = FALSE;
+	BOOL rc = TRUE;
 #ifdef _WIN32
 	if (!InitOnceExecuteOnce(&init_once_module, init_module, nullptr, nullptr))
 		return FALSE;
 	if (pSetThreadpoolThreadMinimum)
 		return pSetThreadpoolThreadMinimum(ptpp, cthrdMic);
 #endif
+	EnterCriticalSection(&ptpp->Lock);
 	ptpp->Minimum = cthrdMic;
 
-	ArrayList_Lock(ptpp->Threads);
-	while (ArrayList_Count(ptpp->Threads) < ptpp->Minimum)
-	{
-		HANDLE thread = CreateThread(nullptr, 0, thread_pool_work_func, (void*)ptpp, 0, nullptr);
-		if (!thread)
-			goto fail;
-
-		if (!ArrayList_Append(ptpp->Threads, thread))
-		{
-			(void)CloseHandle(thread);
-			goto fail;
-		}
-	}
-
-	rc = TRUE;
-fail:
-	ArrayList_Unlock(ptpp->Threads);
+	if (ptpp->Limit < ptpp->Minimum)
+		rc = tp_pool_resize(ptpp, ptpp->Minimum);
+	LeaveCriticalSection(&ptpp->Lock);
 
 	return rc;
 }
@@ -262,17 +838,21 @@ VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
 		return;
 	}
 #endif
+	EnterCriticalSection(&ptpp->Lock);
 	ptpp->Maximum = cthrdMost;
 
-	ArrayList_Lock(ptpp->Threads);
-	if (ArrayList_Count(ptpp->Threads) > ptpp->Maximum)
+	if (ptpp->Limit > ptpp->Maximum)
 	{
-		(void)SetEvent(ptpp->TerminateEvent);
-		ArrayList_Clear(ptpp->Threads);
-		(void)ResetEvent(ptpp->TerminateEvent);
+		DWORD count = ptpp->Minimum;
+		if (count > ptpp->Maximum)
+			count = ptpp->Maximum;
+		if (count == 0)
+			count = 1;
+
+		if (!tp_pool_resize(ptpp, count))
+			WLog_ERR(TAG, "failed to start %" PRIu32 " thread pool workers", count);
 	}
-	ArrayList_Unlock(ptpp->Threads);
-	winpr_SetThreadpoolThreadMinimum(ptpp, ptpp->Minimum);
+	LeaveCriticalSection(&ptpp->Lock);
 }
 
 #endif /* WINPR_THREAD_POOL defined */
@@ -31,16 +31,33 @@
 struct S_TP_CALLBACK_INSTANCE
 {
 	PTP_WORK Work;
+	PTP_CALLBACK_INSTANCE Next;
 };
 
+typedef struct S_TP_WORKER TP_WORKER;
+
 struct S_TP_POOL
 {
 	DWORD Minimum;
 	DWORD Maximum;
-	wArrayList* Threads;
-	wQueue* PendingQueue;
-	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	BOOL Initialized;
+	CRITICAL_SECTION Lock; /* serializes worker (re)configuration */
+	TP_WORKER** Workers;
+	size_t WorkerCount;
+	DWORD Limit;          /* workers at or above this index retire once idle */
+	TP_WORKER*** Retired; /* replaced Workers arrays, thieves may still read them */
+	size_t RetiredCount;
+
+	/* Injection queue for work submitted from threads outside of the pool */
+	CRITICAL_SECTION QueueLock;
+	PTP_CALLBACK_INSTANCE QueueHead;
+	PTP_CALLBACK_INSTANCE QueueTail;
+	volatile LONG QueueCount;
+	PTP_CALLBACK_INSTANCE FreeList;
+
+	volatile LONG Terminate;
+	volatile LONG ParkSequence;
+	volatile LONG Sleepers;
 };
 
 struct S_TP_WORK
@@ -48,6 +65,7 @@ struct S_TP_WORK
 	PVOID CallbackParameter;
 	PTP_WORK_CALLBACK WorkCallback;
 	PTP_CALLBACK_ENVIRON CallbackEnvironment;
+	volatile LONG Pending; /* outstanding callbacks | TP_WORK_WAITER_FLAG */
 };
 
 struct S_TP_TIMER
@@ -75,16 +93,33 @@ struct S_TP_CLEANUP_GROUP
 struct S_TP_CALLBACK_INSTANCE
 {
 	PTP_WORK Work;
+	PTP_CALLBACK_INSTANCE Next;
 };
 
+typedef struct S_TP_WORKER TP_WORKER;
+
 struct S_TP_POOL
 {
 	DWORD Minimum;
 	DWORD Maximum;
-	wArrayList* Threads;
-	wQueue* PendingQueue;
-	HANDLE TerminateEvent;
-	wCountdownEvent* WorkComplete;
+	BOOL Initialized;
+	CRITICAL_SECTION Lock; /* serializes worker (re)configuration */
+	TP_WORKER** Workers;
+	size_t WorkerCount;
+	DWORD Limit;          /* workers at or above this index retire once idle */
+	TP_WORKER*** Retired; /* replaced Workers arrays, thieves may still read them */
+	size_t RetiredCount;
+
+	/* Injection queue for work submitted from threads outside of the pool */
+	CRITICAL_SECTION QueueLock;
+	PTP_CALLBACK_INSTANCE QueueHead;
+	PTP_CALLBACK_INSTANCE QueueTail;
+	volatile LONG QueueCount;
+	PTP_CALLBACK_INSTANCE FreeList;
+
+	volatile LONG Terminate;
+	volatile LONG ParkSequence;
+	volatile LONG Sleepers;
 };
 
 struct S_TP_WORK
@@ -92,6 +127,7 @@ struct S_TP_WORK
 	PVOID CallbackParameter;
 	PTP_WORK_CALLBACK WorkCallback;
 	PTP_CALLBACK_ENVIRON CallbackEnvironment;
+	volatile LONG Pending; /* outstanding callbacks | TP_WORK_WAITER_FLAG */
 };
 
 struct S_TP_TIMER
@@ -117,6 +153,12 @@ struct S_TP_CLEANUP_GROUP
 
 #endif
 
+/* Set in TP_WORK::Pending while a thread waits for the callbacks to complete */
+#define TP_WORK_WAITER_FLAG 0x40000000
+
 PTP_POOL GetDefaultThreadpool(void);
 
+BOOL ThreadpoolSubmitWork(PTP_POOL pool, PTP_WORK work);
+VOID ThreadpoolWaitForWork(PTP_WORK work);
+
 #endif /* WINPR_POOL_PRIVATE_H */
@@ -3,6 +3,12 @@
 #include <winpr/crt.h>
 #include <winpr/pool.h>
 #include <winpr/interlocked.h>
+#include <winpr/sysinfo.h>
+
+#define TEST_BENCH_WORK_OBJECTS 64
+#define TEST_BENCH_ROUNDS 2000
+#define TEST_NESTED_ITEMS 1000
+#define TEST_RESIZE_ROUNDS 50
 
 static LONG count = 0;
 
@@ -118,6 +124,215 @@ fail:
 	return rc;
 }
 
+static void CALLBACK test_BenchCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                        PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	InterlockedIncrement((LONG*)context);
+}
+
+/**
+ * Submit one item per work object and wait for all of them, the pattern used by the
+ * tile decoders (RFX, progressive, YUV). Prints the achieved items per second.
+ */
+static BOOL test3(void)
+{
+	BOOL rc = FALSE;
+	LONG executed = 0;
+	PTP_WORK works[TEST_BENCH_WORK_OBJECTS] = WINPR_C_ARRAY_INIT;
+	printf("Global Thread Pool throughput\n");
+
+	for (size_t x = 0; x < ARRAYSIZE(works); x++)
+	{
+		works[x] = CreateThreadpoolWork(test_BenchCallback, &executed, nullptr);
+		if (!works[x])
+		{
+			printf("CreateThreadpoolWork failure\n");
+			goto fail;
+		}
+	}
+
+	{
+		const UINT64 start = winpr_GetTickCount64NS();
+		for (size_t round = 0; round < TEST_BENCH_ROUNDS; round++)
+		{
+			for (size_t x = 0; x < ARRAYSIZE(works); x++)
+				SubmitThreadpoolWork(works[x]);
+
+			for (size_t x = 0; x < ARRAYSIZE(works); x++)
+				WaitForThreadpoolWorkCallbacks(works[x], FALSE);
+		}
+		const UINT64 end = winpr_GetTickCount64NS();
+
+		const size_t total = ARRAYSIZE(works) * TEST_BENCH_ROUNDS;
+		if (executed != (LONG)total)
+		{
+			printf("executed %" PRId32 " work items, expected %" PRIuz "\n", executed, total);
+			goto fail;
+		}
+
+		const double seconds = (double)(end - start) / 1000000000.0;
+		printf("%" PRIuz " items in %.3f s: %.0f items/s\n", total, seconds,
+		       seconds > 0.0 ? (double)total / seconds : 0.0);
+	}
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(works); x++)
+	{
+		if (works[x])
+			CloseThreadpoolWork(works[x]);
+	}
+	return rc;
+}
+
+typedef struct
+{
+	PTP_WORK leaf;
+	LONG executed;
+} TEST_NESTED;
+
+static void CALLBACK test_NestedLeafCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                             PTP_WORK work)
+{
+	TEST_NESTED* nested = context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	InterlockedIncrement(&nested->executed);
+}
+
+static void CALLBACK test_NestedRootCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                             PTP_WORK work)
+{
+	TEST_NESTED* nested = context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	for (size_t x = 0; x < TEST_NESTED_ITEMS; x++)
+		SubmitThreadpoolWork(nested->leaf);
+}
+
+/**
+ * Work submitted from within a callback must be executed and waited for as well.
+ */
+static BOOL test4(void)
+{
+	BOOL rc = FALSE;
+	TEST_NESTED nested = WINPR_C_ARRAY_INIT;
+	printf("Global Thread Pool nested submission\n");
+
+	PTP_WORK root = CreateThreadpoolWork(test_NestedRootCallback, &nested, nullptr);
+	nested.leaf = CreateThreadpoolWork(test_NestedLeafCallback, &nested, nullptr);
+	if (!root || !nested.leaf)
+	{
+		printf("CreateThreadpoolWork failure\n");
+		goto fail;
+	}
+
+	for (size_t x = 0; x < 4; x++)
+		SubmitThreadpoolWork(root);
+
+	WaitForThreadpoolWorkCallbacks(root, FALSE);
+	WaitForThreadpoolWorkCallbacks(nested.leaf, FALSE);
+
+	if (nested.executed != 4 * TEST_NESTED_ITEMS)
+	{
+		printf("executed %" PRId32 " nested work items, expected %d\n", nested.executed,
+		       4 * TEST_NESTED_ITEMS);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	if (root)
+		CloseThreadpoolWork(root);
+	if (nested.leaf)
+		CloseThreadpoolWork(nested.leaf);
+	return rc;
+}
+
+typedef struct
+{
+	PTP_POOL pool;
+	LONG executed;
+} TEST_RESIZE;
+
+static void CALLBACK test_ResizeCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                         PTP_WORK work)
+{
+	TEST_RESIZE* resize = context;
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	/* Changing the limits from a callback must neither wait for callbacks nor deadlock */
+	const LONG executed = InterlockedIncrement(&resize->executed);
+	if (executed % 2)
+		SetThreadpoolThreadMaximum(resize->pool, 1);
+	else
+	{
+		SetThreadpoolThreadMaximum(resize->pool, 8);
+		if (!SetThreadpoolThreadMinimum(resize->pool, 1 + (DWORD)(executed % 8)))
+			printf("SetThreadpoolThreadMinimum failure\n");
+	}
+}
+
+/**
+ * Grow and shrink a private pool from within its own callbacks while work is pending.
+ */
+static BOOL test5(void)
+{
+	BOOL rc = FALSE;
+	PTP_WORK work = nullptr;
+	TP_CALLBACK_ENVIRON environment;
+	TEST_RESIZE resize = WINPR_C_ARRAY_INIT;
+	printf("Private Thread Pool resize from callbacks\n");
+	InitializeThreadpoolEnvironment(&environment);
+
+	if (!(resize.pool = CreateThreadpool(nullptr)))
+	{
+		printf("CreateThreadpool failure\n");
+		return FALSE;
+	}
+
+	if (!SetThreadpoolThreadMinimum(resize.pool, 4))
+	{
+		printf("SetThreadpoolThreadMinimum failure\n");
+		goto fail;
+	}
+
+	SetThreadpoolCallbackPool(&environment, resize.pool);
+
+	work = CreateThreadpoolWork(test_ResizeCallback, &resize, &environment);
+	if (!work)
+	{
+		printf("CreateThreadpoolWork failure\n");
+		goto fail;
+	}
+
+	for (size_t round = 0; round < TEST_RESIZE_ROUNDS; round++)
+	{
+		for (size_t x = 0; x < 20; x++)
+			SubmitThreadpoolWork(work);
+		WaitForThreadpoolWorkCallbacks(work, FALSE);
+	}
+
+	if (resize.executed != TEST_RESIZE_ROUNDS * 20)
+	{
+		printf("executed %" PRId32 " work items, expected %d\n", resize.executed,
+		       TEST_RESIZE_ROUNDS * 20);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	if (work)
+		CloseThreadpoolWork(work);
+	CloseThreadpool(resize.pool);
+	DestroyThreadpoolEnvironment(&environment);
+	return rc;
+}
+
 int TestPoolWork(int argc, char* argv[])
 {
 
@@ -130,5 +345,14 @@ int TestPoolWork(int argc, char* argv[])
 	if (!test2())
 		return -1;
 
+	if (!test3())
+		return -1;
+
+	if (!test4())
+		return -1;
+
+	if (!test5())
+		return -1;
+
 	return 0;
 }
@@ -130,7 +130,6 @@ VOID winpr_CloseThreadpoolWork(PTP_WORK pwk)
 VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 {
 	PTP_POOL pool = nullptr;
-	PTP_CALLBACK_INSTANCE callbackInstance = nullptr;
 #ifdef _WIN32
 	if (!InitOnceExecuteOnce(&init_once_module, init_module, nullptr, nullptr))
 		return;
@@ -146,16 +145,11 @@ VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 	WINPR_ASSERT(pwk);
 	WINPR_ASSERT(pwk->CallbackEnvironment);
 	pool = pwk->CallbackEnvironment->Pool;
-	callbackInstance = (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
+	if (!pool)
+		pool = GetDefaultThreadpool();
 
-	if (callbackInstance)
-	{
-		callbackInstance->Work = pwk;
-		CountdownEvent_AddCount(pool->WorkComplete, 1);
-		if (!Queue_Enqueue(pool->PendingQueue, callbackInstance))
-			free(callbackInstance);
-	}
-	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc): Queue_Enqueue takes ownership of callbackInstance
+	if (!pool || !ThreadpoolSubmitWork(pool, pwk))
+		WLog_ERR(TAG, "failed to submit thread pool work");
 }
 
 BOOL winpr_TrySubmitThreadpoolCallback(WINPR_ATTR_UNUSED PTP_SIMPLE_CALLBACK pfns,
@@ -177,9 +171,6 @@ BOOL winpr_TrySubmitThreadpoolCallback(WINPR_ATTR_UNUSED PTP_SIMPLE_CALLBACK pfn
 VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk,
                                           WINPR_ATTR_UNUSED BOOL fCancelPendingCallbacks)
 {
-	HANDLE event = nullptr;
-	PTP_POOL pool = nullptr;
-
 #ifdef _WIN32
 	if (!InitOnceExecuteOnce(&init_once_module, init_module, nullptr, nullptr))
 		return;
@@ -192,15 +183,8 @@ VOID winpr_WaitForThreadpoolWorkCallbacks(PTP_WORK pwk,
 
 #endif
 	WINPR_ASSERT(pwk);
-	WINPR_ASSERT(pwk->CallbackEnvironment);
-
-	pool = pwk->CallbackEnvironment->Pool;
-	WINPR_ASSERT(pool);
-
-	event = CountdownEvent_WaitHandle(pool->WorkComplete);
 
-	if (WaitForSingleObject(event, INFINITE) != WAIT_OBJECT_0)
-		WLog_ERR(TAG, "error waiting on work completion");
+	ThreadpoolWaitForWork(pwk);
 }
 
 #endif /* WINPR_THREAD_POOL defined */
@@ -19,7 +19,9 @@
 
 #include <winpr/config.h>
 
+#include <winpr/error.h>
 #include <winpr/synch.h>
+#include <winpr/interlocked.h>
 
 /**
  * WakeByAddressAll
@@ -29,18 +31,187 @@
 
 #ifndef _WIN32
 
-VOID WakeByAddressAll(WINPR_ATTR_UNUSED PVOID Address)
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Waiters that can not use a futex (other platforms, addresses that are not 32bit values)
+ * park on a condition variable selected by hashing the address. Wakeups are broadcast to all
+ * waiters of a bucket, the API allows spurious wakeups.
+ */
+#define ADDRESS_BUCKET_COUNT 64
+
+typedef struct
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	LONG waiters;
+} ADDRESS_BUCKET;
+
+static ADDRESS_BUCKET address_buckets[ADDRESS_BUCKET_COUNT];
+static pthread_once_t address_buckets_once = PTHREAD_ONCE_INIT;
+
+static void address_buckets_init(void)
+{
+	for (size_t x = 0; x < ADDRESS_BUCKET_COUNT; x++)
+	{
+		ADDRESS_BUCKET* bucket = &address_buckets[x];
+		(void)pthread_mutex_init(&bucket->mutex, nullptr);
+		(void)pthread_cond_init(&bucket->cond, nullptr);
+	}
+}
+
+static ADDRESS_BUCKET* address_bucket(const volatile void* Address)
+{
+	const UINT64 key = (UINT64)(ULONG_PTR)Address;
+	const UINT64 hash = (key >> 3) * 0x9E3779B97F4A7C15ULL;
+
+	(void)pthread_once(&address_buckets_once, address_buckets_init);
+	return &address_buckets[hash >> 58];
+}
+
+static BOOL address_equal(const volatile void* Address, const void* CompareAddress,
+                          size_t AddressSize)
 {
+	switch (AddressSize)
+	{
+		case 1:
+			return *(const volatile BYTE*)Address == *(const BYTE*)CompareAddress;
+		case 2:
+			return *(const volatile UINT16*)Address == *(const UINT16*)CompareAddress;
+		case 4:
+			return *(const volatile UINT32*)Address == *(const UINT32*)CompareAddress;
+		case 8:
+			return *(const volatile UINT64*)Address == *(const UINT64*)CompareAddress;
+		default:
+			return FALSE;
+	}
 }
 
-VOID WakeByAddressSingle(WINPR_ATTR_UNUSED PVOID Address)
+#if defined(__linux__)
+static BOOL address_use_futex(const volatile void* Address, size_t AddressSize)
 {
+	return (AddressSize == sizeof(UINT32)) && (((ULONG_PTR)Address % sizeof(UINT32)) == 0);
 }
 
-BOOL WaitOnAddress(WINPR_ATTR_UNUSED VOID volatile* Address, WINPR_ATTR_UNUSED PVOID CompareAddress,
-                   WINPR_ATTR_UNUSED size_t AddressSize, WINPR_ATTR_UNUSED DWORD dwMilliseconds)
+static long address_futex(const volatile void* Address, int op, UINT32 value,
+                          const struct timespec* timeout)
 {
-	return TRUE;
+	return syscall(SYS_futex, Address, op, value, timeout, nullptr, 0);
+}
+#endif
+
+static void address_wake(PVOID Address, BOOL all)
+{
+	if (!Address)
+		return;
+
+#if defined(__linux__)
+	(void)address_futex(Address, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr);
+#endif
+
+	/* The full barrier orders the callers store to Address before the waiter check */
+	ADDRESS_BUCKET* bucket = address_bucket(Address);
+	if (InterlockedCompareExchange(&bucket->waiters, 0, 0) > 0)
+	{
+		(void)pthread_mutex_lock(&bucket->mutex);
+		(void)pthread_cond_broadcast(&bucket->cond);
+		(void)pthread_mutex_unlock(&bucket->mutex);
+	}
+}
+
+VOID WakeByAddressAll(PVOID Address)
+{
+	address_wake(Address, TRUE);
+}
+
+VOID WakeByAddressSingle(PVOID Address)
+{
+	address_wake(Address, FALSE);
+}
+
+BOOL WaitOnAddress(VOID volatile* Address, PVOID CompareAddress, size_t AddressSize,
+                   DWORD dwMilliseconds)
+{
+	if (!Address || !CompareAddress)
+	{
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	switch (AddressSize)
+	{
+		case 1:
+		case 2:
+		case 4:
+		case 8:
+			break;
+		default:
+			SetLastError(ERROR_INVALID_PARAMETER);
+			return FALSE;
+	}
+
+#if defined(__linux__)
+	if (address_use_futex(Address, AddressSize))
+	{
+		struct timespec timeout = WINPR_C_ARRAY_INIT;
+		timeout.tv_sec = dwMilliseconds / 1000;
+		timeout.tv_nsec = (dwMilliseconds % 1000) * 1000000L;
+
+		const long rc = address_futex(Address, FUTEX_WAIT_PRIVATE, *(const UINT32*)CompareAddress,
+		                              (dwMilliseconds == INFINITE) ? nullptr : &timeout);
+		if ((rc != 0) && (errno == ETIMEDOUT))
+		{
+			SetLastError(ERROR_TIMEOUT);
+			return FALSE;
+		}
+
+		/* EAGAIN (value changed) and EINTR are wakeups as well */
+		return TRUE;
+	}
+#endif
+
+	BOOL rc = TRUE;
+	ADDRESS_BUCKET* bucket = address_bucket(Address);
+	struct timespec deadline = WINPR_C_ARRAY_INIT;
+
+	if (dwMilliseconds != INFINITE)
+	{
+		(void)clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += dwMilliseconds / 1000;
+		deadline.tv_nsec += (dwMilliseconds % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	(void)pthread_mutex_lock(&bucket->mutex);
+	InterlockedIncrement(&bucket->waiters);
+
+	if (address_equal(Address, CompareAddress, AddressSize))
+	{
+		if (dwMilliseconds == INFINITE)
+			(void)pthread_cond_wait(&bucket->cond, &bucket->mutex);
+		else if (pthread_cond_timedwait(&bucket->cond, &bucket->mutex, &deadline) == ETIMEDOUT)
+			rc = FALSE;
+	}
+
+	InterlockedDecrement(&bucket->waiters);
+	(void)pthread_mutex_unlock(&bucket->mutex);
+
+	if (!rc)
+		SetLastError(ERROR_TIMEOUT);
+	return rc;
 }
 
 #endif
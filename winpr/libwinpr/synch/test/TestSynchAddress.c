@@ -0,0 +1,86 @@
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+static LONG gValue = 0;
+static BYTE gByte = 0;
+
+static DWORD WINAPI test_synch_address_thread(LPVOID lpParam)
+{
+	WINPR_UNUSED(lpParam);
+
+	LONG undesired = 0;
+	while (gValue == undesired)
+	{
+		if (!WaitOnAddress(&gValue, &undesired, sizeof(undesired), INFINITE))
+			return 1;
+	}
+
+	return 0;
+}
+
+static BOOL test_synch_address_wake(void)
+{
+	HANDLE thread = CreateThread(nullptr, 0, test_synch_address_thread, nullptr, 0, nullptr);
+	if (!thread)
+	{
+		printf("CreateThread failure\n");
+		return FALSE;
+	}
+
+	Sleep(50);
+	InterlockedExchange(&gValue, 1);
+	WakeByAddressAll(&gValue);
+
+	DWORD exitCode = 0;
+	const BOOL rc = (WaitForSingleObject(thread, 5000) == WAIT_OBJECT_0) &&
+	                GetExitCodeThread(thread, &exitCode) && (exitCode == 0);
+	(void)CloseHandle(thread);
+
+	if (!rc)
+		printf("WaitOnAddress waiter was not woken\n");
+	return rc;
+}
+
+static BOOL test_synch_address_timeout(void)
+{
+	BYTE undesired = 0;
+
+	/* A single byte can not use a futex, this checks the generic wait as well */
+	if (WaitOnAddress(&gByte, &undesired, sizeof(undesired), 20))
+	{
+		printf("WaitOnAddress did not time out\n");
+		return FALSE;
+	}
+
+	if (GetLastError() != ERROR_TIMEOUT)
+	{
+		printf("WaitOnAddress timeout error 0x%08" PRIx32 "\n", GetLastError());
+		return FALSE;
+	}
+
+	/* Values that differ do not block */
+	undesired = 1;
+	if (!WaitOnAddress(&gByte, &undesired, sizeof(undesired), INFINITE))
+	{
+		printf("WaitOnAddress blocked on a different value\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int TestSynchAddress(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_synch_address_timeout())
+		return -1;
+
+	if (!test_synch_address_wake())
+		return -1;
+
+	return 0;
+}
@@ -668,6 +668,7 @@ UINT64 winpr_GetUnixTimeNS(void)
 
 #define B_BIT_AVX2 (1 << 5)
 #define B_BIT_AVX512F (1 << 16)
+#define B_BIT_AVX512BW (1 << 30)
 #define D_BIT_MMX (1 << 23)
 #define D_BIT_SSE (1 << 25)
 #define D_BIT_SSE2 (1 << 26)
@@ -687,6 +688,10 @@ UINT64 winpr_GetUnixTimeNS(void)
 #define E_BIT_XMM (1 << 1)
 #define E_BIT_YMM (1 << 2)
 #define E_BITS_AVX (E_BIT_XMM | E_BIT_YMM)
+#define E_BIT_OPMASK (1 << 5)
+#define E_BIT_ZMM_HI256 (1 << 6)
+#define E_BIT_HI16_ZMM (1 << 7)
+#define E_BITS_AVX512 (E_BITS_AVX | E_BIT_OPMASK | E_BIT_ZMM_HI256 | E_BIT_HI16_ZMM)
 
 static void cpuid(unsigned info, unsigned* eax, unsigned* ebx, unsigned* ecx, unsigned* edx)
 {
@@ -1176,6 +1181,7 @@ BOOL IsProcessorFeaturePresentEx(DWORD ProcessorFeature)
 		case PF_EX_AVX:
 		case PF_EX_AVX2:
 		case PF_EX_AVX512F:
+		case PF_EX_AVX512BW:
 		case PF_EX_FMA:
 		case PF_EX_AVX_AES:
 		case PF_EX_AVX_PCLMULQDQ:
@@ -1203,6 +1209,7 @@ BOOL IsProcessorFeaturePresentEx(DWORD ProcessorFeature)
 
 					case PF_EX_AVX2:
 					case PF_EX_AVX512F:
+					case PF_EX_AVX512BW:
 						cpuid(7, &a, &b, &c, &d);
 						switch (ProcessorFeature)
 						{
@@ -1216,6 +1223,13 @@ BOOL IsProcessorFeaturePresentEx(DWORD ProcessorFeature)
 									ret = TRUE;
 								break;
 
+							case PF_EX_AVX512BW:
+								/* the OS must also save the opmask and ZMM states */
+								if (((e & E_BITS_AVX512) == E_BITS_AVX512) &&
+								    (b & B_BIT_AVX512F) && (b & B_BIT_AVX512BW))
+									ret = TRUE;
+								break;
+
 							default:
 								break;
 						}
@@ -1289,6 +1303,12 @@ BOOL IsProcessorFeaturePresentEx(DWORD ProcessorFeature)
 #endif
 			break;
 
+		case PF_EX_AVX512BW:
+#ifdef __AVX512BW__
+			ret = TRUE;
+#endif
+			break;
+
 		case PF_EX_FMA:
 #ifdef __FMA__
 			ret = TRUE;
@@ -0,0 +1,115 @@
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/wlog.h>
+
+#define TEST_MESSAGE_COUNT 200000
+
+/* Count the lines of the log file, checks they are in order while doing so */
+static BOOL check_file(const char* path, size_t expected)
+{
+	BOOL rc = FALSE;
+	size_t count = 0;
+	char line[256] = WINPR_C_ARRAY_INIT;
+	FILE* fp = winpr_fopen(path, "r");
+
+	if (!fp)
+		return FALSE;
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		char expect[64] = WINPR_C_ARRAY_INIT;
+
+		if (count < TEST_MESSAGE_COUNT)
+			(void)_snprintf(expect, sizeof(expect), "message %" PRIuz "\n", count);
+		else
+			(void)_snprintf(expect, sizeof(expect), "error\n");
+
+		if (strcmp(line, expect) != 0)
+		{
+			(void)fprintf(stderr, "line %" PRIuz ": got '%s', expected '%s'\n", count, line,
+			              expect);
+			goto out;
+		}
+
+		count++;
+	}
+
+	rc = (count == expected);
+	if (!rc)
+		(void)fprintf(stderr, "got %" PRIuz " lines, expected %" PRIuz "\n", count, expected);
+out:
+	(void)fclose(fp);
+	return rc;
+}
+
+int TestWLogFile(int argc, char* argv[])
+{
+	int result = 1;
+	char name[64] = WINPR_C_ARRAY_INIT;
+	char* tmp_path = nullptr;
+	char* wlog_file = nullptr;
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!(tmp_path = GetKnownPath(KNOWN_PATH_TEMP)))
+	{
+		(void)fprintf(stderr, "Failed to get temporary directory!\n");
+		goto out;
+	}
+
+	(void)_snprintf(name, sizeof(name), "test_wlog_file_%" PRIu32 ".log", GetCurrentProcessId());
+	if (!(wlog_file = GetCombinedPath(tmp_path, name)))
+		goto out;
+	winpr_DeleteFile(wlog_file);
+
+	wLog* root = WLog_GetRoot();
+	if (!WLog_SetLogAppenderType(root, WLOG_APPENDER_FILE))
+		goto out;
+
+	wLogAppender* appender = WLog_GetLogAppender(root);
+	if (!WLog_ConfigureAppender(appender, "outputfilename", name))
+		goto out;
+	if (!WLog_ConfigureAppender(appender, "outputfilepath", tmp_path))
+		goto out;
+	if (!WLog_ConfigureAppender(appender, "async", "true"))
+		goto out;
+	if (!WLog_ConfigureAppender(appender, "flushinterval", "10"))
+		goto out;
+	if (WLog_ConfigureAppender(appender, "flushinterval", "0"))
+		goto out;
+
+	wLogLayout* layout = WLog_GetLogLayout(root);
+	if (!WLog_Layout_SetPrefixFormat(root, layout, ""))
+		goto out;
+
+	if (!WLog_OpenAppender(root))
+		goto out;
+
+	wLog* log = WLog_Get("com.test.file");
+	WLog_SetLogLevel(log, WLOG_INFO);
+
+	/* Several times the ring size, the producer has to wait for the writer */
+	for (size_t x = 0; x < TEST_MESSAGE_COUNT; x++)
+		WLog_Print(log, WLOG_INFO, "message %" PRIuz, x);
+
+	/* An error is flushed to disk before WLog_Print returns */
+	WLog_Print(log, WLOG_ERROR, "error");
+	if (!check_file(wlog_file, TEST_MESSAGE_COUNT + 1))
+		goto out;
+
+	if (!WLog_CloseAppender(root))
+		goto out;
+
+	if (!check_file(wlog_file, TEST_MESSAGE_COUNT + 1))
+		goto out;
+
+	result = 0;
+out:
+	if (wlog_file)
+		winpr_DeleteFile(wlog_file);
+	free(wlog_file);
+	free(tmp_path);
+	return result;
+}
@@ -19,6 +19,8 @@
 
 #include <winpr/config.h>
 
+#include <errno.h>
+
 #include "FileAppender.h"
 #include "Message.h"
 
@@ -26,6 +28,15 @@
 #include <winpr/environment.h>
 #include <winpr/file.h>
 #include <winpr/path.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/interlocked.h>
+
+/* Size of the asynchronous message ring, must be a power of two */
+#define WLOG_FILE_RING_SIZE (1024ul * 1024ul)
+#define WLOG_FILE_DEFAULT_FLUSH_INTERVAL 100
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
 typedef struct
 {
@@ -35,8 +46,184 @@ typedef struct
 	char* FilePath;
 	char* FullFileName;
 	FILE* FileDescriptor;
+
+	/* Asynchronous mode: WriteMessage formats into a byte ring that a writer thread drains in
+	 * batches. Producers are serialized by the appender lock, the ring itself is lock free. */
+	BOOL Async;
+	DWORD FlushInterval;
+	BYTE* Ring;
+	LONG volatile RingHead;
+	LONG volatile RingTail;
+	LONG volatile RingFlushed;
+	LONG volatile RingStop;
+	HANDLE WakeEvent;
+	HANDLE DrainEvent;
+	HANDLE Writer;
 } wLogFileAppender;
 
+static ULONG WLog_FileAppender_Load(LONG volatile* value)
+{
+	return (ULONG)InterlockedCompareExchange(value, 0, 0);
+}
+
+static void WLog_FileAppender_Store(LONG volatile* value, ULONG pos)
+{
+	const LONG previous = InterlockedExchange(value, (LONG)pos);
+	WINPR_UNUSED(previous);
+}
+
+/* Write everything queued so far, returns TRUE if anything was written */
+static BOOL WLog_FileAppender_Drain(wLogFileAppender* appender)
+{
+	const ULONG head = WLog_FileAppender_Load(&appender->RingHead);
+	ULONG tail = WLog_FileAppender_Load(&appender->RingTail);
+
+	if (head == tail)
+		return FALSE;
+
+	while (tail != head)
+	{
+		const size_t offset = tail & (WLOG_FILE_RING_SIZE - 1);
+		const size_t chunk = MIN(head - tail, WLOG_FILE_RING_SIZE - offset);
+		(void)fwrite(&appender->Ring[offset], 1, chunk, appender->FileDescriptor);
+		tail += (ULONG)chunk;
+	}
+
+	WLog_FileAppender_Store(&appender->RingTail, tail);
+	return TRUE;
+}
+
+/* The writer never logs itself, a producer may be waiting for it with the appender lock held */
+static DWORD WINAPI WLog_FileAppender_WriterThread(LPVOID arg)
+{
+	wLogFileAppender* appender = (wLogFileAppender*)arg;
+	WINPR_ASSERT(appender);
+
+	for (;;)
+	{
+		(void)ResetEvent(appender->WakeEvent);
+
+		const BOOL stop = WLog_FileAppender_Load(&appender->RingStop) != 0;
+		if (WLog_FileAppender_Drain(appender))
+			(void)fflush(appender->FileDescriptor);
+
+		WLog_FileAppender_Store(&appender->RingFlushed,
+		                        WLog_FileAppender_Load(&appender->RingTail));
+		(void)SetEvent(appender->DrainEvent);
+
+		if (stop)
+			break;
+
+		(void)WaitForSingleObject(appender->WakeEvent, appender->FlushInterval);
+	}
+
+	return 0;
+}
+
+/* Block until the writer advanced value (RingTail or RingFlushed) to at least pos */
+static void WLog_FileAppender_WaitWriter(wLogFileAppender* appender, LONG volatile* value,
+                                         ULONG pos)
+{
+	for (;;)
+	{
+		(void)ResetEvent(appender->DrainEvent);
+
+		const ULONG current = WLog_FileAppender_Load(value);
+		if ((LONG)(current - pos) >= 0)
+			break;
+
+		(void)SetEvent(appender->WakeEvent);
+		(void)WaitForSingleObject(appender->DrainEvent, appender->FlushInterval);
+	}
+}
+
+static ULONG WLog_FileAppender_Enqueue(wLogFileAppender* appender, ULONG head, const char* data,
+                                       size_t length)
+{
+	const size_t offset = head & (WLOG_FILE_RING_SIZE - 1);
+	const size_t first = MIN(length, WLOG_FILE_RING_SIZE - offset);
+
+	memcpy(&appender->Ring[offset], data, first);
+	memcpy(appender->Ring, &data[first], length - first);
+	return head + (ULONG)length;
+}
+
+static BOOL WLog_FileAppender_WriteAsync(wLogFileAppender* appender, DWORD level,
+                                         const char* prefix, const char* text)
+{
+	const size_t prefixLength = strlen(prefix);
+	const size_t textLength = strlen(text);
+	const size_t length = prefixLength + textLength + 1;
+	ULONG head = WLog_FileAppender_Load(&appender->RingHead);
+
+	if (length > WLOG_FILE_RING_SIZE)
+	{
+		/* Too large for the ring, write it directly once everything queued before is out */
+		WLog_FileAppender_WaitWriter(appender, &appender->RingFlushed, head);
+		(void)fprintf(appender->FileDescriptor, "%s%s\n", prefix, text);
+		(void)fflush(appender->FileDescriptor);
+		return TRUE;
+	}
+
+	WLog_FileAppender_WaitWriter(appender, &appender->RingTail,
+	                             head + (ULONG)length - WLOG_FILE_RING_SIZE);
+
+	head = WLog_FileAppender_Enqueue(appender, head, prefix, prefixLength);
+	head = WLog_FileAppender_Enqueue(appender, head, text, textLength);
+	head = WLog_FileAppender_Enqueue(appender, head, "\n", 1);
+	WLog_FileAppender_Store(&appender->RingHead, head);
+
+	/* Errors are on disk before the caller continues, it might be about to crash */
+	if (level >= WLOG_ERROR)
+		WLog_FileAppender_WaitWriter(appender, &appender->RingFlushed, head);
+	else if ((head - WLog_FileAppender_Load(&appender->RingTail)) >= WLOG_FILE_RING_SIZE / 2)
+		(void)SetEvent(appender->WakeEvent);
+
+	return TRUE;
+}
+
+static BOOL WLog_FileAppender_StartWriter(wLogFileAppender* appender)
+{
+	appender->Ring = (BYTE*)malloc(WLOG_FILE_RING_SIZE);
+	if (!appender->Ring)
+		return FALSE;
+
+	appender->WakeEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	appender->DrainEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	if (!appender->WakeEvent || !appender->DrainEvent)
+		return FALSE;
+
+	appender->Writer =
+	    CreateThread(nullptr, 0, WLog_FileAppender_WriterThread, appender, 0, nullptr);
+	return appender->Writer != nullptr;
+}
+
+static void WLog_FileAppender_StopWriter(wLogFileAppender* appender)
+{
+	if (appender->Writer)
+	{
+		WLog_FileAppender_Store(&appender->RingStop, 1);
+		(void)SetEvent(appender->WakeEvent);
+		(void)WaitForSingleObject(appender->Writer, INFINITE);
+		(void)CloseHandle(appender->Writer);
+		appender->Writer = nullptr;
+	}
+
+	if (appender->WakeEvent)
+		(void)CloseHandle(appender->WakeEvent);
+	if (appender->DrainEvent)
+		(void)CloseHandle(appender->DrainEvent);
+	free(appender->Ring);
+
+	appender->WakeEvent = nullptr;
+	appender->DrainEvent = nullptr;
+	appender->Ring = nullptr;
+	appender->RingHead = 0;
+	appender->RingTail = 0;
+	appender->RingFlushed = 0;
+	appender->RingStop = 0;
+}
+
 static BOOL WLog_FileAppender_SetOutputFileName(wLogFileAppender* appender, const char* filename)
 {
 	WINPR_ASSERT(appender);
@@ -54,6 +241,37 @@ static BOOL WLog_FileAppender_SetOutputFilePath(wLogFileAppender* appender, cons
 	return appender->FilePath != nullptr;
 }
 
+static BOOL WLog_FileAppender_SetAsync(wLogFileAppender* appender, const char* value)
+{
+	WINPR_ASSERT(appender);
+	WINPR_ASSERT(value);
+
+	if ((_stricmp(value, "true") == 0) || (strcmp(value, "1") == 0))
+		appender->Async = TRUE;
+	else if ((_stricmp(value, "false") == 0) || (strcmp(value, "0") == 0))
+		appender->Async = FALSE;
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+static BOOL WLog_FileAppender_SetFlushInterval(wLogFileAppender* appender, const char* value)
+{
+	WINPR_ASSERT(appender);
+	WINPR_ASSERT(value);
+
+	char* end = nullptr;
+	errno = 0;
+	const unsigned long interval = strtoul(value, &end, 0);
+
+	if ((errno != 0) || !end || (*end != '\0') || (interval == 0) || (interval > UINT32_MAX))
+		return FALSE;
+
+	appender->FlushInterval = (DWORD)interval;
+	return TRUE;
+}
+
 static BOOL WLog_FileAppender_Open(wLog* log, wLogAppender* appender)
 {
 	wLogFileAppender* fileAppender = nullptr;
@@ -100,7 +318,14 @@ static BOOL WLog_FileAppender_Open(wLog* log, wLogAppender* appender)
 
 	fileAppender->FileDescriptor = winpr_fopen(fileAppender->FullFileName, "a+");
 
-	return fileAppender->FileDescriptor != nullptr;
+	if (!fileAppender->FileDescriptor)
+		return FALSE;
+
+	/* Without a writer thread messages are written synchronously */
+	if (fileAppender->Async && !WLog_FileAppender_StartWriter(fileAppender))
+		WLog_FileAppender_StopWriter(fileAppender);
+
+	return TRUE;
 }
 
 static BOOL WLog_FileAppender_Close(wLog* log, wLogAppender* appender)
@@ -115,6 +340,7 @@ static BOOL WLog_FileAppender_Close(wLog* log, wLogAppender* appender)
 	if (!fileAppender->FileDescriptor)
 		return TRUE;
 
+	WLog_FileAppender_StopWriter(fileAppender);
 	(void)fclose(fileAppender->FileDescriptor);
 	fileAppender->FileDescriptor = nullptr;
 	return TRUE;
@@ -134,6 +360,11 @@ static BOOL WLog_FileAppender_WriteMessage(wLog* log, wLogAppender* appender,
 
 	char prefix[WLOG_MAX_PREFIX_SIZE] = WINPR_C_ARRAY_INIT;
 	WLog_Layout_GetMessagePrefix(log, appender->Layout, cmessage, prefix, sizeof(prefix));
+
+	if (fileAppender->Writer)
+		return WLog_FileAppender_WriteAsync(fileAppender, cmessage->Level, prefix,
+		                                    cmessage->TextString);
+
 	(void)fprintf(fp, "%s%s\n", prefix, cmessage->TextString);
 	(void)fflush(fp); /* slow! */
 	return TRUE;
@@ -190,6 +421,12 @@ static BOOL WLog_FileAppender_Set(wLogAppender* appender, const char* setting, v
 	if (!strcmp("outputfilepath", setting))
 		return WLog_FileAppender_SetOutputFilePath(fileAppender, (const char*)value);
 
+	if (!strcmp("async", setting))
+		return WLog_FileAppender_SetAsync(fileAppender, (const char*)value);
+
+	if (!strcmp("flushinterval", setting))
+		return WLog_FileAppender_SetFlushInterval(fileAppender, (const char*)value);
+
 	return FALSE;
 }
 
@@ -200,6 +437,12 @@ static void WLog_FileAppender_Free(wLogAppender* appender)
 	if (appender)
 	{
 		fileAppender = (wLogFileAppender*)appender;
+
+		/* Loggers are freed at exit without being closed, do not lose queued messages */
+		WLog_FileAppender_StopWriter(fileAppender);
+		if (fileAppender->FileDescriptor)
+			(void)fclose(fileAppender->FileDescriptor);
+
 		free(fileAppender->FileName);
 		free(fileAppender->FilePath);
 		free(fileAppender->FullFileName);
@@ -207,6 +450,18 @@ static void WLog_FileAppender_Free(wLogAppender* appender)
 	}
 }
 
+static void WLog_FileAppender_ConfigureFromEnv(wLogFileAppender* appender, const char* name,
+                                               BOOL (*fkt)(wLogFileAppender*, const char*))
+{
+	char* env = GetEnvAlloc(name);
+	if (!env)
+		return;
+
+	if (!fkt(appender, env))
+		(void)fprintf(stderr, "%s: ignoring invalid value '%s' for %s\n", __func__, env, name);
+	free(env);
+}
+
 wLogAppender* WLog_FileAppender_New(WINPR_ATTR_UNUSED wLog* log)
 {
 	LPSTR env = nullptr;
@@ -226,6 +481,13 @@ wLogAppender* WLog_FileAppender_New(WINPR_ATTR_UNUSED wLog* log)
 	FileAppender->common.WriteImageMessage = WLog_FileAppender_WriteImageMessage;
 	FileAppender->common.Free = WLog_FileAppender_Free;
 	FileAppender->common.Set = WLog_FileAppender_Set;
+	FileAppender->FlushInterval = WLOG_FILE_DEFAULT_FLUSH_INTERVAL;
+
+	WLog_FileAppender_ConfigureFromEnv(FileAppender, "WLOG_FILEAPPENDER_ASYNC",
+	                                   WLog_FileAppender_SetAsync);
+	WLog_FileAppender_ConfigureFromEnv(FileAppender, "WLOG_FILEAPPENDER_FLUSH_INTERVAL",
+	                                   WLog_FileAppender_SetFlushInterval);
+
 	name = "WLOG_FILEAPPENDER_OUTPUT_FILE_PATH";
 	nSize = GetEnvironmentVariableA(name, nullptr, 0);
 